@@ -58,3 +58,27 @@ LOCAL_MODULE_TAGS := optional
 
 LOCAL_MODULE    := libnvjni_mosaic
 include $(BUILD_SHARED_LIBRARY)
+
+# Checks and times the intrinsics and threaded corner detection and matching
+# against the C code, on synthetic frames or on the PGM frames listed in a file
+include $(CLEAR_VARS)
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/feature_stab/db_vlvm \
+        $(LOCAL_PATH)/feature_stab/src
+
+LOCAL_CFLAGS := -O3 -DNDEBUG -fstrict-aliasing
+
+LOCAL_SRC_FILES := \
+        feature_stab/src/dbregtest/dbregbench.cpp \
+        feature_stab/src/dbregtest/PgmImage.cpp \
+        feature_stab/db_vlvm/db_feature_detection.cpp \
+        feature_stab/db_vlvm/db_feature_matching.cpp \
+        feature_stab/db_vlvm/db_utilities.cpp \
+        feature_stab/db_vlvm/db_utilities_indexing.cpp
+
+LOCAL_MODULE_TAGS := nvidia_tests
+
+LOCAL_MODULE    := dbregbench
+include external/stlport/libstlport.mk
+include $(BUILD_EXECUTABLE)
@@ -19,6 +19,8 @@
 // $Id: Blend.cpp,v 1.22 2011/06/24 04:22:14 mbansal Exp $
 
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "Interp.h"
 #include "Blend.h"
@@ -29,9 +31,24 @@
 #include "Log.h"
 #define LOG_TAG "BLEND"
 
+BlendWorker::BlendWorker()
+{
+  blend = NULL;
+  pMask[0] = pMask[1] = NULL;
+  cur = 0;
+  pFrameYPyr = pFrameUPyr = pFrameVPyr = NULL;
+  pMosaicYPyr = pMosaicUPyr = pMosaicVPyr = NULL;
+  grayRows = grayCols = NULL;
+  ret = Blend::BLEND_RET_OK;
+}
+
 Blend::Blend()
 {
   m_wb.blendingType = BLEND_TYPE_NONE;
+  m_pFrameYPyr = m_pFrameUPyr = m_pFrameVPyr = NULL;
+
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  setNumThreads(cpus > 0 ? (int) cpus : 1);
 }
 
 Blend::~Blend()
@@ -74,6 +91,13 @@ int Blend::initialize(int blendingType, int stripType, int frame_width, int fram
     return BLEND_RET_OK;
 }
 
+void Blend::setNumThreads(int numThreads)
+{
+    if (numThreads < 1) numThreads = 1;
+    if (numThreads > BLEND_MAX_THREADS) numThreads = BLEND_MAX_THREADS;
+    m_NumThreads = numThreads;
+}
+
 inline double max(double a, double b) { return a > b ? a : b; }
 inline double min(double a, double b) { return a < b ? a : b; }
 
@@ -328,7 +352,7 @@ int Blend::MosaicSizeCheck(float sizeMultiplier, float heightMultiplier) {
    return BLEND_RET_OK;
 }
 
-int Blend::FillFramePyramid(MosaicFrame *mb)
+int Blend::FillFramePyramid(MosaicFrame *mb, BlendWorker &wk)
 {
     ImageType mbY, mbU, mbV;
     // Lay this image, centered into the temporary buffer
@@ -340,9 +364,9 @@ int Blend::FillFramePyramid(MosaicFrame *mb)
 
     for(h=0; h<height; h++)
     {
-        ImageTypeShort yptr = m_pFrameYPyr->ptr[h];
-        ImageTypeShort uptr = m_pFrameUPyr->ptr[h];
-        ImageTypeShort vptr = m_pFrameVPyr->ptr[h];
+        ImageTypeShort yptr = wk.pFrameYPyr->ptr[h];
+        ImageTypeShort uptr = wk.pFrameUPyr->ptr[h];
+        ImageTypeShort vptr = wk.pFrameVPyr->ptr[h];
 
         for(w=0; w<width; w++)
         {
@@ -353,14 +377,14 @@ int Blend::FillFramePyramid(MosaicFrame *mb)
     }
 
     // Spread the image through the border
-    PyramidShort::BorderSpread(m_pFrameYPyr, BORDER, BORDER, BORDER, BORDER);
-    PyramidShort::BorderSpread(m_pFrameUPyr, BORDER, BORDER, BORDER, BORDER);
-    PyramidShort::BorderSpread(m_pFrameVPyr, BORDER, BORDER, BORDER, BORDER);
+    PyramidShort::BorderSpread(wk.pFrameYPyr, BORDER, BORDER, BORDER, BORDER);
+    PyramidShort::BorderSpread(wk.pFrameUPyr, BORDER, BORDER, BORDER, BORDER);
+    PyramidShort::BorderSpread(wk.pFrameVPyr, BORDER, BORDER, BORDER, BORDER);
 
     // Generate Laplacian pyramids
-    if (!PyramidShort::BorderReduce(m_pFrameYPyr, m_wb.nlevs) || !PyramidShort::BorderExpand(m_pFrameYPyr, m_wb.nlevs, -1) ||
-            !PyramidShort::BorderReduce(m_pFrameUPyr, m_wb.nlevsC) || !PyramidShort::BorderExpand(m_pFrameUPyr, m_wb.nlevsC, -1) ||
-            !PyramidShort::BorderReduce(m_pFrameVPyr, m_wb.nlevsC) || !PyramidShort::BorderExpand(m_pFrameVPyr, m_wb.nlevsC, -1))
+    if (!PyramidShort::BorderReduce(wk.pFrameYPyr, m_wb.nlevs) || !PyramidShort::BorderExpand(wk.pFrameYPyr, m_wb.nlevs, -1) ||
+            !PyramidShort::BorderReduce(wk.pFrameUPyr, m_wb.nlevsC) || !PyramidShort::BorderExpand(wk.pFrameUPyr, m_wb.nlevsC, -1) ||
+            !PyramidShort::BorderReduce(wk.pFrameVPyr, m_wb.nlevsC) || !PyramidShort::BorderExpand(wk.pFrameVPyr, m_wb.nlevsC, -1))
     {
         LOGE("Error: Could not generate Laplacian pyramids");
         return BLEND_RET_ERROR;
@@ -375,19 +399,6 @@ int Blend::DoMergeAndBlend(MosaicFrame **frames, int nsite,
              int width, int height, YUVinfo &imgMos, MosaicRect &rect,
              MosaicRect &cropping_rect, float &progress, bool &cancelComputation)
 {
-    m_pMosaicYPyr = NULL;
-    m_pMosaicUPyr = NULL;
-    m_pMosaicVPyr = NULL;
-
-    m_pMosaicYPyr = PyramidShort::allocatePyramidPacked(m_wb.nlevs,(unsigned short)rect.Width(),(unsigned short)rect.Height(),BORDER);
-    m_pMosaicUPyr = PyramidShort::allocatePyramidPacked(m_wb.nlevsC,(unsigned short)rect.Width(),(unsigned short)rect.Height(),BORDER);
-    m_pMosaicVPyr = PyramidShort::allocatePyramidPacked(m_wb.nlevsC,(unsigned short)rect.Width(),(unsigned short)rect.Height(),BORDER);
-    if (!m_pMosaicYPyr || !m_pMosaicUPyr || !m_pMosaicVPyr)
-    {
-      LOGE("Error: Could not allocate pyramids for blending");
-      return BLEND_RET_ERROR_MEMORY;
-    }
-
     MosaicFrame *mb;
 
     CSite *esite = m_AllSites + nsite;
@@ -399,9 +410,6 @@ int Blend::DoMergeAndBlend(MosaicFrame **frames, int nsite,
     {
         if(cancelComputation)
         {
-            if (m_pMosaicVPyr) free(m_pMosaicVPyr);
-            if (m_pMosaicUPyr) free(m_pMosaicUPyr);
-            if (m_pMosaicYPyr) free(m_pMosaicYPyr);
             return BLEND_RET_CANCELLED;
         }
 
@@ -550,34 +558,39 @@ int Blend::DoMergeAndBlend(MosaicFrame **frames, int nsite,
 
     }
 
-    // Now perform the actual blending using the frame assignment determined above
-    site_idx = 0;
-    for(CSite *csite = m_AllSites; csite < esite; csite++)
+    // Now perform the actual blending using the frame assignment determined
+    // above. The mosaic is blended in bands, each from Laplacian pyramids
+    // covering just the band, built from the frames overlapping it; see
+    // BlendBands.
+    m_NumSites = nsite;
+    m_pImgMos = &imgMos;
+    m_MosaicRect = rect;
+    m_CroppingRect = cropping_rect;
+    m_pCancelComputation = &cancelComputation;
+
+    bool *grayRows = (bool *) calloc(imgMos.Y.height, sizeof(bool));
+    bool *grayCols = (bool *) calloc(imgMos.Y.width, sizeof(bool));
+    if (!grayRows || !grayCols)
     {
-        if(cancelComputation)
-        {
-            if (m_pMosaicVPyr) free(m_pMosaicVPyr);
-            if (m_pMosaicUPyr) free(m_pMosaicUPyr);
-            if (m_pMosaicYPyr) free(m_pMosaicYPyr);
-            return BLEND_RET_CANCELLED;
-        }
-
-        mb = csite->getMb();
-
-
-        if(FillFramePyramid(mb)!=BLEND_RET_OK)
-            return BLEND_RET_ERROR;
-
-        ProcessPyramidForThisFrame(csite, mb->vcrect, mb->brect, rect, imgMos, mb->trs, site_idx);
-
-        progress += TIME_PERCENT_BLEND/nsite;
-
-        site_idx++;
+        free(grayRows);
+        free(grayCols);
+        LOGE("Error: Could not allocate memory for blending");
+        return BLEND_RET_ERROR_MEMORY;
     }
 
+    int ret = BlendBands(imgMos, progress, grayRows, grayCols);
+    if (ret != BLEND_RET_OK)
+    {
+        free(grayRows);
+        free(grayCols);
+        return ret;
+    }
 
     // Blend
-    PerformFinalBlending(imgMos, cropping_rect);
+    PerformFinalBlending(imgMos, cropping_rect, grayRows, grayCols);
+
+    free(grayRows);
+    free(grayCols);
 
     if (cropping_rect.Width() <= 0 || cropping_rect.Height() <= 0)
     {
@@ -586,100 +599,295 @@ int Blend::DoMergeAndBlend(MosaicFrame **frames, int nsite,
         return BLEND_RET_ERROR;
     }
 
-    if (m_pMosaicVPyr) free(m_pMosaicVPyr);
-    if (m_pMosaicUPyr) free(m_pMosaicUPyr);
-    if (m_pMosaicYPyr) free(m_pMosaicYPyr);
-
     progress += TIME_PERCENT_FINAL;
 
     return BLEND_RET_OK;
 }
 
-void Blend::CropFinalMosaic(YUVinfo &imgMos, MosaicRect &cropping_rect)
+// The mosaic is split across its longer side into bands, and each band is
+// blended from its own Laplacian pyramids, which only need to cover the band
+// plus BLEND_BAND_HALO pixels on either side at each level: the pyramid
+// filters only look one pixel away, so collapsing the band's pyramids gives
+// the same pixels as collapsing pyramids of the whole mosaic. Bands start at
+// multiples of the coarsest level's scale so their pyramid levels line up
+// with those of the whole mosaic.
+//
+// Bands are blended by up to m_NumThreads workers in passes. Blending a band
+// reads, and marks, the frame index masks up to BLEND_BAND_HALO pixels of the
+// coarsest level outside it, but writing a band out overwrites its masks
+// with the final pixels. So each worker works on a copy of the masks around
+// its band, taken before the previous pass's bands are written out, and the
+// bands are at least that halo wide.
+int Blend::BlendBands(YUVinfo &imgMos, float &progress, bool *grayRows, bool *grayCols)
 {
-    int i, j, k;
-    ImageType yimg;
-    ImageType uimg;
-    ImageType vimg;
+    int align = 1 << (m_wb.nlevs - 1);
+    int halo = BLEND_BAND_HALO << (m_wb.nlevs - 1);
+    bool columns = imgMos.Y.width >= imgMos.Y.height;
+    int length = columns ? imgMos.Y.width : imgMos.Y.height;
+
+    // Use a multiple of the number of threads bands
+    int numWorkers = m_NumThreads;
+    int numBands = (length + BLEND_BAND_SIZE - 1) / BLEND_BAND_SIZE;
+    numBands = (numBands + numWorkers - 1) / numWorkers * numWorkers;
+    int bandSize = (length + numBands - 1) / numBands;
+    bandSize = (bandSize + align - 1) / align * align;
+    if (bandSize <= halo)
+        bandSize = (halo + align) / align * align;
+    numBands = (length + bandSize - 1) / bandSize;
+    if (numWorkers > numBands)
+        numWorkers = numBands;
+
+    int maskWidth = columns ? bandSize + 2 * halo : imgMos.Y.width;
+    int maskHeight = columns ? imgMos.Y.height : bandSize + 2 * halo;
+    if (maskWidth > imgMos.Y.width) maskWidth = imgMos.Y.width;
+    if (maskHeight > imgMos.Y.height) maskHeight = imgMos.Y.height;
+
+    BlendWorker workers[BLEND_MAX_THREADS];
+    int ret = BLEND_RET_OK;
+    int k;
+
+    for (k = 0; k < numWorkers; k++)
+    {
+        BlendWorker &wk = workers[k];
+        wk.blend = this;
+        if (k == 0)
+        {
+            wk.pFrameYPyr = m_pFrameYPyr;
+            wk.pFrameUPyr = m_pFrameUPyr;
+            wk.pFrameVPyr = m_pFrameVPyr;
+        }
+        else
+        {
+            wk.pFrameYPyr = PyramidShort::allocatePyramidPacked(m_wb.nlevs, (unsigned short) width, (unsigned short) height, BORDER);
+            wk.pFrameUPyr = PyramidShort::allocatePyramidPacked(m_wb.nlevsC, (unsigned short) width, (unsigned short) height, BORDER);
+            wk.pFrameVPyr = PyramidShort::allocatePyramidPacked(m_wb.nlevsC, (unsigned short) width, (unsigned short) height, BORDER);
+        }
+        wk.pMask[0] = YUVinfo::allocateImage((unsigned short) maskWidth, (unsigned short) maskHeight);
+        wk.pMask[1] = YUVinfo::allocateImage((unsigned short) maskWidth, (unsigned short) maskHeight);
+        wk.grayRows = (bool *) calloc(imgMos.Y.height, sizeof(bool));
+        wk.grayCols = (bool *) calloc(imgMos.Y.width, sizeof(bool));
 
+        if (!wk.pFrameYPyr || !wk.pFrameUPyr || !wk.pFrameVPyr ||
+                !wk.pMask[0] || !wk.pMask[1] || !wk.grayRows || !wk.grayCols)
+        {
+            LOGE("Error: Could not allocate memory for blending thread %d", k);
+            ret = BLEND_RET_ERROR_MEMORY;
+            numWorkers = k + 1;
+            break;
+        }
 
-    yimg = imgMos.Y.ptr[0];
-    uimg = imgMos.U.ptr[0];
-    vimg = imgMos.V.ptr[0];
+        SetBand(wk, k, numBands, bandSize, columns);
+    }
 
-    k = 0;
-    for (j = cropping_rect.top; j <= cropping_rect.bottom; j++)
+    for (int pass = 0; ret == BLEND_RET_OK; pass++)
     {
-        for (i = cropping_rect.left; i <= cropping_rect.right; i++)
+        int blended = 0;
+
+        // Write out the bands of the last pass and blend the next ones
+        RunWorkers(workers, numWorkers);
+
+        for (k = 0; k < numWorkers; k++)
         {
-            yimg[k] = yimg[j*imgMos.Y.width+i];
-            k++;
+            if (workers[k].ret != BLEND_RET_OK)
+                ret = workers[k].ret;
+            if (workers[k].band.Width() > 0)
+                blended++;
         }
+
+        if (ret == BLEND_RET_OK && *m_pCancelComputation)
+            ret = BLEND_RET_CANCELLED;
+        if (ret != BLEND_RET_OK || blended == 0)
+            break;
+
+        progress += TIME_PERCENT_BLEND * blended / numBands;
+
+        for (k = 0; k < numWorkers; k++)
+            SetBand(workers[k], (pass + 1) * numWorkers + k, numBands, bandSize, columns);
     }
-    for (j = cropping_rect.top; j <= cropping_rect.bottom; j++)
+
+    for (k = 0; k < numWorkers; k++)
     {
-       for (i = cropping_rect.left; i <= cropping_rect.right; i++)
+        if (ret == BLEND_RET_OK)
         {
-            yimg[k] = vimg[j*imgMos.Y.width+i];
-            k++;
+            for (int j = 0; j < imgMos.Y.height; j++)
+                grayRows[j] = grayRows[j] || workers[k].grayRows[j];
+            for (int i = 0; i < imgMos.Y.width; i++)
+                grayCols[i] = grayCols[i] || workers[k].grayCols[i];
         }
+        FreeWorker(workers[k]);
     }
-    for (j = cropping_rect.top; j <= cropping_rect.bottom; j++)
+
+    return ret;
+}
+
+// Moves the worker on to band idx, or to no band if there are no more, and
+// copies the masks around it
+void Blend::SetBand(BlendWorker &wk, int idx, int numBands, int bandSize, bool columns)
+{
+    YUVinfo &imgMos = *m_pImgMos;
+    int halo = BLEND_BAND_HALO << (m_wb.nlevs - 1);
+
+    wk.lastBand = wk.band;
+    wk.cur ^= 1;
+
+    if (idx >= numBands)
     {
-       for (i = cropping_rect.left; i <= cropping_rect.right; i++)
-        {
-            yimg[k] = uimg[j*imgMos.Y.width+i];
-            k++;
-        }
+        wk.band = MosaicRect();
+        return;
+    }
+
+    MosaicRect &band = wk.band;
+    MosaicRect &mrect = wk.maskRect[wk.cur];
+    band.left = band.top = 0;
+    band.right = imgMos.Y.width;
+    band.bottom = imgMos.Y.height;
+    mrect = band;
+    if (columns)
+    {
+        band.left = idx * bandSize;
+        if (band.right > band.left + bandSize) band.right = band.left + bandSize;
+        mrect.left = (band.left > halo) ? band.left - halo : 0;
+        mrect.right = (band.right + halo < imgMos.Y.width) ? band.right + halo : imgMos.Y.width;
+    }
+    else
+    {
+        band.top = idx * bandSize;
+        if (band.bottom > band.top + bandSize) band.bottom = band.top + bandSize;
+        mrect.top = (band.top > halo) ? band.top - halo : 0;
+        mrect.bottom = (band.bottom + halo < imgMos.Y.height) ? band.bottom + halo : imgMos.Y.height;
+    }
+
+    YUVinfo *mask = wk.pMask[wk.cur];
+    for (int j = mrect.top; j < mrect.bottom; j++)
+    {
+        memcpy(mask->Y.ptr[j - mrect.top], imgMos.Y.ptr[j] + mrect.left, mrect.Width());
+        memcpy(mask->V.ptr[j - mrect.top], imgMos.V.ptr[j] + mrect.left, mrect.Width());
+        memcpy(mask->U.ptr[j - mrect.top], imgMos.U.ptr[j] + mrect.left, mrect.Width());
     }
 }
 
-int Blend::PerformFinalBlending(YUVinfo &imgMos, MosaicRect &cropping_rect)
+void *Blend::BlendThread(void *arg)
 {
-    if (!PyramidShort::BorderExpand(m_pMosaicYPyr, m_wb.nlevs, 1) || !PyramidShort::BorderExpand(m_pMosaicUPyr, m_wb.nlevsC, 1) ||
-        !PyramidShort::BorderExpand(m_pMosaicVPyr, m_wb.nlevsC, 1))
+    BlendWorker *wk = (BlendWorker *) arg;
+    wk->blend->RunWorker(*wk);
+    return NULL;
+}
+
+// Runs one pass of all the workers, the first one on this thread. A worker
+// whose thread cannot be started runs here too.
+void Blend::RunWorkers(BlendWorker *workers, int numWorkers)
+{
+    pthread_t threads[BLEND_MAX_THREADS];
+    bool started[BLEND_MAX_THREADS];
+    int k;
+
+    for (k = 1; k < numWorkers; k++)
+        started[k] = (pthread_create(&threads[k], NULL, BlendThread, &workers[k]) == 0);
+
+    RunWorker(workers[0]);
+
+    for (k = 1; k < numWorkers; k++)
+    {
+        if (started[k])
+            pthread_join(threads[k], NULL);
+        else
+            RunWorker(workers[k]);
+    }
+}
+
+void Blend::RunWorker(BlendWorker &wk)
+{
+    if (wk.lastBand.Width() > 0)
+        WriteBand(wk);
+
+    if (wk.band.Width() > 0 && wk.ret == BLEND_RET_OK)
+        wk.ret = BlendBand(wk);
+}
+
+// Builds the band's Laplacian pyramids from the frames overlapping it and
+// collapses them
+int Blend::BlendBand(BlendWorker &wk)
+{
+    MosaicRect &band = wk.band;
+
+    wk.pMosaicYPyr = PyramidShort::allocatePyramidPacked(m_wb.nlevs, (unsigned short) band.Width(), (unsigned short) band.Height(), BORDER);
+    wk.pMosaicUPyr = PyramidShort::allocatePyramidPacked(m_wb.nlevsC, (unsigned short) band.Width(), (unsigned short) band.Height(), BORDER);
+    wk.pMosaicVPyr = PyramidShort::allocatePyramidPacked(m_wb.nlevsC, (unsigned short) band.Width(), (unsigned short) band.Height(), BORDER);
+    if (!wk.pMosaicYPyr || !wk.pMosaicUPyr || !wk.pMosaicVPyr)
+    {
+        LOGE("Error: Could not allocate pyramids for blending");
+        return BLEND_RET_ERROR_MEMORY;
+    }
+
+    CSite *esite = m_AllSites + m_NumSites;
+    int site_idx = 0;
+    for (CSite *csite = m_AllSites; csite < esite; csite++, site_idx++)
+    {
+        if (*m_pCancelComputation)
+            return BLEND_RET_CANCELLED;
+
+        MosaicFrame *mb = csite->getMb();
+
+        // Skip the frames which contribute to no level of this band
+        int l, b, r, t, dscale;
+        for (dscale = 0; dscale < m_wb.nlevs; dscale++)
+        {
+            if (BandLevelRect(mb->vcrect, mb->brect, m_MosaicRect, band, dscale, l, b, r, t))
+                break;
+        }
+        if (dscale == m_wb.nlevs)
+            continue;
+
+        if (FillFramePyramid(mb, wk) != BLEND_RET_OK)
+            return BLEND_RET_ERROR;
+
+        ProcessPyramidForThisFrame(csite, mb->vcrect, mb->brect, m_MosaicRect, wk, mb->trs, site_idx);
+    }
+
+    if (!PyramidShort::BorderExpand(wk.pMosaicYPyr, m_wb.nlevs, 1) || !PyramidShort::BorderExpand(wk.pMosaicUPyr, m_wb.nlevsC, 1) ||
+        !PyramidShort::BorderExpand(wk.pMosaicVPyr, m_wb.nlevsC, 1))
     {
       LOGE("Error: Could not BorderExpand!");
       return BLEND_RET_ERROR;
     }
 
+    return BLEND_RET_OK;
+}
+
+// Copies the collapsed pyramids of the last band into the mosaic using the
+// final mask, and frees them
+void Blend::WriteBand(BlendWorker &wk)
+{
+    YUVinfo &imgMos = *m_pImgMos;
+    MosaicRect &band = wk.lastBand;
+    MosaicRect &mrect = wk.maskRect[wk.cur ^ 1];
+    YUVinfo *mask = wk.pMask[wk.cur ^ 1];
+    MosaicRect &cropping_rect = m_CroppingRect;
+
     ImageTypeShort myimg;
     ImageTypeShort muimg;
     ImageTypeShort mvimg;
     ImageType yimg;
     ImageType uimg;
     ImageType vimg;
+    ImageType ymask;
 
-    int cx = (int)imgMos.Y.width/2;
-    int cy = (int)imgMos.Y.height/2;
-
-    // 2D boolean array that contains true wherever the mosaic image data is
-    // invalid (i.e. in the gray border).
-    bool **b = new bool*[imgMos.Y.height];
-
-    for(int j=0; j<imgMos.Y.height; j++)
+    for (int j = band.top; j < band.bottom; j++)
     {
-        b[j] = new bool[imgMos.Y.width];
-    }
-
-    // Copy the resulting image into the full image using the mask
-    int i, j;
-
-    yimg = imgMos.Y.ptr[0];
-    uimg = imgMos.U.ptr[0];
-    vimg = imgMos.V.ptr[0];
+        myimg = wk.pMosaicYPyr->ptr[j - band.top];
+        muimg = wk.pMosaicUPyr->ptr[j - band.top];
+        mvimg = wk.pMosaicVPyr->ptr[j - band.top];
 
-    for (j = 0; j < imgMos.Y.height; j++)
-    {
-        myimg = m_pMosaicYPyr->ptr[j];
-        muimg = m_pMosaicUPyr->ptr[j];
-        mvimg = m_pMosaicVPyr->ptr[j];
+        yimg = imgMos.Y.ptr[j] + band.left;
+        uimg = imgMos.U.ptr[j] + band.left;
+        vimg = imgMos.V.ptr[j] + band.left;
+        ymask = mask->Y.ptr[j - mrect.top] + band.left - mrect.left;
 
-        for (i = 0; i<imgMos.Y.width; i++)
+        for (int i = band.left; i < band.right; i++)
         {
             // A final mask was set up previously,
             // if the value is zero skip it, otherwise replace it.
-            if (*yimg <255)
+            if (*ymask < 255)
             {
                 short value = (short) ((*myimg) >> 3);
                 if (value < 0) value = 0;
@@ -695,9 +903,6 @@ int Blend::PerformFinalBlending(YUVinfo &imgMos, MosaicRect &cropping_rect)
                 if (value < 0) value = 0;
                 else if (value > 255) value = 255;
                 *vimg = (unsigned char) value;
-
-                b[j][i] = false;
-
             }
             else
             {   // set border color in here
@@ -705,32 +910,103 @@ int Blend::PerformFinalBlending(YUVinfo &imgMos, MosaicRect &cropping_rect)
                 *uimg = (unsigned char) 128;
                 *vimg = (unsigned char) 128;
 
-                b[j][i] = true;
+                if (i >= cropping_rect.left && i < cropping_rect.right)
+                    wk.grayRows[j] = true;
+                if (j >= cropping_rect.top && j < cropping_rect.bottom)
+                    wk.grayCols[i] = true;
             }
 
             yimg++;
             uimg++;
             vimg++;
+            ymask++;
             myimg++;
             muimg++;
             mvimg++;
         }
     }
 
+    free(wk.pMosaicVPyr);
+    free(wk.pMosaicUPyr);
+    free(wk.pMosaicYPyr);
+    wk.pMosaicYPyr = wk.pMosaicUPyr = wk.pMosaicVPyr = NULL;
+    wk.lastBand = MosaicRect();
+}
+
+void Blend::FreeWorker(BlendWorker &wk)
+{
+    if (wk.pFrameYPyr != m_pFrameYPyr)
+    {
+        if (wk.pFrameVPyr) free(wk.pFrameVPyr);
+        if (wk.pFrameUPyr) free(wk.pFrameUPyr);
+        if (wk.pFrameYPyr) free(wk.pFrameYPyr);
+    }
+    if (wk.pMosaicVPyr) free(wk.pMosaicVPyr);
+    if (wk.pMosaicUPyr) free(wk.pMosaicUPyr);
+    if (wk.pMosaicYPyr) free(wk.pMosaicYPyr);
+    for (int m = 0; m < 2; m++)
+    {
+        if (wk.pMask[m])
+        {
+            free(wk.pMask[m]->Y.ptr[0]);
+            free(wk.pMask[m]);
+        }
+    }
+    free(wk.grayRows);
+    free(wk.grayCols);
+}
+
+void Blend::CropFinalMosaic(YUVinfo &imgMos, MosaicRect &cropping_rect)
+{
+    int i, j, k;
+    ImageType yimg;
+    ImageType uimg;
+    ImageType vimg;
+
+
+    yimg = imgMos.Y.ptr[0];
+    uimg = imgMos.U.ptr[0];
+    vimg = imgMos.V.ptr[0];
+
+    k = 0;
+    for (j = cropping_rect.top; j <= cropping_rect.bottom; j++)
+    {
+        for (i = cropping_rect.left; i <= cropping_rect.right; i++)
+        {
+            yimg[k] = yimg[j*imgMos.Y.width+i];
+            k++;
+        }
+    }
+    for (j = cropping_rect.top; j <= cropping_rect.bottom; j++)
+    {
+       for (i = cropping_rect.left; i <= cropping_rect.right; i++)
+        {
+            yimg[k] = vimg[j*imgMos.Y.width+i];
+            k++;
+        }
+    }
+    for (j = cropping_rect.top; j <= cropping_rect.bottom; j++)
+    {
+       for (i = cropping_rect.left; i <= cropping_rect.right; i++)
+        {
+            yimg[k] = uimg[j*imgMos.Y.width+i];
+            k++;
+        }
+    }
+}
+
+// Shrinks the cropping rectangle to exclude the rows (or columns, for a
+// vertical mosaic) containing gray border pixels, as recorded by WriteBand
+int Blend::PerformFinalBlending(YUVinfo &imgMos, MosaicRect &cropping_rect, bool *grayRows, bool *grayCols)
+{
+    int i, j;
+
     if(m_wb.horizontal)
     {
         //Scan through each row and increment top if the row contains any gray
         for (j = 0; j < imgMos.Y.height; j++)
         {
-            for (i = cropping_rect.left; i < cropping_rect.right; i++)
-            {
-                if (b[j][i])
-                {
-                    break; // to next row
-                }
-            }
-
-            if (i == cropping_rect.right)   //no gray pixel in this row!
+            if (!grayRows[j])   //no gray pixel in this row!
             {
                 cropping_rect.top = j;
                 break;
@@ -740,15 +1016,7 @@ int Blend::PerformFinalBlending(YUVinfo &imgMos, MosaicRect &cropping_rect)
         //Scan through each row and decrement bottom if the row contains any gray
         for (j = imgMos.Y.height-1; j >= 0; j--)
         {
-            for (i = cropping_rect.left; i < cropping_rect.right; i++)
-            {
-                if (b[j][i])
-                {
-                    break; // to next row
-                }
-            }
-
-            if (i == cropping_rect.right)   //no gray pixel in this row!
+            if (!grayRows[j])   //no gray pixel in this row!
             {
                 cropping_rect.bottom = j;
                 break;
@@ -760,15 +1028,7 @@ int Blend::PerformFinalBlending(YUVinfo &imgMos, MosaicRect &cropping_rect)
         //Scan through each column and increment left if the column contains any gray
         for (i = 0; i < imgMos.Y.width; i++)
         {
-            for (j = cropping_rect.top; j < cropping_rect.bottom; j++)
-            {
-                if (b[j][i])
-                {
-                    break; // to next column
-                }
-            }
-
-            if (j == cropping_rect.bottom)   //no gray pixel in this column!
+            if (!grayCols[i])   //no gray pixel in this column!
             {
                 cropping_rect.left = i;
                 break;
@@ -778,15 +1038,7 @@ int Blend::PerformFinalBlending(YUVinfo &imgMos, MosaicRect &cropping_rect)
         //Scan through each column and decrement right if the column contains any gray
         for (i = imgMos.Y.width-1; i >= 0; i--)
         {
-            for (j = cropping_rect.top; j < cropping_rect.bottom; j++)
-            {
-                if (b[j][i])
-                {
-                    break; // to next column
-                }
-            }
-
-            if (j == cropping_rect.bottom)   //no gray pixel in this column!
+            if (!grayCols[i])   //no gray pixel in this column!
             {
                 cropping_rect.right = i;
                 break;
@@ -797,13 +1049,6 @@ int Blend::PerformFinalBlending(YUVinfo &imgMos, MosaicRect &cropping_rect)
 
     RoundingCroppingSizeToMultipleOf8(cropping_rect);
 
-    for(int j=0; j<imgMos.Y.height; j++)
-    {
-        delete b[j];
-    }
-
-    delete b;
-
     return BLEND_RET_OK;
 }
 
@@ -819,7 +1064,9 @@ void Blend::RoundingCroppingSizeToMultipleOf8(MosaicRect &rect) {
 
 void Blend::ComputeMask(CSite *csite, BlendRect &vcrect, BlendRect &brect, MosaicRect &rect, YUVinfo &imgMos, int site_idx)
 {
-    PyramidShort *dptr = m_pMosaicYPyr;
+    // Size of the mosaic pyramid
+    int width = (unsigned short) rect.Width();
+    int height = (unsigned short) rect.Height();
 
     int nC = m_wb.nlevsC;
     int l = (int) ((vcrect.lft - rect.left));
@@ -838,14 +1085,14 @@ void Blend::ComputeMask(CSite *csite, BlendRect &vcrect, BlendRect &brect, Mosai
         b = -BORDER;
 
     if (vcrect.rgt == brect.rgt)
-        r = (r >= dptr->width) ? dptr->width + BORDER - 1 : r + BORDER;
-    else if (r >= dptr->width + BORDER)
-        r = dptr->width + BORDER - 1;
+        r = (r >= width) ? width + BORDER - 1 : r + BORDER;
+    else if (r >= width + BORDER)
+        r = width + BORDER - 1;
 
     if (vcrect.top == brect.top)
-        t = (t >= dptr->height) ? dptr->height + BORDER - 1 : t + BORDER;
-    else if (t >= dptr->height + BORDER)
-        t = dptr->height + BORDER - 1;
+        t = (t >= height) ? height + BORDER - 1 : t + BORDER;
+    else if (t >= height + BORDER)
+        t = height + BORDER - 1;
 
     // Walk the Region of interest and populate the pyramid
     for (int j = b; j <= t; j++)
@@ -887,49 +1134,83 @@ void Blend::ComputeMask(CSite *csite, BlendRect &vcrect, BlendRect &brect, Mosai
     }
 }
 
-void Blend::ProcessPyramidForThisFrame(CSite *csite, BlendRect &vcrect, BlendRect &brect, MosaicRect &rect, YUVinfo &imgMos, double trs[3][3], int site_idx)
+// Region of interest of a frame at pyramid level dscale, clipped to the part
+// of that level blended for the band. Returns false if that is empty.
+bool Blend::BandLevelRect(BlendRect &vcrect, BlendRect &brect, MosaicRect &rect, MosaicRect &band, int dscale, int &l, int &b, int &r, int &t)
 {
-    // Put the Region of interest (for all levels) into m_pMosaicYPyr
+    // Size of this level of the mosaic pyramid
+    int width = (unsigned short) rect.Width() >> dscale;
+    int height = (unsigned short) rect.Height() >> dscale;
+
+    l = (int) ((vcrect.lft - rect.left) / (1 << dscale));
+    b = (int) ((vcrect.bot - rect.top) / (1 << dscale));
+    r = (int) ((vcrect.rgt - rect.left) / (1 << dscale) + .5);
+    t = (int) ((vcrect.top - rect.top) / (1 << dscale) + .5);
+
+    if (vcrect.lft == brect.lft)
+        l = (l <= 0) ? -BORDER : l - BORDER;
+    else if (l < -BORDER)
+        l = -BORDER;
+
+    if (vcrect.bot == brect.bot)
+        b = (b <= 0) ? -BORDER : b - BORDER;
+    else if (b < -BORDER)
+        b = -BORDER;
+
+    if (vcrect.rgt == brect.rgt)
+        r = (r >= width) ? width + BORDER - 1 : r + BORDER;
+    else if (r >= width + BORDER)
+        r = width + BORDER - 1;
+
+    if (vcrect.top == brect.top)
+        t = (t >= height) ? height + BORDER - 1 : t + BORDER;
+    else if (t >= height + BORDER)
+        t = height + BORDER - 1;
+
+    int bl = (band.left >> dscale) - BLEND_BAND_HALO;
+    int bb = (band.top >> dscale) - BLEND_BAND_HALO;
+    int br = ((band.right - 1) >> dscale) + BLEND_BAND_HALO;
+    int bt = ((band.bottom - 1) >> dscale) + BLEND_BAND_HALO;
+
+    if (l < bl) l = bl;
+    if (b < bb) b = bb;
+    if (r > br) r = br;
+    if (t > bt) t = bt;
+
+    return l <= r && b <= t;
+}
+
+void Blend::ProcessPyramidForThisFrame(CSite *csite, BlendRect &vcrect, BlendRect &brect, MosaicRect &rect, BlendWorker &wk, double trs[3][3], int site_idx)
+{
+    // Put the Region of interest (for all levels) into the band's pyramids
     double inv_trs[3][3];
     inv33d(trs, inv_trs);
 
     // Process each pyramid level
-    PyramidShort *sptr = m_pFrameYPyr;
-    PyramidShort *suptr = m_pFrameUPyr;
-    PyramidShort *svptr = m_pFrameVPyr;
+    PyramidShort *sptr = wk.pFrameYPyr;
+    PyramidShort *suptr = wk.pFrameUPyr;
+    PyramidShort *svptr = wk.pFrameVPyr;
+
+    PyramidShort *dptr = wk.pMosaicYPyr;
+    PyramidShort *duptr = wk.pMosaicUPyr;
+    PyramidShort *dvptr = wk.pMosaicVPyr;
 
-    PyramidShort *dptr = m_pMosaicYPyr;
-    PyramidShort *duptr = m_pMosaicUPyr;
-    PyramidShort *dvptr = m_pMosaicVPyr;
+    // The masks are read from the worker's copy around the band
+    YUVinfo &imgMos = *wk.pMask[wk.cur];
+    int mx = wk.maskRect[wk.cur].left;
+    int my = wk.maskRect[wk.cur].top;
 
     int dscale = 0; // distance scale for the current level
     int nC = m_wb.nlevsC;
     for (int n = m_wb.nlevs; n--; dscale++, dptr++, sptr++, dvptr++, duptr++, svptr++, suptr++, nC--)
     {
-        int l = (int) ((vcrect.lft - rect.left) / (1 << dscale));
-        int b = (int) ((vcrect.bot - rect.top) / (1 << dscale));
-        int r = (int) ((vcrect.rgt - rect.left) / (1 << dscale) + .5);
-        int t = (int) ((vcrect.top - rect.top) / (1 << dscale) + .5);
-
-        if (vcrect.lft == brect.lft)
-            l = (l <= 0) ? -BORDER : l - BORDER;
-        else if (l < -BORDER)
-            l = -BORDER;
-
-        if (vcrect.bot == brect.bot)
-            b = (b <= 0) ? -BORDER : b - BORDER;
-        else if (b < -BORDER)
-            b = -BORDER;
-
-        if (vcrect.rgt == brect.rgt)
-            r = (r >= dptr->width) ? dptr->width + BORDER - 1 : r + BORDER;
-        else if (r >= dptr->width + BORDER)
-            r = dptr->width + BORDER - 1;
-
-        if (vcrect.top == brect.top)
-            t = (t >= dptr->height) ? dptr->height + BORDER - 1 : t + BORDER;
-        else if (t >= dptr->height + BORDER)
-            t = dptr->height + BORDER - 1;
+        int l, b, r, t;
+        if (!BandLevelRect(vcrect, brect, rect, wk.band, dscale, l, b, r, t))
+            continue;
+
+        // Origin of the band's pyramid level in the mosaic pyramid level
+        int ox = wk.band.left >> dscale;
+        int oy = wk.band.top >> dscale;
 
         // Walk the Region of interest and populate the pyramid
         for (int j = b; j <= t; j++)
@@ -943,12 +1224,12 @@ void Blend::ProcessPyramidForThisFrame(CSite *csite, BlendRect &vcrect, BlendRec
                 // project point and then triangulate to neighbors
                 double si = ii + rect.left;
 
-                int inMask = ((unsigned) ii < imgMos.Y.width &&
-                        (unsigned) jj < imgMos.Y.height) ? 1 : 0;
+                int inMask = ((unsigned) ii < Mwidth &&
+                        (unsigned) jj < Mheight) ? 1 : 0;
 
-                if(inMask && imgMos.Y.ptr[jj][ii] != site_idx &&
-                        imgMos.V.ptr[jj][ii] != site_idx &&
-                        imgMos.Y.ptr[jj][ii] != 255)
+                if(inMask && imgMos.Y.ptr[jj - my][ii - mx] != site_idx &&
+                        imgMos.V.ptr[jj - my][ii - mx] != site_idx &&
+                        imgMos.Y.ptr[jj - my][ii - mx] != 255)
                     continue;
 
                 // Setup weights for cross-fading
@@ -959,11 +1240,11 @@ void Blend::ProcessPyramidForThisFrame(CSite *csite, BlendRect &vcrect, BlendRec
 
                 if (m_wb.stripType == STRIP_TYPE_WIDE)
                 {
-                    if(inMask && imgMos.Y.ptr[jj][ii] != 255)
+                    if(inMask && imgMos.Y.ptr[jj - my][ii - mx] != 255)
                     {
                         // If not on a seam OR pyramid level exceeds
                         // maximum level for cross-fading.
-                        if((imgMos.V.ptr[jj][ii] == 128) ||
+                        if((imgMos.V.ptr[jj - my][ii - mx] == 128) ||
                             (dscale > STRIP_CROSS_FADE_MAX_PYR_LEVEL))
                         {
                             wt0 = 0.0;
@@ -972,9 +1253,9 @@ void Blend::ProcessPyramidForThisFrame(CSite *csite, BlendRect &vcrect, BlendRec
                         else
                         {
                             wt0 = 1.0;
-                            wt1 = ((imgMos.Y.ptr[jj][ii] == site_idx) ?
-                                    (double)imgMos.U.ptr[jj][ii] / 100.0 :
-                                    1.0 - (double)imgMos.U.ptr[jj][ii] / 100.0);
+                            wt1 = ((imgMos.Y.ptr[jj - my][ii - mx] == site_idx) ?
+                                    (double)imgMos.U.ptr[jj - my][ii - mx] / 100.0 :
+                                    1.0 - (double)imgMos.U.ptr[jj - my][ii - mx] / 100.0);
                         }
                     }
                 }
@@ -988,7 +1269,7 @@ void Blend::ProcessPyramidForThisFrame(CSite *csite, BlendRect &vcrect, BlendRec
                 {
                     if(inMask)
                     {
-                        imgMos.Y.ptr[jj][ii] = 255;
+                        imgMos.Y.ptr[jj - my][ii - mx] = 255;
                         wt0 = 0.0f;
                         wt1 = 1.0f;
                     }
@@ -1008,13 +1289,13 @@ void Blend::ProcessPyramidForThisFrame(CSite *csite, BlendRect &vcrect, BlendRec
                 {
                     double xfrac = xx - x1;
                     double yfrac = yy - y1;
-                    dptr->ptr[j][i] = (short) (wt0 * dptr->ptr[j][i] + .5 +
+                    dptr->ptr[j - oy][i - ox] = (short) (wt0 * dptr->ptr[j - oy][i - ox] + .5 +
                             wt1 * ciCalc(sptr, x1, y1, xfrac, yfrac));
-                    if (dvptr >= m_pMosaicVPyr && nC > 0)
+                    if (dvptr >= wk.pMosaicVPyr && nC > 0)
                     {
-                        duptr->ptr[j][i] = (short) (wt0 * duptr->ptr[j][i] + .5 +
+                        duptr->ptr[j - oy][i - ox] = (short) (wt0 * duptr->ptr[j - oy][i - ox] + .5 +
                                 wt1 * ciCalc(suptr, x1, y1, xfrac, yfrac));
-                        dvptr->ptr[j][i] = (short) (wt0 * dvptr->ptr[j][i] + .5 +
+                        dvptr->ptr[j - oy][i - ox] = (short) (wt0 * dvptr->ptr[j - oy][i - ox] + .5 +
                                 wt1 * ciCalc(svptr, x1, y1, xfrac, yfrac));
                     }
                 }
@@ -1029,23 +1310,23 @@ void Blend::ProcessPyramidForThisFrame(CSite *csite, BlendRect &vcrect, BlendRec
                         (sptr->ptr[y1][x2] - sptr->ptr[y1][x1]) * xfrac;
                     double y2val = sptr->ptr[y2][x1] +
                         (sptr->ptr[y2][x2] - sptr->ptr[y2][x1]) * xfrac;
-                    dptr->ptr[j][i] = (short) (y1val + yfrac * (y2val - y1val));
+                    dptr->ptr[j - oy][i - ox] = (short) (y1val + yfrac * (y2val - y1val));
 
-                    if (dvptr >= m_pMosaicVPyr && nC > 0)
+                    if (dvptr >= wk.pMosaicVPyr && nC > 0)
                     {
                         y1val = suptr->ptr[y1][x1] +
                             (suptr->ptr[y1][x2] - suptr->ptr[y1][x1]) * xfrac;
                         y2val = suptr->ptr[y2][x1] +
                             (suptr->ptr[y2][x2] - suptr->ptr[y2][x1]) * xfrac;
 
-                        duptr->ptr[j][i] = (short) (y1val + yfrac * (y2val - y1val));
+                        duptr->ptr[j - oy][i - ox] = (short) (y1val + yfrac * (y2val - y1val));
 
                         y1val = svptr->ptr[y1][x1] +
                             (svptr->ptr[y1][x2] - svptr->ptr[y1][x1]) * xfrac;
                         y2val = svptr->ptr[y2][x1] +
                             (svptr->ptr[y2][x2] - svptr->ptr[y2][x1]) * xfrac;
 
-                        dvptr->ptr[j][i] = (short) (y1val + yfrac * (y2val - y1val));
+                        dvptr->ptr[j - oy][i - ox] = (short) (y1val + yfrac * (y2val - y1val));
                     }
                 }
 #endif
@@ -1054,13 +1335,13 @@ void Blend::ProcessPyramidForThisFrame(CSite *csite, BlendRect &vcrect, BlendRec
                     clipToSegment(x1, sptr->width, BORDER);
                     clipToSegment(y1, sptr->height, BORDER);
 
-                    dptr->ptr[j][i] = (short) (wt0 * dptr->ptr[j][i] + 0.5 +
+                    dptr->ptr[j - oy][i - ox] = (short) (wt0 * dptr->ptr[j - oy][i - ox] + 0.5 +
                             wt1 * sptr->ptr[y1][x1] );
-                    if (dvptr >= m_pMosaicVPyr && nC > 0)
+                    if (dvptr >= wk.pMosaicVPyr && nC > 0)
                     {
-                        dvptr->ptr[j][i] = (short) (wt0 * dvptr->ptr[j][i] +
+                        dvptr->ptr[j - oy][i - ox] = (short) (wt0 * dvptr->ptr[j - oy][i - ox] +
                                 0.5 + wt1 * svptr->ptr[y1][x1] );
-                        duptr->ptr[j][i] = (short) (wt0 * duptr->ptr[j][i] +
+                        duptr->ptr[j - oy][i - ox] = (short) (wt0 * duptr->ptr[j - oy][i - ox] +
                                 0.5 + wt1 * suptr->ptr[y1][x1] );
                     }
                 }
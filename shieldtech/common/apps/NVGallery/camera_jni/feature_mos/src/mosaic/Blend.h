@@ -28,6 +28,17 @@
 #define BLEND_RANGE_DEFAULT 6
 #define BORDER 8
 
+// The mosaic is blended in bands of at most about this many columns (rows for
+// a vertical mosaic), each with its own pyramids, so the memory used for
+// blending does not grow with the length of the mosaic.
+#define BLEND_BAND_SIZE 512
+// Pixels blended on either side of a band at each pyramid level, so that
+// collapsing the band's pyramids gives the same result as collapsing
+// pyramids of the whole mosaic.
+#define BLEND_BAND_HALO 3
+// Maximum number of bands blended in parallel
+#define BLEND_MAX_THREADS 4
+
 // Percent of total mosaicing time spent on each of the following operations
 const float TIME_PERCENT_ALIGN = 20.0;
 const float TIME_PERCENT_BLEND = 75.0;
@@ -47,6 +58,43 @@ const float STRIP_CROSS_FADE_WIDTH_PXLS = 2;
 // the blending algorithm.
 const int STRIP_CROSS_FADE_MAX_PYR_LEVEL = 2;
 
+class Blend;
+
+/**
+ *  State of one blending thread: the band of the mosaic it is blending, the
+ *  band it blended last (waiting to be written out), and its buffers.
+ */
+class BlendWorker {
+public:
+  BlendWorker();
+
+  Blend *blend;
+
+  MosaicRect band;      // Band being blended, in mosaic coordinates
+  MosaicRect lastBand;  // Band blended by the previous pass
+
+  // Copies of the frame index and cross-fade masks around band and lastBand,
+  // taken before the neighbouring bands are written out.
+  YUVinfo *pMask[2];
+  MosaicRect maskRect[2];
+  int cur;              // Index of the mask copy of band
+
+  PyramidShort *pFrameYPyr;
+  PyramidShort *pFrameUPyr;
+  PyramidShort *pFrameVPyr;
+
+  PyramidShort *pMosaicYPyr;
+  PyramidShort *pMosaicUPyr;
+  PyramidShort *pMosaicVPyr;
+
+  // Rows with gray pixels between the cropping columns, and columns with gray
+  // pixels between the cropping rows
+  bool *grayRows;
+  bool *grayCols;
+
+  int ret;
+};
+
 /**
  *  Class for pyramid blending a mosaic.
  */
@@ -76,18 +124,29 @@ public:
   int runBlend(MosaicFrame **frames, MosaicFrame **rframes, int frames_size, ImageType &imageMosaicYVU,
         int &mosaicWidth, int &mosaicHeight, float &progress, bool &cancelComputation);
 
+  /**
+   *  Sets the number of bands blended in parallel, by default the number of
+   *  online CPUs up to BLEND_MAX_THREADS.
+   */
+  void setNumThreads(int numThreads);
+
 protected:
 
   PyramidShort *m_pFrameYPyr;
   PyramidShort *m_pFrameUPyr;
   PyramidShort *m_pFrameVPyr;
 
-  PyramidShort *m_pMosaicYPyr;
-  PyramidShort *m_pMosaicUPyr;
-  PyramidShort *m_pMosaicVPyr;
-
   CDelaunay m_Triangulator;
   CSite *m_AllSites;
+  int m_NumSites;
+
+  // Shared by the blending threads during DoMergeAndBlend
+  YUVinfo *m_pImgMos;
+  MosaicRect m_MosaicRect;
+  MosaicRect m_CroppingRect;
+  bool *m_pCancelComputation;
+
+  int m_NumThreads;
 
   BlendParams m_wb;
 
@@ -106,16 +165,27 @@ protected:
 
   int  DoMergeAndBlend(MosaicFrame **frames, int nsite,  int width, int height, YUVinfo &imgMos, MosaicRect &rect, MosaicRect &cropping_rect, float &progress, bool &cancelComputation);
   void ComputeMask(CSite *csite, BlendRect &vcrect, BlendRect &brect, MosaicRect &rect, YUVinfo &imgMos, int site_idx);
-  void ProcessPyramidForThisFrame(CSite *csite, BlendRect &vcrect, BlendRect &brect, MosaicRect &rect, YUVinfo &imgMos, double trs[3][3], int site_idx);
+  void ProcessPyramidForThisFrame(CSite *csite, BlendRect &vcrect, BlendRect &brect, MosaicRect &rect, BlendWorker &wk, double trs[3][3], int site_idx);
+  bool BandLevelRect(BlendRect &vcrect, BlendRect &brect, MosaicRect &rect, MosaicRect &band, int dscale, int &l, int &b, int &r, int &t);
+
+  int  FillFramePyramid(MosaicFrame *mb, BlendWorker &wk);
 
-  int  FillFramePyramid(MosaicFrame *mb);
+  // Band processing, see DoMergeAndBlend
+  int  BlendBands(YUVinfo &imgMos, float &progress, bool *grayRows, bool *grayCols);
+  void SetBand(BlendWorker &wk, int idx, int numBands, int bandSize, bool columns);
+  void RunWorkers(BlendWorker *workers, int numWorkers);
+  void RunWorker(BlendWorker &wk);
+  int  BlendBand(BlendWorker &wk);
+  void WriteBand(BlendWorker &wk);
+  void FreeWorker(BlendWorker &wk);
+  static void *BlendThread(void *arg);
 
   // TODO: need to add documentation about the parameters
   void ComputeBlendParameters(MosaicFrame **frames, int frames_size, int is360);
   void SelectRelevantFrames(MosaicFrame **frames, int frames_size,
         MosaicFrame **relevant_frames, int &relevant_frames_size);
 
-  int  PerformFinalBlending(YUVinfo &imgMos, MosaicRect &cropping_rect);
+  int  PerformFinalBlending(YUVinfo &imgMos, MosaicRect &cropping_rect, bool *grayRows, bool *grayCols);
   void CropFinalMosaic(YUVinfo &imgMos, MosaicRect &cropping_rect);
 
 private:
@@ -21,6 +21,204 @@
 
 #include "Pyramid.h"
 
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PYRAMID_USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define PYRAMID_USE_SSE2
+#endif
+
+// Vector versions of the [1 4 6 4 1]/16 reduce and [1 6 1]/8, [1 1]/2 expand
+// filter taps. Each one filters the leading part of a run of n outputs, keeps
+// the intermediate sums in 32 bits like the C loops do so the results are
+// identical, and returns how many outputs it wrote; the caller's C loop
+// filters the rest. They never read further than the C loop would.
+
+#ifdef PYRAMID_USE_SSE2
+static inline __m128i SignExtendLo(__m128i v)
+{
+    return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+}
+
+static inline __m128i SignExtendHi(__m128i v)
+{
+    return _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+}
+
+static inline __m128i Times6(__m128i v)
+{
+    return _mm_add_epi32(_mm_slli_epi32(v, 2), _mm_slli_epi32(v, 1));
+}
+
+// 1 4 6 4 1 taps over the even (lo 16 bits) or odd (hi 16 bits) samples of
+// eight consecutive samples starting at p[-2], p and p[2]
+static inline __m128i Reduce4H(const ImageTypeShortBase *p)
+{
+    __m128i a = _mm_loadu_si128((const __m128i *) (p - 2));
+    __m128i b = _mm_loadu_si128((const __m128i *) p);
+    __m128i c = _mm_loadu_si128((const __m128i *) (p + 2));
+    __m128i sum = _mm_add_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16),
+            _mm_srai_epi32(_mm_slli_epi32(c, 16), 16));
+    sum = _mm_add_epi32(sum, _mm_slli_epi32(_mm_add_epi32(_mm_srai_epi32(a, 16),
+            _mm_srai_epi32(b, 16)), 2));
+    sum = _mm_add_epi32(sum, Times6(_mm_srai_epi32(_mm_slli_epi32(b, 16), 16)));
+    return _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(8)), 4);
+}
+#endif
+
+// s[k] = 1 4 6 4 1 filter of p[2k-2..2k+2]
+static int ReduceRowH(ImageTypeShortBase *s, const ImageTypeShortBase *p, int n)
+{
+    int k = 0;
+#if defined(PYRAMID_USE_NEON)
+    for (; k + 8 < n; k += 8, p += 16) {
+        int16x8x2_t a = vld2q_s16(p - 2);
+        int16x8x2_t b = vld2q_s16(p);
+        int16x8_t c = vld2q_s16(p + 2).val[0];
+        int32x4_t lo = vaddl_s16(vget_low_s16(a.val[0]), vget_low_s16(c));
+        int32x4_t hi = vaddl_s16(vget_high_s16(a.val[0]), vget_high_s16(c));
+        lo = vaddq_s32(lo, vshlq_n_s32(vaddl_s16(vget_low_s16(a.val[1]), vget_low_s16(b.val[1])), 2));
+        hi = vaddq_s32(hi, vshlq_n_s32(vaddl_s16(vget_high_s16(a.val[1]), vget_high_s16(b.val[1])), 2));
+        lo = vmlal_n_s16(lo, vget_low_s16(b.val[0]), 6);
+        hi = vmlal_n_s16(hi, vget_high_s16(b.val[0]), 6);
+        vst1q_s16(s + k, vcombine_s16(vrshrn_n_s32(lo, 4), vrshrn_n_s32(hi, 4)));
+    }
+#elif defined(PYRAMID_USE_SSE2)
+    for (; k + 8 < n; k += 8, p += 16) {
+        _mm_storeu_si128((__m128i *) (s + k), _mm_packs_epi32(Reduce4H(p), Reduce4H(p + 8)));
+    }
+#endif
+    return k;
+}
+
+// s[k] = 1 4 6 4 1 filter of p[k - 2 * pitch], ..., p[k + 2 * pitch]
+static int ReduceRowV(ImageTypeShortBase *s, const ImageTypeShortBase *p, int pitch, int n)
+{
+    int k = 0;
+#if defined(PYRAMID_USE_NEON)
+    for (; k + 8 <= n; k += 8, p += 8) {
+        int16x8_t m2 = vld1q_s16(p - 2 * pitch), m1 = vld1q_s16(p - pitch);
+        int16x8_t c = vld1q_s16(p);
+        int16x8_t p1 = vld1q_s16(p + pitch), p2 = vld1q_s16(p + 2 * pitch);
+        int32x4_t lo = vaddl_s16(vget_low_s16(m2), vget_low_s16(p2));
+        int32x4_t hi = vaddl_s16(vget_high_s16(m2), vget_high_s16(p2));
+        lo = vaddq_s32(lo, vshlq_n_s32(vaddl_s16(vget_low_s16(m1), vget_low_s16(p1)), 2));
+        hi = vaddq_s32(hi, vshlq_n_s32(vaddl_s16(vget_high_s16(m1), vget_high_s16(p1)), 2));
+        lo = vmlal_n_s16(lo, vget_low_s16(c), 6);
+        hi = vmlal_n_s16(hi, vget_high_s16(c), 6);
+        vst1q_s16(s + k, vcombine_s16(vrshrn_n_s32(lo, 4), vrshrn_n_s32(hi, 4)));
+    }
+#elif defined(PYRAMID_USE_SSE2)
+    const __m128i round = _mm_set1_epi32(8);
+    for (; k + 8 <= n; k += 8, p += 8) {
+        __m128i m2 = _mm_loadu_si128((const __m128i *) (p - 2 * pitch));
+        __m128i m1 = _mm_loadu_si128((const __m128i *) (p - pitch));
+        __m128i c = _mm_loadu_si128((const __m128i *) p);
+        __m128i p1 = _mm_loadu_si128((const __m128i *) (p + pitch));
+        __m128i p2 = _mm_loadu_si128((const __m128i *) (p + 2 * pitch));
+        __m128i lo = _mm_add_epi32(_mm_add_epi32(SignExtendLo(m2), SignExtendLo(p2)), round);
+        __m128i hi = _mm_add_epi32(_mm_add_epi32(SignExtendHi(m2), SignExtendHi(p2)), round);
+        lo = _mm_add_epi32(lo, _mm_slli_epi32(_mm_add_epi32(SignExtendLo(m1), SignExtendLo(p1)), 2));
+        hi = _mm_add_epi32(hi, _mm_slli_epi32(_mm_add_epi32(SignExtendHi(m1), SignExtendHi(p1)), 2));
+        lo = _mm_srai_epi32(_mm_add_epi32(lo, Times6(SignExtendLo(c))), 4);
+        hi = _mm_srai_epi32(_mm_add_epi32(hi, Times6(SignExtendHi(c))), 4);
+        _mm_storeu_si128((__m128i *) (s + k), _mm_packs_epi32(lo, hi));
+    }
+#endif
+    return k;
+}
+
+// even[k] = 1 6 1 filter of prev[k], cur[k], next[k]; odd[k] = 1 1 filter of
+// cur[k], next[k]
+static int ExpandRowV(ImageTypeShortBase *even, ImageTypeShortBase *odd,
+        const ImageTypeShortBase *prev, const ImageTypeShortBase *cur,
+        const ImageTypeShortBase *next, int n)
+{
+    int k = 0;
+#if defined(PYRAMID_USE_NEON)
+    for (; k + 8 <= n; k += 8) {
+        int16x8_t t0 = vld1q_s16(prev + k), t1 = vld1q_s16(cur + k), t2 = vld1q_s16(next + k);
+        int32x4_t lo = vmlal_n_s16(vaddl_s16(vget_low_s16(t0), vget_low_s16(t2)), vget_low_s16(t1), 6);
+        int32x4_t hi = vmlal_n_s16(vaddl_s16(vget_high_s16(t0), vget_high_s16(t2)), vget_high_s16(t1), 6);
+        vst1q_s16(even + k, vcombine_s16(vrshrn_n_s32(lo, 3), vrshrn_n_s32(hi, 3)));
+        vst1q_s16(odd + k, vrhaddq_s16(t1, t2));
+    }
+#elif defined(PYRAMID_USE_SSE2)
+    const __m128i four = _mm_set1_epi32(4), one = _mm_set1_epi32(1);
+    for (; k + 8 <= n; k += 8) {
+        __m128i t0 = _mm_loadu_si128((const __m128i *) (prev + k));
+        __m128i t1 = _mm_loadu_si128((const __m128i *) (cur + k));
+        __m128i t2 = _mm_loadu_si128((const __m128i *) (next + k));
+        __m128i c_lo = SignExtendLo(t1), c_hi = SignExtendHi(t1);
+        __m128i n_lo = SignExtendLo(t2), n_hi = SignExtendHi(t2);
+        __m128i lo = _mm_add_epi32(_mm_add_epi32(SignExtendLo(t0), n_lo), _mm_add_epi32(Times6(c_lo), four));
+        __m128i hi = _mm_add_epi32(_mm_add_epi32(SignExtendHi(t0), n_hi), _mm_add_epi32(Times6(c_hi), four));
+        _mm_storeu_si128((__m128i *) (even + k),
+                _mm_packs_epi32(_mm_srai_epi32(lo, 3), _mm_srai_epi32(hi, 3)));
+        lo = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(c_lo, n_lo), one), 1);
+        hi = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(c_hi, n_hi), one), 1);
+        _mm_storeu_si128((__m128i *) (odd + k), _mm_packs_epi32(lo, hi));
+    }
+#endif
+    return k;
+}
+
+// out[2k] += mode * 1 6 1 filter of s[k-1..k+1]; out[2k+1] += mode * 1 1
+// filter of s[k..k+1]. Only the expand (mode 1) and subtract (mode -1) cases
+// are vectorised.
+static int ExpandRowH(ImageTypeShortBase *out, const ImageTypeShortBase *s, int mode, int n)
+{
+    int k = 0;
+    if (mode != 1 && mode != -1)
+        return 0;
+#if defined(PYRAMID_USE_NEON)
+    for (; k + 8 <= n; k += 8) {
+        int16x8_t t0 = vld1q_s16(s + k - 1), t1 = vld1q_s16(s + k), t2 = vld1q_s16(s + k + 1);
+        int32x4_t lo = vmlal_n_s16(vaddl_s16(vget_low_s16(t0), vget_low_s16(t2)), vget_low_s16(t1), 6);
+        int32x4_t hi = vmlal_n_s16(vaddl_s16(vget_high_s16(t0), vget_high_s16(t2)), vget_high_s16(t1), 6);
+        int16x8_t even = vcombine_s16(vrshrn_n_s32(lo, 3), vrshrn_n_s32(hi, 3));
+        int16x8_t odd = vrhaddq_s16(t1, t2);
+        int16x8x2_t o = vld2q_s16(out + 2 * k);
+        if (mode > 0) {
+            o.val[0] = vaddq_s16(o.val[0], even);
+            o.val[1] = vaddq_s16(o.val[1], odd);
+        } else {
+            o.val[0] = vsubq_s16(o.val[0], even);
+            o.val[1] = vsubq_s16(o.val[1], odd);
+        }
+        vst2q_s16(out + 2 * k, o);
+    }
+#elif defined(PYRAMID_USE_SSE2)
+    const __m128i four = _mm_set1_epi32(4), one = _mm_set1_epi32(1);
+    for (; k + 8 <= n; k += 8) {
+        __m128i t0 = _mm_loadu_si128((const __m128i *) (s + k - 1));
+        __m128i t1 = _mm_loadu_si128((const __m128i *) (s + k));
+        __m128i t2 = _mm_loadu_si128((const __m128i *) (s + k + 1));
+        __m128i c_lo = SignExtendLo(t1), c_hi = SignExtendHi(t1);
+        __m128i n_lo = SignExtendLo(t2), n_hi = SignExtendHi(t2);
+        __m128i lo = _mm_add_epi32(_mm_add_epi32(SignExtendLo(t0), n_lo), _mm_add_epi32(Times6(c_lo), four));
+        __m128i hi = _mm_add_epi32(_mm_add_epi32(SignExtendHi(t0), n_hi), _mm_add_epi32(Times6(c_hi), four));
+        __m128i even = _mm_packs_epi32(_mm_srai_epi32(lo, 3), _mm_srai_epi32(hi, 3));
+        lo = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(c_lo, n_lo), one), 1);
+        hi = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(c_hi, n_hi), one), 1);
+        __m128i odd = _mm_packs_epi32(lo, hi);
+        __m128i *o = (__m128i *) (out + 2 * k);
+        __m128i o0 = _mm_loadu_si128(o), o1 = _mm_loadu_si128(o + 1);
+        if (mode > 0) {
+            o0 = _mm_add_epi16(o0, _mm_unpacklo_epi16(even, odd));
+            o1 = _mm_add_epi16(o1, _mm_unpackhi_epi16(even, odd));
+        } else {
+            o0 = _mm_sub_epi16(o0, _mm_unpacklo_epi16(even, odd));
+            o1 = _mm_sub_epi16(o1, _mm_unpackhi_epi16(even, odd));
+        }
+        _mm_storeu_si128(o, o0);
+        _mm_storeu_si128(o + 1, o1);
+    }
+#endif
+    return k;
+}
+
 // We allocate the entire pyramid into one contiguous storage. This makes
 // cleanup easier than fragmented stuff. In addition, we added a "pitch"
 // field, so pointer manipulation is much simpler when it would be faster.
@@ -155,7 +353,10 @@ void PyramidShort::BorderExpandOdd(PyramidShort *in, PyramidShort *out, PyramidS
     for (j = -off; j < in->height + off; j++) {
         int j2 = j * 2;
         int limit = scr->width + scr->border;
-        for (i = -scr->border; i < limit; i++) {
+        i = -scr->border;
+        i += ExpandRowV(scr->ptr[j2] + i, scr->ptr[j2+1] + i, in->ptr[j-1] + i,
+                in->ptr[j] + i, in->ptr[j+1] + i, limit - i);
+        for (; i < limit; i++) {
             int t1 = in->ptr[j][i];
             int t2 = in->ptr[j+1][i];
             scr->ptr[j2][i] = (short)
@@ -169,7 +370,9 @@ void PyramidShort::BorderExpandOdd(PyramidShort *in, PyramidShort *out, PyramidS
     // Horizontal Filter
     int limit = out->height + out->border;
     for (j = -out->border; j < limit; j++) {
-        for (i = -off; i < scr->width + off; i++) {
+        i = -off;
+        i += ExpandRowH(out->ptr[j] + 2 * i, scr->ptr[j] + i, mode, scr->width + off - i);
+        for (; i < scr->width + off; i++) {
             int i2 = i * 2;
             int t1 = scr->ptr[j][i];
             int t2 = scr->ptr[j][i+1];
@@ -224,7 +427,10 @@ void PyramidShort::BorderReduceOdd(PyramidShort *in, PyramidShort *out, PyramidS
 
     // treat it as if the whole thing were the image
     for (; s < ls; s = ns, ns += scr->pitch, p = np, np += in->pitch) {
-        for (int w = width; w--; s++, p += 2) {
+        int done = ReduceRowH(s, p, width);
+        s += done;
+        p += done << 1;
+        for (int w = width - done; w--; s++, p += 2) {
             *s = (short)((((int) p[-2]) + ((int) p[2]) + 8 +    // 1
                         ((((int) p[-1]) + ((int) p[1])) << 2) + // 4
                         ((int) *p) * 6) >> 4);          // 6
@@ -241,7 +447,10 @@ void PyramidShort::BorderReduceOdd(PyramidShort *in, PyramidShort *out, PyramidS
     int pitch2 = pitch << 1;
     np = p + pitch2;
     for (; s < ls; s = ns, ns += out->pitch, p = np, np += pitch2) {
-        for (int w = out->pitch; w--; s++, p++) {
+        int done = ReduceRowV(s, p, pitch, out->pitch);
+        s += done;
+        p += done;
+        for (int w = out->pitch - done; w--; s++, p++) {
             *s = (short)((((int) p[-pitch2]) + ((int) p[pitch2]) + 8 + // 1
                         ((((int) p[-pitch]) + ((int) p[pitch])) << 2) + // 4
                         ((int) *p) * 6) >> 4);              // 6
@@ -26,6 +26,11 @@
 #include <iostream>
 #endif
 #include <float.h>
+#if defined(DB_USE_NEON)
+#include <arm_neon.h>
+#elif defined(DB_USE_SSE2_INTRINSICS)
+#include <emmintrin.h>
+#endif
 
 #define DB_SUB_PIXEL
 
@@ -610,6 +615,158 @@ loopstart:
 #endif /*DB_USE_SIMD*/
 }
 
+#if defined(DB_USE_NEON) || defined(DB_USE_SSE2_INTRINSICS)
+/*Intrinsics versions of the Harris strength kernels. They give the same results
+as the C versions above, processing 8 or 4 columns at a time and finishing off
+the last few columns in C. Loads and stores are unaligned*/
+
+#ifdef DB_USE_NEON
+/*Store the 32 bit products of the 8 shorts in a and b at d*/
+inline void db_MulStore8_s16(int *d,int16x8_t a,int16x8_t b)
+{
+    vst1q_s32(d,vmull_s16(vget_low_s16(a),vget_low_s16(b)));
+    vst1q_s32(d+4,vmull_s16(vget_high_s16(a),vget_high_s16(b)));
+}
+#else
+inline void db_MulStore8_s16(int *d,__m128i a,__m128i b)
+{
+    __m128i lo,hi;
+
+    lo=_mm_mullo_epi16(a,b);
+    hi=_mm_mulhi_epi16(a,b);
+    _mm_storeu_si128((__m128i*)d,_mm_unpacklo_epi16(lo,hi));
+    _mm_storeu_si128((__m128i*)(d+4),_mm_unpackhi_epi16(lo,hi));
+}
+#endif /*DB_USE_NEON*/
+
+/*Same as db_IxIyRow_u*/
+inline void db_IxIyRow_u_v(int *dxx,const unsigned char * const *img,int i,int j,int nc)
+{
+    const unsigned char *pl,*pu,*pd;
+    int c;
+    int Ix,Iy;
+
+    pl=img[i]+j-1;
+    pu=img[i-1]+j;
+    pd=img[i+1]+j;
+    for(c=0;c+8<=nc;c+=8)
+    {
+#ifdef DB_USE_NEON
+        /*The wrapped around 16 bit differences reinterpreted as signed are exact*/
+        int16x8_t ix=vshrq_n_s16(vreinterpretq_s16_u16(vsubl_u8(vld1_u8(pl+c),vld1_u8(pl+c+2))),1);
+        int16x8_t iy=vshrq_n_s16(vreinterpretq_s16_u16(vsubl_u8(vld1_u8(pu+c),vld1_u8(pd+c))),1);
+#else
+        __m128i z=_mm_setzero_si128();
+        __m128i ix=_mm_srai_epi16(_mm_sub_epi16(
+            _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(pl+c)),z),
+            _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(pl+c+2)),z)),1);
+        __m128i iy=_mm_srai_epi16(_mm_sub_epi16(
+            _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(pu+c)),z),
+            _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(pd+c)),z)),1);
+#endif /*DB_USE_NEON*/
+        db_MulStore8_s16(dxx+c,ix,ix);
+        db_MulStore8_s16(dxx+c+128,ix,iy);
+        db_MulStore8_s16(dxx+c+256,iy,iy);
+    }
+    for(;c<nc;c++)
+    {
+        Ix=(img[i][j+c-1]-img[i][j+c+1])>>1;
+        Iy=(img[i-1][j+c]-img[i+1][j+c])>>1;
+        dxx[c]=Ix*Ix;
+        dxx[c+128]=Ix*Iy;
+        dxx[c+256]=Iy*Iy;
+    }
+}
+
+/*Same as db_gxx_gxy_gyy_row_s*/
+inline void db_gxx_gxy_gyy_row_v(int *g,int *d0,int *d1,int *d2,int *d3,int *d4,int nc)
+{
+    int b,c,e,dd;
+
+    for(b=0;b<384;b+=128)
+    {
+        for(c=b,e=b+nc;c+4<=e;c+=4)
+        {
+#ifdef DB_USE_NEON
+            int32x4_t v2=vld1q_s32(d2+c);
+            int32x4_t v=vaddq_s32(vld1q_s32(d0+c),vld1q_s32(d4+c));
+            v=vaddq_s32(v,vshlq_n_s32(vaddq_s32(vaddq_s32(vld1q_s32(d1+c),vld1q_s32(d3+c)),v2),2));
+            vst1q_s32(g+c,vaddq_s32(v,vshlq_n_s32(v2,1)));
+#else
+            __m128i v2=_mm_loadu_si128((const __m128i*)(d2+c));
+            __m128i v=_mm_add_epi32(_mm_loadu_si128((const __m128i*)(d0+c)),_mm_loadu_si128((const __m128i*)(d4+c)));
+            v=_mm_add_epi32(v,_mm_slli_epi32(_mm_add_epi32(_mm_add_epi32(
+                _mm_loadu_si128((const __m128i*)(d1+c)),_mm_loadu_si128((const __m128i*)(d3+c))),v2),2));
+            _mm_storeu_si128((__m128i*)(g+c),_mm_add_epi32(v,_mm_slli_epi32(v2,1)));
+#endif /*DB_USE_NEON*/
+        }
+        for(;c<e;c++)
+        {
+            dd=d2[c];
+            g[c]=d0[c]+(d1[c]<<2)+(dd<<2)+(dd<<1)+(d3[c]<<2)+d4[c];
+        }
+    }
+}
+
+#ifdef DB_USE_NEON
+/*Filter 14641 horizontally at g[c],...,g[c+3]*/
+inline float32x4_t db_Filter14641_4_v(const int *g)
+{
+    int32x4_t v2=vld1q_s32(g+2);
+    int32x4_t v=vaddq_s32(vld1q_s32(g),vld1q_s32(g+4));
+    v=vaddq_s32(v,vshlq_n_s32(vaddq_s32(vaddq_s32(vld1q_s32(g+1),vld1q_s32(g+3)),v2),2));
+    return(vcvtq_f32_s32(vaddq_s32(v,vshlq_n_s32(v2,1))));
+}
+#else
+inline __m128 db_Filter14641_4_v(const int *g)
+{
+    __m128i v2=_mm_loadu_si128((const __m128i*)(g+2));
+    __m128i v=_mm_add_epi32(_mm_loadu_si128((const __m128i*)g),_mm_loadu_si128((const __m128i*)(g+4)));
+    v=_mm_add_epi32(v,_mm_slli_epi32(_mm_add_epi32(_mm_add_epi32(
+        _mm_loadu_si128((const __m128i*)(g+1)),_mm_loadu_si128((const __m128i*)(g+3))),v2),2));
+    return(_mm_cvtepi32_ps(_mm_add_epi32(v,_mm_slli_epi32(v2,1))));
+}
+#endif /*DB_USE_NEON*/
+
+/*Same as db_HarrisStrength_row_s, except that gxx,gxy and gyy are left unfiltered*/
+inline void db_HarrisStrength_row_v(float *s,int *gxx,int *gxy,int *gyy,int nc)
+{
+    float k,Gxx,Gxy,Gyy,det,trc;
+    int c;
+
+    k=0.06f;
+    for(c=0;c+4<=nc-4;c+=4)
+    {
+        /*Same operations in the same order as in C, so that the results are the same*/
+#ifdef DB_USE_NEON
+        float32x4_t vxx=db_Filter14641_4_v(gxx+c);
+        float32x4_t vxy=db_Filter14641_4_v(gxy+c);
+        float32x4_t vyy=db_Filter14641_4_v(gyy+c);
+        float32x4_t vdet=vsubq_f32(vmulq_f32(vxx,vyy),vmulq_f32(vxy,vxy));
+        float32x4_t vtrc=vaddq_f32(vxx,vyy);
+        vst1q_f32(s+c,vsubq_f32(vdet,vmulq_f32(vmulq_n_f32(vtrc,k),vtrc)));
+#else
+        __m128 vxx=db_Filter14641_4_v(gxx+c);
+        __m128 vxy=db_Filter14641_4_v(gxy+c);
+        __m128 vyy=db_Filter14641_4_v(gyy+c);
+        __m128 vdet=_mm_sub_ps(_mm_mul_ps(vxx,vyy),_mm_mul_ps(vxy,vxy));
+        __m128 vtrc=_mm_add_ps(vxx,vyy);
+        _mm_storeu_ps(s+c,_mm_sub_ps(vdet,_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(k),vtrc),vtrc)));
+#endif /*DB_USE_NEON*/
+    }
+    for(;c<nc-4;c++)
+    {
+        Gxx=(float)(gxx[c]+(gxx[c+1]<<2)+(gxx[c+2]<<2)+(gxx[c+2]<<1)+(gxx[c+3]<<2)+gxx[c+4]);
+        Gxy=(float)(gxy[c]+(gxy[c+1]<<2)+(gxy[c+2]<<2)+(gxy[c+2]<<1)+(gxy[c+3]<<2)+gxy[c+4]);
+        Gyy=(float)(gyy[c]+(gyy[c+1]<<2)+(gyy[c+2]<<2)+(gyy[c+2]<<1)+(gyy[c+3]<<2)+gyy[c+4]);
+
+        det=Gxx*Gyy-Gxy*Gxy;
+        trc=Gxx+Gyy;
+        s[c]=det-k*trc*trc;
+    }
+}
+#endif /*DB_USE_NEON || DB_USE_SSE2_INTRINSICS*/
+
 /*Compute the Harris corner strength of the chunk [left,top,right,bottom] of img and
 store it into the corresponding region of s. left and top have to be at least 3 and
 right and bottom have to be at most width-4,height-4*/
@@ -655,11 +812,11 @@ inline void db_HarrisStrengthChunk_f(float **s,const float * const *img,int left
 /*Compute the Harris corner strength of the chunk [left,top,left+123,bottom] of img and
 store it into the corresponding region of s. left and top have to be at least 3 and
 right and bottom have to be at most width-4,height-4. The left of the region in s should
-be 16 byte aligned*/
+be 16 byte aligned. If simd is set the intrinsics kernels are used*/
 inline void db_HarrisStrengthChunk_u(float **s,const unsigned char * const *img,int left,int top,int bottom,
                                       /*temp should point to at least
                                       18*128 of allocated memory*/
-                                      int *temp, int nc)
+                                      int *temp, int nc, bool simd)
 {
     int *Ixx[5],*Ixy[5],*Iyy[5];
     int *gxx,*gxy,*gyy;
@@ -675,6 +832,21 @@ inline void db_HarrisStrengthChunk_u(float **s,const unsigned char * const *img,
         Iyy[i]=gyy+(3*i+3)*128;
     }
 
+#if defined(DB_USE_NEON) || defined(DB_USE_SSE2_INTRINSICS)
+    if(simd)
+    {
+        for(i=top-2;i<top+2;i++) db_IxIyRow_u_v(Ixx[i%5],img,i,left-2,nc);
+
+        for(i=top;i<=bottom;i++)
+        {
+            db_IxIyRow_u_v(Ixx[(i+2)%5],img,(i+2),left-2,nc);
+            db_gxx_gxy_gyy_row_v(gxx,Ixx[(i-2)%5],Ixx[(i-1)%5],Ixx[i%5],Ixx[(i+1)%5],Ixx[(i+2)%5],nc);
+            db_HarrisStrength_row_v(s[i]+left,gxx,gxy,gyy,nc);
+        }
+        return;
+    }
+#endif /*DB_USE_NEON || DB_USE_SSE2_INTRINSICS*/
+
     /*Fill four rows of the wrap-around derivative buffers*/
     for(i=top-2;i<top+2;i++) db_IxIyRow_u(Ixx[i%5],img,i,left-2,nc);
 
@@ -716,15 +888,12 @@ void db_HarrisStrength_f(float **s,const float * const *img,int w,int h,
     }
 }
 
-/*Compute Harris corner strength of img. Strength is returned for the region
-with (3,3) as upper left and (w-4,h-4) as lower right, positioned in the
-same place in s. In other words,image should be at least 7 pixels wide and 7 pixels high
-for a meaningful result.Moreover, the image should be overallocated by 256 bytes.
-s[i][3] should by 16 byte aligned for any i*/
-void db_HarrisStrength_u(float **s, const unsigned char * const *img,int w,int h,
+/*Compute Harris corner strength of the rows top to bottom of img, in the columns
+3 to w-4. top has to be at least 3 and bottom at most h-4. See db_HarrisStrength_u*/
+void db_HarrisStrengthRows_u(float **s, const unsigned char * const *img,int w,int top,int bottom,
                                     /*temp should point to at least
                                     18*128 of allocated memory*/
-                                    int *temp)
+                                    int *temp,bool simd)
 {
     int x,next_x,last;
     int nc;
@@ -739,10 +908,23 @@ void db_HarrisStrength_u(float **s, const unsigned char * const *img,int w,int h
         //nc = 128;
 
         /*Compute the Harris strength of a chunk*/
-        db_HarrisStrengthChunk_u(s,img,x,3,h-4,temp,nc);
+        db_HarrisStrengthChunk_u(s,img,x,top,bottom,temp,nc,simd);
     }
 }
 
+/*Compute Harris corner strength of img. Strength is returned for the region
+with (3,3) as upper left and (w-4,h-4) as lower right, positioned in the
+same place in s. In other words,image should be at least 7 pixels wide and 7 pixels high
+for a meaningful result.Moreover, the image should be overallocated by 256 bytes.
+s[i][3] should by 16 byte aligned for any i*/
+void db_HarrisStrength_u(float **s, const unsigned char * const *img,int w,int h,
+                                    /*temp should point to at least
+                                    18*128 of allocated memory*/
+                                    int *temp)
+{
+    db_HarrisStrengthRows_u(s,img,w,3,h-4,temp,db_UseSimd());
+}
+
 inline float db_Max_128Aligned16_f(float *v)
 {
 #ifdef DB_USE_SIMD
@@ -1073,6 +1255,51 @@ float db_MaxImage_Aligned16_f(float **img,int left,int top,int w,int h)
     return(0.0);
 }
 
+#if defined(DB_USE_NEON) || defined(DB_USE_SSE2_INTRINSICS)
+/*Same as db_MaxImage_Aligned16_f, but without the alignment requirement*/
+float db_MaxImage_v(float **img,int left,int top,int w,int h)
+{
+    float val,max_val;
+    const float *v;
+    int i,c,stop_i;
+
+    if(w && h)
+    {
+        stop_i=top+h;
+        max_val=img[top][left];
+
+        for(i=top;i<stop_i;i++)
+        {
+            v=img[i]+left;
+            c=0;
+            if(w>=4)
+            {
+#ifdef DB_USE_NEON
+                float32x4_t m=vld1q_f32(v);
+                float32x2_t m2;
+                for(c=4;c+4<=w;c+=4) m=vmaxq_f32(m,vld1q_f32(v+c));
+                m2=vpmax_f32(vget_low_f32(m),vget_high_f32(m));
+                val=vget_lane_f32(vpmax_f32(m2,m2),0);
+#else
+                __m128 m=_mm_loadu_ps(v);
+                for(c=4;c+4<=w;c+=4) m=_mm_max_ps(m,_mm_loadu_ps(v+c));
+                m=_mm_max_ps(m,_mm_movehl_ps(m,m));
+                val=_mm_cvtss_f32(_mm_max_ss(m,_mm_shuffle_ps(m,m,1)));
+#endif /*DB_USE_NEON*/
+                if(val>max_val) max_val=val;
+            }
+            for(;c<w;c++)
+            {
+                val=v[c];
+                if(val>max_val) max_val=val;
+            }
+        }
+        return(max_val);
+    }
+    return(0.0);
+}
+#endif /*DB_USE_NEON || DB_USE_SSE2_INTRINSICS*/
+
 inline void db_MaxVector_128_Aligned16_f(float *m,float *v1,float *v2)
 {
 #ifdef DB_USE_SIMD
@@ -1447,6 +1674,59 @@ inline int db_CornersFromChunk(float **strength,int left,int top,int right,int b
     return(nr);
 }
 
+#if defined(DB_USE_NEON) || defined(DB_USE_SSE2_INTRINSICS)
+/*Same as db_CornersFromChunk. Four pixels are tested at a time, the ones
+below the threshold first so that the 5x5 neighbourhood is usually skipped*/
+inline int db_CornersFromChunk_v(float **strength,int left,int top,int right,int bottom,float threshold,double *x_temp,double *y_temp,double *s_temp)
+{
+    int i,j,k,di,dj,nr;
+    const float *row;
+    unsigned int lanes[4];
+
+    nr=0;
+    for(i=top;i<=bottom;i++)
+    {
+        row=strength[i];
+        for(j=left;j+3<=right;j+=4)
+        {
+#ifdef DB_USE_NEON
+            float32x4_t sv=vld1q_f32(row+j);
+            uint32x4_t m=vcgeq_f32(sv,vdupq_n_f32(threshold));
+            uint32x2_t any=vorr_u32(vget_low_u32(m),vget_high_u32(m));
+            if(!(vget_lane_u32(any,0)|vget_lane_u32(any,1))) continue;
+
+            for(di= -2;di<=2;di++) for(dj= -2;dj<=2;dj++)
+            {
+                if(di || dj) m=vandq_u32(m,vcgtq_f32(sv,vld1q_f32(strength[i+di]+j+dj)));
+            }
+            vst1q_u32(lanes,m);
+#else
+            __m128 sv=_mm_loadu_ps(row+j);
+            __m128 m=_mm_cmpge_ps(sv,_mm_set1_ps(threshold));
+            int mask;
+            if(!_mm_movemask_ps(m)) continue;
+
+            for(di= -2;di<=2;di++) for(dj= -2;dj<=2;dj++)
+            {
+                if(di || dj) m=_mm_and_ps(m,_mm_cmpgt_ps(sv,_mm_loadu_ps(strength[i+di]+j+dj)));
+            }
+            mask=_mm_movemask_ps(m);
+            for(k=0;k<4;k++) lanes[k]=(mask>>k)&1;
+#endif /*DB_USE_NEON*/
+            for(k=0;k<4;k++) if(lanes[k])
+            {
+                x_temp[nr]=(double) (j+k);
+                y_temp[nr]=(double) i;
+                s_temp[nr]=(double) row[j+k];
+                nr++;
+            }
+        }
+        /*Rest of the row*/
+        if(j<=right) nr+=db_CornersFromChunk(strength,j,i,right,i,threshold,x_temp+nr,y_temp+nr,s_temp+nr);
+    }
+    return(nr);
+}
+#endif /*DB_USE_NEON || DB_USE_SSE2_INTRINSICS*/
 
 //Sub-pixel accuracy using 2D quadratic interpolation.(YCJ)
 inline void db_SubPixel(float **strength, const double xd, const double yd, double &xs, double &ys)
@@ -1492,11 +1772,12 @@ inline void db_SubPixel(float **strength, const double xd, const double yd, doub
 /*Extract corners from the image part from (left,top) to (right,bottom).
 Store in x and y, extracting at most satnr corners in each block of size (bw,bh).
 The pointer temp_d should point to at least 5*bw*bh positions.
-area_factor holds how many corners max to extract per 10000 pixels*/
+area_factor holds how many corners max to extract per 10000 pixels.
+If simd is set the intrinsics kernels are used*/
 void db_ExtractCornersSaturated(float **strength,int left,int top,int right,int bottom,
                                 int bw,int bh,unsigned long area_factor,
                                 float threshold,double *temp_d,
-                                double *x_coord,double *y_coord,int *nr_corners)
+                                double *x_coord,double *y_coord,int *nr_corners,bool simd)
 {
     double *x_temp,*y_temp,*s_temp,*select_temp;
     double loc_thresh;
@@ -1534,7 +1815,12 @@ void db_ExtractCornersSaturated(float **strength,int left,int top,int right,int
 
             area=(last_x-x+1)*(last_y-y+1);
             saturation=(area*area_factor)/10000;
+#if defined(DB_USE_NEON) || defined(DB_USE_SSE2_INTRINSICS)
+            if(simd) nr=db_CornersFromChunk_v(strength,x,y,last_x,last_y,threshold,x_temp,y_temp,s_temp);
+            else nr=db_CornersFromChunk(strength,x,y,last_x,last_y,threshold,x_temp,y_temp,s_temp);
+#else
             nr=db_CornersFromChunk(strength,x,y,last_x,last_y,threshold,x_temp,y_temp,s_temp);
+#endif /*DB_USE_NEON || DB_USE_SSE2_INTRINSICS*/
             if(nr)
             {
                 if(((unsigned long)nr)>saturation) loc_thresh=db_LeanQuickSelect(s_temp,nr,nr-saturation,select_temp);
@@ -1640,12 +1926,57 @@ void db_CornerDetector_f::DetectCorners(const float * const *img,double *x_coord
     else threshold= (float) m_a_thresh;
 
     db_ExtractCornersSaturated(m_strength,BORDER,BORDER,m_w-BORDER-1,m_h-BORDER-1,m_bw,m_bh,m_area_factor,threshold,
-        m_temp_d,x_coord,y_coord,nr_corners);
+        m_temp_d,x_coord,y_coord,nr_corners,db_UseSimd());
+}
+
+/*Harris strength computation of db_CornerDetector_u::DetectCorners, shared out
+over nr_threads bands of rows*/
+class db_HarrisStrengthJob_u
+{
+public:
+    float **s;
+    const unsigned char * const *img;
+    int w,h;
+    /*18*128 ints for each thread*/
+    int *temp;
+    int nr_threads;
+    bool simd;
+    /*Whether to find the maximum strength of each band*/
+    bool find_max;
+    float max_val[DB_MAX_NR_THREADS];
+    bool has_max[DB_MAX_NR_THREADS];
+};
+
+/*Compute the Harris strength, and its maximum if asked for, of band t*/
+void db_HarrisStrengthBand_u(void *arg,int t)
+{
+    db_HarrisStrengthJob_u *job=(db_HarrisStrengthJob_u*) arg;
+    int rows,top,bottom;
+
+    rows=job->h-6;
+    top=3+(t*rows)/job->nr_threads;
+    bottom=2+((t+1)*rows)/job->nr_threads;
+    job->has_max[t]=false;
+    if(bottom<top) return;
+
+    db_HarrisStrengthRows_u(job->s,job->img,job->w,top,bottom,job->temp+t*18*128,job->simd);
+
+    if(job->find_max)
+    {
+#if defined(DB_USE_NEON) || defined(DB_USE_SSE2_INTRINSICS)
+        if(job->simd) job->max_val[t]=db_MaxImage_v(job->s,3,top,job->w-6,bottom-top+1);
+        else job->max_val[t]=db_MaxImage_Aligned16_f(job->s,3,top,job->w-6,bottom-top+1);
+#else
+        job->max_val[t]=db_MaxImage_Aligned16_f(job->s,3,top,job->w-6,bottom-top+1);
+#endif /*DB_USE_NEON || DB_USE_SSE2_INTRINSICS*/
+        job->has_max[t]=true;
+    }
 }
 
 db_CornerDetector_u::db_CornerDetector_u()
 {
     m_w=0; m_h=0;
+    m_nr_threads=DB_DEFAULT_NR_THREADS;
 }
 
 db_CornerDetector_u::~db_CornerDetector_u()
@@ -1655,6 +1986,8 @@ db_CornerDetector_u::~db_CornerDetector_u()
 
 db_CornerDetector_u::db_CornerDetector_u(const db_CornerDetector_u& cd)
 {
+    m_w=0; m_h=0;
+    m_nr_threads=cd.m_nr_threads;
     Start(cd.m_w, cd.m_h, cd.m_bw, cd.m_bh, cd.m_area_factor,
         cd.m_a_thresh, cd.m_r_thresh);
 }
@@ -1665,6 +1998,7 @@ db_CornerDetector_u& db_CornerDetector_u::operator=(const db_CornerDetector_u& c
 
     Clean();
 
+    m_nr_threads=cd.m_nr_threads;
     Start(cd.m_w, cd.m_h, cd.m_bw, cd.m_bh, cd.m_area_factor,
         cd.m_a_thresh, cd.m_r_thresh);
 
@@ -1717,30 +2051,64 @@ unsigned long db_CornerDetector_u::Start(int im_width,int im_height,
     m_a_thresh=absolute_threshold;
     m_max_nr=db_maxl(1,1+(m_w*m_h*m_area_factor)/10000);
 
-    m_temp_i=new int[18*128];
+    m_temp_i=new int[m_nr_threads*18*128];
     m_temp_d=new double[5*m_bw*m_bh];
     m_strength=db_AllocStrengthImage_f(&m_strength_mem,m_w,m_h);
 
     return(m_max_nr);
 }
 
+void db_CornerDetector_u::SetNrThreads(int nr_threads)
+{
+    nr_threads=db_maxi(1,db_mini(nr_threads,DB_MAX_NR_THREADS));
+    if(nr_threads==m_nr_threads) return;
+
+    m_nr_threads=nr_threads;
+    if(m_w!=0)
+    {
+        delete [] m_temp_i;
+        m_temp_i=new int[m_nr_threads*18*128];
+    }
+}
+
 void db_CornerDetector_u::DetectCorners(const unsigned char * const *img,double *x_coord,double *y_coord,int *nr_corners,
                                         const unsigned char * const *msk, unsigned char fgnd) const
 {
     float max_val,threshold;
+    db_HarrisStrengthJob_u job;
+    bool found;
+    int t;
 
-    db_HarrisStrength_u(m_strength,img,m_w,m_h,m_temp_i);
+    job.s=m_strength;
+    job.img=img;
+    job.w=m_w;
+    job.h=m_h;
+    job.temp=m_temp_i;
+    job.nr_threads=m_nr_threads;
+    job.simd=db_UseSimd();
+    job.find_max=(m_r_thresh!=0);
+    db_RunThreads(db_HarrisStrengthBand_u,&job,m_nr_threads);
 
 
     if(m_r_thresh)
     {
-        max_val=db_MaxImage_Aligned16_f(m_strength,3,3,m_w-6,m_h-6);
+        /*Same as the maximum over all bands in one go*/
+        max_val=0.0;
+        found=false;
+        for(t=0;t<m_nr_threads;t++)
+        {
+            if(job.has_max[t] && (!found || job.max_val[t]>max_val))
+            {
+                max_val=job.max_val[t];
+                found=true;
+            }
+        }
         threshold= (float) db_maxd(m_a_thresh,max_val*m_r_thresh);
     }
     else threshold= (float) m_a_thresh;
 
     db_ExtractCornersSaturated(m_strength,BORDER,BORDER,m_w-BORDER-1,m_h-BORDER-1,m_bw,m_bh,m_area_factor,threshold,
-        m_temp_d,x_coord,y_coord,nr_corners);
+        m_temp_d,x_coord,y_coord,nr_corners,job.simd);
 
 
     if ( msk )
@@ -1765,6 +2133,6 @@ void db_CornerDetector_u::DetectCorners(const unsigned char * const *img,double
 void db_CornerDetector_u::ExtractCorners(float ** strength, double *x_coord, double *y_coord, int *nr_corners) {
     if ( m_w!=0 )
         db_ExtractCornersSaturated(strength,BORDER,BORDER,m_w-BORDER-1,m_h-BORDER-1,m_bw,m_bh,m_area_factor,float(m_a_thresh),
-            m_temp_d,x_coord,y_coord,nr_corners);
+            m_temp_d,x_coord,y_coord,nr_corners,db_UseSimd());
 }
 
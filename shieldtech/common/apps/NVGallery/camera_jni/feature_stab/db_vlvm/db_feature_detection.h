@@ -150,6 +150,17 @@ public:
      */
     virtual void SetRelativeThreshold(double r_thresh) { m_r_thresh = r_thresh; };
 
+    /*!
+     Set the number of threads DetectCorners() computes the corner strength
+     with, each on a band of image rows. The corners found do not depend on it.
+     \param nr_threads  number of threads, from 1 (default) to DB_MAX_NR_THREADS
+     */
+    virtual void SetNrThreads(int nr_threads);
+    /*!
+     Get the number of threads set with SetNrThreads()
+     */
+    int GetNrThreads() const { return m_nr_threads; };
+
     /*!
      Extract corners from a pre-computed strength image.
      \param strength    Harris strength image
@@ -171,6 +182,7 @@ protected:
     per 10000 pixels*/
     unsigned long m_area_factor,m_max_nr;
     double m_a_thresh,m_r_thresh;
+    int m_nr_threads;
     int *m_temp_i;
     double *m_temp_d;
     float **m_strength,*m_strength_mem;
@@ -25,6 +25,11 @@
 #ifdef _VERBOSE_
 #include <iostream>
 #endif
+#if defined(DB_USE_NEON)
+#include <arm_neon.h>
+#elif defined(DB_USE_SSE2_INTRINSICS)
+#include <emmintrin.h>
+#endif
 
 
 int AffineWarpPoint_NN_LUT_x[11][11];
@@ -645,7 +650,7 @@ inline void db_SignedSquareNormCorr21x21_PreAlign_u(short *patch,const unsigned
         }
     }
 
-    for(int i=442; i<512; i++)
+    for(int i=441; i<512; i++)
         (*patch++)=0;
 
     *sum= (float) fsum;
@@ -1297,6 +1302,68 @@ float db_SignedSquareNormCorr5x5Aligned_Post_s(const short *f_patch,const short
     return(-fg_corr*fg_corr*f_recip_g_recip);
 }
 
+#if defined(DB_USE_NEON) || defined(DB_USE_SSE2_INTRINSICS)
+/*Scalar product of the n element patches f and g, n a multiple of 16.
+Same as db_ScalarProduct32_s, db_ScalarProduct128_s and db_ScalarProduct512_s*/
+inline int db_ScalarProduct_v(const short *f,const short *g,int n)
+{
+    int c;
+#ifdef DB_USE_NEON
+    int16x8_t f0,g0,f1,g1;
+    int32x4_t acc0,acc1;
+    int32x2_t sum;
+
+    acc0=vdupq_n_s32(0);
+    acc1=vdupq_n_s32(0);
+    for(c=0;c<n;c+=16)
+    {
+        f0=vld1q_s16(f+c);
+        g0=vld1q_s16(g+c);
+        f1=vld1q_s16(f+c+8);
+        g1=vld1q_s16(g+c+8);
+        acc0=vmlal_s16(acc0,vget_low_s16(f0),vget_low_s16(g0));
+        acc1=vmlal_s16(acc1,vget_high_s16(f0),vget_high_s16(g0));
+        acc0=vmlal_s16(acc0,vget_low_s16(f1),vget_low_s16(g1));
+        acc1=vmlal_s16(acc1,vget_high_s16(f1),vget_high_s16(g1));
+    }
+    acc0=vaddq_s32(acc0,acc1);
+    sum=vadd_s32(vget_low_s32(acc0),vget_high_s32(acc0));
+    return(vget_lane_s32(vpadd_s32(sum,sum),0));
+#else
+    __m128i acc0,acc1;
+
+    acc0=_mm_setzero_si128();
+    acc1=_mm_setzero_si128();
+    for(c=0;c<n;c+=16)
+    {
+        acc0=_mm_add_epi32(acc0,_mm_madd_epi16(_mm_loadu_si128((const __m128i*)(f+c)),
+            _mm_loadu_si128((const __m128i*)(g+c))));
+        acc1=_mm_add_epi32(acc1,_mm_madd_epi16(_mm_loadu_si128((const __m128i*)(f+c+8)),
+            _mm_loadu_si128((const __m128i*)(g+c+8))));
+    }
+    acc0=_mm_add_epi32(acc0,acc1);
+    acc0=_mm_add_epi32(acc0,_mm_shuffle_epi32(acc0,_MM_SHUFFLE(1,0,3,2)));
+    acc0=_mm_add_epi32(acc0,_mm_shuffle_epi32(acc0,_MM_SHUFFLE(2,3,0,1)));
+    return(_mm_cvtsi128_si32(acc0));
+#endif /*DB_USE_NEON*/
+}
+
+/*Same as db_SignedSquareNormCorr5x5Aligned_Post_s, db_SignedSquareNormCorr11x11Aligned_Post_s
+and db_SignedSquareNormCorr21x21Aligned_Post_s for patch lengths n of 32, 128 and 512 and
+window areas of 25, 121 and 441*/
+inline float db_SignedSquareNormCorrAligned_Post_v(const short *f_patch,const short *g_patch,int n,float area,
+                                                   float fsum_gsum,float f_recip_g_recip)
+{
+    float fgsum,fg_corr;
+
+    fgsum= (float) db_ScalarProduct_v(f_patch,g_patch,n);
+
+    fg_corr=area*fgsum-fsum_gsum;
+    if(fg_corr>=0.0) return(fg_corr*fg_corr*f_recip_g_recip);
+    return(-fg_corr*fg_corr*f_recip_g_recip);
+}
+#endif /*DB_USE_NEON || DB_USE_SSE2_INTRINSICS*/
+
 
 inline float db_SignedSquareNormCorr15x15_u(unsigned char **f_img,unsigned char **g_img,int x_f,int y_f,int x_g,int y_g)
 {
@@ -2961,11 +3028,18 @@ inline void db_MatchPointPair_f(db_PointInfo_f *pir_l,db_PointInfo_f *pir_r,
     }
 }
 
-inline void db_MatchPointPair_u(db_PointInfo_u *pir_l,db_PointInfo_u *pir_r,
-                            unsigned long kA,unsigned long kB, unsigned int rect_window,bool use_smaller_matching_window, int use_21)
+/*Index of the right points of bucket (a,b) in a table of best matches*/
+inline int db_MatchBestIndex(int a,int b,int nr_h,int bd)
+{
+    return(((a+1)*(nr_h+2)+(b+1))*bd);
+}
+
+/*Compute the match score of pir_l and pir_r into score if they are within the maximum
+disparity of each other. Return whether they are*/
+inline bool db_MatchScore_u(db_PointInfo_u *pir_l,db_PointInfo_u *pir_r,double &score,
+                            unsigned long kA,unsigned long kB, unsigned int rect_window,bool use_smaller_matching_window, int use_21, bool simd)
 {
     int xm,ym;
-    double score;
     bool compute_score;
 
 
@@ -2983,6 +3057,25 @@ inline void db_MatchPointPair_u(db_PointInfo_u *pir_l,db_PointInfo_u *pir_r,
 
     if ( compute_score )
     {
+#if defined(DB_USE_NEON) || defined(DB_USE_SSE2_INTRINSICS)
+        if(simd)
+        {
+            if(use_21)
+                score=db_SignedSquareNormCorrAligned_Post_v(pir_l->patch,pir_r->patch,512,441.0f,
+                    (pir_l->sum)*(pir_r->sum),
+                    (pir_l->recip)*(pir_r->recip));
+            else if(!use_smaller_matching_window)
+                score=db_SignedSquareNormCorrAligned_Post_v(pir_l->patch,pir_r->patch,128,121.0f,
+                    (pir_l->sum)*(pir_r->sum),
+                    (pir_l->recip)*(pir_r->recip));
+            else
+                score=db_SignedSquareNormCorrAligned_Post_v(pir_l->patch,pir_r->patch,32,25.0f,
+                    (pir_l->sum)*(pir_r->sum),
+                    (pir_l->recip)*(pir_r->recip));
+            return(true);
+        }
+#endif /*DB_USE_NEON || DB_USE_SSE2_INTRINSICS*/
+
         if(use_21)
         {
             score=db_SignedSquareNormCorr21x21Aligned_Post_s(pir_l->patch,pir_r->patch,
@@ -3005,7 +3098,17 @@ inline void db_MatchPointPair_u(db_PointInfo_u *pir_l,db_PointInfo_u *pir_r,
                 (pir_l->recip)*(pir_r->recip));
         }
         }
+    }
+    return(compute_score);
+}
+
+inline void db_MatchPointPair_u(db_PointInfo_u *pir_l,db_PointInfo_u *pir_r,
+                            unsigned long kA,unsigned long kB, unsigned int rect_window,bool use_smaller_matching_window, int use_21, bool simd)
+{
+    double score;
 
+    if ( db_MatchScore_u(pir_l,pir_r,score,kA,kB,rect_window,use_smaller_matching_window,use_21,simd) )
+    {
         if((!(pir_l->pir)) || (score>pir_l->s))
         {
             /*Update left corner*/
@@ -3033,7 +3136,7 @@ inline void db_MatchPointAgainstBucket_f(db_PointInfo_f *pir_l,db_Bucket_f *b_r,
 }
 
 inline void db_MatchPointAgainstBucket_u(db_PointInfo_u *pir_l,db_Bucket_u *b_r,
-                                       unsigned long kA,unsigned long kB,int rect_window, bool use_smaller_matching_window, int use_21)
+                                       unsigned long kA,unsigned long kB,int rect_window, bool use_smaller_matching_window, int use_21, bool simd)
 {
     int p_r,nr;
     db_PointInfo_u *pir_r;
@@ -3041,10 +3144,40 @@ inline void db_MatchPointAgainstBucket_u(db_PointInfo_u *pir_l,db_Bucket_u *b_r,
     nr=b_r->nr;
     pir_r=b_r->ptr;
 
-    for(p_r=0;p_r<nr;p_r++) db_MatchPointPair_u(pir_l,pir_r+p_r,kA,kB, rect_window, use_smaller_matching_window, use_21);
+    for(p_r=0;p_r<nr;p_r++) db_MatchPointPair_u(pir_l,pir_r+p_r,kA,kB, rect_window, use_smaller_matching_window, use_21, simd);
 
 }
 
+/*Same as db_MatchPointAgainstBucket_u, except that the best matches of the right
+points are kept in best rather than in the points*/
+inline void db_MatchPointAgainstBucketLocal_u(db_PointInfo_u *pir_l,db_Bucket_u *b_r,db_MatchBest_u *best,
+                                       unsigned long kA,unsigned long kB,int rect_window, bool use_smaller_matching_window, int use_21, bool simd)
+{
+    int p_r,nr;
+    db_PointInfo_u *pir_r;
+    double score;
+
+    nr=b_r->nr;
+    pir_r=b_r->ptr;
+
+    for(p_r=0;p_r<nr;p_r++)
+    {
+        if ( db_MatchScore_u(pir_l,pir_r+p_r,score,kA,kB,rect_window,use_smaller_matching_window,use_21,simd) )
+        {
+            if((!(pir_l->pir)) || (score>pir_l->s))
+            {
+                pir_l->s=score;
+                pir_l->pir=pir_r+p_r;
+            }
+            if((!(best[p_r].pir)) || (score>best[p_r].s))
+            {
+                best[p_r].s=score;
+                best[p_r].pir=pir_l;
+            }
+        }
+    }
+}
+
 void db_MatchBuckets_f(db_Bucket_f **bp_l,db_Bucket_f **bp_r,int nr_h,int nr_v,
                      unsigned long kA,unsigned long kB)
 {
@@ -3072,15 +3205,18 @@ void db_MatchBuckets_f(db_Bucket_f **bp_l,db_Bucket_f **bp_r,int nr_h,int nr_v,
     }
 }
 
-void db_MatchBuckets_u(db_Bucket_u **bp_l,db_Bucket_u **bp_r,int nr_h,int nr_v,
-                     unsigned long kA,unsigned long kB,int rect_window,bool use_smaller_matching_window, int use_21)
+/*Match the points in the rows of buckets from top to bottom of bp_l. If best is
+not 0 the best matches of the right points are kept there, at the index returned
+by db_MatchBestIndex, rather than in the points*/
+void db_MatchBucketRows_u(db_Bucket_u **bp_l,db_Bucket_u **bp_r,int nr_h,int top,int bottom,int bd,db_MatchBest_u *best,
+                     unsigned long kA,unsigned long kB,int rect_window,bool use_smaller_matching_window, int use_21, bool simd)
 {
     int i,j,k,a,b,br_nr;
     db_Bucket_u *br;
     db_PointInfo_u *pir_l;
 
     /*For all buckets*/
-    for(i=0;i<nr_v;i++) for(j=0;j<nr_h;j++)
+    for(i=top;i<=bottom;i++) for(j=0;j<nr_h;j++)
     {
         br=&bp_l[i][j];
         br_nr=br->nr;
@@ -3092,7 +3228,106 @@ void db_MatchBuckets_u(db_Bucket_u **bp_l,db_Bucket_u **bp_r,int nr_h,int nr_v,
             {
                 for(b=j-1;b<=j+1;b++)
                 {
-                    db_MatchPointAgainstBucket_u(pir_l,&bp_r[a][b],kA,kB,rect_window,use_smaller_matching_window, use_21);
+                    if(best) db_MatchPointAgainstBucketLocal_u(pir_l,&bp_r[a][b],best+db_MatchBestIndex(a,b,nr_h,bd),
+                        kA,kB,rect_window,use_smaller_matching_window,use_21,simd);
+                    else db_MatchPointAgainstBucket_u(pir_l,&bp_r[a][b],kA,kB,rect_window,use_smaller_matching_window, use_21, simd);
+                }
+            }
+        }
+    }
+}
+
+void db_MatchBuckets_u(db_Bucket_u **bp_l,db_Bucket_u **bp_r,int nr_h,int nr_v,
+                     unsigned long kA,unsigned long kB,int rect_window,bool use_smaller_matching_window, int use_21)
+{
+    db_MatchBucketRows_u(bp_l,bp_r,nr_h,0,nr_v-1,0,0,kA,kB,rect_window,use_smaller_matching_window,use_21,db_UseSimd());
+}
+
+/*db_MatchBuckets_u shared out over nr_threads bands of bucket rows of bp_l. A left point
+is only matched by the thread of its band, but the right points are matched by up to
+three threads. Threads other than the first keep their best matches of the right points
+in a table of their own, which are merged in thread order afterwards. This gives the same
+matches as matching all bands in turn on one thread*/
+class db_MatchBucketsJob_u
+{
+public:
+    db_Bucket_u **bp_l,**bp_r;
+    int nr_h,nr_v,bd;
+    unsigned long kA,kB;
+    int rect_window;
+    bool use_smaller_matching_window;
+    int use_21;
+    bool simd;
+    int nr_threads;
+    /*(nr_h+2)*(nr_v+2)*bd entries for each thread but the first*/
+    db_MatchBest_u *best;
+};
+
+void db_MatchBucketsBand_u(void *arg,int t)
+{
+    db_MatchBucketsJob_u *job=(db_MatchBucketsJob_u*) arg;
+    db_MatchBest_u *best;
+    int top,bottom,a,b,k,nr;
+
+    top=(t*job->nr_v)/job->nr_threads;
+    bottom=((t+1)*job->nr_v)/job->nr_threads-1;
+    if(bottom<top) return;
+
+    best=0;
+    if(t>0)
+    {
+        best=job->best+(t-1)*(job->nr_h+2)*(job->nr_v+2)*job->bd;
+        for(a= -1;a<=job->nr_v;a++) for(b= -1;b<=job->nr_h;b++)
+        {
+            nr=job->bp_r[a][b].nr;
+            for(k=0;k<nr;k++) best[db_MatchBestIndex(a,b,job->nr_h,job->bd)+k].pir=0;
+        }
+    }
+    db_MatchBucketRows_u(job->bp_l,job->bp_r,job->nr_h,top,bottom,job->bd,best,
+        job->kA,job->kB,job->rect_window,job->use_smaller_matching_window,job->use_21,job->simd);
+}
+
+void db_MatchBucketsThreaded_u(db_Bucket_u **bp_l,db_Bucket_u **bp_r,int nr_h,int nr_v,int bd,
+                     unsigned long kA,unsigned long kB,int rect_window,bool use_smaller_matching_window, int use_21,
+                     int nr_threads,db_MatchBest_u *best)
+{
+    db_MatchBucketsJob_u job;
+    db_MatchBest_u *bt;
+    db_PointInfo_u *pir_r;
+    int t,a,b,k,nr;
+
+    job.bp_l=bp_l;
+    job.bp_r=bp_r;
+    job.nr_h=nr_h;
+    job.nr_v=nr_v;
+    job.bd=bd;
+    job.kA=kA;
+    job.kB=kB;
+    job.rect_window=rect_window;
+    job.use_smaller_matching_window=use_smaller_matching_window;
+    job.use_21=use_21;
+    job.simd=db_UseSimd();
+    job.nr_threads=nr_threads;
+    job.best=best;
+    db_RunThreads(db_MatchBucketsBand_u,&job,nr_threads);
+
+    /*Merge the best matches of the right points*/
+    for(t=1;t<nr_threads;t++)
+    {
+        if(((t+1)*nr_v)/nr_threads<=(t*nr_v)/nr_threads) continue;
+
+        bt=best+(t-1)*(nr_h+2)*(nr_v+2)*bd;
+        for(a= -1;a<=nr_v;a++) for(b= -1;b<=nr_h;b++)
+        {
+            nr=bp_r[a][b].nr;
+            pir_r=bp_r[a][b].ptr;
+            for(k=0;k<nr;k++)
+            {
+                db_MatchBest_u &e=bt[db_MatchBestIndex(a,b,nr_h,bd)+k];
+                if(e.pir && ((!(pir_r[k].pir)) || (e.s>pir_r[k].s)))
+                {
+                    pir_r[k].s=e.s;
+                    pir_r[k].pir=e.pir;
                 }
             }
         }
@@ -3247,16 +3482,23 @@ db_Matcher_u::db_Matcher_u()
     m_bw=m_bh=m_nr_h=m_nr_v=m_bd=m_target=0;
     m_bp_l=m_bp_r=0;
     m_patch_space=m_aligned_patch_space=0;
+    m_nr_threads=DB_DEFAULT_NR_THREADS;
+    m_best=0;
 }
 
 db_Matcher_u::db_Matcher_u(const db_Matcher_u& cm)
 {
+    m_w=0; m_h=0;
+    m_nr_threads=cm.m_nr_threads;
+    m_best=0;
     Init(cm.m_w, cm.m_h, cm.m_max_disparity, cm.m_target, cm.m_max_disparity_v);
 }
 
 db_Matcher_u& db_Matcher_u::operator= (const db_Matcher_u& cm)
 {
     if ( this == &cm ) return *this;
+    Clean();
+    m_nr_threads=cm.m_nr_threads;
     Init(cm.m_w, cm.m_h, cm.m_max_disparity, cm.m_target, cm.m_max_disparity_v);
     return *this;
 }
@@ -3276,10 +3518,29 @@ void db_Matcher_u::Clean()
         db_FreeBuckets_u(m_bp_r,m_nr_h,m_nr_v);
         /*Free space for patch layouts*/
         delete [] m_patch_space;
+        /*Free best match tables of the threads*/
+        delete [] m_best;
+        m_best=0;
     }
     m_w=0; m_h=0;
 }
 
+void db_Matcher_u::AllocBest()
+{
+    delete [] m_best;
+    m_best=0;
+    if(m_nr_threads>1) m_best=new db_MatchBest_u [(m_nr_threads-1)*(m_nr_h+2)*(m_nr_v+2)*m_bd];
+}
+
+void db_Matcher_u::SetNrThreads(int nr_threads)
+{
+    nr_threads=db_maxi(1,db_mini(nr_threads,DB_MAX_NR_THREADS));
+    if(nr_threads==m_nr_threads) return;
+
+    m_nr_threads=nr_threads;
+    if(m_w) AllocBest();
+}
+
 
 unsigned long db_Matcher_u::Init(int im_width,int im_height,double max_disparity,int target_nr_corners,
                                  double max_disparity_v, bool use_smaller_matching_window, int use_21)
@@ -3347,6 +3608,8 @@ unsigned long db_Matcher_u::Init(int im_width,int im_height,double max_disparity
     }
     }
 
+    AllocBest();
+
     return(m_target);
 }
 
@@ -3398,7 +3661,11 @@ void db_Matcher_u::Match(const unsigned char * const *l_img,const unsigned char
 
 
     /*Compute all the necessary match scores*/
-    db_MatchBuckets_u(m_bp_l,m_bp_r,m_nr_h,m_nr_v,m_kA,m_kB, m_rect_window,m_use_smaller_matching_window,m_use_21);
+    if(m_nr_threads>1)
+        db_MatchBucketsThreaded_u(m_bp_l,m_bp_r,m_nr_h,m_nr_v,m_bd,m_kA,m_kB,m_rect_window,m_use_smaller_matching_window,m_use_21,
+            m_nr_threads,m_best);
+    else
+        db_MatchBuckets_u(m_bp_l,m_bp_r,m_nr_h,m_nr_v,m_kA,m_kB, m_rect_window,m_use_smaller_matching_window,m_use_21);
 
     /*Collect the correspondences*/
     db_CollectMatches_u(m_bp_l,m_nr_h,m_nr_v,m_target,id_l,id_r,nr_matches);
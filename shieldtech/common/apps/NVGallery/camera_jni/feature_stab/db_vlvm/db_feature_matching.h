@@ -86,6 +86,16 @@ public:
     db_PointInfo_u *ptr;
     int nr;
 };
+
+/*Best match of a right point found by one thread of db_Matcher_u::Match()*/
+class db_MatchBest_u
+{
+public:
+    /*Best match score*/
+    double s;
+    /*Best match candidate*/
+    db_PointInfo_u *pir;
+};
 /*!
  * \class db_Matcher_f
  * \ingroup FeatureMatching
@@ -239,8 +249,20 @@ public:
      */
     int IsAllocated();
 
+    /*!
+     * Set the number of threads Match() computes the match scores with, each
+     * on a band of rows of buckets. The matches found do not depend on it.
+     * \param nr_threads  number of threads, from 1 (default) to DB_MAX_NR_THREADS
+     */
+    void SetNrThreads(int nr_threads);
+    /*!
+     * Get the number of threads set with SetNrThreads()
+     */
+    int GetNrThreads() const { return m_nr_threads; }
+
 protected:
     virtual void Clean();
+    void AllocBest();
 
 
     int m_w,m_h,m_bw,m_bh,m_nr_h,m_nr_v,m_bd,m_target;
@@ -253,6 +275,10 @@ protected:
     int m_rect_window;
     bool m_use_smaller_matching_window;
     int m_use_21;
+
+    int m_nr_threads;
+    /*Best matches of the right points for each thread but the first*/
+    db_MatchBest_u *m_best;
 };
 
 
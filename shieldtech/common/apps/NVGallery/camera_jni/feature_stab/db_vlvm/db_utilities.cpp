@@ -19,6 +19,15 @@
 #include "db_utilities.h"
 #include <string.h>
 #include <stdio.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#if defined(DB_USE_NEON) || defined(DB_USE_SSE2_INTRINSICS)
+static bool db_use_simd=true;
+#else
+static bool db_use_simd=false;
+#endif
 
 float** db_SetupImageReferences_f(float *im,int w,int h)
 {
@@ -174,3 +183,58 @@ void db_PrintDoubleMatrix(double *a,long rows,long cols)
     }
     printf("]");
 }
+
+void db_SetUseSimd(bool on)
+{
+#if defined(DB_USE_NEON) || defined(DB_USE_SSE2_INTRINSICS)
+    db_use_simd=on;
+#endif
+}
+
+bool db_UseSimd()
+{
+    return(db_use_simd);
+}
+
+#ifndef _WIN32
+struct db_ThreadCall
+{
+    void (*func)(void *arg,int t);
+    void *arg;
+    int t;
+};
+
+static void* db_ThreadMain(void *p)
+{
+    db_ThreadCall *call=(db_ThreadCall*) p;
+    call->func(call->arg,call->t);
+    return(0);
+}
+#endif /* _WIN32 */
+
+void db_RunThreads(void (*func)(void *arg,int t),void *arg,int nr_threads)
+{
+#ifndef _WIN32
+    db_ThreadCall calls[DB_MAX_NR_THREADS];
+    pthread_t threads[DB_MAX_NR_THREADS];
+    bool started[DB_MAX_NR_THREADS];
+    int t;
+
+    nr_threads=db_mini(nr_threads,DB_MAX_NR_THREADS);
+    for(t=1;t<nr_threads;t++)
+    {
+        calls[t].func=func;
+        calls[t].arg=arg;
+        calls[t].t=t;
+        started[t]=(pthread_create(&threads[t],NULL,db_ThreadMain,&calls[t])==0);
+    }
+    func(arg,0);
+    for(t=1;t<nr_threads;t++)
+    {
+        if(started[t]) pthread_join(threads[t],NULL);
+        else func(arg,t);
+    }
+#else
+    for(int t=0;t<nr_threads;t++) func(arg,t);
+#endif /* _WIN32 */
+}
@@ -42,6 +42,18 @@
     #define DB_API
 #endif /* _WIN32 */
 
+/* Intrinsics versions of the corner detection and matching kernels.
+Unlike the DB_USE_MMX/DB_USE_SIMD inline assembly these are picked up by
+any compiler targeting NEON or SSE2, and are used while db_UseSimd() is
+true. Define DB_NO_INTRINSICS to leave them out */
+#ifndef DB_NO_INTRINSICS
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+    #define DB_USE_NEON
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define DB_USE_SSE2_INTRINSICS
+#endif
+#endif /* DB_NO_INTRINSICS */
+
 #ifdef _VERBOSE_
 #include <iostream>
 #endif
@@ -555,6 +567,30 @@ DB_API void db_WarpImageLut_u(const unsigned char * const * src,unsigned char **
 DB_API void db_PrintDoubleVector(double *a,long size);
 DB_API void db_PrintDoubleMatrix(double *a,long rows,long cols);
 
+/*!
+ * Switch the NEON/SSE2 intrinsics kernels of the corner detector and matcher
+ * on or off for the whole process. They are on by default where compiled in.
+ * Switching them off selects the plain C kernels, e.g. to check the intrinsics
+ * kernels against them.
+ * \param on    use the intrinsics kernels
+ */
+DB_API void db_SetUseSimd(bool on);
+/*!
+ * Returns true if the intrinsics kernels are compiled in and switched on.
+ */
+DB_API bool db_UseSimd();
+
+/*!
+ * Call func(arg,t) for t=0,...,nr_threads-1, each call on a thread of its own,
+ * and return once all of them have returned. Call 0 is made on the calling thread.
+ * Where threads cannot be started the remaining calls are made in order on the
+ * calling thread.
+ * \param func          function to call
+ * \param arg           argument passed to each call
+ * \param nr_threads    number of calls
+ */
+DB_API void db_RunThreads(void (*func)(void *arg,int t),void *arg,int nr_threads);
+
 #include "db_utilities_constants.h"
 #include "db_utilities_algebra.h"
 #include "db_utilities_indexing.h"
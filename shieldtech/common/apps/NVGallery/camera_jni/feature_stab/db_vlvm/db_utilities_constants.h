@@ -66,6 +66,8 @@
 #define DB_DEFAULT_MAX_DISPARITY 0.1
 #define DB_DEFAULT_NO_DISPARITY -1.0
 #define DB_DEFAULT_MAX_TRACK_LENGTH 300
+#define DB_DEFAULT_NR_THREADS 1
+#define DB_MAX_NR_THREADS 8
 
 #define DB_DEFAULT_MAX_NR_CAMERAS 1000
 
@@ -118,6 +120,16 @@
  * \brief Maximum disparity (as fraction of image size) allowed in feature matching
 */
  /*!
+ * \def DB_DEFAULT_NR_THREADS
+ * \ingroup FeatureDetection
+ * \brief Default number of threads the corner detector and matcher split their work over.
+*/
+/*!
+ * \def DB_MAX_NR_THREADS
+ * \ingroup FeatureDetection
+ * \brief Maximum number of threads the corner detector and matcher split their work over.
+*/
+/*!
  * \def DB_DEFAULT_NO_DISPARITY
  * \ingroup FeatureMatching
  * \brief Indicates that vertical disparity is the same as horizontal disparity.
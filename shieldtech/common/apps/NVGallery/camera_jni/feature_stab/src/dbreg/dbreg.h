@@ -180,6 +180,12 @@ public:
     */
     void ResetSmoothing(bool enable) { m_do_motion_smoothing = enable; }
 
+    /*!
+     * Set the number of threads corner detection and matching are split over. The alignment does not depend on it.
+     * \param nr_threads    number of threads, from 1 (default) to DB_MAX_NR_THREADS
+    */
+    void SetNrThreads(int nr_threads) { m_cd.SetNrThreads(nr_threads); m_cm.SetNrThreads(nr_threads); }
+
     /*!
      * Align an inspection image to an existing reference image, update the reference image if due and perform motion smoothing if enabled.
      * \param im                new inspection image
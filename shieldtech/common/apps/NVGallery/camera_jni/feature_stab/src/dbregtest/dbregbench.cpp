@@ -0,0 +1,347 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmark of the corner detector and matcher used by dbreg. Every pair of
+// consecutive frames is run through db_CornerDetector_u and db_Matcher_u
+// with the plain C kernels on one thread and with the intrinsics kernels on
+// the given number of threads. The corners and matches of the two have to
+// agree within tolerance, and the time each takes is printed.
+#include "stdafx.h"
+#include "PgmImage.h"
+#include <db_feature_detection.h>
+#include <db_feature_matching.h>
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <stdlib.h>
+#include <sys/time.h>
+
+using namespace std;
+
+const int DEFAULT_NR_CORNERS=500;
+const double DEFAULT_MAX_DISPARITY=0.2;
+const int DEFAULT_NR_THREADS=4;
+const int DEFAULT_NR_ITERATIONS=10;
+const int SYNTHETIC_WIDTH=640;
+const int SYNTHETIC_HEIGHT=480;
+const int SYNTHETIC_NR_FRAMES=4;
+
+// The Harris strengths may differ by this much relative to their size, corner
+// positions by this much, and this fraction of the corners and matches may
+// differ at all: the floating point Harris response can round differently
+// where the compiler fuses multiplies and adds in one path only.
+const double STRENGTH_TOLERANCE=1e-5;
+const double CORNER_TOLERANCE=1e-3;
+const double MISMATCH_TOLERANCE=0.01;
+
+// Gives access to the Harris strength image.
+class StrengthCornerDetector : public db_CornerDetector_u
+{
+public:
+  const float * const * GetStrength() const { return m_strength; }
+};
+
+struct Result
+{
+  vector<float> strength;
+  vector<double> x,y;
+  vector<int> id_l,id_r;
+  double detect_ms,match_ms;
+};
+
+void usage(string name)
+{
+  const char *helpmsg[] = {
+    "Function: checks and times the intrinsics and threaded corner detection and matching against the C code.",
+    "  -t <int>   : number of threads (default 4).",
+    "  -n <int>   : number of timed iterations per frame pair (default 10).",
+    "  -c <int>   : number of corners (default 500).",
+    "  image_list.txt : PGM/PPM frames, one per line (default synthetic 640x480 frames).",
+    NULL
+  };
+
+  cerr << "Usage: " << name << " [options] [image_list.txt]" << endl;
+
+  const char **p = helpmsg;
+
+  while (*p)
+  {
+    cerr << *p++ << endl;
+  }
+}
+
+double now_ms()
+{
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec*1000.0 + tv.tv_usec/1000.0;
+}
+
+// Random rectangles over a gradient, shifted and with some noise per frame.
+void make_synthetic_frames(vector<PgmImage>& frames)
+{
+  srand(1);
+  int nr_rects = 300;
+  vector<int> rects(nr_rects*5);
+  for (int i = 0; i < nr_rects*5; i += 5)
+  {
+    rects[i] = rand() % SYNTHETIC_WIDTH;
+    rects[i+1] = rand() % SYNTHETIC_HEIGHT;
+    rects[i+2] = 4 + rand() % 40;
+    rects[i+3] = 4 + rand() % 40;
+    rects[i+4] = rand() % 256;
+  }
+
+  for (int f = 0; f < SYNTHETIC_NR_FRAMES; f++)
+  {
+    PgmImage frame(SYNTHETIC_WIDTH, SYNTHETIC_HEIGHT);
+    unsigned char **rows = frame.GetRowPointers();
+    int dx = 3*f, dy = 2*f;
+
+    for (int y = 0; y < SYNTHETIC_HEIGHT; y++)
+      for (int x = 0; x < SYNTHETIC_WIDTH; x++)
+        rows[y][x] = (unsigned char)((x + y) / 5);
+
+    for (int i = 0; i < nr_rects*5; i += 5)
+    {
+      for (int y = rects[i+1] + dy; y < rects[i+1] + dy + rects[i+3] && y < SYNTHETIC_HEIGHT; y++)
+        for (int x = rects[i] + dx; x < rects[i] + dx + rects[i+2] && x < SYNTHETIC_WIDTH; x++)
+          rows[y][x] = (unsigned char)rects[i+4];
+    }
+
+    for (int y = 0; y < SYNTHETIC_HEIGHT; y++)
+      for (int x = 0; x < SYNTHETIC_WIDTH; x++)
+        rows[y][x] = (unsigned char)db_mini(255, rows[y][x] + rand() % 4);
+
+    frames.push_back(frame);
+  }
+}
+
+bool read_frames(const string& image_list_file_name, vector<PgmImage>& frames)
+{
+  ifstream in(image_list_file_name.c_str(),ios::in);
+  string file_name;
+
+  if ( !in.is_open() )
+  {
+    cerr << "Could not open file " << image_list_file_name << "." << endl;
+    return false;
+  }
+
+  while ( getline(in,file_name) )
+  {
+    if ( file_name.empty() )
+      continue;
+
+    PgmImage frame(file_name);
+    if ( frame.GetDataPointer() == NULL )
+    {
+      cerr << "Could not open image " << file_name << "." << endl;
+      return false;
+    }
+    frame.ConvertToGray();
+
+    if ( !frames.empty() && (frame.GetWidth() != frames[0].GetWidth() || frame.GetHeight() != frames[0].GetHeight()) )
+    {
+      cerr << "Image " << file_name << " differs in size from the first one." << endl;
+      return false;
+    }
+    frames.push_back(frame);
+  }
+  return frames.size() >= 2;
+}
+
+// Detect corners in both frames and match them, the way dbreg does.
+void run(PgmImage& ref, PgmImage& ins, bool simd, int nr_threads, int nr_iterations,
+         double relative_threshold, bool use_smaller_matching_window, int use_21, int nr_corners, Result& result)
+{
+  int w = ref.GetWidth(), h = ref.GetHeight();
+  StrengthCornerDetector cd;
+  db_Matcher_u cm;
+
+  db_SetUseSimd(simd);
+  cd.SetNrThreads(nr_threads);
+  cm.SetNrThreads(nr_threads);
+
+  int max_nr_corners = cd.Init(w,h,nr_corners,5,5,DB_DEFAULT_ABS_CORNER_THRESHOLD/500.0,relative_threshold);
+  int max_nr_matches = cm.Init(w,h,DEFAULT_MAX_DISPARITY,max_nr_corners,DB_DEFAULT_NO_DISPARITY,use_smaller_matching_window,use_21);
+
+  vector<double> x_ref(max_nr_corners), y_ref(max_nr_corners), x_ins(max_nr_corners), y_ins(max_nr_corners);
+  vector<int> id_l(max_nr_matches), id_r(max_nr_matches);
+  int nr_ref = 0, nr_ins = 0, nr_matches = 0;
+
+  double start = now_ms();
+  for (int i = 0; i < nr_iterations; i++)
+  {
+    cd.DetectCorners(ref.GetRowPointers(),&x_ref[0],&y_ref[0],&nr_ref);
+    cd.DetectCorners(ins.GetRowPointers(),&x_ins[0],&y_ins[0],&nr_ins);
+  }
+  result.detect_ms = (now_ms() - start)/nr_iterations;
+
+  // strength of ins, where DetectCorners computes it
+  result.strength.clear();
+  for (int y = 3; y <= h-4; y++)
+    result.strength.insert(result.strength.end(), cd.GetStrength()[y] + 3, cd.GetStrength()[y] + w-3);
+
+  start = now_ms();
+  for (int i = 0; i < nr_iterations; i++)
+  {
+    cm.Match(ref.GetRowPointers(),ins.GetRowPointers(),&x_ref[0],&y_ref[0],nr_ref,&x_ins[0],&y_ins[0],nr_ins,
+             &id_l[0],&id_r[0],&nr_matches);
+  }
+  result.match_ms = (now_ms() - start)/nr_iterations;
+
+  result.x.assign(x_ref.begin(), x_ref.begin() + nr_ref);
+  result.y.assign(y_ref.begin(), y_ref.begin() + nr_ref);
+  result.x.insert(result.x.end(), x_ins.begin(), x_ins.begin() + nr_ins);
+  result.y.insert(result.y.end(), y_ins.begin(), y_ins.begin() + nr_ins);
+  result.id_l.assign(id_l.begin(), id_l.begin() + nr_matches);
+  result.id_r.assign(id_r.begin(), id_r.begin() + nr_matches);
+
+  db_SetUseSimd(true);
+}
+
+// Largest difference of the strengths relative to their size.
+double strength_difference(const Result& a, const Result& b)
+{
+  double worst = 0.0;
+
+  for (size_t i = 0; i < a.strength.size(); i++)
+  {
+    double d = db_absd((double)a.strength[i] - b.strength[i]);
+    if ( d > 0.0 )
+      worst = db_maxd(worst, d/db_maxd(db_absd(a.strength[i]), db_absd(b.strength[i])));
+  }
+  return worst;
+}
+
+// Number of entries that differ, counting any difference in length as differing entries.
+int count_corner_mismatches(const Result& a, const Result& b)
+{
+  size_t n = db_mini(a.x.size(), b.x.size());
+  int mismatches = db_maxi(a.x.size(), b.x.size()) - n;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    if ( db_absd(a.x[i] - b.x[i]) > CORNER_TOLERANCE || db_absd(a.y[i] - b.y[i]) > CORNER_TOLERANCE )
+      mismatches++;
+  }
+  return mismatches;
+}
+
+int count_match_mismatches(const Result& a, const Result& b)
+{
+  size_t n = db_mini(a.id_l.size(), b.id_l.size());
+  int mismatches = db_maxi(a.id_l.size(), b.id_l.size()) - n;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    if ( a.id_l[i] != b.id_l[i] || a.id_r[i] != b.id_r[i] )
+      mismatches++;
+  }
+  return mismatches;
+}
+
+int main(int argc, char* argv[])
+{
+  int nr_threads = DEFAULT_NR_THREADS;
+  int nr_iterations = DEFAULT_NR_ITERATIONS;
+  int nr_corners = DEFAULT_NR_CORNERS;
+  string image_list_file_name;
+
+  for (int c = 1; c < argc; c++)
+  {
+    string token(argv[c]);
+
+    if (token == "-t" && c + 1 < argc)
+      nr_threads = atoi(argv[++c]);
+    else if (token == "-n" && c + 1 < argc)
+      nr_iterations = db_maxi(1, atoi(argv[++c]));
+    else if (token == "-c" && c + 1 < argc)
+      nr_corners = atoi(argv[++c]);
+    else if (token[0] != '-' && image_list_file_name.empty())
+      image_list_file_name = token;
+    else
+    {
+      usage(argv[0]);
+      exit(1);
+    }
+  }
+
+  vector<PgmImage> frames;
+  if ( image_list_file_name.empty() )
+    make_synthetic_frames(frames);
+  else if ( !read_frames(image_list_file_name, frames) )
+  {
+    cerr << "Need at least two frames of the same size." << endl;
+    return 1;
+  }
+
+  cout << "frames " << frames[0].GetWidth() << "x" << frames[0].GetHeight()
+       << ", " << nr_threads << " threads, " << (db_UseSimd() ? "intrinsics" : "no intrinsics compiled in") << endl;
+
+  // Relative threshold as used by dbreg, and one that needs the maximum strength;
+  // the 11x11, 5x5 and 21x21 matching windows.
+  const double relative_thresholds[] = {0.0, DB_DEFAULT_REL_CORNER_THRESHOLD};
+  const bool smaller_windows[] = {false, true, false};
+  const int use_21s[] = {0, 0, 1};
+  const char *window_names[] = {"11x11", "5x5", "21x21"};
+
+  bool ok = true;
+  double c_ms = 0.0, fast_ms = 0.0;
+
+  for (size_t f = 0; f + 1 < frames.size(); f++)
+  {
+    for (int r = 0; r < 2; r++)
+    {
+      for (int m = 0; m < 3; m++)
+      {
+        Result c_result, fast_result;
+
+        run(frames[f], frames[f+1], false, 1, nr_iterations, relative_thresholds[r],
+            smaller_windows[m], use_21s[m], nr_corners, c_result);
+        run(frames[f], frames[f+1], true, nr_threads, nr_iterations, relative_thresholds[r],
+            smaller_windows[m], use_21s[m], nr_corners, fast_result);
+
+        double strength_diff = strength_difference(c_result, fast_result);
+        int corner_mismatches = count_corner_mismatches(c_result, fast_result);
+        int match_mismatches = count_match_mismatches(c_result, fast_result);
+        bool pair_ok = strength_diff <= STRENGTH_TOLERANCE &&
+                       corner_mismatches <= MISMATCH_TOLERANCE*c_result.x.size() &&
+                       match_mismatches <= MISMATCH_TOLERANCE*c_result.id_l.size();
+
+        cout << "[" << f << "] rel " << relative_thresholds[r] << " " << window_names[m]
+             << fixed << setprecision(2) << ": " << c_result.x.size() << " corners, " << c_result.id_l.size() << " matches"
+             << ", detect " << c_result.detect_ms << " -> " << fast_result.detect_ms << " ms"
+             << ", match " << c_result.match_ms << " -> " << fast_result.match_ms << " ms"
+             << ", " << corner_mismatches << "/" << match_mismatches << " differ"
+             << setprecision(1) << scientific << ", strength " << strength_diff
+             << (pair_ok ? "" : "  FAILED") << endl;
+        cout.unsetf(ios::floatfield);
+        cout << setprecision(6);
+
+        ok = ok && pair_ok;
+        c_ms += c_result.detect_ms + c_result.match_ms;
+        fast_ms += fast_result.detect_ms + fast_result.match_ms;
+      }
+    }
+  }
+
+  cout << fixed << setprecision(2) << "total " << c_ms << " -> " << fast_ms << " ms" << endl;
+  cout << (ok ? "PASSED" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
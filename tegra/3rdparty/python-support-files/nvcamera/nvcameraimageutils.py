@@ -1,5 +1,5 @@
 #
-# Copyright (c) 2013, NVIDIA Corporation.  All rights reserved.
+# Copyright (c) 2013-2014, NVIDIA Corporation.  All rights reserved.
 #
 # NVIDIA Corporation and its licensors retain all intellectual property
 # and proprietary rights in and to this software, related documentation
@@ -14,11 +14,27 @@ import nvrawfile
 import math
 import time
 
+try:
+    # Native image metrics (nvrawimage), with the same results as the Python
+    # code below, which is used without it
+    import _nvrawimage
+except ImportError:
+    _nvrawimage = None
+
+def _useNative(data, typecode):
+    "True if _nvrawimage can work on data in place"
+    return (_nvrawimage is not None and isinstance(data, array.array) and
+            data.typecode == typecode)
+
 ################################# sharpness #################################
 def calculateSharpness(nvrf):
     # nvrf: NvRawFile object
     sharpness = 0
 
+    if _useNative(nvrf._pixelData, 'h'):
+        return _nvrawimage.sharpness(nvrf._pixelData, nvrf._width,
+                                     nvrf._height, nvrf._bayerPhase)
+
     # check if we are able to open the nvraw file
     #print "raw file width:%d, height:%d" % (nvrf._width, nvrf._height)
 
@@ -42,6 +58,9 @@ def _convertRawToY(nvrf):
     bayerPhase = nvrf._bayerPhase
     pixelData = nvrf._pixelData
 
+    if _useNative(pixelData, 'h'):
+        return list(_nvrawimage.convertRawToY(pixelData, width, height, bayerPhase))
+
     indexOfR = bayerPhase.index('R')
 
     if(indexOfR == 0):
@@ -90,6 +109,9 @@ def _sharpnessMeasure_Apply5x5Filter(
                                      height
                                     ):
 
+    if _useNative(input_image, 'd'):
+        return _nvrawimage.sharpness5x5(input_image, width, height)
+
     start_time = time.clock()
     sharpness = []
     cy = 0
@@ -174,10 +196,6 @@ def cropRawImageFromCenter(nvrf, cropWidth, cropHeight):
     if(cropHeight > nvrf._height):
         cropHeight = nvrf._height
 
-    pixelDataList = nvrf._pixelData.tolist()
-
-    #print "original pixelData length: %d" % len(pixelDataList)
-
     x = int(math.floor(nvrf._width/2) - math.floor(cropWidth/2))
     y = int(math.floor(nvrf._height/2) - math.floor(cropHeight/2))
 
@@ -185,19 +203,80 @@ def cropRawImageFromCenter(nvrf, cropWidth, cropHeight):
     # update bayerPhase field based on (x,y) values
     nvrf._bayerPhase = _getBayerPhaseAtRowAndCol(nvrf._bayerPhase, x, y)
 
-    # empty raw file pixelData
-    nvrf._pixelData = array.array('h')
-    for i in range(cropHeight):
-        # get width pixel data
-        startIndex = int(((y + i) * nvrf._width) + x)
-        endIndex = startIndex + cropWidth
+    if _useNative(nvrf._pixelData, 'h'):
+        nvrf._pixelData = _nvrawimage.crop(nvrf._pixelData, nvrf._width, x, y,
+                                           cropWidth, cropHeight)
+    else:
+        pixelDataList = nvrf._pixelData.tolist()
+
+        #print "original pixelData length: %d" % len(pixelDataList)
 
-        nvrf._pixelData.fromlist(pixelDataList[startIndex:endIndex])
+        # empty raw file pixelData
+        nvrf._pixelData = array.array('h')
+        for i in range(cropHeight):
+            # get width pixel data
+            startIndex = int(((y + i) * nvrf._width) + x)
+            endIndex = startIndex + cropWidth
+
+            nvrf._pixelData.fromlist(pixelDataList[startIndex:endIndex])
 
     nvrf._width = cropWidth
     nvrf._height = cropHeight
     return True
 
+################################# histogram #################################
+
+BAYER_CHANNELS = ('R', 'Gr', 'Gb', 'B')
+
+def calculateHistogram(nvrf, bins=256):
+    """Histogram of each Bayer channel of a raw image, as a dictionary from
+    the names in BAYER_CHANNELS to lists of bins counts. Samples are clamped
+    to the range of nvrf._bitsPerSample, and sample * bins >> bitsPerSample
+    is the bin of a sample."""
+    width = nvrf._width
+    height = nvrf._height
+    bitsPerSample = nvrf._bitsPerSample
+    pixelData = nvrf._pixelData
+
+    if _useNative(pixelData, 'h'):
+        histograms = _nvrawimage.histogram(pixelData, width, height,
+                                           nvrf._bayerPhase, bitsPerSample, bins)
+        return dict(zip(BAYER_CHANNELS, histograms))
+
+    if bins < 1 or bins > 65536 or bitsPerSample < 1 or bitsPerSample > 16:
+        raise ValueError("bad sample size or bin count")
+    channels = _getBayerChannels(nvrf._bayerPhase)
+    histograms = dict((channel, [0] * bins) for channel in BAYER_CHANNELS)
+    maxValue = (1 << bitsPerSample) - 1
+
+    for i in range(height):
+        # channels of the even and odd columns of this row
+        rowChannels = [histograms[channels[(i & 1) * 2]],
+                       histograms[channels[(i & 1) * 2 + 1]]]
+        for j in range(width):
+            value = min(max(pixelData[(i*width) + j], 0), maxValue)
+            rowChannels[j & 1][(value * bins) >> bitsPerSample] += 1
+
+    return histograms
+
+def _getBayerChannels(bayerPhase):
+    "gets the channel of each sample of a 2x2 bayer quad, e.g. RGGB gives R Gr Gb B"
+    if len(bayerPhase) != 4:
+        raise ValueError("unsupported bayer phase")
+    channels = []
+    for i in range(4):
+        if bayerPhase[i] == 'G':
+            # a G shares its row with an R or with a B
+            if bayerPhase[i ^ 1] == 'R':
+                channels.append('Gr')
+            else:
+                channels.append('Gb')
+        elif bayerPhase[i] in ('R', 'B'):
+            channels.append(bayerPhase[i])
+        else:
+            raise ValueError("unsupported bayer phase")
+    return channels
+
 def _getBayerPhaseAtRowAndCol(currentBayerPhase, i, j):
     "gets the bayer phase at given row and column using current bayer phase"
 
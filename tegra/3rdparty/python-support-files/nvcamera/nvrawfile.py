@@ -1,5 +1,5 @@
 #
-# Copyright (c) 2013, NVIDIA Corporation.  All rights reserved.
+# Copyright (c) 2013-2014, NVIDIA Corporation.  All rights reserved.
 #
 # NVIDIA Corporation and its licensors retain all intellectual property
 # and proprietary rights in and to this software, related documentation
@@ -11,6 +11,12 @@ import array
 import struct
 import os
 
+try:
+    # Native reader (nvrawimage); the Python one below is used without it
+    import _nvrawimage
+except ImportError:
+    _nvrawimage = None
+
 def isLegacyFormat(first8bytes):
     "Return True if header sample shows this is a legacy nvraw file"
     magic,version = struct.unpack('<LL', first8bytes)
@@ -146,7 +152,28 @@ class NvRawFile(object):
         struct.pack_into('<L', result, offset, NVRAW_BAYER_SENTINEL)
         return result
 
+    def _loadNativeFile(self, filename):
+        "Load a file with _nvrawimage, setting the same fields as the loaders below"
+        info = _nvrawimage.readFile(filename)
+        if info is None:
+            return False
+        if 'legacyVersion' in info:
+            print "INFO: Legacy magic %d version %d" % (NVRAW_LEGACY_MAGIC, info.pop('legacyVersion'))
+        for symbol, exposureTime, analogGains, digitalGains in info.pop('hdrExposureInfos', []):
+            infoStruct = hdrInfo()
+            infoStruct.symbol = symbol
+            infoStruct.exposureTime = exposureTime
+            infoStruct.analogGains = list(analogGains)
+            infoStruct.digitalGains = list(digitalGains)
+            self._hdrExposureInfos.append(infoStruct)
+        for name, value in info.iteritems():
+            setattr(self, name, value)
+        self._loaded = True
+        return True
+
     def _loadLegacyFile(self, infile):
+        if _nvrawimage is not None:
+            return self._loadNativeFile(infile.name)
         awbStateSize = 4*8 # fflLffff
         # read it in
         infile.seek(0, os.SEEK_SET)
@@ -187,6 +214,8 @@ class NvRawFile(object):
         return True
 
     def _loadChunkyFile(self, infile):
+        if _nvrawimage is not None:
+            return self._loadNativeFile(infile.name)
         # Get total file length
         infile.seek(0, os.SEEK_END)
         fileLength = infile.tell()
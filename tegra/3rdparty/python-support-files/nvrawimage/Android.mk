@@ -0,0 +1,33 @@
+LOCAL_PATH := $(call my-dir)
+
+# _nvrawimage needs the headers of the Python 2.6 that the prebuilt
+# libpython2.6 comes from, which are not part of this tree: set
+# NV_PYTHON26_INCLUDES to their directories to build it. Without the module
+# nvrawfile.py and nvcameraimageutils.py use their Python code.
+ifneq ($(NV_PYTHON26_INCLUDES),)
+
+include $(NVIDIA_DEFAULTS)
+LOCAL_MODULE := _nvrawimage
+local_python_modules += _nvrawimage
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/python2.6/lib-dynload
+LOCAL_SRC_FILES := \
+    nvrawimage.cpp \
+    nvrawimage_metrics.cpp \
+    nvrawimagemodule.cpp
+LOCAL_C_INCLUDES += $(NV_PYTHON26_INCLUDES)
+# The metrics must round like the Python they replace
+LOCAL_CFLAGS += -ffp-contract=off
+LOCAL_SHARED_LIBRARIES := libpython2.6
+include $(NVIDIA_SHARED_LIBRARY)
+
+# Checks the module against the Python implementation
+include $(NVIDIA_DEFAULTS)
+LOCAL_MODULE := nvrawimage_test.py
+LOCAL_MODULE_TAGS := nvidia_tests
+LOCAL_MODULE_CLASS := ETC
+LOCAL_MODULE_PATH := $(TARGET_OUT)/usr/share/nvcs/tests
+LOCAL_SRC_FILES := nvrawimage_test.py
+include $(NVIDIA_PREBUILT)
+
+endif
@@ -0,0 +1,443 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+#include "nvrawimage.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Chunk UUIDs, see nvrawfile.py
+static const char s_HeaderChunkUuid[]       = "NVRAWFILE_111107";
+static const char s_DataChunkUuid[]         = "PIXELDATA_111107";
+static const char s_CaptureChunkUuid[]      = "CAPTURE___120118";
+static const char s_CameraStateChunkUuid[]  = "CAMSTATE__120118";
+static const char s_SensorInfoChunkUuid[]   = "SENSORINFO120131";
+static const char s_HdrChunkUuid[]          = "HDR_______130318";
+
+#define NVRAW_UUID_SIZE         16
+#define NVRAW_CHUNK_HEADER_SIZE (16 + 16 + 4)   // UUID, MD5, length
+#define NVRAW_HDR_EXPOSURE_SIZE (4 * 10)        // symbol, time, 8 gains
+
+// Everything in an NvRaw file is little endian, and fields need not be
+// aligned in the chunky format.
+static NvU32 ReadU32(const NvU8 *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((NvU32)p[3] << 24);
+}
+
+static NvS32 ReadS32(const NvU8 *p)
+{
+    return (NvS32)ReadU32(p);
+}
+
+static NvF32 ReadF32(const NvU8 *p)
+{
+    NvU32 bits = ReadU32(p);
+    NvF32 f;
+
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static void ReadF32Array(const NvU8 *p, NvF32 *pOut, NvU32 count)
+{
+    NvU32 i;
+
+    for (i = 0; i < count; i++)
+        pOut[i] = ReadF32(p + 4 * i);
+}
+
+// The phase is stored as a 32 bit number whose bytes, most significant
+// first, spell it out.
+static void BayerPhaseString(NvU32 value, char *pOut)
+{
+    pOut[0] = (char)(value >> 24);
+    pOut[1] = (char)(value >> 16);
+    pOut[2] = (char)(value >> 8);
+    pOut[3] = (char)value;
+    pOut[4] = '\0';
+}
+
+// A 32 bit length followed by that many characters
+static NvError ReadString(const NvU8 *data, size_t length, NvRawString *pOut,
+    size_t *pConsumed)
+{
+    NvS32 count;
+
+    if (length < 4)
+        return NvError_EndOfFile;
+    count = ReadS32(data);
+    if (count < 0)
+        return NvError_InvalidSize;
+    if ((size_t)count > length - 4)
+        return NvError_EndOfFile;
+
+    pOut->Data = (const char *)data + 4;
+    pOut->Length = (NvU32)count;
+    *pConsumed = 4 + (size_t)count;
+    return NvSuccess;
+}
+
+NvRawImage::NvRawImage()
+    : m_pMap(NULL)
+    , m_MapSize(0)
+    , m_pPixelCopy(NULL)
+    , m_pHdrExposures(NULL)
+    , m_HdrExposureAlloc(0)
+{
+    memset(&m_Info, 0, sizeof(m_Info));
+}
+
+NvRawImage::~NvRawImage()
+{
+    Close();
+}
+
+void NvRawImage::Close()
+{
+    if (m_pMap)
+        munmap((void *)m_pMap, m_MapSize);
+    m_pMap = NULL;
+    m_MapSize = 0;
+
+    free(m_pPixelCopy);
+    m_pPixelCopy = NULL;
+    free(m_pHdrExposures);
+    m_pHdrExposures = NULL;
+    m_HdrExposureAlloc = 0;
+
+    memset(&m_Info, 0, sizeof(m_Info));
+}
+
+NvError NvRawImage::Open(const char *filename)
+{
+    struct stat st;
+    void *map;
+    int fd;
+    NvError err;
+
+    Close();
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NvError_FileOperationFailed;
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return NvError_FileOperationFailed;
+    }
+    if (st.st_size < 8)
+    {
+        close(fd);
+        return NvError_BadValue;
+    }
+
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NvError_FileOperationFailed;
+    m_pMap = (const NvU8 *)map;
+    m_MapSize = (size_t)st.st_size;
+    // Pixels are read once front to back
+    madvise(map, m_MapSize, MADV_SEQUENTIAL);
+
+    if (ReadU32(m_pMap) == NVRAW_LEGACY_MAGIC &&
+        ReadU32(m_pMap + 4) >= 1 && ReadU32(m_pMap + 4) <= 4)
+        err = ParseLegacy();
+    else if (!memcmp(m_pMap, s_HeaderChunkUuid, 8))
+        err = ParseChunky();
+    else
+        err = NvError_BadValue;
+
+    if (err != NvSuccess)
+        Close();
+    return err;
+}
+
+NvError NvRawImage::SetPixels(const NvU8 *data, NvU32 count)
+{
+    free(m_pPixelCopy);
+    m_pPixelCopy = NULL;
+
+    // Samples in a chunk can start on an odd offset; these are copied out
+    // rather than read unaligned by the vector code.
+    if (((NvUPtr)data & (sizeof(NvS16) - 1)) != 0)
+    {
+        m_pPixelCopy = (NvS16 *)malloc((size_t)count * sizeof(NvS16) + 1);
+        if (!m_pPixelCopy)
+            return NvError_InsufficientMemory;
+        memcpy(m_pPixelCopy, data, (size_t)count * sizeof(NvS16));
+        m_Info.Pixels = m_pPixelCopy;
+    }
+    else
+    {
+        m_Info.Pixels = (const NvS16 *)data;
+    }
+
+    m_Info.NumPixels = count;
+    m_Info.Present |= NvRawInfo_Pixels;
+    return NvSuccess;
+}
+
+NvError NvRawImage::ParseLegacy()
+{
+    const NvU8 *core = m_pMap;
+    const NvU8 *afinput = m_pMap + NVRAW_LEGACY_CORE_HEADER_SIZE +
+        NVRAW_LEGACY_M3DATA_SIZE;
+    NvU32 phase;
+    NvS64 count;
+
+    if (m_MapSize < NVRAW_LEGACY_HEADER_SIZE)
+        return NvError_EndOfFile;
+    // The only check there is that this really is a legacy file
+    if (ReadU32(m_pMap + NVRAW_LEGACY_HEADER_SIZE - 4) !=
+        NVRAW_BAYER_SENTINEL)
+        return NvError_BadValue;
+
+    m_Info.LegacyVersion = ReadS32(core + 4);
+    m_Info.Width = ReadS32(core + 8);
+    m_Info.Height = ReadS32(core + 12);
+    phase = ReadU32(core + 16);
+    if (phase > 0x7FFFFFFF)
+        return NvError_InvalidSize;
+    BayerPhaseString(phase, m_Info.BayerPhase);
+    // The legacy format has no sample size; the sensors were 10 bit
+    m_Info.BitsPerSample = 10;
+    m_Info.Present |= NvRawInfo_Header;
+
+    // Exposure time in 16.16 fixed point
+    m_Info.ExposureTime = ReadS32(core + 32) / 65536.0;
+    m_Info.Iso = ReadS32(core + 36);
+    m_Info.FocusPosition = ReadU32(core + 48);
+    ReadF32Array(core + 68, m_Info.SensorGains, 4);
+    m_Info.Present |= NvRawInfo_Capture;
+
+    if (m_Info.LegacyVersion >= 2)
+    {
+        // AWB state: lastGoodGuess[2], foundSaneGraypoint, convergeStatus,
+        // gains[4]
+        m_Info.AwbConvergeStatus = ReadU32(afinput + 12);
+        ReadF32Array(afinput + 16, m_Info.AwbGains, 4);
+        m_Info.Present |= NvRawInfo_CameraState;
+    }
+
+    count = (NvS64)m_Info.Width * m_Info.Height;
+    if (count < 0)
+        return NvError_InvalidSize;
+    if (count > (NvS64)((m_MapSize - NVRAW_LEGACY_HEADER_SIZE) /
+        sizeof(NvS16)))
+        return NvError_EndOfFile;
+
+    return SetPixels(m_pMap + NVRAW_LEGACY_HEADER_SIZE, (NvU32)count);
+}
+
+NvError NvRawImage::ParseChunky()
+{
+    size_t pos = 0;
+    NvError err = NvSuccess;
+
+    // Chunks are applied in file order, so where a type repeats the last
+    // one wins. A chunk cut short by the end of the file keeps what there
+    // is of it.
+    while (m_MapSize - pos >= NVRAW_CHUNK_HEADER_SIZE)
+    {
+        const NvU8 *chunk = m_pMap + pos;
+        const NvU8 *data = chunk + NVRAW_CHUNK_HEADER_SIZE;
+        size_t length = ReadU32(chunk + 2 * NVRAW_UUID_SIZE);
+
+        if (length > m_MapSize - pos - NVRAW_CHUNK_HEADER_SIZE)
+            length = m_MapSize - pos - NVRAW_CHUNK_HEADER_SIZE;
+        pos += NVRAW_CHUNK_HEADER_SIZE + length;
+
+        if (!memcmp(chunk, s_HeaderChunkUuid, NVRAW_UUID_SIZE))
+            err = ParseHeaderChunk(data, length);
+        else if (!memcmp(chunk, s_DataChunkUuid, NVRAW_UUID_SIZE))
+            err = ParseDataChunk(data, length);
+        else if (!memcmp(chunk, s_CaptureChunkUuid, NVRAW_UUID_SIZE))
+            err = ParseCaptureChunk(data, length);
+        else if (!memcmp(chunk, s_CameraStateChunkUuid, NVRAW_UUID_SIZE))
+            err = ParseCameraStateChunk(data, length);
+        else if (!memcmp(chunk, s_SensorInfoChunkUuid, NVRAW_UUID_SIZE))
+            err = ParseSensorInfoChunk(data, length);
+        else if (!memcmp(chunk, s_HdrChunkUuid, NVRAW_UUID_SIZE))
+            err = ParseHdrChunk(data, length);
+
+        if (err != NvSuccess)
+            return err;
+    }
+
+    return NvSuccess;
+}
+
+NvError NvRawImage::ParseHeaderChunk(const NvU8 *data, size_t length)
+{
+    // width, height, dataFormat, bitsPerSample, samplesPerPixel, numImages,
+    // time (s), time (ms), flags
+    if (length != 4 * 9)
+        return NvError_InvalidSize;
+
+    m_Info.Width = ReadS32(data);
+    m_Info.Height = ReadS32(data + 4);
+    BayerPhaseString(ReadU32(data + 8), m_Info.BayerPhase);
+    m_Info.BitsPerSample = ReadS32(data + 12);
+    m_Info.Present |= NvRawInfo_Header;
+    return NvSuccess;
+}
+
+NvError NvRawImage::ParseDataChunk(const NvU8 *data, size_t length)
+{
+    // version, ordinal, samples
+    if (length < 4)
+        return NvError_EndOfFile;
+    if (ReadS32(data) != 1)
+        return NvSuccess;
+    if (length < 8)
+        return NvError_EndOfFile;
+    if ((length - 8) % sizeof(NvS16))
+        return NvError_InvalidSize;
+
+    return SetPixels(data + 8, (NvU32)((length - 8) / sizeof(NvS16)));
+}
+
+NvError NvRawImage::ParseCaptureChunk(const NvU8 *data, size_t length)
+{
+    NvU32 version;
+    size_t consumed;
+
+    if (length < 4)
+        return NvError_EndOfFile;
+    version = ReadU32(data);
+
+    if (version >= 2)
+    {
+        // version, exposureTime, expComp, iso, focusPosition, snr, lux,
+        // sensorGains[4], flashPower, flashToAmbientLightRatio, frameRate
+        if (length < 4 * 14)
+            return NvError_EndOfFile;
+        m_Info.ExposureTime = ReadF32(data + 4);
+        m_Info.Iso = ReadU32(data + 12);
+        m_Info.FocusPosition = ReadS32(data + 16);
+        ReadF32Array(data + 28, m_Info.SensorGains, 4);
+        m_Info.Present |= NvRawInfo_Capture;
+    }
+
+    // rollingShutterLength
+    if (version >= 3 && length < 4 * 15)
+        return NvError_EndOfFile;
+
+    if (version >= 4)
+    {
+        NvError err = ReadString(data + 4 * 15, length - 4 * 15,
+            &m_Info.PixelFormat, &consumed);
+        if (err != NvSuccess)
+            return err;
+        m_Info.Present |= NvRawInfo_PixelFormat;
+    }
+
+    return NvSuccess;
+}
+
+NvError NvRawImage::ParseCameraStateChunk(const NvU8 *data, size_t length)
+{
+    // version, convergeStatus, gains[4]
+    if (length < 4)
+        return NvError_EndOfFile;
+    if (ReadS32(data) != 1)
+        return NvSuccess;
+    if (length != 4 * 6)
+        return NvError_InvalidSize;
+
+    m_Info.AwbConvergeStatus = ReadS32(data + 4);
+    ReadF32Array(data + 8, m_Info.AwbGains, 4);
+    m_Info.Present |= NvRawInfo_CameraState;
+    return NvSuccess;
+}
+
+NvError NvRawImage::ParseSensorInfoChunk(const NvU8 *data, size_t length)
+{
+    size_t offset = 4, consumed;
+    NvError err;
+
+    // version, sensorId, fuseId, moduleId (not used)
+    if (length < 4)
+        return NvError_EndOfFile;
+    if (ReadS32(data) != 1)
+        return NvSuccess;
+
+    err = ReadString(data + offset, length - offset, &m_Info.SensorId,
+        &consumed);
+    if (err != NvSuccess)
+        return err;
+    offset += consumed;
+    err = ReadString(data + offset, length - offset, &m_Info.FuseId,
+        &consumed);
+    if (err != NvSuccess)
+        return err;
+
+    m_Info.Present |= NvRawInfo_SensorInfo;
+    return NvSuccess;
+}
+
+NvError NvRawImage::ParseHdrChunk(const NvU8 *data, size_t length)
+{
+    size_t offset, consumed;
+    NvS32 count, i;
+    NvError err;
+
+    // version, number of exposures, readout scheme, exposures; the layout
+    // is the same for all versions
+    if (length < 8)
+        return NvError_EndOfFile;
+    count = ReadS32(data + 4);
+    err = ReadString(data + 8, length - 8, &m_Info.HdrReadoutScheme,
+        &consumed);
+    if (err != NvSuccess)
+        return err;
+    offset = 8 + consumed;
+
+    if (count > 0)
+    {
+        NvU32 needed = m_Info.HdrExposureCount + (NvU32)count;
+
+        if ((size_t)count > (length - offset) / NVRAW_HDR_EXPOSURE_SIZE)
+            return NvError_EndOfFile;
+
+        if (needed > m_HdrExposureAlloc)
+        {
+            NvRawHdrExposure *p = (NvRawHdrExposure *)realloc(
+                m_pHdrExposures, needed * sizeof(NvRawHdrExposure));
+            if (!p)
+                return NvError_InsufficientMemory;
+            m_pHdrExposures = p;
+            m_HdrExposureAlloc = needed;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            NvRawHdrExposure *e = &m_pHdrExposures[m_Info.HdrExposureCount++];
+            const NvU8 *p = data + offset + i * NVRAW_HDR_EXPOSURE_SIZE;
+
+            // The symbol is one character and three bytes of padding
+            memcpy(e->Symbol, p, sizeof(e->Symbol));
+            e->ExposureTime = ReadF32(p + 4);
+            ReadF32Array(p + 8, e->AnalogGains, 4);
+            ReadF32Array(p + 24, e->DigitalGains, 4);
+        }
+    }
+
+    m_Info.HdrNumberOfExposures = count;
+    m_Info.HdrExposures = m_pHdrExposures;
+    m_Info.Present |= NvRawInfo_Hdr;
+    return NvSuccess;
+}
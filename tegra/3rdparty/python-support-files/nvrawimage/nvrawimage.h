@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+/*
+ * Native NvRaw reader and image metrics for the nvcamera Python tools.
+ *
+ * NvRawImage reads the legacy and the chunky NvRaw formats the same way
+ * nvrawfile.py does, through a read-only mapping of the file. The metrics
+ * are those of nvcameraimageutils.py and give the same doubles to the bit:
+ * every sum is evaluated in the order the Python expression evaluates it,
+ * and the sharpness total is rounded the way math.fsum rounds it. Build
+ * with -ffp-contract=off so that no multiply and add pair gets fused.
+ */
+
+#ifndef NV_RAW_IMAGE_H
+#define NV_RAW_IMAGE_H
+
+#include <stddef.h>
+#include "nvcommon.h"
+#include "nverror.h"
+
+#define NVRAW_LEGACY_MAGIC              1
+#define NVRAW_LEGACY_CORE_HEADER_SIZE   (4 * 27)
+#define NVRAW_LEGACY_M3DATA_SIZE        (4 * (64 * 64))
+#define NVRAW_LEGACY_AFINPUT_SIZE       (4 * ((152 * 116 / 4) * 16))
+#define NVRAW_LEGACY_SHARPNESS_SIZE     (4 * 16)
+#define NVRAW_LEGACY_HEADER_SIZE        (NVRAW_LEGACY_CORE_HEADER_SIZE + \
+                                         NVRAW_LEGACY_M3DATA_SIZE + \
+                                         NVRAW_LEGACY_AFINPUT_SIZE + \
+                                         NVRAW_LEGACY_SHARPNESS_SIZE + 4)
+#define NVRAW_BAYER_SENTINEL            0xCAFEFEED
+
+// Bayer channels, in the order the histograms are returned
+enum
+{
+    NvRawChannel_R = 0,
+    NvRawChannel_Gr,
+    NvRawChannel_Gb,
+    NvRawChannel_B,
+    NvRawChannel_Num
+};
+
+// Parts of NvRawImageInfo found in the file. What a file does not provide
+// keeps the default NvRawFile gives it, so the Python side only copies the
+// parts flagged here.
+enum
+{
+    NvRawInfo_Header        = 1 << 0,   // Width, Height, BayerPhase, BitsPerSample
+    NvRawInfo_Pixels        = 1 << 1,   // Pixels, NumPixels
+    NvRawInfo_Capture       = 1 << 2,   // ExposureTime, Iso, FocusPosition, SensorGains
+    NvRawInfo_PixelFormat   = 1 << 3,   // PixelFormat
+    NvRawInfo_CameraState   = 1 << 4,   // AwbConvergeStatus, AwbGains
+    NvRawInfo_SensorInfo    = 1 << 5,   // SensorId, FuseId
+    NvRawInfo_Hdr           = 1 << 6    // HdrNumberOfExposures, HdrReadoutScheme, HdrExposures
+};
+
+// Length counted string pointing into the mapped file
+typedef struct NvRawStringRec
+{
+    const char *Data;
+    NvU32 Length;
+} NvRawString;
+
+typedef struct NvRawHdrExposureRec
+{
+    char Symbol[4];
+    NvF32 ExposureTime;
+    NvF32 AnalogGains[4];
+    NvF32 DigitalGains[4];
+} NvRawHdrExposure;
+
+typedef struct NvRawImageInfoRec
+{
+    NvU32 Present;              // NvRawInfo_* flags
+    NvS32 LegacyVersion;        // 0 for chunky files
+
+    NvS32 Width;
+    NvS32 Height;
+    char BayerPhase[5];         // e.g. "RGGB"
+    NvS32 BitsPerSample;
+
+    // The integer fields below are signed in one format and unsigned in
+    // the other, so they are wide enough for both.
+    NvF64 ExposureTime;         // seconds
+    NvS64 Iso;
+    NvS64 FocusPosition;
+    NvF32 SensorGains[4];
+    NvRawString PixelFormat;
+
+    NvS64 AwbConvergeStatus;
+    NvF32 AwbGains[4];
+
+    NvRawString SensorId;
+    NvRawString FuseId;
+
+    NvS32 HdrNumberOfExposures;
+    NvRawString HdrReadoutScheme;
+    // Exposures of every HDR chunk, appended in file order
+    const NvRawHdrExposure *HdrExposures;
+    NvU32 HdrExposureCount;
+
+    // Native endian samples; not necessarily Width * Height of them, the
+    // data chunk holds whatever was written
+    const NvS16 *Pixels;
+    NvU32 NumPixels;
+} NvRawImageInfo;
+
+class NvRawImage
+{
+public:
+    NvRawImage();
+    ~NvRawImage();
+
+    // Maps and parses a legacy or chunky NvRaw file.
+    // NvError_BadValue: not an NvRaw file, or a legacy file whose bayer
+    //     start mark is missing (the Python reader returns False for both).
+    // NvError_EndOfFile, NvError_InvalidSize: a truncated or malformed
+    //     header or chunk (the Python reader raises for these).
+    NvError Open(const char *filename);
+    void Close();
+
+    const NvRawImageInfo &Info() const { return m_Info; }
+
+private:
+    NvError ParseLegacy();
+    NvError ParseChunky();
+    NvError ParseHeaderChunk(const NvU8 *data, size_t length);
+    NvError ParseDataChunk(const NvU8 *data, size_t length);
+    NvError ParseCaptureChunk(const NvU8 *data, size_t length);
+    NvError ParseCameraStateChunk(const NvU8 *data, size_t length);
+    NvError ParseSensorInfoChunk(const NvU8 *data, size_t length);
+    NvError ParseHdrChunk(const NvU8 *data, size_t length);
+    NvError SetPixels(const NvU8 *data, NvU32 count);
+
+    // Not copyable, the mapping has a single owner
+    NvRawImage(const NvRawImage &);
+    NvRawImage &operator=(const NvRawImage &);
+
+    NvRawImageInfo m_Info;
+    const NvU8 *m_pMap;
+    size_t m_MapSize;
+    NvS16 *m_pPixelCopy;        // pixels, when unaligned in the file
+    NvRawHdrExposure *m_pHdrExposures;
+    NvU32 m_HdrExposureAlloc;
+};
+
+// Size of the Y image made of one value per 2x2 Bayer quad:
+// (width - startCol) / 2 by (height - startRow) / 2, where the start row and
+// column are those of the R sample in bayerPhase.
+NvError NvRawGetYSize(NvS32 width, NvS32 height, const char *bayerPhase,
+    NvS32 *pYWidth, NvS32 *pYHeight);
+
+// _convertRawToY(): y = 0.299 * R + 0.2935 * (Gr + Gb) + 0.114 * B for each
+// quad. pY must hold the number of values given by NvRawGetYSize().
+NvError NvRawConvertToY(const NvS16 *pPixels, NvS32 width, NvS32 height,
+    const char *bayerPhase, NvF64 *pY);
+
+// _sharpnessMeasure_Apply5x5Filter(): the math.fsum of the absolute
+// responses of the 5x5 focus filter over the interior of a Y image.
+// NvError_BadValue when a partial sum overflows, where math.fsum raises.
+NvError NvRawSharpness5x5(const NvF64 *pY, NvS32 width, NvS32 height,
+    NvF64 *pSharpness);
+
+// calculateSharpness(): both of the above, without keeping the whole Y
+// image; it is converted five rows at a time as the filter moves down.
+NvError NvRawSharpness(const NvS16 *pPixels, NvS32 width, NvS32 height,
+    const char *bayerPhase, NvF64 *pSharpness);
+
+// Copies a cropWidth by cropHeight rectangle at (x, y) into pOut.
+NvError NvRawCrop(const NvS16 *pPixels, NvS32 width, NvS32 height,
+    NvS32 x, NvS32 y, NvS32 cropWidth, NvS32 cropHeight, NvS16 *pOut);
+
+// Histograms of each Bayer channel, indexed by NvRawChannel_*. Samples are
+// clamped to [0, 2^bitsPerSample - 1] and sample * bins >> bitsPerSample
+// picks the bin. Each histogram must hold bins counters; they are cleared
+// first.
+NvError NvRawHistogram(const NvS16 *pPixels, NvS32 width, NvS32 height,
+    const char *bayerPhase, NvU32 bitsPerSample, NvU32 bins,
+    NvU32 *pHistograms[NvRawChannel_Num]);
+
+#endif // NV_RAW_IMAGE_H
@@ -0,0 +1,562 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+#include "nvrawimage.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Python works in doubles, so only vector units with double lanes can
+// follow it exactly: SSE2, and NEON on AArch64. 32 bit NEON has no double
+// arithmetic and uses the C loops.
+#if defined(__aarch64__) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#include <arm_neon.h>
+#define NVRAW_NEON64 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define NVRAW_SSE2 1
+#endif
+
+#define NVRAW_Y_R   0.299
+#define NVRAW_Y_G   0.2935
+#define NVRAW_Y_B   0.114
+
+#define NVRAW_FSUM_PARTIALS 32
+
+// isfinite() is not available to C++ in every libc this is built against
+static inline bool IsFinite(NvF64 x)
+{
+    return fabs(x) <= DBL_MAX;
+}
+
+/*
+ * Port of CPython's math.fsum(): Shewchuk's exactly rounded summation,
+ * keeping the sum as a list of non-overlapping partials, with the final
+ * half-even correction. The result is the exactly rounded sum, so it does
+ * not depend on the order the values are added in.
+ *
+ * Only non-negative values are added here, so the -inf + inf case of
+ * math.fsum cannot happen and is left out.
+ */
+class NvRawFsum
+{
+public:
+    NvRawFsum()
+        : m_pPartials(m_Local)
+        , m_Count(0)
+        , m_Alloc(NVRAW_FSUM_PARTIALS)
+        , m_Special(0.0)
+        , m_Error(NvSuccess)
+    {
+    }
+
+    ~NvRawFsum()
+    {
+        if (m_pPartials != m_Local)
+            free(m_pPartials);
+    }
+
+    void Add(NvF64 x)
+    {
+        NvF64 xsave = x;
+        NvU32 i = 0, j;
+
+        for (j = 0; j < m_Count; j++)
+        {
+            NvF64 y = m_pPartials[j], hi, yr, lo;
+
+            if (fabs(x) < fabs(y))
+            {
+                NvF64 t = x;
+                x = y;
+                y = t;
+            }
+            hi = x + y;
+            yr = hi - x;
+            lo = y - yr;
+            if (lo != 0.0)
+                m_pPartials[i++] = lo;
+            x = hi;
+        }
+
+        m_Count = i;
+        if (x == 0.0)
+            return;
+        if (!IsFinite(x))
+        {
+            // Either the sum of finite values overflowed, or an inf or nan
+            // was added, which then is the result
+            if (IsFinite(xsave))
+                m_Error = NvError_BadValue;
+            m_Special += xsave;
+            m_Count = 0;
+            return;
+        }
+        if (m_Count == m_Alloc && !Grow())
+            return;
+        m_pPartials[m_Count++] = x;
+    }
+
+    NvError Result(NvF64 *pSum)
+    {
+        NvF64 hi = 0.0, lo = 0.0;
+        NvU32 n = m_Count;
+
+        if (m_Error != NvSuccess)
+            return m_Error;
+        if (m_Special != 0.0)
+        {
+            *pSum = m_Special;
+            return NvSuccess;
+        }
+
+        if (n > 0)
+        {
+            // Sum from the top until the sum becomes inexact
+            hi = m_pPartials[--n];
+            while (n > 0)
+            {
+                NvF64 x = hi, y = m_pPartials[--n], yr;
+
+                hi = x + y;
+                yr = hi - x;
+                lo = y - yr;
+                if (lo != 0.0)
+                    break;
+            }
+            // Round half-even across the remaining partials
+            if (n > 0 && ((lo < 0.0 && m_pPartials[n - 1] < 0.0) ||
+                          (lo > 0.0 && m_pPartials[n - 1] > 0.0)))
+            {
+                NvF64 y = lo * 2.0, x = hi + y, yr = x - hi;
+
+                if (y == yr)
+                    hi = x;
+            }
+        }
+
+        *pSum = hi;
+        return NvSuccess;
+    }
+
+private:
+    bool Grow()
+    {
+        NvU32 alloc = m_Alloc * 2;
+        NvF64 *p = (NvF64 *)malloc(alloc * sizeof(NvF64));
+
+        if (!p)
+        {
+            m_Error = NvError_InsufficientMemory;
+            return false;
+        }
+        memcpy(p, m_pPartials, m_Count * sizeof(NvF64));
+        if (m_pPartials != m_Local)
+            free(m_pPartials);
+        m_pPartials = p;
+        m_Alloc = alloc;
+        return true;
+    }
+
+    NvRawFsum(const NvRawFsum &);
+    NvRawFsum &operator=(const NvRawFsum &);
+
+    NvF64 m_Local[NVRAW_FSUM_PARTIALS];
+    NvF64 *m_pPartials;
+    NvU32 m_Count;
+    NvU32 m_Alloc;
+    NvF64 m_Special;
+    NvError m_Error;
+};
+
+// Row and column of the R sample in the first quad
+static NvError GetRStart(const char *bayerPhase, NvS32 *pRow, NvS32 *pCol)
+{
+    const char *r = bayerPhase ? strchr(bayerPhase, 'R') : NULL;
+    NvS32 index;
+
+    if (!r || r - bayerPhase > 3)
+        return NvError_BadParameter;
+    index = (NvS32)(r - bayerPhase);
+    *pRow = index >> 1;
+    *pCol = index & 1;
+    return NvSuccess;
+}
+
+// Python's floor division by two
+static NvS32 HalfFloor(NvS32 n)
+{
+    return n >= 0 ? n / 2 : -((1 - n) / 2);
+}
+
+NvError NvRawGetYSize(NvS32 width, NvS32 height, const char *bayerPhase,
+    NvS32 *pYWidth, NvS32 *pYHeight)
+{
+    NvS32 startRow, startCol;
+    NvError err;
+
+    err = GetRStart(bayerPhase, &startRow, &startCol);
+    if (err != NvSuccess)
+        return err;
+
+    *pYWidth = HalfFloor(width - startCol);
+    *pYHeight = HalfFloor(height - startRow);
+    return NvSuccess;
+}
+
+// One row of Y from the two raw rows of its quads, each starting at the R
+// or G sample of its first quad
+static void ConvertRowToY(const NvS16 *pTop, const NvS16 *pBottom,
+    NvS32 yWidth, NvF64 *pY)
+{
+    NvS32 x = 0;
+
+#if NVRAW_NEON64
+    const float64x2_t kr = vdupq_n_f64(NVRAW_Y_R);
+    const float64x2_t kg = vdupq_n_f64(NVRAW_Y_G);
+    const float64x2_t kb = vdupq_n_f64(NVRAW_Y_B);
+
+    for (; x + 8 <= yWidth; x += 8)
+    {
+        // val[0] are the samples of even columns, val[1] of odd ones
+        int16x8x2_t top = vld2q_s16(pTop + 2 * x);
+        int16x8x2_t bottom = vld2q_s16(pBottom + 2 * x);
+        int32x4_t r[2], g[2], b[2];
+        NvU32 i;
+
+        r[0] = vmovl_s16(vget_low_s16(top.val[0]));
+        r[1] = vmovl_s16(vget_high_s16(top.val[0]));
+        g[0] = vaddl_s16(vget_low_s16(top.val[1]),
+            vget_low_s16(bottom.val[0]));
+        g[1] = vaddl_s16(vget_high_s16(top.val[1]),
+            vget_high_s16(bottom.val[0]));
+        b[0] = vmovl_s16(vget_low_s16(bottom.val[1]));
+        b[1] = vmovl_s16(vget_high_s16(bottom.val[1]));
+
+        for (i = 0; i < 4; i++)
+        {
+            int32x2_t r2 = (i & 1) ? vget_high_s32(r[i >> 1]) :
+                vget_low_s32(r[i >> 1]);
+            int32x2_t g2 = (i & 1) ? vget_high_s32(g[i >> 1]) :
+                vget_low_s32(g[i >> 1]);
+            int32x2_t b2 = (i & 1) ? vget_high_s32(b[i >> 1]) :
+                vget_low_s32(b[i >> 1]);
+            float64x2_t y;
+
+            y = vmulq_f64(kr, vcvtq_f64_s64(vmovl_s32(r2)));
+            y = vaddq_f64(y, vmulq_f64(kg, vcvtq_f64_s64(vmovl_s32(g2))));
+            y = vaddq_f64(y, vmulq_f64(kb, vcvtq_f64_s64(vmovl_s32(b2))));
+            vst1q_f64(pY + x + 2 * i, y);
+        }
+    }
+#elif NVRAW_SSE2
+    const __m128d kr = _mm_set1_pd(NVRAW_Y_R);
+    const __m128d kg = _mm_set1_pd(NVRAW_Y_G);
+    const __m128d kb = _mm_set1_pd(NVRAW_Y_B);
+
+    for (; x + 4 <= yWidth; x += 4)
+    {
+        __m128i top = _mm_loadu_si128((const __m128i *)(pTop + 2 * x));
+        __m128i bottom = _mm_loadu_si128((const __m128i *)(pBottom + 2 * x));
+        // Sign extend the even and the odd columns to 32 bits
+        __m128i r = _mm_srai_epi32(_mm_slli_epi32(top, 16), 16);
+        __m128i g = _mm_add_epi32(_mm_srai_epi32(top, 16),
+            _mm_srai_epi32(_mm_slli_epi32(bottom, 16), 16));
+        __m128i b = _mm_srai_epi32(bottom, 16);
+        NvU32 i;
+
+        for (i = 0; i < 2; i++)
+        {
+            __m128d y;
+
+            y = _mm_mul_pd(kr, _mm_cvtepi32_pd(r));
+            y = _mm_add_pd(y, _mm_mul_pd(kg, _mm_cvtepi32_pd(g)));
+            y = _mm_add_pd(y, _mm_mul_pd(kb, _mm_cvtepi32_pd(b)));
+            _mm_storeu_pd(pY + x + 2 * i, y);
+
+            r = _mm_shuffle_epi32(r, _MM_SHUFFLE(1, 0, 3, 2));
+            g = _mm_shuffle_epi32(g, _MM_SHUFFLE(1, 0, 3, 2));
+            b = _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2));
+        }
+    }
+#endif
+
+    for (; x < yWidth; x++)
+    {
+        pY[x] = NVRAW_Y_R * pTop[2 * x] +
+            NVRAW_Y_G * (pTop[2 * x + 1] + pBottom[2 * x]) +
+            NVRAW_Y_B * pBottom[2 * x + 1];
+    }
+}
+
+NvError NvRawConvertToY(const NvS16 *pPixels, NvS32 width, NvS32 height,
+    const char *bayerPhase, NvF64 *pY)
+{
+    NvS32 startRow, startCol, yWidth, yHeight, i;
+    NvError err;
+
+    err = GetRStart(bayerPhase, &startRow, &startCol);
+    if (err != NvSuccess)
+        return err;
+    yWidth = HalfFloor(width - startCol);
+    yHeight = HalfFloor(height - startRow);
+    if (yWidth <= 0 || yHeight <= 0)
+        return NvSuccess;
+
+    for (i = 0; i < yHeight; i++)
+    {
+        const NvS16 *pTop = pPixels + (size_t)(startRow + 2 * i) * width +
+            startCol;
+
+        ConvertRowToY(pTop, pTop + width, yWidth, pY + (size_t)i * yWidth);
+    }
+
+    return NvSuccess;
+}
+
+/*
+ * The 5x5 filter on row cy of a Y image, given its rows cy - 2 to cy + 2:
+ *
+ *      0  -1  -1   -1   0
+ *     -1   1  1.5   1  -1
+ *     -1  1.5  2   1.5 -1
+ *     -1   1  1.5   1  -1
+ *      0  -1  -1   -1   0
+ *
+ * The terms are added left to right, top to bottom, as the expression in
+ * _sharpnessMeasure_Apply5x5Filter() adds them.
+ */
+static void FilterRow(const NvF64 *tt, const NvF64 *t, const NvF64 *c,
+    const NvF64 *b, const NvF64 *bb, NvS32 width, NvRawFsum *pSum)
+{
+    NvS32 x = 2;
+
+#if NVRAW_NEON64
+    const float64x2_t k15 = vdupq_n_f64(1.5);
+    const float64x2_t k2 = vdupq_n_f64(2.0);
+
+    for (; x + 2 <= width - 2; x += 2)
+    {
+        float64x2_t v;
+
+        v = vnegq_f64(vld1q_f64(tt + x - 1));
+        v = vsubq_f64(v, vld1q_f64(tt + x));
+        v = vsubq_f64(v, vld1q_f64(tt + x + 1));
+        v = vsubq_f64(v, vld1q_f64(t + x - 2));
+        v = vaddq_f64(v, vld1q_f64(t + x - 1));
+        v = vaddq_f64(v, vmulq_f64(k15, vld1q_f64(t + x)));
+        v = vaddq_f64(v, vld1q_f64(t + x + 1));
+        v = vsubq_f64(v, vld1q_f64(t + x + 2));
+        v = vsubq_f64(v, vld1q_f64(c + x - 2));
+        v = vaddq_f64(v, vmulq_f64(k15, vld1q_f64(c + x - 1)));
+        v = vaddq_f64(v, vmulq_f64(k2, vld1q_f64(c + x)));
+        v = vaddq_f64(v, vmulq_f64(k15, vld1q_f64(c + x + 1)));
+        v = vsubq_f64(v, vld1q_f64(c + x + 2));
+        v = vsubq_f64(v, vld1q_f64(b + x - 2));
+        v = vaddq_f64(v, vld1q_f64(b + x - 1));
+        v = vaddq_f64(v, vmulq_f64(k15, vld1q_f64(b + x)));
+        v = vaddq_f64(v, vld1q_f64(b + x + 1));
+        v = vsubq_f64(v, vld1q_f64(b + x + 2));
+        v = vsubq_f64(v, vld1q_f64(bb + x - 1));
+        v = vsubq_f64(v, vld1q_f64(bb + x));
+        v = vsubq_f64(v, vld1q_f64(bb + x + 1));
+        v = vabsq_f64(v);
+
+        pSum->Add(vgetq_lane_f64(v, 0));
+        pSum->Add(vgetq_lane_f64(v, 1));
+    }
+#elif NVRAW_SSE2
+    const __m128d k15 = _mm_set1_pd(1.5);
+    const __m128d k2 = _mm_set1_pd(2.0);
+    const __m128d sign = _mm_set1_pd(-0.0);
+
+    for (; x + 2 <= width - 2; x += 2)
+    {
+        NvF64 out[2];
+        __m128d v;
+
+        v = _mm_xor_pd(sign, _mm_loadu_pd(tt + x - 1));
+        v = _mm_sub_pd(v, _mm_loadu_pd(tt + x));
+        v = _mm_sub_pd(v, _mm_loadu_pd(tt + x + 1));
+        v = _mm_sub_pd(v, _mm_loadu_pd(t + x - 2));
+        v = _mm_add_pd(v, _mm_loadu_pd(t + x - 1));
+        v = _mm_add_pd(v, _mm_mul_pd(k15, _mm_loadu_pd(t + x)));
+        v = _mm_add_pd(v, _mm_loadu_pd(t + x + 1));
+        v = _mm_sub_pd(v, _mm_loadu_pd(t + x + 2));
+        v = _mm_sub_pd(v, _mm_loadu_pd(c + x - 2));
+        v = _mm_add_pd(v, _mm_mul_pd(k15, _mm_loadu_pd(c + x - 1)));
+        v = _mm_add_pd(v, _mm_mul_pd(k2, _mm_loadu_pd(c + x)));
+        v = _mm_add_pd(v, _mm_mul_pd(k15, _mm_loadu_pd(c + x + 1)));
+        v = _mm_sub_pd(v, _mm_loadu_pd(c + x + 2));
+        v = _mm_sub_pd(v, _mm_loadu_pd(b + x - 2));
+        v = _mm_add_pd(v, _mm_loadu_pd(b + x - 1));
+        v = _mm_add_pd(v, _mm_mul_pd(k15, _mm_loadu_pd(b + x)));
+        v = _mm_add_pd(v, _mm_loadu_pd(b + x + 1));
+        v = _mm_sub_pd(v, _mm_loadu_pd(b + x + 2));
+        v = _mm_sub_pd(v, _mm_loadu_pd(bb + x - 1));
+        v = _mm_sub_pd(v, _mm_loadu_pd(bb + x));
+        v = _mm_sub_pd(v, _mm_loadu_pd(bb + x + 1));
+        v = _mm_andnot_pd(sign, v);
+
+        _mm_storeu_pd(out, v);
+        pSum->Add(out[0]);
+        pSum->Add(out[1]);
+    }
+#endif
+
+    for (; x < width - 2; x++)
+    {
+        NvF64 v = -tt[x - 1] - tt[x] - tt[x + 1] +
+            -t[x - 2] + t[x - 1] + 1.5 * t[x] + t[x + 1] - t[x + 2] +
+            -c[x - 2] + 1.5 * c[x - 1] + 2 * c[x] + 1.5 * c[x + 1] - c[x + 2] +
+            -b[x - 2] + b[x - 1] + 1.5 * b[x] + b[x + 1] - b[x + 2] +
+            -bb[x - 1] - bb[x] - bb[x + 1];
+
+        pSum->Add(fabs(v));
+    }
+}
+
+NvError NvRawSharpness5x5(const NvF64 *pY, NvS32 width, NvS32 height,
+    NvF64 *pSharpness)
+{
+    NvRawFsum sum;
+    NvS32 y;
+
+    for (y = 2; y < height - 2; y++)
+    {
+        const NvF64 *c = pY + (size_t)y * width;
+
+        FilterRow(c - 2 * width, c - width, c, c + width, c + 2 * width,
+            width, &sum);
+    }
+
+    return sum.Result(pSharpness);
+}
+
+NvError NvRawSharpness(const NvS16 *pPixels, NvS32 width, NvS32 height,
+    const char *bayerPhase, NvF64 *pSharpness)
+{
+    NvS32 startRow, startCol, yWidth, yHeight, y, i;
+    NvF64 *pRows, *rows[5];
+    NvRawFsum sum;
+    NvError err;
+
+    err = GetRStart(bayerPhase, &startRow, &startCol);
+    if (err != NvSuccess)
+        return err;
+    yWidth = HalfFloor(width - startCol);
+    yHeight = HalfFloor(height - startRow);
+    if (yWidth < 5 || yHeight < 5)
+    {
+        *pSharpness = 0.0;
+        return NvSuccess;
+    }
+
+    // The five Y rows under the filter, reused round robin
+    pRows = (NvF64 *)malloc(5 * (size_t)yWidth * sizeof(NvF64));
+    if (!pRows)
+        return NvError_InsufficientMemory;
+
+    for (y = 0; y < yHeight; y++)
+    {
+        const NvS16 *pTop = pPixels + (size_t)(startRow + 2 * y) * width +
+            startCol;
+
+        ConvertRowToY(pTop, pTop + width, yWidth,
+            pRows + (size_t)(y % 5) * yWidth);
+        if (y < 4)
+            continue;
+
+        for (i = 0; i < 5; i++)
+            rows[i] = pRows + (size_t)((y - 4 + i) % 5) * yWidth;
+        FilterRow(rows[0], rows[1], rows[2], rows[3], rows[4], yWidth, &sum);
+    }
+
+    free(pRows);
+    return sum.Result(pSharpness);
+}
+
+NvError NvRawCrop(const NvS16 *pPixels, NvS32 width, NvS32 height,
+    NvS32 x, NvS32 y, NvS32 cropWidth, NvS32 cropHeight, NvS16 *pOut)
+{
+    NvS32 i;
+
+    if (x < 0 || y < 0 || cropWidth < 0 || cropHeight < 0 ||
+        x + cropWidth > width || y + cropHeight > height)
+        return NvError_BadParameter;
+
+    for (i = 0; i < cropHeight; i++)
+    {
+        memcpy(pOut + (size_t)i * cropWidth,
+            pPixels + (size_t)(y + i) * width + x,
+            (size_t)cropWidth * sizeof(NvS16));
+    }
+
+    return NvSuccess;
+}
+
+NvError NvRawHistogram(const NvS16 *pPixels, NvS32 width, NvS32 height,
+    const char *bayerPhase, NvU32 bitsPerSample, NvU32 bins,
+    NvU32 *pHistograms[NvRawChannel_Num])
+{
+    NvU32 *channel[4];
+    NvS32 maxValue, row, col, i;
+
+    if (!bayerPhase || strlen(bayerPhase) != 4 ||
+        bitsPerSample < 1 || bitsPerSample > 16 || bins < 1)
+        return NvError_BadParameter;
+
+    // Channel of each position in the quad; a G shares its row with an R
+    // (Gr) or with a B (Gb)
+    for (i = 0; i < 4; i++)
+    {
+        switch (bayerPhase[i])
+        {
+            case 'R':
+                channel[i] = pHistograms[NvRawChannel_R];
+                break;
+            case 'B':
+                channel[i] = pHistograms[NvRawChannel_B];
+                break;
+            case 'G':
+                channel[i] = bayerPhase[i ^ 1] == 'R' ?
+                    pHistograms[NvRawChannel_Gr] :
+                    pHistograms[NvRawChannel_Gb];
+                break;
+            default:
+                return NvError_BadParameter;
+        }
+    }
+
+    for (i = 0; i < NvRawChannel_Num; i++)
+        memset(pHistograms[i], 0, bins * sizeof(NvU32));
+
+    maxValue = (1 << bitsPerSample) - 1;
+    for (row = 0; row < height; row++)
+    {
+        const NvS16 *p = pPixels + (size_t)row * width;
+        NvU32 **quad = channel + 2 * (row & 1);
+
+        for (col = 0; col < width; col++)
+        {
+            NvS32 value = p[col];
+
+            if (value < 0)
+                value = 0;
+            else if (value > maxValue)
+                value = maxValue;
+            quad[col & 1][((NvU64)value * bins) >> bitsPerSample]++;
+        }
+    }
+
+    return NvSuccess;
+}
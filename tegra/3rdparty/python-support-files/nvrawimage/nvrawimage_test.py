@@ -0,0 +1,219 @@
+#
+# Copyright (c) 2014, NVIDIA Corporation.  All rights reserved.
+#
+# NVIDIA Corporation and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA Corporation is strictly prohibited.
+#
+#!/usr/bin/env python
+
+"""Checks _nvrawimage against the Python code it replaces.
+
+Legacy and chunky files written here must load to the same NvRawFile
+fields with and without the module, and Y conversion, sharpness, cropping
+and histograms must give the same values to the bit, for every bayer phase
+and for odd image sizes. The time of calculateSharpness() is printed for
+both.
+
+usage: nvrawimage_test.py [width height]
+"""
+
+import array
+import copy
+import os
+import random
+import struct
+import sys
+import tempfile
+import time
+
+import nvrawfile
+import nvcameraimageutils
+
+PHASES = ['RGGB', 'GRBG', 'GBRG', 'BGGR']
+SIZES = [(0, 0), (3, 3), (9, 7), (10, 10), (17, 12), (64, 48), (101, 77)]
+
+def useNative(native):
+    "Switches both modules between the native and the Python implementation"
+    module = native and _nvrawimage or None
+    nvrawfile._nvrawimage = module
+    nvcameraimageutils._nvrawimage = module
+
+def makePixels(count, seed):
+    rand = random.Random(seed)
+    pixels = array.array('h', [rand.randint(0, 1023) for i in range(count)])
+    # a few samples out of the 10 bit range for the histograms
+    for i in range(0, count, 97):
+        pixels[i] = rand.choice([-32768, -1, 1024, 32767])
+    return pixels
+
+def makeChunk(uuid, data):
+    return uuid + '\0' * 16 + struct.pack('<L', len(data)) + data
+
+def makeString(s):
+    return struct.pack('<l', len(s)) + s
+
+def writeChunkyFile(path, width, height, phase, pixels, misalign):
+    header = struct.pack('<lllllllll', width, height,
+                         nvrawfile.getBayerPhaseNumber(phase), 10, 1, 1, 0, 0, 0)
+    chunks = [makeChunk(nvrawfile.NvRawFileHeaderChunkUuid, header)]
+    if misalign:
+        # unknown chunk of odd length, leaving the samples unaligned
+        chunks.append(makeChunk('UNKNOWN___140101', 'x'))
+    capture = struct.pack('<LffLlfffffffff', 4, 0.033, 0.0, 400, -12, 1.0,
+                          2.0, 1.5, 1.25, 1.0, 2.0, 0.0, 0.0, 30.0)
+    capture += struct.pack('<L', 0) + makeString('int16')
+    chunks.append(makeChunk(nvrawfile.NvRawFileCaptureChunkUuid, capture))
+    chunks.append(makeChunk(nvrawfile.NvRawFileCameraStateChunkUuid,
+                            struct.pack('<llffff', 1, 2, 1.0, 1.5, 1.75, 2.0)))
+    chunks.append(makeChunk(nvrawfile.NvRawFileSensorInfoChunkUuid,
+                            struct.pack('<l', 1) + makeString('OV5693') +
+                            makeString('0123456789abcdef')))
+    hdr = struct.pack('<ll', 1, 2) + makeString('ROW')
+    for symbol, exposure in (('L', 0.03), ('S', 0.001)):
+        hdr += struct.pack('<4s', symbol)
+        hdr += struct.pack('<fffffffff', exposure, 1.0, 2.0, 3.0, 4.0,
+                           1.1, 1.2, 1.3, 1.4)
+    chunks.append(makeChunk(nvrawfile.NvRawFileHDRChunkUuid, hdr))
+    chunks.append(makeChunk(nvrawfile.NvRawFileDataChunkUuid,
+                            struct.pack('<ll', 1, 0) + pixels.tostring()))
+    f = open(path, 'wb')
+    f.write(''.join(chunks))
+    f.close()
+
+def writeLegacyFile(path, width, height, phase, pixels):
+    nvrf = nvrawfile.NvRawFile()
+    nvrf._width = width
+    nvrf._height = height
+    nvrf._bayerPhase = phase
+    nvrf._exposureTime = 0.0335
+    nvrf._iso = 200
+    nvrf._awbConvergeStatus = 1
+    nvrf._awbGains = [1.5, 1.0, 1.0, 2.25]
+    f = open(path, 'wb')
+    f.write(nvrf.makeLegacyHeader().tostring() + pixels.tostring())
+    f.close()
+
+def fields(nvrf):
+    "Everything loaded into an NvRawFile, in comparable form"
+    result = dict(vars(nvrf))
+    result['_pixelData'] = nvrf._pixelData.tostring()
+    result['_hdrExposureInfos'] = [vars(info) for info in nvrf._hdrExposureInfos]
+    return result
+
+def loadBoth(path):
+    results = []
+    for native in (False, True):
+        useNative(native)
+        nvrf = nvrawfile.NvRawFile()
+        loaded = nvrf.readFile(path)
+        results.append((loaded, fields(nvrf)))
+    return results
+
+def bits(value):
+    return struct.pack('<d', value)
+
+def runBoth(function, *args):
+    "Calls function with copies of args, with and without the module"
+    results = []
+    for native in (False, True):
+        useNative(native)
+        results.append(function(*copy.deepcopy(args)))
+    return results
+
+def checkFiles(tmpdir):
+    ok = True
+    for width, height in SIZES:
+        for phase in PHASES:
+            pixels = makePixels(width * height, width * 1000 + height)
+            for kind in ('legacy', 'chunky', 'unaligned'):
+                path = os.path.join(tmpdir, '%s_%dx%d_%s.nvraw' % (kind, width, height, phase))
+                if kind == 'legacy':
+                    writeLegacyFile(path, width, height, phase, pixels)
+                else:
+                    writeChunkyFile(path, width, height, phase, pixels,
+                                    kind == 'unaligned')
+                python, native = loadBoth(path)
+                if not python[0] or python != native:
+                    print "%s load FAILED" % path
+                    ok = False
+                os.remove(path)
+    return ok
+
+def checkMetrics():
+    ok = True
+    for width, height in SIZES:
+        for phase in PHASES:
+            nvrf = nvcameraimageutils.createTestNvRawFile(width, height, phase, 0)
+            nvrf._pixelData = makePixels(width * height, width + height)
+            name = '%dx%d %s' % (width, height, phase)
+
+            python, native = runBoth(nvcameraimageutils._convertRawToY, nvrf)
+            if python[1:] != native[1:] or python[0].tostring() != native[0].tostring():
+                print "%s Y FAILED" % name
+                ok = False
+
+            y, yWidth, yHeight = python
+            python, native = runBoth(nvcameraimageutils._sharpnessMeasure_Apply5x5Filter,
+                                     y, yWidth, yHeight)
+            if bits(python) != bits(native):
+                print "%s sharpness5x5 FAILED: %r %r" % (name, python, native)
+                ok = False
+
+            python, native = runBoth(nvcameraimageutils.calculateSharpness, nvrf)
+            if bits(python) != bits(native):
+                print "%s sharpness FAILED: %r %r" % (name, python, native)
+                ok = False
+
+            def crop(nvrf):
+                nvcameraimageutils.cropRawImageFromCenter(nvrf, width / 2 + 1, height / 3 + 1)
+                return fields(nvrf)
+            python, native = runBoth(crop, nvrf)
+            if python != native:
+                print "%s crop FAILED" % name
+                ok = False
+
+            for bins in (1, 7, 256, 1024):
+                python, native = runBoth(nvcameraimageutils.calculateHistogram, nvrf, bins)
+                if python != native:
+                    print "%s histogram %d FAILED" % (name, bins)
+                    ok = False
+    return ok
+
+def benchSharpness(width, height):
+    nvrf = nvcameraimageutils.createTestNvRawFile(width, height, 'RGGB', 0)
+    nvrf._pixelData = makePixels(width * height, 1)
+    times = []
+    for native in (False, True):
+        useNative(native)
+        start = time.time()
+        nvcameraimageutils.calculateSharpness(nvrf)
+        times.append(time.time() - start)
+    print "calculateSharpness %dx%d: python %.3f s, native %.4f s" % (
+        width, height, times[0], times[1])
+
+if __name__ == '__main__':
+    try:
+        import _nvrawimage
+    except ImportError:
+        print "_nvrawimage is not installed"
+        print "FAILED"
+        sys.exit(1)
+
+    width, height = 640, 480
+    if len(sys.argv) == 3:
+        width, height = int(sys.argv[1]), int(sys.argv[2])
+
+    tmpdir = tempfile.mkdtemp()
+    ok = checkFiles(tmpdir)
+    os.rmdir(tmpdir)
+    ok = checkMetrics() and ok
+    benchSharpness(width, height)
+
+    if ok:
+        print "PASSED"
+    else:
+        print "FAILED"
+    sys.exit(not ok and 1 or 0)
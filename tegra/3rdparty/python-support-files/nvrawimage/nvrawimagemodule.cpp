@@ -0,0 +1,495 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+/*
+ * _nvrawimage: Python binding of nvrawimage.h, used by nvrawfile.py and
+ * nvcameraimageutils.py when it is installed.
+ *
+ * Images are passed as array.array objects ('h' for raw samples, 'd' for
+ * Y) and read in place through the buffer interface. Python 2.6 is the
+ * oldest interpreter this has to load in.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "nvrawimage.h"
+
+static PyObject *s_ArrayType;
+
+// Raises the exception matching a failed call
+static PyObject *SetError(NvError err)
+{
+    switch (err)
+    {
+        case NvError_InsufficientMemory:
+            return PyErr_NoMemory();
+        case NvError_FileOperationFailed:
+            return PyErr_SetFromErrno(PyExc_IOError);
+        case NvError_EndOfFile:
+            PyErr_SetString(PyExc_ValueError, "NvRaw file is truncated");
+            return NULL;
+        case NvError_InvalidSize:
+            PyErr_SetString(PyExc_ValueError, "NvRaw file is malformed");
+            return NULL;
+        case NvError_BadParameter:
+            PyErr_SetString(PyExc_ValueError, "unsupported bayer phase");
+            return NULL;
+        case NvError_BadValue:
+            PyErr_SetString(PyExc_OverflowError,
+                "intermediate overflow in fsum");
+            return NULL;
+        default:
+            PyErr_Format(PyExc_RuntimeError, "NvError 0x%x", err);
+            return NULL;
+    }
+}
+
+// Samples of an array, checked to hold at least count of them
+static const void *GetSamples(PyObject *array, size_t itemSize,
+    Py_ssize_t count)
+{
+    const void *data;
+    Py_ssize_t length;
+
+    if (PyObject_AsReadBuffer(array, &data, &length) < 0)
+        return NULL;
+    if (count < 0 || length / (Py_ssize_t)itemSize < count)
+    {
+        PyErr_SetString(PyExc_IndexError, "array index out of range");
+        return NULL;
+    }
+
+    return data;
+}
+
+// array.array(typecode, data), which copies data
+static PyObject *NewArray(const char *typecode, const void *data,
+    size_t bytes)
+{
+    PyObject *string, *array;
+
+    string = PyString_FromStringAndSize((const char *)data,
+        (Py_ssize_t)bytes);
+    if (!string)
+        return NULL;
+    array = PyObject_CallFunction(s_ArrayType, (char *)"sO", typecode,
+        string);
+    Py_DECREF(string);
+
+    return array;
+}
+
+// What struct.unpack gives for a 32 bit field: an int, or a long where the
+// value does not fit
+static PyObject *NewInteger(NvS64 value)
+{
+    if (value >= LONG_MIN && value <= LONG_MAX)
+        return PyInt_FromLong((long)value);
+    return PyLong_FromLongLong(value);
+}
+
+static PyObject *NewGains(const NvF32 *gains)
+{
+    return Py_BuildValue("(dddd)", (double)gains[0], (double)gains[1],
+        (double)gains[2], (double)gains[3]);
+}
+
+static PyObject *NewString(const NvRawString &s)
+{
+    return PyString_FromStringAndSize(s.Length ? s.Data : "",
+        (Py_ssize_t)s.Length);
+}
+
+// Stores value (which may be NULL after a failed call) and drops the
+// reference to it
+static bool SetItem(PyObject *dict, const char *key, PyObject *value)
+{
+    int ret;
+
+    if (!value)
+        return false;
+    ret = PyDict_SetItemString(dict, key, value);
+    Py_DECREF(value);
+
+    return ret == 0;
+}
+
+static bool FillInfo(PyObject *dict, const NvRawImageInfo &info)
+{
+    NvU32 i;
+
+    if (info.LegacyVersion &&
+        !SetItem(dict, "legacyVersion", PyInt_FromLong(info.LegacyVersion)))
+        return false;
+
+    if (info.Present & NvRawInfo_Header)
+    {
+        if (!SetItem(dict, "_width", PyInt_FromLong(info.Width)) ||
+            !SetItem(dict, "_height", PyInt_FromLong(info.Height)) ||
+            !SetItem(dict, "_bayerPhase",
+                PyString_FromStringAndSize(info.BayerPhase, 4)) ||
+            !SetItem(dict, "_bitsPerSample",
+                PyInt_FromLong(info.BitsPerSample)))
+            return false;
+    }
+
+    if (info.Present & NvRawInfo_Pixels)
+    {
+        if (!SetItem(dict, "_pixelData", NewArray("h", info.Pixels,
+            (size_t)info.NumPixels * sizeof(NvS16))))
+            return false;
+    }
+
+    if (info.Present & NvRawInfo_Capture)
+    {
+        if (!SetItem(dict, "_exposureTime",
+                PyFloat_FromDouble(info.ExposureTime)) ||
+            !SetItem(dict, "_iso", NewInteger(info.Iso)) ||
+            !SetItem(dict, "_focusPosition",
+                NewInteger(info.FocusPosition)) ||
+            !SetItem(dict, "_sensorGains", NewGains(info.SensorGains)))
+            return false;
+    }
+
+    if (info.Present & NvRawInfo_PixelFormat)
+    {
+        if (!SetItem(dict, "_pixelFormat", NewString(info.PixelFormat)))
+            return false;
+    }
+
+    if (info.Present & NvRawInfo_CameraState)
+    {
+        if (!SetItem(dict, "_awbConvergeStatus",
+                NewInteger(info.AwbConvergeStatus)) ||
+            !SetItem(dict, "_awbGains", NewGains(info.AwbGains)))
+            return false;
+    }
+
+    if (info.Present & NvRawInfo_SensorInfo)
+    {
+        if (!SetItem(dict, "_sensorId", NewString(info.SensorId)) ||
+            !SetItem(dict, "_fuseId", NewString(info.FuseId)))
+            return false;
+    }
+
+    if (info.Present & NvRawInfo_Hdr)
+    {
+        PyObject *list = PyList_New(info.HdrExposureCount);
+
+        if (!SetItem(dict, "_hdrNumberOfExposures",
+                PyInt_FromLong(info.HdrNumberOfExposures)) ||
+            !SetItem(dict, "_hdrReadoutScheme",
+                NewString(info.HdrReadoutScheme)))
+        {
+            Py_XDECREF(list);
+            return false;
+        }
+        if (!list)
+            return false;
+
+        // (symbol, exposureTime, analogGains, digitalGains) each, to be
+        // made into hdrInfo objects by nvrawfile.py
+        for (i = 0; i < info.HdrExposureCount; i++)
+        {
+            const NvRawHdrExposure *e = &info.HdrExposures[i];
+            PyObject *item = Py_BuildValue("(s#dNN)", e->Symbol,
+                (Py_ssize_t)sizeof(e->Symbol), (double)e->ExposureTime,
+                NewGains(e->AnalogGains), NewGains(e->DigitalGains));
+
+            if (!item)
+            {
+                Py_DECREF(list);
+                return false;
+            }
+            PyList_SET_ITEM(list, i, item);
+        }
+        if (!SetItem(dict, "hdrExposureInfos", list))
+            return false;
+    }
+
+    return true;
+}
+
+PyDoc_STRVAR(ReadFileDoc,
+"readFile(filename) -> dict or None\n\n"
+"Reads a legacy or chunky NvRaw file. The dictionary holds the NvRawFile\n"
+"attributes the file sets, plus 'legacyVersion' for legacy files and\n"
+"'hdrExposureInfos' for HDR ones. None if this is not an NvRaw file.");
+
+static PyObject *ReadFile(PyObject *self, PyObject *args)
+{
+    const char *filename;
+    NvRawImage image;
+    PyObject *dict;
+    NvError err;
+
+    if (!PyArg_ParseTuple(args, "s:readFile", &filename))
+        return NULL;
+
+    err = image.Open(filename);
+    if (err == NvError_BadValue)
+        Py_RETURN_NONE;
+    if (err != NvSuccess)
+        return SetError(err);
+
+    dict = PyDict_New();
+    if (dict && !FillInfo(dict, image.Info()))
+        Py_CLEAR(dict);
+
+    return dict;
+}
+
+PyDoc_STRVAR(ConvertRawToYDoc,
+"convertRawToY(pixels, width, height, bayerPhase) -> (y, yWidth, yHeight)\n\n"
+"One luma value per 2x2 Bayer quad, as an array('d').");
+
+static PyObject *ConvertRawToY(PyObject *self, PyObject *args)
+{
+    PyObject *pixels, *array;
+    const NvS16 *pPixels;
+    const char *phase;
+    int width, height;
+    NvS32 yWidth, yHeight;
+    size_t count;
+    NvF64 *pY;
+    NvError err;
+
+    if (!PyArg_ParseTuple(args, "Oiis:convertRawToY", &pixels, &width,
+        &height, &phase))
+        return NULL;
+
+    err = NvRawGetYSize(width, height, phase, &yWidth, &yHeight);
+    if (err != NvSuccess)
+        return SetError(err);
+    count = (yWidth > 0 && yHeight > 0) ? (size_t)yWidth * yHeight : 0;
+
+    pPixels = (const NvS16 *)GetSamples(pixels, sizeof(NvS16),
+        count ? (Py_ssize_t)width * height : 0);
+    if (!pPixels)
+        return NULL;
+
+    pY = (NvF64 *)PyMem_Malloc(count * sizeof(NvF64) + 1);
+    if (!pY)
+        return PyErr_NoMemory();
+    NvRawConvertToY(pPixels, width, height, phase, pY);
+    array = NewArray("d", pY, count * sizeof(NvF64));
+    PyMem_Free(pY);
+    if (!array)
+        return NULL;
+
+    return Py_BuildValue("(Nii)", array, yWidth, yHeight);
+}
+
+PyDoc_STRVAR(Sharpness5x5Doc,
+"sharpness5x5(y, width, height) -> float\n\n"
+"Focus measure of a Y image: the sum of the absolute 5x5 filter responses.");
+
+static PyObject *Sharpness5x5(PyObject *self, PyObject *args)
+{
+    PyObject *y;
+    const NvF64 *pY;
+    int width, height;
+    NvF64 sharpness = 0.0;
+    NvError err;
+
+    if (!PyArg_ParseTuple(args, "Oii:sharpness5x5", &y, &width, &height))
+        return NULL;
+
+    pY = (const NvF64 *)GetSamples(y, sizeof(NvF64),
+        (width > 0 && height > 0) ? (Py_ssize_t)width * height : 0);
+    if (!pY)
+        return NULL;
+
+    err = NvRawSharpness5x5(pY, width, height, &sharpness);
+    if (err != NvSuccess)
+        return SetError(err);
+
+    return PyFloat_FromDouble(sharpness);
+}
+
+PyDoc_STRVAR(SharpnessDoc,
+"sharpness(pixels, width, height, bayerPhase) -> float\n\n"
+"sharpness5x5() of the convertRawToY() image of a raw image.");
+
+static PyObject *Sharpness(PyObject *self, PyObject *args)
+{
+    PyObject *pixels;
+    const NvS16 *pPixels;
+    const char *phase;
+    int width, height;
+    NvS32 yWidth, yHeight;
+    NvF64 sharpness = 0.0;
+    NvError err;
+
+    if (!PyArg_ParseTuple(args, "Oiis:sharpness", &pixels, &width, &height,
+        &phase))
+        return NULL;
+
+    err = NvRawGetYSize(width, height, phase, &yWidth, &yHeight);
+    if (err != NvSuccess)
+        return SetError(err);
+
+    pPixels = (const NvS16 *)GetSamples(pixels, sizeof(NvS16),
+        (yWidth > 0 && yHeight > 0) ? (Py_ssize_t)width * height : 0);
+    if (!pPixels)
+        return NULL;
+
+    err = NvRawSharpness(pPixels, width, height, phase, &sharpness);
+    if (err != NvSuccess)
+        return SetError(err);
+
+    return PyFloat_FromDouble(sharpness);
+}
+
+PyDoc_STRVAR(CropDoc,
+"crop(pixels, width, x, y, cropWidth, cropHeight) -> array('h')\n\n"
+"The cropWidth by cropHeight rectangle at (x, y) of a raw image.");
+
+static PyObject *Crop(PyObject *self, PyObject *args)
+{
+    PyObject *pixels, *array;
+    const void *data;
+    Py_ssize_t length;
+    int width, height, x, y, cropWidth, cropHeight;
+    size_t count;
+    NvS16 *pOut;
+    NvError err;
+
+    if (!PyArg_ParseTuple(args, "Oiiiii:crop", &pixels, &width, &x, &y,
+        &cropWidth, &cropHeight))
+        return NULL;
+    if (PyObject_AsReadBuffer(pixels, &data, &length) < 0)
+        return NULL;
+    if (cropWidth < 0 || cropHeight < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "bad crop size");
+        return NULL;
+    }
+    height = width > 0 ? (int)(length / sizeof(NvS16) / width) : 0;
+    count = (size_t)cropWidth * cropHeight;
+
+    pOut = (NvS16 *)PyMem_Malloc(count * sizeof(NvS16) + 1);
+    if (!pOut)
+        return PyErr_NoMemory();
+    err = NvRawCrop((const NvS16 *)data, width, height, x, y, cropWidth,
+        cropHeight, pOut);
+    if (err != NvSuccess)
+    {
+        PyMem_Free(pOut);
+        PyErr_SetString(PyExc_IndexError, "crop outside of the image");
+        return NULL;
+    }
+    array = NewArray("h", pOut, count * sizeof(NvS16));
+    PyMem_Free(pOut);
+
+    return array;
+}
+
+PyDoc_STRVAR(HistogramDoc,
+"histogram(pixels, width, height, bayerPhase, bitsPerSample, bins)\n"
+"    -> (r, gr, gb, b)\n\n"
+"Histograms of the samples of each Bayer channel, as lists of bins counts.");
+
+static PyObject *Histogram(PyObject *self, PyObject *args)
+{
+    PyObject *pixels, *result = NULL;
+    const NvS16 *pPixels;
+    const char *phase;
+    int width, height;
+    unsigned int bits, bins;
+    NvU32 *pCounts, *histograms[NvRawChannel_Num];
+    NvU32 c, i;
+    NvError err;
+
+    if (!PyArg_ParseTuple(args, "OiisII:histogram", &pixels, &width,
+        &height, &phase, &bits, &bins))
+        return NULL;
+    if (width < 0 || height < 0)
+        width = height = 0;
+
+    pPixels = (const NvS16 *)GetSamples(pixels, sizeof(NvS16),
+        (Py_ssize_t)width * height);
+    if (!pPixels)
+        return NULL;
+    if (bins < 1 || bins > 65536 || bits < 1 || bits > 16)
+    {
+        PyErr_SetString(PyExc_ValueError, "bad sample size or bin count");
+        return NULL;
+    }
+
+    pCounts = (NvU32 *)PyMem_Malloc(NvRawChannel_Num * bins * sizeof(NvU32));
+    if (!pCounts)
+        return PyErr_NoMemory();
+    for (c = 0; c < NvRawChannel_Num; c++)
+        histograms[c] = pCounts + c * bins;
+
+    err = NvRawHistogram(pPixels, width, height, phase, bits, bins,
+        histograms);
+    if (err != NvSuccess)
+    {
+        PyMem_Free(pCounts);
+        return SetError(err);
+    }
+
+    result = PyTuple_New(NvRawChannel_Num);
+    for (c = 0; result && c < NvRawChannel_Num; c++)
+    {
+        PyObject *list = PyList_New(bins);
+
+        if (!list)
+        {
+            Py_CLEAR(result);
+            break;
+        }
+        PyTuple_SET_ITEM(result, c, list);
+        for (i = 0; i < bins; i++)
+        {
+            PyObject *count = PyInt_FromLong(histograms[c][i]);
+
+            if (!count)
+            {
+                Py_CLEAR(result);
+                break;
+            }
+            PyList_SET_ITEM(list, i, count);
+        }
+    }
+
+    PyMem_Free(pCounts);
+    return result;
+}
+
+static PyMethodDef s_Methods[] =
+{
+    { "readFile", ReadFile, METH_VARARGS, ReadFileDoc },
+    { "convertRawToY", ConvertRawToY, METH_VARARGS, ConvertRawToYDoc },
+    { "sharpness5x5", Sharpness5x5, METH_VARARGS, Sharpness5x5Doc },
+    { "sharpness", Sharpness, METH_VARARGS, SharpnessDoc },
+    { "crop", Crop, METH_VARARGS, CropDoc },
+    { "histogram", Histogram, METH_VARARGS, HistogramDoc },
+    { NULL, NULL, 0, NULL }
+};
+
+PyMODINIT_FUNC init_nvrawimage(void)
+{
+    PyObject *arrayModule;
+
+    arrayModule = PyImport_ImportModule("array");
+    if (!arrayModule)
+        return;
+    s_ArrayType = PyObject_GetAttrString(arrayModule, "array");
+    Py_DECREF(arrayModule);
+    if (!s_ArrayType)
+        return;
+
+    Py_InitModule3("_nvrawimage", s_Methods,
+        "Native NvRaw reader and image metrics for the nvcamera tools.");
+}
@@ -31,6 +31,48 @@ extern "C"
  * @{
  */
 
+/**
+ * Implementations of the CRC32 computation.
+ */
+typedef enum
+{
+    /// Picks the fastest implementation supported by the CPU.
+    NvCrc32Backend_Auto = 0,
+
+    /// One table lookup per byte.
+    NvCrc32Backend_Bytewise,
+
+    /// Eight table lookups per eight bytes.
+    NvCrc32Backend_Slice8,
+
+    /// ARMv8 CRC32 instructions, when the compiler targets them.
+    NvCrc32Backend_Armv8,
+
+    /// x86 carry-less multiply folding, when the CPU has PCLMULQDQ.
+    NvCrc32Backend_Pclmul,
+
+    /// Number of implementations -- Should appear after the last one.
+    NvCrc32Backend_Num,
+
+    /// Ignore -- Forces compilers to make 32-bit enums.
+    NvCrc32Backend_Force32 = 0x7FFFFFFF
+} NvCrc32Backend;
+
+/**
+ * Selects the implementation used by NvComputeCrc32(). All of them return
+ * the same values. Without a call to this, the fastest one is used.
+ *
+ * @param Backend The implementation to use.
+ *
+ * @retval NV_TRUE if selected, NV_FALSE if not supported by this build or CPU.
+ */
+NvBool NvCrc32SelectBackend(NvCrc32Backend Backend);
+
+/**
+ * Returns the implementation used by NvComputeCrc32().
+ */
+NvCrc32Backend NvCrc32GetBackend(void);
+
 /**
  * Computes CRC32 value of the submitted buffer.
  *
@@ -42,6 +84,36 @@ extern "C"
  */
 NvU32 NvComputeCrc32(NvU32 CrcInitVal, const NvU8 *buf, NvU32 size);
 
+/**
+ * Extends a CRC32 value over a run of zero bytes without reading them.
+ *
+ * Returns the same value as NvComputeCrc32() over  Length zero bytes, in
+ * time logarithmic in  Length.
+ *
+ * @param Crc CRC32 value of the data preceding the zeros.
+ * @param Length Number of zero bytes.
+ *
+ * @retval Returns the CRC32 value including the zeros.
+ */
+NvU32 NvComputeCrc32Zeros(NvU32 Crc, NvU64 Length);
+
+/**
+ * Combines the CRC32 values of two consecutive buffers.
+ *
+ * Returns the same value as NvComputeCrc32() over the first buffer followed
+ * by the second, so that parts of a large image can be checksummed
+ * separately, or in parallel, and merged. Takes time logarithmic in
+ *  Length2.
+ *
+ * @param Crc1 CRC32 value of the first buffer.
+ * @param Crc2 CRC32 value of the second buffer, computed with a zero
+ *     initial value.
+ * @param Length2 Size of the second buffer.
+ *
+ * @retval Returns the CRC32 value of both buffers.
+ */
+NvU32 NvComputeCrc32Combine(NvU32 Crc1, NvU32 Crc2, NvU64 Length2);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -61,6 +61,19 @@ extern "C"
 
 /** Define the download chunk size at one go. */
 #define NVFLASH_DOWNLOAD_CHUNK (1024 * 1024)
+
+/**
+ * Defines the largest number of data packets that may be in flight in
+ * windowed mode. See ::Nv3pSetWindowSize.
+ */
+#define NV3P_WINDOW_MAX (8)
+
+/**
+ * ::Nv3pDataSend flag: more data of the same transfer follows. In windowed
+ * mode the packet is then not waited for unless the window is full. The last
+ * packet of a transfer must be sent without this flag.
+ */
+#define NV3P_DATA_FLAG_MORE (0x1)
 /**
  * Defines the Nv3p commands. The first set of enums are supported by the
  * mini-loader. The second set, are only supported by the boot loader. The
@@ -157,6 +170,12 @@ typedef enum
 #if ENABLE_NVDUMPER
     Nv3pCommand_NvtbootRAMDump,
 #endif
+    /**
+     * Queries the largest window the server accepts for windowed data
+     * transfers. Servers that do not support windowed mode NACK it.
+     * Numbered explicitly as the commands above depend on the build.
+     */
+    Nv3pCommand_GetWindowSize = 0x100,
 
     /** Ignore -- Forces compilers to make 32-bit enums. */
     Nv3pCommand_Force32 = 0x7FFFFFFF,
@@ -172,6 +191,8 @@ typedef enum
 
     Nv3pNackCode_BadCommand,
     Nv3pNackCode_BadData,
+    /* Windowed mode only: resend every packet after the NACKed sequence. */
+    Nv3pNackCode_Retransmit,
 
     /** Ignore -- Forces compilers to make 32-bit enums. */
     Nv3pNackCode_Force32 = 0x7FFFFFFF,
@@ -960,6 +981,14 @@ typedef struct Nv3pCmdGetNv3pServerVersionRec
     char Version[NV3P_STRING_MAX];
 } Nv3pCmdGetNv3pServerVersion;
 
+/**
+ * Gets the largest window the server accepts for windowed data transfers.
+ */
+typedef struct Nv3pCmdGetWindowSizeRec
+{
+    NvU32 WindowSize;
+} Nv3pCmdGetWindowSize;
+
 /*
  * Gives the length of the keys.
  */
@@ -1097,10 +1126,16 @@ Nv3pCommandComplete(
 /**
  * Sends a data packet.
  *
+ * In windowed mode (see ::Nv3pSetWindowSize) the data is sent as one or
+ * more windowed packets of at most ::NVFLASH_DOWNLOAD_CHUNK bytes, and the
+ * call only waits for the receiver when the window is full or when \a flags
+ * does not have ::NV3P_DATA_FLAG_MORE set. Packets the receiver NACKs for
+ * retransmission are resent from the window.
+ *
  * @param h3p A handle to the socket state.
  * @param data The data to send.
  * @param length The length of the data in bytes.
- * @param flags Reserved, must be zero.
+ * @param flags Zero or ::NV3P_DATA_FLAG_MORE.
  *
  * @return NvSuccess if the receiver ACKs the packet or a NACK
  * error code if not. This is a blocking interface.
@@ -1163,6 +1198,34 @@ Nv3pNack(
     Nv3pSocketHandle h3p,
     Nv3pNackCode code );
 
+/**
+ * Ends a data send that stops before its last packet.
+ *
+ * Call this when a transfer started with ::NV3P_DATA_FLAG_MORE cannot be
+ * completed. In windowed mode, packets still in flight are dropped without
+ * waiting for their ACK. The receiver is still waiting for the rest of the
+ * transfer, so the socket then fails every command and data send with
+ * NvError_Nv3pUnrecoverableProtocol. Does nothing if no packet is in flight.
+ *
+ * @param h3p A handle to the socket state.
+ */
+void
+Nv3pDataSendAbort( Nv3pSocketHandle h3p );
+
+/**
+ * Sets the number of data packets ::Nv3pDataSend may have in flight.
+ *
+ * Only call this once the peer reported support for windowed mode through
+ * ::Nv3pCommand_GetWindowSize, with at most the size it returned. Data
+ * packets are received in either mode without any setup.
+ *
+ * @param h3p A handle to the socket state.
+ * @param WindowSize Packets in flight, 1 disables windowed mode. Clamped to
+ *    ::NV3P_WINDOW_MAX.
+ */
+NvError
+Nv3pSetWindowSize( Nv3pSocketHandle h3p, NvU32 WindowSize );
+
 /**
  * Retreives the last NACK code.
  *
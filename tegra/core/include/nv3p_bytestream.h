@@ -203,6 +203,40 @@ extern "C"
  * @par error code
  *
  *      The failing condition code (see nv3p_status.h for failure codes).
+ *
+ * <h3>Windowed Data Packets</h3>
+ *
+ *      When both sides support it (negotiated with a command, see nv3p.h),
+ *      write data may be sent as windowed data packets. The sender does not
+ *      wait for an ACK after each of them. Instead it sets the ack request
+ *      flag on the packet that fills its window or ends the transfer, and
+ *      waits for one cumulative ACK. The ACK carries the sequence number of
+ *      the last packet received in order.
+ *
+ *      The receiver drops a windowed packet with a bad checksum or an
+ *      unexpected sequence number, and every later windowed packet, until
+ *      the next packet requesting an ACK. It answers that packet with a NACK
+ *      that carries the sequence number of the last good packet and the
+ *      retransmit code. The sender then resends every packet after it.
+ *
+ * @par Windowed Data Header
+ *
+ * <pre>
+ *
+ *  0                   1                   2                   3
+ *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * | length                                                        |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * | flags                                                         |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * | data ...                                                      |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * </pre>
+ *
+ * @par flags
+ *
+ *      NV3P_WINDOW_FLAG_ACK_REQUEST if the receiver must answer the packet.
  */
 
 /**
@@ -215,6 +249,10 @@ extern "C"
 #define NV3P_PACKET_SIZE_FOOTER     (1 * 4)
 #define NV3P_PACKET_SIZE_ACK        (0 * 4)
 #define NV3P_PACKET_SIZE_NACK       (1 * 4)
+#define NV3P_PACKET_SIZE_WINDOW_DATA (2 * 4)
+
+/** Windowed data flag: the sender waits for an ACK or NACK of this packet. */
+#define NV3P_WINDOW_FLAG_ACK_REQUEST (0x1)
 
 /**
  * Defines the packet type in the Nv3p bytestream basic header.
@@ -226,6 +264,7 @@ typedef enum
     Nv3pByteStream_PacketType_Encrypted,
     Nv3pByteStream_PacketType_Ack,
     Nv3pByteStream_PacketType_Nack,
+    Nv3pByteStream_PacketType_WindowData,
 
     Nv3pByteStream_PacketType_Force32 = 0x7FFFFFFF,
 } Nv3pByteStream_PacketType;
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2011-2013 NVIDIA Corporation.  All rights reserved.
+ * Copyright (c) 2011-2014 NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -28,6 +28,22 @@ typedef struct _BigIntModulus
     NvU32 r2[BIGINT_MAX_DW];
 } NvBigIntModulus;
 
+/**
+* Private key in Chinese Remainder Theorem form, for signing with two
+* exponentiations of half the size
+*/
+typedef struct _RSACrtKey
+{
+    NvBigIntModulus n;          /* p * q */
+    NvBigIntModulus p;
+    NvBigIntModulus q;
+    NvU32 d[BIGINT_MAX_DW];     /* private exponent */
+    NvU32 dp[BIGINT_MAX_DW];    /* d mod (p - 1) */
+    NvU32 dq[BIGINT_MAX_DW];    /* d mod (q - 1) */
+    NvU32 qinv[BIGINT_MAX_DW];  /* q^-1 mod p */
+    NvU32 e;                    /* public exponent */
+} NvRSACrtKey;
+
 /**
 *   @param Dgst Message digest for which signature needs to be generated
 *   @param PrivKeyN Private key modulus
@@ -81,4 +97,16 @@ void NvRSAInitModulusFromPQ(NvBigIntModulus* n, NvU32* p, NvU32* q, NvU32 bitSiz
 */
 void NvRSAPrivateKeyGeneration(NvU32* result, NvU32* e, NvU8* p, NvU8* q, NvU32 digit);
 
+/**
+* Sets up the CRT form of a private key.
+* @param key CRT key to initialize
+* @param p one of the prime numbers, little endian digits
+* @param q another prime number, little endian digits
+* @param d private exponent from NvRSAPrivateKeyGeneration()
+* @param e public exponent
+* @param digit number of digits of the modulus; p and q have half of them
+*/
+void NvRSAInitCrtKey(NvRSACrtKey* key, const NvU32* p, const NvU32* q,
+                     const NvU32* d, NvU32 e, NvU32 digit);
+
 #endif  /*  #ifdef __NV_RSA_H__ */
@@ -47,6 +47,10 @@ typedef enum
     ///     for CBC spec, and see NIST Special Publication 800-38A.
     NvCryptoCipherAlgoType_AesCbc,
     NvCryptoCipherAlgoType_AesEcb,
+    /// AES in Counter (CTR) mode, see NIST Special Publication 800-38A.
+    ///     The initial vector is the initial 128-bit big-endian counter
+    ///     block; padding does not apply.
+    NvCryptoCipherAlgoType_AesCtr,
     NvCryptoCipherAlgoType_Num,
     NvCryptoCipherAlgoType_Max = 0x7fffffff
 } NvCryptoCipherAlgoType;
@@ -176,6 +176,20 @@ typedef enum NvCPR_AccessTypeRec {
         NvCPR_GetRTCPSdesPriv,
         /// To get latest stream timestamps received from the server.
         NvCPR_GetTimeStamps,
+        /// To map the whole content read-only into the caller's address space.
+        /// The mapping stays valid until the content is closed. Reading pages
+        /// that are gone from the file does not raise SIGBUS, the pages read
+        /// as zeros and NvCPR_MappedContent::pFaulted is set instead.
+        /// Uses NvCPR_MappedContent data.
+        NvCPR_ConfigGetMappedContent,
+        /// Hints that a range of the mapped content will be read soon, so
+        /// that it can be paged in ahead of the reader.
+        /// Uses NvCPR_MappedRange data.
+        NvCPR_ConfigMappedWillNeed,
+        /// Returns what identifies the content independent of the handle and
+        /// the name it was opened by, so that readers of the same content
+        /// can share a cache. Uses NvCPR_ContentId data.
+        NvCPR_ConfigGetContentId,
         NvCPR_ConfigMax = 0X7FFFFFFF
     } NvCPR_ConfigQueryType;
 
@@ -189,6 +203,30 @@ typedef struct CP_QueryConfigTS
     NvBool bVideo;
 }CP_QueryConfigTS;
 
+typedef struct NvCPR_MappedContentRec
+{
+    NvU8 *pBase;    // read-only, must not be written to
+    NvU64 nSize;
+    // Set once a read of the mapping faulted (file truncated or its media
+    // removed); the faulting pages read as zeros from then on.
+    const volatile NvU32 *pFaulted;
+}NvCPR_MappedContent;
+
+typedef struct NvCPR_MappedRangeRec
+{
+    NvU64 nOffset;
+    NvU64 nSize;
+}NvCPR_MappedRange;
+
+// Equal ids mean equal bytes: a file rewritten in place changes nModTime
+typedef struct NvCPR_ContentIdRec
+{
+    NvU64 nDevice;
+    NvU64 nInode;
+    NvU64 nSize;
+    NvU64 nModTime;
+}NvCPR_ContentId;
+
 
 #define NV_CUSTOM_PROTOCOL_VERSION 2
 
@@ -190,6 +190,19 @@ typedef enum
      */
     NvFileSystemIoctlType_WriteTagDataDisable,
 
+    /**
+     * Trim erase the sectors lying entirely inside the next NumBytes bytes of
+     * a file open for writing, so data that is not going to be written does
+     * not survive from a previous image. The file position is not changed
+     * and a partially covered sector is left untouched.
+     *
+     * inputs: NvFileSystemIoctl_TrimEraseInputArgs
+     * outputs: none
+     *
+     * @retval NvError_NotSupported Current file system cannot trim
+     */
+    NvFileSystemIoctlType_TrimErase,
+
     NvFileSystemIoctlType_Num,
     NvFileSystemIoctlType_Force32 = 0x7FFFFFFF
 } NvFileSystemIoctlType;
@@ -331,6 +344,17 @@ typedef struct NvFileSystemIoctl_WriteTagDataDisableInputArgsRec
     NvBool TagDataWriteDisable;
 } NvFileSystemIoctl_WriteTagDataDisableInputArgs;
 
+/**
+ * TrimErase Ioctl
+ */
+
+///  Ioctl input arguments
+typedef struct NvFileSystemIoctl_TrimEraseInputArgsRec
+{
+    /// Number of bytes from the current file position
+    NvU64 NumBytes;
+} NvFileSystemIoctl_TrimEraseInputArgs;
+
 #if defined(__cplusplus)
 }
 #endif
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited
+ */
+
+/**
+ * @file
+ * <b> NVIDIA Operating System Abstraction: Futex Synchronization</b>
+ *
+ * @b Description: Process-local mutexes and semaphores built directly on
+ * Linux futexes. The objects are plain structures that can be embedded in
+ * other structures or defined statically; they need no allocation and no
+ * destroy call. Locking or posting without contention does not enter the
+ * kernel.
+ */
+
+#ifndef INCLUDED_NVOS_FUTEX_H
+#define INCLUDED_NVOS_FUTEX_H
+
+#include <pthread.h>
+#include "nvos.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif  /* __cplusplus */
+
+/**
+ * @defgroup nvos_futex_group Futex Synchronization Objects
+ *
+ * Only available on Linux. When libnvos is built with NVOS_USE_FUTEX set, the
+ * ::NvOsMutexHandle, ::NvOsConditionHandle and ::NvOsSemaphoreHandle objects
+ * are implemented with these as well.
+ *
+ * @ingroup nvos_group
+ * @{
+ */
+
+/** Default number of times a contended lock is retried before the thread
+ *  sleeps in the kernel. */
+#define NVOS_FUTEX_SPIN_DEFAULT 100
+
+/**
+ * Recursive mutex. Lockers spin for a while on contention, then sleep.
+ */
+typedef struct NvOsFutexMutexRec
+{
+    /* 0 unlocked, 1 locked, 2 locked and a thread may be sleeping */
+    volatile NvS32 State;
+    volatile pthread_t Owner;
+    NvU32 Count;
+    NvU32 SpinCount;
+} NvOsFutexMutex;
+
+/** Static initializer for ::NvOsFutexMutex. */
+#define NVOS_FUTEX_MUTEX_INITIALIZER { 0, 0, 0, NVOS_FUTEX_SPIN_DEFAULT }
+
+/**
+ * Counting semaphore.
+ */
+typedef struct NvOsFutexSemaphoreRec
+{
+    volatile NvS32 Value;
+    volatile NvS32 Waiters;
+} NvOsFutexSemaphore;
+
+/** Static initializer for ::NvOsFutexSemaphore with the given count. */
+#define NVOS_FUTEX_SEMAPHORE_INITIALIZER(value) { (value), 0 }
+
+/**
+ * Contention seen at one place a mutex is locked from.
+ */
+typedef struct NvOsFutexContentionRec
+{
+    /** Return address of the lock call. */
+    const void *Site;
+    /** Lock calls that found the mutex held. */
+    NvU32 Contended;
+    /** Of these, the calls that had to sleep. */
+    NvU32 Slept;
+    /** Time spent waiting for the mutex, in microseconds. */
+    NvU64 WaitUS;
+} NvOsFutexContention;
+
+/**
+ * Initializes a mutex.
+ *
+ * @param mutex The mutex to initialize.
+ * @param spinCount Number of times to retry a contended lock before
+ *     sleeping; 0 sleeps straight away.
+ */
+void NvOsFutexMutexInit(NvOsFutexMutex *mutex, NvU32 spinCount);
+
+/**
+ * Locks a mutex. The mutex is recursive; it must be unlocked as many times
+ * as it was locked.
+ *
+ * @param mutex The mutex to lock.
+ */
+void NvOsFutexMutexLock(NvOsFutexMutex *mutex);
+
+/**
+ * Locks a mutex if no other thread holds it.
+ *
+ * @param mutex The mutex to lock.
+ *
+ * @retval NV_TRUE The mutex was locked.
+ */
+NvBool NvOsFutexMutexTryLock(NvOsFutexMutex *mutex);
+
+/**
+ * Unlocks a mutex locked by the calling thread.
+ *
+ * @param mutex The mutex to unlock.
+ */
+void NvOsFutexMutexUnlock(NvOsFutexMutex *mutex);
+
+/**
+ * Initializes a semaphore.
+ *
+ * @param semaphore The semaphore to initialize.
+ * @param value The initial count.
+ */
+void NvOsFutexSemaphoreInit(NvOsFutexSemaphore *semaphore, NvU32 value);
+
+/**
+ * Waits until the count is non-zero and decrements it.
+ *
+ * @param semaphore The semaphore to wait on.
+ */
+void NvOsFutexSemaphoreWait(NvOsFutexSemaphore *semaphore);
+
+/**
+ * Waits for the semaphore for up to the given time.
+ *
+ * @param semaphore The semaphore to wait on.
+ * @param msec Timeout in milliseconds, or ::NV_WAIT_INFINITE.
+ *
+ * @retval NvError_Timeout The count stayed at zero.
+ */
+NvError NvOsFutexSemaphoreWaitTimeout(NvOsFutexSemaphore *semaphore,
+    NvU32 msec);
+
+/**
+ * Increments the count, waking a waiting thread.
+ *
+ * @param semaphore The semaphore to signal.
+ */
+void NvOsFutexSemaphoreSignal(NvOsFutexSemaphore *semaphore);
+
+/**
+ * Returns the lock call sites that saw contention, most contended first.
+ * Sites are only recorded once a lock call has found its mutex held.
+ *
+ * @param stats Filled with up to @a max entries.
+ * @param max Size of @a stats.
+ *
+ * @return The number of entries filled in.
+ */
+NvU32 NvOsFutexGetContention(NvOsFutexContention *stats, NvU32 max);
+
+/**
+ * Clears the contention counters.
+ */
+void NvOsFutexResetContention(void);
+
+/**
+ * Prints the contended lock call sites with NvOsDebugPrintf, resolving them
+ * to symbols where possible.
+ */
+void NvOsFutexDumpContention(void);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif  /* __cplusplus */
+
+#endif // INCLUDED_NVOS_FUTEX_H
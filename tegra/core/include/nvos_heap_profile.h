@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited
+ */
+
+/**
+ * @file
+ * <b> NVIDIA Operating System Abstraction: Heap Profiling</b>
+ *
+ * @b Description: Per call site accounting of the memory allocated with
+ * NvOsAlloc and NvOsRealloc. For every place that allocates, the profile
+ * holds the bytes and allocations currently live, the peak of the live
+ * bytes and the number of allocations made, so that growth in a long
+ * running process can be pinned on the code responsible for it.
+ */
+
+#ifndef INCLUDED_NVOS_HEAP_PROFILE_H
+#define INCLUDED_NVOS_HEAP_PROFILE_H
+
+#include "nvos.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif  /* __cplusplus */
+
+/**
+ * @defgroup nvos_heap_profile_group Heap Profiling
+ *
+ * Only available on Linux, and only records allocations when libnvos is
+ * built with NVOS_HEAP_PROFILE set; otherwise no sites are reported.
+ *
+ * A site is the code location of the allocating call: the source file and
+ * line in debug builds, and always the return address of the call. With
+ * call stacks enabled the call stack leading to it is part of the site
+ * too, so that one allocating helper used from many places is split up by
+ * its callers.
+ *
+ * @ingroup nvos_group
+ * @{
+ */
+
+/**
+ * Allocation statistics of one call site.
+ */
+typedef struct NvOsHeapSiteRec
+{
+    /** Source file of the call, or NULL when the caller was built without
+     *  NV_DEBUG. */
+    const char *File;
+    /** Source line of the call, 0 when File is NULL. */
+    NvU32 Line;
+    /** Return address of the allocating call. */
+    const void *Caller;
+    /** Hash of the call stack, 0 when call stacks are not recorded. */
+    NvU32 StackHash;
+    /** Bytes allocated here and not yet freed. */
+    NvU64 LiveBytes;
+    /** Allocations made here and not yet freed. */
+    NvU32 LiveAllocs;
+    /** Largest value LiveBytes reached since the last reset. */
+    NvU64 PeakBytes;
+    /** Allocations made since the last reset. */
+    NvU64 TotalAllocs;
+    /** Bytes allocated since the last reset. */
+    NvU64 TotalBytes;
+} NvOsHeapSite;
+
+/**
+ * Tells whether allocations are being profiled.
+ *
+ * @retval NV_TRUE libnvos was built with heap profiling.
+ */
+NvBool NvOsHeapProfileEnabled(void);
+
+/**
+ * Makes the call stack of each allocation part of its site. Unwinding the
+ * stack on every allocation is many times slower than the allocation
+ * itself, so this is off by default. Only allocations made after the call
+ * are affected.
+ *
+ * @param enable NV_TRUE to record call stacks.
+ */
+void NvOsHeapProfileSetCallstacks(NvBool enable);
+
+/**
+ * Returns the allocation sites with memory live or allocated since the
+ * last reset, largest live bytes first.
+ *
+ * @param sites Filled with up to @a max entries.
+ * @param max Size of @a sites.
+ *
+ * @return The number of entries filled in.
+ */
+NvU32 NvOsHeapProfileGetSites(NvOsHeapSite *sites, NvU32 max);
+
+/**
+ * Starts a new measurement interval: clears the allocation totals and
+ * sets each peak to the current live bytes. Live counts are kept.
+ */
+void NvOsHeapProfileReset(void);
+
+/**
+ * Writes the profile as text, one line per site ordered by the site
+ * location rather than by size, so that two dumps of the same process can
+ * be compared with diff. Sites are named by file and line where known and
+ * by symbol or module offset, which do not change from run to run.
+ *
+ * @param file Stream to write to, or NULL for NvOsDebugPrintf.
+ */
+void NvOsHeapProfileDump(NvOsFileHandle file);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif  /* __cplusplus */
+
+#endif // INCLUDED_NVOS_HEAP_PROFILE_H
@@ -55,6 +55,10 @@ NvSysUtilGetDeviceInfo( NvU32 id, NvU32 logicalSector, NvU32 *sectorsPerBlock,
 NvBool NvSysUtilCheckSparseImage(const NvU8 *Buffer, NvU32 size);
 
 /**
+ * Writes the next part of a sparse image to \a hFile. Fill chunks are
+ * expanded on the device, don't care chunks are skipped and, for runs of
+ * 1MB or more, trim erased when the file system supports it.
+ *
  * @param hFile Handle to the storage manager
  * @param Buffer Buffer containing the sparse data
  * @param size size of buffer
@@ -192,6 +192,7 @@ nv_modules := \
     libnvmmlite_utils \
     libnvmmlite_video \
     libnvmmtransport \
+    libnvmtswriter \
     libnvnative_env_core \
     libnvodm_audiocodec \
     libnvodm_dtvtuner \
@@ -178,3 +178,17 @@ LOCAL_SRC_FILES += nv3p_transport_sema_host.c
 LOCAL_SRC_FILES += nv3p_transport_host.c
 
 include $(NVIDIA_HOST_STATIC_LIBRARY)
+
+include $(NVIDIA_DEFAULTS)
+
+LOCAL_MODULE := nv3p_window_bench
+
+LOCAL_SRC_FILES += nv3p_window_bench.c
+
+LOCAL_STATIC_LIBRARIES += libnv3p
+LOCAL_STATIC_LIBRARIES += libnvusbhost
+LOCAL_STATIC_LIBRARIES += libnvapputil
+LOCAL_STATIC_LIBRARIES += libnvos
+LOCAL_LDLIBS += -lpthread -ldl
+
+include $(NVIDIA_HOST_EXECUTABLE)
@@ -30,6 +30,17 @@
     NV3P_PACKET_SIZE_NACK + \
     NV3P_PACKET_SIZE_FOOTER
 
+/* resends of one window before the transfer is given up */
+#define NV3P_WINDOW_MAX_RETRIES 3
+
+/* a windowed data packet kept until the receiver acks it */
+typedef struct Nv3pWindowSlotRec
+{
+    NvU32 sequence;
+    NvU32 length;
+    NvU8 *data;
+} Nv3pWindowSlot;
+
 typedef struct Nv3pSocketRec
 {
     Nv3pTransportHandle hTrans;
@@ -45,6 +56,21 @@ typedef struct Nv3pSocketRec
     /* the last nack code */
     Nv3pNackCode last_nack;
 
+    /* windowed data send, disabled while window_size <= 1 */
+    NvU32 window_size;
+    NvU32 window_count;
+    Nv3pWindowSlot window[NV3P_WINDOW_MAX];
+    NvBool window_aborted;      // a transfer was abandoned part way
+
+    /* windowed data receive */
+    NvU32 recv_good;            // last packet received in order
+    NvBool window_active;       // more packets follow before an ack request
+    NvBool window_error;        // a packet was dropped since the last ack
+    Nv3pNackCode window_fail;   // set by Nv3pTransferFail
+    NvU8 *window_buf;           // verified payload of the last packet
+    NvU32 window_pending;
+    NvU32 window_offset;
+
     unsigned char s_buffer[NV3P_MAX_COMMAND_SIZE];
     unsigned char s_args[NV3P_MAX_COMMAND_SIZE]; // handed out to clients
     unsigned char s_retbuf[NV3P_MAX_COMMAND_SIZE];
@@ -136,6 +162,7 @@ Nv3pOpen( Nv3pSocketHandle *h3p, Nv3pTransportMode mode, NvU32 instance )
     sock = NvOsAlloc(sizeof(Nv3pSocket));
     NvOsMemset( sock, 0, sizeof(Nv3pSocket) );
     sock->last_nack = Nv3pNackCode_Success;
+    sock->window_fail = Nv3pNackCode_Success;
 
     NV_CHECK_ERROR_CLEANUP(
         Nv3pTransportReopen( &sock->hTrans, mode, instance )
@@ -175,12 +202,19 @@ fail:
 void
 Nv3pClose( Nv3pSocketHandle h3p )
 {
+    NvU32 i;
+
     if( !h3p )
     {
         return;
     }
 
     Nv3pTransportClose( h3p->hTrans );
+    for( i = 0; i < NV3P_WINDOW_MAX; i++ )
+    {
+        NvOsFree( h3p->window[i].data );
+    }
+    NvOsFree( h3p->window_buf );
     NvOsFree(h3p);
 }
 
@@ -363,6 +397,310 @@ Nv3pPrivWriteFooter( Nv3pSocketHandle h3p, NvU32 checksum, NvU8 *packet )
     WRITE32( packet, checksum );
 }
 
+static NvError
+Nv3pPrivWindowSendPacket( Nv3pSocketHandle h3p, Nv3pWindowSlot *slot,
+    NvU32 flags )
+{
+    NvError e;
+    NvU32 checksum;
+    NvU8 *packet;
+    NvU8 *tmp;
+    NvU32 hdrlen;
+
+    packet = &h3p->s_buffer[0];
+
+    Nv3pPrivWriteBasicHeader( h3p, Nv3pByteStream_PacketType_WindowData,
+        slot->sequence, packet );
+    tmp = packet + NV3P_PACKET_SIZE_BASIC;
+
+    /* windowed data header */
+    WRITE32( tmp, slot->length );
+    WRITE32( tmp, flags );
+
+    hdrlen = NV3P_PACKET_SIZE_BASIC + NV3P_PACKET_SIZE_WINDOW_DATA;
+
+    checksum = Nv3pPrivChecksum( packet, hdrlen );
+    checksum += Nv3pPrivChecksum( slot->data, slot->length );
+    checksum = ~checksum + 1;
+
+    NV_CHECK_ERROR_CLEANUP(
+        Nv3pTransportSend( h3p->hTrans, packet, hdrlen, 0 )
+    );
+
+    NV_CHECK_ERROR_CLEANUP(
+        Nv3pTransportSend( h3p->hTrans, slot->data, slot->length, 0 )
+    );
+
+    NV_CHECK_ERROR_CLEANUP(
+        Nv3pTransportSend( h3p->hTrans, (NvU8 *)&checksum, 4, 0 )
+    );
+
+fail:
+    return e;
+}
+
+/**
+ * Waits for the cumulative ack of the window. A retransmit nack drops the
+ * packets the receiver got in order and resends the rest.
+ */
+static NvError
+Nv3pPrivWindowWaitAck( Nv3pSocketHandle h3p )
+{
+    NvError e;
+    Nv3pHdrBasic hdr = {0,0,0};
+    NvU32 recv_checksum = 0, checksum;
+    Nv3pNackCode code = Nv3pNackCode_Success;
+    Nv3pWindowSlot done[NV3P_WINDOW_MAX];
+    NvU32 retries = 0;
+    NvU32 acked;
+    NvU32 i;
+    NvBool b;
+
+    h3p->last_nack = Nv3pNackCode_Success;
+
+    for( ;; )
+    {
+        b = Nv3pPrivReceiveBasicHeader( h3p, &hdr, &recv_checksum );
+        if( !b )
+        {
+            e = NvError_Nv3pUnrecoverableProtocol;
+            goto fail;
+        }
+
+        if( hdr.PacketType == Nv3pByteStream_PacketType_Nack )
+        {
+            NV_CHECK_ERROR_CLEANUP(
+                Nv3pTransportReceive( h3p->hTrans, (NvU8 *)&code, 4, 0, 0 )
+            );
+
+            recv_checksum += Nv3pPrivChecksum( (NvU8 *)&code, 4 );
+        }
+        else if( hdr.PacketType != Nv3pByteStream_PacketType_Ack )
+        {
+            e = NvError_Nv3pUnrecoverableProtocol;
+            goto fail;
+        }
+
+        NV_CHECK_ERROR_CLEANUP(
+            Nv3pTransportReceive( h3p->hTrans, (NvU8 *)&checksum, 4, 0, 0 )
+        );
+
+        if( recv_checksum + checksum != 0 )
+        {
+            e = NvError_Nv3pUnrecoverableProtocol;
+            goto fail;
+        }
+
+        /* the sequence is the last packet the receiver got in order */
+        acked = hdr.Sequence + 1 - h3p->window[0].sequence;
+        if( acked > h3p->window_count )
+        {
+            e = NvError_Nv3pUnrecoverableProtocol;
+            goto fail;
+        }
+
+        if( hdr.PacketType == Nv3pByteStream_PacketType_Ack )
+        {
+            if( acked != h3p->window_count )
+            {
+                e = NvError_Nv3pUnrecoverableProtocol;
+                goto fail;
+            }
+            h3p->window_count = 0;
+            return NvSuccess;
+        }
+
+        if( code != Nv3pNackCode_Retransmit )
+        {
+            h3p->last_nack = code;
+            e = NvError_Nv3pPacketNacked;
+            goto fail;
+        }
+
+        if( acked == h3p->window_count || ++retries > NV3P_WINDOW_MAX_RETRIES )
+        {
+            e = NvError_Nv3pUnrecoverableProtocol;
+            goto fail;
+        }
+
+        /* keep the unacked packets first, reusing the acked buffers */
+        NvOsMemcpy( done, h3p->window, acked * sizeof(Nv3pWindowSlot) );
+        for( i = acked; i < h3p->window_count; i++ )
+        {
+            h3p->window[i - acked] = h3p->window[i];
+        }
+        h3p->window_count -= acked;
+        NvOsMemcpy( &h3p->window[h3p->window_count], done,
+            acked * sizeof(Nv3pWindowSlot) );
+
+        for( i = 0; i < h3p->window_count; i++ )
+        {
+            NV_CHECK_ERROR_CLEANUP(
+                Nv3pPrivWindowSendPacket( h3p, &h3p->window[i],
+                    (i + 1 == h3p->window_count) ?
+                        NV3P_WINDOW_FLAG_ACK_REQUEST : 0 )
+            );
+        }
+    }
+
+fail:
+    h3p->window_count = 0;
+    return e;
+}
+
+static NvError
+Nv3pPrivWindowDataSend( Nv3pSocketHandle h3p, NvU8 *data, NvU32 length,
+    NvU32 flags )
+{
+    NvError e = NvSuccess;
+    Nv3pWindowSlot *slot;
+    NvU32 ack;
+
+    if( !length )
+    {
+        return NvError_BadParameter;
+    }
+
+    while( length )
+    {
+        slot = &h3p->window[h3p->window_count++];
+        slot->sequence = h3p->sequence++;
+        slot->length = NV_MIN( length, NVFLASH_DOWNLOAD_CHUNK );
+        NvOsMemcpy( slot->data, data, slot->length );
+
+        data += slot->length;
+        length -= slot->length;
+
+        ack = 0;
+        if( h3p->window_count == h3p->window_size ||
+            (!length && !(flags & NV3P_DATA_FLAG_MORE)) )
+        {
+            ack = NV3P_WINDOW_FLAG_ACK_REQUEST;
+        }
+
+        NV_CHECK_ERROR_CLEANUP(
+            Nv3pPrivWindowSendPacket( h3p, slot, ack )
+        );
+
+        if( ack )
+        {
+            NV_CHECK_ERROR_CLEANUP(
+                Nv3pPrivWindowWaitAck( h3p )
+            );
+        }
+    }
+
+    return NvSuccess;
+
+fail:
+    h3p->window_count = 0;
+    return e;
+}
+
+/**
+ * Receives the rest of a windowed data packet. If it is the next packet in
+ * order, its payload is left in window_buf, otherwise it is dropped. Packets
+ * requesting it are acked or nacked with the last packet received in order.
+ */
+static NvError
+Nv3pPrivWindowReceive( Nv3pSocketHandle h3p, Nv3pHdrBasic *hdr,
+    NvU32 recv_checksum )
+{
+    NvError e;
+    NvU8 *tmp;
+    NvU32 length;
+    NvU32 flags;
+    NvU32 checksum;
+
+    tmp = &h3p->s_buffer[0];
+
+    NV_CHECK_ERROR_CLEANUP(
+        Nv3pTransportReceive( h3p->hTrans, tmp,
+            NV3P_PACKET_SIZE_WINDOW_DATA, 0, 0 )
+    );
+
+    recv_checksum += Nv3pPrivChecksum( tmp, NV3P_PACKET_SIZE_WINDOW_DATA );
+    READ32( tmp, length );
+    READ32( tmp, flags );
+
+    /* the stream cannot be followed past a bad length */
+    if( !length || length > NVFLASH_DOWNLOAD_CHUNK )
+    {
+        e = NvError_Nv3pBadReceiveLength;
+        goto fail;
+    }
+
+    if( !h3p->window_buf )
+    {
+        h3p->window_buf = NvOsAlloc( NVFLASH_DOWNLOAD_CHUNK );
+        if( !h3p->window_buf )
+        {
+            e = NvError_InsufficientMemory;
+            goto fail;
+        }
+    }
+
+    NV_CHECK_ERROR_CLEANUP(
+        Nv3pTransportReceive( h3p->hTrans, h3p->window_buf, length, 0, 0 )
+    );
+
+    recv_checksum += Nv3pPrivChecksum( h3p->window_buf, length );
+
+    NV_CHECK_ERROR_CLEANUP(
+        Nv3pTransportReceive( h3p->hTrans, (NvU8 *)&checksum, 4, 0, 0 )
+    );
+
+    if( !h3p->window_error &&
+        h3p->window_fail == Nv3pNackCode_Success &&
+        recv_checksum + checksum == 0 &&
+        hdr->Sequence == h3p->recv_good + 1 )
+    {
+        h3p->recv_good = hdr->Sequence;
+        h3p->window_pending = length;
+        h3p->window_offset = 0;
+    }
+    else
+    {
+        h3p->window_error = NV_TRUE;
+    }
+
+    h3p->window_active = !(flags & NV3P_WINDOW_FLAG_ACK_REQUEST);
+    if( flags & NV3P_WINDOW_FLAG_ACK_REQUEST )
+    {
+        h3p->recv_sequence = h3p->recv_good;
+        if( h3p->window_fail != Nv3pNackCode_Success )
+        {
+            Nv3pNack( h3p, h3p->window_fail );
+        }
+        else if( h3p->window_error )
+        {
+            Nv3pNack( h3p, Nv3pNackCode_Retransmit );
+        }
+        else
+        {
+            Nv3pAck( h3p );
+        }
+
+        h3p->window_error = NV_FALSE;
+        h3p->window_fail = Nv3pNackCode_Success;
+    }
+
+    return NvSuccess;
+
+fail:
+    return e;
+}
+
+static NvU32
+Nv3pPrivWindowCopy( Nv3pSocketHandle h3p, NvU8 *data, NvU32 length )
+{
+    length = NV_MIN( length, h3p->window_pending );
+    NvOsMemcpy( data, h3p->window_buf + h3p->window_offset, length );
+    h3p->window_offset += length;
+    h3p->window_pending -= length;
+    return length;
+}
+
 static void
 Nv3pPrivWriteCmd( Nv3pSocketHandle h3p, Nv3pCommand command, void *args,
     NvU32 *length, NvU8 *packet )
@@ -388,6 +726,7 @@ Nv3pPrivWriteCmd( Nv3pSocketHandle h3p, Nv3pCommand command, void *args,
     case Nv3pCommand_GetBoardDetails:
     case Nv3pCommand_Recovery:
     case Nv3pCommand_ReadBoardInfo:
+    case Nv3pCommand_GetWindowSize:
         // no args or output only
         *length = 0;
         WRITE32( tmp, *length );
@@ -1052,6 +1391,17 @@ Nv3pPrivGetCmdReturn( Nv3pSocketHandle h3p, Nv3pCommand command, void *args )
         tmp += NV3P_STRING_MAX;
         break;
     }
+    case Nv3pCommand_GetWindowSize:
+    {
+        Nv3pCmdGetWindowSize *a = (Nv3pCmdGetWindowSize *)args;
+
+        length = 1 * 4;
+        NV_CHECK_ERROR_CLEANUP(
+            Nv3pDataReceive(h3p, tmp, length, 0, 0)
+        );
+        READ32(tmp, a->WindowSize);
+        break;
+    }
     case Nv3pCommand_symkeygen:
     {
         Nv3pCmdSymKeyGen *a = (Nv3pCmdSymKeyGen *)args;
@@ -1146,6 +1496,13 @@ Nv3pCommandSend( Nv3pSocketHandle h3p, Nv3pCommand command, void *args,
     NvBool b;
     packet = &h3p->s_buffer[0];
 
+    /* the last data packet of a transfer must be sent without MORE */
+    NV_ASSERT( !h3p->window_count );
+    if( h3p->window_aborted )
+    {
+        return NvError_Nv3pUnrecoverableProtocol;
+    }
+
     Nv3pPrivWriteBasicHeader( h3p, Nv3pByteStream_PacketType_Command,
         h3p->sequence, packet );
 
@@ -1358,6 +1715,13 @@ Nv3pCommandComplete(
         tmp += NV3P_STRING_MAX;
         break;
     }
+    case Nv3pCommand_GetWindowSize:
+    {
+        Nv3pCmdGetWindowSize *a = (Nv3pCmdGetWindowSize *)args;
+        length = 1 * 4;
+        WRITE32(tmp, a->WindowSize);
+        break;
+    }
     case Nv3pCommand_symkeygen:
     {
         Nv3pCmdSymKeyGen *a = (Nv3pCmdSymKeyGen *)args;
@@ -1446,6 +1810,7 @@ Nv3pPrivGetCmdArgs( Nv3pSocketHandle h3p, Nv3pCommand command, void **args,
     case Nv3pCommand_GetNv3pServerVersion:
     case Nv3pCommand_BDKGetSuiteInfo:
     case Nv3pCommand_GetBoardDetails:
+    case Nv3pCommand_GetWindowSize:
         /* output only */
         break;
     case Nv3pCommand_Status:
@@ -1820,6 +2185,7 @@ Nv3pCommandReceive(
         goto fail;
     }
 
+    h3p->recv_good = hdr.Sequence;
     return NvSuccess;
 
 fail:
@@ -1839,6 +2205,16 @@ Nv3pDataSend(
     NvU8 *tmp;
     NvU32 hdrlen;
 
+    if( h3p->window_aborted )
+    {
+        return NvError_Nv3pUnrecoverableProtocol;
+    }
+
+    if( h3p->window_size > 1 )
+    {
+        return Nv3pPrivWindowDataSend( h3p, data, length, flags );
+    }
+
     packet = &h3p->s_buffer[0];
 
     Nv3pPrivWriteBasicHeader( h3p, Nv3pByteStream_PacketType_Data,
@@ -1900,6 +2276,17 @@ Nv3pDataReceive(
     NvU32 recv_length;
     NvBool b;
 
+    /* check for left over data from a windowed packet */
+    if( h3p->window_pending )
+    {
+        length = Nv3pPrivWindowCopy( h3p, data, length );
+        if( bytes )
+        {
+            *bytes = length;
+        }
+        return NvSuccess;
+    }
+
     /* check for left over stuff from a previous read */
     if( h3p->bytes_remaining == 0 )
     {
@@ -1911,6 +2298,31 @@ Nv3pDataReceive(
             goto fail;
         }
 
+        /* dropped windowed packets are followed by their resend */
+        while( hdr.PacketType == Nv3pByteStream_PacketType_WindowData )
+        {
+            NV_CHECK_ERROR_CLEANUP(
+                Nv3pPrivWindowReceive( h3p, &hdr, h3p->recv_checksum )
+            );
+
+            if( h3p->window_pending )
+            {
+                length = Nv3pPrivWindowCopy( h3p, data, length );
+                if( bytes )
+                {
+                    *bytes = length;
+                }
+                return NvSuccess;
+            }
+
+            b = Nv3pPrivReceiveBasicHeader( h3p, &hdr, &h3p->recv_checksum );
+            if( !b )
+            {
+                e = NvError_Nv3pUnrecoverableProtocol;
+                goto fail;
+            }
+        }
+
         if( hdr.PacketType != Nv3pByteStream_PacketType_Data )
         {
             return Nv3pPrivDrainPacket( h3p, &hdr );
@@ -1968,6 +2380,7 @@ Nv3pDataReceive(
             goto fail;
         }
 
+        h3p->recv_good = h3p->recv_sequence;
         Nv3pAck( h3p );
     }
 
@@ -1985,9 +2398,31 @@ Nv3pTransferFail( Nv3pSocketHandle h3p, Nv3pNackCode code )
     NvU8 *tmp;
     NvU32 length;
     NvBool bReceive = NV_FALSE;
+    Nv3pHdrBasic hdr = {0,0,0};
+    NvU32 checksum = 0;
 
     tmp = &h3p->s_buffer[0];
 
+    /* drop the rest of a windowed transfer and nack its last packet */
+    h3p->window_pending = 0;
+    if( h3p->window_active )
+    {
+        h3p->window_fail = code;
+        while( h3p->window_active )
+        {
+            if( !Nv3pPrivReceiveBasicHeader( h3p, &hdr, &checksum ) ||
+                hdr.PacketType != Nv3pByteStream_PacketType_WindowData )
+            {
+                goto fail;
+            }
+
+            NV_CHECK_ERROR_CLEANUP(
+                Nv3pPrivWindowReceive( h3p, &hdr, checksum )
+            );
+        }
+        return;
+    }
+
     if( h3p->bytes_remaining )
     {
         bReceive = NV_TRUE;
@@ -2091,6 +2526,44 @@ fail:
     return;
 }
 
+void
+Nv3pDataSendAbort( Nv3pSocketHandle h3p )
+{
+    /* the receiver still waits for the rest, so nothing can follow */
+    if( h3p->window_count )
+    {
+        h3p->window_count = 0;
+        h3p->window_aborted = NV_TRUE;
+    }
+}
+
+NvError
+Nv3pSetWindowSize( Nv3pSocketHandle h3p, NvU32 WindowSize )
+{
+    NvU32 i;
+
+    NV_ASSERT( !h3p->window_count );
+
+    WindowSize = NV_MIN( WindowSize, NV3P_WINDOW_MAX );
+    for( i = 0; WindowSize > 1 && i < WindowSize; i++ )
+    {
+        if( h3p->window[i].data )
+        {
+            continue;
+        }
+
+        h3p->window[i].data = NvOsAlloc( NVFLASH_DOWNLOAD_CHUNK );
+        if( !h3p->window[i].data )
+        {
+            h3p->window_size = 0;
+            return NvError_InsufficientMemory;
+        }
+    }
+
+    h3p->window_size = WindowSize;
+    return NvSuccess;
+}
+
 Nv3pNackCode
 Nv3pGetLastNackCode( Nv3pSocketHandle h3p )
 {
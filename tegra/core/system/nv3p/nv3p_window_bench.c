@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2013, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software and related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+/*
+ * Loopback benchmark for windowed nv3p data transfers.
+ *
+ * Both ends of the socket run in this process over the semaphore transport.
+ * For each window size from 1 (stop-and-wait) to NV3P_WINDOW_MAX the host
+ * side negotiates with Nv3pCommand_GetWindowSize, sends the payload in
+ * NVFLASH_DOWNLOAD_CHUNK sized calls and reports the throughput seen by the
+ * sender. The receiving thread verifies every byte.
+ *
+ * usage: nv3p_window_bench [megabytes]
+ */
+
+#include "nvos.h"
+#include "nvcommon.h"
+#include "nv3p.h"
+#include "nv3p_bytestream.h"
+#include "nvapputil.h"
+#include "nvutil.h"
+
+#define BENCH_DEFAULT_MB 64
+
+typedef struct BenchDeviceRec
+{
+    Nv3pSocketHandle hSock;
+    NvU64 Total;
+    NvU32 Runs;
+    NvBool Failed;
+} BenchDevice;
+
+static NvU8
+bench_pattern( NvU64 offset )
+{
+    return (NvU8)((offset * 7) ^ (offset >> 11));
+}
+
+static NvBool
+bench_device_run( BenchDevice *dev, NvU8 *buf )
+{
+    NvError e;
+    Nv3pCommand command;
+    void *arg;
+    Nv3pCmdGetWindowSize a;
+    NvU64 count = 0;
+    NvU32 bytes;
+    NvU32 i;
+
+    e = Nv3pCommandReceive( dev->hSock, &command, &arg, 0 );
+    if( e != NvSuccess || command != Nv3pCommand_GetWindowSize )
+    {
+        return NV_FALSE;
+    }
+
+    a.WindowSize = NV3P_WINDOW_MAX;
+    e = Nv3pCommandComplete( dev->hSock, command, &a, 0 );
+    if( e != NvSuccess )
+    {
+        return NV_FALSE;
+    }
+
+    while( count < dev->Total )
+    {
+        e = Nv3pDataReceive( dev->hSock, buf, NVFLASH_DOWNLOAD_CHUNK,
+            &bytes, 0 );
+        if( e != NvSuccess )
+        {
+            return NV_FALSE;
+        }
+
+        for( i = 0; i < bytes; i++ )
+        {
+            if( buf[i] != bench_pattern( count + i ) )
+            {
+                return NV_FALSE;
+            }
+        }
+        count += bytes;
+    }
+
+    return NV_TRUE;
+}
+
+static void
+bench_device_thread( void *args )
+{
+    BenchDevice *dev = (BenchDevice *)args;
+    NvU8 *buf;
+    NvU32 run;
+
+    buf = NvOsAlloc( NVFLASH_DOWNLOAD_CHUNK );
+    if( !buf )
+    {
+        dev->Failed = NV_TRUE;
+        return;
+    }
+
+    for( run = 0; run < dev->Runs; run++ )
+    {
+        if( !bench_device_run( dev, buf ) )
+        {
+            dev->Failed = NV_TRUE;
+            break;
+        }
+    }
+
+    NvOsFree( buf );
+}
+
+static NvError
+bench_host_run( Nv3pSocketHandle hSock, NvU8 *buf, NvU64 total,
+    NvU32 window, NvU64 *us )
+{
+    NvError e;
+    Nv3pCmdGetWindowSize a;
+    NvU64 start;
+    NvU64 count;
+    NvU32 size;
+    NvU32 i;
+
+    NV_CHECK_ERROR(
+        Nv3pCommandSend( hSock, Nv3pCommand_GetWindowSize, &a, 0 )
+    );
+
+    NV_CHECK_ERROR(
+        Nv3pSetWindowSize( hSock, NV_MIN( window, a.WindowSize ) )
+    );
+
+    start = NvOsGetTimeUS();
+    for( count = 0; count < total; count += size )
+    {
+        size = (NvU32)NV_MIN( total - count, NVFLASH_DOWNLOAD_CHUNK );
+        for( i = 0; i < size; i++ )
+        {
+            buf[i] = bench_pattern( count + i );
+        }
+
+        NV_CHECK_ERROR(
+            Nv3pDataSend( hSock, buf, size,
+                (count + size < total) ? NV3P_DATA_FLAG_MORE : 0 )
+        );
+    }
+    *us = NvOsGetTimeUS() - start;
+
+    return NvSuccess;
+}
+
+int
+main( int argc, const char *argv[] )
+{
+    NvError e = NvSuccess;
+    Nv3pSocketHandle hHost = 0;
+    BenchDevice dev;
+    NvOsThreadHandle hThread = 0;
+    NvU8 *buf = 0;
+    NvU64 us;
+    NvU32 window;
+    NvU32 mb = BENCH_DEFAULT_MB;
+
+    NvOsMemset( &dev, 0, sizeof(dev) );
+
+    if( argc > 1 )
+    {
+        mb = NvUStrtoul( argv[1], 0, 0 );
+        if( !mb )
+        {
+            NvAuPrintf( "usage: %s [megabytes]\n", argv[0] );
+            return 1;
+        }
+    }
+
+    dev.Total = (NvU64)mb * 1024 * 1024;
+    dev.Runs = NV3P_WINDOW_MAX;
+
+    buf = NvOsAlloc( NVFLASH_DOWNLOAD_CHUNK );
+    if( !buf )
+    {
+        e = NvError_InsufficientMemory;
+        goto fail;
+    }
+
+    /* both ends share the pipes created by the first open */
+    NV_CHECK_ERROR_CLEANUP(
+        Nv3pOpen( &hHost, Nv3pTransportMode_Sema, 0 )
+    );
+    NV_CHECK_ERROR_CLEANUP(
+        Nv3pOpen( &dev.hSock, Nv3pTransportMode_Sema, 1 )
+    );
+
+    NV_CHECK_ERROR_CLEANUP(
+        NvOsThreadCreate( bench_device_thread, &dev, &hThread )
+    );
+
+    NvAuPrintf( "window  %u MB over sema loopback\n", mb );
+    for( window = 1; window <= NV3P_WINDOW_MAX; window++ )
+    {
+        NV_CHECK_ERROR_CLEANUP(
+            bench_host_run( hHost, buf, dev.Total, window, &us )
+        );
+
+        NvAuPrintf( "%6u  %llu us  %llu KB/s\n", window, us,
+            us ? (dev.Total * 1000000 / 1024) / us : 0 );
+    }
+
+    NvOsThreadJoin( hThread );
+    hThread = 0;
+    if( dev.Failed )
+    {
+        NvAuPrintf( "receiver saw bad data\n" );
+        e = NvError_Nv3pUnrecoverableProtocol;
+    }
+    goto clean;
+
+fail:
+    NvAuPrintf( "benchmark failed NvError 0x%x\n", e );
+
+clean:
+    /* a receiver blocked on a failed sender cannot be woken, leave it */
+    if( !hThread )
+    {
+        Nv3pClose( dev.hSock );
+        Nv3pClose( hHost );
+    }
+    NvOsFree( buf );
+    return (e == NvSuccess) ? 0 : 1;
+}
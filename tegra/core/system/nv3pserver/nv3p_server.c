@@ -495,6 +495,7 @@ static COMMAND_HANDLER(SetTime);
 static COMMAND_HANDLER(GetDevInfo);
 static COMMAND_HANDLER(DownloadNvPrivData);
 static COMMAND_HANDLER(GetNv3pServerVersion);
+static COMMAND_HANDLER(GetWindowSize);
 static COMMAND_HANDLER(FuseWrite);
 static COMMAND_HANDLER(GetPlatformInfo);
 static COMMAND_HANDLER(SkipSync);
@@ -5405,6 +5406,31 @@ fail:
     return ReportStatus(hSock, Message, s, 0);
 }
 
+COMMAND_HANDLER(GetWindowSize)
+{
+    NvError e = NvSuccess;
+    Nv3pStatus s = Nv3pStatus_Ok;
+    Nv3pCmdGetWindowSize a;
+    char Message[NV3P_STRING_MAX] = {'\0'};
+
+    // the receive side handles windowed packets without any setup, so just
+    // advertise how many packets the host may send per acknowledgement
+    a.WindowSize = NV3P_WINDOW_MAX;
+
+    NV_CHECK_ERROR_FAIL_3P(
+        Nv3pCommandComplete(hSock, command, &a, 0),
+            Nv3pStatus_CmdCompleteFailure);
+fail:
+    if (e)
+    {
+        Nv3pNack(hSock, Nv3pNackCode_BadData);
+        NvOsDebugPrintf(
+            "\nGetWindowSize failed. NvError %u NvStatus %u\n", e, s);
+    }
+
+    return ReportStatus(hSock, Message, s, 0);
+}
+
 COMMAND_HANDLER(FuseWrite)
 {
     NvError e = NvSuccess;
@@ -5980,6 +6006,11 @@ NvError Nv3pServer(void)
                     GetNv3pServerVersion(hSock, command, arg)
                 );
                 break;
+            case Nv3pCommand_GetWindowSize:
+                NV_CHECK_ERROR_CLEANUP(
+                    GetWindowSize(hSock, command, arg)
+                );
+                break;
             case Nv3pCommand_FuseWrite:
                 NV_CHECK_ERROR_CLEANUP(
                     FuseWrite(hSock, command, arg)
@@ -32,6 +32,8 @@ NvCryptoCipherSelectAlgorithm(
             break;
 #else
         case NvCryptoCipherAlgoType_AesCbc:
+        case NvCryptoCipherAlgoType_AesEcb:
+        case NvCryptoCipherAlgoType_AesCtr:
             NV_CHECK_ERROR(NvCryptoCipherSelectAlgorithmAes(
                                CipherAlgoType,
                                pCipherAlgoHandle));
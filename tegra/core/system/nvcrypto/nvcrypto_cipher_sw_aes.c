@@ -63,13 +63,14 @@ typedef struct NvCryptoCipherAlgoAesRec
     /// Initial vector to use when encrypting/decrypting the first block in the
     /// chain
     NvU8 InitialVector[NVCRYPTO_CIPHER_AES_IV_BYTES];
-} NvCryptoCipherAlgoAes;
 
-/**
- * The following global variable is defined to hold
- * the algo key bytes aes_ref SW AES
- */
-static NvU8 AlgoKeyBytes[NVCRYPTO_CIPHER_AES_BLOCK_SIZE_BYTES];
+    /// Chaining value carried between ProcessBlocks() calls: the previous
+    /// ciphertext block for CBC, the next counter block for CTR
+    NvU8 ChainVector[NVCRYPTO_CIPHER_AES_IV_BYTES];
+
+    /// Expanded encryption and decryption keys, computed once per key
+    NvAesKeySchedule KeySchedule;
+} NvCryptoCipherAlgoAes;
 
 /**
  * The following routines are defined according to the prototypes given in
@@ -167,8 +168,8 @@ SetAlgoParams(
     NvOsMemcpy(pAlgo->InitialVector, pParams->InitialVectorBytes,
                sizeof(pParams->InitialVectorBytes));
 
-    // populate the AlgoKeyBytes array with the Key Bytes
-    NvOsMemcpy(AlgoKeyBytes, pParams->KeyBytes, NVCRYPTO_CIPHER_AES_BLOCK_SIZE_BYTES);
+    // expand the key once rather than on every ProcessBlocks() call
+    NvAesSetKey(&pAlgo->KeySchedule, pParams->KeyBytes);
 
     return NvSuccess;
 }
@@ -379,18 +380,9 @@ ProcessBlocks(
     NvBool IsFirstBlock,
     NvBool IsLastBlock)
 {
-    NvU8 pAesRefExpKey[NVAES_KEYCOLS * NVAES_STATECOLS * (NVAES_ROUNDS + 1)];
-    NvU8 pAesRefIn[NVCRYPTO_CIPHER_AES_BLOCK_SIZE_BYTES];
-    // IV (Initial Vector) is all zero for Cmac/Cbc -- Need to confirm
-    NvU8 pAesRefOut[NVCRYPTO_CIPHER_AES_BLOCK_SIZE_BYTES];
-    static NvU8 pAesIv[NVCRYPTO_CIPHER_AES_BLOCK_SIZE_BYTES] = {0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00};
-    NvU8 i;
-    NvU8 *pSrcPtr;
-    NvU8 *pDstPtr;
-
+    NvU32 NumBlocks;
+    const NvU8 *pSrcPtr = (const NvU8 *)pSrcBuffer;
+    NvU8 *pDstPtr = (NvU8 *)pDstBuffer;
 
     NvCryptoCipherAlgoAesHandle pAlgo = (NvCryptoCipherAlgoAesHandle)AlgoHandle;
     if (!pAlgo)
@@ -411,44 +403,38 @@ ProcessBlocks(
     // load IV when first block is processed
     if (IsFirstBlock)
     {
-        NvOsMemcpy(pAesIv, pAlgo->InitialVector, NVCRYPTO_CIPHER_AES_BLOCK_SIZE_BYTES);
+        NvOsMemcpy(pAlgo->ChainVector, pAlgo->InitialVector,
+                   NVCRYPTO_CIPHER_AES_IV_BYTES);
     }
 
-    // perform crypto operation
-    NvAesExpandKey((NvU8 *)AlgoKeyBytes, (NvU8 *)pAesRefExpKey);
-
-    pSrcPtr = (NvU8 *)pSrcBuffer;
-    pDstPtr = (NvU8 *)pDstBuffer;
-
-    while (NumBytes) {
-        NvOsMemcpy(pAesRefIn, pSrcPtr, NVCRYPTO_CIPHER_AES_BLOCK_SIZE_BYTES);
-
-        if (pAlgo->IsEncrypt == NV_TRUE)
-        {
-            for (i=0; i<NVCRYPTO_CIPHER_AES_BLOCK_SIZE_BYTES; i++)
-            {
-                    pAesRefIn[i] ^= pAesIv[i];
-            }
-            NvAesEncrypt(pAesRefIn, pAesRefExpKey, pAesRefOut);
-
-            NvOsMemcpy(pAesIv, pAesRefOut, NVCRYPTO_CIPHER_AES_BLOCK_SIZE_BYTES);
-        }
-        else
-        {
-            NvAesDecrypt(pAesRefIn, pAesRefExpKey, pAesRefOut);
-            for (i=0; i<NVCRYPTO_CIPHER_AES_BLOCK_SIZE_BYTES; i++)
-            {
-                    pAesRefOut[i] ^= pAesIv[i];
-            }
-
-            NvOsMemcpy(pAesIv, pAesRefIn, NVCRYPTO_CIPHER_AES_BLOCK_SIZE_BYTES);
-        }
-
-        NvOsMemcpy(pDstPtr, pAesRefOut, NVCRYPTO_CIPHER_AES_BLOCK_SIZE_BYTES);
-
-        NumBytes -= NVCRYPTO_CIPHER_AES_BLOCK_SIZE_BYTES;
-        pSrcPtr += NVCRYPTO_CIPHER_AES_BLOCK_SIZE_BYTES;
-        pDstPtr += NVCRYPTO_CIPHER_AES_BLOCK_SIZE_BYTES;
+    NumBlocks = NumBytes / NVCRYPTO_CIPHER_AES_BLOCK_SIZE_BYTES;
+
+    // perform crypto operation; all blocks of the call go to the backend at
+    // once so that it can work on several of them in parallel
+    switch (pAlgo->AlgoType)
+    {
+        case NvCryptoCipherAlgoType_AesCbc:
+            if (pAlgo->IsEncrypt)
+                NvAesCbcEncrypt(&pAlgo->KeySchedule, pAlgo->ChainVector,
+                                pSrcPtr, pDstPtr, NumBlocks);
+            else
+                NvAesCbcDecrypt(&pAlgo->KeySchedule, pAlgo->ChainVector,
+                                pSrcPtr, pDstPtr, NumBlocks);
+            break;
+        case NvCryptoCipherAlgoType_AesEcb:
+            if (pAlgo->IsEncrypt)
+                NvAesEcbEncrypt(&pAlgo->KeySchedule, pSrcPtr, pDstPtr,
+                                NumBlocks);
+            else
+                NvAesEcbDecrypt(&pAlgo->KeySchedule, pSrcPtr, pDstPtr,
+                                NumBlocks);
+            break;
+        case NvCryptoCipherAlgoType_AesCtr:
+            NvAesCtrCrypt(&pAlgo->KeySchedule, pAlgo->ChainVector,
+                          pSrcPtr, pDstPtr, NumBlocks);
+            break;
+        default:
+            return NvError_BadParameter;
     }
 
     return NvSuccess;
@@ -480,6 +466,8 @@ NvCryptoCipherSelectAlgorithmAes(
     switch(CipherAlgoType)
     {
         case NvCryptoCipherAlgoType_AesCbc:
+        case NvCryptoCipherAlgoType_AesEcb:
+        case NvCryptoCipherAlgoType_AesCtr:
             break;
         default:
             return NvError_BadParameter;
@@ -511,6 +499,8 @@ NvCryptoCipherSelectAlgorithmAes(
     pAlgo->PayloadSizeModuloBlockSize = 0;
     pAlgo->AesHandle = NULL;
     pAlgo->PaddingType = NvCryptoPaddingType_Invalid;
+    NvOsMemset(pAlgo->InitialVector, 0, sizeof(pAlgo->InitialVector));
+    NvOsMemset(pAlgo->ChainVector, 0, sizeof(pAlgo->ChainVector));
 
     *pCipherAlgoHandle = (NvCryptoCipherAlgoHandle)pAlgo;
 
@@ -24,6 +24,7 @@ _local_includes += $(TEGRA_TOP)/core/utils/nvos/aos/nvap
 _local_includes += $(TARGET_OUT_HEADERS)
 
 _local_src_files := nvflash_app.c
+_local_src_files += nvflash_sendfile.c
 _local_src_files += nvflash_util.c
 _local_src_files += nvflash_usage.c
 _local_src_files += nvflash_util_t30.c
@@ -126,6 +127,33 @@ endif
 
 include $(NVIDIA_HOST_EXECUTABLE)
 
+##########################################################################
+#                     Makefile for nvflash_sendfile_test                 #
+##########################################################################
+# the test counts semaphores and threads through GNU ld symbol wrapping
+ifeq ($(HOST_OS),linux)
+include $(NVIDIA_DEFAULTS)
+
+LOCAL_MODULE := nvflash_sendfile_test
+
+LOCAL_C_INCLUDES += $(_local_includes)
+
+LOCAL_SRC_FILES += nvflash_sendfile.c
+LOCAL_SRC_FILES += nvflash_sendfile_test.c
+
+LOCAL_STATIC_LIBRARIES += libnv3p
+LOCAL_STATIC_LIBRARIES += libnvusbhost
+LOCAL_STATIC_LIBRARIES += libnvapputil
+LOCAL_STATIC_LIBRARIES += libnvos
+
+LOCAL_LDFLAGS += -Wl,--wrap=NvOsSemaphoreCreate,--wrap=NvOsSemaphoreDestroy
+LOCAL_LDFLAGS += -Wl,--wrap=NvOsThreadCreate,--wrap=NvOsThreadJoin
+
+LOCAL_LDLIBS += -lpthread -ldl
+
+include $(NVIDIA_HOST_EXECUTABLE)
+endif
+
 #clean variables
 _local_cflags :=
 _local_includes :=
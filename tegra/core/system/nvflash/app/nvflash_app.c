@@ -305,7 +305,7 @@ static void nvflash_thread_execute_command(void *args);
 static NvBool
 ConvertPartitionType(NvPartMgrPartitionType PartNvPartMgr,
                      Nv3pPartitionType *PartNv3p);
-static void nvflash_report_progress(NvU32 size);
+void nvflash_report_progress(NvU32 size);
 
 static NvBool nvflash_ParseConfigTable(
     const char *config_file, NvU32 partition_id, NvU64 partition_size);
@@ -1501,82 +1501,6 @@ clean:
     return b;
 }
 
-/*
-* nvflash_sendfile: send data present in file "filename" to nv3p server.
-* If NoOfBytes is valid (>0 && <file_size) then only those many number
-* of bytes will be sent.
-*/
-NvBool
-nvflash_sendfile( const char *filename, NvU64 NoOfBytes)
-{
-    NvBool b;
-    NvError e;
-    NvOsFileHandle hFile = 0;
-    NvOsStatType stat;
-    NvU8 *buf = 0;
-    NvU32 size;
-    NvU64 total;
-    size_t bytes;
-    NvU64 count;
-    char *spinner = "-\\|/";
-    NvU32 spin_idx = 0;
-    char *err_str = 0;
-
-    NvAuPrintf( "sending file: %s\n", filename );
-
-    e = NvOsFopen( filename, NVOS_OPEN_READ, &hFile );
-    VERIFY( e == NvSuccess, err_str = "file open failed"; goto fail );
-
-    e = NvOsFstat( hFile, &stat );
-    VERIFY( e == NvSuccess, err_str = "file stat failed"; goto fail );
-
-    total = stat.size;
-    if(NoOfBytes && (NoOfBytes < stat.size))
-    {
-        total = NoOfBytes;
-    }
-    buf = NvOsAlloc( NVFLASH_DOWNLOAD_CHUNK );
-    VERIFY( buf, err_str = "buffer allocation failed"; goto fail );
-
-    count = 0;
-    while( count != total )
-    {
-        size = (NvU32) NV_MIN( total - count, NVFLASH_DOWNLOAD_CHUNK );
-
-        e = NvOsFread( hFile, buf, size, &bytes );
-        VERIFY( e == NvSuccess, err_str = "file read failed"; goto fail );
-        VERIFY( bytes == size, goto fail );
-
-        e = Nv3pDataSend( s_hSock, buf, size, 0 );
-        VERIFY( e == NvSuccess, err_str = "data send failed"; goto fail );
-
-        count += size;
-        if( !s_Quiet )
-        {
-            NvAuPrintf( "\r%c %llu/%llu bytes sent", spinner[spin_idx],
-                count, total );
-            spin_idx = (spin_idx + 1) % 4;
-        }
-        nvflash_report_progress(size);
-    }
-    NvAuPrintf( "\n%s sent successfully\n", filename );
-
-    b = NV_TRUE;
-    goto clean;
-
-fail:
-    b = NV_FALSE;
-    if( err_str )
-    {
-        NvAuPrintf( "%s NvError 0x%x\n", err_str , e);
-    }
-
-clean:
-    NvOsFclose( hFile );
-    NvOsFree( buf );
-    return b;
-}
-
 NvBool nvflash_recvfile(const char *pFileName, NvU64 Size)
 {
     NvBool Ret = NV_TRUE;
@@ -6226,6 +6150,8 @@ nvflash_dispatch( void )
                 bBL = NV_TRUE; \
                 b = nvflash_validate_nv3pserver_version(s_hSock);     \
                 VERIFY(b, err_str = "validate nv3pserver version failed"; goto fail);   \
+                b = nvflash_negotiate_window(s_hSock);     \
+                VERIFY(b, err_str = "window size negotiation failed"; goto fail);   \
             } \
         } while( 0 )
 
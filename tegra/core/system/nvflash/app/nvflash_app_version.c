@@ -260,3 +260,35 @@ nvflash_display_versioninfo(NvU32 Major1, NvU32 Major2)
     return NV_TRUE;
 }
 
+NvBool
+nvflash_negotiate_window(Nv3pSocketHandle hSock)
+{
+    NvBool b = NV_TRUE;
+    NvError e = NvSuccess;
+    NvU32 WindowSize;
+    Nv3pCmdGetWindowSize WindowStruc;
+
+    e = Nv3pCommandSend(hSock, Nv3pCommand_GetWindowSize,
+            (NvU8 *)&WindowStruc, 0);
+    if (e != NvSuccess)
+    {
+        // Older 3pserver, keep acknowledging every data packet
+        return NV_TRUE;
+    }
+
+    b = nvflash_wait_status();
+    VERIFY(b, NvAuPrintf("unable to retrieve window size\n"); return b);
+
+    WindowSize = WindowStruc.WindowSize;
+    if (WindowSize > NV3P_WINDOW_MAX)
+        WindowSize = NV3P_WINDOW_MAX;
+
+    e = Nv3pSetWindowSize(hSock, WindowSize);
+    if (e != NvSuccess)
+    {
+        // Not fatal, the transfer just falls back to stop-and-wait
+        NvAuPrintf("windowed transfers disabled, NvError 0x%x\n", e);
+    }
+
+    return NV_TRUE;
+}
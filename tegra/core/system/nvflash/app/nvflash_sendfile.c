@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2013, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software and related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#include "nvos.h"
+#include "nvcommon.h"
+#include "nvapputil.h"
+#include "nv3p.h"
+
+extern Nv3pSocketHandle s_hSock;
+extern NvBool s_Quiet;
+
+extern void nvflash_report_progress(NvU32 size);
+
+#define VERIFY( exp, code ) \
+    if( !(exp) ) { \
+        code; \
+    }
+
+/* Chunks of NVFLASH_DOWNLOAD_CHUNK bytes in flight between the file reader
+ * thread and the sender in nvflash_sendfile.
+ */
+#define NVFLASH_DOWNLOAD_BUFFERS 3
+
+typedef struct NvFlashSendFileRec
+{
+    NvOsFileHandle hFile;
+    NvU64 Total;
+    NvU8 *Buf[NVFLASH_DOWNLOAD_BUFFERS];
+    NvU32 Size[NVFLASH_DOWNLOAD_BUFFERS];
+    /* buffers the reader may fill */
+    NvOsSemaphoreHandle hEmpty;
+    /* buffers ready to be sent, a zero Size marks a read failure */
+    NvOsSemaphoreHandle hFull;
+    volatile NvBool Abort;
+    NvError ReadError;
+    NvU32 ReadMs;
+} NvFlashSendFile;
+
+/*
+* nvflash_sendfile_reader: fills the download buffers in order from the file
+* while the previous ones are being sent.
+*/
+static void
+nvflash_sendfile_reader( void *args )
+{
+    NvFlashSendFile *s = (NvFlashSendFile *)args;
+    NvError e = NvSuccess;
+    NvU64 count = 0;
+    NvU32 idx = 0;
+    NvU32 size;
+    NvU32 start;
+    size_t bytes;
+
+    while( count != s->Total )
+    {
+        NvOsSemaphoreWait( s->hEmpty );
+        if( s->Abort )
+            break;
+
+        size = (NvU32) NV_MIN( s->Total - count, NVFLASH_DOWNLOAD_CHUNK );
+
+        start = NvOsGetTimeMS();
+        e = NvOsFread( s->hFile, s->Buf[idx], size, &bytes );
+        s->ReadMs += NvOsGetTimeMS() - start;
+        if( e != NvSuccess || bytes != size )
+        {
+            s->ReadError = (e != NvSuccess) ? e : NvError_FileReadFailed;
+            s->Size[idx] = 0;
+            NvOsSemaphoreSignal( s->hFull );
+            break;
+        }
+
+        s->Size[idx] = size;
+        NvOsSemaphoreSignal( s->hFull );
+
+        count += size;
+        idx = (idx + 1) % NVFLASH_DOWNLOAD_BUFFERS;
+    }
+}
+
+/*
+* nvflash_sendfile: send data present in file "filename" to nv3p server.
+* If NoOfBytes is valid (>0 && <file_size) then only those many number
+* of bytes will be sent.
+*
+* The file is read by a separate thread into NVFLASH_DOWNLOAD_BUFFERS
+* buffers, so reading the host file overlaps with sending the previous
+* chunks and waiting for their acknowledgement. Chunks other than the last
+* are sent with NV3P_DATA_FLAG_MORE so a windowed socket can keep several
+* of them in flight.
+*/
+NvBool
+nvflash_sendfile( const char *filename, NvU64 NoOfBytes)
+{
+    NvBool b;
+    NvError e = NvSuccess;
+    NvOsStatType stat;
+    NvFlashSendFile s;
+    NvOsThreadHandle hReader = 0;
+    NvU32 size;
+    NvU64 count;
+    NvU32 idx;
+    NvU32 i;
+    NvU32 StartMs;
+    NvU32 SendMs = 0;
+    NvU32 ElapsedMs;
+    char *spinner = "-\\|/";
+    NvU32 spin_idx = 0;
+    char *err_str = 0;
+
+    NvOsMemset( &s, 0, sizeof(s) );
+
+    NvAuPrintf( "sending file: %s\n", filename );
+
+    e = NvOsFopen( filename, NVOS_OPEN_READ, &s.hFile );
+    VERIFY( e == NvSuccess, err_str = "file open failed"; goto fail );
+
+    e = NvOsFstat( s.hFile, &stat );
+    VERIFY( e == NvSuccess, err_str = "file stat failed"; goto fail );
+
+    s.Total = stat.size;
+    if(NoOfBytes && (NoOfBytes < stat.size))
+    {
+        s.Total = NoOfBytes;
+    }
+    for( i = 0; i < NVFLASH_DOWNLOAD_BUFFERS; i++ )
+    {
+        s.Buf[i] = NvOsAlloc( NVFLASH_DOWNLOAD_CHUNK );
+        VERIFY( s.Buf[i], err_str = "buffer allocation failed"; goto fail );
+    }
+
+    e = NvOsSemaphoreCreate( &s.hEmpty, NVFLASH_DOWNLOAD_BUFFERS );
+    VERIFY( e == NvSuccess, err_str = "semaphore creation failed"; goto fail );
+    e = NvOsSemaphoreCreate( &s.hFull, 0 );
+    VERIFY( e == NvSuccess, err_str = "semaphore creation failed"; goto fail );
+
+    StartMs = NvOsGetTimeMS();
+
+    e = NvOsThreadCreate( nvflash_sendfile_reader, &s, &hReader );
+    VERIFY( e == NvSuccess, err_str = "reader thread creation failed"; goto fail );
+
+    count = 0;
+    idx = 0;
+    while( count != s.Total )
+    {
+        NvU32 SendStart;
+
+        NvOsSemaphoreWait( s.hFull );
+        size = s.Size[idx];
+        e = s.ReadError;
+        VERIFY( size, err_str = "file read failed"; goto fail );
+
+        SendStart = NvOsGetTimeMS();
+        /* only the last chunk has to wait for the server's ack */
+        e = Nv3pDataSend( s_hSock, s.Buf[idx], size,
+            (count + size < s.Total) ? NV3P_DATA_FLAG_MORE : 0 );
+        SendMs += NvOsGetTimeMS() - SendStart;
+        VERIFY( e == NvSuccess, err_str = "data send failed"; goto fail );
+
+        NvOsSemaphoreSignal( s.hEmpty );
+        idx = (idx + 1) % NVFLASH_DOWNLOAD_BUFFERS;
+
+        count += size;
+        if( !s_Quiet )
+        {
+            NvAuPrintf( "\r%c %llu/%llu bytes sent", spinner[spin_idx],
+                count, s.Total );
+            spin_idx = (spin_idx + 1) % 4;
+        }
+        nvflash_report_progress(size);
+    }
+
+    NvOsThreadJoin( hReader );
+    hReader = 0;
+
+    ElapsedMs = NvOsGetTimeMS() - StartMs;
+    NvAuPrintf( "\n%s sent successfully\n", filename );
+    NvAuPrintf( "%llu bytes in %u ms (%llu KB/s), file read %u ms, "
+        "send %u ms\n", s.Total, ElapsedMs,
+        ElapsedMs ? (s.Total * 1000 / 1024) / ElapsedMs : 0,
+        s.ReadMs, SendMs );
+
+    b = NV_TRUE;
+    goto clean;
+
+fail:
+    b = NV_FALSE;
+    if( err_str )
+    {
+        NvAuPrintf( "%s NvError 0x%x\n", err_str , e);
+    }
+    /* chunks sent with NV3P_DATA_FLAG_MORE may still wait for their ack */
+    Nv3pDataSendAbort( s_hSock );
+
+clean:
+    if( hReader )
+    {
+        /* wake the reader if it waits for a buffer */
+        s.Abort = NV_TRUE;
+        NvOsSemaphoreSignal( s.hEmpty );
+        NvOsThreadJoin( hReader );
+    }
+    NvOsSemaphoreDestroy( s.hEmpty );
+    NvOsSemaphoreDestroy( s.hFull );
+    NvOsFclose( s.hFile );
+    for( i = 0; i < NVFLASH_DOWNLOAD_BUFFERS; i++ )
+        NvOsFree( s.Buf[i] );
+    return b;
+}
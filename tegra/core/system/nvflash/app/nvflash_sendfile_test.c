@@ -0,0 +1,476 @@
+/*
+ * Copyright (c) 2013, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software and related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+/*
+ * Host test for nvflash_sendfile.
+ *
+ * s_hSock is one end of the semaphore loopback transport. A device thread on
+ * the other end receives what nvflash_sendfile sends and checks every byte
+ * against the file. The cases cover a whole file and the first NoOfBytes of
+ * one, both acked per chunk and windowed; the file shrinking under the
+ * reader thread, so that a file read fails part way; and the device failing
+ * the transfer in the middle of a window, so that a send fails part way.
+ *
+ * The semaphores and threads nvflash_sendfile creates are counted by
+ * wrapping the NvOs calls at link time (-Wl,--wrap). After every case, the
+ * failed ones included, all of them must have been destroyed and joined.
+ *
+ * usage: nvflash_sendfile_test [file]
+ */
+
+#include "nvos.h"
+#include "nvcommon.h"
+#include "nv3p.h"
+#include "nvapputil.h"
+
+#define TEST_DEFAULT_FILE "nvflash_sendfile_test.bin"
+/* the last chunk of every file is a partial one */
+#define TEST_TAIL 4321
+#define TEST_WINDOW 4
+
+typedef struct TestCaseRec
+{
+    const char *Name;
+    NvU32 Chunks;       /* file size: whole chunks plus TEST_TAIL bytes */
+    NvU64 NoOfBytes;
+    NvU32 Window;       /* 1 acks every chunk */
+    NvU32 TruncateAt;   /* device empties the file after this chunk */
+    NvU32 FailAt;       /* device fails the transfer after this chunk */
+    NvBool Success;
+} TestCase;
+
+/* a failed windowed transfer leaves the device out of sequence, so the send
+ * failure comes last
+ */
+static const TestCase s_Cases[] =
+{
+    { "whole file",          6, 0,                                         1,           0, 0, NV_TRUE },
+    { "partial",             6, 2 * NVFLASH_DOWNLOAD_CHUNK + 1000,         1,           0, 0, NV_TRUE },
+    { "partial, file end",   2, 8 * NVFLASH_DOWNLOAD_CHUNK,                1,           0, 0, NV_TRUE },
+    { "read failure",       12, 0,                                         1,           1, 0, NV_FALSE },
+    { "whole file, window", 10, 0,                                         TEST_WINDOW, 0, 0, NV_TRUE },
+    { "partial, window",    10, 5 * NVFLASH_DOWNLOAD_CHUNK + 1,            TEST_WINDOW, 0, 0, NV_TRUE },
+    { "send failure",       12, 0,                                         TEST_WINDOW, 0, 2, NV_FALSE },
+};
+
+typedef struct TestDeviceRec
+{
+    Nv3pSocketHandle hSock;
+    const char *FileName;
+    const TestCase *Case;
+    NvU64 Expected;
+    NvU64 Received;
+    NvBool BadData;
+    NvBool Ended;
+    NvBool Exit;
+    NvOsSemaphoreHandle hStart;
+    NvOsSemaphoreHandle hDone;
+} TestDevice;
+
+/* nvflash_app.c globals nvflash_sendfile uses */
+Nv3pSocketHandle s_hSock;
+NvBool s_Quiet = NV_TRUE;
+
+void
+nvflash_report_progress( NvU32 size )
+{
+}
+
+NvBool nvflash_sendfile( const char *filename, NvU64 NoOfBytes );
+
+static NvS32 s_LiveSemaphores;
+static NvS32 s_LiveThreads;
+static NvU32 s_ThreadsCreated;
+
+NvError __real_NvOsSemaphoreCreate( NvOsSemaphoreHandle *semaphore,
+    NvU32 value );
+void __real_NvOsSemaphoreDestroy( NvOsSemaphoreHandle semaphore );
+NvError __real_NvOsThreadCreate( NvOsThreadFunction function, void *args,
+    NvOsThreadHandle *thread );
+void __real_NvOsThreadJoin( NvOsThreadHandle thread );
+
+NvError
+__wrap_NvOsSemaphoreCreate( NvOsSemaphoreHandle *semaphore, NvU32 value )
+{
+    NvError e = __real_NvOsSemaphoreCreate( semaphore, value );
+    if( e == NvSuccess )
+    {
+        NvOsAtomicExchangeAdd32( &s_LiveSemaphores, 1 );
+    }
+    return e;
+}
+
+void
+__wrap_NvOsSemaphoreDestroy( NvOsSemaphoreHandle semaphore )
+{
+    if( semaphore )
+    {
+        NvOsAtomicExchangeAdd32( &s_LiveSemaphores, -1 );
+    }
+    __real_NvOsSemaphoreDestroy( semaphore );
+}
+
+NvError
+__wrap_NvOsThreadCreate( NvOsThreadFunction function, void *args,
+    NvOsThreadHandle *thread )
+{
+    NvError e = __real_NvOsThreadCreate( function, args, thread );
+    if( e == NvSuccess )
+    {
+        NvOsAtomicExchangeAdd32( &s_LiveThreads, 1 );
+        s_ThreadsCreated++;
+    }
+    return e;
+}
+
+void
+__wrap_NvOsThreadJoin( NvOsThreadHandle thread )
+{
+    if( thread )
+    {
+        NvOsAtomicExchangeAdd32( &s_LiveThreads, -1 );
+    }
+    __real_NvOsThreadJoin( thread );
+}
+
+static NvU8
+test_pattern( NvU64 offset )
+{
+    return (NvU8)((offset * 7) ^ (offset >> 11));
+}
+
+static NvError
+test_write_file( const char *name, NvU64 size )
+{
+    NvError e;
+    NvOsFileHandle hFile = 0;
+    NvU8 *buf;
+    NvU64 count;
+    NvU32 chunk;
+    NvU32 i;
+
+    buf = NvOsAlloc( NVFLASH_DOWNLOAD_CHUNK );
+    if( !buf )
+    {
+        return NvError_InsufficientMemory;
+    }
+
+    NV_CHECK_ERROR_CLEANUP(
+        NvOsFopen( name, NVOS_OPEN_CREATE | NVOS_OPEN_WRITE, &hFile )
+    );
+
+    for( count = 0; count < size; count += chunk )
+    {
+        chunk = (NvU32)NV_MIN( size - count, NVFLASH_DOWNLOAD_CHUNK );
+        for( i = 0; i < chunk; i++ )
+        {
+            buf[i] = test_pattern( count + i );
+        }
+
+        NV_CHECK_ERROR_CLEANUP(
+            NvOsFwrite( hFile, buf, chunk )
+        );
+    }
+
+fail:
+    NvOsFclose( hFile );
+    NvOsFree( buf );
+    return e;
+}
+
+static void
+test_device_run( TestDevice *dev, NvU8 *buf )
+{
+    const TestCase *c = dev->Case;
+    NvError e;
+    Nv3pCommand command;
+    void *arg;
+    Nv3pCmdGetWindowSize a;
+    NvOsFileHandle hFile;
+    NvU32 chunks = 0;
+    NvU32 bytes;
+    NvU32 i;
+
+    if( c->Window > 1 )
+    {
+        e = Nv3pCommandReceive( dev->hSock, &command, &arg, 0 );
+        if( e != NvSuccess || command != Nv3pCommand_GetWindowSize )
+        {
+            dev->BadData = NV_TRUE;
+            return;
+        }
+
+        a.WindowSize = c->Window;
+        e = Nv3pCommandComplete( dev->hSock, command, &a, 0 );
+        if( e != NvSuccess )
+        {
+            dev->BadData = NV_TRUE;
+            return;
+        }
+    }
+
+    while( dev->Received < dev->Expected )
+    {
+        e = Nv3pDataReceive( dev->hSock, buf, NVFLASH_DOWNLOAD_CHUNK,
+            &bytes, 0 );
+        if( e == NvError_Nv3pBadPacketType )
+        {
+            /* the host gave up on the transfer */
+            dev->Ended = NV_TRUE;
+            return;
+        }
+        if( e != NvSuccess )
+        {
+            dev->BadData = NV_TRUE;
+            return;
+        }
+
+        for( i = 0; i < bytes; i++ )
+        {
+            if( buf[i] != test_pattern( dev->Received + i ) )
+            {
+                dev->BadData = NV_TRUE;
+                return;
+            }
+        }
+        dev->Received += bytes;
+        chunks++;
+
+        if( chunks == c->TruncateAt )
+        {
+            /* the chunks the reader has not read yet are gone */
+            if( NvOsFopen( dev->FileName, NVOS_OPEN_CREATE | NVOS_OPEN_WRITE,
+                    &hFile ) != NvSuccess )
+            {
+                dev->BadData = NV_TRUE;
+                return;
+            }
+            NvOsFclose( hFile );
+        }
+
+        if( chunks == c->FailAt )
+        {
+            /* drains the rest of the window and nacks it */
+            Nv3pTransferFail( dev->hSock, Nv3pNackCode_BadData );
+            return;
+        }
+    }
+}
+
+static void
+test_device_thread( void *args )
+{
+    TestDevice *dev = (TestDevice *)args;
+    NvU8 *buf;
+
+    buf = NvOsAlloc( NVFLASH_DOWNLOAD_CHUNK );
+
+    for( ;; )
+    {
+        NvOsSemaphoreWait( dev->hStart );
+        if( dev->Exit )
+        {
+            break;
+        }
+
+        if( buf )
+        {
+            test_device_run( dev, buf );
+        }
+        else
+        {
+            dev->BadData = NV_TRUE;
+        }
+        NvOsSemaphoreSignal( dev->hDone );
+    }
+
+    NvOsFree( buf );
+}
+
+static NvBool
+test_run( TestDevice *dev, const TestCase *c )
+{
+    NvError e;
+    Nv3pCmdGetWindowSize a;
+    NvU64 size = (NvU64)c->Chunks * NVFLASH_DOWNLOAD_CHUNK + TEST_TAIL;
+    NvS32 semaphores;
+    NvS32 threads;
+    NvU32 created;
+    NvBool b;
+    NvBool ok = NV_TRUE;
+
+    e = test_write_file( dev->FileName, size );
+    if( e != NvSuccess )
+    {
+        NvAuPrintf( "%-20s cannot write %s NvError 0x%x\n", c->Name,
+            dev->FileName, e );
+        return NV_FALSE;
+    }
+
+    dev->Case = c;
+    dev->Expected = (c->NoOfBytes && c->NoOfBytes < size) ?
+        c->NoOfBytes : size;
+    dev->Received = 0;
+    dev->BadData = NV_FALSE;
+    dev->Ended = NV_FALSE;
+    NvOsSemaphoreSignal( dev->hStart );
+
+    if( c->Window > 1 )
+    {
+        e = Nv3pCommandSend( s_hSock, Nv3pCommand_GetWindowSize, &a, 0 );
+        if( e == NvSuccess )
+        {
+            e = Nv3pSetWindowSize( s_hSock, NV_MIN( c->Window, a.WindowSize ) );
+        }
+        if( e != NvSuccess )
+        {
+            /* the device cannot be brought back in step */
+            NvAuPrintf( "%-20s window negotiation failed NvError 0x%x\n",
+                c->Name, e );
+            return NV_FALSE;
+        }
+    }
+
+    semaphores = s_LiveSemaphores;
+    threads = s_LiveThreads;
+    created = s_ThreadsCreated;
+
+    b = nvflash_sendfile( dev->FileName, c->NoOfBytes );
+
+    if( !b && c->TruncateAt )
+    {
+        /* the device still waits for the rest of the file */
+        Nv3pAck( s_hSock );
+    }
+    NvOsSemaphoreWait( dev->hDone );
+
+    if( b != c->Success )
+    {
+        NvAuPrintf( "%-20s nvflash_sendfile returned %s\n", c->Name,
+            b ? "success" : "failure" );
+        ok = NV_FALSE;
+    }
+    if( dev->BadData )
+    {
+        NvAuPrintf( "%-20s device received bad data\n", c->Name );
+        ok = NV_FALSE;
+    }
+    if( c->Success && dev->Received != dev->Expected )
+    {
+        NvAuPrintf( "%-20s device received %llu of %llu bytes\n", c->Name,
+            dev->Received, dev->Expected );
+        ok = NV_FALSE;
+    }
+    if( !c->Success && dev->Received >= dev->Expected )
+    {
+        NvAuPrintf( "%-20s device received the whole file\n", c->Name );
+        ok = NV_FALSE;
+    }
+    if( c->TruncateAt && !dev->Ended )
+    {
+        NvAuPrintf( "%-20s device did not see the transfer end\n", c->Name );
+        ok = NV_FALSE;
+    }
+    if( s_ThreadsCreated == created )
+    {
+        NvAuPrintf( "%-20s no reader thread was started\n", c->Name );
+        ok = NV_FALSE;
+    }
+    if( s_LiveThreads != threads )
+    {
+        NvAuPrintf( "%-20s %d reader threads not joined\n", c->Name,
+            s_LiveThreads - threads );
+        ok = NV_FALSE;
+    }
+    if( s_LiveSemaphores != semaphores )
+    {
+        NvAuPrintf( "%-20s %d semaphores not destroyed\n", c->Name,
+            s_LiveSemaphores - semaphores );
+        ok = NV_FALSE;
+    }
+
+    NvAuPrintf( "%-20s %llu bytes received, %s\n", c->Name, dev->Received,
+        ok ? "ok" : "FAILED" );
+    return ok;
+}
+
+int
+main( int argc, const char *argv[] )
+{
+    NvError e = NvSuccess;
+    TestDevice dev;
+    NvOsThreadHandle hThread = 0;
+    NvU32 failed = 0;
+    NvU32 i;
+
+    NvOsMemset( &dev, 0, sizeof(dev) );
+    dev.FileName = (argc > 1) ? argv[1] : TEST_DEFAULT_FILE;
+
+    /* both ends share the pipes created by the first open */
+    NV_CHECK_ERROR_CLEANUP(
+        Nv3pOpen( &s_hSock, Nv3pTransportMode_Sema, 0 )
+    );
+    NV_CHECK_ERROR_CLEANUP(
+        Nv3pOpen( &dev.hSock, Nv3pTransportMode_Sema, 1 )
+    );
+
+    NV_CHECK_ERROR_CLEANUP(
+        NvOsSemaphoreCreate( &dev.hStart, 0 )
+    );
+    NV_CHECK_ERROR_CLEANUP(
+        NvOsSemaphoreCreate( &dev.hDone, 0 )
+    );
+    NV_CHECK_ERROR_CLEANUP(
+        NvOsThreadCreate( test_device_thread, &dev, &hThread )
+    );
+
+    for( i = 0; i < NV_ARRAY_SIZE(s_Cases); i++ )
+    {
+        if( !test_run( &dev, &s_Cases[i] ) )
+        {
+            failed++;
+            /* the loopback may be out of step, the remaining cases are moot */
+            if( dev.BadData || s_Cases[i].Window > 1 )
+            {
+                break;
+            }
+        }
+    }
+
+    dev.Exit = NV_TRUE;
+    NvOsSemaphoreSignal( dev.hStart );
+    NvOsThreadJoin( hThread );
+    hThread = 0;
+
+    NvOsFremove( dev.FileName );
+    NvAuPrintf( "%s\n", failed ? "FAILED" : "PASSED" );
+    goto clean;
+
+fail:
+    NvAuPrintf( "test setup failed NvError 0x%x\n", e );
+    failed = 1;
+
+clean:
+    /* a device thread blocked on the loopback cannot be woken, leave it */
+    if( !hThread )
+    {
+        NvOsSemaphoreDestroy( dev.hStart );
+        NvOsSemaphoreDestroy( dev.hDone );
+        if( dev.hSock )
+        {
+            Nv3pClose( dev.hSock );
+        }
+        if( s_hSock )
+        {
+            Nv3pClose( s_hSock );
+        }
+    }
+    return failed ? 1 : 0;
+}
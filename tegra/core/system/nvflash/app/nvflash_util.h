@@ -197,6 +197,13 @@ nvflash_validate_versionstr(char* VersionStr);
 NvBool
 nvflash_validate_nv3pserver_version(Nv3pSocketHandle s_hSock);
 
+/**
+ * Enables windowed data transfers if the 3pserver supports them; older
+ * servers reject the query and the socket stays in stop-and-wait mode
+ */
+NvBool
+nvflash_negotiate_window(Nv3pSocketHandle s_hSock);
+
 /**
  * Validates the nvsecuretool version with nvflash app version
  */
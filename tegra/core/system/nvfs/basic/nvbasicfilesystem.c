@@ -691,6 +691,54 @@ NvFileSystemFileIoctl(
         }
         case NvFileSystemIoctlType_WriteTagDataDisable:
             break;
+        case NvFileSystemIoctlType_TrimErase:
+        {
+            const NvFileSystemIoctl_TrimEraseInputArgs *pTrim =
+                (const NvFileSystemIoctl_TrimEraseInputArgs *)InputArgs;
+            NvDdkBlockDevIoctl_EraseLogicalSectorsInputArgs EraseArgs;
+            NvDdkBlockDevHandle hBlockDeviceDriver =
+                pNvBasicFileSystemFile->pBasicFileSystem->hBlkDevHandle;
+            NvU32 BytesPerSector = pNvBasicFileSystemFile->BytesPerSector;
+            NvU64 StartSector;
+            NvU64 EndSector;
+
+            CHECK_PARAM(InputArgs);
+            CHECK_PARAM(InputSize ==
+                sizeof(NvFileSystemIoctl_TrimEraseInputArgs));
+            CHECK_PARAM(pNvBasicFileSystemFile->OpenMode == NVOS_OPEN_WRITE);
+
+            if ((pNvBasicFileSystemFile->FileOffset + pTrim->NumBytes) >
+                pNvBasicFileSystemFile->MaxFileSize)
+            {
+                Err = NvError_InvalidSize;
+                break;
+            }
+
+            // Only whole sectors, the cached sector is never among them
+            StartSector = (pNvBasicFileSystemFile->FileOffset +
+                BytesPerSector - 1) / BytesPerSector;
+            EndSector = (pNvBasicFileSystemFile->FileOffset +
+                pTrim->NumBytes) / BytesPerSector;
+            if (EndSector <= StartSector)
+                break;
+
+            NvOsMemset(&EraseArgs, 0, sizeof(EraseArgs));
+            EraseArgs.StartLogicalSector = (NvU32)(StartSector +
+                pNvBasicFileSystemFile->pBasicFileSystem->hPartion->
+                    StartLogicalSectorAddress);
+            EraseArgs.NumberOfLogicalSectors = (NvU32)(EndSector - StartSector);
+            EraseArgs.IsTrimErase = NV_TRUE;
+            EraseArgs.IsSecureErase = NV_FALSE;
+
+            Err = hBlockDeviceDriver->NvDdkBlockDevIoctl(
+                        hBlockDeviceDriver,
+                        NvDdkBlockDevIoctlType_EraseLogicalSectors,
+                        sizeof(NvDdkBlockDevIoctl_EraseLogicalSectorsInputArgs),
+                        0,
+                        &EraseArgs,
+                        NULL);
+            break;
+        }
         default:
             Err = NvError_BadParameter;
     }
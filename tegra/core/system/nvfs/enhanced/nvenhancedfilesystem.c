@@ -2409,6 +2409,11 @@ NvFileSystemFileIoctl(
             break;
         }
 
+        case NvFileSystemIoctlType_TrimErase:
+            // Only the basic file system maps files to plain sector ranges
+            e = NvError_NotSupported;
+            break;
+
         default:
             e = NvError_BadParameter;
     }
@@ -34,6 +34,7 @@ LOCAL_SRC_FILES += nvsecuretool_t1xx.c
 LOCAL_SRC_FILES += nvsecuretool_pkc.c
 LOCAL_SRC_FILES += nvsecuretool_version.c
 LOCAL_SRC_FILES += nvsecuretool_t12x.c
+LOCAL_SRC_FILES += nvsecuretool_batch.c
 LOCAL_SRC_FILES += nvtest.c
 LOCAL_SRC_FILES += nv_asn_parser.c
 
@@ -53,3 +54,32 @@ LOCAL_ADDITIONAL_DEPENDENCIES += $(TARGET_OUT_HEADERS)/nvtboot_t124.h
 LOCAL_LDLIBS += -lpthread -ldl
 
 include $(NVIDIA_HOST_EXECUTABLE)
+
+# SHA-256 check and throughput benchmark
+
+include $(NVIDIA_DEFAULTS)
+
+LOCAL_MODULE := sha256_bench
+
+LOCAL_SRC_FILES += sha256_bench.c
+LOCAL_SRC_FILES += nv_sha256.c
+
+LOCAL_STATIC_LIBRARIES += libnvos
+LOCAL_LDLIBS += -lpthread -ldl
+
+include $(NVIDIA_HOST_EXECUTABLE)
+
+# RSA signing check and throughput benchmark
+
+include $(NVIDIA_DEFAULTS)
+
+LOCAL_MODULE := rsa_bench
+
+LOCAL_SRC_FILES += rsa_bench.c
+LOCAL_SRC_FILES += nv_bigintmod.c
+LOCAL_SRC_FILES += nv_rsa_core.c
+
+LOCAL_STATIC_LIBRARIES += libnvos
+LOCAL_LDLIBS += -lpthread -ldl
+
+include $(NVIDIA_HOST_EXECUTABLE)
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2013, NVIDIA Corporation.  All rights reserved.
+ * Copyright (c) 2012-2014, NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -15,6 +15,24 @@
 #include "nv_cryptolib.h"
 #include "nvassert.h"
 
+/*
+ * With a 64x64->128 bit multiply the Montgomery products work on 64 bit
+ * limbs, a quarter of the multiplies of the 32 bit digit version.
+ */
+#if defined(__SIZEOF_INT128__)
+#define BIGINT_HAVE_LIMB64 1
+typedef unsigned __int128 NvBigIntU128;
+#define BIGINT_MAX_LIMBS (BIGINT_MAX_DW / 2)
+#else
+#define BIGINT_HAVE_LIMB64 0
+#endif
+
+/*
+ * Largest sliding window used by NvBigIntPowerMod(); the table of odd
+ * powers has 2^(BIGINT_MAX_WINDOW-1) entries.
+ */
+#define BIGINT_MAX_WINDOW 5
+
 
 /*
 * Finding inverse modulo 2^32, input must be odd number
@@ -77,7 +95,7 @@ static int NvBigIntCompare(const NvU32* x, const NvU32* y, const NvU32 digits)
     return 0;
 }
 
-static void NvBigIntSubtractMod(NvU32 *z, const NvU32* x, const NvU32* y, const NvBigIntModulus* p)
+void NvBigIntSubtractMod(NvU32 *z, const NvU32* x, const NvU32* y, const NvBigIntModulus* p)
 {
     if (NvBigIntSubtract(z, x, y, p->digits))
     {
@@ -169,6 +187,159 @@ static void NvBigIntMontgomeryProduct(NvU32* z, const NvU32* x, const NvU32* y,
   }
 }
 
+#if BIGINT_HAVE_LIMB64
+/*
+* -n^-1 mod 2^64 for odd n, by Newton iteration; each step doubles the
+* number of correct low bits, starting from 3
+*/
+static NvU64 NvInverseLimb(NvU64 n)
+{
+    NvU64 i = n;
+    NvU32 k;
+    for (k = 0; k < 5; k++)
+    {
+        i *= 2 - n * i;
+    }
+    return (NvU64)0 - i;
+}
+
+static void NvBigIntToLimbs(NvU64* z, const NvU32* x, const NvU32 limbs)
+{
+    NvU32 i;
+    for (i = 0; i < limbs; i++)
+    {
+        z[i] = x[2 * i] | ((NvU64)x[2 * i + 1] << 32);
+    }
+}
+
+static void NvBigIntFromLimbs(NvU32* z, const NvU64* x, const NvU32 limbs)
+{
+    NvU32 i;
+    for (i = 0; i < limbs; i++)
+    {
+        z[2 * i] = (NvU32)x[i];
+        z[2 * i + 1] = (NvU32)(x[i] >> 32);
+    }
+}
+
+static int NvBigIntCompare64(const NvU64* x, const NvU64* y, const NvU32 limbs)
+{
+    int i;
+    for (i = limbs - 1; i >= 0; i--)
+    {
+        if (x[i] > y[i])
+            return 1;
+        else if (x[i] < y[i])
+            return -1;
+    }
+    return 0;
+}
+
+/*
+* Same as NvBigIntMontgomeryProduct() on 64 bit limbs; z may be x or y
+*/
+static void NvBigIntMontgomeryProduct64(NvU64* z, const NvU64* x, const NvU64* y,
+                                        const NvU64* n, const NvU32 limbs,
+                                        const NvU64 invlimb)
+{
+    NvU64 t[BIGINT_MAX_LIMBS + 2], m, c;
+    NvBigIntU128 acc;
+    NvU32 i, j;
+
+    memset(t, 0, (limbs + 2) * sizeof(NvU64));
+    for (i = 0; i < limbs; i++)
+    {
+        // t += x[i] * y
+        c = 0;
+        for (j = 0; j < limbs; j++)
+        {
+            acc = (NvBigIntU128)x[i] * y[j] + t[j] + c;
+            t[j] = (NvU64)acc;
+            c = (NvU64)(acc >> 64);
+        }
+        acc = (NvBigIntU128)t[limbs] + c;
+        t[limbs] = (NvU64)acc;
+        t[limbs + 1] = (NvU64)(acc >> 64);
+
+        // t = (t + m * n) / 2^64, with m chosen to clear the low limb
+        m = t[0] * invlimb;
+        acc = (NvBigIntU128)m * n[0] + t[0];
+        c = (NvU64)(acc >> 64);
+        for (j = 1; j < limbs; j++)
+        {
+            acc = (NvBigIntU128)m * n[j] + t[j] + c;
+            t[j - 1] = (NvU64)acc;
+            c = (NvU64)(acc >> 64);
+        }
+        acc = (NvBigIntU128)t[limbs] + c;
+        t[limbs - 1] = (NvU64)acc;
+        t[limbs] = t[limbs + 1] + (NvU64)(acc >> 64);
+    }
+
+    // t < 2n here
+    if (t[limbs] || NvBigIntCompare64(t, n, limbs) >= 0)
+    {
+        c = 0;
+        for (j = 0; j < limbs; j++)
+        {
+            acc = (NvBigIntU128)t[j] - n[j] - c;
+            z[j] = (NvU64)acc;
+            c = (NvU64)(acc >> 64) & 1;
+        }
+    }
+    else
+    {
+        memcpy(z, t, limbs * sizeof(NvU64));
+    }
+}
+#endif
+
+/*
+* Operands of NvBigIntPowerMod(): the modulus, and a copy of it in 64 bit
+* limbs when those are used
+*/
+typedef struct NvBigIntMontRec
+{
+    const NvBigIntModulus* p;
+#if BIGINT_HAVE_LIMB64
+    NvU32 limbs;
+    NvU64 invlimb;
+    NvU64 n[BIGINT_MAX_LIMBS];
+#endif
+} NvBigIntMont;
+
+static void NvBigIntMontInit(NvBigIntMont* m, const NvBigIntModulus* p)
+{
+    m->p = p;
+#if BIGINT_HAVE_LIMB64
+    // an odd number of digits would change R, so keep to 32 bit then
+    m->limbs = (p->digits & 1) ? 0 : p->digits / 2;
+    if (m->limbs)
+    {
+        NvBigIntToLimbs(m->n, p->n, m->limbs);
+        m->invlimb = NvInverseLimb(m->n[0]);
+    }
+#endif
+}
+
+static void NvBigIntMontProduct(NvU32* z, const NvU32* x, const NvU32* y,
+                                const NvBigIntMont* m)
+{
+#if BIGINT_HAVE_LIMB64
+    if (m->limbs)
+    {
+        NvU64 x64[BIGINT_MAX_LIMBS], y64[BIGINT_MAX_LIMBS];
+
+        NvBigIntToLimbs(x64, x, m->limbs);
+        NvBigIntToLimbs(y64, y, m->limbs);
+        NvBigIntMontgomeryProduct64(x64, x64, y64, m->n, m->limbs, m->invlimb);
+        NvBigIntFromLimbs(z, x64, m->limbs);
+        return;
+    }
+#endif
+    NvBigIntMontgomeryProduct(z, x, y, m->p);
+}
+
 static NvU32 NvBigIntGetBit(const NvU32* x, NvU32 i)
 {
   NvU32 b = 0;
@@ -275,28 +446,157 @@ void NvBigIntInverseMod(NvU32 *z, const NvU32* x, const NvBigIntModulus* p)
     memcpy(z, d, p->digits * sizeof(NvU32));
 }
 
+/*
+* Window size for an exponent of the given number of bits; larger windows
+* need fewer multiplies but more precomputed powers
+*/
+static NvU32 NvBigIntWindowBits(NvU32 bits)
+{
+    if (bits > 239)
+        return BIGINT_MAX_WINDOW;
+    if (bits > 79)
+        return 4;
+    if (bits > 23)
+        return 3;
+    return 1;
+}
+
+/*
+* z = x^e mod p, left to right with a sliding window: runs of zero bits
+* cost one squaring each, and each window of up to w bits starting and
+* ending with a one costs w squarings and one multiply by a precomputed
+* odd power of x
+*/
 void NvBigIntPowerMod(NvU32* z, const NvU32* x, const NvU32* e, const NvBigIntModulus* p, const NvU32 e_digits)
 {
-  int i;
-  NvU32 one[BIGINT_MAX_DW], rx[BIGINT_MAX_DW];
+  int i, j;
+  NvU32 k, w, val, bits;
+  NvU32 one[BIGINT_MAX_DW], x2[BIGINT_MAX_DW], acc[BIGINT_MAX_DW];
+  NvU32 table[1 << (BIGINT_MAX_WINDOW - 1)][BIGINT_MAX_DW];
+  NvBool started = NV_FALSE;
+  NvBigIntMont m;
 
   memset(one, 0, sizeof(NvU32)*BIGINT_MAX_DW);
   one[0] = 1;
 
-  for (i = e_digits * 32 - 1; !NvBigIntGetBit(e, i) && i >= 0; i--);
+  for (i = e_digits * 32 - 1; i >= 0 && !NvBigIntGetBit(e, i); i--);
   if (i < 0)
   {
     memcpy(z, one, p->digits * sizeof(NvU32));
     return;
   }
-  NvBigIntMontgomeryProduct(rx, x, p->r2, p);
-  memcpy(z, rx, p->digits * sizeof(NvU32));
-  for (i--; i >= 0; i--)
+  bits = i + 1;
+  w = NvBigIntWindowBits(bits);
+
+  // table[k] = x^(2k+1) in Montgomery form
+  NvBigIntMontInit(&m, p);
+  NvBigIntMontProduct(table[0], x, p->r2, &m);
+  if (w > 1)
   {
-    NvBigIntMontgomeryProduct(z, z, z, p);
-    if (NvBigIntGetBit(e, i)) NvBigIntMontgomeryProduct(z, z, rx, p);
+    NvBigIntMontProduct(x2, table[0], table[0], &m);
+    for (k = 1; k < (1U << (w - 1)); k++)
+      NvBigIntMontProduct(table[k], table[k - 1], x2, &m);
   }
-  NvBigIntMontgomeryProduct(z, z, one, p);
+
+  while (i >= 0)
+  {
+    if (!NvBigIntGetBit(e, i))
+    {
+      NvBigIntMontProduct(acc, acc, acc, &m);
+      i--;
+      continue;
+    }
+
+    // longest window of at most w bits from bit i down, ending in a one
+    j = (i + 1 >= (int)w) ? i - (int)w + 1 : 0;
+    while (!NvBigIntGetBit(e, j))
+      j++;
+    for (val = 0, k = i + 1; k-- > (NvU32)j; )
+      val = (val << 1) | NvBigIntGetBit(e, k);
+
+    if (started)
+    {
+      for (k = 0; k < (NvU32)(i - j + 1); k++)
+        NvBigIntMontProduct(acc, acc, acc, &m);
+      NvBigIntMontProduct(acc, acc, table[val >> 1], &m);
+    }
+    else
+    {
+      memcpy(acc, table[val >> 1], p->digits * sizeof(NvU32));
+      started = NV_TRUE;
+    }
+    i = j - 1;
+  }
+  NvBigIntMontProduct(z, acc, one, &m);
+}
+
+/*
+* z = x mod m for any m > 0 of m_digits digits, one bit of x at a time;
+* z has m_digits digits
+*/
+void NvBigIntMod(NvU32* z, const NvU32* x, const NvU32 x_digits, const NvU32* m, const NvU32 m_digits)
+{
+  NvU32 r[BIGINT_MAX_DW + 1], mm[BIGINT_MAX_DW + 1];
+  NvU32 j, carry;
+  int b;
+
+  memset(r, 0, (m_digits + 1) * sizeof(NvU32));
+  memcpy(mm, m, m_digits * sizeof(NvU32));
+  mm[m_digits] = 0;
+
+  for (b = x_digits * 32 - 1; b >= 0; b--)
+  {
+    // r = 2r + bit; r < 2m fits in m_digits + 1 digits
+    carry = NvBigIntGetBit(x, b);
+    for (j = 0; j <= m_digits; j++)
+    {
+      NvU32 next = r[j] >> 31;
+      r[j] = (r[j] << 1) | carry;
+      carry = next;
+    }
+    if (NvBigIntCompare(r, mm, m_digits + 1) >= 0)
+      NvBigIntSubtract(r, r, mm, m_digits + 1);
+  }
+  memcpy(z, r, m_digits * sizeof(NvU32));
+}
+
+/*
+* z = x mod p for x of 2 * p->digits digits. With the top bit of p set
+* each half of x is below 2p, so the high half only needs one Montgomery
+* product by R^2 to move it down; otherwise this falls back to NvBigIntMod()
+*/
+void NvBigIntReduceMod(NvU32* z, const NvU32* x, const NvBigIntModulus* p)
+{
+  const NvU32 digits = p->digits;
+  NvU32 hi[BIGINT_MAX_DW], lo[BIGINT_MAX_DW];
+
+  if (!(p->n[digits - 1] & 0x80000000))
+  {
+    NvBigIntMod(z, x, digits * 2, p->n, digits);
+    return;
+  }
+
+  memcpy(lo, x, digits * sizeof(NvU32));
+  memcpy(hi, x + digits, digits * sizeof(NvU32));
+  if (NvBigIntCompare(lo, p->n, digits) >= 0)
+    NvBigIntSubtract(lo, lo, p->n, digits);
+  if (NvBigIntCompare(hi, p->n, digits) >= 0)
+    NvBigIntSubtract(hi, hi, p->n, digits);
+
+  // hi * R mod p, R = 2^(32 * digits)
+  NvBigIntMontgomeryProduct(hi, hi, p->r2, p);
+  NvBigIntAddMod(z, hi, lo, p);
+}
+
+/*
+* z = x * y mod p, for x, y < p
+*/
+void NvBigIntMultiplyMod(NvU32* z, const NvU32* x, const NvU32* y, const NvBigIntModulus* p)
+{
+  NvU32 t[BIGINT_MAX_DW];
+
+  NvBigIntMontgomeryProduct(t, x, y, p);
+  NvBigIntMontgomeryProduct(z, t, p->r2, p);
 }
 
 void NvInitBigIntModulus(NvBigIntModulus* p, const NvU8* data, const NvU32 size, NvU32 swap)
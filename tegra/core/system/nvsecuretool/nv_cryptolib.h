@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2013, NVIDIA Corporation.  All rights reserved.
+ * Copyright (c) 2012-2014, NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -22,6 +22,11 @@ void NvBigIntHalve(NvU32 *z, const NvU32* x, const NvU32 carry, const NvU32 digi
 void NvBigIntMultiply(NvU32 *z, const NvU32* x, const NvU32* y, const NvU32 digits);
 void NvBigIntAddMod(NvU32 *z, const NvU32* x, const NvU32* y, const NvBigIntModulus* p);
 NvU32 NvBigIntAdd(NvU32* z, const NvU32* x, const NvU32* y, const NvU32 digits);
+void NvBigIntSubtractMod(NvU32 *z, const NvU32* x, const NvU32* y, const NvBigIntModulus* p);
+void NvBigIntMultiplyMod(NvU32 *z, const NvU32* x, const NvU32* y, const NvBigIntModulus* p);
+void NvBigIntReduceMod(NvU32 *z, const NvU32* x, const NvBigIntModulus* p);
+void NvBigIntMod(NvU32 *z, const NvU32* x, const NvU32 x_digits,
+                 const NvU32* m, const NvU32 m_digits);
 
 //RSA
 
@@ -34,6 +39,16 @@ NvU32 NvBigIntAdd(NvU32* z, const NvU32* x, const NvU32* y, const NvU32 digits);
 */
 void NvRSAEncDecMessage(NvU32* output, NvU32* message, NvU32* exponent, NvBigIntModulus* n);
 
+/**
+* Does c = m^d (mod n) from the CRT form of the private key, about three
+* times faster than NvRSAEncDecMessage() with d. The result is checked
+* with the public exponent and recomputed with d if it is wrong.
+* @param output will contain the result of the modular exponentiation
+* @param message on which the exponentiation will be applied
+* @param key private key, set up by NvRSAInitCrtKey()
+*/
+void NvRSACrtEncDecMessage(NvU32* output, const NvU32* message, const NvRSACrtKey* key);
+
 /**
  * NvOsBase64Decode - Convert an encoded char buffer to binary
  */
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2013, NVIDIA Corporation.  All rights reserved.
+ * Copyright (c) 2012-2014, NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -50,6 +50,7 @@ void NvRSAPrivateKeyGeneration(NvU32* result, NvU32* e,
   NvU32 phi[BIGINT_MAX_DW];
   NvU32 a=1;
   NvU32 b[BIGINT_MAX_DW];
+  NvU32 bn[BIGINT_MAX_DW*2];
   NvU32 eDoublePrime;
   NvS32 i = 0;
   NvU32 terminate=NV_FALSE;
@@ -101,9 +102,9 @@ void NvRSAPrivateKeyGeneration(NvU32* result, NvU32* e,
   b[0] = i;
 
   //(5) the final value is d = d' + b * n'
-  memset(result, 0, digit*4);
-  NvBigIntMultiply(result, b, nPrime, digit);
-  NvBigIntAdd(result, dPrime, result, digit);
+  // the product has 2*digit digits, the upper half zero as d < phi
+  NvBigIntMultiply(bn, b, nPrime, digit);
+  NvBigIntAdd(result, dPrime, bn, digit);
 
 }
 
@@ -124,3 +125,68 @@ void NvRSAEncDecMessage
     (NvU32* output, NvU32* message, NvU32* exponent, NvBigIntModulus* n) {
   NvBigIntPowerMod(output, message, exponent, n, n->digits);
 }
+
+void NvRSAInitCrtKey(NvRSACrtKey* key, const NvU32* p, const NvU32* q,
+                     const NvU32* d, NvU32 e, NvU32 digit)
+{
+  NvU32 half = digit / 2;
+  NvU32 t[BIGINT_MAX_DW];
+
+  memset(key, 0, sizeof(NvRSACrtKey));
+  NvInitBigIntModulus(&key->p, (const NvU8*)p, half*sizeof(NvU32), NV_FALSE);
+  NvInitBigIntModulus(&key->q, (const NvU8*)q, half*sizeof(NvU32), NV_FALSE);
+
+  NvBigIntMultiply(t, p, q, half);
+  NvInitBigIntModulus(&key->n, (const NvU8*)t, digit*sizeof(NvU32), NV_FALSE);
+
+  memcpy(key->d, d, digit*sizeof(NvU32));
+  key->e = e;
+
+  // dp = d mod (p-1), dq = d mod (q-1); p and q are odd, so no borrow
+  memcpy(t, p, half*sizeof(NvU32));
+  t[0]--;
+  NvBigIntMod(key->dp, d, digit, t, half);
+  memcpy(t, q, half*sizeof(NvU32));
+  t[0]--;
+  NvBigIntMod(key->dq, d, digit, t, half);
+
+  // qinv = q^-1 mod p
+  NvBigIntMod(t, q, half, p, half);
+  NvBigIntInverseMod(key->qinv, t, &key->p);
+}
+
+/*
+* Garner's recombination: with sp = m^dp mod p and sq = m^dq mod q,
+* s = sq + q * ((sp - sq) * qinv mod p). A wrong s (a fault, or a message
+* not below n) is caught by s^e and redone the slow way.
+*/
+void NvRSACrtEncDecMessage(NvU32* output, const NvU32* message, const NvRSACrtKey* key)
+{
+  const NvU32 digit = key->n.digits;
+  const NvU32 half = key->p.digits;
+  NvU32 mp[BIGINT_MAX_DW], mq[BIGINT_MAX_DW];
+  NvU32 sp[BIGINT_MAX_DW], sq[BIGINT_MAX_DW];
+  NvU32 h[BIGINT_MAX_DW], s[BIGINT_MAX_DW];
+  NvU32 t[BIGINT_MAX_DW];
+
+  NvBigIntReduceMod(mp, message, &key->p);
+  NvBigIntReduceMod(mq, message, &key->q);
+  NvBigIntPowerMod(sp, mp, key->dp, &key->p, half);
+  NvBigIntPowerMod(sq, mq, key->dq, &key->q, half);
+
+  // h = (sp - sq) * qinv mod p
+  memset(t, 0, digit*sizeof(NvU32));
+  memcpy(t, sq, half*sizeof(NvU32));
+  NvBigIntReduceMod(h, t, &key->p);
+  NvBigIntSubtractMod(h, sp, h, &key->p);
+  NvBigIntMultiplyMod(h, h, key->qinv, &key->p);
+
+  // s = h * q + sq, below n
+  NvBigIntMultiply(s, h, key->q.n, half);
+  NvBigIntAdd(s, s, t, digit);
+
+  NvBigIntPowerMod(h, s, &key->e, &key->n, 1);
+  if (memcmp(h, message, digit*sizeof(NvU32)))
+    NvBigIntPowerMod(s, message, key->d, &key->n, digit);
+  memcpy(output, s, digit*sizeof(NvU32));
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2013, NVIDIA Corporation.  All rights reserved.
+ * Copyright (c) 2012-2014, NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -13,13 +13,41 @@
 #include "nvos.h"
 #include "nv_sha256.h"
 
+#if defined(__ARM_FEATURE_CRYPTO)
+#include <arm_neon.h>
+#define SHA256_HAVE_ARMV8 1
+#else
+#define SHA256_HAVE_ARMV8 0
+#endif
+
+#if (defined(__i386__) || defined(__x86_64__)) && (defined(__clang__) || \
+    __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA256_HAVE_X86 1
+#else
+#define SHA256_HAVE_X86 0
+#endif
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SHA256_HAVE_NEON 1
+#else
+#define SHA256_HAVE_NEON 0
+#endif
+
 #define LEFT_ROTATE(x,n)  (((x) << (n)) | ((x) >> (32-(n))))
 #define RIGHT_ROTATE(x,n) (((x) >> (n)) | ((x) << (32-(n))))
 
 #define LEFT_SHIFT(x,n)  (((x) << (n)))
 #define RIGHT_SHIFT(x,n) (((x) >> (n)))
 
-static NvU32 k[64] = {
+#define SHA256_BLOCK_SIZE   64
+
+/*  number of messages hashed side by side by NvSHA256_MultiHash() */
+#define SHA256_LANES        4
+
+static const NvU32 k[64] = {
 0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
@@ -29,102 +57,307 @@ static NvU32 k[64] = {
 0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
 
+static const NvU32 s_InitialState[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+/*  hashes NumBlocks consecutive 64 byte blocks into the h-variables */
+typedef void (*Sha256BlocksFunc)(NvU32 *pState, const NvU8 *pMsg,
+                                 NvU32 NumBlocks);
+
+#define SHA256_LOAD_BE(p) \
+    (((NvU32)(p)[0] << 24) | ((NvU32)(p)[1] << 16) | \
+     ((NvU32)(p)[2] << 8) | (NvU32)(p)[3])
+
+#define SHA256_CH(e,f,g)  ((g) ^ ((e) & ((f) ^ (g))))
+#define SHA256_MAJ(a,b,c) (((a) & (b)) | ((c) & ((a) | (b))))
+
+#define SHA256_S0(x) (RIGHT_ROTATE(x,2) ^ RIGHT_ROTATE(x,13) ^ RIGHT_ROTATE(x,22))
+#define SHA256_S1(x) (RIGHT_ROTATE(x,6) ^ RIGHT_ROTATE(x,11) ^ RIGHT_ROTATE(x,25))
+#define SHA256_s0(x) (RIGHT_ROTATE(x,7) ^ RIGHT_ROTATE(x,18) ^ RIGHT_SHIFT(x,3))
+#define SHA256_s1(x) (RIGHT_ROTATE(x,17) ^ RIGHT_ROTATE(x,19) ^ RIGHT_SHIFT(x,10))
+
+/*
+ *  One round. Rather than moving all eight h-variables along, the callers
+ *  rename them, so only d and h change.
+ */
+#define SHA256_ROUND(a,b,c,d,e,f,g,h,i) \
+    do { \
+        NvU32 t1 = (h) + SHA256_S1(e) + SHA256_CH(e,f,g) + k[i] + w[(i) & 15]; \
+        (d) += t1; \
+        (h) = t1 + SHA256_S0(a) + SHA256_MAJ(a,b,c); \
+    } while (0)
+
+/*  extends the message schedule in place, keeping only the last 16 words */
+#define SHA256_SCHEDULE(i) \
+    (w[(i) & 15] += SHA256_s1(w[((i) - 2) & 15]) + w[((i) - 7) & 15] + \
+                    SHA256_s0(w[((i) - 15) & 15]))
+
+static void Sha256GenericBlocks(NvU32 *pState, const NvU8 *pMsg, NvU32 NumBlocks)
+{
+    NvU32 a, b, c, d, e, f, g, h;
+    NvU32 w[16];
+    NvU32 i, j;
+
+    for (; NumBlocks; NumBlocks--, pMsg += SHA256_BLOCK_SIZE)
+    {
+        for (i = 0; i < 16; i++)
+            w[i] = SHA256_LOAD_BE(pMsg + 4 * i);
+
+        a = pState[0];
+        b = pState[1];
+        c = pState[2];
+        d = pState[3];
+        e = pState[4];
+        f = pState[5];
+        g = pState[6];
+        h = pState[7];
+
+        for (i = 0; i < 64; i += 8)
+        {
+            if (i >= 16)
+            {
+                for (j = i; j < i + 8; j++)
+                    SHA256_SCHEDULE(j);
+            }
+            SHA256_ROUND(a, b, c, d, e, f, g, h, i);
+            SHA256_ROUND(h, a, b, c, d, e, f, g, i + 1);
+            SHA256_ROUND(g, h, a, b, c, d, e, f, i + 2);
+            SHA256_ROUND(f, g, h, a, b, c, d, e, i + 3);
+            SHA256_ROUND(e, f, g, h, a, b, c, d, i + 4);
+            SHA256_ROUND(d, e, f, g, h, a, b, c, i + 5);
+            SHA256_ROUND(c, d, e, f, g, h, a, b, i + 6);
+            SHA256_ROUND(b, c, d, e, f, g, h, a, i + 7);
+        }
+
+        pState[0] += a;
+        pState[1] += b;
+        pState[2] += c;
+        pState[3] += d;
+        pState[4] += e;
+        pState[5] += f;
+        pState[6] += g;
+        pState[7] += h;
+    }
+}
+
+#if SHA256_HAVE_ARMV8
+/*
+ *  Each vsha256h/vsha256h2 pair does four rounds on the abcd and efgh
+ *  halves of the state; vsha256su0/vsha256su1 extend the schedule four
+ *  words at a time.
+ */
+static void Sha256Armv8Blocks(NvU32 *pState, const NvU8 *pMsg, NvU32 NumBlocks)
+{
+    uint32x4_t abcd, efgh, abcd0, efgh0, wk, t;
+    uint32x4_t m[4];
+    NvU32 i;
+
+    abcd = vld1q_u32(pState);
+    efgh = vld1q_u32(pState + 4);
+
+    for (; NumBlocks; NumBlocks--, pMsg += SHA256_BLOCK_SIZE)
+    {
+        abcd0 = abcd;
+        efgh0 = efgh;
+        for (i = 0; i < 4; i++)
+            m[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(pMsg + 16 * i)));
+
+        for (i = 0; i < 16; i++)
+        {
+            wk = vaddq_u32(m[i & 3], vld1q_u32(&k[4 * i]));
+            if (i < 12)
+                m[i & 3] = vsha256su1q_u32(
+                    vsha256su0q_u32(m[i & 3], m[(i + 1) & 3]),
+                    m[(i + 2) & 3], m[(i + 3) & 3]);
+            t = abcd;
+            abcd = vsha256hq_u32(abcd, efgh, wk);
+            efgh = vsha256h2q_u32(efgh, t, wk);
+        }
+
+        abcd = vaddq_u32(abcd, abcd0);
+        efgh = vaddq_u32(efgh, efgh0);
+    }
+
+    vst1q_u32(pState, abcd);
+    vst1q_u32(pState + 4, efgh);
+}
+#endif
+
+#if SHA256_HAVE_X86
+/*
+ *  The SHA extensions keep the state as ABEF and CDGH; each sha256rnds2
+ *  does two rounds, and sha256msg1/sha256msg2 extend the schedule four
+ *  words at a time.
+ */
+static void __attribute__((target("ssse3,sse4.1,sha")))
+Sha256ShaNiBlocks(NvU32 *pState, const NvU8 *pMsg, NvU32 NumBlocks)
+{
+    const __m128i Swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                        0x0405060700010203ULL);
+    __m128i state0, state1, save0, save1, wk, t;
+    __m128i m[4];
+    NvU32 i;
+
+    t = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)pState), 0xB1);
+    state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(pState + 4)),
+                               0x1B);
+    state0 = _mm_alignr_epi8(t, state1, 8);         // ABEF
+    state1 = _mm_blend_epi16(state1, t, 0xF0);      // CDGH
+
+    for (; NumBlocks; NumBlocks--, pMsg += SHA256_BLOCK_SIZE)
+    {
+        save0 = state0;
+        save1 = state1;
+        for (i = 0; i < 4; i++)
+            m[i] = _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i *)(pMsg + 16 * i)), Swap);
+
+        for (i = 0; i < 16; i++)
+        {
+            wk = _mm_add_epi32(m[i & 3],
+                               _mm_loadu_si128((const __m128i *)&k[4 * i]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+            state0 = _mm_sha256rnds2_epu32(state0, state1,
+                                           _mm_shuffle_epi32(wk, 0x0E));
+            if (i < 12)
+            {
+                t = _mm_sha256msg1_epu32(m[i & 3], m[(i + 1) & 3]);
+                t = _mm_add_epi32(t, _mm_alignr_epi8(m[(i + 3) & 3],
+                                                     m[(i + 2) & 3], 4));
+                m[i & 3] = _mm_sha256msg2_epu32(t, m[(i + 3) & 3]);
+            }
+        }
+
+        state0 = _mm_add_epi32(state0, save0);
+        state1 = _mm_add_epi32(state1, save1);
+    }
+
+    t = _mm_shuffle_epi32(state0, 0x1B);            // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);       // DCHG
+    state0 = _mm_blend_epi16(t, state1, 0xF0);      // DCBA
+    state1 = _mm_alignr_epi8(state1, t, 8);         // HGFE
+    _mm_storeu_si128((__m128i *)pState, state0);
+    _mm_storeu_si128((__m128i *)(pState + 4), state1);
+}
+
+static NvBool Sha256HaveShaNi(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (__get_cpuid_max(0, NULL) < 7)
+        return NV_FALSE;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return NV_FALSE;
+    if (!(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1))
+        return NV_FALSE;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & (1 << 29)) ? NV_TRUE : NV_FALSE;  // SHA
+}
+#endif
+
+static const Sha256BlocksFunc s_Sha256Blocks[NvSHA256Backend_Num] = {
+    NULL,
+    Sha256GenericBlocks,
+#if SHA256_HAVE_X86
+    Sha256ShaNiBlocks,
+#else
+    NULL,
+#endif
+#if SHA256_HAVE_ARMV8
+    Sha256Armv8Blocks,
+#else
+    NULL,
+#endif
+};
+
+/*
+ *  Selected backend. Picking it is idempotent, so concurrent first calls
+ *  at worst make the same choice twice.
+ */
+static NvSHA256Backend s_Sha256Backend = NvSHA256Backend_Auto;
+
+static NvBool Sha256BackendSupported(NvSHA256Backend Backend)
+{
+    if ((NvU32)Backend >= NvSHA256Backend_Num || !s_Sha256Blocks[Backend])
+        return NV_FALSE;
+#if SHA256_HAVE_X86
+    if (Backend == NvSHA256Backend_ShaNi)
+        return Sha256HaveShaNi();
+#endif
+    return NV_TRUE;
+}
 
-static void SHA256_Process(NvSHA256_Data *pSHAData)
-{
-    NvU32 s0 = 0;
-    NvU32 s1 = 0;
-    NvU32 t1 = 0;
-    NvU32 t2 = 0;
-    NvU32 i = 0;
-    NvU32 a = 0;
-    NvU32 b = 0;
-    NvU32 c = 0;
-    NvU32 d = 0;
-    NvU32 e = 0;
-    NvU32 f = 0;
-    NvU32 g = 0;
-    NvU32 h = 0;
-    NvU32 temp_inputbuf[16];
-    NvU32 w[64];
-
-    memcpy(&temp_inputbuf, pSHAData->InputBuf, 64);
-    /*  copy the input buffer to first 16 words */
-    for (i = 0 ; i < 16 ; i++)
-    {
-        NvU32 temp;
-        temp = temp_inputbuf[i];
-        w[i] = ( ( (temp & 0X000000FF) << 24 )  |
-                 ( (temp & 0X0000FF00) << 8 )  |
-                 ( (temp & 0X00FF0000) >> 8 )  |
-                 ( (temp & 0XFF000000) >> 24 ) );
-    }
-
-    /*  extending 16 words to 64 words */
-    for (i = 16 ; i < 64 ; i++)
-    {
-        s0 = (RIGHT_ROTATE(w[i-15],7)) ^ (RIGHT_ROTATE(w[i-15],18)) ^ (RIGHT_SHIFT(w[i-15],3));
-        s1 = (RIGHT_ROTATE(w[i-2],17)) ^ (RIGHT_ROTATE(w[i-2],19)) ^ (RIGHT_SHIFT(w[i-2],10));
-        w[i] = w[i-16] + s0 + w[i-7] + s1;
-    }
-
-    a = pSHAData->h_state[0];
-    b = pSHAData->h_state[1];
-    c = pSHAData->h_state[2];
-    d = pSHAData->h_state[3];
-    e = pSHAData->h_state[4];
-    f = pSHAData->h_state[5];
-    g = pSHAData->h_state[6];
-    h = pSHAData->h_state[7];
-
-    /*  main loop */
-    for (i = 0 ; i < 64 ; i++)
-    {
-        NvU32 maj = 0;
-        NvU32 ch = 0;
-
-        s0 = (RIGHT_ROTATE(a,2)) ^ (RIGHT_ROTATE(a,13)) ^ (RIGHT_ROTATE(a,22));
-        maj = (a & b) ^ (a & c) ^ (b & c);
-        t2 = s0 + maj;
-        s1 = (RIGHT_ROTATE(e,6)) ^ (RIGHT_ROTATE(e,11)) ^ (RIGHT_ROTATE(e,25));
-        ch = (e & f) ^ ((~e) & g);
-        t1 = h + s1 + ch + k[i] + w[i];
-
-        h = g;
-        g = f;
-        f = e;
-        e = d + t1;
-        d = c;
-        c = b;
-        b = a;
-        a = t1 + t2;
-    }
-
-    pSHAData->h_state[0] += a;
-    pSHAData->h_state[1] += b;
-    pSHAData->h_state[2] += c;
-    pSHAData->h_state[3] += d;
-    pSHAData->h_state[4] += e;
-    pSHAData->h_state[5] += f;
-    pSHAData->h_state[6] += g;
-    pSHAData->h_state[7] += h;
+NvBool NvSHA256_SelectBackend(NvSHA256Backend Backend)
+{
+    if (Backend == NvSHA256Backend_Auto)
+    {
+        if (Sha256BackendSupported(NvSHA256Backend_Armv8))
+            Backend = NvSHA256Backend_Armv8;
+        else if (Sha256BackendSupported(NvSHA256Backend_ShaNi))
+            Backend = NvSHA256Backend_ShaNi;
+        else
+            Backend = NvSHA256Backend_Generic;
+    }
+    else if (!Sha256BackendSupported(Backend))
+    {
+        return NV_FALSE;
+    }
 
+    s_Sha256Backend = Backend;
+    return NV_TRUE;
 }
 
+NvSHA256Backend NvSHA256_GetBackend(void)
+{
+    if (s_Sha256Backend == NvSHA256Backend_Auto)
+        NvSHA256_SelectBackend(NvSHA256Backend_Auto);
+    return s_Sha256Backend;
+}
+
+static void Sha256Blocks(NvU32 *pState, const NvU8 *pMsg, NvU32 NumBlocks)
+{
+    s_Sha256Blocks[NvSHA256_GetBackend()](pState, pMsg, NumBlocks);
+}
+
+/*
+ *  Pads the last RemLen (< 64) bytes of a TotalLen byte message into one or
+ *  two blocks at pTail, and returns the number of blocks.
+ */
+static NvU32
+Sha256PadTail(NvU8 *pTail, const NvU8 *pRem, NvU32 RemLen, NvU64 TotalLen)
+{
+    NvU32 Blocks = (RemLen < SHA256_BLOCK_SIZE - 8) ? 1 : 2;
+    NvU32 End = Blocks * SHA256_BLOCK_SIZE;
+    NvU64 MsgLen = TotalLen * 8;
+    NvU32 i;
+
+    memcpy(pTail, pRem, RemLen);
+    pTail[RemLen] = 0x80;    /*  appending the message with '1' */
+    memset(pTail + RemLen + 1, 0, End - 8 - (RemLen + 1));
+    for (i = 0 ; i < 8 ; i++)
+        pTail[End - 8 + i] = (NvU8)(MsgLen >> (7-i) * 8);
+
+    return Blocks;
+}
+
+static void Sha256StoreHash(const NvU32 *pState, NvSHA256_Hash *pSHAHash)
+{
+    NvU32 i;
+
+    for (i = 0 ; i < SHA_256_HASH_SIZE ; i++)
+    {
+        NvU32 temp = pState[i/4];
+        pSHAHash->Hash[i] = temp >> (3-(i%4))*8;
+    }
+}
 
 NvS32 NvSHA256_Init(NvSHA256_Data *pSHAData)
 {
     if (pSHAData == NULL)
         return -1;
-    pSHAData->h_state[0] = 0x6a09e667;
-    pSHAData->h_state[1] = 0xbb67ae85;
-    pSHAData->h_state[2] = 0x3c6ef372;
-    pSHAData->h_state[3] = 0xa54ff53a;
-    pSHAData->h_state[4] = 0x510e527f;
-    pSHAData->h_state[5] = 0x9b05688c;
-    pSHAData->h_state[6] = 0x1f83d9ab;
-    pSHAData->h_state[7] = 0x5be0cd19;
 
+    memcpy(pSHAData->h_state, s_InitialState, sizeof(s_InitialState));
     pSHAData->Count = 0;
 
     return 0;
@@ -132,64 +365,340 @@ NvS32 NvSHA256_Init(NvSHA256_Data *pSHAData)
 
 NvS32 NvSHA256_Update(NvSHA256_Data *pSHAData, NvU8 *pMsg, NvU32 MsgLen)
 {
-    NvU32 i;
+    NvU32 Used;
+    NvU32 Len;
     const NvU8* p = (const NvU8*)pMsg;
 
     if ((pSHAData == NULL) || (pMsg == NULL))
         return -1;
 
-    i = pSHAData->Count % sizeof(pSHAData->InputBuf);
+    Used = (NvU32)(pSHAData->Count % sizeof(pSHAData->InputBuf));
     pSHAData->Count += MsgLen;
-    while (MsgLen--)
+
+    /*  complete a block left over from the previous call */
+    if (Used)
     {
-        pSHAData->InputBuf[i++] = *p++;
-        if (i == sizeof(pSHAData->InputBuf))
-        {
-            SHA256_Process(pSHAData);
-            i = 0;
-        }
+        Len = sizeof(pSHAData->InputBuf) - Used;
+        if (Len > MsgLen)
+            Len = MsgLen;
+        memcpy(pSHAData->InputBuf + Used, p, Len);
+        p += Len;
+        MsgLen -= Len;
+        if (Used + Len < sizeof(pSHAData->InputBuf))
+            return 0;
+        Sha256Blocks(pSHAData->h_state, pSHAData->InputBuf, 1);
+    }
+
+    /*  hash whole blocks in place */
+    Len = MsgLen / SHA256_BLOCK_SIZE;
+    if (Len)
+    {
+        Sha256Blocks(pSHAData->h_state, p, Len);
+        p += Len * SHA256_BLOCK_SIZE;
+        MsgLen -= Len * SHA256_BLOCK_SIZE;
     }
+
+    memcpy(pSHAData->InputBuf, p, MsgLen);
     return 0;
 }
 
 NvS32 NvSHA256_Finalize(NvSHA256_Data *pSHAData, NvSHA256_Hash *pSHAHash)
 {
-    NvU32 BufIndex = 0;
-    NvU32 BufSize = 0;
-    NvU32 i = 0;
-    NvU64 MsgLen = 0;
+    NvU8 Tail[2 * SHA256_BLOCK_SIZE];
+    NvU32 BufIndex;
+    NvU32 Blocks;
 
     if ((pSHAData == NULL) || (pSHAHash == NULL))
         return -1;
 
-    MsgLen = pSHAData->Count * 8;
-    BufSize = sizeof(pSHAData->InputBuf);
-    BufIndex = (NvU32)((pSHAData->Count) % (NvU64)BufSize);
+    BufIndex = (NvU32)(pSHAData->Count % sizeof(pSHAData->InputBuf));
+    Blocks = Sha256PadTail(Tail, pSHAData->InputBuf, BufIndex,
+                           pSHAData->Count);
+    Sha256Blocks(pSHAData->h_state, Tail, Blocks);
+    Sha256StoreHash(pSHAData->h_state, pSHAHash);
+    return 0;
+}
+
+/*
+ *  Multi-buffer hashing: each lane walks through the whole blocks of one
+ *  message and then its padded tail, and picks up the next message when
+ *  done. Lanes without a message hash a dummy block that is thrown away.
+ */
+typedef struct Sha256LaneRec
+{
+    const NvU8 *pMsg;       /*  next whole block of the message */
+    NvU32 Blocks;           /*  whole blocks left */
+    NvU32 TailBlocks;       /*  padded blocks left in Tail */
+    NvU32 TailIndex;        /*  next block in Tail */
+    NvU32 Index;            /*  message hashed by this lane */
+    NvBool Busy;
+    NvU8 Tail[2 * SHA256_BLOCK_SIZE];
+} Sha256Lane;
+
+#if SHA256_HAVE_X86
+#define SHA256_HAVE_LANES 1
+#define SHA256_LANES_ATTR __attribute__((target("sse2")))
+typedef __m128i Sha256Vec;
+#define VLOAD(p)        _mm_loadu_si128((const __m128i *)(p))
+#define VSTORE(p, x)    _mm_storeu_si128((__m128i *)(p), x)
+#define VDUP(x)         _mm_set1_epi32((int)(x))
+#define VADD(a, b)      _mm_add_epi32(a, b)
+#define VXOR(a, b)      _mm_xor_si128(a, b)
+#define VAND(a, b)      _mm_and_si128(a, b)
+#define VOR(a, b)       _mm_or_si128(a, b)
+#define VSHR(x, n)      _mm_srli_epi32(x, n)
+#define VSHL(x, n)      _mm_slli_epi32(x, n)
+#elif SHA256_HAVE_NEON
+#define SHA256_HAVE_LANES 1
+#define SHA256_LANES_ATTR
+typedef uint32x4_t Sha256Vec;
+#define VLOAD(p)        vld1q_u32(p)
+#define VSTORE(p, x)    vst1q_u32(p, x)
+#define VDUP(x)         vdupq_n_u32(x)
+#define VADD(a, b)      vaddq_u32(a, b)
+#define VXOR(a, b)      veorq_u32(a, b)
+#define VAND(a, b)      vandq_u32(a, b)
+#define VOR(a, b)       vorrq_u32(a, b)
+#define VSHR(x, n)      vshrq_n_u32(x, n)
+#define VSHL(x, n)      vshlq_n_u32(x, n)
+#else
+#define SHA256_HAVE_LANES 0
+#endif
 
-    pSHAData->InputBuf[BufIndex++] = 0x80;    /*  appending the message with '1' */
+#if SHA256_HAVE_LANES
+#define VROTR(x, n)     VOR(VSHR(x, n), VSHL(x, 32 - (n)))
+#define VCH(e,f,g)      VXOR(g, VAND(e, VXOR(f, g)))
+#define VMAJ(a,b,c)     VOR(VAND(a, b), VAND(c, VOR(a, b)))
+#define VS0(x)  VXOR(VXOR(VROTR(x, 2), VROTR(x, 13)), VROTR(x, 22))
+#define VS1(x)  VXOR(VXOR(VROTR(x, 6), VROTR(x, 11)), VROTR(x, 25))
+#define Vs0(x)  VXOR(VXOR(VROTR(x, 7), VROTR(x, 18)), VSHR(x, 3))
+#define Vs1(x)  VXOR(VXOR(VROTR(x, 17), VROTR(x, 19)), VSHR(x, 10))
 
-    if (BufIndex > (BufSize-8))
+#define SHA256_VROUND(a,b,c,d,e,f,g,h,i) \
+    do { \
+        Sha256Vec t1 = VADD(VADD(VADD(h, VS1(e)), VADD(VCH(e,f,g), VDUP(k[i]))), \
+                            w[(i) & 15]); \
+        (d) = VADD(d, t1); \
+        (h) = VADD(t1, VADD(VS0(a), VMAJ(a,b,c))); \
+    } while (0)
+
+#define SHA256_VSCHEDULE(i) \
+    (w[(i) & 15] = VADD(VADD(w[(i) & 15], Vs1(w[((i) - 2) & 15])), \
+                        VADD(w[((i) - 7) & 15], Vs0(w[((i) - 15) & 15]))))
+
+/*
+ *  Hashes one block per lane. pState holds word i of lane l at
+ *  pState[i * SHA256_LANES + l].
+ */
+static void SHA256_LANES_ATTR
+Sha256LanesBlock(NvU32 *pState, const NvU8 * const *ppBlock)
+{
+    Sha256Vec a, b, c, d, e, f, g, h;
+    Sha256Vec w[16];
+    NvU32 Words[SHA256_LANES];
+    NvU32 i, j;
+
+    for (i = 0; i < 16; i++)
     {
-        while (BufIndex < BufSize)
-            pSHAData->InputBuf[BufIndex++] = 0x00;
-        SHA256_Process(pSHAData);
-        BufIndex = 0;
+        for (j = 0; j < SHA256_LANES; j++)
+            Words[j] = SHA256_LOAD_BE(ppBlock[j] + 4 * i);
+        w[i] = VLOAD(Words);
     }
-    while (BufIndex < (BufSize-8))
-        pSHAData->InputBuf[BufIndex++] = 0x00;
 
-    for (i = 0 ; i < 8 ; i++)
-        pSHAData->InputBuf[BufIndex++] = (NvU8)(MsgLen >> (7-i) * 8);
+    a = VLOAD(pState + 0 * SHA256_LANES);
+    b = VLOAD(pState + 1 * SHA256_LANES);
+    c = VLOAD(pState + 2 * SHA256_LANES);
+    d = VLOAD(pState + 3 * SHA256_LANES);
+    e = VLOAD(pState + 4 * SHA256_LANES);
+    f = VLOAD(pState + 5 * SHA256_LANES);
+    g = VLOAD(pState + 6 * SHA256_LANES);
+    h = VLOAD(pState + 7 * SHA256_LANES);
+
+    for (i = 0; i < 64; i += 8)
+    {
+        if (i >= 16)
+        {
+            for (j = i; j < i + 8; j++)
+                SHA256_VSCHEDULE(j);
+        }
+        SHA256_VROUND(a, b, c, d, e, f, g, h, i);
+        SHA256_VROUND(h, a, b, c, d, e, f, g, i + 1);
+        SHA256_VROUND(g, h, a, b, c, d, e, f, i + 2);
+        SHA256_VROUND(f, g, h, a, b, c, d, e, i + 3);
+        SHA256_VROUND(e, f, g, h, a, b, c, d, i + 4);
+        SHA256_VROUND(d, e, f, g, h, a, b, c, i + 5);
+        SHA256_VROUND(c, d, e, f, g, h, a, b, i + 6);
+        SHA256_VROUND(b, c, d, e, f, g, h, a, i + 7);
+    }
+
+    VSTORE(pState + 0 * SHA256_LANES, VADD(a, VLOAD(pState + 0 * SHA256_LANES)));
+    VSTORE(pState + 1 * SHA256_LANES, VADD(b, VLOAD(pState + 1 * SHA256_LANES)));
+    VSTORE(pState + 2 * SHA256_LANES, VADD(c, VLOAD(pState + 2 * SHA256_LANES)));
+    VSTORE(pState + 3 * SHA256_LANES, VADD(d, VLOAD(pState + 3 * SHA256_LANES)));
+    VSTORE(pState + 4 * SHA256_LANES, VADD(e, VLOAD(pState + 4 * SHA256_LANES)));
+    VSTORE(pState + 5 * SHA256_LANES, VADD(f, VLOAD(pState + 5 * SHA256_LANES)));
+    VSTORE(pState + 6 * SHA256_LANES, VADD(g, VLOAD(pState + 6 * SHA256_LANES)));
+    VSTORE(pState + 7 * SHA256_LANES, VADD(h, VLOAD(pState + 7 * SHA256_LANES)));
+}
+
+static NvBool Sha256HaveLanes(void)
+{
+#if SHA256_HAVE_X86
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return NV_FALSE;
+    return (edx & bit_SSE2) ? NV_TRUE : NV_FALSE;
+#else
+    return NV_TRUE;
+#endif
+}
 
-    if(BufIndex != BufSize)
+/*  sets up Lane to hash message Index, or marks it idle */
+static void
+Sha256LaneStart(Sha256Lane *pLane, NvU32 *pState, NvU32 LaneIndex,
+                const NvU8 * const *ppMsg, const NvU32 *pMsgLen,
+                NvU32 Index, NvU32 NumMsgs)
+{
+    NvU32 Len, i;
+
+    pLane->Busy = (Index < NumMsgs) ? NV_TRUE : NV_FALSE;
+    if (!pLane->Busy)
+        return;
+
+    Len = pMsgLen[Index];
+    pLane->Index = Index;
+    pLane->pMsg = ppMsg[Index];
+    pLane->Blocks = Len / SHA256_BLOCK_SIZE;
+    pLane->TailIndex = 0;
+    pLane->TailBlocks = Sha256PadTail(pLane->Tail,
+        ppMsg[Index] + pLane->Blocks * SHA256_BLOCK_SIZE,
+        Len % SHA256_BLOCK_SIZE, Len);
+
+    for (i = 0; i < 8; i++)
+        pState[i * SHA256_LANES + LaneIndex] = s_InitialState[i];
+}
+
+/*  returns the next block of the lane, and NV_TRUE if it is the last one */
+static NvBool Sha256LaneNextBlock(Sha256Lane *pLane, const NvU8 **ppBlock)
+{
+    if (!pLane->Busy)
+    {
+        *ppBlock = pLane->Tail;
+        return NV_FALSE;
+    }
+
+    if (pLane->Blocks)
+    {
+        *ppBlock = pLane->pMsg;
+        pLane->pMsg += SHA256_BLOCK_SIZE;
+        pLane->Blocks--;
+        return NV_FALSE;
+    }
+
+    *ppBlock = pLane->Tail + pLane->TailIndex * SHA256_BLOCK_SIZE;
+    pLane->TailIndex++;
+    return (pLane->TailIndex == pLane->TailBlocks) ? NV_TRUE : NV_FALSE;
+}
+
+static void
+Sha256MultiLanes(const NvU8 * const *ppMsg, const NvU32 *pMsgLen,
+                 NvU32 NumMsgs, NvSHA256_Hash *pSHAHash)
+{
+    Sha256Lane Lanes[SHA256_LANES];
+    NvU32 State[8 * SHA256_LANES];
+    NvU32 Single[8];
+    const NvU8 *pBlocks[SHA256_LANES];
+    NvBool Last[SHA256_LANES];
+    NvU32 Next = 0;
+    NvU32 Busy, l, i;
+    Sha256Lane *pLane;
+
+    memset(State, 0, sizeof(State));
+    for (l = 0; l < SHA256_LANES; l++)
+        Sha256LaneStart(&Lanes[l], State, l, ppMsg, pMsgLen, Next++, NumMsgs);
+
+    for (;;)
+    {
+        Busy = 0;
+        for (l = 0; l < SHA256_LANES; l++)
+            Busy += Lanes[l].Busy ? 1 : 0;
+        if (Busy <= 1 && Next >= NumMsgs)
+            break;
+
+        for (l = 0; l < SHA256_LANES; l++)
+            Last[l] = Sha256LaneNextBlock(&Lanes[l], &pBlocks[l]);
+
+        Sha256LanesBlock(State, pBlocks);
+
+        for (l = 0; l < SHA256_LANES; l++)
+        {
+            if (!Last[l])
+                continue;
+            for (i = 0; i < 8; i++)
+                Single[i] = State[i * SHA256_LANES + l];
+            Sha256StoreHash(Single, &pSHAHash[Lanes[l].Index]);
+            Sha256LaneStart(&Lanes[l], State, l, ppMsg, pMsgLen, Next++,
+                            NumMsgs);
+        }
+    }
+
+    /*  a single message left is quicker to finish on its own */
+    for (l = 0; l < SHA256_LANES; l++)
+    {
+        pLane = &Lanes[l];
+        if (!pLane->Busy)
+            continue;
+        for (i = 0; i < 8; i++)
+            Single[i] = State[i * SHA256_LANES + l];
+        if (pLane->Blocks)
+            Sha256Blocks(Single, pLane->pMsg, pLane->Blocks);
+        Sha256Blocks(Single, pLane->Tail + pLane->TailIndex * SHA256_BLOCK_SIZE,
+                     pLane->TailBlocks - pLane->TailIndex);
+        Sha256StoreHash(Single, &pSHAHash[pLane->Index]);
+    }
+}
+#endif
+
+NvS32 NvSHA256_MultiHash(const NvU8 * const *ppMsg, const NvU32 *pMsgLen,
+                         NvU32 NumMsgs, NvSHA256_Hash *pSHAHash)
+{
+    NvU8 Tail[2 * SHA256_BLOCK_SIZE];
+    NvU32 State[8];
+    NvU32 Blocks, i;
+
+    if ((ppMsg == NULL) || (pMsgLen == NULL) || (pSHAHash == NULL))
         return -1;
+    for (i = 0; i < NumMsgs; i++)
+    {
+        if (ppMsg[i] == NULL && pMsgLen[i])
+            return -1;
+    }
 
-    SHA256_Process(pSHAData);
-    for (i = 0 ; i < SHA_256_HASH_SIZE ; i++)
+    /*
+     *  The SIMD lanes only pay off against the generic code; the SHA
+     *  instructions are faster one message at a time.
+     */
+#if SHA256_HAVE_LANES
+    if (NumMsgs > 1 && NvSHA256_GetBackend() == NvSHA256Backend_Generic &&
+        Sha256HaveLanes())
     {
-        NvU32 temp = pSHAData->h_state[i/4];
-        pSHAHash->Hash[i] = temp >> (3-(i%4))*8;
+        Sha256MultiLanes(ppMsg, pMsgLen, NumMsgs, pSHAHash);
+        return 0;
     }
+#endif
+
+    for (i = 0; i < NumMsgs; i++)
+    {
+        memcpy(State, s_InitialState, sizeof(s_InitialState));
+        Blocks = pMsgLen[i] / SHA256_BLOCK_SIZE;
+        if (Blocks)
+            Sha256Blocks(State, ppMsg[i], Blocks);
+        Blocks = Sha256PadTail(Tail, ppMsg[i] + Blocks * SHA256_BLOCK_SIZE,
+                               pMsgLen[i] % SHA256_BLOCK_SIZE, pMsgLen[i]);
+        Sha256Blocks(State, Tail, Blocks);
+        Sha256StoreHash(State, &pSHAHash[i]);
+    }
+
     return 0;
 }
-
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2013, NVIDIA Corporation.  All rights reserved.
+ * Copyright (c) 2012-2014, NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -28,6 +28,45 @@ typedef struct _SHA_256_Hash
     NvU8 Hash[SHA_256_HASH_SIZE];   /*  stores the Hash value of the input Msg */
 } NvSHA256_Hash;
 
+/**
+*   SHA-256 block compression implementations. All of them produce the same
+*   hashes.
+*/
+typedef enum
+{
+    /// Picks the fastest implementation supported by the CPU.
+    NvSHA256Backend_Auto = 0,
+
+    /// Portable C.
+    NvSHA256Backend_Generic,
+
+    /// x86 SHA extensions, when the CPU has them.
+    NvSHA256Backend_ShaNi,
+
+    /// ARMv8 SHA-256 instructions, when the compiler targets them.
+    NvSHA256Backend_Armv8,
+
+    /// Number of implementations -- Should appear after the last one.
+    NvSHA256Backend_Num,
+
+    /// Ignore -- Forces compilers to make 32-bit enums.
+    NvSHA256Backend_Force32 = 0x7FFFFFFF
+} NvSHA256Backend;
+
+/**
+*   Selects the implementation used by the SHA-256 functions. Without a call
+*   to this, the fastest one is used.
+*
+*   @param Backend the implementation to use
+*   @retval NV_TRUE if selected, NV_FALSE if not supported by this build or CPU
+*/
+NvBool NvSHA256_SelectBackend(NvSHA256Backend Backend);
+
+/**
+*   Returns the implementation used by the SHA-256 functions.
+*/
+NvSHA256Backend NvSHA256_GetBackend(void);
+
 /**
 *   Initializes the SHA-256 engine internal state machine
 *
@@ -37,7 +76,9 @@ typedef struct _SHA_256_Hash
 NvS32 NvSHA256_Init(NvSHA256_Data *pSHAData);
 
 /**
-*   Updates the SHA-256 engine internal state machine based on the Msg
+*   Updates the SHA-256 engine internal state machine based on the Msg.
+*   Whole blocks are hashed straight from pMsg; only a partial block at
+*   either end goes through the internal buffer.
 *
 *   @param pSHAData pointer to the SHA_Data object
 *   @param data pointer to the pMsg
@@ -56,4 +97,18 @@ NvS32 NvSHA256_Update(NvSHA256_Data *pSHAData, NvU8 *pMsg, NvU32 MsgLen);
 */
 NvS32 NvSHA256_Finalize(NvSHA256_Data *pSHAData, NvSHA256_Hash *pSHAHash);
 
+/**
+*   Computes the SHA-256 hashes of several independent messages, such as
+*   one per partition. Without SHA instructions, up to four messages are
+*   hashed at once in the lanes of the SIMD unit.
+*
+*   @param ppMsg array of NumMsgs pointers to the messages
+*   @param pMsgLen array of NumMsgs message lengths
+*   @param NumMsgs number of messages
+*   @param pSHAHash array of NumMsgs SHA_Hash objects receiving the hashes
+*   @retval 0 on success and -1 on failure
+*/
+NvS32 NvSHA256_MultiHash(const NvU8 * const *ppMsg, const NvU32 *pMsgLen,
+                         NvU32 NumMsgs, NvSHA256_Hash *pSHAHash);
+
 #endif /*   __NV_SHA256_H__ */
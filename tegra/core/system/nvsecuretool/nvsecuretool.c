@@ -49,6 +49,8 @@ static const char *s_PrivKeyFile         = DSESSION_PRIVATE_KEY;
 static const char *s_PubHashFile         = "pub.sha";
 static const char *s_Oemfile             = NULL;
 static const char *s_tidfile             = NULL;
+static const char *s_BatchFile           = NULL;
+static NvU32 s_BatchThreads              = 0;
 static NvBctHandle s_BctHandle    = NULL;
 static NvOsFileHandle s_BlobFile  = NULL;
 NvU32 g_OptionChipId              = 0;
@@ -158,6 +160,11 @@ NvSecureTool_Usage(void)
         "nvsecuretool --pkc keyfile <options>\n"
         "\tUsed to create signed BCT with bootloader, microboot signature\n"
         "\tminiloader(along with RCM messages) and bct\n"
+
+        "OR\n"
+
+        "nvsecuretool --batch manifest --chip <N> [--threads <N>]\n"
+        "\tUsed to sign or encrypt many bootloader images, each with its own key\n"
         "\n\nUse --help or -h for command details\n\n"
     );
 }
@@ -221,6 +228,20 @@ NvSecureTool_Help(void)
         "\tOptional, used to sign nvtest file\n"
         "  --applet <file>\n"
         "\tOptional, used to pass the applet to be downloaded by bootrom\n"
+        "\n\n"
+        "For batch mode:\n"
+        "  --batch <manifest>\n"
+        "\tMandatory, file listing one image per line as\n"
+        "\t  pkc <keyfile> <infile> [outfile]\n"
+        "\tor\n"
+        "\t  sbk <0xXXXXXXXX 0xXXXXXXXX 0xXXXXXXXX 0xXXXXXXXX> <infile> [outfile]\n"
+        "\tAll lines must use the same mode. Each image is signed or encrypted\n"
+        "\tand saved as --bl would, and its hash or signature is saved in\n"
+        "\t<outfile>.sig. Blank lines and lines starting with # are skipped\n"
+        "  --chip <N>\n"
+        "\tMandatory, where N {0x35, 0x40}\n"
+        "  --threads <N>\n"
+        "\tOptional, number of signing threads, default 4\n"
         "\n"
     );
 }
@@ -429,6 +450,20 @@ NvSecureParseCommandLine(int argc, const char *argv[])
             i++;
             s_AppletFile = argv[i];
         }
+        else if (NvOsStrcmp(arg, "--batch") == 0)
+        {
+            VERIFY((i + 1) < argc,
+                err_str = "--batch argument missing"; goto fail);
+            i++;
+            s_BatchFile = argv[i];
+        }
+        else if (NvOsStrcmp(arg, "--threads") == 0)
+        {
+            VERIFY((i + 1) < argc,
+                err_str = "--threads argument missing"; goto fail);
+            i++;
+            s_BatchThreads = NvUStrtoul(argv[i], 0, 0);
+        }
         else
         {
             NvAuPrintf("\nunknown command %s\n", arg);
@@ -441,6 +476,14 @@ NvSecureParseCommandLine(int argc, const char *argv[])
     if (s_RsaKeyFileIn != NULL)
         goto clean;
 
+    /* In batch mode the keys come from the manifest */
+    if (s_BatchFile != NULL)
+    {
+        VERIFY(g_OptionChipId != 0,
+               err_str = "--Chip id option needed"; goto fail);
+        goto clean;
+    }
+
     /* Throw error if compulsory options are not used */
     VERIFY(g_SecureMode != 0,
            err_str = "--sbk  or --pkc option needed"; goto fail);
@@ -1474,6 +1517,13 @@ main(int argc, const char *argv[])
             goto fail;
     }
 
+    if (s_BatchFile != NULL)
+    {
+        e = NvSecureBatch(s_BatchFile, s_BatchThreads);
+        VERIFY(e == NvSuccess, err_str = "Batch signing failed"; goto fail);
+        goto clean;
+    }
+
     if (s_tidfile)
     {
         RetVal = NvSecureEncryptTid();
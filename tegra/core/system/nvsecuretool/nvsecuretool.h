@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2013, NVIDIA Corporation.  All rights reserved.
+ * Copyright (c) 2012-2014, NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software and related documentation
@@ -17,6 +17,7 @@
 #include "nvapputil.h"
 #include "nvboothost.h"
 #include "nvflash_version.h"
+#include "nv_rsa.h"
 
 #define LP0_EXIT_RUN_ADDRESS    0x40020000
 
@@ -62,6 +63,14 @@ typedef struct NvSecureBctInterfaceRec
     NvError (*NvSecureSignWB0Image)(NvU8* WB0Buf, NvU32 WB0Length);
 }NvSecureBctInterface;
 
+/* RSA key pair read from a PKC key file */
+typedef struct NvSecurePkcKeyRec
+{
+    NvBigIntModulus Modulus;
+    NvU32 PrivKey[BIGINT_MAX_DW];
+    NvRSACrtKey Crt;
+}NvSecurePkcKey;
+
 
 // outputs information about how to use nvsecuretool
 void NvSecureTool_Usage(void);
@@ -228,6 +237,31 @@ NvSecureHostRcmCreateMsgFromBuffer(
 NvError
 NvSecureGenerateKeyPair(const char *KeyFile);
 
+/*
+ * Reads a PKC key file in polarssl or PEM format into Key
+ *
+ * @param KeyFile name of the key file
+ * @param Key key pair to fill in
+ *
+ * Returns NvSuccess if the key file is valid
+ */
+NvError
+NvSecureLoadPkcKey(const char *KeyFile, NvSecurePkcKey *Key);
+
+/*
+ * Lets each thread sign with its own key. NvSecurePkcThreadKeyInit() must be
+ * called before any thread calls NvSecurePkcSetThreadKey(); a thread that
+ * has not set a key, or has set NULL, uses the key of --pkc.
+ */
+NvError
+NvSecurePkcThreadKeyInit(void);
+void
+NvSecurePkcSetThreadKey(const NvSecurePkcKey *Key);
+
+/* Returns the modulus of the key the calling thread signs with */
+const NvBigIntModulus *
+NvSecurePkcGetModulus(void);
+
 /*
  *Performs encryption of fuse data with decrypted symmetric key
  */
@@ -313,5 +347,16 @@ const char* NvSecureGetBlobVersion(void);
 /* Sign nvtest */
 NvError NvSecureSignNvTest(void);
 
+/*
+ * Signs or encrypts every image listed in a manifest, as --bl would,
+ * over a pool of threads
+ *
+ * @param ManifestFile name of the manifest file
+ * @param NumThreads number of signing threads, 0 for the default
+ *
+ * Returns NvSuccess if every image was processed
+ */
+NvError NvSecureBatch(const char *ManifestFile, NvU32 NumThreads);
+
 #endif//INCLUDED_NVSECURETOOL_H
 
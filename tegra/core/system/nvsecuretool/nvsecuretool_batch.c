@@ -0,0 +1,494 @@
+/*
+ * Copyright (c) 2014, NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software and related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+/*
+ * Batch mode: signs or encrypts every image listed in a manifest, each with
+ * its own key, the same way the command line bootloader is handled.
+ *
+ * Each image goes through three stages. The main thread reads the images in
+ * manifest order, a pool of threads signs or encrypts them, and the main
+ * thread writes them out in manifest order again, so the output does not
+ * depend on the number of threads. Reading stops while two images per
+ * thread, or NVSECURE_BATCH_MAX_BYTES of them, wait to be written.
+ */
+
+#include <string.h>
+#include "nvsecuretool.h"
+#include "nv_sha256.h"
+
+#define NVSECURE_BATCH_DEFAULT_THREADS  4
+#define NVSECURE_BATCH_MAX_THREADS      64
+#define NVSECURE_BATCH_MAX_BYTES        (64 * 1024 * 1024)
+#define NVSECURE_BATCH_MAX_TOKENS       7
+#define NVSECURE_BATCH_SIG_EXTENSION    ".sig"
+
+extern NvU32 g_OptionChipId;
+extern NvSecureMode g_SecureMode;
+extern NvBool g_Encrypt;
+
+typedef struct NvSecureBatchKeyRec
+{
+    const char *KeyFile;
+    NvSecurePkcKey Key;
+} NvSecureBatchKey;
+
+typedef struct NvSecureBatchJobRec
+{
+    NvU32 Line;
+    const char *InFile;
+    const char *OutFile;
+    char *OutFileName;              /* default OutFile, allocated */
+    const NvSecurePkcKey *PkcKey;   /* PKC mode */
+    NvU32 Sbk[4];                   /* SBK mode, same order as --sbk */
+    NvU8 *Buf;
+    NvU32 BufSize;
+    NvU32 Size;                     /* of the image in Buf, padded */
+    NvU8 *Sig;
+    NvU32 SigSize;
+    NvError Error;
+    NvBool Done;                    /* signed, under Lock */
+    NvU64 ReadUs;
+    NvU64 SignUs;
+    NvU64 WriteUs;
+} NvSecureBatchJob;
+
+typedef struct NvSecureBatchStateRec
+{
+    NvSecureBatchJob *Jobs;
+    NvU32 NumJobs;
+    NvSecureBatchKey *Keys;
+    NvU32 NumKeys;
+    NvU32 NextSign;                 /* next job to sign, under Lock */
+    NvOsMutexHandle Lock;
+    NvOsSemaphoreHandle Ready;      /* signalled for each job read */
+    NvOsSemaphoreHandle Signed;     /* signalled for each job signed */
+} NvSecureBatchState;
+
+/* Splits Line at blanks in place; returns MaxTokens + 1 if there are more */
+static NvU32
+NvSecureBatchSplit(char *Line, char **Tokens, NvU32 MaxTokens)
+{
+    NvU32 Count = 0;
+
+    for (;;)
+    {
+        while (*Line == ' ' || *Line == '\t' || *Line == '\r')
+            Line++;
+        if (*Line == '\0')
+            break;
+        if (Count == MaxTokens)
+            return MaxTokens + 1;
+
+        Tokens[Count++] = Line;
+        while (*Line && *Line != ' ' && *Line != '\t' && *Line != '\r')
+            Line++;
+        if (*Line)
+            *Line++ = '\0';
+    }
+
+    return Count;
+}
+
+/* Loads each key file once, however many images use it */
+static const NvSecurePkcKey *
+NvSecureBatchGetKey(NvSecureBatchState *Batch, const char *KeyFile)
+{
+    NvSecureBatchKey *Key;
+    NvU32 i;
+
+    for (i = 0; i < Batch->NumKeys; i++)
+    {
+        if (NvOsStrcmp(Batch->Keys[i].KeyFile, KeyFile) == 0)
+            return &Batch->Keys[i].Key;
+    }
+
+    Key = &Batch->Keys[Batch->NumKeys];
+    if (NvSecureLoadPkcKey(KeyFile, &Key->Key) != NvSuccess)
+        return NULL;
+    Key->KeyFile = KeyFile;
+    Batch->NumKeys++;
+
+    return &Key->Key;
+}
+
+static NvError
+NvSecureBatchParse(NvSecureBatchState *Batch, const char *ManifestFile,
+                   char *Manifest)
+{
+    NvError e           = NvSuccess;
+    const char *err_str = NULL;
+    char *Tokens[NVSECURE_BATCH_MAX_TOKENS];
+    char *Line          = Manifest;
+    char *Next          = NULL;
+    NvU32 LineNum       = 0;
+    NvU32 NumTokens;
+    NvU32 KeyTokens;
+    NvU32 j;
+    NvU32 tmp;
+    NvSecureMode Mode;
+    NvBool Encrypt;
+    NvSecureBatchJob *Job;
+
+    for (; Line != NULL; Line = Next)
+    {
+        Next = strchr(Line, '\n');
+        if (Next != NULL)
+            *Next++ = '\0';
+        LineNum++;
+
+        NumTokens = NvSecureBatchSplit(Line, Tokens, NVSECURE_BATCH_MAX_TOKENS);
+        if (NumTokens == 0 || Tokens[0][0] == '#')
+            continue;
+
+        Job = &Batch->Jobs[Batch->NumJobs];
+        NvOsMemset(Job, 0x0, sizeof(NvSecureBatchJob));
+        Job->Line = LineNum;
+
+        if (NvOsStrcmp(Tokens[0], "pkc") == 0)
+        {
+            Mode = NvSecure_Pkc;
+            KeyTokens = 1;
+        }
+        else if (NvOsStrcmp(Tokens[0], "sbk") == 0)
+        {
+            Mode = NvSecure_Sbk;
+            KeyTokens = 4;
+        }
+        else
+        {
+            e = NvError_BadParameter;
+            err_str = "expected pkc or sbk";
+            goto fail;
+        }
+
+        VERIFY(NumTokens == KeyTokens + 2 || NumTokens == KeyTokens + 3,
+               e = NvError_BadParameter;
+               err_str = "expected key, input file and optional output file";
+               goto fail);
+
+        Encrypt = NV_TRUE;
+        if (Mode == NvSecure_Sbk)
+        {
+            Encrypt = NV_FALSE;
+            for (j = 0; j < 4; j++)
+            {
+                VERIFY(NvSecureCheckValidKeyInput(Tokens[j + 1]),
+                       e = NvError_BadParameter;
+                       err_str = "sbk key should be in hex format 0xXXXXXXXX";
+                       goto fail);
+
+                tmp = NvUStrtoul(Tokens[j + 1], 0, 0);
+                /* need to reverse the byte order */
+                Job->Sbk[j] = (tmp & 0xff) << 24 |
+                              ((tmp >> 8) & 0xff) << 16 |
+                              ((tmp >> 16) & 0xff) << 8 |
+                              ((tmp >> 24) & 0xff);
+                if (Job->Sbk[j] != 0)
+                    Encrypt = NV_TRUE;
+            }
+        }
+        else
+        {
+            Job->PkcKey = NvSecureBatchGetKey(Batch, Tokens[1]);
+            VERIFY(Job->PkcKey != NULL, e = NvError_BadParameter;
+                   err_str = "loading key file failed"; goto fail);
+        }
+
+        /* mode and output names are global, so one mode per manifest */
+        if (Batch->NumJobs == 0)
+        {
+            g_SecureMode = Mode;
+            g_Encrypt = Encrypt;
+        }
+        VERIFY(Mode == g_SecureMode && Encrypt == g_Encrypt,
+               e = NvError_BadParameter;
+               err_str = "all images must use the same mode"; goto fail);
+
+        Job->InFile = Tokens[KeyTokens + 1];
+        if (NumTokens == KeyTokens + 3)
+            Job->OutFile = Tokens[KeyTokens + 2];
+        Batch->NumJobs++;
+    }
+
+    VERIFY(Batch->NumJobs != 0, e = NvError_BadParameter;
+           err_str = "no images in manifest"; goto fail);
+
+    if (g_SecureMode == NvSecure_Sbk && !g_Encrypt)
+        NvAuPrintf("Using Zero SBK key\n");
+
+    for (j = 0; j < Batch->NumJobs; j++)
+    {
+        Job = &Batch->Jobs[j];
+        if (Job->OutFile != NULL)
+            continue;
+
+        Job->OutFileName = NvSecureGetOutFileName(Job->InFile, NULL);
+        VERIFY(Job->OutFileName != NULL, e = NvError_InsufficientMemory;
+               goto fail);
+        Job->OutFile = Job->OutFileName;
+    }
+
+fail:
+    if (err_str)
+        NvAuPrintf("%s:%d: %s\n", ManifestFile, LineNum, err_str);
+    return e;
+}
+
+static void
+NvSecureBatchThread(void *Arg)
+{
+    NvSecureBatchState *Batch = (NvSecureBatchState *)Arg;
+    NvSecureBatchJob *Job;
+    NvU32 Index;
+    NvU64 Start;
+
+    for (;;)
+    {
+        NvOsSemaphoreWait(Batch->Ready);
+        NvOsMutexLock(Batch->Lock);
+        Index = Batch->NextSign++;
+        NvOsMutexUnlock(Batch->Lock);
+        if (Index >= Batch->NumJobs)
+            break;
+
+        Job = &Batch->Jobs[Index];
+        if (Job->Error == NvSuccess)
+        {
+            Start = NvOsGetTimeUS();
+            NvSecurePkcSetThreadKey(Job->PkcKey);
+            Job->Error = NvSecureSignEncryptBuffer(g_SecureMode,
+                            (NvU8 *)Job->Sbk, Job->Buf, Job->Size,
+                            &Job->Sig, &Job->SigSize, NV_TRUE, NV_TRUE);
+            Job->SignUs = NvOsGetTimeUS() - Start;
+        }
+
+        NvOsMutexLock(Batch->Lock);
+        Job->Done = NV_TRUE;
+        NvOsMutexUnlock(Batch->Lock);
+        NvOsSemaphoreSignal(Batch->Signed);
+    }
+}
+
+static void
+NvSecureBatchRead(NvSecureBatchJob *Job)
+{
+    NvU64 Start = NvOsGetTimeUS();
+
+    /* page size only matters for the 0x20 and 0x30 padding workaround */
+    Job->Error = NvSecureReadFile(Job->InFile, &Job->Buf, NV_TRUE,
+                                  &Job->BufSize, 0, 0);
+    if (Job->Error == NvSuccess)
+        Job->Size = Job->BufSize - NV3P_AES_HASH_BLOCK_LEN - sizeof(NvU32);
+    Job->ReadUs = NvOsGetTimeUS() - Start;
+}
+
+static void
+NvSecureBatchWrite(NvSecureBatchJob *Job)
+{
+    char *SigFile = NULL;
+    NvU32 Len;
+    NvU64 Start = NvOsGetTimeUS();
+
+    Job->Error = NvSecureSaveFile(Job->OutFile, Job->Buf, Job->Size);
+    if (Job->Error != NvSuccess)
+        goto fail;
+
+    Len = NvOsStrlen(Job->OutFile);
+    SigFile = NvOsAlloc(Len + sizeof(NVSECURE_BATCH_SIG_EXTENSION));
+    VERIFY(SigFile != NULL, Job->Error = NvError_InsufficientMemory;
+           goto fail);
+    NvOsMemcpy(SigFile, Job->OutFile, Len);
+    NvOsMemcpy(SigFile + Len, NVSECURE_BATCH_SIG_EXTENSION,
+               sizeof(NVSECURE_BATCH_SIG_EXTENSION));
+
+    Job->Error = NvSecureSaveFile(SigFile, Job->Sig, Job->SigSize);
+
+fail:
+    if (SigFile)
+        NvOsFree(SigFile);
+    Job->WriteUs = NvOsGetTimeUS() - Start;
+}
+
+NvError
+NvSecureBatch(const char *ManifestFile, NvU32 NumThreads)
+{
+    NvError e           = NvSuccess;
+    const char *err_str = NULL;
+    char *Manifest      = NULL;
+    NvU32 ManifestSize  = 0;
+    NvU32 MaxJobs       = 1;
+    NvU32 Threads       = 0;
+    NvU32 NextRead      = 0;
+    NvU32 NextWrite     = 0;
+    NvU32 Failed        = 0;
+    NvU32 InFlightBytes = 0;
+    NvU64 ReadUs        = 0;
+    NvU64 SignUs        = 0;
+    NvU64 WriteUs       = 0;
+    NvU64 Start         = NvOsGetTimeUS();
+    NvBool Done;
+    NvU32 i;
+    NvSecureBatchJob *Job;
+    NvSecureBatchState Batch;
+    NvOsThreadHandle Handles[NVSECURE_BATCH_MAX_THREADS];
+
+    NvOsMemset(&Batch, 0x0, sizeof(Batch));
+
+    VERIFY(g_OptionChipId != 0x30, e = NvError_NotSupported;
+           err_str = "Batch mode is not supported for 0x30 chips"; goto fail);
+
+    if (NumThreads == 0)
+        NumThreads = NVSECURE_BATCH_DEFAULT_THREADS;
+    if (NumThreads > NVSECURE_BATCH_MAX_THREADS)
+        NumThreads = NVSECURE_BATCH_MAX_THREADS;
+
+    /* one extra byte keeps the manifest nul terminated */
+    e = NvSecureReadFile(ManifestFile, (NvU8 **)&Manifest, NV_FALSE,
+                         &ManifestSize, 0, 1);
+    VERIFY(e == NvSuccess, err_str = "Reading manifest failed"; goto fail);
+
+    for (i = 0; i < ManifestSize; i++)
+    {
+        if (Manifest[i] == '\n')
+            MaxJobs++;
+    }
+
+    Batch.Jobs = NvOsAlloc(MaxJobs * sizeof(NvSecureBatchJob));
+    Batch.Keys = NvOsAlloc(MaxJobs * sizeof(NvSecureBatchKey));
+    VERIFY(Batch.Jobs != NULL && Batch.Keys != NULL,
+           e = NvError_InsufficientMemory;
+           err_str = "Allocating batch jobs failed"; goto fail);
+
+    e = NvSecureBatchParse(&Batch, ManifestFile, Manifest);
+    VERIFY(e == NvSuccess, err_str = "Parsing manifest failed"; goto fail);
+
+    if (NumThreads > Batch.NumJobs)
+        NumThreads = Batch.NumJobs;
+
+    e = NvSecurePkcThreadKeyInit();
+    VERIFY(e == NvSuccess, err_str = "Allocating thread key failed"; goto fail);
+    e = NvOsMutexCreate(&Batch.Lock);
+    VERIFY(e == NvSuccess, err_str = "Creating mutex failed"; goto fail);
+    e = NvOsSemaphoreCreate(&Batch.Ready, 0);
+    VERIFY(e == NvSuccess, err_str = "Creating semaphore failed"; goto fail);
+    e = NvOsSemaphoreCreate(&Batch.Signed, 0);
+    VERIFY(e == NvSuccess, err_str = "Creating semaphore failed"; goto fail);
+
+    /* pick the SHA-256 backend now rather than in every thread at once */
+    NvSHA256_GetBackend();
+
+    for (Threads = 0; Threads < NumThreads; Threads++)
+    {
+        if (NvOsThreadCreate(NvSecureBatchThread, &Batch,
+                             &Handles[Threads]) != NvSuccess)
+            break;
+    }
+    VERIFY(Threads != 0, e = NvError_InsufficientMemory;
+           err_str = "Creating signing threads failed"; goto fail);
+
+    NvAuPrintf("Signing %d images with %d threads\n", Batch.NumJobs, Threads);
+
+    while (NextWrite < Batch.NumJobs)
+    {
+        /* read ahead while there is room; the oldest image always fits */
+        while (NextRead < Batch.NumJobs &&
+               (NextRead == NextWrite ||
+                (NextRead - NextWrite < 2 * Threads &&
+                 InFlightBytes < NVSECURE_BATCH_MAX_BYTES)))
+        {
+            Job = &Batch.Jobs[NextRead++];
+            NvSecureBatchRead(Job);
+            InFlightBytes += Job->BufSize;
+            NvOsSemaphoreSignal(Batch.Ready);
+        }
+
+        /* images are signed out of order, so wait for the oldest */
+        Job = &Batch.Jobs[NextWrite++];
+        for (;;)
+        {
+            NvOsMutexLock(Batch.Lock);
+            Done = Job->Done;
+            NvOsMutexUnlock(Batch.Lock);
+            if (Done)
+                break;
+            NvOsSemaphoreWait(Batch.Signed);
+        }
+
+        if (Job->Error == NvSuccess)
+            NvSecureBatchWrite(Job);
+
+        if (Job->Error == NvSuccess)
+        {
+            NvAuPrintf("%s is saved as %s: read %llu us, sign %llu us, "
+                       "write %llu us\n", Job->InFile, Job->OutFile,
+                       (unsigned long long)Job->ReadUs,
+                       (unsigned long long)Job->SignUs,
+                       (unsigned long long)Job->WriteUs);
+        }
+        else
+        {
+            NvAuPrintf("%s:%d: %s failed NvError 0x%x\n", ManifestFile,
+                       Job->Line, Job->InFile, Job->Error);
+            Failed++;
+        }
+
+        ReadUs += Job->ReadUs;
+        SignUs += Job->SignUs;
+        WriteUs += Job->WriteUs;
+
+        InFlightBytes -= Job->BufSize;
+        if (Job->Buf)
+            NvOsFree(Job->Buf);
+        if (Job->Sig)
+            NvOsFree(Job->Sig);
+        Job->Buf = NULL;
+        Job->Sig = NULL;
+    }
+
+    NvAuPrintf("Batch of %d images, %d failed, in %llu us\n",
+               Batch.NumJobs, Failed,
+               (unsigned long long)(NvOsGetTimeUS() - Start));
+    NvAuPrintf("read %llu us, sign %llu us over %d threads, write %llu us\n",
+               (unsigned long long)ReadUs, (unsigned long long)SignUs,
+               Threads, (unsigned long long)WriteUs);
+
+    if (Failed)
+        e = NvError_BadParameter;
+
+fail:
+    /* every job has been taken, so this wakes the threads to exit */
+    for (i = 0; i < Threads; i++)
+        NvOsSemaphoreSignal(Batch.Ready);
+    for (i = 0; i < Threads; i++)
+        NvOsThreadJoin(Handles[i]);
+
+    if (err_str)
+        NvAuPrintf("\n%s NvError 0x%x \n", err_str, e);
+    if (Batch.Signed)
+        NvOsSemaphoreDestroy(Batch.Signed);
+    if (Batch.Ready)
+        NvOsSemaphoreDestroy(Batch.Ready);
+    if (Batch.Lock)
+        NvOsMutexDestroy(Batch.Lock);
+    if (Batch.Jobs)
+    {
+        for (i = 0; i < Batch.NumJobs; i++)
+        {
+            if (Batch.Jobs[i].OutFileName)
+                NvOsFree(Batch.Jobs[i].OutFileName);
+        }
+        NvOsFree(Batch.Jobs);
+    }
+    if (Batch.Keys)
+        NvOsFree(Batch.Keys);
+    if (Manifest)
+        NvOsFree(Manifest);
+    return e;
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2013, NVIDIA Corporation.  All rights reserved.
+ * Copyright (c) 2012-2014, NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -19,14 +19,13 @@
 #include "nvboothost_t12x.h"
 #include "nvboothost_t1xx.h"
 
-static unsigned char PubKey[RSA_KEY_SIZE + 1];
-static unsigned char PrivKey[RSA_KEY_SIZE + 1];
-static unsigned char P[RSA_KEY_SIZE];
-static unsigned char Q[RSA_KEY_SIZE];
-
 extern NvU32 g_OptionChipId;
 
-NvBigIntModulus *KeyModulus;
+/* Key pair given with --pkc or --keygen */
+static NvSecurePkcKey s_PkcKey;
+
+/* Key of the calling thread, overriding s_PkcKey in batch mode */
+static NvU32 s_PkcKeyTls = NVOS_INVALID_TLS_INDEX;
 
 #ifdef DEBUG
 #undef DEBUG
@@ -102,9 +101,12 @@ NvError NvRSAMaskGenerationFunction(
     NvU8 *dbMaskBuffer, NvU32 hLen)
 {
     NvU32 counter = 0;
+    NvU32 numCounters = NV_ICEIL(maskLen, hLen);
     NvError e = NvSuccess;
-    NvU32 T[((ARSE_SHA512_HASH_SIZE/8) * MAX_MGF_COUNTER_LOOPS) / 4];
-    NvU32 hashInputBuffer[(ARSE_SHA512_HASH_SIZE / 8 / 4) +  1];
+    NvSHA256_Hash T[MAX_MGF_COUNTER_LOOPS];
+    NvU32 hashInputBuffer[MAX_MGF_COUNTER_LOOPS][(ARSE_SHA512_HASH_SIZE / 8 / 4) +  1];
+    const NvU8 *hashInputs[MAX_MGF_COUNTER_LOOPS];
+    NvU32 hashInputLengths[MAX_MGF_COUNTER_LOOPS];
 
     /* +1 for the octet string C of 4 octets
      * Step 1. If maskLen > 2^32 hLen, output "mask too long" and stop.
@@ -119,18 +121,28 @@ NvError NvRSAMaskGenerationFunction(
      *         string T:
      *         T = T || Hash(mgfSeed||C).
      */
-    for (counter = 0; counter <= (NV_ICEIL(maskLen, hLen) - 1); counter++)
+    if (numCounters > MAX_MGF_COUNTER_LOOPS)
+        return NvError_BadParameter;
+
+    for (counter = 0; counter < numCounters; counter++)
     {
         /* counter is already a NvU32, so no need to convert to
          * length of four octets
          */
-        NvOsMemcpy(&hashInputBuffer[0], mgfSeed, hLen);
-        hashInputBuffer[(hLen / 4) + 1 - 1] = NvRSAUtilSwapBytesInNvU32(counter);
-        e = NvSecureGenerateSHA256Hash((NvU8*)&hashInputBuffer[0],
-                                       (NvU8 *)&T[0], hLen + 4);
-        NvOsMemcpy(&dbMaskBuffer[counter*hLen], &T[0], hLen);
+        NvOsMemcpy(&hashInputBuffer[counter][0], mgfSeed, hLen);
+        hashInputBuffer[counter][(hLen / 4) + 1 - 1] =
+            NvRSAUtilSwapBytesInNvU32(counter);
+        hashInputs[counter] = (const NvU8 *)&hashInputBuffer[counter][0];
+        hashInputLengths[counter] = hLen + 4;
     }
 
+    /* the hashes don't depend on each other, so compute them together */
+    if (NvSHA256_MultiHash(hashInputs, hashInputLengths, numCounters, T) == -1)
+        return NvError_BadParameter;
+
+    for (counter = 0; counter < numCounters; counter++)
+        NvOsMemcpy(&dbMaskBuffer[counter*hLen], T[counter].Hash, hLen);
+
     /* Step 4. Output the leading maskLen octets
      * of T as the octet string mask.
      */
@@ -151,15 +163,16 @@ NvRSAPSSEncode(NvU8 *Msg, NvU32 EmLength,NvU8 *EncodedMsg)
     NvU8 dbMaskBuffer[RSA_KEY_SIZE];
     NvU8 maskedDB[RSA_KEY_SIZE];
 
-    static NvU8 M_Prime[8 + (ARSE_SHA512_HASH_SIZE/8) +
-                        (ARSE_SHA512_HASH_SIZE/8)];
-    static NvU32 H_Prime[(ARSE_SHA512_HASH_SIZE/32)];
+    NvU8 M_Prime[8 + (ARSE_SHA512_HASH_SIZE/8) +
+                 (ARSE_SHA512_HASH_SIZE/8)];
+    NvU32 H_Prime[(ARSE_SHA512_HASH_SIZE/32)];
 
     /* random slat required? */
     NvOsMemset(Salt, 0xff, HASH_SIZE);
     NvOsMemset(DB, 0, RSA_KEY_SIZE);
     NvOsMemset(dbMaskBuffer, 0, RSA_KEY_SIZE);
     NvOsMemset(maskedDB, 0, RSA_KEY_SIZE);
+    NvOsMemset(M_Prime, 0, sizeof(M_Prime));
 
     NvOsMemcpy(mHash, Msg, HASH_SIZE);
     NvOsMemcpy(&M_Prime[8], &mHash[0], hLen);
@@ -231,8 +244,8 @@ clean:
 }
 
 static NvS32 NvRSASignSHA256Dgst(
-        NvU8 *Dgst, NvBigIntModulus *PrivKey_n,
-        NvU32 *PrivKey_d, NvU32 *Sign)
+        NvU8 *Dgst, const NvBigIntModulus *PrivKey_n,
+        const NvU32 *PrivKey_d, const NvRSACrtKey *PrivKey_crt, NvU32 *Sign)
 {
     NvS32 retval      = -1;
     NvU32 *EncodedMsg = NULL;
@@ -263,8 +276,12 @@ static NvS32 NvRSASignSHA256Dgst(
             ((NvU8*)EncodedMsg)[RSANUMBYTES - 1 - i] = temp;
         }
     }
-    /** Generating the signature */
-    NvRSAEncDecMessage(Sign, EncodedMsg, PrivKey_d, PrivKey_n);
+    /** Generating the signature, from p and q when they are known */
+    if (PrivKey_crt)
+        NvRSACrtEncDecMessage(Sign, EncodedMsg, PrivKey_crt);
+    else
+        NvRSAEncDecMessage(Sign, EncodedMsg, (NvU32 *)PrivKey_d,
+                           (NvBigIntModulus *)PrivKey_n);
 
     retval = 1;
 
@@ -280,7 +297,7 @@ fail:
  */
 
 NvError
-NvSecureGenerateKeyPair(const char *KeyFile)
+NvSecureLoadPkcKey(const char *KeyFile, NvSecurePkcKey *Key)
 {
     NvError e            = NvSuccess;
     char *err_str        = NULL;
@@ -290,8 +307,16 @@ NvSecureGenerateKeyPair(const char *KeyFile)
     char *KeyBuf         = NULL;
     NvU32 FileSize       = 0;
     size_t BytesRead     = 0;
+    NvU32 P[RSA_KEY_SIZE / 4];
+    NvU32 Q[RSA_KEY_SIZE / 4];
+    NvU32 PubExp[BIGINT_MAX_DW];
     NvOsStatType FileStat;
 
+    NvOsMemset(Key, 0, sizeof(NvSecurePkcKey));
+    NvOsMemset(P, 0, sizeof(P));
+    NvOsMemset(Q, 0, sizeof(Q));
+    NvOsMemset(PubExp, 0, sizeof(PubExp));
+
     e = NvOsFopen(KeyFile, NVOS_OPEN_READ, &hFile);
     VERIFY(e == NvSuccess, err_str = "file open failed"; goto fail);
 
@@ -312,13 +337,6 @@ NvSecureGenerateKeyPair(const char *KeyFile)
     NvOsFclose(hFile);
     hFile = NULL;
 
-    KeyModulus = (NvBigIntModulus*)NvOsAlloc(sizeof(NvBigIntModulus));
-    if (KeyModulus == NULL)
-    {
-        printf("malloc failed @%d\n",__LINE__);
-        goto fail;
-    }
-
     //check the format of key
     if (NvOsMemcmp(KeyBuf, PEMFORMAT_START, sizeof(PEMFORMAT_START) - 1) == 0)
     {
@@ -346,7 +364,7 @@ NvSecureGenerateKeyPair(const char *KeyFile)
                 goto fail;
             }
 
-            if ((NvGetPQFromPrivateKey(Base64Buf, Base64Size, P,RSA_KEY_SIZE/2, Q,RSA_KEY_SIZE/2))== -1)
+            if ((NvGetPQFromPrivateKey(Base64Buf, Base64Size, (NvU8 *)P,RSA_KEY_SIZE/2, (NvU8 *)Q,RSA_KEY_SIZE/2))== -1)
             {
                 NvAuPrintf("PQ extraction failed\n");
                 NvOsFree(Base64Buf);
@@ -374,19 +392,19 @@ NvSecureGenerateKeyPair(const char *KeyFile)
             goto fail;
         }
 
-        ExtractPrime(tokenq, Q);
-        ExtractPrime(tokenp, P);
+        ExtractPrime(tokenq, (NvU8 *)Q);
+        ExtractPrime(tokenp, (NvU8 *)P);
     }
 
 #if DEBUG
 {
     NvU32 i = 0;
     for (i = 0; i < RSANUMBYTES/2; i++)
-        NvAuPrintf("%0x  ", P[i]);
+        NvAuPrintf("%0x  ", ((NvU8 *)P)[i]);
     NvAuPrintf("\n\n");
 
     for (i = 0; i < RSANUMBYTES/2; i++)
-        NvAuPrintf("%0x  ", Q[i]);
+        NvAuPrintf("%0x  ", ((NvU8 *)Q)[i]);
     NvAuPrintf("\n\n");
 }
 #endif
@@ -396,22 +414,23 @@ NvSecureGenerateKeyPair(const char *KeyFile)
      */
 
     /*  Generating modulus(n) */
-    NvRSAInitModulusFromPQ(KeyModulus, (NvU32 *)P,
-                           (NvU32 *) Q, RSA_LENGTH, NV_TRUE);
+    NvRSAInitModulusFromPQ(&Key->Modulus, P, Q, RSA_LENGTH, NV_TRUE);
 #if DEBUG
 {
     NvU32 i = 0;
     NvAuPrintf("KeyModulus is");
     i = 0;
     for (i = 0;i < RSANUMBYTES / 4; i++)
-        NvAuPrintf("%0x  ", KeyModulus->n[i]);
+        NvAuPrintf("%0x  ", Key->Modulus.n[i]);
     NvAuPrintf("\n\n");
 }
 #endif
 
-    ((NvU32*)PubKey)[0] = RSA_PUBLIC_EXPONENT_VAL;
-    NvRSAPrivateKeyGeneration((NvU32 *)PrivKey, (NvU32*)PubKey,
+    PubExp[0] = RSA_PUBLIC_EXPONENT_VAL;
+    NvRSAPrivateKeyGeneration(Key->PrivKey, PubExp,
                               (NvU8*)P, (NvU8*)Q, (RSANUMBYTES / 4));
+    NvRSAInitCrtKey(&Key->Crt, P, Q, Key->PrivKey,
+                    RSA_PUBLIC_EXPONENT_VAL, (RSANUMBYTES / 4));
 
 goto clean;
 
@@ -426,6 +445,46 @@ clean:
     return e;
 }
 
+NvError
+NvSecureGenerateKeyPair(const char *KeyFile)
+{
+    return NvSecureLoadPkcKey(KeyFile, &s_PkcKey);
+}
+
+NvError
+NvSecurePkcThreadKeyInit(void)
+{
+    if (s_PkcKeyTls == NVOS_INVALID_TLS_INDEX)
+    {
+        s_PkcKeyTls = NvOsTlsAlloc();
+        if (s_PkcKeyTls == NVOS_INVALID_TLS_INDEX)
+            return NvError_InsufficientMemory;
+    }
+    return NvSuccess;
+}
+
+void
+NvSecurePkcSetThreadKey(const NvSecurePkcKey *Key)
+{
+    NvOsTlsSet(s_PkcKeyTls, (void *)Key);
+}
+
+static const NvSecurePkcKey *
+NvSecurePkcGetKey(void)
+{
+    const NvSecurePkcKey *Key = NULL;
+
+    if (s_PkcKeyTls != NVOS_INVALID_TLS_INDEX)
+        Key = NvOsTlsGet(s_PkcKeyTls);
+    return Key ? Key : &s_PkcKey;
+}
+
+const NvBigIntModulus *
+NvSecurePkcGetModulus(void)
+{
+    return &NvSecurePkcGetKey()->Modulus;
+}
+
 NvError NvSecureGetKeys(const char *spub, const char *spriv)
 {
     NvError e             = NvSuccess;
@@ -439,10 +498,10 @@ NvError NvSecureGetKeys(const char *spub, const char *spriv)
     e = NvOsFopen(spriv, NVOS_OPEN_WRITE | NVOS_OPEN_CREATE, &hFile2);
     VERIFY(e == NvSuccess, err_str = "file open failed"; goto fail);
 
-    e = NvOsFwrite(hFile1, (NvU8 *)KeyModulus, sizeof(NvBigIntModulus));
+    e = NvOsFwrite(hFile1, (NvU8 *)&s_PkcKey.Modulus, sizeof(NvBigIntModulus));
     VERIFY(e == NvSuccess, err_str = "file write failed"; goto fail);
 
-    e = NvOsFwrite(hFile2, PrivKey, RSA_KEY_SIZE);
+    e = NvOsFwrite(hFile2, (NvU8 *)s_PkcKey.PrivKey, RSA_KEY_SIZE);
     VERIFY(e == NvSuccess, err_str = "file write failed"; goto fail);
 
 fail:
@@ -516,6 +575,7 @@ NvSecurePkcSign(NvU8 *Src, NvU8 *Dst, NvU32 Length)
 {
     NvError e = NvSuccess;
     NvU8 Hash[HASH_SIZE +1];
+    const NvSecurePkcKey *Key = NvSecurePkcGetKey();
     NvS32 Ret;
 
     NvOsMemset(Hash,0,HASH_SIZE + 1);
@@ -532,7 +592,8 @@ NvSecurePkcSign(NvU8 *Src, NvU8 *Dst, NvU32 Length)
     if (e != NvSuccess)
         goto fail;
 
-    Ret = NvRSASignSHA256Dgst(Hash, KeyModulus, (NvU32 *)PrivKey,(NvU32 *)Dst);
+    Ret = NvRSASignSHA256Dgst(Hash, &Key->Modulus, Key->PrivKey,
+                              &Key->Crt, (NvU32 *)Dst);
     if (Ret == -1)
     {
         NvAuPrintf("RSA_Sign failed...!\n");
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2013, NVIDIA Corporation.  All rights reserved.
+ * Copyright (c) 2012-2014, NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software and related documentation
@@ -18,7 +18,6 @@
 #define NV_MICROBOOT_ENTRY_POINT 0x4000E000 // entry point for microboot in IRAM
 #define NV_MICROBOOT_SIZE_MAX 0x00024000 // minimum IRAM size
 
-extern NvBigIntModulus *KeyModulus;
 extern const NvSecureMode g_SecureMode;
 
 /**
@@ -284,7 +283,7 @@ NvUpdateWarmBootHeader(
     if (g_SecureMode == NvSecure_Pkc)
     {
         /* Copy the RSA public key into warm boot header */
-        NvOsMemcpy(WarmBootHeadbuf->PublicKey.Modulus, (char*)KeyModulus->n, 256);
+        NvOsMemcpy(WarmBootHeadbuf->PublicKey.Modulus, (char*)NvSecurePkcGetModulus()->n, 256);
     }
 
     return e;
@@ -293,7 +292,7 @@ NvUpdateWarmBootHeader(
 void
 NvSecurePkcGetPubKeyT12x(NvU8 *Dst)
 {
-   NvOsMemcpy(Dst, KeyModulus->n, sizeof(NvBootRsaKeyModulus));
+   NvOsMemcpy(Dst, NvSecurePkcGetModulus()->n, sizeof(NvBootRsaKeyModulus));
 }
 
 NvError
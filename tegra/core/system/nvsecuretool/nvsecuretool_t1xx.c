@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2013, NVIDIA Corporation.  All rights reserved.
+ * Copyright (c) 2012-2014, NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software and related documentation
@@ -18,8 +18,6 @@
 #define NV_MICROBOOT_ENTRY_POINT 0x4000E000 // entry point for microboot in IRAM
 #define NV_MICROBOOT_SIZE_MAX 0x00024000 // minimum IRAM size
 
-extern NvBigIntModulus *KeyModulus;
-
 /**
 * Find the warmboot code offset from the input Buffer
 * @param Buffer pointer to the bootloader Buffer
@@ -234,7 +232,7 @@ NvUpdateWarmBootHeader(
     WarmBootHeadbuf->RecoveryCodeLength = temp;
 
     /* Copy the RSA public key into warm boot header */
-    NvOsMemcpy(WarmBootHeadbuf->PublicKey.Modulus, (char*)KeyModulus->n, 256);
+    NvOsMemcpy(WarmBootHeadbuf->PublicKey.Modulus, (char*)NvSecurePkcGetModulus()->n, 256);
 
     return e;
 }
@@ -242,7 +240,7 @@ NvUpdateWarmBootHeader(
 void
 NvSecurePkcGetPubKeyT1xx(NvU8 *Dst)
 {
-   NvOsMemcpy(Dst, KeyModulus->n, sizeof(NvBootRsaKeyModulus));
+   NvOsMemcpy(Dst, NvSecurePkcGetModulus()->n, sizeof(NvBootRsaKeyModulus));
 }
 
 NvError
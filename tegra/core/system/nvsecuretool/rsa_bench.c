@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+/*
+ * RSA signing check and throughput benchmark.
+ *
+ * First checks NvBigIntPowerMod(), NvBigIntReduceMod() and
+ * NvBigIntMultiplyMod() against plain square and multiply over random
+ * operands of 1 to 9 digits, so that both the 32 bit and the 64 bit limb
+ * Montgomery products and every window size are covered.
+ *
+ * Then sets up a fixed 2048 bit key the way nvsecuretool does and checks
+ * the signature of a fixed message with and without CRT against the known
+ * answer, and that a faulty CRT key still gives the right signature.
+ *
+ * Then prints signatures per second with and without CRT.
+ *
+ * usage: rsa_bench [signatures]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvos.h"
+#include "nv_rsa.h"
+#include "nv_cryptolib.h"
+
+#define BENCH_DEFAULT_SIGNS     200
+#define BENCH_CHECK_DIGITS      9
+#define BENCH_CHECK_ROUNDS      50
+
+static const char s_KeyP[] =
+    "ca6373718c7aa5e2d663e7bcc3a6553b4e4d260bbf23842be5535fb111680517"
+    "19594e718042a89bcfc1a8644daf5e1b04b30ad721e4823993dedcdf88284679"
+    "68881b8cda0467291a211a95edf52cc02fcd6609f8ab36fd25830f3e40537cc3"
+    "6a14ac7ecec0248b6b9a2bd182e75d82e8d513a4f1a5325b7dc73f7865d14a63";
+
+static const char s_KeyQ[] =
+    "f536f18db1b696318a2c8dc3fcb566f90a0ede45f0abb40021aa34d38449b9b7"
+    "2a825dbb5533c776a4b73e19f8f58eac814ea8ada0ebe1e870b3ba369acd603a"
+    "e2f7020f57d9fcde16e239199bae527ed14353d06b194fa9aff53505fed9a36d"
+    "fcbfd15e402ac8d067c0fa9e1039ea3fcbf0438977fda8610a48e3495d50fb01";
+
+static const char s_ExpectedSign[] =
+    "9a48b21cdff9df62b1c1369fb0a5f3bf91b5e490a19717bd2651e459ef19a139"
+    "8933ae5005499c0e3413e8e3d46b99bbe81f65ce95b631abcda731b718d476a0"
+    "ece56c5df397929a8ba8bb723b45318deb567480683f74c171751b9f7a1cbe5a"
+    "54ec295b93f71a01bc33f2a3e399b889d0cd9841d11e3e5ec7a2e218dfe70b93"
+    "9aff52a51ca877397d001e2159471ec534901207b7c77beb0464a5139b23e1e3"
+    "524ce6426c41af71340078ac9860def748df8db911c7ffe60d2fe5188003b2a7"
+    "5b4bed2d645a2df2ce4d21ad7d2d91c2d675b91b3899b83d84dd944df7c53154"
+    "beb9ba33fe5ceeb287d3e507898b7f9e084c8b112c616706eb227fc16a8a1076";
+
+static NvU32 s_Seed = 12345;
+
+static NvU32 BenchRandom(void)
+{
+    s_Seed = s_Seed * 1664525 + 1013904223;
+    return (s_Seed >> 8) ^ (s_Seed << 24);
+}
+
+static void BenchRandomBigInt(NvU32 *x, NvU32 digits)
+{
+    NvU32 i;
+
+    memset(x, 0, BIGINT_MAX_DW * sizeof(NvU32));
+    for (i = 0; i < digits; i++)
+        x[i] = BenchRandom();
+}
+
+/* Big endian hex to little endian digits */
+static void BenchHexToBigInt(NvU32 *x, const char *hex, NvU32 digits)
+{
+    NvU8 *b = (NvU8 *)x;
+    NvU32 i, bytes = digits * sizeof(NvU32);
+    char pair[3] = { 0, 0, 0 };
+
+    for (i = 0; i < bytes; i++)
+    {
+        pair[0] = hex[2 * i];
+        pair[1] = hex[2 * i + 1];
+        b[bytes - 1 - i] = (NvU8)strtoul(pair, NULL, 16);
+    }
+}
+
+/* z = x^e mod n one bit at a time, without Montgomery products */
+static void RefPowerMod(NvU32 *z, const NvU32 *x, const NvU32 *e,
+    NvU32 e_digits, const NvU32 *n, NvU32 digits)
+{
+    NvU32 acc[BIGINT_MAX_DW], t[BIGINT_MAX_DW * 2];
+    int i;
+
+    memset(acc, 0, sizeof(acc));
+    acc[0] = 1;
+    for (i = e_digits * 32 - 1; i >= 0; i--)
+    {
+        NvBigIntMultiply(t, acc, acc, digits);
+        NvBigIntMod(acc, t, digits * 2, n, digits);
+        if ((e[i >> 5] >> (i & 31)) & 1)
+        {
+            NvBigIntMultiply(t, acc, x, digits);
+            NvBigIntMod(acc, t, digits * 2, n, digits);
+        }
+    }
+    memcpy(z, acc, digits * sizeof(NvU32));
+}
+
+static NvBool CheckArithmetic(void)
+{
+    NvBigIntModulus n;
+    NvU32 x[BIGINT_MAX_DW], y[BIGINT_MAX_DW], e[BIGINT_MAX_DW];
+    NvU32 z[BIGINT_MAX_DW], ref[BIGINT_MAX_DW];
+    NvU32 t[BIGINT_MAX_DW * 2];
+    NvU32 digits, round, e_digits;
+
+    for (digits = 1; digits <= BENCH_CHECK_DIGITS; digits++)
+    {
+        for (round = 0; round < BENCH_CHECK_ROUNDS; round++)
+        {
+            /* odd modulus with the top bit set, as for RSA primes */
+            BenchRandomBigInt(x, digits);
+            x[0] |= 1;
+            x[digits - 1] |= 0x80000000;
+            NvInitBigIntModulus(&n, (NvU8 *)x, digits * sizeof(NvU32),
+                NV_FALSE);
+
+            BenchRandomBigInt(t, digits);
+            memset(t + digits, 0, digits * sizeof(NvU32));
+            NvBigIntMod(x, t, digits, n.n, digits);
+            BenchRandomBigInt(t, digits);
+            NvBigIntMod(y, t, digits, n.n, digits);
+
+            e_digits = 1 + BenchRandom() % digits;
+            BenchRandomBigInt(e, e_digits);
+            if (round < 4)
+                e[e_digits - 1] >>= 8 * round;
+
+            NvBigIntPowerMod(z, x, e, &n, e_digits);
+            RefPowerMod(ref, x, e, e_digits, n.n, digits);
+            if (memcmp(z, ref, digits * sizeof(NvU32)))
+            {
+                printf("PowerMod %u digits, exponent %u digits: mismatch\n",
+                    digits, e_digits);
+                return NV_FALSE;
+            }
+
+            NvBigIntMultiply(t, x, y, digits);
+            NvBigIntMultiplyMod(z, x, y, &n);
+            NvBigIntMod(ref, t, digits * 2, n.n, digits);
+            if (memcmp(z, ref, digits * sizeof(NvU32)))
+            {
+                printf("MultiplyMod %u digits: mismatch\n", digits);
+                return NV_FALSE;
+            }
+
+            BenchRandomBigInt(t, digits);
+            BenchRandomBigInt(t + digits, digits);
+            NvBigIntReduceMod(z, t, &n);
+            NvBigIntMod(ref, t, digits * 2, n.n, digits);
+            if (memcmp(z, ref, digits * sizeof(NvU32)))
+            {
+                printf("ReduceMod %u digits: mismatch\n", digits);
+                return NV_FALSE;
+            }
+        }
+    }
+
+    return NV_TRUE;
+}
+
+int main(int argc, char **argv)
+{
+    static NvBigIntModulus s_N;
+    static NvRSACrtKey s_Crt, s_Faulty;
+    NvU32 p[BIGINT_MAX_DW], q[BIGINT_MAX_DW], d[BIGINT_MAX_DW];
+    NvU32 pub[BIGINT_MAX_DW];
+    NvU32 msg[BIGINT_MAX_DW], sign[BIGINT_MAX_DW], ref[BIGINT_MAX_DW];
+    NvU32 check[BIGINT_MAX_DW];
+    NvU8 raw[RSANUMBYTES];
+    const NvU32 digits = RSANUMBYTES / 4;
+    NvU32 signs = BENCH_DEFAULT_SIGNS;
+    NvU32 i;
+    NvU64 start, us, crt_us;
+    NvBool ok = NV_TRUE;
+
+    if (argc > 1)
+    {
+        signs = strtoul(argv[1], NULL, 0);
+        if (!signs)
+        {
+            printf("usage: %s [signatures]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!CheckArithmetic())
+    {
+        printf("arithmetic check FAILED\n");
+        ok = NV_FALSE;
+    }
+
+    /* same steps as NvSecureGenerateKeyPair() */
+    memset(p, 0, sizeof(p));
+    memset(q, 0, sizeof(q));
+    BenchHexToBigInt(p, s_KeyP, digits / 2);
+    BenchHexToBigInt(q, s_KeyQ, digits / 2);
+    NvRSAInitModulusFromPQ(&s_N, p, q, RSA_LENGTH, NV_FALSE);
+    memset(pub, 0, sizeof(pub));
+    pub[0] = RSA_PUBLIC_EXPONENT_VAL;
+    NvRSAPrivateKeyGeneration(d, pub, (NvU8 *)p, (NvU8 *)q, digits);
+    NvRSAInitCrtKey(&s_Crt, p, q, d, RSA_PUBLIC_EXPONENT_VAL, digits);
+
+    /* message: bytes 0 to 255, reduced mod n */
+    for (i = 0; i < RSANUMBYTES; i++)
+        raw[i] = (NvU8)i;
+    NvSwapEndianness(raw, raw, RSANUMBYTES);
+    NvBigIntMod(msg, (NvU32 *)raw, digits, s_N.n, digits);
+    BenchHexToBigInt(ref, s_ExpectedSign, digits);
+
+    NvRSAEncDecMessage(sign, msg, d, &s_N);
+    if (memcmp(sign, ref, RSANUMBYTES))
+    {
+        printf("signature without CRT: mismatch\n");
+        ok = NV_FALSE;
+    }
+
+    NvRSACrtEncDecMessage(sign, msg, &s_Crt);
+    if (memcmp(sign, ref, RSANUMBYTES))
+    {
+        printf("signature with CRT: mismatch\n");
+        ok = NV_FALSE;
+    }
+
+    NvRSAEncDecMessage(check, sign, pub, &s_N);
+    if (memcmp(check, msg, RSANUMBYTES))
+    {
+        printf("signature does not verify\n");
+        ok = NV_FALSE;
+    }
+
+    /* a wrong dp must be caught and redone without CRT */
+    s_Faulty = s_Crt;
+    s_Faulty.dp[3] ^= 0x10;
+    NvRSACrtEncDecMessage(sign, msg, &s_Faulty);
+    if (memcmp(sign, ref, RSANUMBYTES))
+    {
+        printf("signature with faulty CRT key: mismatch\n");
+        ok = NV_FALSE;
+    }
+
+    start = NvOsGetTimeUS();
+    for (i = 0; i < signs; i++)
+        NvRSAEncDecMessage(sign, msg, d, &s_N);
+    us = NvOsGetTimeUS() - start;
+
+    start = NvOsGetTimeUS();
+    for (i = 0; i < signs; i++)
+        NvRSACrtEncDecMessage(sign, msg, &s_Crt);
+    crt_us = NvOsGetTimeUS() - start;
+
+    printf("%u signatures without CRT in %llu us, %8.1f/s\n", signs, us,
+        us ? signs * 1000000.0 / us : 0.0);
+    printf("%u signatures with CRT    in %llu us, %8.1f/s\n", signs, crt_us,
+        crt_us ? signs * 1000000.0 / crt_us : 0.0);
+
+    printf(ok ? "PASSED\n" : "FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,393 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+/*
+ * SHA-256 check and throughput benchmark.
+ *
+ * First checks the FIPS 180-2 examples, then every SHA-256 implementation
+ * supported here against a plain reference over random messages of all
+ * small sizes, fed at random alignments and in random pieces, and checks
+ * NvSHA256_MultiHash() over random batches of messages.
+ *
+ * The reference is the previous nvsecuretool code: each byte copied through
+ * the 64 byte buffer, and a rolled 64 word message schedule. Its throughput
+ * is printed first, then that of each implementation, and of hashing the
+ * buffer as 4 and 16 separate messages with NvSHA256_MultiHash().
+ *
+ * usage: sha256_bench [megabytes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvos.h"
+#include "nv_sha256.h"
+
+#define BENCH_DEFAULT_MB        64
+#define BENCH_CHECK_SIZE        300
+#define BENCH_CHECK_ROUNDS      3
+#define BENCH_MULTI_MAX         37
+
+static const char *s_BackendNames[NvSHA256Backend_Num] = {
+    "auto", "generic", "shani", "armv8"
+};
+
+static NvU32 s_Seed = 12345;
+
+static NvU32 BenchRandom(void)
+{
+    s_Seed = s_Seed * 1664525 + 1013904223;
+    return s_Seed >> 8;
+}
+
+#define ROTR(x,n) (((x) >> (n)) | ((x) << (32-(n))))
+
+static const NvU32 s_RefK[64] = {
+0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+typedef struct RefSha256Rec
+{
+    NvU64 Count;
+    NvU8 Buf[64];
+    NvU32 H[8];
+} RefSha256;
+
+static void RefProcess(RefSha256 *ctx)
+{
+    NvU32 w[64], s[8];
+    NvU32 i, t1, t2;
+
+    for (i = 0; i < 16; i++)
+        w[i] = ((NvU32)ctx->Buf[4 * i] << 24) | (ctx->Buf[4 * i + 1] << 16) |
+               (ctx->Buf[4 * i + 2] << 8) | ctx->Buf[4 * i + 3];
+    for (i = 16; i < 64; i++)
+        w[i] = w[i - 16] + w[i - 7] +
+               (ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3)) +
+               (ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10));
+
+    memcpy(s, ctx->H, sizeof(s));
+    for (i = 0; i < 64; i++)
+    {
+        t1 = s[7] + (ROTR(s[4], 6) ^ ROTR(s[4], 11) ^ ROTR(s[4], 25)) +
+             ((s[4] & s[5]) ^ (~s[4] & s[6])) + s_RefK[i] + w[i];
+        t2 = (ROTR(s[0], 2) ^ ROTR(s[0], 13) ^ ROTR(s[0], 22)) +
+             ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+        memmove(s + 1, s, 7 * sizeof(NvU32));
+        s[4] += t1;
+        s[0] = t1 + t2;
+    }
+    for (i = 0; i < 8; i++)
+        ctx->H[i] += s[i];
+}
+
+static void RefByte(RefSha256 *ctx, NvU8 b)
+{
+    ctx->Buf[ctx->Count++ % 64] = b;
+    if (!(ctx->Count % 64))
+        RefProcess(ctx);
+}
+
+static void RefSha256Hash(const NvU8 *buf, NvU32 size, NvU8 *hash)
+{
+    static const NvU32 init[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    RefSha256 ctx;
+    NvU64 bits = (NvU64)size * 8;
+    NvU32 i;
+
+    memcpy(ctx.H, init, sizeof(init));
+    ctx.Count = 0;
+    while (size--)
+        RefByte(&ctx, *buf++);
+    RefByte(&ctx, 0x80);
+    while (ctx.Count % 64 != 56)
+        RefByte(&ctx, 0);
+    for (i = 0; i < 8; i++)
+        RefByte(&ctx, (NvU8)(bits >> (56 - 8 * i)));
+    for (i = 0; i < 32; i++)
+        hash[i] = (NvU8)(ctx.H[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+static void Sha256Hash(const NvU8 *buf, NvU32 size, NvU8 *hash)
+{
+    NvSHA256_Data data;
+    NvSHA256_Hash out;
+
+    NvSHA256_Init(&data);
+    NvSHA256_Update(&data, (NvU8 *)buf, size);
+    NvSHA256_Finalize(&data, &out);
+    memcpy(hash, out.Hash, SHA_256_HASH_SIZE);
+}
+
+static NvBool CheckKnownAnswers(void)
+{
+    static const struct
+    {
+        const char *Msg;
+        NvU32 Repeat;
+        NvU8 Hash[SHA_256_HASH_SIZE];
+    } Tests[] = {
+        { "abc", 1,
+          { 0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+            0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+            0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+            0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad } },
+        { "", 1,
+          { 0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14,
+            0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+            0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c,
+            0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55 } },
+        { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+          { 0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+            0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+            0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+            0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1 } },
+        { "a", 1000000,
+          { 0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92,
+            0x81, 0xa1, 0xc7, 0xe2, 0x84, 0xd7, 0x3e, 0x67,
+            0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97, 0x20, 0x0e,
+            0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0 } },
+    };
+    NvSHA256_Data data;
+    NvSHA256_Hash hash;
+    NvU8 ref[SHA_256_HASH_SIZE];
+    NvU32 i, j, len;
+
+    for (i = 0; i < sizeof(Tests) / sizeof(Tests[0]); i++)
+    {
+        len = (NvU32)strlen(Tests[i].Msg);
+        NvSHA256_Init(&data);
+        for (j = 0; j < Tests[i].Repeat; j++)
+            NvSHA256_Update(&data, (NvU8 *)Tests[i].Msg, len);
+        NvSHA256_Finalize(&data, &hash);
+        if (memcmp(hash.Hash, Tests[i].Hash, SHA_256_HASH_SIZE))
+        {
+            printf("known answer %u FAILED\n", i);
+            return NV_FALSE;
+        }
+
+        if (Tests[i].Repeat == 1)
+        {
+            RefSha256Hash((const NvU8 *)Tests[i].Msg, len, ref);
+            if (memcmp(ref, Tests[i].Hash, SHA_256_HASH_SIZE))
+            {
+                printf("reference known answer %u FAILED\n", i);
+                return NV_FALSE;
+            }
+        }
+    }
+
+    return NV_TRUE;
+}
+
+static NvBool CheckBackend(NvU8 *buf)
+{
+    NvSHA256_Data data;
+    NvSHA256_Hash hash;
+    NvU8 ref[SHA_256_HASH_SIZE];
+    NvU32 size, align, round, done, piece;
+
+    for (round = 0; round < BENCH_CHECK_ROUNDS; round++)
+    {
+        for (size = 0; size <= BENCH_CHECK_SIZE; size++)
+        {
+            align = round ? BenchRandom() % 16 : 0;
+            RefSha256Hash(buf + align, size, ref);
+
+            /* in one piece, then in random ones */
+            Sha256Hash(buf + align, size, hash.Hash);
+            if (memcmp(hash.Hash, ref, SHA_256_HASH_SIZE))
+            {
+                printf("size %u align %u: mismatch\n", size, align);
+                return NV_FALSE;
+            }
+
+            NvSHA256_Init(&data);
+            for (done = 0; done < size; done += piece)
+            {
+                piece = BenchRandom() % 150;
+                if (piece > size - done)
+                    piece = size - done;
+                NvSHA256_Update(&data, buf + align + done, piece);
+            }
+            NvSHA256_Finalize(&data, &hash);
+            if (memcmp(hash.Hash, ref, SHA_256_HASH_SIZE))
+            {
+                printf("size %u align %u in pieces: mismatch\n", size, align);
+                return NV_FALSE;
+            }
+        }
+    }
+
+    return NV_TRUE;
+}
+
+static NvBool CheckMultiHash(NvU8 *buf)
+{
+    const NvU8 *msgs[BENCH_MULTI_MAX];
+    NvU32 lens[BENCH_MULTI_MAX];
+    NvSHA256_Hash hashes[BENCH_MULTI_MAX];
+    NvU8 ref[SHA_256_HASH_SIZE];
+    NvU32 round, count, i;
+
+    for (round = 0; round < 200; round++)
+    {
+        count = BenchRandom() % (BENCH_MULTI_MAX + 1);
+        for (i = 0; i < count; i++)
+        {
+            /* mostly short, some a few blocks long */
+            lens[i] = BenchRandom() % ((i & 3) ? 130 : 1000);
+            msgs[i] = buf + BenchRandom() % 4096;
+        }
+
+        if (NvSHA256_MultiHash(msgs, lens, count, hashes))
+        {
+            printf("multihash of %u failed\n", count);
+            return NV_FALSE;
+        }
+        for (i = 0; i < count; i++)
+        {
+            RefSha256Hash(msgs[i], lens[i], ref);
+            if (memcmp(hashes[i].Hash, ref, SHA_256_HASH_SIZE))
+            {
+                printf("multihash %u of %u, size %u: mismatch\n", i, count,
+                    lens[i]);
+                return NV_FALSE;
+            }
+        }
+    }
+
+    return NV_TRUE;
+}
+
+static double BenchMBs(NvU64 bytes, NvU64 us)
+{
+    return us ? (double)bytes / us : 0.0;
+}
+
+/* Hashes the buffer as count messages and returns the elapsed time */
+static NvU64 BenchMulti(const NvU8 *buf, NvU32 size, NvU32 count,
+    NvSHA256_Hash *hashes)
+{
+    const NvU8 *msgs[16];
+    NvU32 lens[16];
+    NvU64 start;
+    NvU32 i;
+
+    for (i = 0; i < count; i++)
+    {
+        msgs[i] = buf + (NvU64)size * i / count;
+        lens[i] = (NvU32)((NvU64)size * (i + 1) / count -
+            (NvU64)size * i / count);
+    }
+
+    start = NvOsGetTimeUS();
+    NvSHA256_MultiHash(msgs, lens, count, hashes);
+    return NvOsGetTimeUS() - start;
+}
+
+int main(int argc, char **argv)
+{
+    NvU32 mb = BENCH_DEFAULT_MB;
+    NvU32 size, i, count;
+    NvSHA256Backend backend, best;
+    NvSHA256_Hash multi[16], single[16];
+    NvU8 ref[SHA_256_HASH_SIZE], hash[SHA_256_HASH_SIZE];
+    NvU64 start, us;
+    NvBool ok = NV_TRUE;
+    NvU8 *buf;
+
+    if (argc > 1)
+    {
+        mb = strtoul(argv[1], NULL, 0);
+        if (!mb || mb > 1024)
+        {
+            printf("usage: %s [megabytes]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    size = mb * 1024 * 1024;
+    buf = malloc(size);
+    if (!buf)
+    {
+        printf("cannot allocate %u MB\n", mb);
+        return 1;
+    }
+    for (i = 0; i < size; i++)
+        buf[i] = (NvU8)BenchRandom();
+
+    best = NvSHA256_GetBackend();
+    printf("default implementation: %s\n", s_BackendNames[best]);
+
+    if (!CheckKnownAnswers())
+        ok = NV_FALSE;
+
+    start = NvOsGetTimeUS();
+    RefSha256Hash(buf, size, ref);
+    us = NvOsGetTimeUS() - start;
+    printf("%-9s %u MB in %llu us, %8.1f MB/s\n", "previous", mb, us,
+        BenchMBs(size, us));
+
+    for (backend = NvSHA256Backend_Generic; backend < NvSHA256Backend_Num;
+         backend++)
+    {
+        if (!NvSHA256_SelectBackend(backend))
+        {
+            printf("%-9s not supported\n", s_BackendNames[backend]);
+            continue;
+        }
+
+        if (!CheckKnownAnswers() || !CheckBackend(buf) || !CheckMultiHash(buf))
+        {
+            printf("%-9s check FAILED\n", s_BackendNames[backend]);
+            ok = NV_FALSE;
+            continue;
+        }
+
+        start = NvOsGetTimeUS();
+        Sha256Hash(buf, size, hash);
+        us = NvOsGetTimeUS() - start;
+        if (memcmp(hash, ref, SHA_256_HASH_SIZE))
+            ok = NV_FALSE;
+
+        printf("%-9s %u MB in %llu us, %8.1f MB/s%s\n",
+            s_BackendNames[backend], mb, us, BenchMBs(size, us),
+            memcmp(hash, ref, SHA_256_HASH_SIZE) ? " MISMATCH" : "");
+
+        for (count = 4; count <= 16; count *= 4)
+        {
+            us = BenchMulti(buf, size, count, multi);
+            for (i = 0; i < count; i++)
+            {
+                Sha256Hash(buf + (NvU64)size * i / count,
+                    (NvU32)((NvU64)size * (i + 1) / count -
+                    (NvU64)size * i / count), single[i].Hash);
+                if (memcmp(single[i].Hash, multi[i].Hash, SHA_256_HASH_SIZE))
+                    ok = NV_FALSE;
+            }
+            printf("%-9s %u MB as %2u messages in %llu us, %8.1f MB/s\n",
+                "", mb, count, us, BenchMBs(size, us));
+        }
+    }
+
+    NvSHA256_SelectBackend(best);
+    free(buf);
+    printf(ok ? "PASSED\n" : "FAILED\n");
+    return ok ? 0 : 1;
+}
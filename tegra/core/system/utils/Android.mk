@@ -23,3 +23,29 @@ LOCAL_SRC_FILES += crc32.c
 LOCAL_SRC_FILES += datetime.c
 
 include $(NVIDIA_HOST_STATIC_LIBRARY)
+
+# CRC32 check and throughput benchmark
+
+include $(NVIDIA_DEFAULTS)
+
+LOCAL_MODULE := crc32_bench
+LOCAL_MODULE_TAGS := nvidia_tests
+
+LOCAL_SRC_FILES := crc32_bench.c
+
+LOCAL_STATIC_LIBRARIES += libnvsystem_utils
+LOCAL_SHARED_LIBRARIES += libnvos
+
+include $(NVIDIA_EXECUTABLE)
+
+include $(NVIDIA_DEFAULTS)
+
+LOCAL_MODULE := crc32_bench
+
+LOCAL_SRC_FILES := crc32_bench.c
+
+LOCAL_STATIC_LIBRARIES += libnvsystem_utilshost
+LOCAL_STATIC_LIBRARIES += libnvos
+LOCAL_LDLIBS += -lpthread -ldl
+
+include $(NVIDIA_HOST_EXECUTABLE)
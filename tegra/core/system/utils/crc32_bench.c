@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+/*
+ * CRC32 check and throughput benchmark.
+ *
+ * First checks every CRC32 implementation supported here against a plain
+ * bitwise CRC over random buffers of all small sizes and alignments, chained
+ * from random initial values, and checks NvComputeCrc32Zeros() and
+ * NvComputeCrc32Combine() against computing the whole buffer.
+ *
+ * Then prints the throughput of each implementation, and of checksumming the
+ * buffer in 1 to 4 parallel chunks merged with NvComputeCrc32Combine().
+ *
+ * usage: crc32_bench [megabytes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvos.h"
+#include "crc32.h"
+
+#define BENCH_DEFAULT_MB        64
+#define BENCH_MAX_THREADS       4
+#define BENCH_CHECK_SIZE        1100
+#define BENCH_CHECK_ALIGN       16
+#define BENCH_CHECK_ROUNDS      3
+
+static const char *s_BackendNames[NvCrc32Backend_Num] = {
+    "auto", "bytewise", "slice8", "armv8", "pclmul"
+};
+
+typedef struct BenchChunkRec
+{
+    const NvU8 *Buf;
+    NvU32 Size;
+    NvU32 Crc;
+} BenchChunk;
+
+static NvU32 s_Seed = 12345;
+
+static NvU32 BenchRandom(void)
+{
+    s_Seed = s_Seed * 1664525 + 1013904223;
+    return s_Seed >> 8;
+}
+
+/* The CRC one bit at a time, independent of the tables */
+static NvU32 RefCrc32(NvU32 crc, const NvU8 *buf, NvU32 size)
+{
+    NvU32 i;
+
+    crc = ~crc;
+    while (size--)
+    {
+        crc ^= *buf++;
+        for (i = 0; i < 8; i++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+    }
+    return ~crc;
+}
+
+static NvBool CheckBackend(NvU8 *buf)
+{
+    NvU32 size, align, round, split;
+    NvU32 init, crc, ref;
+
+    for (round = 0; round < BENCH_CHECK_ROUNDS; round++)
+    {
+        for (size = 0; size <= BENCH_CHECK_SIZE; size++)
+        {
+            for (align = 0; align < BENCH_CHECK_ALIGN; align++)
+            {
+                init = round ? BenchRandom() : 0;
+                ref = RefCrc32(init, buf + align, size);
+                crc = NvComputeCrc32(init, buf + align, size);
+                if (crc != ref)
+                {
+                    printf("size %u align %u: 0x%08x, expected 0x%08x\n",
+                        size, align, crc, ref);
+                    return NV_FALSE;
+                }
+
+                if (align)
+                    continue;
+
+                /* chain over two parts */
+                split = size ? BenchRandom() % size : 0;
+                crc = NvComputeCrc32(init, buf, split);
+                crc = NvComputeCrc32(crc, buf + split, size - split);
+                if (crc != ref)
+                {
+                    printf("size %u split %u: 0x%08x, expected 0x%08x\n",
+                        size, split, crc, ref);
+                    return NV_FALSE;
+                }
+            }
+        }
+    }
+
+    return NV_TRUE;
+}
+
+static NvBool CheckCombine(NvU8 *buf, NvU32 total)
+{
+    NvU8 *zeros;
+    NvU32 i, size, split, crc, ref;
+    NvBool ok = NV_TRUE;
+
+    for (i = 0; i < 1000 && ok; i++)
+    {
+        size = BenchRandom() % total;
+        split = size ? BenchRandom() % size : 0;
+        ref = NvComputeCrc32(0, buf, size);
+        crc = NvComputeCrc32Combine(NvComputeCrc32(0, buf, split),
+            NvComputeCrc32(0, buf + split, size - split), size - split);
+        if (crc != ref)
+        {
+            printf("combine size %u split %u: 0x%08x, expected 0x%08x\n",
+                size, split, crc, ref);
+            ok = NV_FALSE;
+        }
+    }
+
+    zeros = calloc(1, total);
+    if (!zeros)
+        return NV_FALSE;
+
+    for (i = 0; i < 100 && ok; i++)
+    {
+        size = BenchRandom() % total;
+        split = BenchRandom() % BENCH_CHECK_SIZE;
+        memcpy(zeros, buf, split);
+        ref = NvComputeCrc32(0, zeros, split + size);
+        crc = NvComputeCrc32Zeros(NvComputeCrc32(0, buf, split), size);
+        if (crc != ref)
+        {
+            printf("zeros %u after %u: 0x%08x, expected 0x%08x\n",
+                size, split, crc, ref);
+            ok = NV_FALSE;
+        }
+        memset(zeros, 0, split);
+    }
+
+    free(zeros);
+    return ok;
+}
+
+static void BenchChunkThread(void *arg)
+{
+    BenchChunk *chunk = arg;
+
+    chunk->Crc = NvComputeCrc32(0, chunk->Buf, chunk->Size);
+}
+
+/* Checksums the buffer in threads chunks and merges them */
+static NvU32 ParallelCrc32(const NvU8 *buf, NvU32 size, NvU32 threads)
+{
+    BenchChunk chunks[BENCH_MAX_THREADS];
+    NvOsThreadHandle handles[BENCH_MAX_THREADS];
+    NvU32 i, crc;
+
+    for (i = 0; i < threads; i++)
+    {
+        chunks[i].Buf = buf + (NvU64)size * i / threads;
+        chunks[i].Size = (NvU32)((NvU64)size * (i + 1) / threads -
+            (NvU64)size * i / threads);
+        handles[i] = NULL;
+        if (i && NvOsThreadCreate(BenchChunkThread, &chunks[i],
+                &handles[i]) != NvSuccess)
+            handles[i] = NULL;
+    }
+
+    BenchChunkThread(&chunks[0]);
+    crc = chunks[0].Crc;
+    for (i = 1; i < threads; i++)
+    {
+        if (handles[i])
+            NvOsThreadJoin(handles[i]);
+        else
+            BenchChunkThread(&chunks[i]);
+        crc = NvComputeCrc32Combine(crc, chunks[i].Crc, chunks[i].Size);
+    }
+
+    return crc;
+}
+
+static double BenchMBs(NvU64 bytes, NvU64 us)
+{
+    return us ? (double)bytes / us : 0.0;
+}
+
+int main(int argc, char **argv)
+{
+    NvU32 mb = BENCH_DEFAULT_MB;
+    NvU32 size, i, crc, ref = 0;
+    NvCrc32Backend backend, best;
+    NvU64 start, us;
+    NvBool ok = NV_TRUE;
+    NvU8 *buf;
+
+    if (argc > 1)
+    {
+        mb = strtoul(argv[1], NULL, 0);
+        if (!mb || mb > 1024)
+        {
+            printf("usage: %s [megabytes]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    size = mb * 1024 * 1024;
+    buf = malloc(size);
+    if (!buf)
+    {
+        printf("cannot allocate %u MB\n", mb);
+        return 1;
+    }
+    for (i = 0; i < size; i++)
+        buf[i] = (NvU8)BenchRandom();
+
+    best = NvCrc32GetBackend();
+    printf("default implementation: %s\n", s_BackendNames[best]);
+
+    for (backend = NvCrc32Backend_Bytewise; backend < NvCrc32Backend_Num;
+         backend++)
+    {
+        if (!NvCrc32SelectBackend(backend))
+        {
+            printf("%-9s not supported\n", s_BackendNames[backend]);
+            continue;
+        }
+
+        if (!CheckBackend(buf))
+        {
+            printf("%-9s check FAILED\n", s_BackendNames[backend]);
+            ok = NV_FALSE;
+            continue;
+        }
+
+        start = NvOsGetTimeUS();
+        crc = NvComputeCrc32(0, buf, size);
+        us = NvOsGetTimeUS() - start;
+
+        if (backend == NvCrc32Backend_Bytewise)
+            ref = crc;
+        else if (crc != ref)
+            ok = NV_FALSE;
+
+        printf("%-9s %u MB in %llu us, %8.1f MB/s%s\n",
+            s_BackendNames[backend], mb, us, BenchMBs(size, us),
+            crc == ref ? "" : " MISMATCH");
+    }
+
+    NvCrc32SelectBackend(best);
+    if (!CheckCombine(buf, size < (1 << 20) ? size : (1 << 20)))
+    {
+        printf("combine check FAILED\n");
+        ok = NV_FALSE;
+    }
+
+    for (i = 1; i <= BENCH_MAX_THREADS; i++)
+    {
+        start = NvOsGetTimeUS();
+        crc = ParallelCrc32(buf, size, i);
+        us = NvOsGetTimeUS() - start;
+        if (crc != ref)
+            ok = NV_FALSE;
+
+        printf("%u chunks  %u MB in %llu us, %8.1f MB/s%s\n", i, mb, us,
+            BenchMBs(size, us), crc == ref ? "" : " MISMATCH");
+    }
+
+    free(buf);
+    printf(ok ? "PASSED\n" : "FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -49,6 +49,11 @@
 #define CHUNK_TYPE_FILL   0xCAC2
 #define CHUNK_TYPE_DONT_CARE  0xCAC3
 #define CHUNK_TYPE_CRC32  0xCAC4
+
+// Blocks written per call for a FILL chunk
+#define FILL_CHUNK_BLOCKS (1 << 8)
+// DONT_CARE runs shorter than this are skipped without trimming them
+#define DONT_CARE_TRIM_MIN (1024 * 1024)
 static NvBool IsStart = NV_TRUE;
 
 typedef struct SparseHeaderRec {
@@ -214,7 +219,7 @@ NvError NvSysUtilUnSparse(
     NvU32 offset = 0;
     NvU32 BytesToDecode = Size;
     const NvU8 *pBuff = Buffer;
-    NvU32 *FillBuff = NULL;
+    static NvU32 *FillBuff = NULL;
     static NvU8 *FillData = NULL;
     static NvU32 NumFillBlocks = 0;
     static NvU8 *crc = NULL;
@@ -263,6 +268,10 @@ NvError NvSysUtilUnSparse(
 
         *FillData = 0;
 
+        // Left over by an image that was not completed, blk_sz may differ
+        NvOsFree(FillBuff);
+        FillBuff = NULL;
+
         crc = NvOsAlloc(sizeof(NvU32));
         if (crc == NULL)
         {
@@ -271,6 +280,7 @@ NvError NvSysUtilUnSparse(
         }
 
         *crc = 0;
+        hSparse->filecrc = 0;
         hSparse->dummy = NV_FALSE;
         hSparse->dummycount = 0;
         if(BytesToDecode < sizeof(SparseHeader))
@@ -405,7 +415,7 @@ NvError NvSysUtilUnSparse(
 
                 offset += hSparse->BytesRemaining;
                 BytesToDecode -= hSparse->BytesRemaining;
-                if(*crc != hSparse->filecrc)
+                if (*(NvU32 *)crc != hSparse->filecrc)
                 {
                     e= NvError_CountMismatch;
                     goto fail;
@@ -426,21 +436,27 @@ NvError NvSysUtilUnSparse(
             {
                 NvU32 i;
                 NvU32 BlocksToWrite;
+                NvU32 BytesToWrite;
                 NvU32 BytesWritten = 0;
-                NvU32 NumBlocksInChunk = 1 << 8;
+                NvBool IsEnd;
 
                 NvOsMemcpy(FillData + sizeof(NvU32) - hSparse->BytesRemaining,
                             pBuff + offset,
                             hSparse->BytesRemaining);
 
-                BlocksToWrite = (NvU32)NV_MIN(NumBlocksInChunk, NumFillBlocks);
-                FillBuff = NvOsAlloc(hSparse->pSparse->blk_sz * BlocksToWrite);
+                // The buffer is kept for the following FILL chunks
                 if (FillBuff == NULL)
                 {
-                    e = NvError_InsufficientMemory;
-                    goto fail;
+                    FillBuff = NvOsAlloc(hSparse->pSparse->blk_sz *
+                                         FILL_CHUNK_BLOCKS);
+                    if (FillBuff == NULL)
+                    {
+                        e = NvError_InsufficientMemory;
+                        goto fail;
+                    }
                 }
 
+                BlocksToWrite = (NvU32)NV_MIN(FILL_CHUNK_BLOCKS, NumFillBlocks);
                 i = 0;
                 while (i < (hSparse->pSparse->blk_sz * BlocksToWrite) /
                             sizeof(NvU32))
@@ -450,19 +466,43 @@ NvError NvSysUtilUnSparse(
 
                 while (NumFillBlocks)
                 {
-                    BlocksToWrite = (NvU32)NV_MIN(NumBlocksInChunk, NumFillBlocks);
+                    BlocksToWrite = (NvU32)NV_MIN(FILL_CHUNK_BLOCKS, NumFillBlocks);
+                    BytesToWrite = BlocksToWrite * hSparse->pSparse->blk_sz;
                     NumFillBlocks -= BlocksToWrite;
                     e = NvStorMgrFileWrite(hFile, (void *)FillBuff,
-                                    BlocksToWrite * hSparse->pSparse->blk_sz,
+                                    BytesToWrite,
                                     &BytesWritten);
-                    if (BytesWritten != BlocksToWrite * hSparse->pSparse->blk_sz)
+                    if (BytesWritten != BytesToWrite)
                         e = NvError_EndOfFile;
                     if (e != NvSuccess)
                         goto fail;
-                }
 
-                NvOsFree(FillBuff);
-                FillBuff = NULL;
+                    // Filled blocks are part of the image the hash and the
+                    // CRC32 chunks are computed over
+                    if (IsSignRequired)
+                    {
+                        IsEnd = !NumFillBlocks && IsLastBuffer &&
+                                (BytesToDecode == hSparse->BytesRemaining);
+                        e = NvSysUtilSignUnSparse(
+                                   (NvU8 *)FillBuff,
+                                   lBuff,
+                                   &LeftOut,
+                                   BytesToWrite,
+                                   IsSparseStart,
+                                   IsEnd,
+                                   Hash,
+                                   OpMode);
+                        if (e != NvSuccess)
+                            goto fail;
+                        if (IsEnd)
+                            LeftOut = 0;
+                    }
+                    if (IsCRC32Required)
+                        hSparse->filecrc = NvComputeCrc32(
+                                                  hSparse->filecrc,
+                                                  (NvU8 *)FillBuff,
+                                                  BytesToWrite);
+                }
 
                 offset += hSparse->BytesRemaining;
                 BytesToDecode -= hSparse->BytesRemaining;
@@ -578,6 +618,25 @@ NvError NvSysUtilUnSparse(
                     }
                     NvOsFree(ZeroBuffer);
                 }
+                // Don't care blocks read back as zeros for the CRC32 chunks
+                if (IsCRC32Required)
+                    hSparse->filecrc = NvComputeCrc32Zeros(hSparse->filecrc,
+                                                  hSparse->BytesRemaining);
+                // Trim large runs so stale data of a previous image does
+                // not survive in them. Not every file system or device can
+                // trim, the blocks are then only skipped as before.
+                if (hSparse->BytesRemaining >= DONT_CARE_TRIM_MIN)
+                {
+                    NvFileSystemIoctl_TrimEraseInputArgs TrimArgs;
+
+                    TrimArgs.NumBytes = hSparse->BytesRemaining;
+                    (void)NvStorMgrFileIoctl(hFile,
+                                             NvFileSystemIoctlType_TrimErase,
+                                             sizeof(TrimArgs),
+                                             0,
+                                             &TrimArgs,
+                                             NULL);
+                }
                 NvStorMgrFileSeek(hFile, hSparse->BytesRemaining, NvOsSeek_Cur);
                 hSparse->state = Unsparse_ChunkHeaderDownloading;
                 hSparse->BytesRemaining = CHUNK_HEADER_LEN;
@@ -630,10 +689,10 @@ fail:
         NvOsFree(hSparse);
         NvOsFree(crc);
         NvOsFree(FillData);
+        NvOsFree(FillBuff);
+        FillBuff = NULL;
         IsStart = NV_TRUE;
     }
-    if (FillBuff)
-        NvOsFree(FillBuff);
 
     return e;
 }
@@ -4,6 +4,7 @@ include $(NVIDIA_DEFAULTS)
 
 LOCAL_MODULE := libnvaes_ref
 LOCAL_SRC_FILES += aes_ref.c
+LOCAL_SRC_FILES += aes_blocks.c
 
 include $(NVIDIA_HOST_STATIC_LIBRARY)
 
@@ -12,8 +13,33 @@ include $(NVIDIA_DEFAULTS)
 LOCAL_MODULE := libnvaes_ref
 LOCAL_CFLAGS += -Os -ggdb0
 LOCAL_SRC_FILES += aes_ref.c
+LOCAL_SRC_FILES += aes_blocks.c
 
 LOCAL_NVIDIA_NO_EXTRA_WARNINGS := 1
 include $(NVIDIA_STATIC_LIBRARY)
 
+# AES known-answer and throughput test
 
+include $(NVIDIA_DEFAULTS)
+
+LOCAL_MODULE := aes_blocks_test
+LOCAL_MODULE_TAGS := nvidia_tests
+
+LOCAL_SRC_FILES := aes_blocks_test.c
+
+LOCAL_STATIC_LIBRARIES += libnvaes_ref
+LOCAL_SHARED_LIBRARIES += libnvos
+
+include $(NVIDIA_EXECUTABLE)
+
+include $(NVIDIA_DEFAULTS)
+
+LOCAL_MODULE := aes_blocks_test
+
+LOCAL_SRC_FILES := aes_blocks_test.c
+
+LOCAL_STATIC_LIBRARIES += libnvaes_ref
+LOCAL_STATIC_LIBRARIES += libnvos
+LOCAL_LDLIBS += -lpthread -ldl
+
+include $(NVIDIA_HOST_EXECUTABLE)
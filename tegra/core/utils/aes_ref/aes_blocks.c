@@ -0,0 +1,1174 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+/*
+ * Multi-block AES-128 in ECB, CBC and CTR modes, on top of interchangeable
+ * block cipher implementations. Each implementation encrypts or decrypts a
+ * run of independent blocks, interleaving several of them where it can; the
+ * modes hand them up to AES_CHUNK_BLOCKS blocks at a time, except for CBC
+ * encryption, which is serial.
+ */
+
+#include "nvaes_ref.h"
+#include "nvos.h"
+
+#if defined(__ARM_FEATURE_CRYPTO)
+#include <arm_neon.h>
+#define AES_HAVE_ARMV8CE 1
+#else
+#define AES_HAVE_ARMV8CE 0
+#endif
+
+#if (defined(__i386__) || defined(__x86_64__)) && (defined(__clang__) || \
+    __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#define AES_HAVE_AESNI 1
+#else
+#define AES_HAVE_AESNI 0
+#endif
+
+// blocks handed to an implementation at once by the chaining modes
+#define AES_CHUNK_BLOCKS    8
+
+// blocks processed at once by the bitsliced implementation
+#define AES_SLICE_BLOCKS    4
+
+#define AES_GETU32(p) \
+    (((NvU32)(p)[0] << 24) | ((NvU32)(p)[1] << 16) | \
+     ((NvU32)(p)[2] << 8) | (NvU32)(p)[3])
+
+#define AES_PUTU32(p, v) \
+    do { \
+        (p)[0] = (NvU8)((v) >> 24); \
+        (p)[1] = (NvU8)((v) >> 16); \
+        (p)[2] = (NvU8)((v) >> 8); \
+        (p)[3] = (NvU8)(v); \
+    } while (0)
+
+#define AES_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+typedef void (*AesBlocksFunc)(const NvAesKeySchedule *pSchedule,
+                              const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks);
+
+// forward s-box
+static const NvU8 s_Sbox[256] =
+{
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5,
+    0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0,
+    0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc,
+    0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a,
+    0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0,
+    0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b,
+    0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85,
+    0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5,
+    0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17,
+    0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88,
+    0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c,
+    0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9,
+    0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6,
+    0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e,
+    0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94,
+    0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68,
+    0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+// inverse s-box
+static const NvU8 s_InvSbox[256] =
+{
+    0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38,
+    0xbf, 0x40, 0xa3, 0x9e, 0x81, 0xf3, 0xd7, 0xfb,
+    0x7c, 0xe3, 0x39, 0x82, 0x9b, 0x2f, 0xff, 0x87,
+    0x34, 0x8e, 0x43, 0x44, 0xc4, 0xde, 0xe9, 0xcb,
+    0x54, 0x7b, 0x94, 0x32, 0xa6, 0xc2, 0x23, 0x3d,
+    0xee, 0x4c, 0x95, 0x0b, 0x42, 0xfa, 0xc3, 0x4e,
+    0x08, 0x2e, 0xa1, 0x66, 0x28, 0xd9, 0x24, 0xb2,
+    0x76, 0x5b, 0xa2, 0x49, 0x6d, 0x8b, 0xd1, 0x25,
+    0x72, 0xf8, 0xf6, 0x64, 0x86, 0x68, 0x98, 0x16,
+    0xd4, 0xa4, 0x5c, 0xcc, 0x5d, 0x65, 0xb6, 0x92,
+    0x6c, 0x70, 0x48, 0x50, 0xfd, 0xed, 0xb9, 0xda,
+    0x5e, 0x15, 0x46, 0x57, 0xa7, 0x8d, 0x9d, 0x84,
+    0x90, 0xd8, 0xab, 0x00, 0x8c, 0xbc, 0xd3, 0x0a,
+    0xf7, 0xe4, 0x58, 0x05, 0xb8, 0xb3, 0x45, 0x06,
+    0xd0, 0x2c, 0x1e, 0x8f, 0xca, 0x3f, 0x0f, 0x02,
+    0xc1, 0xaf, 0xbd, 0x03, 0x01, 0x13, 0x8a, 0x6b,
+    0x3a, 0x91, 0x11, 0x41, 0x4f, 0x67, 0xdc, 0xea,
+    0x97, 0xf2, 0xcf, 0xce, 0xf0, 0xb4, 0xe6, 0x73,
+    0x96, 0xac, 0x74, 0x22, 0xe7, 0xad, 0x35, 0x85,
+    0xe2, 0xf9, 0x37, 0xe8, 0x1c, 0x75, 0xdf, 0x6e,
+    0x47, 0xf1, 0x1a, 0x71, 0x1d, 0x29, 0xc5, 0x89,
+    0x6f, 0xb7, 0x62, 0x0e, 0xaa, 0x18, 0xbe, 0x1b,
+    0xfc, 0x56, 0x3e, 0x4b, 0xc6, 0xd2, 0x79, 0x20,
+    0x9a, 0xdb, 0xc0, 0xfe, 0x78, 0xcd, 0x5a, 0xf4,
+    0x1f, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31,
+    0xb1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xec, 0x5f,
+    0x60, 0x51, 0x7f, 0xa9, 0x19, 0xb5, 0x4a, 0x0d,
+    0x2d, 0xe5, 0x7a, 0x9f, 0x93, 0xc9, 0x9c, 0xef,
+    0xa0, 0xe0, 0x3b, 0x4d, 0xae, 0x2a, 0xf5, 0xb0,
+    0xc8, 0xeb, 0xbb, 0x3c, 0x83, 0x53, 0x99, 0x61,
+    0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26,
+    0xe1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0c, 0x7d
+};
+
+// S-box times the MixColumns column {02, 01, 01, 03}, most significant
+// byte first
+static const NvU32 s_Te[256] =
+{
+    0xc66363a5, 0xf87c7c84, 0xee777799, 0xf67b7b8d, 0xfff2f20d, 0xd66b6bbd,
+    0xde6f6fb1, 0x91c5c554, 0x60303050, 0x02010103, 0xce6767a9, 0x562b2b7d,
+    0xe7fefe19, 0xb5d7d762, 0x4dababe6, 0xec76769a, 0x8fcaca45, 0x1f82829d,
+    0x89c9c940, 0xfa7d7d87, 0xeffafa15, 0xb25959eb, 0x8e4747c9, 0xfbf0f00b,
+    0x41adadec, 0xb3d4d467, 0x5fa2a2fd, 0x45afafea, 0x239c9cbf, 0x53a4a4f7,
+    0xe4727296, 0x9bc0c05b, 0x75b7b7c2, 0xe1fdfd1c, 0x3d9393ae, 0x4c26266a,
+    0x6c36365a, 0x7e3f3f41, 0xf5f7f702, 0x83cccc4f, 0x6834345c, 0x51a5a5f4,
+    0xd1e5e534, 0xf9f1f108, 0xe2717193, 0xabd8d873, 0x62313153, 0x2a15153f,
+    0x0804040c, 0x95c7c752, 0x46232365, 0x9dc3c35e, 0x30181828, 0x379696a1,
+    0x0a05050f, 0x2f9a9ab5, 0x0e070709, 0x24121236, 0x1b80809b, 0xdfe2e23d,
+    0xcdebeb26, 0x4e272769, 0x7fb2b2cd, 0xea75759f, 0x1209091b, 0x1d83839e,
+    0x582c2c74, 0x341a1a2e, 0x361b1b2d, 0xdc6e6eb2, 0xb45a5aee, 0x5ba0a0fb,
+    0xa45252f6, 0x763b3b4d, 0xb7d6d661, 0x7db3b3ce, 0x5229297b, 0xdde3e33e,
+    0x5e2f2f71, 0x13848497, 0xa65353f5, 0xb9d1d168, 0x00000000, 0xc1eded2c,
+    0x40202060, 0xe3fcfc1f, 0x79b1b1c8, 0xb65b5bed, 0xd46a6abe, 0x8dcbcb46,
+    0x67bebed9, 0x7239394b, 0x944a4ade, 0x984c4cd4, 0xb05858e8, 0x85cfcf4a,
+    0xbbd0d06b, 0xc5efef2a, 0x4faaaae5, 0xedfbfb16, 0x864343c5, 0x9a4d4dd7,
+    0x66333355, 0x11858594, 0x8a4545cf, 0xe9f9f910, 0x04020206, 0xfe7f7f81,
+    0xa05050f0, 0x783c3c44, 0x259f9fba, 0x4ba8a8e3, 0xa25151f3, 0x5da3a3fe,
+    0x804040c0, 0x058f8f8a, 0x3f9292ad, 0x219d9dbc, 0x70383848, 0xf1f5f504,
+    0x63bcbcdf, 0x77b6b6c1, 0xafdada75, 0x42212163, 0x20101030, 0xe5ffff1a,
+    0xfdf3f30e, 0xbfd2d26d, 0x81cdcd4c, 0x180c0c14, 0x26131335, 0xc3ecec2f,
+    0xbe5f5fe1, 0x359797a2, 0x884444cc, 0x2e171739, 0x93c4c457, 0x55a7a7f2,
+    0xfc7e7e82, 0x7a3d3d47, 0xc86464ac, 0xba5d5de7, 0x3219192b, 0xe6737395,
+    0xc06060a0, 0x19818198, 0x9e4f4fd1, 0xa3dcdc7f, 0x44222266, 0x542a2a7e,
+    0x3b9090ab, 0x0b888883, 0x8c4646ca, 0xc7eeee29, 0x6bb8b8d3, 0x2814143c,
+    0xa7dede79, 0xbc5e5ee2, 0x160b0b1d, 0xaddbdb76, 0xdbe0e03b, 0x64323256,
+    0x743a3a4e, 0x140a0a1e, 0x924949db, 0x0c06060a, 0x4824246c, 0xb85c5ce4,
+    0x9fc2c25d, 0xbdd3d36e, 0x43acacef, 0xc46262a6, 0x399191a8, 0x319595a4,
+    0xd3e4e437, 0xf279798b, 0xd5e7e732, 0x8bc8c843, 0x6e373759, 0xda6d6db7,
+    0x018d8d8c, 0xb1d5d564, 0x9c4e4ed2, 0x49a9a9e0, 0xd86c6cb4, 0xac5656fa,
+    0xf3f4f407, 0xcfeaea25, 0xca6565af, 0xf47a7a8e, 0x47aeaee9, 0x10080818,
+    0x6fbabad5, 0xf0787888, 0x4a25256f, 0x5c2e2e72, 0x381c1c24, 0x57a6a6f1,
+    0x73b4b4c7, 0x97c6c651, 0xcbe8e823, 0xa1dddd7c, 0xe874749c, 0x3e1f1f21,
+    0x964b4bdd, 0x61bdbddc, 0x0d8b8b86, 0x0f8a8a85, 0xe0707090, 0x7c3e3e42,
+    0x71b5b5c4, 0xcc6666aa, 0x904848d8, 0x06030305, 0xf7f6f601, 0x1c0e0e12,
+    0xc26161a3, 0x6a35355f, 0xae5757f9, 0x69b9b9d0, 0x17868691, 0x99c1c158,
+    0x3a1d1d27, 0x279e9eb9, 0xd9e1e138, 0xebf8f813, 0x2b9898b3, 0x22111133,
+    0xd26969bb, 0xa9d9d970, 0x078e8e89, 0x339494a7, 0x2d9b9bb6, 0x3c1e1e22,
+    0x15878792, 0xc9e9e920, 0x87cece49, 0xaa5555ff, 0x50282878, 0xa5dfdf7a,
+    0x038c8c8f, 0x59a1a1f8, 0x09898980, 0x1a0d0d17, 0x65bfbfda, 0xd7e6e631,
+    0x844242c6, 0xd06868b8, 0x824141c3, 0x299999b0, 0x5a2d2d77, 0x1e0f0f11,
+    0x7bb0b0cb, 0xa85454fc, 0x6dbbbbd6, 0x2c16163a
+};
+
+// inverse S-box times the InvMixColumns column {0e, 09, 0d, 0b}, most
+// significant byte first
+static const NvU32 s_Td[256] =
+{
+    0x51f4a750, 0x7e416553, 0x1a17a4c3, 0x3a275e96, 0x3bab6bcb, 0x1f9d45f1,
+    0xacfa58ab, 0x4be30393, 0x2030fa55, 0xad766df6, 0x88cc7691, 0xf5024c25,
+    0x4fe5d7fc, 0xc52acbd7, 0x26354480, 0xb562a38f, 0xdeb15a49, 0x25ba1b67,
+    0x45ea0e98, 0x5dfec0e1, 0xc32f7502, 0x814cf012, 0x8d4697a3, 0x6bd3f9c6,
+    0x038f5fe7, 0x15929c95, 0xbf6d7aeb, 0x955259da, 0xd4be832d, 0x587421d3,
+    0x49e06929, 0x8ec9c844, 0x75c2896a, 0xf48e7978, 0x99583e6b, 0x27b971dd,
+    0xbee14fb6, 0xf088ad17, 0xc920ac66, 0x7dce3ab4, 0x63df4a18, 0xe51a3182,
+    0x97513360, 0x62537f45, 0xb16477e0, 0xbb6bae84, 0xfe81a01c, 0xf9082b94,
+    0x70486858, 0x8f45fd19, 0x94de6c87, 0x527bf8b7, 0xab73d323, 0x724b02e2,
+    0xe31f8f57, 0x6655ab2a, 0xb2eb2807, 0x2fb5c203, 0x86c57b9a, 0xd33708a5,
+    0x302887f2, 0x23bfa5b2, 0x02036aba, 0xed16825c, 0x8acf1c2b, 0xa779b492,
+    0xf307f2f0, 0x4e69e2a1, 0x65daf4cd, 0x0605bed5, 0xd134621f, 0xc4a6fe8a,
+    0x342e539d, 0xa2f355a0, 0x058ae132, 0xa4f6eb75, 0x0b83ec39, 0x4060efaa,
+    0x5e719f06, 0xbd6e1051, 0x3e218af9, 0x96dd063d, 0xdd3e05ae, 0x4de6bd46,
+    0x91548db5, 0x71c45d05, 0x0406d46f, 0x605015ff, 0x1998fb24, 0xd6bde997,
+    0x894043cc, 0x67d99e77, 0xb0e842bd, 0x07898b88, 0xe7195b38, 0x79c8eedb,
+    0xa17c0a47, 0x7c420fe9, 0xf8841ec9, 0x00000000, 0x09808683, 0x322bed48,
+    0x1e1170ac, 0x6c5a724e, 0xfd0efffb, 0x0f853856, 0x3daed51e, 0x362d3927,
+    0x0a0fd964, 0x685ca621, 0x9b5b54d1, 0x24362e3a, 0x0c0a67b1, 0x9357e70f,
+    0xb4ee96d2, 0x1b9b919e, 0x80c0c54f, 0x61dc20a2, 0x5a774b69, 0x1c121a16,
+    0xe293ba0a, 0xc0a02ae5, 0x3c22e043, 0x121b171d, 0x0e090d0b, 0xf28bc7ad,
+    0x2db6a8b9, 0x141ea9c8, 0x57f11985, 0xaf75074c, 0xee99ddbb, 0xa37f60fd,
+    0xf701269f, 0x5c72f5bc, 0x44663bc5, 0x5bfb7e34, 0x8b432976, 0xcb23c6dc,
+    0xb6edfc68, 0xb8e4f163, 0xd731dcca, 0x42638510, 0x13972240, 0x84c61120,
+    0x854a247d, 0xd2bb3df8, 0xaef93211, 0xc729a16d, 0x1d9e2f4b, 0xdcb230f3,
+    0x0d8652ec, 0x77c1e3d0, 0x2bb3166c, 0xa970b999, 0x119448fa, 0x47e96422,
+    0xa8fc8cc4, 0xa0f03f1a, 0x567d2cd8, 0x223390ef, 0x87494ec7, 0xd938d1c1,
+    0x8ccaa2fe, 0x98d40b36, 0xa6f581cf, 0xa57ade28, 0xdab78e26, 0x3fadbfa4,
+    0x2c3a9de4, 0x5078920d, 0x6a5fcc9b, 0x547e4662, 0xf68d13c2, 0x90d8b8e8,
+    0x2e39f75e, 0x82c3aff5, 0x9f5d80be, 0x69d0937c, 0x6fd52da9, 0xcf2512b3,
+    0xc8ac993b, 0x10187da7, 0xe89c636e, 0xdb3bbb7b, 0xcd267809, 0x6e5918f4,
+    0xec9ab701, 0x834f9aa8, 0xe6956e65, 0xaaffe67e, 0x21bccf08, 0xef15e8e6,
+    0xbae79bd9, 0x4a6f36ce, 0xea9f09d4, 0x29b07cd6, 0x31a4b2af, 0x2a3f2331,
+    0xc6a59430, 0x35a266c0, 0x744ebc37, 0xfc82caa6, 0xe090d0b0, 0x33a7d815,
+    0xf104984a, 0x41ecdaf7, 0x7fcd500e, 0x1791f62f, 0x764dd68d, 0x43efb04d,
+    0xccaa4d54, 0xe49604df, 0x9ed1b5e3, 0x4c6a881b, 0xc12c1fb8, 0x4665517f,
+    0x9d5eea04, 0x018c355d, 0xfa877473, 0xfb0b412e, 0xb3671d5a, 0x92dbd252,
+    0xe9105633, 0x6dd64713, 0x9ad7618c, 0x37a10c7a, 0x59f8148e, 0xeb133c89,
+    0xcea927ee, 0xb761c935, 0xe11ce5ed, 0x7a47b13c, 0x9cd2df59, 0x55f2733f,
+    0x1814ce79, 0x73c737bf, 0x53f7cdea, 0x5ffdaa5b, 0xdf3d6f14, 0x7844db86,
+    0xcaaff381, 0xb968c43e, 0x3824342c, 0xc2a3405f, 0x161dc372, 0xbce2250c,
+    0x283c498b, 0xff0d9541, 0x39a80171, 0x080cb3de, 0xd8b4e49c, 0x6456c190,
+    0x7bcb8461, 0xd532b670, 0x486c5c74, 0xd0b85742
+};
+
+/*
+ * Reference implementation
+ */
+
+static void
+RefEncryptBlocks(const NvAesKeySchedule *pSchedule,
+                 const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks)
+{
+    NvU8 in[NVAES_BLOCK_BYTES];
+
+    for (; NumBlocks--; pSrc += NVAES_BLOCK_BYTES, pDst += NVAES_BLOCK_BYTES)
+    {
+        NvOsMemcpy(in, pSrc, NVAES_BLOCK_BYTES);
+        NvAesEncrypt(in, (NvU8 *)pSchedule->EncKey, pDst);
+    }
+}
+
+static void
+RefDecryptBlocks(const NvAesKeySchedule *pSchedule,
+                 const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks)
+{
+    NvU8 in[NVAES_BLOCK_BYTES];
+
+    for (; NumBlocks--; pSrc += NVAES_BLOCK_BYTES, pDst += NVAES_BLOCK_BYTES)
+    {
+        NvOsMemcpy(in, pSrc, NVAES_BLOCK_BYTES);
+        NvAesDecrypt(in, (NvU8 *)pSchedule->EncKey, pDst);
+    }
+}
+
+/*
+ * T-table implementation: each round of a column is four table lookups,
+ * the other three tables being byte rotations of s_Te and s_Td. The lookups
+ * depend on the data, so this is not constant time.
+ */
+
+static void
+TTableEncryptBlocks(const NvAesKeySchedule *pSchedule,
+                    const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks)
+{
+    const NvU32 *rk;
+    NvU32 s0, s1, s2, s3, t0, t1, t2, t3;
+    NvU32 round;
+
+    for (; NumBlocks--; pSrc += NVAES_BLOCK_BYTES, pDst += NVAES_BLOCK_BYTES)
+    {
+        rk = pSchedule->EncWords;
+        s0 = AES_GETU32(pSrc + 0) ^ rk[0];
+        s1 = AES_GETU32(pSrc + 4) ^ rk[1];
+        s2 = AES_GETU32(pSrc + 8) ^ rk[2];
+        s3 = AES_GETU32(pSrc + 12) ^ rk[3];
+
+        for (round = 1; round < NVAES_ROUNDS; round++)
+        {
+            rk += NVAES_STATECOLS;
+            t0 = s_Te[s0 >> 24] ^ AES_ROTR(s_Te[(s1 >> 16) & 0xff], 8) ^
+                 AES_ROTR(s_Te[(s2 >> 8) & 0xff], 16) ^
+                 AES_ROTR(s_Te[s3 & 0xff], 24) ^ rk[0];
+            t1 = s_Te[s1 >> 24] ^ AES_ROTR(s_Te[(s2 >> 16) & 0xff], 8) ^
+                 AES_ROTR(s_Te[(s3 >> 8) & 0xff], 16) ^
+                 AES_ROTR(s_Te[s0 & 0xff], 24) ^ rk[1];
+            t2 = s_Te[s2 >> 24] ^ AES_ROTR(s_Te[(s3 >> 16) & 0xff], 8) ^
+                 AES_ROTR(s_Te[(s0 >> 8) & 0xff], 16) ^
+                 AES_ROTR(s_Te[s1 & 0xff], 24) ^ rk[2];
+            t3 = s_Te[s3 >> 24] ^ AES_ROTR(s_Te[(s0 >> 16) & 0xff], 8) ^
+                 AES_ROTR(s_Te[(s1 >> 8) & 0xff], 16) ^
+                 AES_ROTR(s_Te[s2 & 0xff], 24) ^ rk[3];
+            s0 = t0;
+            s1 = t1;
+            s2 = t2;
+            s3 = t3;
+        }
+
+        // last round, without MixColumns
+        rk += NVAES_STATECOLS;
+        t0 = ((NvU32)s_Sbox[s0 >> 24] << 24) ^
+             ((NvU32)s_Sbox[(s1 >> 16) & 0xff] << 16) ^
+             ((NvU32)s_Sbox[(s2 >> 8) & 0xff] << 8) ^
+             (NvU32)s_Sbox[s3 & 0xff] ^ rk[0];
+        t1 = ((NvU32)s_Sbox[s1 >> 24] << 24) ^
+             ((NvU32)s_Sbox[(s2 >> 16) & 0xff] << 16) ^
+             ((NvU32)s_Sbox[(s3 >> 8) & 0xff] << 8) ^
+             (NvU32)s_Sbox[s0 & 0xff] ^ rk[1];
+        t2 = ((NvU32)s_Sbox[s2 >> 24] << 24) ^
+             ((NvU32)s_Sbox[(s3 >> 16) & 0xff] << 16) ^
+             ((NvU32)s_Sbox[(s0 >> 8) & 0xff] << 8) ^
+             (NvU32)s_Sbox[s1 & 0xff] ^ rk[2];
+        t3 = ((NvU32)s_Sbox[s3 >> 24] << 24) ^
+             ((NvU32)s_Sbox[(s0 >> 16) & 0xff] << 16) ^
+             ((NvU32)s_Sbox[(s1 >> 8) & 0xff] << 8) ^
+             (NvU32)s_Sbox[s2 & 0xff] ^ rk[3];
+        AES_PUTU32(pDst + 0, t0);
+        AES_PUTU32(pDst + 4, t1);
+        AES_PUTU32(pDst + 8, t2);
+        AES_PUTU32(pDst + 12, t3);
+    }
+}
+
+static void
+TTableDecryptBlocks(const NvAesKeySchedule *pSchedule,
+                    const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks)
+{
+    const NvU32 *rk;
+    NvU32 s0, s1, s2, s3, t0, t1, t2, t3;
+    NvU32 round;
+
+    for (; NumBlocks--; pSrc += NVAES_BLOCK_BYTES, pDst += NVAES_BLOCK_BYTES)
+    {
+        rk = pSchedule->DecWords;
+        s0 = AES_GETU32(pSrc + 0) ^ rk[0];
+        s1 = AES_GETU32(pSrc + 4) ^ rk[1];
+        s2 = AES_GETU32(pSrc + 8) ^ rk[2];
+        s3 = AES_GETU32(pSrc + 12) ^ rk[3];
+
+        for (round = 1; round < NVAES_ROUNDS; round++)
+        {
+            rk += NVAES_STATECOLS;
+            t0 = s_Td[s0 >> 24] ^ AES_ROTR(s_Td[(s3 >> 16) & 0xff], 8) ^
+                 AES_ROTR(s_Td[(s2 >> 8) & 0xff], 16) ^
+                 AES_ROTR(s_Td[s1 & 0xff], 24) ^ rk[0];
+            t1 = s_Td[s1 >> 24] ^ AES_ROTR(s_Td[(s0 >> 16) & 0xff], 8) ^
+                 AES_ROTR(s_Td[(s3 >> 8) & 0xff], 16) ^
+                 AES_ROTR(s_Td[s2 & 0xff], 24) ^ rk[1];
+            t2 = s_Td[s2 >> 24] ^ AES_ROTR(s_Td[(s1 >> 16) & 0xff], 8) ^
+                 AES_ROTR(s_Td[(s0 >> 8) & 0xff], 16) ^
+                 AES_ROTR(s_Td[s3 & 0xff], 24) ^ rk[2];
+            t3 = s_Td[s3 >> 24] ^ AES_ROTR(s_Td[(s2 >> 16) & 0xff], 8) ^
+                 AES_ROTR(s_Td[(s1 >> 8) & 0xff], 16) ^
+                 AES_ROTR(s_Td[s0 & 0xff], 24) ^ rk[3];
+            s0 = t0;
+            s1 = t1;
+            s2 = t2;
+            s3 = t3;
+        }
+
+        // last round, without InvMixColumns
+        rk += NVAES_STATECOLS;
+        t0 = ((NvU32)s_InvSbox[s0 >> 24] << 24) ^
+             ((NvU32)s_InvSbox[(s3 >> 16) & 0xff] << 16) ^
+             ((NvU32)s_InvSbox[(s2 >> 8) & 0xff] << 8) ^
+             (NvU32)s_InvSbox[s1 & 0xff] ^ rk[0];
+        t1 = ((NvU32)s_InvSbox[s1 >> 24] << 24) ^
+             ((NvU32)s_InvSbox[(s0 >> 16) & 0xff] << 16) ^
+             ((NvU32)s_InvSbox[(s3 >> 8) & 0xff] << 8) ^
+             (NvU32)s_InvSbox[s2 & 0xff] ^ rk[1];
+        t2 = ((NvU32)s_InvSbox[s2 >> 24] << 24) ^
+             ((NvU32)s_InvSbox[(s1 >> 16) & 0xff] << 16) ^
+             ((NvU32)s_InvSbox[(s0 >> 8) & 0xff] << 8) ^
+             (NvU32)s_InvSbox[s3 & 0xff] ^ rk[2];
+        t3 = ((NvU32)s_InvSbox[s3 >> 24] << 24) ^
+             ((NvU32)s_InvSbox[(s2 >> 16) & 0xff] << 16) ^
+             ((NvU32)s_InvSbox[(s1 >> 8) & 0xff] << 8) ^
+             (NvU32)s_InvSbox[s0 & 0xff] ^ rk[3];
+        AES_PUTU32(pDst + 0, t0);
+        AES_PUTU32(pDst + 4, t1);
+        AES_PUTU32(pDst + 8, t2);
+        AES_PUTU32(pDst + 12, t3);
+    }
+}
+
+/*
+ * Bitsliced implementation: AES_SLICE_BLOCKS blocks are spread over eight
+ * 64-bit planes, plane b holding bit b of every byte, at bit position
+ * 4 * (byte index) + block. The S-box is computed as the inverse in GF(2^8)
+ * followed by the affine map, with logical operations only, so the timing
+ * does not depend on the data or the key.
+ *
+ * Byte i of a block is row i % 4 of column i / 4, so a column takes up 16
+ * bits of a plane and a row is every fourth nibble.
+ */
+
+// bits of row 0
+#define AES_SLICE_ROW0      0x000F000F000F000FULL
+
+#define AES_ROTR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+// row r of each column gets row r + n, n = 1, 2, 3
+static NV_INLINE NvU64 SliceColRot1(NvU64 x)
+{
+    return ((x >> 4) & 0x0FFF0FFF0FFF0FFFULL) | ((x << 12) & 0xF000F000F000F000ULL);
+}
+
+static NV_INLINE NvU64 SliceColRot2(NvU64 x)
+{
+    return ((x >> 8) & 0x00FF00FF00FF00FFULL) | ((x << 8) & 0xFF00FF00FF00FF00ULL);
+}
+
+static NV_INLINE NvU64 SliceColRot3(NvU64 x)
+{
+    return ((x >> 12) & 0x000F000F000F000FULL) | ((x << 4) & 0xFFF0FFF0FFF0FFF0ULL);
+}
+
+static void
+SlicePack(const NvU8 *pSrc, NvU32 NumBlocks, NvU64 *q)
+{
+    NvU32 blk, i, b;
+    NvU64 bit;
+
+    for (b = 0; b < 8; b++)
+        q[b] = 0;
+
+    for (blk = 0; blk < NumBlocks; blk++)
+    {
+        for (i = 0; i < NVAES_BLOCK_BYTES; i++)
+        {
+            bit = 1ULL << (4 * i + blk);
+            for (b = 0; b < 8; b++)
+                q[b] |= ((pSrc[blk * NVAES_BLOCK_BYTES + i] >> b) & 1) ? bit : 0;
+        }
+    }
+}
+
+static void
+SliceUnpack(const NvU64 *q, NvU32 NumBlocks, NvU8 *pDst)
+{
+    NvU32 blk, i, b;
+    NvU8 v;
+
+    for (blk = 0; blk < NumBlocks; blk++)
+    {
+        for (i = 0; i < NVAES_BLOCK_BYTES; i++)
+        {
+            v = 0;
+            for (b = 0; b < 8; b++)
+                v |= (NvU8)(((q[b] >> (4 * i + blk)) & 1) << b);
+            pDst[blk * NVAES_BLOCK_BYTES + i] = v;
+        }
+    }
+}
+
+// r = a * b in GF(2^8) modulo x^8 + x^4 + x^3 + x + 1, on bit planes
+static NV_INLINE void
+SliceGfMul(NvU64 *r, const NvU64 *a, const NvU64 *b)
+{
+    NvU64 p[15];
+    int i, j;
+
+    for (i = 0; i < 15; i++)
+        p[i] = 0;
+    for (i = 0; i < 8; i++)
+        for (j = 0; j < 8; j++)
+            p[i + j] ^= a[i] & b[j];
+
+    // x^8 = x^4 + x^3 + x + 1
+    for (i = 14; i >= 8; i--)
+    {
+        p[i - 4] ^= p[i];
+        p[i - 5] ^= p[i];
+        p[i - 7] ^= p[i];
+        p[i - 8] ^= p[i];
+    }
+
+    for (i = 0; i < 8; i++)
+        r[i] = p[i];
+}
+
+static NV_INLINE void
+SliceGfSquare(NvU64 *r, const NvU64 *a)
+{
+    NvU64 p[15];
+    int i;
+
+    for (i = 0; i < 15; i++)
+        p[i] = (i & 1) ? 0 : a[i / 2];
+    for (i = 14; i >= 8; i--)
+    {
+        p[i - 4] ^= p[i];
+        p[i - 5] ^= p[i];
+        p[i - 7] ^= p[i];
+        p[i - 8] ^= p[i];
+    }
+
+    for (i = 0; i < 8; i++)
+        r[i] = p[i];
+}
+
+// q = q^254, the inverse of every non-zero byte, with 0 staying 0
+static void
+SliceGfInverse(NvU64 *q)
+{
+    NvU64 x2[8], x3[8], x12[8], t[8];
+
+    SliceGfSquare(x2, q);
+    SliceGfMul(x3, x2, q);
+    SliceGfSquare(t, x3);
+    SliceGfSquare(x12, t);
+    SliceGfMul(t, x12, x3);         // x^15
+    SliceGfSquare(t, t);
+    SliceGfSquare(t, t);
+    SliceGfSquare(t, t);
+    SliceGfSquare(t, t);            // x^240
+    SliceGfMul(t, t, x12);          // x^252
+    SliceGfMul(q, t, x2);           // x^254
+}
+
+static void
+SliceSubBytes(NvU64 *q)
+{
+    NvU64 b[8];
+    int i;
+
+    SliceGfInverse(q);
+    for (i = 0; i < 8; i++)
+        b[i] = q[i];
+
+    // affine map, adding 0x63
+    for (i = 0; i < 8; i++)
+        q[i] = b[i] ^ b[(i + 4) & 7] ^ b[(i + 5) & 7] ^ b[(i + 6) & 7] ^
+               b[(i + 7) & 7];
+    q[0] = ~q[0];
+    q[1] = ~q[1];
+    q[5] = ~q[5];
+    q[6] = ~q[6];
+}
+
+static void
+SliceInvSubBytes(NvU64 *q)
+{
+    NvU64 s[8];
+    int i;
+
+    // inverse affine map, adding 0x05
+    for (i = 0; i < 8; i++)
+        s[i] = q[i];
+    for (i = 0; i < 8; i++)
+        q[i] = s[(i + 2) & 7] ^ s[(i + 5) & 7] ^ s[(i + 7) & 7];
+    q[0] = ~q[0];
+    q[2] = ~q[2];
+
+    SliceGfInverse(q);
+}
+
+// row r of column c gets column c + r, which is a rotation by 16 * r bits
+static void
+SliceShiftRows(NvU64 *q)
+{
+    NvU64 x;
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        x = q[i];
+        q[i] = (x & AES_SLICE_ROW0) |
+               AES_ROTR64(x & (AES_SLICE_ROW0 << 4), 16) |
+               AES_ROTR64(x & (AES_SLICE_ROW0 << 8), 32) |
+               AES_ROTR64(x & (AES_SLICE_ROW0 << 12), 48);
+    }
+}
+
+static void
+SliceInvShiftRows(NvU64 *q)
+{
+    NvU64 x;
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        x = q[i];
+        q[i] = (x & AES_SLICE_ROW0) |
+               AES_ROTR64(x & (AES_SLICE_ROW0 << 4), 48) |
+               AES_ROTR64(x & (AES_SLICE_ROW0 << 8), 32) |
+               AES_ROTR64(x & (AES_SLICE_ROW0 << 12), 16);
+    }
+}
+
+// q = q * x for every byte
+static void
+SliceXtime(NvU64 *q)
+{
+    NvU64 hi = q[7];
+
+    q[7] = q[6];
+    q[6] = q[5];
+    q[5] = q[4];
+    q[4] = q[3] ^ hi;
+    q[3] = q[2] ^ hi;
+    q[2] = q[1];
+    q[1] = q[0] ^ hi;
+    q[0] = hi;
+}
+
+// row r becomes 2 * a_r + 3 * a_(r+1) + a_(r+2) + a_(r+3)
+static void
+SliceMixColumns(NvU64 *q)
+{
+    NvU64 t[8];
+    NvU64 r1;
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        r1 = SliceColRot1(q[i]);
+        t[i] = q[i] ^ r1;
+        q[i] = r1 ^ SliceColRot2(q[i]) ^ SliceColRot3(q[i]);
+    }
+
+    SliceXtime(t);
+    for (i = 0; i < 8; i++)
+        q[i] ^= t[i];
+}
+
+// InvMixColumns is MixColumns after adding 4 * (a_r + a_(r+2)) to each row
+static void
+SliceInvMixColumns(NvU64 *q)
+{
+    NvU64 t[8];
+    int i;
+
+    for (i = 0; i < 8; i++)
+        t[i] = q[i] ^ SliceColRot2(q[i]);
+
+    SliceXtime(t);
+    SliceXtime(t);
+    for (i = 0; i < 8; i++)
+        q[i] ^= t[i];
+
+    SliceMixColumns(q);
+}
+
+static void
+SliceAddRoundKey(NvU64 *q, const NvU64 *sk)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+        q[i] ^= sk[i];
+}
+
+static void
+SliceEncryptBlocks(const NvAesKeySchedule *pSchedule,
+                   const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks)
+{
+    const NvU64 *sk;
+    NvU64 q[8];
+    NvU32 n, round;
+
+    for (; NumBlocks; NumBlocks -= n)
+    {
+        n = (NumBlocks < AES_SLICE_BLOCKS) ? NumBlocks : AES_SLICE_BLOCKS;
+
+        sk = pSchedule->SliceKey;
+        SlicePack(pSrc, n, q);
+        SliceAddRoundKey(q, sk);
+        for (round = 1; round <= NVAES_ROUNDS; round++)
+        {
+            sk += 8;
+            SliceSubBytes(q);
+            SliceShiftRows(q);
+            if (round < NVAES_ROUNDS)
+                SliceMixColumns(q);
+            SliceAddRoundKey(q, sk);
+        }
+        SliceUnpack(q, n, pDst);
+
+        pSrc += n * NVAES_BLOCK_BYTES;
+        pDst += n * NVAES_BLOCK_BYTES;
+    }
+}
+
+static void
+SliceDecryptBlocks(const NvAesKeySchedule *pSchedule,
+                   const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks)
+{
+    const NvU64 *sk;
+    NvU64 q[8];
+    NvU32 n, round;
+
+    for (; NumBlocks; NumBlocks -= n)
+    {
+        n = (NumBlocks < AES_SLICE_BLOCKS) ? NumBlocks : AES_SLICE_BLOCKS;
+
+        sk = pSchedule->SliceKey + 8 * NVAES_ROUNDS;
+        SlicePack(pSrc, n, q);
+        SliceAddRoundKey(q, sk);
+        for (round = NVAES_ROUNDS; round--; )
+        {
+            sk -= 8;
+            SliceInvShiftRows(q);
+            SliceInvSubBytes(q);
+            SliceAddRoundKey(q, sk);
+            if (round)
+                SliceInvMixColumns(q);
+        }
+        SliceUnpack(q, n, pDst);
+
+        pSrc += n * NVAES_BLOCK_BYTES;
+        pDst += n * NVAES_BLOCK_BYTES;
+    }
+}
+
+#if AES_HAVE_AESNI
+/*
+ * AES-NI implementation, four blocks in flight to cover the latency of the
+ * round instructions
+ */
+
+static void __attribute__((target("sse2,aes")))
+AesNiEncryptBlocks(const NvAesKeySchedule *pSchedule,
+                   const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks)
+{
+    __m128i k[NVAES_ROUNDS + 1];
+    __m128i b0, b1, b2, b3;
+    NvU32 round;
+
+    for (round = 0; round <= NVAES_ROUNDS; round++)
+        k[round] = _mm_loadu_si128(
+            (const __m128i *)(pSchedule->EncKey + round * NVAES_BLOCK_BYTES));
+
+    for (; NumBlocks >= 4; NumBlocks -= 4)
+    {
+        b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pSrc + 0), k[0]);
+        b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pSrc + 1), k[0]);
+        b2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pSrc + 2), k[0]);
+        b3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pSrc + 3), k[0]);
+        for (round = 1; round < NVAES_ROUNDS; round++)
+        {
+            b0 = _mm_aesenc_si128(b0, k[round]);
+            b1 = _mm_aesenc_si128(b1, k[round]);
+            b2 = _mm_aesenc_si128(b2, k[round]);
+            b3 = _mm_aesenc_si128(b3, k[round]);
+        }
+        _mm_storeu_si128((__m128i *)pDst + 0,
+            _mm_aesenclast_si128(b0, k[NVAES_ROUNDS]));
+        _mm_storeu_si128((__m128i *)pDst + 1,
+            _mm_aesenclast_si128(b1, k[NVAES_ROUNDS]));
+        _mm_storeu_si128((__m128i *)pDst + 2,
+            _mm_aesenclast_si128(b2, k[NVAES_ROUNDS]));
+        _mm_storeu_si128((__m128i *)pDst + 3,
+            _mm_aesenclast_si128(b3, k[NVAES_ROUNDS]));
+        pSrc += 4 * NVAES_BLOCK_BYTES;
+        pDst += 4 * NVAES_BLOCK_BYTES;
+    }
+
+    for (; NumBlocks--; pSrc += NVAES_BLOCK_BYTES, pDst += NVAES_BLOCK_BYTES)
+    {
+        b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pSrc), k[0]);
+        for (round = 1; round < NVAES_ROUNDS; round++)
+            b0 = _mm_aesenc_si128(b0, k[round]);
+        _mm_storeu_si128((__m128i *)pDst,
+            _mm_aesenclast_si128(b0, k[NVAES_ROUNDS]));
+    }
+}
+
+static void __attribute__((target("sse2,aes")))
+AesNiDecryptBlocks(const NvAesKeySchedule *pSchedule,
+                   const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks)
+{
+    __m128i k[NVAES_ROUNDS + 1];
+    __m128i b0, b1, b2, b3;
+    NvU32 round;
+
+    for (round = 0; round <= NVAES_ROUNDS; round++)
+        k[round] = _mm_loadu_si128(
+            (const __m128i *)(pSchedule->DecKey + round * NVAES_BLOCK_BYTES));
+
+    for (; NumBlocks >= 4; NumBlocks -= 4)
+    {
+        b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pSrc + 0), k[0]);
+        b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pSrc + 1), k[0]);
+        b2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pSrc + 2), k[0]);
+        b3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pSrc + 3), k[0]);
+        for (round = 1; round < NVAES_ROUNDS; round++)
+        {
+            b0 = _mm_aesdec_si128(b0, k[round]);
+            b1 = _mm_aesdec_si128(b1, k[round]);
+            b2 = _mm_aesdec_si128(b2, k[round]);
+            b3 = _mm_aesdec_si128(b3, k[round]);
+        }
+        _mm_storeu_si128((__m128i *)pDst + 0,
+            _mm_aesdeclast_si128(b0, k[NVAES_ROUNDS]));
+        _mm_storeu_si128((__m128i *)pDst + 1,
+            _mm_aesdeclast_si128(b1, k[NVAES_ROUNDS]));
+        _mm_storeu_si128((__m128i *)pDst + 2,
+            _mm_aesdeclast_si128(b2, k[NVAES_ROUNDS]));
+        _mm_storeu_si128((__m128i *)pDst + 3,
+            _mm_aesdeclast_si128(b3, k[NVAES_ROUNDS]));
+        pSrc += 4 * NVAES_BLOCK_BYTES;
+        pDst += 4 * NVAES_BLOCK_BYTES;
+    }
+
+    for (; NumBlocks--; pSrc += NVAES_BLOCK_BYTES, pDst += NVAES_BLOCK_BYTES)
+    {
+        b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pSrc), k[0]);
+        for (round = 1; round < NVAES_ROUNDS; round++)
+            b0 = _mm_aesdec_si128(b0, k[round]);
+        _mm_storeu_si128((__m128i *)pDst,
+            _mm_aesdeclast_si128(b0, k[NVAES_ROUNDS]));
+    }
+}
+
+static NvBool
+AesNiSupported(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return NV_FALSE;
+    return (ecx & bit_AES) && (edx & bit_SSE2);
+}
+#endif
+
+#if AES_HAVE_ARMV8CE
+/*
+ * ARMv8 crypto extensions implementation. AESE and AESD add the round key
+ * before the S-box rather than after MixColumns, so the last round key is
+ * added separately.
+ */
+
+static void
+CeEncryptBlocks(const NvAesKeySchedule *pSchedule,
+                const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks)
+{
+    uint8x16_t k[NVAES_ROUNDS + 1];
+    uint8x16_t b0, b1, b2, b3;
+    NvU32 round;
+
+    for (round = 0; round <= NVAES_ROUNDS; round++)
+        k[round] = vld1q_u8(pSchedule->EncKey + round * NVAES_BLOCK_BYTES);
+
+    for (; NumBlocks >= 4; NumBlocks -= 4)
+    {
+        b0 = vld1q_u8(pSrc + 0 * NVAES_BLOCK_BYTES);
+        b1 = vld1q_u8(pSrc + 1 * NVAES_BLOCK_BYTES);
+        b2 = vld1q_u8(pSrc + 2 * NVAES_BLOCK_BYTES);
+        b3 = vld1q_u8(pSrc + 3 * NVAES_BLOCK_BYTES);
+        for (round = 0; round < NVAES_ROUNDS - 1; round++)
+        {
+            b0 = vaesmcq_u8(vaeseq_u8(b0, k[round]));
+            b1 = vaesmcq_u8(vaeseq_u8(b1, k[round]));
+            b2 = vaesmcq_u8(vaeseq_u8(b2, k[round]));
+            b3 = vaesmcq_u8(vaeseq_u8(b3, k[round]));
+        }
+        b0 = veorq_u8(vaeseq_u8(b0, k[NVAES_ROUNDS - 1]), k[NVAES_ROUNDS]);
+        b1 = veorq_u8(vaeseq_u8(b1, k[NVAES_ROUNDS - 1]), k[NVAES_ROUNDS]);
+        b2 = veorq_u8(vaeseq_u8(b2, k[NVAES_ROUNDS - 1]), k[NVAES_ROUNDS]);
+        b3 = veorq_u8(vaeseq_u8(b3, k[NVAES_ROUNDS - 1]), k[NVAES_ROUNDS]);
+        vst1q_u8(pDst + 0 * NVAES_BLOCK_BYTES, b0);
+        vst1q_u8(pDst + 1 * NVAES_BLOCK_BYTES, b1);
+        vst1q_u8(pDst + 2 * NVAES_BLOCK_BYTES, b2);
+        vst1q_u8(pDst + 3 * NVAES_BLOCK_BYTES, b3);
+        pSrc += 4 * NVAES_BLOCK_BYTES;
+        pDst += 4 * NVAES_BLOCK_BYTES;
+    }
+
+    for (; NumBlocks--; pSrc += NVAES_BLOCK_BYTES, pDst += NVAES_BLOCK_BYTES)
+    {
+        b0 = vld1q_u8(pSrc);
+        for (round = 0; round < NVAES_ROUNDS - 1; round++)
+            b0 = vaesmcq_u8(vaeseq_u8(b0, k[round]));
+        b0 = veorq_u8(vaeseq_u8(b0, k[NVAES_ROUNDS - 1]), k[NVAES_ROUNDS]);
+        vst1q_u8(pDst, b0);
+    }
+}
+
+static void
+CeDecryptBlocks(const NvAesKeySchedule *pSchedule,
+                const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks)
+{
+    uint8x16_t k[NVAES_ROUNDS + 1];
+    uint8x16_t b0, b1, b2, b3;
+    NvU32 round;
+
+    for (round = 0; round <= NVAES_ROUNDS; round++)
+        k[round] = vld1q_u8(pSchedule->DecKey + round * NVAES_BLOCK_BYTES);
+
+    for (; NumBlocks >= 4; NumBlocks -= 4)
+    {
+        b0 = vld1q_u8(pSrc + 0 * NVAES_BLOCK_BYTES);
+        b1 = vld1q_u8(pSrc + 1 * NVAES_BLOCK_BYTES);
+        b2 = vld1q_u8(pSrc + 2 * NVAES_BLOCK_BYTES);
+        b3 = vld1q_u8(pSrc + 3 * NVAES_BLOCK_BYTES);
+        for (round = 0; round < NVAES_ROUNDS - 1; round++)
+        {
+            b0 = vaesimcq_u8(vaesdq_u8(b0, k[round]));
+            b1 = vaesimcq_u8(vaesdq_u8(b1, k[round]));
+            b2 = vaesimcq_u8(vaesdq_u8(b2, k[round]));
+            b3 = vaesimcq_u8(vaesdq_u8(b3, k[round]));
+        }
+        b0 = veorq_u8(vaesdq_u8(b0, k[NVAES_ROUNDS - 1]), k[NVAES_ROUNDS]);
+        b1 = veorq_u8(vaesdq_u8(b1, k[NVAES_ROUNDS - 1]), k[NVAES_ROUNDS]);
+        b2 = veorq_u8(vaesdq_u8(b2, k[NVAES_ROUNDS - 1]), k[NVAES_ROUNDS]);
+        b3 = veorq_u8(vaesdq_u8(b3, k[NVAES_ROUNDS - 1]), k[NVAES_ROUNDS]);
+        vst1q_u8(pDst + 0 * NVAES_BLOCK_BYTES, b0);
+        vst1q_u8(pDst + 1 * NVAES_BLOCK_BYTES, b1);
+        vst1q_u8(pDst + 2 * NVAES_BLOCK_BYTES, b2);
+        vst1q_u8(pDst + 3 * NVAES_BLOCK_BYTES, b3);
+        pSrc += 4 * NVAES_BLOCK_BYTES;
+        pDst += 4 * NVAES_BLOCK_BYTES;
+    }
+
+    for (; NumBlocks--; pSrc += NVAES_BLOCK_BYTES, pDst += NVAES_BLOCK_BYTES)
+    {
+        b0 = vld1q_u8(pSrc);
+        for (round = 0; round < NVAES_ROUNDS - 1; round++)
+            b0 = vaesimcq_u8(vaesdq_u8(b0, k[round]));
+        b0 = veorq_u8(vaesdq_u8(b0, k[NVAES_ROUNDS - 1]), k[NVAES_ROUNDS]);
+        vst1q_u8(pDst, b0);
+    }
+}
+#endif
+
+static const AesBlocksFunc s_EncryptBlocks[NvAesBackend_Num] =
+{
+    NULL,
+    RefEncryptBlocks,
+    TTableEncryptBlocks,
+    SliceEncryptBlocks,
+#if AES_HAVE_AESNI
+    AesNiEncryptBlocks,
+#else
+    NULL,
+#endif
+#if AES_HAVE_ARMV8CE
+    CeEncryptBlocks,
+#else
+    NULL,
+#endif
+};
+
+static const AesBlocksFunc s_DecryptBlocks[NvAesBackend_Num] =
+{
+    NULL,
+    RefDecryptBlocks,
+    TTableDecryptBlocks,
+    SliceDecryptBlocks,
+#if AES_HAVE_AESNI
+    AesNiDecryptBlocks,
+#else
+    NULL,
+#endif
+#if AES_HAVE_ARMV8CE
+    CeDecryptBlocks,
+#else
+    NULL,
+#endif
+};
+
+// Selected backend; picking it is idempotent, so a racing first use is fine
+static NvAesBackend s_Backend = NvAesBackend_Auto;
+
+static NvBool
+AesBackendSupported(NvAesBackend Backend)
+{
+    if ((NvU32)Backend >= NvAesBackend_Num || !s_EncryptBlocks[Backend])
+        return NV_FALSE;
+#if AES_HAVE_AESNI
+    if (Backend == NvAesBackend_AesNi)
+        return AesNiSupported();
+#endif
+    return NV_TRUE;
+}
+
+NvBool
+NvAesSelectBackend(NvAesBackend Backend)
+{
+    if (Backend == NvAesBackend_Auto)
+    {
+        if (AesBackendSupported(NvAesBackend_Armv8Ce))
+            Backend = NvAesBackend_Armv8Ce;
+        else if (AesBackendSupported(NvAesBackend_AesNi))
+            Backend = NvAesBackend_AesNi;
+        else
+            Backend = NvAesBackend_TTable;
+    }
+    else if (!AesBackendSupported(Backend))
+    {
+        return NV_FALSE;
+    }
+
+    s_Backend = Backend;
+    return NV_TRUE;
+}
+
+NvAesBackend
+NvAesGetBackend(void)
+{
+    if (s_Backend == NvAesBackend_Auto)
+        NvAesSelectBackend(NvAesBackend_Auto);
+    return s_Backend;
+}
+
+static NvU8
+GfMul(NvU8 a, NvU8 b)
+{
+    NvU8 p = 0;
+
+    while (b)
+    {
+        if (b & 1)
+            p ^= a;
+        a = (NvU8)((a << 1) ^ ((a & 0x80) ? 0x1b : 0));
+        b >>= 1;
+    }
+    return p;
+}
+
+void
+NvAesSetKey(NvAesKeySchedule *pSchedule, const NvU8 *pKey)
+{
+    NvU8 *dk;
+    NvU8 a0, a1, a2, a3;
+    NvU32 round, col, i, b;
+
+    NvAesExpandKey((NvU8 *)pKey, pSchedule->EncKey);
+
+    // the equivalent inverse cipher takes the round keys in reverse order,
+    // with InvMixColumns applied to all but the first and last
+    for (round = 0; round <= NVAES_ROUNDS; round++)
+    {
+        dk = pSchedule->DecKey + round * NVAES_BLOCK_BYTES;
+        NvOsMemcpy(dk,
+            pSchedule->EncKey + (NVAES_ROUNDS - round) * NVAES_BLOCK_BYTES,
+            NVAES_BLOCK_BYTES);
+        if (round == 0 || round == NVAES_ROUNDS)
+            continue;
+
+        for (col = 0; col < NVAES_STATECOLS; col++, dk += 4)
+        {
+            a0 = dk[0];
+            a1 = dk[1];
+            a2 = dk[2];
+            a3 = dk[3];
+            dk[0] = GfMul(a0, 14) ^ GfMul(a1, 11) ^ GfMul(a2, 13) ^ GfMul(a3, 9);
+            dk[1] = GfMul(a0, 9) ^ GfMul(a1, 14) ^ GfMul(a2, 11) ^ GfMul(a3, 13);
+            dk[2] = GfMul(a0, 13) ^ GfMul(a1, 9) ^ GfMul(a2, 14) ^ GfMul(a3, 11);
+            dk[3] = GfMul(a0, 11) ^ GfMul(a1, 13) ^ GfMul(a2, 9) ^ GfMul(a3, 14);
+        }
+    }
+
+    for (i = 0; i < NVAES_STATECOLS * (NVAES_ROUNDS + 1); i++)
+    {
+        pSchedule->EncWords[i] = AES_GETU32(pSchedule->EncKey + 4 * i);
+        pSchedule->DecWords[i] = AES_GETU32(pSchedule->DecKey + 4 * i);
+    }
+
+    // every block of the bitsliced state gets the same round key
+    for (round = 0; round <= NVAES_ROUNDS; round++)
+    {
+        NvU64 *sk = pSchedule->SliceKey + 8 * round;
+        const NvU8 *ek = pSchedule->EncKey + round * NVAES_BLOCK_BYTES;
+
+        for (b = 0; b < 8; b++)
+        {
+            sk[b] = 0;
+            for (i = 0; i < NVAES_BLOCK_BYTES; i++)
+                if ((ek[i] >> b) & 1)
+                    sk[b] |= 0xFULL << (4 * i);
+        }
+    }
+}
+
+void
+NvAesEcbEncrypt(const NvAesKeySchedule *pSchedule,
+                const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks)
+{
+    s_EncryptBlocks[NvAesGetBackend()](pSchedule, pSrc, pDst, NumBlocks);
+}
+
+void
+NvAesEcbDecrypt(const NvAesKeySchedule *pSchedule,
+                const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks)
+{
+    s_DecryptBlocks[NvAesGetBackend()](pSchedule, pSrc, pDst, NumBlocks);
+}
+
+void
+NvAesCbcEncrypt(const NvAesKeySchedule *pSchedule, NvU8 *pIv,
+                const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks)
+{
+    AesBlocksFunc Encrypt = s_EncryptBlocks[NvAesGetBackend()];
+    NvU8 block[NVAES_BLOCK_BYTES];
+    NvU32 i;
+
+    // each block depends on the previous one
+    for (; NumBlocks--; pSrc += NVAES_BLOCK_BYTES, pDst += NVAES_BLOCK_BYTES)
+    {
+        for (i = 0; i < NVAES_BLOCK_BYTES; i++)
+            block[i] = pSrc[i] ^ pIv[i];
+        Encrypt(pSchedule, block, pDst, 1);
+        NvOsMemcpy(pIv, pDst, NVAES_BLOCK_BYTES);
+    }
+}
+
+void
+NvAesCbcDecrypt(const NvAesKeySchedule *pSchedule, NvU8 *pIv,
+                const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks)
+{
+    AesBlocksFunc Decrypt = s_DecryptBlocks[NvAesGetBackend()];
+    NvU8 cipher[AES_CHUNK_BLOCKS * NVAES_BLOCK_BYTES];
+    NvU32 n, i;
+
+    for (; NumBlocks; NumBlocks -= n)
+    {
+        n = (NumBlocks < AES_CHUNK_BLOCKS) ? NumBlocks : AES_CHUNK_BLOCKS;
+
+        // keep the ciphertext, which may be overwritten, for the chaining
+        NvOsMemcpy(cipher, pSrc, n * NVAES_BLOCK_BYTES);
+        Decrypt(pSchedule, cipher, pDst, n);
+
+        for (i = 0; i < NVAES_BLOCK_BYTES; i++)
+            pDst[i] ^= pIv[i];
+        for (i = NVAES_BLOCK_BYTES; i < n * NVAES_BLOCK_BYTES; i++)
+            pDst[i] ^= cipher[i - NVAES_BLOCK_BYTES];
+        NvOsMemcpy(pIv, cipher + (n - 1) * NVAES_BLOCK_BYTES,
+                   NVAES_BLOCK_BYTES);
+
+        pSrc += n * NVAES_BLOCK_BYTES;
+        pDst += n * NVAES_BLOCK_BYTES;
+    }
+}
+
+void
+NvAesCtrCrypt(const NvAesKeySchedule *pSchedule, NvU8 *pCounter,
+              const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks)
+{
+    AesBlocksFunc Encrypt = s_EncryptBlocks[NvAesGetBackend()];
+    NvU8 stream[AES_CHUNK_BLOCKS * NVAES_BLOCK_BYTES];
+    NvU32 n, i;
+    int j;
+
+    for (; NumBlocks; NumBlocks -= n)
+    {
+        n = (NumBlocks < AES_CHUNK_BLOCKS) ? NumBlocks : AES_CHUNK_BLOCKS;
+
+        for (i = 0; i < n; i++)
+        {
+            NvOsMemcpy(stream + i * NVAES_BLOCK_BYTES, pCounter,
+                       NVAES_BLOCK_BYTES);
+            for (j = NVAES_BLOCK_BYTES - 1; j >= 0; j--)
+                if (++pCounter[j])
+                    break;
+        }
+        Encrypt(pSchedule, stream, stream, n);
+
+        for (i = 0; i < n * NVAES_BLOCK_BYTES; i++)
+            pDst[i] = pSrc[i] ^ stream[i];
+
+        pSrc += n * NVAES_BLOCK_BYTES;
+        pDst += n * NVAES_BLOCK_BYTES;
+    }
+}
@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+/*
+ * AES known answer and throughput test.
+ *
+ * Each implementation supported here is checked against the FIPS-197
+ * example and the SP 800-38A AES-128 ECB, CBC and CTR vectors, then against
+ * NvAesEncrypt() and NvAesDecrypt() over random buffers of 1 to 40 blocks,
+ * split across two calls and processed in place. The throughput of each
+ * mode is printed for each implementation.
+ *
+ * usage: aes_blocks_test [megabytes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvos.h"
+#include "nvaes_ref.h"
+
+#define TEST_DEFAULT_MB     16
+#define TEST_MAX_BLOCKS     40
+
+static const char *s_BackendNames[NvAesBackend_Num] =
+{
+    "auto", "reference", "ttable", "bitsliced", "aesni", "armv8ce"
+};
+
+// FIPS-197 appendix C.1
+static const NvU8 s_FipsKey[16] =
+{
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+static const NvU8 s_FipsPlain[16] =
+{
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+};
+static const NvU8 s_FipsCipher[16] =
+{
+    0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+    0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a
+};
+
+// SP 800-38A appendix F, AES-128
+static const NvU8 s_SpKey[16] =
+{
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+static const NvU8 s_SpPlain[64] =
+{
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+    0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
+    0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11,
+    0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17,
+    0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+};
+static const NvU8 s_SpEcb[64] =
+{
+    0x3a, 0xd7, 0x7b, 0xb4, 0x0d, 0x7a, 0x36, 0x60,
+    0xa8, 0x9e, 0xca, 0xf3, 0x24, 0x66, 0xef, 0x97,
+    0xf5, 0xd3, 0xd5, 0x85, 0x03, 0xb9, 0x69, 0x9d,
+    0xe7, 0x85, 0x89, 0x5a, 0x96, 0xfd, 0xba, 0xaf,
+    0x43, 0xb1, 0xcd, 0x7f, 0x59, 0x8e, 0xce, 0x23,
+    0x88, 0x1b, 0x00, 0xe3, 0xed, 0x03, 0x06, 0x88,
+    0x7b, 0x0c, 0x78, 0x5e, 0x27, 0xe8, 0xad, 0x3f,
+    0x82, 0x23, 0x20, 0x71, 0x04, 0x72, 0x5d, 0xd4
+};
+static const NvU8 s_SpCbcIv[16] =
+{
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+static const NvU8 s_SpCbc[64] =
+{
+    0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46,
+    0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d,
+    0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72, 0x19, 0xee,
+    0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2,
+    0x73, 0xbe, 0xd6, 0xb8, 0xe3, 0xc1, 0x74, 0x3b,
+    0x71, 0x16, 0xe6, 0x9e, 0x22, 0x22, 0x95, 0x16,
+    0x3f, 0xf1, 0xca, 0xa1, 0x68, 0x1f, 0xac, 0x09,
+    0x12, 0x0e, 0xca, 0x30, 0x75, 0x86, 0xe1, 0xa7
+};
+static const NvU8 s_SpCtrCounter[16] =
+{
+    0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+    0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+};
+static const NvU8 s_SpCtr[64] =
+{
+    0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26,
+    0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+    0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff,
+    0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+    0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e,
+    0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+    0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1,
+    0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee
+};
+
+static NvU32 s_Seed = 12345;
+
+static NvU8
+TestRandom(void)
+{
+    s_Seed = s_Seed * 1664525 + 1013904223;
+    return (NvU8)(s_Seed >> 24);
+}
+
+static NvBool
+Check(const char *what, const NvU8 *got, const NvU8 *expected, NvU32 size)
+{
+    if (!memcmp(got, expected, size))
+        return NV_TRUE;
+    printf("  %s mismatch\n", what);
+    return NV_FALSE;
+}
+
+static NvBool
+CheckKnownAnswers(void)
+{
+    NvAesKeySchedule ks;
+    NvU8 buf[64], iv[16];
+    NvBool ok = NV_TRUE;
+
+    NvAesSetKey(&ks, s_FipsKey);
+    NvAesEcbEncrypt(&ks, s_FipsPlain, buf, 1);
+    ok &= Check("FIPS-197 encrypt", buf, s_FipsCipher, 16);
+    NvAesEcbDecrypt(&ks, buf, buf, 1);
+    ok &= Check("FIPS-197 decrypt", buf, s_FipsPlain, 16);
+
+    NvAesSetKey(&ks, s_SpKey);
+    NvAesEcbEncrypt(&ks, s_SpPlain, buf, 4);
+    ok &= Check("ECB encrypt", buf, s_SpEcb, 64);
+    NvAesEcbDecrypt(&ks, s_SpEcb, buf, 4);
+    ok &= Check("ECB decrypt", buf, s_SpPlain, 64);
+
+    memcpy(iv, s_SpCbcIv, 16);
+    NvAesCbcEncrypt(&ks, iv, s_SpPlain, buf, 4);
+    ok &= Check("CBC encrypt", buf, s_SpCbc, 64);
+    memcpy(iv, s_SpCbcIv, 16);
+    NvAesCbcDecrypt(&ks, iv, s_SpCbc, buf, 4);
+    ok &= Check("CBC decrypt", buf, s_SpPlain, 64);
+
+    memcpy(iv, s_SpCtrCounter, 16);
+    NvAesCtrCrypt(&ks, iv, s_SpPlain, buf, 4);
+    ok &= Check("CTR encrypt", buf, s_SpCtr, 64);
+    memcpy(iv, s_SpCtrCounter, 16);
+    NvAesCtrCrypt(&ks, iv, s_SpCtr, buf, 4);
+    ok &= Check("CTR decrypt", buf, s_SpPlain, 64);
+
+    return ok;
+}
+
+// NvAesEncrypt() and NvAesDecrypt() in the same modes, one block at a time
+static void
+RefModes(const NvAesKeySchedule *ks, const NvU8 *iv, const NvU8 *src,
+         NvU32 blocks, NvU8 *ecbEnc, NvU8 *ecbDec, NvU8 *cbcEnc, NvU8 *cbcDec,
+         NvU8 *ctr)
+{
+    NvU8 in[16], chain[16], count[16], stream[16];
+    NvU32 b, i;
+    int j;
+
+    memcpy(chain, iv, 16);
+    memcpy(count, iv, 16);
+    for (b = 0; b < blocks; b++, src += 16)
+    {
+        memcpy(in, src, 16);
+        NvAesEncrypt(in, (NvU8 *)ks->EncKey, ecbEnc + 16 * b);
+        memcpy(in, src, 16);
+        NvAesDecrypt(in, (NvU8 *)ks->EncKey, ecbDec + 16 * b);
+
+        for (i = 0; i < 16; i++)
+            in[i] = src[i] ^ chain[i];
+        NvAesEncrypt(in, (NvU8 *)ks->EncKey, chain);
+        memcpy(cbcEnc + 16 * b, chain, 16);
+
+        for (i = 0; i < 16; i++)
+            cbcDec[16 * b + i] = ecbDec[16 * b + i] ^
+                (b ? (src - 16)[i] : iv[i]);
+
+        NvAesEncrypt(count, (NvU8 *)ks->EncKey, stream);
+        for (i = 0; i < 16; i++)
+            ctr[16 * b + i] = src[i] ^ stream[i];
+        for (j = 15; j >= 0; j--)
+            if (++count[j])
+                break;
+    }
+}
+
+static NvBool
+CheckAgainstReference(void)
+{
+    NvAesKeySchedule ks;
+    NvU8 key[16], iv[16], chain[16];
+    NvU8 src[TEST_MAX_BLOCKS * 16], buf[TEST_MAX_BLOCKS * 16];
+    NvU8 ecbEnc[TEST_MAX_BLOCKS * 16], ecbDec[TEST_MAX_BLOCKS * 16];
+    NvU8 cbcEnc[TEST_MAX_BLOCKS * 16], cbcDec[TEST_MAX_BLOCKS * 16];
+    NvU8 ctr[TEST_MAX_BLOCKS * 16];
+    NvU32 blocks, split, i;
+    NvBool ok = NV_TRUE;
+
+    for (blocks = 1; blocks <= TEST_MAX_BLOCKS && ok; blocks++)
+    {
+        for (i = 0; i < 16; i++)
+        {
+            key[i] = TestRandom();
+            iv[i] = TestRandom();
+        }
+        // exercise the carry out of the low counter bytes
+        iv[15] = 0xfe;
+        iv[14] = 0xff;
+        for (i = 0; i < blocks * 16; i++)
+            src[i] = TestRandom();
+        split = TestRandom() % blocks;
+
+        NvAesSetKey(&ks, key);
+        RefModes(&ks, iv, src, blocks, ecbEnc, ecbDec, cbcEnc, cbcDec, ctr);
+
+        memcpy(buf, src, blocks * 16);
+        NvAesEcbEncrypt(&ks, buf, buf, split);
+        NvAesEcbEncrypt(&ks, buf + split * 16, buf + split * 16,
+                        blocks - split);
+        ok &= Check("ECB encrypt", buf, ecbEnc, blocks * 16);
+
+        memcpy(buf, src, blocks * 16);
+        NvAesEcbDecrypt(&ks, buf, buf, blocks);
+        ok &= Check("ECB decrypt", buf, ecbDec, blocks * 16);
+
+        memcpy(buf, src, blocks * 16);
+        memcpy(chain, iv, 16);
+        NvAesCbcEncrypt(&ks, chain, buf, buf, split);
+        NvAesCbcEncrypt(&ks, chain, buf + split * 16, buf + split * 16,
+                        blocks - split);
+        ok &= Check("CBC encrypt", buf, cbcEnc, blocks * 16);
+
+        memcpy(buf, src, blocks * 16);
+        memcpy(chain, iv, 16);
+        NvAesCbcDecrypt(&ks, chain, buf, buf, split);
+        NvAesCbcDecrypt(&ks, chain, buf + split * 16, buf + split * 16,
+                        blocks - split);
+        ok &= Check("CBC decrypt", buf, cbcDec, blocks * 16);
+
+        memcpy(buf, src, blocks * 16);
+        memcpy(chain, iv, 16);
+        NvAesCtrCrypt(&ks, chain, buf, buf, split);
+        NvAesCtrCrypt(&ks, chain, buf + split * 16, buf + split * 16,
+                      blocks - split);
+        ok &= Check("CTR", buf, ctr, blocks * 16);
+    }
+
+    return ok;
+}
+
+static double
+TestMBs(NvU64 bytes, NvU64 us)
+{
+    return us ? (double)bytes / us : 0.0;
+}
+
+static void
+Throughput(NvU8 *buf, NvU32 size)
+{
+    NvAesKeySchedule ks;
+    NvU8 iv[16];
+    NvU32 blocks = size / 16;
+    NvU64 start, ecbEnc, ecbDec, cbcEnc, cbcDec, ctr;
+
+    memset(iv, 0, sizeof(iv));
+    NvAesSetKey(&ks, s_SpKey);
+
+    start = NvOsGetTimeUS();
+    NvAesEcbEncrypt(&ks, buf, buf, blocks);
+    ecbEnc = NvOsGetTimeUS() - start;
+
+    start = NvOsGetTimeUS();
+    NvAesEcbDecrypt(&ks, buf, buf, blocks);
+    ecbDec = NvOsGetTimeUS() - start;
+
+    start = NvOsGetTimeUS();
+    NvAesCbcEncrypt(&ks, iv, buf, buf, blocks);
+    cbcEnc = NvOsGetTimeUS() - start;
+
+    start = NvOsGetTimeUS();
+    NvAesCbcDecrypt(&ks, iv, buf, buf, blocks);
+    cbcDec = NvOsGetTimeUS() - start;
+
+    start = NvOsGetTimeUS();
+    NvAesCtrCrypt(&ks, iv, buf, buf, blocks);
+    ctr = NvOsGetTimeUS() - start;
+
+    printf("  MB/s: ECB enc %7.1f dec %7.1f  CBC enc %7.1f dec %7.1f  "
+           "CTR %7.1f\n", TestMBs(size, ecbEnc), TestMBs(size, ecbDec),
+           TestMBs(size, cbcEnc), TestMBs(size, cbcDec), TestMBs(size, ctr));
+}
+
+int
+main(int argc, char **argv)
+{
+    NvU32 mb = TEST_DEFAULT_MB;
+    NvAesBackend backend, best;
+    NvBool ok = NV_TRUE;
+    NvU32 size, i;
+    NvU8 *buf;
+
+    if (argc > 1)
+    {
+        mb = strtoul(argv[1], NULL, 0);
+        if (!mb || mb > 1024)
+        {
+            printf("usage: %s [megabytes]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    size = mb * 1024 * 1024;
+    buf = malloc(size);
+    if (!buf)
+    {
+        printf("cannot allocate %u MB\n", mb);
+        return 1;
+    }
+    for (i = 0; i < size; i++)
+        buf[i] = TestRandom();
+
+    best = NvAesGetBackend();
+    printf("default implementation: %s\n", s_BackendNames[best]);
+
+    for (backend = NvAesBackend_Reference; backend < NvAesBackend_Num;
+         backend++)
+    {
+        if (!NvAesSelectBackend(backend))
+        {
+            printf("%s: not supported\n", s_BackendNames[backend]);
+            continue;
+        }
+
+        printf("%s:\n", s_BackendNames[backend]);
+        if (!CheckKnownAnswers() || !CheckAgainstReference())
+        {
+            printf("  FAILED\n");
+            ok = NV_FALSE;
+            continue;
+        }
+        Throughput(buf, size);
+    }
+
+    NvAesSelectBackend(best);
+    free(buf);
+    printf(ok ? "PASSED\n" : "FAILED\n");
+    return ok ? 0 : 1;
+}
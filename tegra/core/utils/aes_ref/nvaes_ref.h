@@ -26,6 +26,58 @@ void NvAesExpandKey(NvU8 *key, NvU8 *expkey);
 void NvAesEncrypt  (NvU8 *in,  NvU8 *expkey, NvU8 *out);
 void NvAesDecrypt  (NvU8 *in,  NvU8 *expkey, NvU8 *out);
 
+#define NVAES_BLOCK_BYTES       16
+#define NVAES_EXPKEY_BYTES      (NVAES_STATECOLS * 4 * (NVAES_ROUNDS + 1))
+
+// Implementations of the multi-block functions below
+typedef enum
+{
+    NvAesBackend_Auto = 0,      // fastest one supported by the CPU
+    NvAesBackend_Reference,     // NvAesEncrypt() and NvAesDecrypt()
+    NvAesBackend_TTable,        // 32-bit table lookups, four per column
+    NvAesBackend_Bitsliced,     // constant time, four blocks at once
+    NvAesBackend_AesNi,         // x86 AES instructions, if the CPU has them
+    NvAesBackend_Armv8Ce,       // ARMv8 crypto extensions, if compiled in
+    NvAesBackend_Num,
+    NvAesBackend_Force32 = 0x7FFFFFFF
+} NvAesBackend;
+
+// Key expanded once for all the implementations
+typedef struct NvAesKeyScheduleRec
+{
+    // round keys as produced by NvAesExpandKey()
+    NvU8  EncKey[NVAES_EXPKEY_BYTES];
+    // round keys of the equivalent inverse cipher, in decryption order
+    NvU8  DecKey[NVAES_EXPKEY_BYTES];
+    // the same as most significant byte first words
+    NvU32 EncWords[NVAES_STATECOLS * (NVAES_ROUNDS + 1)];
+    NvU32 DecWords[NVAES_STATECOLS * (NVAES_ROUNDS + 1)];
+    // EncKey spread over the eight bit planes of the bitsliced state
+    NvU64 SliceKey[8 * (NVAES_ROUNDS + 1)];
+} NvAesKeySchedule;
+
+// Returns NV_FALSE if Backend is not supported by this build or CPU. All
+// implementations give the same results; the fastest is used by default.
+NvBool       NvAesSelectBackend(NvAesBackend Backend);
+NvAesBackend NvAesGetBackend   (void);
+
+void NvAesSetKey(NvAesKeySchedule *pSchedule, const NvU8 *pKey);
+
+// The following process NumBlocks blocks of NVAES_BLOCK_BYTES, independent
+// blocks several at a time. pSrc and pDst may be the same buffer. pIv and
+// pCounter are updated to continue the chain in the next call; the counter
+// is incremented as a 128-bit big-endian number.
+void NvAesEcbEncrypt(const NvAesKeySchedule *pSchedule,
+                     const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks);
+void NvAesEcbDecrypt(const NvAesKeySchedule *pSchedule,
+                     const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks);
+void NvAesCbcEncrypt(const NvAesKeySchedule *pSchedule, NvU8 *pIv,
+                     const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks);
+void NvAesCbcDecrypt(const NvAesKeySchedule *pSchedule, NvU8 *pIv,
+                     const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks);
+void NvAesCtrCrypt  (const NvAesKeySchedule *pSchedule, NvU8 *pCounter,
+                     const NvU8 *pSrc, NvU8 *pDst, NvU32 NumBlocks);
+
 #if defined(__cplusplus)
 }
 #endif
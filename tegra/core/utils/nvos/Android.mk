@@ -1,5 +1,5 @@
 #
-# Copyright (c) 2012-2013, NVIDIA CORPORATION.  All rights reserved.
+# Copyright (c) 2012-2014, NVIDIA CORPORATION.  All rights reserved.
 #
 # NVIDIA Corporation and its licensors retain all intellectual property
 # and proprietary rights in and to this software, related documentation
@@ -37,10 +37,16 @@ LOCAL_CFLAGS += -DBUILD_FOR_COSIM
 endif
 
 LOCAL_CFLAGS += -DUNIFIED_SCALING=1
+# Build NvOsMutex, NvOsCondition and NvOsSemaphore on futexes
+#LOCAL_CFLAGS += -DNVOS_USE_FUTEX=1
+# Account NvOsAlloc memory per call site, see nvos_heap_profile.h
+#LOCAL_CFLAGS += -DNVOS_HEAP_PROFILE=1
 
 LOCAL_SRC_FILES += $(COMMON_SRC_FILES)
 LOCAL_SRC_FILES += nvos_config.c
 LOCAL_SRC_FILES += linux/nvos_linux.c
+LOCAL_SRC_FILES += linux/nvos_linux_futex.c
+LOCAL_SRC_FILES += linux/nvos_linux_heap_profile.c
 LOCAL_SRC_FILES += linux/nvos_linux_librt.c
 LOCAL_SRC_FILES += linux/nvos_linux_stub.c
 LOCAL_SRC_FILES += linux/nvos_linux_user.c
@@ -75,6 +81,8 @@ LOCAL_CFLAGS += -UANDROID
 LOCAL_SRC_FILES += $(COMMON_SRC_FILES)
 LOCAL_SRC_FILES += nvos_config.c
 LOCAL_SRC_FILES += linux/nvos_linux.c
+LOCAL_SRC_FILES += linux/nvos_linux_futex.c
+LOCAL_SRC_FILES += linux/nvos_linux_heap_profile.c
 LOCAL_SRC_FILES += linux/nvos_linux_librt.c
 LOCAL_SRC_FILES += linux/nvos_linux_host_stub.c
 LOCAL_SRC_FILES += linux/nvos_linux_user.c
@@ -85,6 +93,34 @@ LOCAL_WHOLE_STATIC_LIBRARIES += libnvosutils
 
 include $(NVIDIA_HOST_STATIC_LIBRARY)
 
+# lock contention benchmark
+
+include $(NVIDIA_DEFAULTS)
+
+LOCAL_MODULE := nvos_futex_bench
+LOCAL_MODULE_TAGS := nvidia_tests
+LOCAL_ARM_MODE := arm
+
+LOCAL_SRC_FILES := linux/nvos_futex_bench.c
+
+LOCAL_SHARED_LIBRARIES += libnvos
+
+include $(NVIDIA_EXECUTABLE)
+
+# heap profiler overhead benchmark
+
+include $(NVIDIA_DEFAULTS)
+
+LOCAL_MODULE := nvos_heap_profile_bench
+LOCAL_MODULE_TAGS := nvidia_tests
+LOCAL_ARM_MODE := arm
+
+LOCAL_SRC_FILES := linux/nvos_heap_profile_bench.c
+
+LOCAL_SHARED_LIBRARIES += libnvos
+
+include $(NVIDIA_EXECUTABLE)
+
 # bootloader libgcc implementation
 
 include $(NVIDIA_DEFAULTS)
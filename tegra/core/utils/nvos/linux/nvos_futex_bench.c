@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+/*
+ * Lock contention microbenchmark.
+ *
+ * 1 to 8 threads increment a shared counter under a lock, doing a little
+ * work inside and outside the critical section, with a pthread mutex, an
+ * NvOsMutex (futex or pthread based depending on how libnvos was built) and
+ * an embedded NvOsFutexMutex with and without spinning. A second test
+ * bounces between two threads through a pair of semaphores. The contended
+ * lock sites are dumped at the end.
+ *
+ * usage: nvos_futex_bench [iterations]
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "nvos.h"
+#include "nvos_futex.h"
+
+#define BENCH_DEFAULT_ITERATIONS    200000
+#define BENCH_MAX_THREADS           8
+#define BENCH_INNER_WORK            16
+#define BENCH_OUTER_WORK            64
+
+typedef enum
+{
+    BenchLock_Pthread,
+    BenchLock_NvOsMutex,
+    BenchLock_Futex,
+    BenchLock_FutexNoSpin,
+    BenchLock_Num
+} BenchLock;
+
+static const char *s_LockNames[BenchLock_Num] =
+{
+    "pthread", "NvOsMutex", "futex", "futex-nospin"
+};
+
+typedef struct BenchContextRec
+{
+    BenchLock Lock;
+    NvU32 Iterations;
+    pthread_mutex_t Pthread;
+    NvOsMutexHandle NvOsMutex;
+    NvOsFutexMutex Futex;
+    volatile NvU32 Counter;
+    NvOsFutexSemaphore Start;
+} BenchContext;
+
+static volatile NvU32 s_Sink;
+
+static void BenchWork(NvU32 n)
+{
+    NvU32 i, v = s_Sink;
+
+    for (i = 0; i < n; i++)
+        v = v * 1664525 + 1013904223;
+    s_Sink = v;
+}
+
+static void BenchLockThread(void *arg)
+{
+    BenchContext *ctx = arg;
+    NvU32 i;
+
+    NvOsFutexSemaphoreWait(&ctx->Start);
+
+    for (i = 0; i < ctx->Iterations; i++)
+    {
+        switch (ctx->Lock)
+        {
+            case BenchLock_Pthread:
+                pthread_mutex_lock(&ctx->Pthread);
+                ctx->Counter++;
+                BenchWork(BENCH_INNER_WORK);
+                pthread_mutex_unlock(&ctx->Pthread);
+                break;
+            case BenchLock_NvOsMutex:
+                NvOsMutexLock(ctx->NvOsMutex);
+                ctx->Counter++;
+                BenchWork(BENCH_INNER_WORK);
+                NvOsMutexUnlock(ctx->NvOsMutex);
+                break;
+            default:
+                NvOsFutexMutexLock(&ctx->Futex);
+                ctx->Counter++;
+                BenchWork(BENCH_INNER_WORK);
+                NvOsFutexMutexUnlock(&ctx->Futex);
+                break;
+        }
+        BenchWork(BENCH_OUTER_WORK);
+    }
+}
+
+static NvBool BenchLocks(NvU32 threads, NvU32 iterations)
+{
+    NvOsThreadHandle handles[BENCH_MAX_THREADS];
+    BenchContext ctx;
+    NvBool ok = NV_TRUE;
+    NvU32 lock, t;
+
+    for (lock = 0; lock < BenchLock_Num; lock++)
+    {
+        NvU64 start, elapsed;
+
+        NvOsMemset(&ctx, 0, sizeof(ctx));
+        ctx.Lock = (BenchLock)lock;
+        ctx.Iterations = iterations;
+        pthread_mutex_init(&ctx.Pthread, NULL);
+        if (NvOsMutexCreate(&ctx.NvOsMutex) != NvSuccess)
+            return NV_FALSE;
+        NvOsFutexMutexInit(&ctx.Futex, lock == BenchLock_FutexNoSpin ?
+            0 : NVOS_FUTEX_SPIN_DEFAULT);
+        NvOsFutexSemaphoreInit(&ctx.Start, 0);
+
+        for (t = 0; t < threads; t++)
+        {
+            if (NvOsThreadCreate(BenchLockThread, &ctx, &handles[t]) !=
+                NvSuccess)
+                return NV_FALSE;
+        }
+
+        start = NvOsGetTimeUS();
+        for (t = 0; t < threads; t++)
+            NvOsFutexSemaphoreSignal(&ctx.Start);
+        for (t = 0; t < threads; t++)
+            NvOsThreadJoin(handles[t]);
+        elapsed = NvOsGetTimeUS() - start;
+
+        printf("%u threads %-12s: %8.1f ns/lock%s\n", threads,
+            s_LockNames[lock],
+            elapsed * 1000.0 / ((NvU64)threads * iterations),
+            ctx.Counter == threads * iterations ? "" : "  COUNT MISMATCH");
+        if (ctx.Counter != threads * iterations)
+            ok = NV_FALSE;
+
+        NvOsMutexDestroy(ctx.NvOsMutex);
+        pthread_mutex_destroy(&ctx.Pthread);
+    }
+
+    return ok;
+}
+
+typedef struct BenchPingPongRec
+{
+    NvU32 Iterations;
+    NvOsSemaphoreHandle Ping, Pong;
+    NvOsFutexSemaphore FutexPing, FutexPong;
+    NvBool UseFutex;
+} BenchPingPong;
+
+static void BenchPongThread(void *arg)
+{
+    BenchPingPong *pp = arg;
+    NvU32 i;
+
+    for (i = 0; i < pp->Iterations; i++)
+    {
+        if (pp->UseFutex)
+        {
+            NvOsFutexSemaphoreWait(&pp->FutexPing);
+            NvOsFutexSemaphoreSignal(&pp->FutexPong);
+        }
+        else
+        {
+            NvOsSemaphoreWait(pp->Ping);
+            NvOsSemaphoreSignal(pp->Pong);
+        }
+    }
+}
+
+static NvBool BenchSemaphores(NvU32 iterations)
+{
+    BenchPingPong pp;
+    NvOsThreadHandle thread;
+    NvU32 pass, i;
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        NvU64 start, elapsed;
+
+        NvOsMemset(&pp, 0, sizeof(pp));
+        pp.Iterations = iterations / 4;
+        pp.UseFutex = pass ? NV_TRUE : NV_FALSE;
+        if (NvOsSemaphoreCreate(&pp.Ping, 0) != NvSuccess ||
+            NvOsSemaphoreCreate(&pp.Pong, 0) != NvSuccess)
+            return NV_FALSE;
+        NvOsFutexSemaphoreInit(&pp.FutexPing, 0);
+        NvOsFutexSemaphoreInit(&pp.FutexPong, 0);
+
+        if (NvOsThreadCreate(BenchPongThread, &pp, &thread) != NvSuccess)
+            return NV_FALSE;
+
+        start = NvOsGetTimeUS();
+        for (i = 0; i < pp.Iterations; i++)
+        {
+            if (pp.UseFutex)
+            {
+                NvOsFutexSemaphoreSignal(&pp.FutexPing);
+                NvOsFutexSemaphoreWait(&pp.FutexPong);
+            }
+            else
+            {
+                NvOsSemaphoreSignal(pp.Ping);
+                NvOsSemaphoreWait(pp.Pong);
+            }
+        }
+        elapsed = NvOsGetTimeUS() - start;
+        NvOsThreadJoin(thread);
+
+        printf("semaphore ping-pong %-14s: %8.1f us/round trip\n",
+            pp.UseFutex ? "NvOsFutex" : "NvOsSemaphore",
+            (double)elapsed / pp.Iterations);
+
+        NvOsSemaphoreDestroy(pp.Ping);
+        NvOsSemaphoreDestroy(pp.Pong);
+    }
+
+    /* A timed wait on an empty semaphore must time out */
+    NvOsFutexSemaphoreInit(&pp.FutexPing, 0);
+    if (NvOsFutexSemaphoreWaitTimeout(&pp.FutexPing, 10) != NvError_Timeout)
+    {
+        printf("semaphore timeout FAILED\n");
+        return NV_FALSE;
+    }
+
+    return NV_TRUE;
+}
+
+int main(int argc, char **argv)
+{
+    NvU32 iterations = BENCH_DEFAULT_ITERATIONS;
+    NvBool ok = NV_TRUE;
+    NvU32 threads;
+
+    if (argc > 1)
+        iterations = strtoul(argv[1], NULL, 0);
+    if (!iterations)
+    {
+        printf("usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    for (threads = 1; threads <= BENCH_MAX_THREADS; threads *= 2)
+        ok &= BenchLocks(threads, iterations);
+
+    ok &= BenchSemaphores(iterations);
+
+    NvOsFutexDumpContention();
+
+    printf(ok ? "PASSED\n" : "FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+/*
+ * Heap profiler check and overhead benchmark.
+ *
+ * First checks that the live, peak and total counts of a site follow a
+ * known sequence of allocations, reallocations and frees. Then 1 to 4
+ * threads churn through allocations of mixed sizes from eight call sites,
+ * keeping a window of them live, with NvOsAlloc and with malloc for
+ * reference, and the profile is dumped at the end.
+ *
+ * The cost of NvOsAlloc over malloc is printed for each thread count; with
+ * a profiling libnvos this is the overhead of the profiler and the guard
+ * bands it relies on.
+ *
+ * usage: nvos_heap_profile_bench [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "nvos.h"
+#include "nvos_heap_profile.h"
+
+#define BENCH_DEFAULT_ITERATIONS    500000
+#define BENCH_MAX_THREADS           4
+#define BENCH_WINDOW                64
+#define BENCH_CHECK_BLOCKS          100
+#define BENCH_CHECK_SIZE            100
+
+typedef struct BenchContextRec
+{
+    NvBool UseMalloc;
+    NvU32 Iterations;
+    NvU32 Seed;
+} BenchContext;
+
+#define BENCH_ALLOC(ctx, size) \
+    ((ctx)->UseMalloc ? malloc(size) : NvOsAlloc(size))
+
+static void BenchThread(void *arg)
+{
+    BenchContext *ctx = arg;
+    void *live[BENCH_WINDOW] = { NULL };
+    NvU32 seed = ctx->Seed;
+    NvU32 i, slot;
+
+    for (i = 0; i < ctx->Iterations; i++)
+    {
+        size_t size;
+        void *p = NULL;
+
+        seed = seed * 1664525 + 1013904223;
+        slot = (seed >> 8) % BENCH_WINDOW;
+        size = 16 + ((seed >> 16) & 1023);
+
+        if (ctx->UseMalloc)
+            free(live[slot]);
+        else
+            NvOsFree(live[slot]);
+
+        /* Separate calls with different sizes, so that the compiler keeps
+         * one call instruction, and so one site, for each */
+        switch (seed >> 29)
+        {
+            case 0: p = BENCH_ALLOC(ctx, size); break;
+            case 1: p = BENCH_ALLOC(ctx, size + 8); break;
+            case 2: p = BENCH_ALLOC(ctx, size + 16); break;
+            case 3: p = BENCH_ALLOC(ctx, size + 24); break;
+            case 4: p = BENCH_ALLOC(ctx, size + 32); break;
+            case 5: p = BENCH_ALLOC(ctx, size + 40); break;
+            case 6: p = BENCH_ALLOC(ctx, size + 48); break;
+            default: p = BENCH_ALLOC(ctx, size + 56); break;
+        }
+        live[slot] = p;
+    }
+
+    for (slot = 0; slot < BENCH_WINDOW; slot++)
+    {
+        if (ctx->UseMalloc)
+            free(live[slot]);
+        else
+            NvOsFree(live[slot]);
+    }
+}
+
+static double BenchRun(NvU32 threads, NvU32 iterations, NvBool useMalloc)
+{
+    NvOsThreadHandle handles[BENCH_MAX_THREADS];
+    BenchContext ctx[BENCH_MAX_THREADS];
+    NvU64 start, elapsed;
+    NvU32 t;
+
+    start = NvOsGetTimeUS();
+    for (t = 0; t < threads; t++)
+    {
+        ctx[t].UseMalloc = useMalloc;
+        ctx[t].Iterations = iterations;
+        ctx[t].Seed = t * 7919 + 1;
+        if (NvOsThreadCreate(BenchThread, &ctx[t], &handles[t]) != NvSuccess)
+            return 0.0;
+    }
+    for (t = 0; t < threads; t++)
+        NvOsThreadJoin(handles[t]);
+    elapsed = NvOsGetTimeUS() - start;
+
+    return elapsed * 1000.0 / ((NvU64)threads * iterations);
+}
+
+static NvBool BenchFindSite(NvU32 liveAllocs, NvOsHeapSite *found)
+{
+    NvOsHeapSite sites[64];
+    NvU32 i, count;
+
+    count = NvOsHeapProfileGetSites(sites, 64);
+    for (i = 0; i < count; i++)
+    {
+        if (sites[i].LiveAllocs == liveAllocs &&
+            sites[i].TotalAllocs == BENCH_CHECK_BLOCKS)
+        {
+            *found = sites[i];
+            return NV_TRUE;
+        }
+    }
+
+    return NV_FALSE;
+}
+
+static NvBool BenchCheck(void)
+{
+    void *blocks[BENCH_CHECK_BLOCKS];
+    NvOsHeapSite site;
+    NvBool ok = NV_TRUE;
+    NvU32 i;
+
+    NvOsHeapProfileReset();
+
+    for (i = 0; i < BENCH_CHECK_BLOCKS; i++)
+    {
+        blocks[i] = NvOsAlloc(BENCH_CHECK_SIZE);
+        if (!blocks[i])
+            return NV_FALSE;
+    }
+    if (!BenchFindSite(BENCH_CHECK_BLOCKS, &site) ||
+        site.LiveBytes != BENCH_CHECK_BLOCKS * BENCH_CHECK_SIZE ||
+        site.PeakBytes != BENCH_CHECK_BLOCKS * BENCH_CHECK_SIZE ||
+        site.TotalBytes != BENCH_CHECK_BLOCKS * BENCH_CHECK_SIZE)
+    {
+        printf("live counts after allocation FAILED\n");
+        ok = NV_FALSE;
+    }
+
+    /* Freeing half leaves the peak where it was */
+    for (i = 0; i < BENCH_CHECK_BLOCKS / 2; i++)
+        NvOsFree(blocks[i]);
+    if (!BenchFindSite(BENCH_CHECK_BLOCKS / 2, &site) ||
+        site.LiveBytes != BENCH_CHECK_BLOCKS / 2 * BENCH_CHECK_SIZE ||
+        site.PeakBytes != BENCH_CHECK_BLOCKS * BENCH_CHECK_SIZE)
+    {
+        printf("live counts after free FAILED\n");
+        ok = NV_FALSE;
+    }
+
+    /* A realloc moves the block to the site of the realloc */
+    blocks[BENCH_CHECK_BLOCKS / 2] =
+        NvOsRealloc(blocks[BENCH_CHECK_BLOCKS / 2], 2 * BENCH_CHECK_SIZE);
+    if (!BenchFindSite(BENCH_CHECK_BLOCKS / 2 - 1, &site) ||
+        site.LiveBytes != (BENCH_CHECK_BLOCKS / 2 - 1) * BENCH_CHECK_SIZE)
+    {
+        printf("live counts after realloc FAILED\n");
+        ok = NV_FALSE;
+    }
+
+    for (i = BENCH_CHECK_BLOCKS / 2; i < BENCH_CHECK_BLOCKS; i++)
+        NvOsFree(blocks[i]);
+    if (!BenchFindSite(0, &site) || site.LiveBytes != 0)
+    {
+        printf("live counts after freeing all FAILED\n");
+        ok = NV_FALSE;
+    }
+
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    NvU32 iterations = BENCH_DEFAULT_ITERATIONS;
+    NvBool ok = NV_TRUE;
+    NvU32 threads;
+
+    if (argc > 1)
+        iterations = strtoul(argv[1], NULL, 0);
+    if (!iterations)
+    {
+        printf("usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    if (NvOsHeapProfileEnabled())
+        ok = BenchCheck();
+    else
+        printf("libnvos built without NVOS_HEAP_PROFILE, timing only\n");
+
+    for (threads = 1; threads <= BENCH_MAX_THREADS; threads *= 2)
+    {
+        double base = BenchRun(threads, iterations, NV_TRUE);
+        double nvos = BenchRun(threads, iterations, NV_FALSE);
+
+        printf("%u threads: malloc %6.1f ns, NvOsAlloc %6.1f ns, "
+            "overhead %+.1f%%\n", threads, base, nvos,
+            base > 0.0 ? (nvos - base) * 100.0 / base : 0.0);
+    }
+
+    fflush(stdout);
+    NvOsHeapProfileDump(NULL);
+
+    printf(ok ? "PASSED\n" : "FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2006-2013,  NVIDIA CORPORATION. All rights reserved.
+ * Copyright (c) 2006-2014,  NVIDIA CORPORATION. All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property and
  * proprietary rights in and to this software and related documentation.  Any
@@ -1654,6 +1654,65 @@ void NvOsWaitUS(NvU32 usec)
     }
 }
 
+#if NVOS_USE_FUTEX
+
+typedef struct NvOsMutexRec
+{
+    NvOsFutexMutex futex;
+} NvOsMutex;
+
+NvError NvOsMutexCreateInternal(NvOsMutexHandle *mutex)
+{
+    NvOsMutex *m;
+
+    NV_ASSERT( mutex );
+
+    m = NvOsAlloc( sizeof(NvOsMutex) );
+    if( !m )
+    {
+        *mutex = 0;
+        return NvError_InsufficientMemory;
+    }
+
+    NvOsFutexMutexInit( &m->futex, NVOS_FUTEX_SPIN_DEFAULT );
+
+    *mutex = m;
+    return NvSuccess;
+}
+
+void NvOsMutexLockAtInternal( NvOsMutexHandle m, const void *site )
+{
+    NV_ASSERT( m );
+    if ( !m ) return;
+
+    NvOsLinuxFutexMutexLockAt( &m->futex, site );
+}
+
+void NvOsMutexLockInternal( NvOsMutexHandle m )
+{
+    NvOsMutexLockAtInternal( m, __builtin_return_address(0) );
+}
+
+void NvOsMutexUnlockInternal( NvOsMutexHandle m )
+{
+    NV_ASSERT( m );
+    if ( !m ) return;
+
+    NvOsFutexMutexUnlock( &m->futex );
+}
+
+void NvOsMutexDestroyInternal( NvOsMutexHandle m )
+{
+    NV_ASSERT( m );
+    if (!m)
+        return;
+
+    NV_ASSERT( m->futex.State == 0 );
+    NvOsFree(m);
+}
+
+#else
+
 typedef struct NvOsMutexRec
 {
     pthread_mutex_t    mutex;
@@ -1756,6 +1815,8 @@ void NvOsMutexDestroyInternal( NvOsMutexHandle m )
     NvOsFree(m);
 }
 
+#endif // NVOS_USE_FUTEX
+
 typedef struct NvOsIntrMutexRec
 {
     pthread_mutex_t mutex;
@@ -1799,6 +1860,203 @@ void NvOsIntrMutexDestroy(NvOsIntrMutexHandle mutex)
     NvOsFree( mutex );
 }
 
+#if NVOS_USE_FUTEX
+
+/* The waiters sleep on a sequence number that every signal bumps, so a
+ * signal between releasing the mutex and sleeping is not lost */
+typedef struct NvOsConditionRec
+{
+    volatile NvS32 seq;
+    volatile NvS32 waiters;
+} NvOsCondition;
+
+NvError NvOsConditionCreate(NvOsConditionHandle *cond)
+{
+    NvOsCondition *c;
+
+    NV_ASSERT(cond);
+
+    c = NvOsAlloc(sizeof(NvOsCondition));
+    if (!c)
+        return NvError_InsufficientMemory;
+
+    c->seq = 0;
+    c->waiters = 0;
+
+    *cond = c;
+    return NvSuccess;
+}
+
+NvError NvOsConditionDestroy(NvOsConditionHandle cond)
+{
+    if (!cond)
+        return NvError_BadParameter;
+
+    if (cond->waiters)
+        return NvError_Busy;
+
+    NvOsFree(cond);
+    return NvSuccess;
+}
+
+NvError NvOsConditionBroadcast(NvOsConditionHandle cond)
+{
+    if (!cond)
+        return NvError_BadParameter;
+
+    (void)__sync_fetch_and_add(&cond->seq, 1);
+    if (cond->waiters)
+        NvOsLinuxFutexWake(&cond->seq, INT_MAX);
+    return NvSuccess;
+}
+
+NvError NvOsConditionSignal(NvOsConditionHandle cond)
+{
+    if (!cond)
+        return NvError_BadParameter;
+
+    (void)__sync_fetch_and_add(&cond->seq, 1);
+    if (cond->waiters)
+        NvOsLinuxFutexWake(&cond->seq, 1);
+    return NvSuccess;
+}
+
+static NvError NvOsConditionWaitFutex(
+    NvOsConditionHandle cond,
+    NvOsMutexHandle mutex,
+    NvU32 microsecs)
+{
+    NvError ret;
+    NvS32 seq;
+
+    if (!cond || !mutex)
+        return NvError_BadParameter;
+
+    // Ensure that mutex is locked only once in the current thread
+    if (mutex->futex.Count != 1 || mutex->futex.Owner != pthread_self())
+        return NvError_AccessDenied;
+
+    (void)__sync_fetch_and_add(&cond->waiters, 1);
+    seq = cond->seq;
+    NvOsFutexMutexUnlock(&mutex->futex);
+
+    ret = NvOsLinuxFutexWait(&cond->seq, seq, microsecs);
+
+    NvOsLinuxFutexMutexLockAt(&mutex->futex, NULL);
+    (void)__sync_fetch_and_sub(&cond->waiters, 1);
+
+    return ret;
+}
+
+NvError NvOsConditionWait(NvOsConditionHandle cond, NvOsMutexHandle mutex)
+{
+    return NvOsConditionWaitFutex(cond, mutex, NV_WAIT_INFINITE);
+}
+
+NvError NvOsConditionWaitTimeout(NvOsConditionHandle cond, NvOsMutexHandle mutex, NvU32 microsecs)
+{
+    if (microsecs == NV_WAIT_INFINITE)
+        microsecs--;
+    return NvOsConditionWaitFutex(cond, mutex, microsecs);
+}
+
+typedef struct NvOsSemaphoreRec
+{
+    NvOsFutexSemaphore futex;
+    NvS32 refCount;
+} NvOsSemaphore;
+
+NvError NvOsSemaphoreCreateInternal(
+    NvOsSemaphoreHandle *semaphore,
+    NvU32 value)
+{
+    NvOsSemaphore *s;
+
+    NV_ASSERT(semaphore);
+    if (!semaphore)
+        return NvError_BadParameter;
+
+    s = NvOsAlloc(sizeof(NvOsSemaphore));
+    if (!s)
+        return NvError_InsufficientMemory;
+
+    NvOsFutexSemaphoreInit(&s->futex, value);
+    s->refCount = 1;
+
+    *semaphore = s;
+    return NvSuccess;
+}
+
+NvError NvOsSemaphoreCloneInternal(
+    NvOsSemaphoreHandle s,
+    NvOsSemaphoreHandle *semaphore)
+{
+    NV_ASSERT(s && semaphore);
+
+    if (!s || !semaphore)
+        return NvError_BadParameter;
+
+    (void)__sync_fetch_and_add(&s->refCount, 1);
+    *semaphore = s;
+    return NvSuccess;
+}
+
+NvError NvOsSemaphoreUnmarshal(
+    NvOsSemaphoreHandle hClientSema,
+    NvOsSemaphoreHandle *phDriverSema)
+{
+    /* Futex semaphores are never shared with a kernel driver */
+    return NvError_NotSupported;
+}
+
+void NvOsSemaphoreWaitInternal(NvOsSemaphoreHandle s)
+{
+    NV_ASSERT(s);
+
+    if (!s)
+        return;
+
+    NvOsFutexSemaphoreWait(&s->futex);
+}
+
+NvError NvOsSemaphoreWaitTimeoutInternal(NvOsSemaphoreHandle s, NvU32 msec)
+{
+    NV_ASSERT( s );
+
+    if (!s)
+        return NvError_BadParameter;
+
+    return NvOsFutexSemaphoreWaitTimeout(&s->futex, msec);
+}
+
+void NvOsSemaphoreSignalInternal( NvOsSemaphoreHandle s )
+{
+    NV_ASSERT(s);
+
+    if (!s)
+        return;
+
+    NvOsFutexSemaphoreSignal(&s->futex);
+}
+
+void NvOsSemaphoreDestroyInternal(NvOsSemaphoreHandle s)
+{
+    NvS32 v;
+
+    if (!s)
+        return;
+
+    v = __sync_fetch_and_sub(&s->refCount, 1);
+    if (v > 1)
+        return;
+
+    NV_ASSERT(v == 1);
+    NV_ASSERT(!s->futex.Waiters);
+    NvOsFree(s);
+}
+
+#else
+
 typedef struct NvOsConditionRec
 {
     pthread_cond_t cond;
@@ -2037,6 +2295,8 @@ void NvOsSemaphoreDestroyInternal(NvOsSemaphoreHandle s)
         g_NvOsKernel->nvOsSemaphoreDestroy(s);
 }
 
+#endif // NVOS_USE_FUTEX
+
 #define CONVERT_CPU_NUM_TO_CPU_MASK(cpu_num)  (1 << (cpu_num))
 
 void NvOsThreadSetAffinity(NvU32 CpuHint)
@@ -1,5 +1,5 @@
 /*
- * Copyright 2006 - 2011 NVIDIA Corporation.  All Rights Reserved.
+ * Copyright 2006 - 2014 NVIDIA Corporation.  All Rights Reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property and
  * proprietary rights in and to this software and related documentation.  Any
@@ -14,6 +14,7 @@
 #include "nvcommon.h"
 #include "nvassert.h"
 #include "nvos.h"
+#include "nvos_futex.h"
 #include "linux/nvos_ioctl.h"
 
 #ifdef __cplusplus
@@ -68,6 +69,11 @@ NvError NvOsLinuxPhysicalMemMapFd(
 void  NvOsAndroidDebugString(const char* str);
 #endif // ANDROID
 
+/* Futex primitives, see nvos_linux_futex.c */
+NvError NvOsLinuxFutexWait(volatile NvS32 *addr, NvS32 val, NvU32 usec);
+void NvOsLinuxFutexWake(volatile NvS32 *addr, NvS32 count);
+void NvOsLinuxFutexMutexLockAt(NvOsFutexMutex *mutex, const void *site);
+
 #ifdef __cplusplus
 }
 #endif  /* __cplusplus */
@@ -0,0 +1,415 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+/*
+ * Futex based mutexes and semaphores, see nvos_futex.h.
+ *
+ * The mutex is the three state futex lock: a locker takes it by moving State
+ * from 0 to 1 with one compare-and-swap. On contention it retries SpinCount
+ * times, as the holder is usually about to release it, and then marks the
+ * lock 2 ("may have sleepers") and sleeps in the kernel. Unlocking only
+ * enters the kernel to wake a sleeper when the state was 2.
+ *
+ * Contended lock calls are counted per call site, in a fixed table keyed by
+ * the return address of the lock call, so the counters cost nothing until a
+ * lock is actually contended.
+ */
+
+#if defined(__linux__)
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "nvos.h"
+#include "nvos_futex.h"
+#include "nvos_internal.h"
+#include "nvassert.h"
+#include "nvos_linux.h"
+
+#ifndef FUTEX_PRIVATE_FLAG
+#define FUTEX_PRIVATE_FLAG 128
+#endif
+
+/* Number of lock call sites tracked, a power of 2 */
+#define NVOS_FUTEX_MAX_SITES 256
+
+static NvOsFutexContention s_FutexSites[NVOS_FUTEX_MAX_SITES];
+
+static NV_INLINE void NvOsFutexRelax(void)
+{
+#if NVCPU_IS_X86
+    __asm__ __volatile__("pause" ::: "memory");
+#elif NVCPU_IS_ARM && defined(__ARM_ARCH_7A__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+static NvU64 NvOsFutexTimeUS(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (NvU64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Sleeps while *addr == val, for at most usec unless that is
+ * NV_WAIT_INFINITE. Returns NvError_Timeout when the time ran out; other
+ * returns may be spurious, so callers recheck their condition. */
+NvError NvOsLinuxFutexWait(volatile NvS32 *addr, NvS32 val, NvU32 usec)
+{
+    struct timespec ts, *pts = NULL;
+    int ret;
+
+    if (usec != NV_WAIT_INFINITE)
+    {
+        ts.tv_sec = usec / 1000000;
+        ts.tv_nsec = (usec % 1000000) * 1000;
+        pts = &ts;
+    }
+
+    ret = syscall(__NR_futex, addr, FUTEX_WAIT | FUTEX_PRIVATE_FLAG, val,
+              pts, NULL, 0);
+    if (ret < 0 && errno == ETIMEDOUT)
+        return NvError_Timeout;
+
+    return NvSuccess;
+}
+
+void NvOsLinuxFutexWake(volatile NvS32 *addr, NvS32 count)
+{
+    (void)syscall(__NR_futex, addr, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, count,
+              NULL, NULL, 0);
+}
+
+/*
+ * Contention counters
+ */
+
+static NvOsFutexContention *NvOsFutexFindSite(const void *site)
+{
+    NvU32 hash = (NvU32)(((NvUPtr)site >> 2) * 2654435761U);
+    NvU32 i, slot;
+
+    for (i = 0; i < NVOS_FUTEX_MAX_SITES; i++)
+    {
+        const void *cur;
+
+        slot = (hash + i) & (NVOS_FUTEX_MAX_SITES - 1);
+        cur = s_FutexSites[slot].Site;
+        if (cur == site)
+            return &s_FutexSites[slot];
+        if (!cur)
+        {
+            cur = __sync_val_compare_and_swap(
+                      (const void **)&s_FutexSites[slot].Site, NULL, site);
+            if (!cur || cur == site)
+                return &s_FutexSites[slot];
+        }
+    }
+
+    /* Table full, the site goes uncounted */
+    return NULL;
+}
+
+static void NvOsFutexRecordContention(
+    const void *site,
+    NvBool slept,
+    NvU64 waitUS)
+{
+    NvOsFutexContention *entry;
+
+    if (!site)
+        return;
+
+    entry = NvOsFutexFindSite(site);
+    if (!entry)
+        return;
+
+    (void)__sync_fetch_and_add(&entry->Contended, 1);
+    if (slept)
+        (void)__sync_fetch_and_add(&entry->Slept, 1);
+    (void)__sync_fetch_and_add(&entry->WaitUS, waitUS);
+}
+
+static int NvOsFutexCompareContention(const void *a, const void *b)
+{
+    const NvOsFutexContention *ca = a;
+    const NvOsFutexContention *cb = b;
+
+    if (ca->Contended != cb->Contended)
+        return ca->Contended < cb->Contended ? 1 : -1;
+    return 0;
+}
+
+NvU32 NvOsFutexGetContention(NvOsFutexContention *stats, NvU32 max)
+{
+    NvOsFutexContention all[NVOS_FUTEX_MAX_SITES];
+    NvU32 i, count = 0;
+
+    if (!stats)
+        return 0;
+
+    for (i = 0; i < NVOS_FUTEX_MAX_SITES; i++)
+    {
+        if (s_FutexSites[i].Site && s_FutexSites[i].Contended)
+            all[count++] = s_FutexSites[i];
+    }
+    qsort(all, count, sizeof(all[0]), NvOsFutexCompareContention);
+
+    if (count > max)
+        count = max;
+    NvOsMemcpy(stats, all, count * sizeof(all[0]));
+    return count;
+}
+
+void NvOsFutexResetContention(void)
+{
+    NvU32 i;
+
+    /* Sites stay in place so that concurrent lockers keep their slots */
+    for (i = 0; i < NVOS_FUTEX_MAX_SITES; i++)
+    {
+        s_FutexSites[i].Contended = 0;
+        s_FutexSites[i].Slept = 0;
+        s_FutexSites[i].WaitUS = 0;
+    }
+}
+
+void NvOsFutexDumpContention(void)
+{
+    NvOsFutexContention stats[NVOS_FUTEX_MAX_SITES];
+    NvU32 i, count;
+
+    count = NvOsFutexGetContention(stats, NVOS_FUTEX_MAX_SITES);
+    NvOsDebugPrintf("nvos: %u contended lock sites\n", count);
+
+    for (i = 0; i < count; i++)
+    {
+        Dl_info info;
+        const char *name = "?";
+        NvUPtr offset = (NvUPtr)stats[i].Site;
+
+        if (dladdr(stats[i].Site, &info) && info.dli_sname)
+        {
+            name = info.dli_sname;
+            offset -= (NvUPtr)info.dli_saddr;
+        }
+        NvOsDebugPrintf("nvos:   %p %s+0x%lx: %u contended, %u slept, "
+            "%llu us waiting\n", stats[i].Site, name, (unsigned long)offset,
+            stats[i].Contended, stats[i].Slept,
+            (unsigned long long)stats[i].WaitUS);
+    }
+}
+
+/*
+ * Mutex
+ */
+
+void NvOsFutexMutexInit(NvOsFutexMutex *mutex, NvU32 spinCount)
+{
+    NV_ASSERT(mutex);
+
+    mutex->State = 0;
+    mutex->Owner = 0;
+    mutex->Count = 0;
+    mutex->SpinCount = spinCount;
+}
+
+static void NvOsFutexMutexLockSlow(NvOsFutexMutex *mutex, const void *site)
+{
+    NvU64 start = NvOsFutexTimeUS();
+    NvBool slept = NV_FALSE;
+    NvS32 state;
+    NvU32 i;
+
+    for (i = 0; i < mutex->SpinCount; i++)
+    {
+        NvOsFutexRelax();
+        if (mutex->State == 0 &&
+            __sync_bool_compare_and_swap(&mutex->State, 0, 1))
+            goto locked;
+    }
+
+    /* Take the lock in the "may have sleepers" state, as other threads may
+     * be asleep when this one wakes up with it */
+    state = __sync_lock_test_and_set(&mutex->State, 2);
+    while (state != 0)
+    {
+        slept = NV_TRUE;
+        (void)NvOsLinuxFutexWait(&mutex->State, 2, NV_WAIT_INFINITE);
+        state = __sync_lock_test_and_set(&mutex->State, 2);
+    }
+
+locked:
+    NvOsFutexRecordContention(site, slept, NvOsFutexTimeUS() - start);
+}
+
+void NvOsLinuxFutexMutexLockAt(NvOsFutexMutex *mutex, const void *site)
+{
+    pthread_t self = pthread_self();
+
+    NV_ASSERT(mutex);
+
+    if (mutex->Owner == self)
+    {
+        mutex->Count++;
+        return;
+    }
+
+    if (!__sync_bool_compare_and_swap(&mutex->State, 0, 1))
+        NvOsFutexMutexLockSlow(mutex, site);
+
+    NV_ASSERT(mutex->Count == 0);
+    mutex->Owner = self;
+    mutex->Count = 1;
+}
+
+void NvOsFutexMutexLock(NvOsFutexMutex *mutex)
+{
+    NvOsLinuxFutexMutexLockAt(mutex, __builtin_return_address(0));
+}
+
+NvBool NvOsFutexMutexTryLock(NvOsFutexMutex *mutex)
+{
+    pthread_t self = pthread_self();
+
+    NV_ASSERT(mutex);
+
+    if (mutex->Owner == self)
+    {
+        mutex->Count++;
+        return NV_TRUE;
+    }
+
+    if (!__sync_bool_compare_and_swap(&mutex->State, 0, 1))
+        return NV_FALSE;
+
+    mutex->Owner = self;
+    mutex->Count = 1;
+    return NV_TRUE;
+}
+
+void NvOsFutexMutexUnlock(NvOsFutexMutex *mutex)
+{
+    NV_ASSERT(mutex);
+
+    if (mutex->Owner != pthread_self())
+    {
+        NV_ASSERT(0 && "illegal thread id in unlock");
+        return;
+    }
+
+    if (--mutex->Count)
+        return;
+
+    mutex->Owner = 0;
+    if (__sync_fetch_and_sub(&mutex->State, 1) != 1)
+    {
+        mutex->State = 0;
+        NvOsLinuxFutexWake(&mutex->State, 1);
+    }
+}
+
+/*
+ * Semaphore
+ */
+
+void NvOsFutexSemaphoreInit(NvOsFutexSemaphore *semaphore, NvU32 value)
+{
+    NV_ASSERT(semaphore);
+
+    semaphore->Value = (NvS32)value;
+    semaphore->Waiters = 0;
+}
+
+static NvBool NvOsFutexSemaphoreTryWait(NvOsFutexSemaphore *semaphore)
+{
+    NvS32 value = semaphore->Value;
+
+    while (value > 0)
+    {
+        NvS32 old = __sync_val_compare_and_swap(&semaphore->Value, value,
+                        value - 1);
+        if (old == value)
+            return NV_TRUE;
+        value = old;
+    }
+
+    return NV_FALSE;
+}
+
+NvError NvOsFutexSemaphoreWaitTimeout(
+    NvOsFutexSemaphore *semaphore,
+    NvU32 msec)
+{
+    NvU64 deadline = 0;
+    NvError ret = NvSuccess;
+
+    NV_ASSERT(semaphore);
+
+    if (NvOsFutexSemaphoreTryWait(semaphore))
+        return NvSuccess;
+    if (!msec)
+        return NvError_Timeout;
+
+    if (msec != NV_WAIT_INFINITE)
+        deadline = NvOsFutexTimeUS() + (NvU64)msec * 1000;
+
+    /* A signaller checks Waiters after raising Value, so either it sees this
+     * waiter or the wait below sees the new value and returns at once */
+    (void)__sync_fetch_and_add(&semaphore->Waiters, 1);
+    while (!NvOsFutexSemaphoreTryWait(semaphore))
+    {
+        NvU32 usec = NV_WAIT_INFINITE;
+
+        if (deadline)
+        {
+            NvU64 now = NvOsFutexTimeUS();
+
+            if (now >= deadline)
+            {
+                ret = NvError_Timeout;
+                break;
+            }
+            usec = (deadline - now) > 0x7FFFFFFF ?
+                       0x7FFFFFFF : (NvU32)(deadline - now);
+        }
+        (void)NvOsLinuxFutexWait(&semaphore->Value, 0, usec);
+    }
+    (void)__sync_fetch_and_sub(&semaphore->Waiters, 1);
+
+    return ret;
+}
+
+void NvOsFutexSemaphoreWait(NvOsFutexSemaphore *semaphore)
+{
+    (void)NvOsFutexSemaphoreWaitTimeout(semaphore, NV_WAIT_INFINITE);
+}
+
+void NvOsFutexSemaphoreSignal(NvOsFutexSemaphore *semaphore)
+{
+    NV_ASSERT(semaphore);
+
+    (void)__sync_fetch_and_add(&semaphore->Value, 1);
+    if (semaphore->Waiters)
+        NvOsLinuxFutexWake(&semaphore->Value, 1);
+}
+
+#endif // __linux__
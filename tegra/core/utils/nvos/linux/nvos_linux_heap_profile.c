@@ -0,0 +1,661 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+/*
+ * Per call site heap profile, see nvos_heap_profile.h.
+ *
+ * Sites live in a fixed open addressed table. A slot is claimed with one
+ * compare-and-swap and its key never changes afterwards, so lookups take no
+ * lock. nvos_alloc.c stores the site of each allocation in its header, so a
+ * free only has to subtract from the counters of that site; there is no
+ * table of live pointers to look up or keep in sync with the heap.
+ *
+ * Each thread keeps a small direct mapped cache of the sites it allocated
+ * from last. Besides saving the probe of the shared table, a cache entry
+ * holds the allocation totals of its site for that thread, which are only
+ * added to the site when the entry is evicted or the thread exits. Only the
+ * live counts, which the peak is taken from, are updated atomically on the
+ * site for every allocation. The caches are chained on a list that is never
+ * shortened, so that a report can add in the totals they hold; a cache left
+ * behind by a thread that exited is taken over by the next new thread.
+ */
+
+#if defined(__linux__)
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvos.h"
+#include "nvos_heap_profile.h"
+#include "nvos_internal.h"
+#include "nvassert.h"
+
+/* Number of allocation sites tracked, a power of 2 */
+#define NVOS_HEAP_MAX_SITES 4096
+
+/* Entries in the per-thread site cache, a power of 2 */
+#define NVOS_HEAP_CACHE_SIZE 64
+
+/* Totals held in a cache entry are handed to the site before they can
+ * overflow */
+#define NVOS_HEAP_PENDING_MAX 0x40000000
+
+typedef enum
+{
+    NvOsHeapSiteState_Free = 0,
+    NvOsHeapSiteState_Filling,
+    NvOsHeapSiteState_Ready
+} NvOsHeapSiteState;
+
+typedef struct NvOsHeapSiteEntryRec
+{
+    volatile NvU32 State;
+    const char *File;
+    NvU32 Line;
+    const void *Caller;
+    NvU32 StackHash;
+    /* Call stack of the first allocation, when stacks are recorded */
+    NvCallstack *Stack;
+
+    /* Live counts never exceed the address space, so they are kept in
+     * native words that can be updated and compared atomically */
+    volatile size_t LiveBytes;
+    volatile size_t PeakBytes;
+    volatile NvU32 LiveAllocs;
+    volatile NvU64 TotalAllocs;
+    volatile NvU64 TotalBytes;
+} NvOsHeapSiteEntry;
+
+typedef struct NvOsHeapCacheEntryRec
+{
+    const char *File;
+    NvU32 Line;
+    const void *Caller;
+    NvU32 StackHash;
+    NvOsHeapSiteEntry *Entry;
+    /* Allocations made through this entry not yet added to the site */
+    volatile NvU32 Allocs;
+    volatile NvU32 Bytes;
+} NvOsHeapCacheEntry;
+
+typedef struct NvOsHeapCacheRec
+{
+    struct NvOsHeapCacheRec *Next;
+    volatile NvU32 InUse;
+    /* Reset count the pending totals belong to */
+    volatile NvU32 Epoch;
+    NvOsHeapCacheEntry Entries[NVOS_HEAP_CACHE_SIZE];
+} NvOsHeapCache;
+
+static NvOsHeapSiteEntry s_HeapSites[NVOS_HEAP_MAX_SITES];
+
+/* Allocations from new sites are counted here once the table is full */
+static NvOsHeapSiteEntry s_HeapOverflow =
+{
+    NvOsHeapSiteState_Ready, "<overflow>", 0, NULL, 0, NULL, 0, 0, 0, 0, 0
+};
+
+static NvOsHeapCache *volatile s_HeapCaches = NULL;
+static volatile NvU32 s_HeapEpoch = 0;
+static volatile NvBool s_HeapStacks = NV_FALSE;
+static NvU64 s_HeapResetTimeUS;
+
+static pthread_once_t s_HeapOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t s_HeapCacheKey;
+static NvBool s_HeapCacheKeyValid = NV_FALSE;
+
+/*
+ * Per-thread caches
+ */
+
+/* Hands the totals held by a cache entry over to its site. Totals from
+ * before the last reset are dropped. */
+static void NvOsHeapFlush(NvOsHeapCache *cache, NvOsHeapCacheEntry *cached)
+{
+    if (cached->Entry && cached->Allocs && cache->Epoch == s_HeapEpoch)
+    {
+        (void)__sync_fetch_and_add(&cached->Entry->TotalAllocs,
+                  (NvU64)cached->Allocs);
+        (void)__sync_fetch_and_add(&cached->Entry->TotalBytes,
+                  (NvU64)cached->Bytes);
+    }
+    cached->Allocs = 0;
+    cached->Bytes = 0;
+}
+
+static void NvOsHeapReleaseCache(void *arg)
+{
+    NvOsHeapCache *cache = arg;
+    NvU32 i;
+
+    for (i = 0; i < NVOS_HEAP_CACHE_SIZE; i++)
+        NvOsHeapFlush(cache, &cache->Entries[i]);
+    __sync_synchronize();
+    cache->InUse = 0;
+}
+
+static void NvOsHeapInit(void)
+{
+    s_HeapResetTimeUS = NvOsGetTimeUS();
+    if (pthread_key_create(&s_HeapCacheKey, NvOsHeapReleaseCache) == 0)
+        s_HeapCacheKeyValid = NV_TRUE;
+}
+
+static NvOsHeapCache *NvOsHeapGetCache(void)
+{
+    NvOsHeapCache *cache;
+
+    pthread_once(&s_HeapOnce, NvOsHeapInit);
+    if (!s_HeapCacheKeyValid)
+        return NULL;
+
+    cache = pthread_getspecific(s_HeapCacheKey);
+    if (cache)
+        return cache;
+
+    for (cache = s_HeapCaches; cache; cache = cache->Next)
+    {
+        if (!cache->InUse &&
+            __sync_bool_compare_and_swap(&cache->InUse, 0, 1))
+            break;
+    }
+
+    if (!cache)
+    {
+        /* The cache comes from the internal allocator, which is not
+         * profiled, and is never freed */
+        cache = NvOsAllocInternal(sizeof(*cache));
+        if (!cache)
+            return NULL;
+        NvOsMemset(cache, 0, sizeof(*cache));
+        cache->InUse = 1;
+        cache->Epoch = s_HeapEpoch;
+        do
+        {
+            cache->Next = s_HeapCaches;
+        } while (!__sync_bool_compare_and_swap(&s_HeapCaches, cache->Next,
+                      cache));
+    }
+
+    if (pthread_setspecific(s_HeapCacheKey, cache))
+    {
+        NvOsHeapReleaseCache(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+/*
+ * Site table
+ */
+
+static NV_INLINE NvU32 NvOsHeapHash(
+    const char *file,
+    NvU32 line,
+    const void *caller,
+    NvU32 stackHash)
+{
+    NvU32 hash;
+
+    hash = (NvU32)((NvUPtr)caller >> 2) * 2654435761U;
+    hash ^= ((NvU32)(NvUPtr)file + line) * 2246822519U;
+    hash ^= stackHash * 3266489917U;
+    return hash ^ (hash >> 15);
+}
+
+/* Finds the site, adding it if it is new. The call stack is handed over to
+ * the site when the site is added here, and *stack is then cleared. */
+static NvOsHeapSiteEntry *NvOsHeapFindSite(
+    NvU32 hash,
+    const char *file,
+    NvU32 line,
+    const void *caller,
+    NvU32 stackHash,
+    NvCallstack **stack)
+{
+    NvU32 i;
+
+    for (i = 0; i < NVOS_HEAP_MAX_SITES; i++)
+    {
+        NvOsHeapSiteEntry *entry =
+            &s_HeapSites[(hash + i) & (NVOS_HEAP_MAX_SITES - 1)];
+        NvU32 state = entry->State;
+
+        if (state == NvOsHeapSiteState_Free)
+        {
+            if (__sync_bool_compare_and_swap(&entry->State,
+                    NvOsHeapSiteState_Free, NvOsHeapSiteState_Filling))
+            {
+                entry->File = file;
+                entry->Line = line;
+                entry->Caller = caller;
+                entry->StackHash = stackHash;
+                entry->Stack = *stack;
+                *stack = NULL;
+                __sync_synchronize();
+                entry->State = NvOsHeapSiteState_Ready;
+                return entry;
+            }
+            state = entry->State;
+        }
+
+        /* Another thread is filling in the key; that is a few stores */
+        while (state != NvOsHeapSiteState_Ready)
+        {
+            __sync_synchronize();
+            state = entry->State;
+        }
+        __sync_synchronize();
+
+        if (entry->Caller == caller && entry->File == file &&
+            entry->Line == line && entry->StackHash == stackHash)
+            return entry;
+    }
+
+    return &s_HeapOverflow;
+}
+
+void *NvOsHeapProfileAllocInternal(
+    size_t size,
+    const char *file,
+    NvU32 line,
+    const void *caller)
+{
+    NvOsHeapCacheEntry *cached = NULL;
+    NvOsHeapSiteEntry *entry = NULL;
+    NvOsHeapCache *cache;
+    NvCallstack *stack = NULL;
+    NvU32 stackHash = 0;
+    NvU32 hash, i;
+    size_t live, peak;
+
+    if (s_HeapStacks)
+    {
+        stack = NvOsCallstackCreate(NvOsCallstackType_HexStack);
+        stackHash = NvOsCallstackHash(stack);
+    }
+    hash = NvOsHeapHash(file, line, caller, stackHash);
+
+    cache = NvOsHeapGetCache();
+    if (cache)
+    {
+        if (cache->Epoch != s_HeapEpoch)
+        {
+            for (i = 0; i < NVOS_HEAP_CACHE_SIZE; i++)
+                NvOsHeapFlush(cache, &cache->Entries[i]);
+            cache->Epoch = s_HeapEpoch;
+        }
+
+        cached = &cache->Entries[hash & (NVOS_HEAP_CACHE_SIZE - 1)];
+        if (cached->Entry &&
+            cached->Caller == caller && cached->File == file &&
+            cached->Line == line && cached->StackHash == stackHash)
+            entry = cached->Entry;
+    }
+
+    if (!entry)
+    {
+        entry = NvOsHeapFindSite(hash, file, line, caller, stackHash, &stack);
+        if (cached)
+        {
+            NvOsHeapFlush(cache, cached);
+            cached->File = file;
+            cached->Line = line;
+            cached->Caller = caller;
+            cached->StackHash = stackHash;
+            cached->Entry = entry;
+        }
+    }
+    NvOsCallstackDestroy(stack);
+
+    if (cached && size < NVOS_HEAP_PENDING_MAX)
+    {
+        cached->Allocs++;
+        cached->Bytes += size;
+        if (cached->Allocs >= NVOS_HEAP_PENDING_MAX ||
+            cached->Bytes >= NVOS_HEAP_PENDING_MAX)
+            NvOsHeapFlush(cache, cached);
+    }
+    else
+    {
+        (void)__sync_fetch_and_add(&entry->TotalAllocs, 1);
+        (void)__sync_fetch_and_add(&entry->TotalBytes, (NvU64)size);
+    }
+
+    (void)__sync_fetch_and_add(&entry->LiveAllocs, 1);
+    live = __sync_add_and_fetch(&entry->LiveBytes, size);
+
+    peak = entry->PeakBytes;
+    while (live > peak)
+    {
+        size_t old = __sync_val_compare_and_swap(&entry->PeakBytes, peak,
+                         live);
+        if (old == peak)
+            break;
+        peak = old;
+    }
+
+    return entry;
+}
+
+void NvOsHeapProfileFreeInternal(void *site, size_t size)
+{
+    NvOsHeapSiteEntry *entry = site;
+
+    if (!entry)
+        return;
+
+    (void)__sync_fetch_and_sub(&entry->LiveBytes, size);
+    (void)__sync_fetch_and_sub(&entry->LiveAllocs, 1);
+}
+
+NvBool NvOsHeapProfileEnabled(void)
+{
+    return NVOS_HEAP_PROFILE ? NV_TRUE : NV_FALSE;
+}
+
+void NvOsHeapProfileSetCallstacks(NvBool enable)
+{
+    s_HeapStacks = enable;
+}
+
+/* Copies the active sites out of the table, adding in the totals still
+ * held by the thread caches. Allocations made meanwhile may be missed or,
+ * when a cache entry is flushed at the same time, counted twice. 64 bit
+ * counters are read with an atomic operation as plain loads may tear on 32
+ * bit CPUs. */
+static NvU32 NvOsHeapSnapshot(NvOsHeapSite *sites, const NvCallstack **stacks)
+{
+    NvOsHeapCache *cache;
+    NvU32 i, count = 0;
+
+    /* Fill in by table slot first, with the overflow site last */
+    for (i = 0; i <= NVOS_HEAP_MAX_SITES; i++)
+    {
+        NvOsHeapSiteEntry *entry = i < NVOS_HEAP_MAX_SITES ?
+            &s_HeapSites[i] : &s_HeapOverflow;
+        NvOsHeapSite *site = &sites[i];
+
+        NvOsMemset(site, 0, sizeof(*site));
+        stacks[i] = NULL;
+        if (entry->State != NvOsHeapSiteState_Ready)
+            continue;
+        __sync_synchronize();
+
+        site->File = entry->File;
+        site->Line = entry->Line;
+        site->Caller = entry->Caller;
+        site->StackHash = entry->StackHash;
+        site->LiveBytes = entry->LiveBytes;
+        site->LiveAllocs = entry->LiveAllocs;
+        site->PeakBytes = entry->PeakBytes;
+        site->TotalAllocs = __sync_fetch_and_add(&entry->TotalAllocs, 0);
+        site->TotalBytes = __sync_fetch_and_add(&entry->TotalBytes, 0);
+        stacks[i] = entry->Stack;
+    }
+
+    for (cache = s_HeapCaches; cache; cache = cache->Next)
+    {
+        if (cache->Epoch != s_HeapEpoch)
+            continue;
+
+        for (i = 0; i < NVOS_HEAP_CACHE_SIZE; i++)
+        {
+            NvOsHeapCacheEntry *cached = &cache->Entries[i];
+            NvOsHeapSiteEntry *entry = cached->Entry;
+            NvU32 slot;
+
+            if (!entry)
+                continue;
+            slot = entry == &s_HeapOverflow ?
+                NVOS_HEAP_MAX_SITES : (NvU32)(entry - s_HeapSites);
+            sites[slot].TotalAllocs += cached->Allocs;
+            sites[slot].TotalBytes += cached->Bytes;
+        }
+    }
+
+    for (i = 0; i <= NVOS_HEAP_MAX_SITES; i++)
+    {
+        if (!sites[i].LiveAllocs && !sites[i].TotalAllocs)
+            continue;
+        sites[count] = sites[i];
+        stacks[count] = stacks[i];
+        count++;
+    }
+
+    return count;
+}
+
+static int NvOsHeapCompareLive(const void *a, const void *b)
+{
+    const NvOsHeapSite *sa = a;
+    const NvOsHeapSite *sb = b;
+
+    if (sa->LiveBytes != sb->LiveBytes)
+        return sa->LiveBytes < sb->LiveBytes ? 1 : -1;
+    if (sa->TotalBytes != sb->TotalBytes)
+        return sa->TotalBytes < sb->TotalBytes ? 1 : -1;
+    return 0;
+}
+
+NvU32 NvOsHeapProfileGetSites(NvOsHeapSite *sites, NvU32 max)
+{
+    NvOsHeapSite *all;
+    const NvCallstack **stacks;
+    NvU32 count = 0;
+
+    if (!sites || !max)
+        return 0;
+
+    /* Too big for the stack of an arbitrary thread */
+    all = NvOsAllocInternal((NVOS_HEAP_MAX_SITES + 1) * sizeof(*all));
+    stacks = NvOsAllocInternal((NVOS_HEAP_MAX_SITES + 1) * sizeof(*stacks));
+    if (all && stacks)
+    {
+        count = NvOsHeapSnapshot(all, stacks);
+        qsort(all, count, sizeof(all[0]), NvOsHeapCompareLive);
+
+        if (count > max)
+            count = max;
+        NvOsMemcpy(sites, all, count * sizeof(all[0]));
+    }
+
+    NvOsFreeInternal(all);
+    NvOsFreeInternal((void *)stacks);
+    return count;
+}
+
+void NvOsHeapProfileReset(void)
+{
+    NvU32 i;
+
+    pthread_once(&s_HeapOnce, NvOsHeapInit);
+
+    /* Moving to a new epoch drops the totals held by the thread caches.
+     * Allocations racing with this may land on either side of the reset. */
+    (void)__sync_fetch_and_add(&s_HeapEpoch, 1);
+
+    for (i = 0; i <= NVOS_HEAP_MAX_SITES; i++)
+    {
+        NvOsHeapSiteEntry *entry = i < NVOS_HEAP_MAX_SITES ?
+            &s_HeapSites[i] : &s_HeapOverflow;
+
+        if (entry->State != NvOsHeapSiteState_Ready)
+            continue;
+        (void)__sync_and_and_fetch(&entry->TotalAllocs, 0);
+        (void)__sync_and_and_fetch(&entry->TotalBytes, 0);
+        entry->PeakBytes = entry->LiveBytes;
+    }
+    s_HeapResetTimeUS = NvOsGetTimeUS();
+}
+
+/*
+ * Report
+ */
+
+typedef struct NvOsHeapReportLineRec
+{
+    NvOsHeapSite Site;
+    const NvCallstack *Stack;
+    char Name[192];
+} NvOsHeapReportLine;
+
+/* Names a site by file and line when known, and by the symbol or the
+ * module offset of the caller, which stay the same across runs */
+static void NvOsHeapSiteName(char *buf, NvU32 len, const NvOsHeapSite *site)
+{
+    const char *where = "?";
+    NvUPtr offset = (NvUPtr)site->Caller;
+    Dl_info info;
+    NvU32 n = 0;
+
+    buf[0] = '\0';
+    if (site->File)
+        n = NvOsSnprintf(buf, len, "%s:%u ", site->File, site->Line);
+    if (n >= len)
+        return;
+
+    if (!site->Caller)
+    {
+        if (!site->File)
+            NvOsSnprintf(buf, len, "<unknown>");
+        return;
+    }
+
+    if (dladdr(site->Caller, &info))
+    {
+        if (info.dli_sname)
+        {
+            where = info.dli_sname;
+            offset -= (NvUPtr)info.dli_saddr;
+        }
+        else if (info.dli_fname)
+        {
+            where = strrchr(info.dli_fname, '/');
+            where = where ? where + 1 : info.dli_fname;
+            offset -= (NvUPtr)info.dli_fbase;
+        }
+    }
+    NvOsSnprintf(buf + n, len - n, "%s+0x%lx", where, (unsigned long)offset);
+}
+
+static int NvOsHeapCompareName(const void *a, const void *b)
+{
+    const NvOsHeapReportLine *la = a;
+    const NvOsHeapReportLine *lb = b;
+    int cmp = strcmp(la->Name, lb->Name);
+
+    if (cmp)
+        return cmp;
+    if (la->Site.StackHash != lb->Site.StackHash)
+        return la->Site.StackHash < lb->Site.StackHash ? -1 : 1;
+    return 0;
+}
+
+static void NvOsHeapPrintf(NvOsFileHandle file, const char *format, ...)
+{
+    char buf[512];
+    va_list ap;
+
+    va_start(ap, format);
+    (void)NvOsVsnprintf(buf, sizeof(buf), format, ap);
+    va_end(ap);
+
+    if (file)
+        (void)NvOsFwrite(file, buf, NvOsStrlen(buf));
+    else
+        NvOsDebugPrintf("%s", buf);
+}
+
+void NvOsHeapProfileDump(NvOsFileHandle file)
+{
+    NvOsHeapReportLine *lines;
+    NvOsHeapSite *sites;
+    const NvCallstack **stacks;
+    NvU64 liveBytes = 0, liveAllocs = 0, totalAllocs = 0;
+    NvU64 elapsed;
+    double seconds;
+    NvU32 i, count;
+
+    if (!NvOsHeapProfileEnabled())
+    {
+        NvOsHeapPrintf(file, "nvos heap profile: not built in\n");
+        return;
+    }
+
+    pthread_once(&s_HeapOnce, NvOsHeapInit);
+    elapsed = NvOsGetTimeUS() - s_HeapResetTimeUS;
+    seconds = elapsed ? elapsed / 1000000.0 : 1.0;
+
+    lines = NvOsAllocInternal((NVOS_HEAP_MAX_SITES + 1) * sizeof(*lines));
+    sites = NvOsAllocInternal((NVOS_HEAP_MAX_SITES + 1) * sizeof(*sites));
+    stacks = NvOsAllocInternal((NVOS_HEAP_MAX_SITES + 1) * sizeof(*stacks));
+    if (!lines || !sites || !stacks)
+    {
+        NvOsHeapPrintf(file, "nvos heap profile: out of memory\n");
+        goto cleanup;
+    }
+
+    count = NvOsHeapSnapshot(sites, stacks);
+    for (i = 0; i < count; i++)
+    {
+        lines[i].Site = sites[i];
+        lines[i].Stack = stacks[i];
+        NvOsHeapSiteName(lines[i].Name, sizeof(lines[i].Name), &sites[i]);
+        liveBytes += sites[i].LiveBytes;
+        liveAllocs += sites[i].LiveAllocs;
+        totalAllocs += sites[i].TotalAllocs;
+    }
+    qsort(lines, count, sizeof(lines[0]), NvOsHeapCompareName);
+
+    NvOsHeapPrintf(file, "nvos heap profile: %u sites, %llu bytes live in "
+        "%llu allocations, %llu allocations in %.1f s\n", count,
+        (unsigned long long)liveBytes, (unsigned long long)liveAllocs,
+        (unsigned long long)totalAllocs, seconds);
+    NvOsHeapPrintf(file, "%12s %8s %12s %10s %10s  %s\n", "live_bytes",
+        "live", "peak_bytes", "allocs", "allocs/s", "site");
+
+    for (i = 0; i < count; i++)
+    {
+        const NvOsHeapSite *site = &lines[i].Site;
+        NvU32 frame, height;
+
+        NvOsHeapPrintf(file, "%12llu %8u %12llu %10llu %10.1f  %s",
+            (unsigned long long)site->LiveBytes, site->LiveAllocs,
+            (unsigned long long)site->PeakBytes,
+            (unsigned long long)site->TotalAllocs,
+            site->TotalAllocs / seconds, lines[i].Name);
+        if (site->StackHash)
+            NvOsHeapPrintf(file, " [%08x]", site->StackHash);
+        NvOsHeapPrintf(file, "\n");
+
+        height = NvOsCallstackGetHeight((NvCallstack *)lines[i].Stack);
+        for (frame = 0; frame < height; frame++)
+        {
+            char buf[256];
+
+            NvOsCallstackGetFrame(buf, sizeof(buf),
+                (NvCallstack *)lines[i].Stack, frame);
+            NvOsHeapPrintf(file, "%57s#%u %s\n", "", frame, buf);
+        }
+    }
+
+cleanup:
+    NvOsFreeInternal(lines);
+    NvOsFreeInternal(sites);
+    NvOsFreeInternal((void *)stacks);
+}
+
+#endif // __linux__
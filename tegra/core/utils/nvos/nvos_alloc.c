@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007 - 2013 NVIDIA Corporation.  All Rights Reserved.
+ * Copyright (c) 2007 - 2014 NVIDIA Corporation.  All Rights Reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property and
  * proprietary rights in and to this software and related documentation.  Any
@@ -24,6 +24,25 @@
 typedef NvU64 Guardband;
 typedef struct AllocHeaderRec AllocHeader;
 
+#if NVOS_HEAP_PROFILE
+/* The site pointer can leave the header short of the alignment of the block
+ * it is carved from (twice the pointer size for malloc): size, site and
+ * preguard are 24 bytes on LP64. The site shares a union with enough bytes
+ * to round the header up, sized from the layout of the unpadded fields. */
+struct AllocHeaderFieldsRec
+{
+    size_t              size;
+    void               *site;
+    Guardband           preguard;
+};
+
+#define ALLOC_HEADER_ALIGN (2 * sizeof(void *))
+#define ALLOC_HEADER_PAD \
+    ((ALLOC_HEADER_ALIGN - \
+      sizeof(struct AllocHeaderFieldsRec) % ALLOC_HEADER_ALIGN) % \
+     ALLOC_HEADER_ALIGN)
+#endif
+
 /* Information about allocations.
  *
  * Structure for user allocations is:
@@ -33,9 +52,20 @@ typedef struct AllocHeaderRec AllocHeader;
 struct AllocHeaderRec
 {
     size_t              size;
+#if NVOS_HEAP_PROFILE
+    union
+    {
+        void           *site;
+        NvU8            pad[sizeof(void *) + ALLOC_HEADER_PAD];
+    } profile;
+#endif
     Guardband           preguard;
 };
 
+#if NVOS_HEAP_PROFILE
+NV_CT_ASSERT((sizeof(AllocHeader) % ALLOC_HEADER_ALIGN) == 0);
+#endif
+
 #define COMPUTE_GUARDED_SIZE(size) \
     (sizeof(AllocHeader) + size + sizeof(Guardband))
 
@@ -105,6 +135,9 @@ GuardedAlloc(size_t size)
 
     ptr = header + 1;
     header->size = size;
+#if NVOS_HEAP_PROFILE
+    header->profile.site = NULL;
+#endif
     NvOsMemcpy(&header->preguard, &s_preGuard, sizeof(Guardband));
     NvOsMemcpy(((NvU8 *) ptr) + size, &s_postGuard, sizeof(Guardband));
 
@@ -168,6 +201,192 @@ GuardedFree(void *ptr)
 
 #if NVOS_RESTRACKER_COMPILED
 
+/*
+ *  Get the size of an alloc.
+ */
+size_t
+NvOsGetAllocSize(void *ptr)
+{
+    AllocHeader *header;
+
+    if (ptr == NULL)
+        return 0;
+
+    header = GET_GUARDED_HEADER(ptr);
+
+    if (NvOsMemcmp(&header->preguard, &s_preGuard, sizeof(Guardband)) == 0)
+        return header->size;
+
+    return 0;
+}
+
+#endif // NVOS_RESTRACKER_COMPILED
+
+/* Need this in the export table, will be called if we mix debug application
+ *  and release NvOs.*/
+#if !(NV_DEBUG)
+// If NV_DEBUG, we already have declarations.
+void *NvOsAllocLeak(size_t size, const char *filename, int line);
+void *NvOsReallocLeak(void *ptr, size_t size, const char *filename, int line);
+void NvOsFreeLeak(void *ptr, const char *filename, int line);
+#endif
+
+#if NVOS_HEAP_PROFILE
+
+/* Profiled allocations carry the site they were counted against in their
+ * header, so that freeing them needs no lookup. Debug builds keep the full
+ * guard bands. Release builds only write and check the guard in the header:
+ * the band after the buffer and the fill touch cache lines the caller may
+ * never use, which costs more than the profiling itself. */
+#if NV_DEBUG
+#define PROFILED_GUARDS 1
+#else
+#define PROFILED_GUARDS 0
+#endif
+
+static NvBool
+ProfiledVerify(void *ptr)
+{
+    AllocHeader *header;
+
+    if (PROFILED_GUARDS)
+        return GuardedVerify(ptr);
+
+    header = GET_GUARDED_HEADER(ptr);
+    if (header->preguard != s_preGuard)
+    {
+        NvOsDebugPrintf("Allocation header compromised or already freed "
+                        "(userptr: 0x%08x)\n", ptr);
+        return NV_FALSE;
+    }
+
+    return NV_TRUE;
+}
+
+static void *
+ProfiledAlloc(size_t size,
+              const char *filename,
+              int line,
+              const void *caller)
+{
+    AllocHeader *header;
+    void *ptr;
+
+    if (PROFILED_GUARDS)
+    {
+        ptr = GuardedAlloc(size);
+        if (ptr == NULL)
+            return NULL;
+        header = GET_GUARDED_HEADER(ptr);
+    }
+    else
+    {
+        header = NvOsAllocInternal(sizeof(AllocHeader) + size);
+        if (header == NULL)
+            return NULL;
+        ptr = header + 1;
+        header->size = size;
+        header->preguard = s_preGuard;
+    }
+
+    header->profile.site =
+        NvOsHeapProfileAllocInternal(size, filename, (NvU32) line, caller);
+
+    return ptr;
+}
+
+static void *
+ProfiledRealloc(void *ptr,
+                size_t size,
+                const char *filename,
+                int line,
+                const void *caller)
+{
+    AllocHeader *header;
+    size_t oldsize;
+    void *oldsite;
+
+    if (ptr == NULL)
+        return ProfiledAlloc(size, filename, line, caller);
+
+    if (!ProfiledVerify(ptr))
+        GUARDED_DIE();
+
+    header = GET_GUARDED_HEADER(ptr);
+    oldsize = header->size;
+    oldsite = header->profile.site;
+
+    if (PROFILED_GUARDS)
+    {
+        ptr = GuardedRealloc(ptr, size);
+        if (ptr == NULL)
+            return NULL;
+        header = GET_GUARDED_HEADER(ptr);
+    }
+    else
+    {
+        header = NvOsReallocInternal(header, sizeof(AllocHeader) + size);
+        if (header == NULL)
+            return NULL;
+        ptr = header + 1;
+        header->size = size;
+    }
+
+    /* The block moves to the site of the realloc, as it is the last code
+     * to have sized it */
+    NvOsHeapProfileFreeInternal(oldsite, oldsize);
+    header->profile.site =
+        NvOsHeapProfileAllocInternal(size, filename, (NvU32) line, caller);
+
+    return ptr;
+}
+
+static void
+ProfiledFree(void *ptr)
+{
+    AllocHeader *header;
+
+    if (ptr == NULL)
+        return;
+
+    header = GET_GUARDED_HEADER(ptr);
+
+    /* Only trust the site pointer of an intact header */
+    if (ProfiledVerify(ptr))
+        NvOsHeapProfileFreeInternal(header->profile.site, header->size);
+    else
+        GUARDED_DIE();
+
+    if (PROFILED_GUARDS)
+    {
+        GuardedFree(ptr);
+    }
+    else
+    {
+        header->preguard = s_freedGuard;
+        NvOsFreeInternal(header);
+    }
+}
+
+void * NvOsAllocLeak(size_t size, const char *filename, int line)
+    { return ProfiledAlloc(size, filename, line,
+                           __builtin_return_address(0)); }
+void * NvOsReallocLeak(void *ptr, size_t size, const char *filename, int line)
+    { return ProfiledRealloc(ptr, size, filename, line,
+                             __builtin_return_address(0)); }
+void NvOsFreeLeak(void *ptr, const char *filename, int line)
+    { ProfiledFree(ptr); }
+
+void * NvOsAlloc(size_t size)
+    { return ProfiledAlloc(size, NULL, 0, __builtin_return_address(0)); }
+void * NvOsRealloc(void *ptr, size_t size)
+    { return ProfiledRealloc(ptr, size, NULL, 0,
+                             __builtin_return_address(0)); }
+void NvOsFree(void *ptr)
+    { ProfiledFree(ptr); }
+
+#elif NVOS_RESTRACKER_COMPILED
+
 static void *
 TrackedAlloc(size_t size,
              const char *filename,
@@ -321,25 +540,6 @@ TrackedFree(void *ptr,
     GuardedFree(ptr);
 }
 
-/*
- *  Get the size of an alloc.
- */
-size_t
-NvOsGetAllocSize(void *ptr)
-{
-    AllocHeader *header;
-
-    if (ptr == NULL)
-        return 0;
-
-    header = GET_GUARDED_HEADER(ptr);
-
-    if (NvOsMemcmp(&header->preguard, &s_preGuard, sizeof(Guardband)) == 0)
-        return header->size;
-
-    return 0;
-}
-
 /* Need this in the export table, will be called if we mix release application
  *  and debug NvOs.*/
 static char message[] = "Release app, no line data";
@@ -358,16 +558,7 @@ void * NvOsRealloc(void *ptr, size_t size)
 void NvOsFree(void *ptr)
     { NvOsFreeLeak(ptr, message, 0); }
 
-#else // NVOS_RESTRACKER_COMPILED
-
-/* Need this in the export table, will be called if we mix debug application
- *  and release NvOs.*/
-#if !(NV_DEBUG)
-// If NV_DEBUG, we already have declarations.
-void *NvOsAllocLeak(size_t size, const char *filename, int line);
-void *NvOsReallocLeak(void *ptr, size_t size, const char *filename, int line);
-void NvOsFreeLeak(void *ptr, const char *filename, int line);
-#endif
+#else // NVOS_HEAP_PROFILE || NVOS_RESTRACKER_COMPILED
 
 void * NvOsAllocLeak(size_t size, const char *filename, int line)
     { return GuardedAlloc(size); }
@@ -383,4 +574,4 @@ void * NvOsRealloc(void *ptr, size_t size)
 void NvOsFree(void *ptr)
     { NvOsFreeInternal(ptr); }
 
-#endif // NVOS_RESTRACKER_COMPILED
+#endif // NVOS_HEAP_PROFILE || NVOS_RESTRACKER_COMPILED
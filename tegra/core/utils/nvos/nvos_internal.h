@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2008-2013 NVIDIA Corporation.  All Rights Reserved.
+ * Copyright (c) 2008-2014 NVIDIA Corporation.  All Rights Reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property and
  * proprietary rights in and to this software and related documentation.  Any
@@ -58,10 +58,34 @@ void *NvOsAllocInternal(size_t size);
 void *NvOsReallocInternal(void *ptr, size_t size);
 void NvOsFreeInternal(void *ptr);
 
+// Set this to non-zero to account NvOsAlloc memory per call site (Linux
+// only, see nvos_heap_profile.h). NvOsAlloc memory is then profiled instead
+// of being tracked by the resource tracker.
+#if !defined(NVOS_HEAP_PROFILE)
+#define NVOS_HEAP_PROFILE 0
+#endif
+
+#if NVOS_HEAP_PROFILE
+// Counts an allocation against its site and returns the site, to be passed
+// back when the allocation is freed.
+void *NvOsHeapProfileAllocInternal(size_t size, const char *file,
+    NvU32 line, const void *caller);
+void NvOsHeapProfileFreeInternal(void *site, size_t size);
+#endif
+
+// Set this to non-zero to build the process-local mutexes, conditions and
+// semaphores on futexes (Linux only, see nvos_futex.h).
+#if !defined(NVOS_USE_FUTEX)
+#define NVOS_USE_FUTEX 0
+#endif
 
 // The internal thread packages are preemptive
 NvError NvOsMutexCreateInternal( NvOsMutexHandle *mutex );
 void NvOsMutexLockInternal( NvOsMutexHandle mutex );
+#if NVOS_USE_FUTEX
+// Lock with the caller's return address, for the contention counters
+void NvOsMutexLockAtInternal( NvOsMutexHandle mutex, const void *site );
+#endif
 void NvOsMutexUnlockInternal( NvOsMutexHandle mutex );
 void NvOsMutexDestroyInternal( NvOsMutexHandle mutex );
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007 - 2009 NVIDIA Corporation.  All Rights Reserved.
+ * Copyright (c) 2007 - 2014 NVIDIA Corporation.  All Rights Reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property and
  * proprietary rights in and to this software and related documentation.  Any
@@ -47,7 +47,11 @@ NvOsMutexLock(NvOsMutexHandle mutex)
     if (g_UseCoopThread)
         CoopMutexLock(mutex);
     else
+#if NVOS_USE_FUTEX
+        NvOsMutexLockAtInternal(mutex, __builtin_return_address(0));
+#else
         NvOsMutexLockInternal(mutex);
+#endif
 }
 
 void 
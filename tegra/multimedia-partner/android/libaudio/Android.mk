@@ -1,5 +1,5 @@
 #
-# Copyright (c) 2011-2012, NVIDIA CORPORATION.  All rights reserved.
+# Copyright (c) 2011-2014, NVIDIA CORPORATION.  All rights reserved.
 #
 
 USE_NEW_LIBAUDIO = 1
@@ -93,6 +93,9 @@ LOCAL_C_INCLUDES += \
 LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/hw
 
 LOCAL_CFLAGS += -DTEGRA_TEST_LIBAUDIO
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+    LOCAL_CFLAGS += -mfpu=neon
+endif
 ifeq ($(BOARD_SUPPORT_AUDIO_TUNE), true)
 	LOCAL_CFLAGS += -DAUDIO_TUNE
 endif
@@ -101,6 +104,8 @@ LOCAL_NVIDIA_NO_WARNINGS_AS_ERRORS := 1
 
 LOCAL_SRC_FILES := \
     nvaudio_list.c \
+    nvaudio_mix.c \
+    nvaudio_resampler.c \
     nvaudio_hw.c \
     nvaudio_submix.cpp \
     nvaudio_service.cpp
@@ -110,6 +115,41 @@ endif
 
 include $(NVIDIA_SHARED_LIBRARY)
 
+#
+# Build the mixer benchmark
+#
+include $(NVIDIA_DEFAULTS)
+
+LOCAL_ARM_MODE := arm
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+    LOCAL_CFLAGS += -mfpu=neon
+endif
+
+LOCAL_MODULE := nvaudio_mix_bench
+LOCAL_MODULE_TAGS := nvidia_tests
+
+LOCAL_SRC_FILES := \
+    nvaudio_mix.c \
+    nvaudio_mix_bench.c
+
+include $(NVIDIA_EXECUTABLE)
+
+#
+# Build the resampler quality test, it runs on the host
+#
+include $(NVIDIA_DEFAULTS)
+
+LOCAL_MODULE := nvaudio_resampler_test
+LOCAL_MODULE_TAGS := nvidia_tests
+
+LOCAL_SRC_FILES := \
+    nvaudio_resampler.c \
+    nvaudio_resampler_test.c
+
+LOCAL_LDLIBS += -lm -lpthread -lrt
+
+include $(NVIDIA_HOST_EXECUTABLE)
+
 #
 # Build libaudiopolicy
 #
@@ -68,6 +68,8 @@
 #endif
 
 #include "nvaudio_submix.h"
+#include "nvaudio_mix.h"
+#include "nvaudio_resampler.h"
 
 /*****************************************************************************
  * MACROS
@@ -191,19 +193,6 @@ enum audio_sample_rates {
     RATE_192000 = (1 << 14),
 };
 
- enum tegra_audio_channel_id {
-    LF = 1,                           // Left Front
-    RF,                               // Right Front
-    CF,                               // Center Front
-    LS,                               // Left Surround
-    RS,                               // Right Surround
-    LFE,                              // Low Frequency Effect
-    CS,                               // Center Surround
-    LR,                               // Rear Left
-    RR,                               // Rear Right
-    TEGRA_AUDIO_CHANNEL_ID_LAST
-};
-
 enum at_cmd_type {
     AT_PROFILE,
     AT_VOLUME,
@@ -242,26 +231,10 @@ static const uint32_t tegra_dest_ch_map[8] = {
     (LS << 24) | (RS << 28)
 };
 
-static const uint32_t tegra_stereo_dwn_mix_ch_map[8] = {
-    (LF << 0),
-    (LF << 0) | (RF << 4),
-    (CF << 0) | (LF << 4) | (RF << 8),
-    (LS << 0) | (LF << 4) | (RF << 8) | (RS << 12),
-    (CF << 0) | (LF << 4) | (RF << 8) | (LS << 12) | (RS << 16),
-    (CF << 0) | (LF << 4) | (RF << 8) | (LS << 12) | (RS << 16) | (LFE << 20),
-    (CF << 0) | (LF << 4) | (RF << 8) | (LR << 12) | (RR << 16) | (LS << 20) |\
-    (RS << 24),
-    (CF << 0) | (LF << 4) | (RF << 8) | (LR << 12) | (RR << 16) | (LS << 20) |\
-    (RS << 24) |(LFE << 28)
-};
-
 static const char* tegra_audio_chid_str[TEGRA_AUDIO_CHANNEL_ID_LAST] =
 {"", "LF", "RF", "CF", "LS", "RS", "LFE", "CS", "LR", "RR"};
 
 
-static const uint32_t ch_mask[8] =
-{ 0xF, 0xFF, 0xFFF, 0xFFFF, 0xFFFFF, 0xFFFFFF, 0xFFFFFFF, 0xFFFFFFFF};
-
 struct audio_params {
     uint32_t src_channels;
     uint32_t src_ch_map;
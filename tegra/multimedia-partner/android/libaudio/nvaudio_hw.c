@@ -65,16 +65,6 @@ static int set_route_by_array(struct mixer *mixer, list_handle route_list,
 static void close_alsa_dev(struct audio_stream *stream, struct alsa_dev *dev);
 static uint32_t audio_rate_mask(uint32_t rate);
 static int get_max_aux_channels (struct alsa_dev *dev);
-static int shuffle_channels(int16_t *buffer, uint32_t bytes, uint32_t channels,
-    uint32_t src_ch_map, uint32_t dst_ch_map);
-static int  downmix(int16_t *src_buffer, uint32_t src_ch_map, uint32_t src_ch,
-    int16_t *dest_buffer, uint32_t dst_ch_map, uint32_t dest_ch,
-    uint32_t framecount);
-static void downmix_to_stereo(int16_t *buffer, uint32_t channels,
-    uint32_t frames);
-static int upmix(int16_t *src_buffer, uint32_t src_ch_map, uint32_t src_ch,
-    int16_t *dest_buffer, uint32_t dst_ch_map, uint32_t dest_ch,
-    uint32_t framecount);
 static void process_audio(struct audio_params *p_audio_params,
     size_t num_of_frames);
 static uint32_t get_ch_map(uint32_t channels);
@@ -1077,11 +1067,7 @@ static void apply_volume(int16_t* buffer, size_t frames,
         vol = temp;
     }
 
-    do {
-        for (i = 0; i < d_channels; i++)
-            buffer[i] = (int16_t)(((int32_t)buffer[i] * vol[i]) >> SHIFT_Q15);
-        buffer += d_channels;
-    } while(--frames);
+    nvaudio_gain_s16(buffer, frames, d_channels, vol);
 }
 
 /*
@@ -1736,6 +1722,105 @@ static void set_mute(struct alsa_dev* dev, uint32_t devices, bool mute)
     }
 }
 
+/* Wraps the HAL polyphase resampler in the platform resampler interface so
+ * streams can use either one */
+struct nvaudio_resampler_itfe {
+    struct resampler_itfe itfe;
+    struct nvaudio_resampler *resampler;
+};
+
+static void nv_resampler_reset(struct resampler_itfe *resampler)
+{
+    struct nvaudio_resampler_itfe *rsx =
+                                (struct nvaudio_resampler_itfe *)resampler;
+
+    nvaudio_resampler_reset(rsx->resampler);
+}
+
+static int nv_resampler_resample_from_provider(
+                                struct resampler_itfe *resampler,
+                                int16_t *out, size_t *out_frames)
+{
+    /* Streams always push their input */
+    return -ENOSYS;
+}
+
+static int nv_resampler_resample_from_input(struct resampler_itfe *resampler,
+                                            int16_t *in, size_t *in_frames,
+                                            int16_t *out, size_t *out_frames)
+{
+    struct nvaudio_resampler_itfe *rsx =
+                                (struct nvaudio_resampler_itfe *)resampler;
+
+    return nvaudio_resampler_process(rsx->resampler, in, in_frames,
+                                     out, out_frames);
+}
+
+static int32_t nv_resampler_delay_ns(struct resampler_itfe *resampler)
+{
+    struct nvaudio_resampler_itfe *rsx =
+                                (struct nvaudio_resampler_itfe *)resampler;
+
+    return nvaudio_resampler_delay_ns(rsx->resampler);
+}
+
+/* Creates the HAL resampler, or the platform one for rate pairs it does not
+ * support */
+static int nvaudio_create_resampler(uint32_t in_rate, uint32_t out_rate,
+                                    uint32_t channels, uint32_t quality,
+                                    struct resampler_itfe **resampler)
+{
+    struct nvaudio_resampler_itfe *rsx;
+    enum nvaudio_resampler_quality nv_quality;
+    int ret;
+
+    if (quality <= RESAMPLER_QUALITY_VOIP)
+        nv_quality = NVAUDIO_RESAMPLER_QUALITY_LOW;
+    else if (quality == RESAMPLER_QUALITY_DEFAULT)
+        nv_quality = NVAUDIO_RESAMPLER_QUALITY_MEDIUM;
+    else
+        nv_quality = NVAUDIO_RESAMPLER_QUALITY_HIGH;
+
+    rsx = calloc(1, sizeof(*rsx));
+    if (!rsx)
+        return -ENOMEM;
+
+    ret = nvaudio_resampler_create(in_rate, out_rate, channels, nv_quality,
+                                   &rsx->resampler);
+    if (ret < 0) {
+        ALOGW("%s: %d -> %d Hz not supported, using platform resampler",
+              __FUNCTION__, in_rate, out_rate);
+        free(rsx);
+        return create_resampler(in_rate, out_rate, channels, quality, NULL,
+                                resampler);
+    }
+
+    rsx->itfe.reset = nv_resampler_reset;
+    rsx->itfe.resample_from_provider = nv_resampler_resample_from_provider;
+    rsx->itfe.resample_from_input = nv_resampler_resample_from_input;
+    rsx->itfe.delay_ns = nv_resampler_delay_ns;
+    *resampler = &rsx->itfe;
+
+    return 0;
+}
+
+static void nvaudio_release_resampler(struct resampler_itfe *resampler)
+{
+    struct nvaudio_resampler_itfe *rsx =
+                                (struct nvaudio_resampler_itfe *)resampler;
+
+    if (!resampler)
+        return;
+
+    if (resampler->reset != nv_resampler_reset) {
+        release_resampler(resampler);
+        return;
+    }
+
+    nvaudio_resampler_release(rsx->resampler);
+    free(rsx);
+}
+
 /* Call with device and out stream lock held */
 static int set_out_resampler(struct nvaudio_stream_out* out,
                             struct alsa_dev *dev,
@@ -1778,12 +1863,11 @@ static int set_out_resampler(struct nvaudio_stream_out* out,
         return 0;
     }
 
-    ret = create_resampler(out->rate,
-                           dev->config.rate,
-                           out->channel_count,
-                           quality,
-                           NULL,
-                           &out->resampler[id]);
+    ret = nvaudio_create_resampler(out->rate,
+                                   dev->config.rate,
+                                   out->channel_count,
+                                   quality,
+                                   &out->resampler[id]);
     if (ret < 0) {
         ALOGE("Failed to create resampler");
         goto err_exit;
@@ -1810,7 +1894,7 @@ static int set_out_resampler(struct nvaudio_stream_out* out,
 
 err_exit:
     if (out->resampler[id]) {
-        release_resampler(out->resampler[id]);
+        nvaudio_release_resampler(out->resampler[id]);
         out->resampler[id] = NULL;
     }
 
@@ -1834,12 +1918,11 @@ static int set_in_resampler(struct nvaudio_stream_in* in,
     }
 
     if (!in->resampler && (in->rate != dev->config.rate)) {
-        ret = create_resampler(dev->config.rate,
-                               in->rate,
-                               in->channel_count,
-                               quality,
-                               NULL,
-                               &in->resampler);
+        ret = nvaudio_create_resampler(dev->config.rate,
+                                       in->rate,
+                                       in->channel_count,
+                                       quality,
+                                       &in->resampler);
         if (ret < 0) {
             ALOGE("Failed to create resampler");
             goto err_exit;
@@ -1871,7 +1954,7 @@ static int set_in_resampler(struct nvaudio_stream_in* in,
 
 err_exit:
     if (in->resampler) {
-        release_resampler(in->resampler);
+        nvaudio_release_resampler(in->resampler);
         in->resampler = NULL;
     }
 
@@ -1897,329 +1980,9 @@ static int get_max_aux_channels (struct alsa_dev *dev)
     return channels;
 }
 
-static int shuffle_channels(int16_t *buffer, uint32_t bytes, uint32_t channels,
-    uint32_t src_ch_map, uint32_t dst_ch_map)
-{
-    uint32_t frames = (bytes) /(channels*2);
-    int16_t tmp[TEGRA_AUDIO_CHANNEL_ID_LAST] = {0};
-
-    if (src_ch_map == dst_ch_map)
-        return -EINVAL;
-
-    do {
-        uint32_t i, mask;
-        for (i = 0, mask = 0xF; i < channels; i++, mask <<= 4) {
-            uint32_t src_ch_id = src_ch_map & mask;
-            if ((dst_ch_map & mask) == src_ch_id)
-               continue;
-
-            tmp[src_ch_id >> (i << 2)] = buffer[i];
-        }
-
-        for (i = 0, mask = 0xF; i < channels; i++, mask <<= 4) {
-            uint32_t dst_ch_id = dst_ch_map & mask;
-            if ((src_ch_map & mask) == dst_ch_id)
-                continue;
-
-            buffer[i] = tmp[dst_ch_id >> (i << 2)];
-        }
-        buffer += channels;
-    } while(--frames);
-
-    return 0;
-}
-
-static inline int16_t sat16(int32_t val)
-{
-    if ((val >> 15) ^ (val >> 31))
-        val = 0x7FFF ^ (val >> 31);
-
-    return val;
-}
-
-/*This function does inplace computation (src and dest buffers are same)
-if src_buffer is equal to dest_buffer*/
-static int  downmix(int16_t *src_buffer, uint32_t src_ch_map, uint32_t src_ch,
-    int16_t *dest_buffer, uint32_t dst_ch_map, uint32_t dest_ch,
-    uint32_t framecount)
-{
-    uint32_t i, mask;
-    uint32_t j, mask2;
-    int32_t tmp;
-
-    if (src_ch <= dest_ch)
-        return -EINVAL;
-
-    do {
-        for (i = 0, mask = 0xF; i < dest_ch; i++, mask <<= 4) {
-            tmp = 0;
-            if ((dst_ch_map & mask) == LFE)
-                continue;
-
-            for (j = 0, mask2 = 0xF; j < src_ch; j++, mask2 <<= 4) {
-                if ((src_ch_map & mask2) != LFE)
-                     tmp += src_buffer[j];
-            }
-            dest_buffer[i] = sat16(tmp);
-        }
-        src_buffer += src_ch;
-        dest_buffer += dest_ch;
-    } while(--framecount);
-
-    return 0;
-}
-
- /*This function does inplace computation (src and dest buffers are same)*/
-static void downmix_to_stereo(int16_t *buffer, uint32_t channels,
-    uint32_t frames)
-{
-    uint32_t i, count;
-
-    /*3 channels to stereo downmix*/
-    if(3 == channels)
-    {
-        count = 0;
-        for(i = 0; i < frames*channels; i+=channels)
-        {
-            short cmix;
-            short left;
-            short right;
-           //cmix = c*0.70703125
-            cmix = ((buffer[i] * 23167) << 1) >> 16;
-           // left = 0.58798 (left + cmix) = 0.58798*left + 0.41572*c
-            left = ((19267*(buffer[i+1] + cmix)) << 1) >> 16;
-           // right = 0.58798 (right + cmix) = 0.58798*right + 0.41572*c
-            right = ((19267*(buffer[i+2] + cmix)) << 1) >> 16;
-            buffer[count++] = left;
-            buffer[count++] = right;
-            }
-    }
-
-    /*4 channels to stereo downmix*/
-    if(4 == channels)
-    {
-        count = 0;
-        for(i = 0; i < frames*channels; i+=channels)
-        {
-            short cmix;
-            short rearmix;
-            short left;
-            short right;
-            //cmix = c*0.70703125
-            cmix = ((buffer[i] * 23167) << 1) >> 16;
-            //rearmix = rear*0.70703125
-            rearmix = ((buffer[i+3] * 23167) << 1) >> 16;
-            // left = 0.414 (left + cmix + rearmix) = 0.414*left
-            //+ 0.2927*c + 0.2927*rear
-            left = ((13566*(buffer[i+1] + cmix + rearmix)) << 1) >> 16;
-            // right = 0.414 (right + cmix + rearmix) = 0.414*right
-            //+ 0.2927*c + 0.2927*rear
-            right = ((13566*(buffer[i+2] + cmix + rearmix)) << 1) >> 16;
-            buffer[count++] = left;
-            buffer[count++] = right;
-        }
-    }
-
-    /*5 channels to stereo downmix*/
-    if(5 == channels)
-    {
-        count = 0;
-        for(i = 0; i < frames*channels; i+=channels)
-        {
-             short cmix;
-             short l_rearmix;
-             short r_rearmix;
-             short left;
-             short right;
-             //cmix = c*0.70703125
-             cmix = ((buffer[i] * 23167) << 1) >> 16;
-             //l_rearmix = l_rear*0.70703125
-             l_rearmix = ((buffer[i+3] * 23167) << 1) >> 16;
-             //r_rearmix = r_rear*0.70703125
-             r_rearmix = ((buffer[i+4] * 23167) << 1) >> 16;
-            // left = 0.414 (left + cmix + rearmix) = 0.414*left
-            //+ 0.2927*c + 0.2927*rear
-             left = ((13566*(buffer[i+1] + cmix + l_rearmix)) << 1) >> 16;
-             // right = 0.414 (right + cmix + rearmix) = 0.414*right
-             //+ 0.2927*c + 0.2927*rear
-             right = ((13566*(buffer[i+2] + cmix + r_rearmix)) << 1) >> 16;
-             buffer[count++] = left;
-             buffer[count++] = right;
-        }
-    }
-
-    /*5.1 channels to stereo downmix (NOTE: LFE is not mixed)*/
-    if(6 == channels)
-    {
-        count = 0;
-        for(i = 0; i < frames*channels; i+=channels)
-        {
-            short cmix;
-            short l_rearmix;
-            short r_rearmix;
-            short left;
-            short right;
-            //cmix = c*0.70703125
-            cmix = ((buffer[i] * 23167) << 1) >> 16;
-            //l_rearmix = l_rear*0.70703125
-            l_rearmix = ((buffer[i+3] * 23167) << 1) >> 16;
-            //r_rearmix = r_rear*0.70703125
-            r_rearmix = ((buffer[i+4] * 23167) << 1) >> 16;
-            // left = 0.414 (left + cmix + rearmix) = 0.414*left
-            //+ 0.2927*c + 0.2927*rear
-            left = ((13566*(buffer[i+1] + cmix + l_rearmix)) << 1) >> 16;
-            // right = 0.414 (right + cmix + rearmix) = 0.414*right
-            //+ 0.2927*c + 0.2927*rear
-            right = ((13566*(buffer[i+2] + cmix + r_rearmix)) << 1) >> 16;
-            buffer[count++] = left;
-            buffer[count++] = right;
-        }
-    }
-
-    /*7 channels to stereo downmix*/
-    if(7 == channels)
-    {
-        count = 0;
-        for(i = 0; i < frames*channels; i+=channels)
-        {
-            short cmix;
-            short l_rearmix;
-            short r_rearmix;
-            short l_sidemix;
-            short r_sidemix;
-            short left;
-            short right;
-            //cmix = c*0.70703125
-            cmix = ((buffer[i] * 23167) << 1) >> 16;
-            //l_rearmix = l_rear*0.70703125
-            l_rearmix = ((buffer[i+3] * 23167) << 1) >> 16;
-            //r_rearmix = r_rear*0.70703125
-            r_rearmix = ((buffer[i+4] * 23167) << 1) >> 16;
-            //l_sidemix = l_side*0.70703125
-            l_sidemix = ((buffer[i+5] * 23167) << 1) >> 16;
-            //r_sidemix = r_side*0.70703125
-            r_sidemix = ((buffer[i+6] * 23167) << 1) >> 16;
-            // left = 0.320 (left + cmix + rearmix + sidemix) =
-            //0.320*left + 0.2927*c + 0.2927*rear + 0.2265*side
-            left = ((10486*(buffer[i+1] + cmix + l_rearmix + l_sidemix)) << 1)
-                >> 16;
-            // right = 0.320 (right + cmix + rearmix + sidemix) =
-            //0.320*right + 0.2265*c + 0.2265*rear + 0.2265*side
-            right = ((10486*(buffer[i+2] + cmix + r_rearmix + r_sidemix)) << 1)
-                >> 16;
-            buffer[count++] = left;
-            buffer[count++] = right;
-        }
-    }
-
-    /*7.1 channels to stereo downmix (NOTE: LFE is not mixed)*/
-    if(8 == channels)
-    {
-    count = 0;
-    for(i = 0; i < frames*channels; i+=channels)
-    {
-        short cmix;
-        short l_rearmix;
-        short r_rearmix;
-        short l_sidemix;
-        short r_sidemix;
-        short left;
-        short right;
-        //cmix = c*0.70703125
-        cmix = ((buffer[i] * 23167) << 1) >> 16;
-        //l_rearmix = l_rear*0.70703125
-        l_rearmix = ((buffer[i+3] * 23167) << 1) >> 16;
-        //r_rearmix = r_rear*0.70703125
-        r_rearmix = ((buffer[i+4] * 23167) << 1) >> 16;
-        //l_sidemix = l_side*0.70703125
-        l_sidemix = ((buffer[i+5] * 23167) << 1) >> 16;
-        //r_sidemix = r_side*0.70703125
-        r_sidemix = ((buffer[i+6] * 23167) << 1) >> 16;
-
-        // left = 0.320 (left + cmix + rearmix + sidemix) = 0.320*left
-        //+ 0.2927*c + 0.2927*rear + 0.2265*sid
-        left = ((10486*(buffer[i+1] + cmix + l_rearmix + l_sidemix)) << 1)
-           >> 16;
-
-        // right = 0.320 (right + cmix + rearmix + sidemix) = 0.320*right
-        //+ 0.2265*c + 0.2265*rear + 0.2265*side
-        right = ((10486*(buffer[i+2] + cmix + r_rearmix + r_sidemix)) << 1)
-            >> 16;
-
-        buffer[count++] = left;
-        buffer[count++] = right;
-    }
-    }
-}
-
- /* If dest_buffer is NULL then  src_buffer must be large enough to fill the upmixed data*/
-static int upmix(int16_t *src_buffer, uint32_t src_ch_map, uint32_t src_ch,
-    int16_t *dest_buffer, uint32_t dst_ch_map, uint32_t dest_ch,
-    uint32_t framecount)
-{
-    uint32_t i , mask;
-    uint32_t j, mask2;
-    uint32_t copy_upmix_flag = 0;
-    int16_t *p_dest_buffer;
-    int16_t *p_src_buffer;
-    uint32_t dest_buff_size;
-
-    if (dest_buffer == NULL) {
-        p_dest_buffer = dest_buffer = malloc(framecount*dest_ch*2);
-        p_src_buffer = src_buffer;
-        dest_buff_size = framecount*dest_ch*2;
-        copy_upmix_flag = 1;
-        if (!dest_buffer) {
-            ALOGE("Failed to allocate upmix buffer");
-            return -ENOMEM;
-        }
-    }
-
-    memset((void*)dest_buffer, 0, dest_ch*2*framecount);
-
-    if ((dst_ch_map & ch_mask[src_ch - 1]) == src_ch_map) {
-        do {
-            memcpy(dest_buffer, src_buffer, src_ch * sizeof(int16_t));
-            src_buffer += src_ch;
-            dest_buffer += dest_ch;
-        } while (--framecount);
-    }  else {
-        int dstIndexTab[8] = {0};
-        for (i = 0, mask = 0xF; i < src_ch; i++, mask <<= 4) {
-            if ((src_ch_map & mask) == (dst_ch_map & mask)) {
-                dstIndexTab[i] = i;
-                continue;
-            }
-            for (j = 0, mask2 = 0xF; j < dest_ch; j++, mask2 <<= 4) {
-                if (((src_ch_map & mask) >> (i << 2)) ==
-                ((dst_ch_map & mask2) >> (j << 2))) {
-                    dstIndexTab[i] = j;
-                    break;
-                }
-            }
-        }
-
-        do {
-            for (i = 0; i < src_ch; i++)
-                dest_buffer[dstIndexTab[i]] = src_buffer[i];
-
-            src_buffer += src_ch;
-            dest_buffer += dest_ch;
-        } while(--framecount);
-    }
-
-    if(copy_upmix_flag == 1) {
-        memcpy(p_src_buffer, p_dest_buffer, dest_buff_size);
-        free(p_dest_buffer);
-    }
-
-    return 0;
-}
-
 static void process_audio(struct audio_params *p_audio_params,
     size_t num_of_frames)
 {
-    uint32_t dwnmix_stereo_ch_map;
     uint32_t src_channels = p_audio_params->src_channels;
     uint32_t src_ch_map = p_audio_params->src_ch_map;
     int16_t* psrc_buffer = p_audio_params->psrc_buffer;
@@ -2239,41 +2002,15 @@ static void process_audio(struct audio_params *p_audio_params,
         mono_to_stereo(psrc_buffer,
             pdest_buffer,
             num_of_frames);
-    } else {
-        if (src_channels > dest_channels) { /*downmix*/
-            if (dest_channels == 2) {/*downmix to stereo*/
-                dwnmix_stereo_ch_map =
-                tegra_stereo_dwn_mix_ch_map[src_channels -
-                1];
-
-                if (src_ch_map != dwnmix_stereo_ch_map)
-                    shuffle_channels(psrc_buffer,
-                        num_of_frames*src_channels*2, src_channels,
-                        src_ch_map, dwnmix_stereo_ch_map);
-
-                downmix_to_stereo(psrc_buffer,
-                    src_channels, num_of_frames);
-            } else {
-                downmix(psrc_buffer, src_ch_map,
-                    src_channels, pdest_buffer,
-                    dest_ch_map, dest_channels,
-                    num_of_frames);
-            }
-        } else if (src_channels
-        < dest_channels) {
-            /*upmix*/
-            upmix(psrc_buffer,
-            src_ch_map,
-            src_channels,
-            psrc_buffer == pdest_buffer ? NULL : pdest_buffer,
-            dest_ch_map, dest_channels, num_of_frames);
-        } else if ((src_ch_map != dest_ch_map) &&
-            (src_channels == dest_channels)) {
-            /*shuffle*/
-            shuffle_channels(psrc_buffer,
-            num_of_frames*src_channels*2, src_channels,
-            src_ch_map, dest_ch_map);
-        }
+    } else if ((src_ch_map != dest_ch_map) ||
+        (src_channels != dest_channels)) {
+        /*downmix, upmix or shuffle*/
+        struct nvaudio_mix_matrix matrix;
+
+        if (!nvaudio_mix_matrix_init(&matrix, src_ch_map, src_channels,
+                dest_ch_map, dest_channels))
+            nvaudio_mix_matrix_apply(&matrix, psrc_buffer, pdest_buffer,
+                num_of_frames);
     }
 
     if ((vol[0] != INT_Q15(1) ||
@@ -2602,7 +2339,7 @@ static int open_out_alsa_dev(struct nvaudio_stream_out* out,
             reset_resampler = 1;
         } else {
             if (out->resampler[id] ) {
-            release_resampler(out->resampler[id]);
+            nvaudio_release_resampler(out->resampler[id]);
             out->resampler[id] = NULL;
             }
         }
@@ -2741,7 +2478,7 @@ static int open_out_alsa_dev(struct nvaudio_stream_out* out,
 
     if (out->resampler[id] && ((old_rate != dev->config.rate) ||
                                (out->rate == dev->config.rate))) {
-        release_resampler(out->resampler[id]);
+        nvaudio_release_resampler(out->resampler[id]);
         out->resampler[id] = NULL;
     }
 
@@ -2771,7 +2508,7 @@ static int open_out_alsa_dev(struct nvaudio_stream_out* out,
                     continue;
 
                 if (out_iter->resampler[id]) {
-                    release_resampler(out_iter->resampler[id]);
+                    nvaudio_release_resampler(out_iter->resampler[id]);
                     out_iter->resampler[id] = NULL;
                 }
 
@@ -2860,7 +2597,7 @@ static int open_in_alsa_dev(struct nvaudio_stream_in* in)
          dev->config.silence_threshold, dev->config.avail_min);
 
     if (in->resampler && (old_rate != dev->config.rate)) {
-        release_resampler(in->resampler);
+        nvaudio_release_resampler(in->resampler);
         in->resampler = NULL;
     }
 
@@ -3306,7 +3043,7 @@ static int nvaudio_out_set_sample_rate(struct audio_stream *stream,
         pthread_mutex_lock(&dev->lock);
 
         if (out->resampler[id]) {
-            release_resampler(out->resampler[id]);
+            nvaudio_release_resampler(out->resampler[id]);
             out->resampler[id] = NULL;
         }
         set_out_resampler(out, dev, RESAMPLER_QUALITY_DEFAULT);
@@ -3579,7 +3316,7 @@ static int nvaudio_out_set_parameters(struct audio_stream *stream,
 
                 pthread_mutex_lock(&dev->lock);
                 if (out->resampler[id]) {
-                    release_resampler(out->resampler[id]);
+                    nvaudio_release_resampler(out->resampler[id]);
                     out->resampler[id] = NULL;
                 }
                 set_out_resampler(out, dev, RESAMPLER_QUALITY_DEFAULT);
@@ -3767,8 +3504,6 @@ static ssize_t nvaudio_out_write(struct audio_stream_out *stream,
     int ret = 0;
     uint32_t src_ch_map, dest_ch_map;
     uint32_t dev_stream_cnt;
-    uint32_t i;
-    int32_t mix;
     int16_t *src_buffer;
     uint32_t sleep_periods;
     double sleep_time;
@@ -3901,11 +3636,7 @@ static ssize_t nvaudio_out_write(struct audio_stream_out *stream,
                     *(1000000000))/(dev->config.rate);
                 if (dev->buff_cnt + 1 < dev_stream_cnt) {
                     /*mix*/
-                    for (i = 0; i < bytes/2; i++) {
-                        mix = (int32_t)dev->mix_buffer[i] +
-                            (int32_t)src_buffer[i];
-                        dev->mix_buffer[i] = sat16(mix);
-                    }
+                    nvaudio_mix_s16(dev->mix_buffer, src_buffer, bytes/2);
                     if(dev->bytes < bytes)
                         dev->bytes = bytes;
                     dev->buff_cnt++;
@@ -3940,11 +3671,7 @@ static ssize_t nvaudio_out_write(struct audio_stream_out *stream,
                     pthread_mutex_lock(&out->lock);
                 } else {
                     /*mix*/
-                    for (i = 0; i < bytes/2; i++) {
-                        mix = (int32_t)dev->mix_buffer[i]
-                            + (int32_t)src_buffer[i];
-                        dev->mix_buffer[i] = sat16(mix);
-                    }
+                    nvaudio_mix_s16(dev->mix_buffer, src_buffer, bytes/2);
                     if(dev->bytes < bytes)
                         dev->bytes = bytes;
                     dev->buff_cnt++;
@@ -4165,13 +3892,8 @@ static ssize_t nvaudio_out_write(struct audio_stream_out *stream,
                         (1000000000))/(dev->config.rate);
                     if (dev->buff_cnt + 1 < dev_stream_cnt) {
                         /*mix*/
-                        for (i = 0;
-                                 i < (dev->config.period_size*out_frame_size)/2;
-                                 i++) {
-                            mix = (int32_t)dev->mix_buffer[i]
-                               + (int32_t)src_buffer[i];
-                            dev->mix_buffer[i] = sat16(mix);
-                        }
+                        nvaudio_mix_s16(dev->mix_buffer, src_buffer,
+                            (dev->config.period_size*out_frame_size)/2);
                         if(dev->bytes < (dev->config.period_size*out_frame_size))
                             dev->bytes = (dev->config.period_size*out_frame_size);
                         dev->buff_cnt++;
@@ -4205,13 +3927,8 @@ static ssize_t nvaudio_out_write(struct audio_stream_out *stream,
                         pthread_mutex_lock(&out->lock);
                     } else {
                         /*mix*/
-                        for (i = 0;
-                          i < (dev->config.period_size*out_frame_size)/2;
-                          i++) {
-                            mix = (int32_t)dev->mix_buffer[i]
-                               + (int32_t)src_buffer[i];
-                            dev->mix_buffer[i] = sat16(mix);
-                        }
+                        nvaudio_mix_s16(dev->mix_buffer, src_buffer,
+                            (dev->config.period_size*out_frame_size)/2);
                         if(dev->bytes < (dev->config.period_size*out_frame_size))
                             dev->bytes = (dev->config.period_size*out_frame_size);
                         dev->buff_cnt++;
@@ -4492,7 +4209,7 @@ static int nvaudio_in_set_sample_rate(struct audio_stream *stream,
 
     in->rate = rate;
     if (in->resampler) {
-        release_resampler(in->resampler);
+        nvaudio_release_resampler(in->resampler);
         in->resampler = NULL;
     }
     set_in_resampler(in, RESAMPLER_QUALITY_DEFAULT);
@@ -4636,7 +4353,7 @@ static int nvaudio_in_set_parameters(struct audio_stream *stream,
                     !(dev->devices & in->devices)) {
                     in->dev = dev;
                     if (in->resampler) {
-                        release_resampler(in->resampler);
+                        nvaudio_release_resampler(in->resampler);
                         in->resampler = NULL;
                     }
 
@@ -4710,7 +4427,7 @@ static int nvaudio_in_set_parameters(struct audio_stream *stream,
             in->channels = key_val;
 
             if (in->resampler) {
-                release_resampler(in->resampler);
+                nvaudio_release_resampler(in->resampler);
                 in->resampler = NULL;
             }
             set_in_resampler(in, RESAMPLER_QUALITY_DEFAULT);
@@ -5159,7 +4876,7 @@ static void nvaudio_dev_close_output_stream(struct audio_hw_device *dev,
 
     for (i = 0; i < DEV_ID_NON_CALL_MAX; i++) {
         if (out->resampler[i])
-            release_resampler(out->resampler[i]);
+            nvaudio_release_resampler(out->resampler[i]);
         if (out->buffer[i])
             free(out->buffer[i]);
         if (out->resampling_buffer[i]) {
@@ -6162,7 +5879,7 @@ static void nvaudio_dev_close_input_stream(struct audio_hw_device *dev,
     }
 
     if (in_stream->resampler)
-        release_resampler(in_stream->resampler);
+        nvaudio_release_resampler(in_stream->resampler);
     if (in_stream->buffer)
         free(in_stream->buffer);
 
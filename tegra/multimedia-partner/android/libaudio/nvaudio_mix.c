@@ -0,0 +1,642 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+/*
+ * PCM mixing and channel conversion used by the output path: saturating
+ * accumulation of streams into the mix buffer, per channel Q15 volume and
+ * channel matrixing for up/downmix and channel reordering.
+ *
+ * Each routine has a NEON and an SSE2 inner loop chosen at compile time and
+ * a portable loop for the tail and for other targets. The vector loops use
+ * the same arithmetic as the portable one, so the output does not depend on
+ * the backend.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "nvaudio_mix.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define NVAUDIO_MIX_NEON 1
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define NVAUDIO_MIX_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/* Frames converted per pass of the channel matrix */
+#define MATRIX_BLOCK_FRAMES     16
+
+/* Largest Q15 gain, keeps both halves of the SSE2 multiplier in 16 bits */
+#define GAIN_Q15_MAX            0xFFFE
+
+/* Sum of a matrix row is limited so that the 32 bit accumulators can not
+ * overflow */
+#define MATRIX_ROW_SUM_MAX      0xFF00
+
+/* -3 dB, as used by the legacy stereo downmix */
+#define FOLD_COEF               0.70703125f
+
+/* Scale of the legacy stereo downmix for 3 to 8 source channels (Q15) */
+static const int32_t stereo_downmix_scale[NVAUDIO_MIX_MAX_CHANNELS + 1] = {
+    0, 0, 0, 19267, 13566, 13566, 13566, 10486, 10486
+};
+
+static inline int16_t sat16(int32_t val)
+{
+    if ((val >> 15) ^ (val >> 31))
+        val = 0x7FFF ^ (val >> 31);
+
+    return val;
+}
+
+static inline uint32_t clamp_gain(uint32_t vol)
+{
+    return vol > GAIN_Q15_MAX ? GAIN_Q15_MAX : vol;
+}
+
+const char *nvaudio_mix_backend(void)
+{
+#if defined(NVAUDIO_MIX_NEON)
+    return "neon";
+#elif defined(NVAUDIO_MIX_SSE2)
+    return "sse2";
+#else
+    return "c";
+#endif
+}
+
+/*****************************************************************************
+ * Stream mixing
+ *****************************************************************************/
+void nvaudio_mix_s16(int16_t *dst, const int16_t *src, size_t samples)
+{
+    size_t i = 0;
+
+#if defined(NVAUDIO_MIX_NEON)
+    for (; i + 16 <= samples; i += 16) {
+        int16x8_t a0 = vld1q_s16(dst + i);
+        int16x8_t a1 = vld1q_s16(dst + i + 8);
+        int16x8_t b0 = vld1q_s16(src + i);
+        int16x8_t b1 = vld1q_s16(src + i + 8);
+
+        vst1q_s16(dst + i, vqaddq_s16(a0, b0));
+        vst1q_s16(dst + i + 8, vqaddq_s16(a1, b1));
+    }
+#elif defined(NVAUDIO_MIX_SSE2)
+    for (; i + 16 <= samples; i += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i a1 = _mm_loadu_si128((const __m128i *)(dst + i + 8));
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(src + i + 8));
+
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_adds_epi16(a0, b0));
+        _mm_storeu_si128((__m128i *)(dst + i + 8), _mm_adds_epi16(a1, b1));
+    }
+#endif
+
+    for (; i < samples; i++)
+        dst[i] = sat16((int32_t)dst[i] + (int32_t)src[i]);
+}
+
+void nvaudio_mix_s32(int32_t *dst, const int32_t *src, size_t samples)
+{
+    size_t i = 0;
+
+#if defined(NVAUDIO_MIX_NEON)
+    for (; i + 8 <= samples; i += 8) {
+        int32x4_t a0 = vld1q_s32(dst + i);
+        int32x4_t a1 = vld1q_s32(dst + i + 4);
+        int32x4_t b0 = vld1q_s32(src + i);
+        int32x4_t b1 = vld1q_s32(src + i + 4);
+
+        vst1q_s32(dst + i, vqaddq_s32(a0, b0));
+        vst1q_s32(dst + i + 4, vqaddq_s32(a1, b1));
+    }
+#elif defined(NVAUDIO_MIX_SSE2)
+    {
+        const __m128i max = _mm_set1_epi32(0x7FFFFFFF);
+
+        /* SSE2 has no saturating 32 bit add: the sum overflowed when both
+         * inputs have the same sign and the sum does not */
+        for (; i + 4 <= samples; i += 4) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(dst + i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i sum = _mm_add_epi32(a, b);
+            __m128i ovf = _mm_andnot_si128(_mm_xor_si128(a, b),
+                _mm_xor_si128(a, sum));
+            __m128i sat = _mm_xor_si128(_mm_srai_epi32(a, 31), max);
+
+            ovf = _mm_srai_epi32(ovf, 31);
+            sum = _mm_or_si128(_mm_and_si128(ovf, sat),
+                _mm_andnot_si128(ovf, sum));
+            _mm_storeu_si128((__m128i *)(dst + i), sum);
+        }
+    }
+#endif
+
+    for (; i < samples; i++) {
+        int64_t sum = (int64_t)dst[i] + (int64_t)src[i];
+
+        if (sum > INT32_MAX)
+            sum = INT32_MAX;
+        else if (sum < INT32_MIN)
+            sum = INT32_MIN;
+        dst[i] = (int32_t)sum;
+    }
+}
+
+void nvaudio_mix_float(float *dst, const float *src, size_t samples)
+{
+    size_t i = 0;
+
+#if defined(NVAUDIO_MIX_NEON)
+    for (; i + 8 <= samples; i += 8) {
+        vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vld1q_f32(src + i)));
+        vst1q_f32(dst + i + 4, vaddq_f32(vld1q_f32(dst + i + 4),
+            vld1q_f32(src + i + 4)));
+    }
+#elif defined(NVAUDIO_MIX_SSE2)
+    for (; i + 8 <= samples; i += 8) {
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i),
+            _mm_loadu_ps(src + i)));
+        _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4),
+            _mm_loadu_ps(src + i + 4)));
+    }
+#endif
+
+    for (; i < samples; i++)
+        dst[i] += src[i];
+}
+
+/*****************************************************************************
+ * Volume
+ *****************************************************************************/
+/*
+ * The vector loops work on 8 frames at a time, which is a whole number of
+ * 8 sample vectors for any channel count, with the per channel gains laid
+ * out once for the whole block.
+ */
+void nvaudio_gain_s16(int16_t *buffer, size_t frames, uint32_t channels,
+    const uint32_t *vol)
+{
+    size_t i, block_frames = 0;
+    uint32_t j;
+
+    if (!channels || channels > NVAUDIO_MIX_MAX_CHANNELS)
+        return;
+
+#if defined(NVAUDIO_MIX_NEON)
+    {
+        int32_t gain[8 * NVAUDIO_MIX_MAX_CHANNELS];
+
+        for (j = 0; j < 8 * channels; j++)
+            gain[j] = clamp_gain(vol[j % channels]);
+
+        block_frames = frames & ~(size_t)7;
+        for (i = 0; i < block_frames * channels; i += 8 * channels) {
+            for (j = 0; j < channels; j++) {
+                int16_t *p = buffer + i + (j << 3);
+                int16x8_t x = vld1q_s16(p);
+                int32x4_t lo = vmulq_s32(vmovl_s16(vget_low_s16(x)),
+                    vld1q_s32(gain + (j << 3)));
+                int32x4_t hi = vmulq_s32(vmovl_s16(vget_high_s16(x)),
+                    vld1q_s32(gain + (j << 3) + 4));
+
+                vst1q_s16(p, vcombine_s16(vqshrn_n_s32(lo, 15),
+                    vqshrn_n_s32(hi, 15)));
+            }
+        }
+    }
+#elif defined(NVAUDIO_MIX_SSE2)
+    {
+        /* pmaddwd multiplies 16 bit pairs, so each gain is split into two
+         * halves applied to two copies of the sample */
+        int16_t gain[16 * NVAUDIO_MIX_MAX_CHANNELS];
+
+        for (j = 0; j < 8 * channels; j++) {
+            uint32_t g = clamp_gain(vol[j % channels]);
+
+            gain[2 * j] = (int16_t)(g >> 1);
+            gain[2 * j + 1] = (int16_t)(g - (g >> 1));
+        }
+
+        block_frames = frames & ~(size_t)7;
+        for (i = 0; i < block_frames * channels; i += 8 * channels) {
+            for (j = 0; j < channels; j++) {
+                int16_t *p = buffer + i + (j << 3);
+                __m128i x = _mm_loadu_si128((const __m128i *)p);
+                __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(x, x),
+                    _mm_loadu_si128((const __m128i *)(gain + (j << 4))));
+                __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(x, x),
+                    _mm_loadu_si128((const __m128i *)(gain + (j << 4) + 8)));
+
+                _mm_storeu_si128((__m128i *)p, _mm_packs_epi32(
+                    _mm_srai_epi32(lo, 15), _mm_srai_epi32(hi, 15)));
+            }
+        }
+    }
+#endif
+
+    buffer += block_frames * channels;
+    for (i = block_frames; i < frames; i++) {
+        for (j = 0; j < channels; j++)
+            buffer[j] = sat16(((int32_t)buffer[j] *
+                (int32_t)clamp_gain(vol[j])) >> 15);
+        buffer += channels;
+    }
+}
+
+void nvaudio_gain_float(float *buffer, size_t frames, uint32_t channels,
+    const uint32_t *vol)
+{
+    float gain[4 * NVAUDIO_MIX_MAX_CHANNELS];
+    size_t i, block_frames = 0;
+    uint32_t j;
+
+    if (!channels || channels > NVAUDIO_MIX_MAX_CHANNELS)
+        return;
+
+    for (j = 0; j < 4 * channels; j++)
+        gain[j] = (float)clamp_gain(vol[j % channels]) / (1 << 15);
+
+#if defined(NVAUDIO_MIX_NEON)
+    block_frames = frames & ~(size_t)3;
+    for (i = 0; i < block_frames * channels; i += 4 * channels) {
+        for (j = 0; j < channels; j++) {
+            float *p = buffer + i + (j << 2);
+            vst1q_f32(p, vmulq_f32(vld1q_f32(p), vld1q_f32(gain + (j << 2))));
+        }
+    }
+#elif defined(NVAUDIO_MIX_SSE2)
+    block_frames = frames & ~(size_t)3;
+    for (i = 0; i < block_frames * channels; i += 4 * channels) {
+        for (j = 0; j < channels; j++) {
+            float *p = buffer + i + (j << 2);
+            _mm_storeu_ps(p, _mm_mul_ps(_mm_loadu_ps(p),
+                _mm_loadu_ps(gain + (j << 2))));
+        }
+    }
+#endif
+
+    buffer += block_frames * channels;
+    for (i = block_frames; i < frames; i++) {
+        for (j = 0; j < channels; j++)
+            buffer[j] *= gain[j];
+        buffer += channels;
+    }
+}
+
+/*****************************************************************************
+ * Format conversion
+ *****************************************************************************/
+void nvaudio_s16_to_float(float *dst, const int16_t *src, size_t samples)
+{
+    const float scale = 1.0f / 32768.0f;
+    size_t i = 0;
+
+#if defined(NVAUDIO_MIX_NEON)
+    for (; i + 8 <= samples; i += 8) {
+        int16x8_t x = vld1q_s16(src + i);
+
+        vst1q_f32(dst + i, vmulq_n_f32(
+            vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), scale));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(
+            vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), scale));
+    }
+#elif defined(NVAUDIO_MIX_SSE2)
+    {
+        const __m128 s = _mm_set1_ps(scale);
+
+        for (; i + 8 <= samples; i += 8) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+            __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), s));
+            _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), s));
+        }
+    }
+#endif
+
+    for (; i < samples; i++)
+        dst[i] = (float)src[i] * scale;
+}
+
+void nvaudio_float_to_s16(int16_t *dst, const float *src, size_t samples)
+{
+    size_t i = 0;
+
+#if defined(NVAUDIO_MIX_NEON)
+    {
+        const float32x4_t max = vdupq_n_f32(32767.0f);
+        const float32x4_t min = vdupq_n_f32(-32768.0f);
+
+        for (; i + 8 <= samples; i += 8) {
+            float32x4_t lo = vmulq_n_f32(vld1q_f32(src + i), 32768.0f);
+            float32x4_t hi = vmulq_n_f32(vld1q_f32(src + i + 4), 32768.0f);
+
+            lo = vmaxq_f32(vminq_f32(lo, max), min);
+            hi = vmaxq_f32(vminq_f32(hi, max), min);
+            vst1q_s16(dst + i, vcombine_s16(vmovn_s32(vcvtq_s32_f32(lo)),
+                vmovn_s32(vcvtq_s32_f32(hi))));
+        }
+    }
+#elif defined(NVAUDIO_MIX_SSE2)
+    {
+        const __m128 scale = _mm_set1_ps(32768.0f);
+        const __m128 max = _mm_set1_ps(32767.0f);
+        const __m128 min = _mm_set1_ps(-32768.0f);
+
+        for (; i + 8 <= samples; i += 8) {
+            __m128 lo = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+            __m128 hi = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+
+            lo = _mm_max_ps(_mm_min_ps(lo, max), min);
+            hi = _mm_max_ps(_mm_min_ps(hi, max), min);
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(
+                _mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi)));
+        }
+    }
+#endif
+
+    for (; i < samples; i++) {
+        float s = src[i] * 32768.0f;
+
+        if (s > 32767.0f)
+            s = 32767.0f;
+        else if (s < -32768.0f)
+            s = -32768.0f;
+        dst[i] = (int16_t)s;
+    }
+}
+
+/*****************************************************************************
+ * Channel matrix
+ *****************************************************************************/
+static inline uint32_t ch_id(uint32_t ch_map, uint32_t ch)
+{
+    return (ch_map >> (ch << 2)) & 0xF;
+}
+
+static int find_ch(uint32_t ch_map, uint32_t channels, uint32_t id)
+{
+    uint32_t i;
+
+    for (i = 0; i < channels; i++) {
+        if (ch_id(ch_map, i) == id)
+            return i;
+    }
+    return -1;
+}
+
+/* First of the given channel ids present in the map */
+static int find_nearest_ch(uint32_t ch_map, uint32_t channels,
+    uint32_t id0, uint32_t id1, uint32_t id2)
+{
+    int ch = find_ch(ch_map, channels, id0);
+
+    if (ch < 0)
+        ch = find_ch(ch_map, channels, id1);
+    if (ch < 0)
+        ch = find_ch(ch_map, channels, id2);
+    return ch;
+}
+
+int nvaudio_mix_matrix_init(struct nvaudio_mix_matrix *matrix,
+    uint32_t src_ch_map, uint32_t src_channels,
+    uint32_t dst_ch_map, uint32_t dst_channels)
+{
+    float coef[NVAUDIO_MIX_MAX_CHANNELS][NVAUDIO_MIX_MAX_CHANNELS];
+    float scale = 1.0f;
+    uint32_t s, d;
+
+    if (!src_channels || src_channels > NVAUDIO_MIX_MAX_CHANNELS ||
+        !dst_channels || dst_channels > NVAUDIO_MIX_MAX_CHANNELS)
+        return -EINVAL;
+
+    memset(matrix, 0, sizeof(*matrix));
+    memset(coef, 0, sizeof(coef));
+    matrix->src_channels = src_channels;
+    matrix->dst_channels = dst_channels;
+
+    for (s = 0; s < src_channels; s++) {
+        uint32_t id = ch_id(src_ch_map, s);
+        int left = -1, right = -1;
+        int dst = find_ch(dst_ch_map, dst_channels, id);
+
+        if (dst >= 0) {
+            coef[dst][s] = 1.0f;
+            continue;
+        }
+        if (id == LFE)
+            continue;
+
+        if (dst_channels == 1) {
+            coef[0][s] = 1.0f;
+            continue;
+        }
+
+        switch (id) {
+            case LF:
+                left = find_ch(dst_ch_map, dst_channels, LF);
+                break;
+            case RF:
+                right = find_ch(dst_ch_map, dst_channels, RF);
+                break;
+            case LS:
+            case LR:
+                left = find_nearest_ch(dst_ch_map, dst_channels, LS, LR, LF);
+                break;
+            case RS:
+            case RR:
+                right = find_nearest_ch(dst_ch_map, dst_channels, RS, RR, RF);
+                break;
+            default:
+                /* centre channels */
+                left = find_ch(dst_ch_map, dst_channels, CF);
+                if (left < 0) {
+                    left = find_ch(dst_ch_map, dst_channels, LF);
+                    right = find_ch(dst_ch_map, dst_channels, RF);
+                }
+                break;
+        }
+
+        if (left >= 0)
+            coef[left][s] += FOLD_COEF;
+        if (right >= 0)
+            coef[right][s] += FOLD_COEF;
+    }
+
+    if (dst_channels == 2 && src_channels > 2)
+        scale = (float)stereo_downmix_scale[src_channels] / (1 << 15);
+
+    matrix->is_route = 1;
+    for (d = 0; d < dst_channels; d++) {
+        float sum = 0.0f;
+        int nonzero = 0;
+
+        matrix->route[d] = -1;
+        for (s = 0; s < src_channels; s++)
+            sum += coef[d][s] * scale;
+
+        for (s = 0; s < src_channels; s++) {
+            float c = coef[d][s] * scale;
+
+            if (sum * NVAUDIO_MIX_COEF_ONE > MATRIX_ROW_SUM_MAX)
+                c *= MATRIX_ROW_SUM_MAX / (sum * NVAUDIO_MIX_COEF_ONE);
+            matrix->coef[d][s] = NVAUDIO_MIX_COEF(c);
+            if (matrix->coef[d][s]) {
+                nonzero++;
+                matrix->route[d] = s;
+                if (matrix->coef[d][s] != NVAUDIO_MIX_COEF_ONE)
+                    matrix->is_route = 0;
+            }
+        }
+        if (nonzero > 1)
+            matrix->is_route = 0;
+    }
+
+    return 0;
+}
+
+static void matrix_block(const struct nvaudio_mix_matrix *matrix,
+    int16_t in[][MATRIX_BLOCK_FRAMES], int16_t out[][MATRIX_BLOCK_FRAMES])
+{
+    uint32_t src_channels = matrix->src_channels;
+    uint32_t s, d;
+
+    for (d = 0; d < matrix->dst_channels; d++) {
+        const int16_t *coef = matrix->coef[d];
+#if defined(NVAUDIO_MIX_NEON)
+        int32x4_t acc0 = vdupq_n_s32(0);
+        int32x4_t acc1 = vdupq_n_s32(0);
+        int32x4_t acc2 = vdupq_n_s32(0);
+        int32x4_t acc3 = vdupq_n_s32(0);
+
+        for (s = 0; s < src_channels; s++) {
+            int16x8_t x0, x1;
+
+            if (!coef[s])
+                continue;
+            x0 = vld1q_s16(in[s]);
+            x1 = vld1q_s16(in[s] + 8);
+            acc0 = vmlal_n_s16(acc0, vget_low_s16(x0), coef[s]);
+            acc1 = vmlal_n_s16(acc1, vget_high_s16(x0), coef[s]);
+            acc2 = vmlal_n_s16(acc2, vget_low_s16(x1), coef[s]);
+            acc3 = vmlal_n_s16(acc3, vget_high_s16(x1), coef[s]);
+        }
+        vst1q_s16(out[d], vcombine_s16(
+            vqrshrn_n_s32(acc0, NVAUDIO_MIX_COEF_SHIFT),
+            vqrshrn_n_s32(acc1, NVAUDIO_MIX_COEF_SHIFT)));
+        vst1q_s16(out[d] + 8, vcombine_s16(
+            vqrshrn_n_s32(acc2, NVAUDIO_MIX_COEF_SHIFT),
+            vqrshrn_n_s32(acc3, NVAUDIO_MIX_COEF_SHIFT)));
+#elif defined(NVAUDIO_MIX_SSE2)
+        /* Source channels are taken in pairs so that one pmaddwd applies
+         * both coefficients; in[] has a zeroed plane past the last channel */
+        const __m128i round = _mm_set1_epi32(1 << (NVAUDIO_MIX_COEF_SHIFT - 1));
+        __m128i acc0 = round, acc1 = round, acc2 = round, acc3 = round;
+
+        for (s = 0; s < src_channels; s += 2) {
+            int16_t c1 = s + 1 < src_channels ? coef[s + 1] : 0;
+            __m128i c, a0, a1, b0, b1;
+
+            if (!coef[s] && !c1)
+                continue;
+            c = _mm_set1_epi32(((uint32_t)(uint16_t)c1 << 16) |
+                (uint16_t)coef[s]);
+            a0 = _mm_loadu_si128((const __m128i *)in[s]);
+            a1 = _mm_loadu_si128((const __m128i *)(in[s] + 8));
+            b0 = _mm_loadu_si128((const __m128i *)in[s + 1]);
+            b1 = _mm_loadu_si128((const __m128i *)(in[s + 1] + 8));
+            acc0 = _mm_add_epi32(acc0,
+                _mm_madd_epi16(_mm_unpacklo_epi16(a0, b0), c));
+            acc1 = _mm_add_epi32(acc1,
+                _mm_madd_epi16(_mm_unpackhi_epi16(a0, b0), c));
+            acc2 = _mm_add_epi32(acc2,
+                _mm_madd_epi16(_mm_unpacklo_epi16(a1, b1), c));
+            acc3 = _mm_add_epi32(acc3,
+                _mm_madd_epi16(_mm_unpackhi_epi16(a1, b1), c));
+        }
+        _mm_storeu_si128((__m128i *)out[d], _mm_packs_epi32(
+            _mm_srai_epi32(acc0, NVAUDIO_MIX_COEF_SHIFT),
+            _mm_srai_epi32(acc1, NVAUDIO_MIX_COEF_SHIFT)));
+        _mm_storeu_si128((__m128i *)(out[d] + 8), _mm_packs_epi32(
+            _mm_srai_epi32(acc2, NVAUDIO_MIX_COEF_SHIFT),
+            _mm_srai_epi32(acc3, NVAUDIO_MIX_COEF_SHIFT)));
+#else
+        uint32_t i;
+
+        for (i = 0; i < MATRIX_BLOCK_FRAMES; i++) {
+            int32_t acc = 1 << (NVAUDIO_MIX_COEF_SHIFT - 1);
+
+            for (s = 0; s < src_channels; s++)
+                acc += (int32_t)in[s][i] * coef[s];
+            out[d][i] = sat16(acc >> NVAUDIO_MIX_COEF_SHIFT);
+        }
+#endif
+    }
+}
+
+/*
+ * Works on blocks of frames which are read completely before any of the
+ * block is written. Going forward when the frames shrink and backward when
+ * they grow, an in place conversion never overwrites unread input.
+ */
+void nvaudio_mix_matrix_apply(const struct nvaudio_mix_matrix *matrix,
+    const int16_t *src, int16_t *dst, size_t frames)
+{
+    int16_t in[NVAUDIO_MIX_MAX_CHANNELS + 1][MATRIX_BLOCK_FRAMES];
+    int16_t out[NVAUDIO_MIX_MAX_CHANNELS][MATRIX_BLOCK_FRAMES];
+    uint32_t src_channels = matrix->src_channels;
+    uint32_t dst_channels = matrix->dst_channels;
+    size_t blocks = (frames + MATRIX_BLOCK_FRAMES - 1) / MATRIX_BLOCK_FRAMES;
+    int backward = (src == dst) && (dst_channels > src_channels);
+    size_t b;
+
+    memset(in, 0, sizeof(in));
+
+    for (b = 0; b < blocks; b++) {
+        size_t block = backward ? blocks - 1 - b : b;
+        size_t first = block * MATRIX_BLOCK_FRAMES;
+        size_t count = frames - first;
+        const int16_t *psrc = src + first * src_channels;
+        int16_t *pdst = dst + first * dst_channels;
+        uint32_t i, ch;
+
+        if (count > MATRIX_BLOCK_FRAMES)
+            count = MATRIX_BLOCK_FRAMES;
+
+        for (i = 0; i < count; i++) {
+            for (ch = 0; ch < src_channels; ch++)
+                in[ch][i] = psrc[ch];
+            psrc += src_channels;
+        }
+
+        if (matrix->is_route) {
+            for (i = 0; i < count; i++) {
+                for (ch = 0; ch < dst_channels; ch++)
+                    pdst[ch] = matrix->route[ch] < 0 ? 0 :
+                        in[(uint32_t)matrix->route[ch]][i];
+                pdst += dst_channels;
+            }
+            continue;
+        }
+
+        matrix_block(matrix, in, out);
+        for (i = 0; i < count; i++) {
+            for (ch = 0; ch < dst_channels; ch++)
+                pdst[ch] = out[ch][i];
+            pdst += dst_channels;
+        }
+    }
+}
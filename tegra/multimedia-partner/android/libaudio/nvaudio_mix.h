@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+#ifndef LIBAUDIO_NVAUDIO_MIX_H
+#define LIBAUDIO_NVAUDIO_MIX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*****************************************************************************
+ * MACROS
+ *****************************************************************************/
+#define NVAUDIO_MIX_MAX_CHANNELS    8
+
+/* Channel matrix coefficients are Q14 so that unity gain fits in 16 bits */
+#define NVAUDIO_MIX_COEF_SHIFT      14
+#define NVAUDIO_MIX_COEF_ONE        (1 << NVAUDIO_MIX_COEF_SHIFT)
+#define NVAUDIO_MIX_COEF(f)         (int16_t)((float)(f) * \
+                                        NVAUDIO_MIX_COEF_ONE + 0.5f)
+
+/*****************************************************************************
+ * ENUMS
+ *****************************************************************************/
+/* Channel ids used in the 4 bit per channel maps, channel 0 in bits 0-3 */
+enum tegra_audio_channel_id {
+    LF = 1,                           // Left Front
+    RF,                               // Right Front
+    CF,                               // Center Front
+    LS,                               // Left Surround
+    RS,                               // Right Surround
+    LFE,                              // Low Frequency Effect
+    CS,                               // Center Surround
+    LR,                               // Rear Left
+    RR,                               // Rear Right
+    TEGRA_AUDIO_CHANNEL_ID_LAST
+};
+
+/*****************************************************************************
+ * Structures
+ *****************************************************************************/
+struct nvaudio_mix_matrix {
+    uint32_t src_channels;
+    uint32_t dst_channels;
+    /* coef[d][s] weights source channel s into destination channel d */
+    int16_t coef[NVAUDIO_MIX_MAX_CHANNELS][NVAUDIO_MIX_MAX_CHANNELS];
+    /* Set when every destination channel is a copy of one source channel
+     * or silent; route[d] is that source channel or -1 */
+    int is_route;
+    int8_t route[NVAUDIO_MIX_MAX_CHANNELS];
+};
+
+/*****************************************************************************
+ * Functions
+ *
+ * All buffers are interleaved. The NEON, SSE2 and portable versions give
+ * bit exact results.
+ *****************************************************************************/
+/* Name of the backend compiled in: "neon", "sse2" or "c" */
+const char *nvaudio_mix_backend(void);
+
+/* dst[i] += src[i], saturating for the integer formats */
+void nvaudio_mix_s16(int16_t *dst, const int16_t *src, size_t samples);
+void nvaudio_mix_s32(int32_t *dst, const int32_t *src, size_t samples);
+void nvaudio_mix_float(float *dst, const float *src, size_t samples);
+
+/* In place per channel gain, vol[] in Q15 with INT_Q15(1) being unity. Gains
+ * are limited to just under 2.0. */
+void nvaudio_gain_s16(int16_t *buffer, size_t frames, uint32_t channels,
+    const uint32_t *vol);
+void nvaudio_gain_float(float *buffer, size_t frames, uint32_t channels,
+    const uint32_t *vol);
+
+/* Conversions between 16 bit PCM and float in [-1.0, 1.0), float samples
+ * out of range are clipped and rounded towards zero */
+void nvaudio_s16_to_float(float *dst, const int16_t *src, size_t samples);
+void nvaudio_float_to_s16(int16_t *dst, const float *src, size_t samples);
+
+/*
+ * Builds the matrix converting between two channel maps. Channels present in
+ * both maps are copied. Other source channels are folded into the nearest
+ * destination channel on the same side at -3 dB, centre channels into both
+ * front channels when there is no centre; LFE is dropped. Downmixes to
+ * stereo are scaled to keep the legacy loudness and a mono destination sums
+ * every channel. Returns -EINVAL for an unsupported channel count.
+ */
+int nvaudio_mix_matrix_init(struct nvaudio_mix_matrix *matrix,
+    uint32_t src_ch_map, uint32_t src_channels,
+    uint32_t dst_ch_map, uint32_t dst_channels);
+
+/* Applies the matrix to frames of 16 bit PCM. src and dst may be the same
+ * buffer, large enough for the bigger of the two layouts, but must not
+ * otherwise overlap. */
+void nvaudio_mix_matrix_apply(const struct nvaudio_mix_matrix *matrix,
+    const int16_t *src, int16_t *dst, size_t frames);
+
+#endif // LIBAUDIO_NVAUDIO_MIX_H
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+/*
+ * Output mixer benchmark.
+ *
+ * Mixes 2 to 8 streams of 16 bit PCM the way nvaudio_out_write does: every
+ * stream gets its volume applied and is then added into the device mix
+ * buffer, one period at a time. Each stream count is run with the per sample
+ * loops the HAL used before and with the vector routines of nvaudio_mix, and
+ * the results of both are compared. A last run converts 5.1 to stereo with
+ * the channel matrix.
+ *
+ * Each line reports the mixed frames per second and the CPU time spent per
+ * stream as a share of real time at 48 kHz.
+ *
+ * usage: nvaudio_mix_bench [periods] [channels]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "nvaudio_mix.h"
+
+#define BENCH_DEFAULT_PERIODS   20000
+#define BENCH_DEFAULT_CHANNELS  2
+#define BENCH_PERIOD_FRAMES     1024
+#define BENCH_RATE              48000
+#define BENCH_MAX_STREAMS       8
+
+static double bench_cpu_seconds(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+        usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static inline int16_t bench_sat16(int32_t val)
+{
+    if ((val >> 15) ^ (val >> 31))
+        val = 0x7FFF ^ (val >> 31);
+
+    return val;
+}
+
+/* The per sample loops of the HAL before nvaudio_mix */
+static void legacy_volume(int16_t *buffer, size_t frames, uint32_t channels,
+    const uint32_t *vol)
+{
+    uint32_t i;
+
+    do {
+        for (i = 0; i < channels; i++)
+            buffer[i] = (int16_t)(((int32_t)buffer[i] * vol[i]) >> 15);
+        buffer += channels;
+    } while (--frames);
+}
+
+static void legacy_mix(int16_t *mix_buffer, const int16_t *src_buffer,
+    size_t samples)
+{
+    size_t i;
+    int32_t mix;
+
+    for (i = 0; i < samples; i++) {
+        mix = (int32_t)mix_buffer[i] + (int32_t)src_buffer[i];
+        mix_buffer[i] = bench_sat16(mix);
+    }
+}
+
+static void bench_fill(int16_t *buffer, size_t samples, uint32_t seed)
+{
+    size_t i;
+
+    for (i = 0; i < samples; i++) {
+        seed = seed * 1664525 + 1013904223;
+        buffer[i] = (int16_t)(seed >> 16) / 3;
+    }
+}
+
+static void bench_report(const char *name, uint32_t streams, uint32_t periods,
+    double cpu)
+{
+    double frames = (double)periods * BENCH_PERIOD_FRAMES;
+    double audio_seconds = frames / BENCH_RATE;
+
+    printf("%-8s %u streams: %10.0f frames/s, %6.3f%% CPU per stream\n",
+        name, streams, cpu > 0 ? frames / cpu : 0.0,
+        100.0 * cpu / audio_seconds / streams);
+}
+
+static int bench_streams(uint32_t streams, uint32_t periods,
+    uint32_t channels, int16_t **stream_buffers, int16_t *work,
+    int16_t *mix_legacy, int16_t *mix_vector)
+{
+    size_t samples = BENCH_PERIOD_FRAMES * channels;
+    uint32_t vol[NVAUDIO_MIX_MAX_CHANNELS];
+    double start;
+    uint32_t p, s, i;
+    int mismatch = 0;
+
+    for (i = 0; i < channels; i++)
+        vol[i] = 23170 + i * 1000;
+
+    start = bench_cpu_seconds();
+    for (p = 0; p < periods; p++) {
+        memset(mix_legacy, 0, samples * sizeof(int16_t));
+        for (s = 0; s < streams; s++) {
+            memcpy(work, stream_buffers[s], samples * sizeof(int16_t));
+            legacy_volume(work, BENCH_PERIOD_FRAMES, channels, vol);
+            legacy_mix(mix_legacy, work, samples);
+        }
+    }
+    bench_report("legacy", streams, periods, bench_cpu_seconds() - start);
+
+    start = bench_cpu_seconds();
+    for (p = 0; p < periods; p++) {
+        memset(mix_vector, 0, samples * sizeof(int16_t));
+        for (s = 0; s < streams; s++) {
+            memcpy(work, stream_buffers[s], samples * sizeof(int16_t));
+            nvaudio_gain_s16(work, BENCH_PERIOD_FRAMES, channels, vol);
+            nvaudio_mix_s16(mix_vector, work, samples);
+        }
+    }
+    bench_report(nvaudio_mix_backend(), streams, periods,
+        bench_cpu_seconds() - start);
+
+    if (memcmp(mix_legacy, mix_vector, samples * sizeof(int16_t))) {
+        printf("  mismatch between legacy and %s output\n",
+            nvaudio_mix_backend());
+        mismatch = 1;
+    }
+    return mismatch;
+}
+
+static void bench_matrix(uint32_t periods, int16_t *src, int16_t *dst)
+{
+    const uint32_t src_map = (LF << 0) | (RF << 4) | (CF << 8) | (LFE << 12) |
+        (LS << 16) | (RS << 20);
+    const uint32_t dst_map = (LF << 0) | (RF << 4);
+    struct nvaudio_mix_matrix matrix;
+    double start;
+    uint32_t p;
+
+    if (nvaudio_mix_matrix_init(&matrix, src_map, 6, dst_map, 2)) {
+        printf("matrix init failed\n");
+        return;
+    }
+
+    start = bench_cpu_seconds();
+    for (p = 0; p < periods; p++)
+        nvaudio_mix_matrix_apply(&matrix, src, dst, BENCH_PERIOD_FRAMES);
+    bench_report("5.1->2.0", 1, periods, bench_cpu_seconds() - start);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t periods = BENCH_DEFAULT_PERIODS;
+    uint32_t channels = BENCH_DEFAULT_CHANNELS;
+    int16_t *stream_buffers[BENCH_MAX_STREAMS];
+    int16_t *work, *mix_legacy, *mix_vector;
+    size_t samples;
+    uint32_t s;
+    int failed = 0;
+
+    if (argc > 1)
+        periods = strtoul(argv[1], NULL, 0);
+    if (argc > 2)
+        channels = strtoul(argv[2], NULL, 0);
+    if (!periods || !channels || channels > NVAUDIO_MIX_MAX_CHANNELS) {
+        printf("usage: %s [periods] [channels 1-%d]\n", argv[0],
+            NVAUDIO_MIX_MAX_CHANNELS);
+        return 1;
+    }
+
+    samples = BENCH_PERIOD_FRAMES * NVAUDIO_MIX_MAX_CHANNELS;
+    for (s = 0; s < BENCH_MAX_STREAMS; s++) {
+        stream_buffers[s] = malloc(samples * sizeof(int16_t));
+        if (!stream_buffers[s])
+            return 1;
+        bench_fill(stream_buffers[s], samples, s + 1);
+    }
+    work = malloc(samples * sizeof(int16_t));
+    mix_legacy = malloc(samples * sizeof(int16_t));
+    mix_vector = malloc(samples * sizeof(int16_t));
+    if (!work || !mix_legacy || !mix_vector)
+        return 1;
+
+    printf("%u periods of %u frames, %u channels, %s backend\n", periods,
+        BENCH_PERIOD_FRAMES, channels, nvaudio_mix_backend());
+
+    for (s = 2; s <= BENCH_MAX_STREAMS; s++)
+        failed |= bench_streams(s, periods, channels, stream_buffers, work,
+            mix_legacy, mix_vector);
+
+    bench_matrix(periods, stream_buffers[0], work);
+
+    for (s = 0; s < BENCH_MAX_STREAMS; s++)
+        free(stream_buffers[s]);
+    free(work);
+    free(mix_legacy);
+    free(mix_vector);
+
+    return failed;
+}
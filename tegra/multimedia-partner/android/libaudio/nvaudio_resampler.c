@@ -0,0 +1,556 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+/*
+ * Polyphase resampler for the output and input paths.
+ *
+ * For in_rate * L == out_rate * M with L and M coprime, output frame n is
+ * taken at input position n * M / L. Its integer part selects the input
+ * samples and its fraction one of the L phases of a Kaiser windowed sinc
+ * designed at L times the input rate. Each phase is stored reversed, so an
+ * output sample is a dot product of one contiguous coefficient row with the
+ * last taps input samples of the channel, which are kept de-interleaved.
+ *
+ * Coefficients are Q15 with every phase summing to exactly unity gain. Q15
+ * rounding alone limits THD+N to about -80 dB, so the medium and high quality
+ * banks also keep a residual row with the next RESIDUAL_BITS bits of every
+ * coefficient and filter with both. The dot products have NEON and SSE2 versions; each
+ * vector lane only sums a quarter of the taps or less and the lanes are added
+ * in 64 bits, so the vector and the portable code give the same result
+ * without overflowing.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvaudio_resampler.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define NVAUDIO_RESAMPLER_NEON 1
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define NVAUDIO_RESAMPLER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#define MAX_CHANNELS            8
+
+/* Taps are rounded up to a multiple of this for the vector loops */
+#define TAPS_ALIGN              8
+#define MAX_TAPS                256
+
+/* Extra coefficient bits of the banks with a residual row. Residuals stay within
+ * +-2^(RESIDUAL_BITS - 1), so their vector lanes cannot overflow either. */
+#define RESIDUAL_BITS           8
+
+/* Banks kept for the life of the process; others are freed with their
+ * resampler */
+#define MAX_CACHED_BANKS        8
+
+/* Input taken beyond what the output needs, see nvaudio_resampler_process */
+#define INPUT_SLACK_FRAMES      64
+
+static const struct {
+    uint32_t taps;
+    float stopband_db;
+    int residual;
+} quality_params[NVAUDIO_RESAMPLER_QUALITY_MAX] = {
+    { 24, 60.0f, 0 },
+    { 48, 85.0f, 1 },
+    { 96, 100.0f, 1 },
+};
+
+struct filter_bank {
+    uint32_t phases;            /* L */
+    uint32_t step;              /* M */
+    uint32_t taps;
+    enum nvaudio_resampler_quality quality;
+    int cached;
+    int16_t *coef;              /* phases rows of taps coefficients */
+    int16_t *residual;          /* low bits of coef, or NULL */
+};
+
+struct nvaudio_resampler {
+    uint32_t in_rate;
+    uint32_t out_rate;
+    uint32_t channels;
+    struct filter_bank *bank;
+    uint32_t phase;             /* phase of the next output frame */
+    size_t pos;                 /* newest input frame it needs */
+    size_t fill;                /* input frames held */
+    size_t capacity;            /* frames per channel plane */
+    int16_t *planes;            /* channels planes of capacity frames */
+};
+
+static pthread_mutex_t bank_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct filter_bank *bank_cache[MAX_CACHED_BANKS];
+
+/*****************************************************************************
+ * Filter design
+ *****************************************************************************/
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* Modified Bessel function of the first kind, order 0 */
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    int k;
+
+    for (k = 1; k < 50; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+static struct filter_bank *design_bank(uint32_t phases, uint32_t step,
+    enum nvaudio_resampler_quality quality)
+{
+    struct filter_bank *bank;
+    uint32_t taps = quality_params[quality].taps;
+    double atten = quality_params[quality].stopband_db;
+    double beta, transition, cutoff, center, i0_beta;
+    double *row;
+    int32_t *qrow;
+    uint32_t p, j, bits;
+
+    /* Keep the transition band the same width at the output rate when
+     * decimating */
+    if (step > phases)
+        taps = (uint32_t)((double)taps * step / phases);
+    taps = (taps + TAPS_ALIGN - 1) & ~(TAPS_ALIGN - 1);
+    if (taps > MAX_TAPS)
+        taps = MAX_TAPS;
+
+    bank = calloc(1, sizeof(*bank));
+    if (!bank)
+        return NULL;
+    bank->coef = malloc(phases * taps * sizeof(int16_t));
+    if (quality_params[quality].residual)
+        bank->residual = malloc(phases * taps * sizeof(int16_t));
+    row = malloc(taps * sizeof(double));
+    qrow = malloc(taps * sizeof(int32_t));
+    if (!bank->coef || !row || !qrow ||
+        (quality_params[quality].residual && !bank->residual)) {
+        free(qrow);
+        free(row);
+        free(bank->residual);
+        free(bank->coef);
+        free(bank);
+        return NULL;
+    }
+    bank->phases = phases;
+    bank->step = step;
+    bank->taps = taps;
+    bank->quality = quality;
+
+    /* Kaiser design: beta and transition width for the stopband, with the
+     * stopband starting at the lower Nyquist frequency. Frequencies are
+     * relative to the input rate. */
+    beta = 0.1102 * (atten - 8.7);
+    transition = (atten - 7.95) / (14.36 * taps);
+    cutoff = 0.5 * (step > phases ? (double)phases / step : 1.0) -
+        transition / 2;
+    center = (double)taps / 2;
+    i0_beta = bessel_i0(beta);
+    bits = bank->residual ? 15 + RESIDUAL_BITS : 15;
+
+    for (p = 0; p < phases; p++) {
+        int16_t *coef = bank->coef + p * taps;
+        double sum = 0.0;
+        int64_t qsum = 0;
+        uint32_t peak = 0;
+
+        /* Coefficient j of the row weights the input sample taps - 1 - j
+         * frames before the newest one, at a fraction p / phases of a frame
+         * before the output position */
+        for (j = 0; j < taps; j++) {
+            double t = (double)j + 1.0 - (double)p / phases - center;
+            double x = 2 * cutoff * t;
+            double r = t / center;
+            double sinc = fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double win = r * r < 1.0 ?
+                bessel_i0(beta * sqrt(1.0 - r * r)) / i0_beta : 0.0;
+
+            row[j] = 2 * cutoff * sinc * win;
+            sum += row[j];
+        }
+
+        for (j = 0; j < taps; j++) {
+            double c = row[j] / sum * (double)(1 << bits);
+
+            qrow[j] = (int32_t)(c < 0 ? c - 0.5 : c + 0.5);
+            qsum += qrow[j];
+            if (abs(qrow[j]) > abs(qrow[peak]))
+                peak = j;
+        }
+        /* Put the rounding error on the largest tap for unity DC gain */
+        qrow[peak] += (int32_t)((1 << bits) - qsum);
+
+        for (j = 0; j < taps; j++) {
+            if (bank->residual) {
+                int32_t high = (qrow[j] + (1 << (RESIDUAL_BITS - 1))) >>
+                    RESIDUAL_BITS;
+
+                coef[j] = (int16_t)high;
+                bank->residual[p * taps + j] =
+                    (int16_t)(qrow[j] - (high << RESIDUAL_BITS));
+            } else {
+                coef[j] = (int16_t)qrow[j];
+            }
+        }
+    }
+
+    free(qrow);
+    free(row);
+    return bank;
+}
+
+static struct filter_bank *get_bank(uint32_t phases, uint32_t step,
+    enum nvaudio_resampler_quality quality)
+{
+    struct filter_bank *bank = NULL;
+    int i, slot = -1;
+
+    pthread_mutex_lock(&bank_lock);
+    for (i = 0; i < MAX_CACHED_BANKS; i++) {
+        struct filter_bank *b = bank_cache[i];
+
+        if (!b) {
+            if (slot < 0)
+                slot = i;
+            continue;
+        }
+        if (b->phases == phases && b->step == step && b->quality == quality) {
+            bank = b;
+            break;
+        }
+    }
+
+    if (!bank) {
+        bank = design_bank(phases, step, quality);
+        if (bank && slot >= 0) {
+            bank->cached = 1;
+            bank_cache[slot] = bank;
+        }
+    }
+    pthread_mutex_unlock(&bank_lock);
+
+    return bank;
+}
+
+static void put_bank(struct filter_bank *bank)
+{
+    if (bank && !bank->cached) {
+        free(bank->residual);
+        free(bank->coef);
+        free(bank);
+    }
+}
+
+/*****************************************************************************
+ * Filtering
+ *****************************************************************************/
+static inline int16_t sat16(int32_t val)
+{
+    if ((val >> 15) ^ (val >> 31))
+        val = 0x7FFF ^ (val >> 31);
+
+    return val;
+}
+
+static inline int16_t round_q(int64_t acc, uint32_t bits)
+{
+    acc = (acc + ((int64_t)1 << (bits - 1))) >> bits;
+    if (acc > INT16_MAX)
+        acc = INT16_MAX;
+    else if (acc < INT16_MIN)
+        acc = INT16_MIN;
+    return (int16_t)acc;
+}
+
+/* taps is a multiple of TAPS_ALIGN */
+static inline int64_t dot_s16(const int16_t *coef, const int16_t *x,
+    uint32_t taps)
+{
+    int64_t acc;
+    uint32_t i;
+
+#if defined(NVAUDIO_RESAMPLER_NEON)
+    int32x4_t acc0 = vdupq_n_s32(0);
+    int32x4_t acc1 = vdupq_n_s32(0);
+    int64x2_t sum;
+
+    for (i = 0; i < taps; i += 8) {
+        int16x8_t c = vld1q_s16(coef + i);
+        int16x8_t s = vld1q_s16(x + i);
+
+        acc0 = vmlal_s16(acc0, vget_low_s16(c), vget_low_s16(s));
+        acc1 = vmlal_s16(acc1, vget_high_s16(c), vget_high_s16(s));
+    }
+    sum = vaddq_s64(vpaddlq_s32(acc0), vpaddlq_s32(acc1));
+    acc = vgetq_lane_s64(sum, 0) + vgetq_lane_s64(sum, 1);
+#elif defined(NVAUDIO_RESAMPLER_SSE2)
+    __m128i acc0 = _mm_setzero_si128();
+    int32_t lanes[4];
+
+    for (i = 0; i < taps; i += 8) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(coef + i));
+        __m128i s = _mm_loadu_si128((const __m128i *)(x + i));
+
+        acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(c, s));
+    }
+    _mm_storeu_si128((__m128i *)lanes, acc0);
+    acc = (int64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#else
+    acc = 0;
+    for (i = 0; i < taps; i++)
+        acc += (int32_t)coef[i] * x[i];
+#endif
+
+    return acc;
+}
+
+static inline int16_t dot_q15(const int16_t *coef, const int16_t *x,
+    uint32_t taps)
+{
+    return round_q(dot_s16(coef, x, taps), 15);
+}
+
+/* coef and residual together hold Q(15 + RESIDUAL_BITS) coefficients */
+static inline int16_t dot_residual(const int16_t *coef,
+    const int16_t *residual, const int16_t *x, uint32_t taps)
+{
+    int64_t acc = dot_s16(coef, x, taps) * (1 << RESIDUAL_BITS) +
+        dot_s16(residual, x, taps);
+
+    return round_q(acc, 15 + RESIDUAL_BITS);
+}
+
+static int grow_planes(struct nvaudio_resampler *rs, size_t frames)
+{
+    size_t capacity = rs->capacity;
+    int16_t *planes;
+    uint32_t ch;
+
+    if (frames <= capacity)
+        return 0;
+
+    while (capacity < frames)
+        capacity *= 2;
+
+    planes = malloc(capacity * rs->channels * sizeof(int16_t));
+    if (!planes)
+        return -ENOMEM;
+
+    for (ch = 0; ch < rs->channels; ch++)
+        memcpy(planes + ch * capacity, rs->planes + ch * rs->capacity,
+            rs->fill * sizeof(int16_t));
+
+    free(rs->planes);
+    rs->planes = planes;
+    rs->capacity = capacity;
+    return 0;
+}
+
+/*****************************************************************************
+ * Interface
+ *****************************************************************************/
+int nvaudio_resampler_create(uint32_t in_rate, uint32_t out_rate,
+    uint32_t channels, enum nvaudio_resampler_quality quality,
+    struct nvaudio_resampler **resampler)
+{
+    struct nvaudio_resampler *rs;
+    uint32_t divisor, phases, step;
+
+    if (!resampler || !in_rate || !out_rate || !channels ||
+        channels > MAX_CHANNELS || quality >= NVAUDIO_RESAMPLER_QUALITY_MAX)
+        return -EINVAL;
+
+    divisor = gcd(in_rate, out_rate);
+    phases = out_rate / divisor;
+    step = in_rate / divisor;
+    if (phases > NVAUDIO_RESAMPLER_MAX_PHASES)
+        return -EINVAL;
+
+    rs = calloc(1, sizeof(*rs));
+    if (!rs)
+        return -ENOMEM;
+
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->channels = channels;
+    rs->bank = get_bank(phases, step, quality);
+    if (!rs->bank) {
+        free(rs);
+        return -ENOMEM;
+    }
+
+    rs->capacity = 1024;
+    while (rs->capacity < 2 * rs->bank->taps)
+        rs->capacity *= 2;
+    rs->planes = malloc(rs->capacity * channels * sizeof(int16_t));
+    if (!rs->planes) {
+        put_bank(rs->bank);
+        free(rs);
+        return -ENOMEM;
+    }
+
+    nvaudio_resampler_reset(rs);
+    *resampler = rs;
+    return 0;
+}
+
+void nvaudio_resampler_release(struct nvaudio_resampler *resampler)
+{
+    if (!resampler)
+        return;
+
+    put_bank(resampler->bank);
+    free(resampler->planes);
+    free(resampler);
+}
+
+void nvaudio_resampler_reset(struct nvaudio_resampler *resampler)
+{
+    uint32_t ch, history;
+
+    if (!resampler)
+        return;
+
+    /* Start from silence, the first output frame lines up with the first
+     * input frame */
+    history = resampler->bank->taps - 1;
+    for (ch = 0; ch < resampler->channels; ch++)
+        memset(resampler->planes + ch * resampler->capacity, 0,
+            history * sizeof(int16_t));
+    resampler->fill = history;
+    resampler->pos = history;
+    resampler->phase = 0;
+}
+
+int nvaudio_resampler_process(struct nvaudio_resampler *resampler,
+    const int16_t *in, size_t *in_frames, int16_t *out, size_t *out_frames)
+{
+    struct nvaudio_resampler *rs = resampler;
+    const struct filter_bank *bank;
+    uint32_t channels, taps, phases, step, ch;
+    size_t take = 0, produced = 0, out_max, start, i;
+    int ret;
+
+    if (!rs || !in || !in_frames || !out || !out_frames)
+        return -EINVAL;
+
+    bank = rs->bank;
+    channels = rs->channels;
+    taps = bank->taps;
+    phases = bank->phases;
+    step = bank->step;
+    out_max = *out_frames;
+
+    /* Input up to the newest frame the last output needs, plus some slack
+     * for the rounding of the caller's period sizes */
+    if (out_max) {
+        uint64_t last = rs->pos +
+            ((uint64_t)rs->phase + (uint64_t)(out_max - 1) * step) / phases;
+
+        if (last + 1 > rs->fill)
+            take = (size_t)(last + 1 - rs->fill);
+        take += INPUT_SLACK_FRAMES;
+        if (take > *in_frames)
+            take = *in_frames;
+    }
+
+    ret = grow_planes(rs, rs->fill + take);
+    if (ret)
+        return ret;
+
+    for (ch = 0; ch < channels; ch++) {
+        int16_t *plane = rs->planes + ch * rs->capacity + rs->fill;
+        const int16_t *src = in + ch;
+
+        for (i = 0; i < take; i++) {
+            plane[i] = *src;
+            src += channels;
+        }
+    }
+    rs->fill += take;
+
+    while (produced < out_max && rs->pos < rs->fill) {
+        const int16_t *coef = bank->coef + rs->phase * taps;
+        const int16_t *x = rs->planes + rs->pos + 1 - taps;
+        int16_t *dst = out + produced * channels;
+
+        if (bank->residual) {
+            const int16_t *residual = bank->residual + rs->phase * taps;
+
+            for (ch = 0; ch < channels; ch++) {
+                dst[ch] = dot_residual(coef, residual, x, taps);
+                x += rs->capacity;
+            }
+        } else {
+            for (ch = 0; ch < channels; ch++) {
+                dst[ch] = dot_q15(coef, x, taps);
+                x += rs->capacity;
+            }
+        }
+        produced++;
+
+        rs->phase += step;
+        rs->pos += rs->phase / phases;
+        rs->phase %= phases;
+    }
+
+    /* Keep only the history the next output frame needs */
+    start = rs->pos + 1 - taps;
+    if (start > rs->fill)
+        start = rs->fill;
+    if (start) {
+        for (ch = 0; ch < channels; ch++) {
+            int16_t *plane = rs->planes + ch * rs->capacity;
+            memmove(plane, plane + start,
+                (rs->fill - start) * sizeof(int16_t));
+        }
+        rs->fill -= start;
+        rs->pos -= start;
+    }
+
+    *in_frames = take;
+    *out_frames = produced;
+    return 0;
+}
+
+int32_t nvaudio_resampler_delay_ns(struct nvaudio_resampler *resampler)
+{
+    size_t buffered;
+
+    if (!resampler)
+        return 0;
+
+    /* Half the filter plus the input held for later outputs */
+    buffered = resampler->bank->taps / 2;
+    if (resampler->fill > resampler->pos + 1)
+        buffered += resampler->fill - resampler->pos - 1;
+
+    return (int32_t)(((int64_t)buffered * 1000000000) / resampler->in_rate);
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+#ifndef LIBAUDIO_NVAUDIO_RESAMPLER_H
+#define LIBAUDIO_NVAUDIO_RESAMPLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*****************************************************************************
+ * MACROS
+ *****************************************************************************/
+/* Rate pairs needing more filter phases than this (out_rate / gcd of the
+ * two rates) are not supported */
+#define NVAUDIO_RESAMPLER_MAX_PHASES    1024
+
+/*****************************************************************************
+ * ENUMS
+ *****************************************************************************/
+enum nvaudio_resampler_quality {
+    NVAUDIO_RESAMPLER_QUALITY_LOW = 0,    /* 24 taps, 60 dB stopband, Q15 */
+    NVAUDIO_RESAMPLER_QUALITY_MEDIUM,     /* 48 taps, 85 dB stopband, Q23 */
+    NVAUDIO_RESAMPLER_QUALITY_HIGH,       /* 96 taps, 100 dB stopband, Q23 */
+    NVAUDIO_RESAMPLER_QUALITY_MAX
+};
+
+/*****************************************************************************
+ * Functions
+ *
+ * Converts interleaved 16 bit PCM between two fixed rates with a polyphase
+ * FIR. The filter bank of each rate pair and quality is designed on first use
+ * and shared by every resampler using it, so creating one for a rate seen
+ * before only allocates the stream state.
+ *****************************************************************************/
+struct nvaudio_resampler;
+
+/* Returns -EINVAL for rates needing more than NVAUDIO_RESAMPLER_MAX_PHASES
+ * phases, or for more than 8 channels */
+int nvaudio_resampler_create(uint32_t in_rate, uint32_t out_rate,
+    uint32_t channels, enum nvaudio_resampler_quality quality,
+    struct nvaudio_resampler **resampler);
+
+void nvaudio_resampler_release(struct nvaudio_resampler *resampler);
+
+/* Drops the buffered input, as after a flush or standby */
+void nvaudio_resampler_reset(struct nvaudio_resampler *resampler);
+
+/*
+ * Consumes up to *in_frames frames from in and writes up to *out_frames
+ * frames to out, returning the frames consumed and produced in them. Input
+ * a little past what the output needs is kept for the next call, so giving
+ * each call the period that matches the output size does not drop frames.
+ *
+ * in and out may be the same buffer, with room for the output: the consumed
+ * input is copied before any output is written. Input left unconsumed in
+ * such a buffer is overwritten.
+ */
+int nvaudio_resampler_process(struct nvaudio_resampler *resampler,
+    const int16_t *in, size_t *in_frames, int16_t *out, size_t *out_frames);
+
+/* Delay added by the filter */
+int32_t nvaudio_resampler_delay_ns(struct nvaudio_resampler *resampler);
+
+#endif // LIBAUDIO_NVAUDIO_RESAMPLER_H
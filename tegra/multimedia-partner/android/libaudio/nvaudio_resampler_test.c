@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2014, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+/*
+ * Resampler quality and cost test.
+ *
+ * Converts -1 dBFS sine waves between the rate pairs the HAL meets at every
+ * quality, feeding the resampler periods of the output size in place the way
+ * the output path does. THD+N is measured against a sine of the input
+ * frequency fitted to the output after the filter delay; the run fails if a
+ * tone in the passband is worse than the limit for its quality, or if a
+ * higher quality measures worse than a lower one for the same rates.
+ *
+ * The cost is reported in CPU cycles per output frame on x86 and in
+ * nanoseconds per frame elsewhere, or in cycles when the CPU clock in MHz is
+ * given.
+ *
+ * usage: nvaudio_resampler_test [cpu_mhz]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define TEST_HAVE_TSC 1
+#endif
+
+#include "nvaudio_resampler.h"
+
+#define TEST_SECONDS            2
+#define TEST_PERIOD_FRAMES      512
+#define TEST_CHANNELS           2
+#define TEST_AMPLITUDE          (32767.0 * 0.891250938)    /* -1 dBFS */
+
+static const uint32_t test_rates[][2] = {
+    { 44100, 48000 },
+    { 48000, 44100 },
+    { 16000, 48000 },
+    { 48000, 16000 },
+    { 8000, 48000 },
+    { 48000, 8000 },
+    { 22050, 44100 },
+    { 32000, 48000 },
+};
+
+static const double test_tones[] = { 100.0, 1000.0, 3000.0, 6000.0, 15000.0 };
+
+/* Worst THD+N allowed in the passband, in dB, a few dB above the worst
+ * measured over the rates below. Low quality is limited by its images and
+ * its Q15 coefficients; the others come close to the 16 bit output. */
+static const double thdn_limit[NVAUDIO_RESAMPLER_QUALITY_MAX] = {
+    -67.0, -88.0, -92.0,
+};
+
+/* Near the 16 bit floor the qualities measure within noise of each other */
+#define TEST_ORDER_SLACK_DB     0.5
+
+static const char *quality_name[NVAUDIO_RESAMPLER_QUALITY_MAX] = {
+    "low", "medium", "high",
+};
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t now_cycles(void)
+{
+#if defined(TEST_HAVE_TSC)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Fits a*sin(wt) + b*cos(wt) + c to the first channel of the output and
+ * returns the residual power relative to the fitted sine in dB.
+ */
+static double measure_thdn(const int16_t *out, size_t frames, size_t skip,
+    double freq, uint32_t rate)
+{
+    double m[3][4] = { { 0 } };
+    double w = 2 * M_PI * freq / rate;
+    double a, b, c, signal, noise = 0.0;
+    size_t i, n = frames - skip;
+    int r, k, col;
+
+    for (i = skip; i < frames; i++) {
+        double v[3] = { sin(w * i), cos(w * i), 1.0 };
+        double y = out[i * TEST_CHANNELS];
+
+        for (r = 0; r < 3; r++) {
+            for (col = 0; col < 3; col++)
+                m[r][col] += v[r] * v[col];
+            m[r][3] += v[r] * y;
+        }
+    }
+
+    for (r = 0; r < 3; r++) {
+        for (k = r + 1; k < 3; k++) {
+            double f = m[k][r] / m[r][r];
+
+            for (col = r; col < 4; col++)
+                m[k][col] -= f * m[r][col];
+        }
+    }
+    c = m[2][3] / m[2][2];
+    b = (m[1][3] - m[1][2] * c) / m[1][1];
+    a = (m[0][3] - m[0][1] * b - m[0][2] * c) / m[0][0];
+
+    for (i = skip; i < frames; i++) {
+        double e = out[i * TEST_CHANNELS] -
+            (a * sin(w * i) + b * cos(w * i) + c);
+
+        noise += e * e;
+    }
+    signal = (a * a + b * b) / 2 * n;
+
+    return 10 * log10((noise + 1e-9) / signal);
+}
+
+static int test_pair(uint32_t in_rate, uint32_t out_rate,
+    enum nvaudio_resampler_quality quality, double cpu_mhz, double *thdn_out)
+{
+    struct nvaudio_resampler *rs;
+    size_t in_total = (size_t)in_rate * TEST_SECONDS;
+    size_t out_total = (size_t)out_rate * TEST_SECONDS;
+    size_t period_in, buf_frames, produced, consumed, skip, timed = 0;
+    double passband = 0.45 * (in_rate < out_rate ? in_rate : out_rate);
+    double worst = -200.0, ns = 0.0;
+    uint64_t cycles = 0;
+    int16_t *in, *out, *work;
+    uint32_t t;
+    int failed = 0;
+
+    period_in = (TEST_PERIOD_FRAMES * (size_t)in_rate + out_rate - 1) /
+        out_rate;
+    buf_frames = period_in > TEST_PERIOD_FRAMES ?
+        period_in : TEST_PERIOD_FRAMES;
+
+    in = malloc(in_total * TEST_CHANNELS * sizeof(int16_t));
+    out = malloc((out_total + TEST_PERIOD_FRAMES) * TEST_CHANNELS *
+        sizeof(int16_t));
+    work = malloc(buf_frames * TEST_CHANNELS * sizeof(int16_t));
+    if (!in || !out || !work) {
+        free(in);
+        free(out);
+        free(work);
+        return 1;
+    }
+
+    if (nvaudio_resampler_create(in_rate, out_rate, TEST_CHANNELS, quality,
+            &rs)) {
+        printf("%5u -> %5u %-6s: create failed\n", in_rate, out_rate,
+            quality_name[quality]);
+        free(in);
+        free(out);
+        free(work);
+        return 1;
+    }
+    skip = (size_t)((double)nvaudio_resampler_delay_ns(rs) * out_rate / 1e9)
+        * 2 + 64;
+
+    for (t = 0; t < sizeof(test_tones) / sizeof(test_tones[0]); t++) {
+        double freq = test_tones[t];
+        double thdn;
+        size_t i;
+
+        if (freq > passband)
+            continue;
+
+        for (i = 0; i < in_total; i++) {
+            int16_t s = (int16_t)lrint(TEST_AMPLITUDE *
+                sin(2 * M_PI * freq * i / in_rate));
+
+            in[i * TEST_CHANNELS] = s;
+            in[i * TEST_CHANNELS + 1] = -s;
+        }
+
+        nvaudio_resampler_reset(rs);
+        consumed = 0;
+        produced = 0;
+        while (produced < out_total && consumed < in_total) {
+            size_t in_frames = in_total - consumed;
+            size_t out_frames = TEST_PERIOD_FRAMES;
+            double start_ns;
+            uint64_t start_cycles;
+
+            if (in_frames > period_in)
+                in_frames = period_in;
+            memcpy(work, in + consumed * TEST_CHANNELS,
+                in_frames * TEST_CHANNELS * sizeof(int16_t));
+
+            start_ns = now_ns();
+            start_cycles = now_cycles();
+            nvaudio_resampler_process(rs, work, &in_frames, work,
+                &out_frames);
+            cycles += now_cycles() - start_cycles;
+            ns += now_ns() - start_ns;
+
+            memcpy(out + produced * TEST_CHANNELS, work,
+                out_frames * TEST_CHANNELS * sizeof(int16_t));
+            consumed += in_frames;
+            produced += out_frames;
+        }
+        timed += produced;
+
+        for (i = skip; i < produced; i++) {
+            /* Rounding may differ by one between the two polarities */
+            if (abs(out[i * TEST_CHANNELS] + out[i * TEST_CHANNELS + 1]) > 1) {
+                printf("  channels differ at frame %zu\n", i);
+                failed = 1;
+                break;
+            }
+        }
+
+        thdn = produced > skip + out_rate / 10 ?
+            measure_thdn(out, produced, skip, freq, out_rate) : 0.0;
+        if (thdn > worst)
+            worst = thdn;
+        if (thdn > thdn_limit[quality]) {
+            printf("  %.0f Hz: THD+N %.1f dB\n", freq, thdn);
+            failed = 1;
+        }
+    }
+
+    if (cycles)
+        cpu_mhz = 0;
+    printf("%5u -> %5u %-6s: THD+N %6.1f dB, %7.1f %s/frame%s\n",
+        in_rate, out_rate, quality_name[quality], worst,
+        cycles ? (double)cycles / timed :
+            cpu_mhz ? ns * cpu_mhz / 1000 / timed : ns / timed,
+        cycles || cpu_mhz ? "cycles" : "ns", failed ? "  FAIL" : "");
+
+    *thdn_out = worst;
+    nvaudio_resampler_release(rs);
+    free(in);
+    free(out);
+    free(work);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    double cpu_mhz = 0.0;
+    uint32_t p, q;
+    int failed = 0;
+
+    if (argc > 1)
+        cpu_mhz = strtod(argv[1], NULL);
+
+    for (p = 0; p < sizeof(test_rates) / sizeof(test_rates[0]); p++) {
+        double thdn[NVAUDIO_RESAMPLER_QUALITY_MAX];
+
+        for (q = 0; q < NVAUDIO_RESAMPLER_QUALITY_MAX; q++)
+            failed |= test_pair(test_rates[p][0], test_rates[p][1], q,
+                cpu_mhz, &thdn[q]);
+
+        for (q = 1; q < NVAUDIO_RESAMPLER_QUALITY_MAX; q++) {
+            if (thdn[q] > thdn[q - 1] + TEST_ORDER_SLACK_DB) {
+                printf("  %s is worse than %s\n", quality_name[q],
+                    quality_name[q - 1]);
+                failed = 1;
+            }
+        }
+    }
+
+    printf(failed ? "FAILED\n" : "PASSED\n");
+    return failed;
+}
@@ -140,6 +140,11 @@ typedef enum
      *   To set NvMMAttribute_UAProf for super parser block.
      */
     NvMMAttribute_UserAgentProf,
+
+    /** AttributeType for parser cores
+     *   To get the seek latency counters as NvMMSeekIndexStats (nvmm_seekindex.h).
+     */
+    NvMMAttribute_SeekStats,
 } NvMMParserAttribute;
 
 typedef struct
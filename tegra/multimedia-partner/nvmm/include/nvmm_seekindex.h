@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2013 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software and related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+#ifndef INCLUDED_NVMM_SEEKINDEX_H
+#define INCLUDED_NVMM_SEEKINDEX_H
+
+#include "nvcommon.h"
+#include "nverror.h"
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+/**
+ * Two-level seek index shared by the parsers.
+ *
+ * Level one is a table of seek points, at most one every Granularity
+ * samples, that maps a presentation time to the sample number and, when the
+ * container knows it, the byte offset of that sample. The table is filled
+ * in increasing order by the parser, typically lazily while it walks its own
+ * time tables, and is searched with a binary search. Level two is container
+ * specific: the parser resumes from the returned point, using the private
+ * cursors it stored in it, and only has to refine over one span of at most
+ * Granularity samples.
+ *
+ * The index also keeps seek latency counters that the parser updates around
+ * each seek with NvMMSeekIndexSeekBegin/NvMMSeekIndexSeekEnd.
+ *
+ * The index is not thread safe.
+ */
+
+/** Offset value for points whose byte offset is resolved by the parser. */
+#define NVMM_SEEKINDEX_OFFSET_UNKNOWN   ((NvU64)-1)
+
+typedef struct NvMMSeekIndexRec *NvMMSeekIndexHandle;
+
+typedef struct NvMMSeekPointRec
+{
+    NvU64 Time;         /**< time of the sample, in the parser's time base */
+    NvU64 Offset;       /**< byte offset or NVMM_SEEKINDEX_OFFSET_UNKNOWN */
+    NvU32 Sample;       /**< 0 based sample number */
+    NvU32 Cursor[2];    /**< parser private table cursors at this sample */
+} NvMMSeekPoint;
+
+typedef struct NvMMSeekIndexStatsRec
+{
+    NvU32 PointCount;       /**< level one points held by the index */
+    NvU32 LookupCount;      /**< level one lookups */
+    NvU32 SeekCount;        /**< seeks timed by the parser */
+    NvU32 LastLatencyUs;
+    NvU32 MaxLatencyUs;
+    NvU64 TotalLatencyUs;
+    NvU32 FrameBudgetUs;    /**< one frame interval, 0 if not known */
+    NvU32 OverBudgetCount;  /**< seeks that took longer than FrameBudgetUs */
+} NvMMSeekIndexStats;
+
+/**
+ * Creates an empty index.
+ *
+ * @param Granularity Minimum distance, in samples, between two points.
+ */
+NvError NvMMSeekIndexCreate(NvMMSeekIndexHandle *phIndex, NvU32 Granularity);
+void NvMMSeekIndexDestroy(NvMMSeekIndexHandle hIndex);
+
+/** Drops every point. Latency counters are kept. */
+void NvMMSeekIndexReset(NvMMSeekIndexHandle hIndex);
+
+/**
+ * Appends a point. Points must be added with non-decreasing time and sample
+ * number; a point closer than Granularity samples to the last one is
+ * silently dropped.
+ */
+NvError NvMMSeekIndexAddPoint(NvMMSeekIndexHandle hIndex, const NvMMSeekPoint *pPoint);
+
+/** Returns NV_FALSE when the index is empty. */
+NvBool NvMMSeekIndexGetLastPoint(NvMMSeekIndexHandle hIndex, NvMMSeekPoint *pPoint);
+
+/**
+ * Finds the last point at or before Time.
+ *
+ * @retval NvError_BadValue if the index is empty or its first point is
+ *         after Time.
+ */
+NvError NvMMSeekIndexFindTime(NvMMSeekIndexHandle hIndex, NvU64 Time, NvMMSeekPoint *pPoint);
+
+/** Finds the last point at or before Sample. */
+NvError NvMMSeekIndexFindSample(NvMMSeekIndexHandle hIndex, NvU32 Sample, NvMMSeekPoint *pPoint);
+
+/**
+ * Returns the index of the first of Count ascending values that is not
+ * less than Key, or Count if there is none. Used for level two refinement
+ * over tables read by the parser.
+ */
+NvU32 NvMMSeekIndexLowerBound(const NvU32 *pValues, NvU32 Count, NvU32 Key);
+
+/** Sets the budget seeks are measured against, normally one frame interval. */
+void NvMMSeekIndexSetFrameBudget(NvMMSeekIndexHandle hIndex, NvU32 BudgetUs);
+void NvMMSeekIndexSeekBegin(NvMMSeekIndexHandle hIndex);
+void NvMMSeekIndexSeekEnd(NvMMSeekIndexHandle hIndex);
+void NvMMSeekIndexGetStats(NvMMSeekIndexHandle hIndex, NvMMSeekIndexStats *pStats);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // INCLUDED_NVMM_SEEKINDEX_H
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2006 - 2007 NVIDIA Corporation.  All rights reserved.
+ * Copyright (c) 2006 - 2013 NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -103,6 +103,20 @@ typedef enum
       */
     NvMMWriterAttribute_TrakDurationLimit,
 
+    /** AttributeType for Base writer Block
+      *     To set NvMMWriterAttribute_SegmentDuration for writer block.
+      * attribute for splitting the output into segments of about this
+      * duration in msec, each starting on a video sync frame
+      */
+    NvMMWriterAttribute_SegmentDuration,
+
+     /**
+      *     To set NvMMWriterAttribute_FragmentDuration for writer block.
+      * attribute for writing fragmented MP4 with movie fragments of about
+      * this duration in msec, each starting on a video sync frame
+      */
+    NvMMWriterAttribute_FragmentDuration,
+
     NvMMWriterAttribute_Force32 = 0x7FFFFFFF
 
 }NvMMWriterAttribute;
@@ -171,6 +185,18 @@ typedef struct
     NvU64 maxTrakDuration;
 }NvMMWriterAttrib_TrakDurationLimit;
 
+ // segment duration, 0 writes a single segment
+typedef struct
+{
+    NvU64 segmentDuration;
+}NvMMWriterAttrib_SegmentDuration;
+
+ // fragment duration in msec, 0 writes a regular (non fragmented) file
+typedef struct
+{
+    NvU32 fragmentDuration;
+}NvMMWriterAttrib_FragmentDuration;
+
 typedef struct NvMMMP4WriterVideoConfig
 {
 
@@ -14,5 +14,6 @@ LOCAL_SRC_FILES += nvmm_3gpwriterblock.c
 LOCAL_SRC_FILES += nv_3gp_writer.c
 LOCAL_SRC_FILES += nv3gpwritervideo.c
 LOCAL_SRC_FILES += nv3gpwriteraudio.c
+LOCAL_SRC_FILES += nv3gpwriterfragment.c
 
 include $(NVIDIA_STATIC_LIBRARY)
@@ -0,0 +1,906 @@
+/*
+ * Copyright (c) 2013 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+/*
+ * Fragmented MP4 output of the 3GP writer (ISO/IEC 14496-12 movie
+ * fragments). The first fragment is preceded by ftyp and by a moov whose
+ * sample tables are empty and which announces the fragments with mvex;
+ * each fragment is a moof + mdat pair carrying its own sample table, so
+ * nothing is kept in temporary files or rewritten at close, and a file cut
+ * short loses at most the fragment being written.
+ *
+ * A fragment ends on the first video sync frame (any audio frame without
+ * video) once the fragment duration has elapsed, or earlier when its buffer
+ * or sample table is full. Video data is copied straight into the fragment
+ * buffer behind room reserved for the headers; audio is staged aside and
+ * appended when the fragment completes so that each track's samples are
+ * contiguous in the mdat.
+ *
+ * Only H.264 video and AAC audio are supported.
+ */
+
+#include "nv_3gp_writer.h"
+#include "nvos.h"
+#include "nvmm_common.h"
+
+#define FRAG_TRACK_ID_AUDIO 2
+#define FRAG_TRACK_ID_VIDEO 1
+// 100 ns units to TIME_SCALE
+#define FRAG_TS_TO_TIME_SCALE(t) ((t) / (10000000 / TIME_SCALE))
+// sample_flags of trun: sample_depends_on = 2 for sync samples, 1 and
+// sample_is_non_sync_sample for others
+#define FRAG_SAMPLE_FLAGS_SYNC 0x02000000
+#define FRAG_SAMPLE_FLAGS_NON_SYNC 0x01010000
+// tfhd default-base-is-moof
+#define FRAG_TFHD_FLAGS 0x020000
+// trun data-offset, sample-duration, sample-size and sample-flags present
+#define FRAG_TRUN_FLAGS 0x000701
+#define FRAG_TRUN_ENTRY_SIZE 12
+#define FRAG_NAL_TYPE_SPS 7
+#define FRAG_NAL_TYPE_PPS 8
+#define FRAG_AAC_OBJECT_LC 2
+#define FRAG_AAC_OBJECT_SBR 5
+// estimate of moof and mdat headers, used for the pending size
+#define FRAG_MOOF_BASE_SIZE 256
+
+// Supported sampling rates for AAC encoding
+static NvU32 s_AacSamplingRates[] =
+{
+    96000, 88200, 64000, 48000, 44100, 32000,
+    24000, 22050, 16000, 12000, 11025, 8000
+};
+
+static void
+NvMM3GpFragPut8(
+    NvU8 *pBuf,
+    NvU32 *pOffset,
+    NvU32 Val)
+{
+    pBuf[(*pOffset)++] = (NvU8)Val;
+}
+
+static void
+NvMM3GpFragPut16(
+    NvU8 *pBuf,
+    NvU32 *pOffset,
+    NvU32 Val)
+{
+    COPY_TWO_BYTES((pBuf + *pOffset), (Val >> 8), Val);
+    *pOffset += sizeof(NvU16);
+}
+
+static void
+NvMM3GpFragPut32(
+    NvU8 *pBuf,
+    NvU32 *pOffset,
+    NvU32 Val)
+{
+    LITTLE_TO_BIG_ENDIAN((pBuf + *pOffset), Val);
+    *pOffset += sizeof(NvU32);
+}
+
+static void
+NvMM3GpFragPutZeros(
+    NvU8 *pBuf,
+    NvU32 *pOffset,
+    NvU32 Count)
+{
+    NvOsMemset(pBuf + *pOffset, 0, Count);
+    *pOffset += Count;
+}
+
+/* Opens a box; returns its offset for NvMM3GpFragEndBox. */
+static NvU32
+NvMM3GpFragStartBox(
+    NvU8 *pBuf,
+    NvU32 *pOffset,
+    const char *pType)
+{
+    NvU32 Start = *pOffset;
+
+    *pOffset += sizeof(NvU32);
+    COPY_FOUR_BYTES((pBuf + *pOffset), pType[0], pType[1], pType[2], pType[3]);
+    *pOffset += sizeof(NvU32);
+    return Start;
+}
+
+static NvU32
+NvMM3GpFragStartFullBox(
+    NvU8 *pBuf,
+    NvU32 *pOffset,
+    const char *pType,
+    NvU32 VersionFlags)
+{
+    NvU32 Start = NvMM3GpFragStartBox(pBuf, pOffset, pType);
+
+    NvMM3GpFragPut32(pBuf, pOffset, VersionFlags);
+    return Start;
+}
+
+static void
+NvMM3GpFragEndBox(
+    NvU8 *pBuf,
+    NvU32 *pOffset,
+    NvU32 Start)
+{
+    LITTLE_TO_BIG_ENDIAN((pBuf + Start), (*pOffset - Start));
+}
+
+static void
+NvMM3GpFragWriteFtyp(
+    NvMM3GpMuxInputParam *pInpParam,
+    NvU8 *pBuf,
+    NvU32 *pOffset)
+{
+    NvU32 Box;
+    const char *pMajor = "3gp6";
+
+    if (!NvOsStrcmp(&pInpParam->FileExt[0], "mp4"))
+        pMajor = "iso5";
+
+    Box = NvMM3GpFragStartBox(pBuf, pOffset, "ftyp");
+    COPY_FOUR_BYTES((pBuf + *pOffset), pMajor[0], pMajor[1], pMajor[2], pMajor[3]);
+    *pOffset += sizeof(NvU32);
+    NvMM3GpFragPut32(pBuf, pOffset, 0);
+    COPY_FOUR_BYTES((pBuf + *pOffset), pMajor[0], pMajor[1], pMajor[2], pMajor[3]);
+    *pOffset += sizeof(NvU32);
+    COPY_FOUR_BYTES((pBuf + *pOffset), 'i', 's', 'o', '5');
+    *pOffset += sizeof(NvU32);
+    COPY_FOUR_BYTES((pBuf + *pOffset), 'i', 's', 'o', 'm');
+    *pOffset += sizeof(NvU32);
+    NvMM3GpFragEndBox(pBuf, pOffset, Box);
+}
+
+static void
+NvMM3GpFragWriteMatrix(
+    NvU8 *pBuf,
+    NvU32 *pOffset)
+{
+    NvMM3GpFragPut32(pBuf, pOffset, 0x00010000);
+    NvMM3GpFragPutZeros(pBuf, pOffset, 12);
+    NvMM3GpFragPut32(pBuf, pOffset, 0x00010000);
+    NvMM3GpFragPutZeros(pBuf, pOffset, 12);
+    NvMM3GpFragPut32(pBuf, pOffset, 0x40000000);
+}
+
+static void
+NvMM3GpFragWriteAvcSampleEntry(
+    Nv3gpFragMux *pFrag,
+    NvMM3GpMuxInputParam *pInpParam,
+    NvU8 *pBuf,
+    NvU32 *pOffset)
+{
+    NvU32 Entry;
+    NvU32 Box;
+
+    Entry = NvMM3GpFragStartBox(pBuf, pOffset, "avc1");
+    NvMM3GpFragPutZeros(pBuf, pOffset, 6);
+    // data reference index
+    NvMM3GpFragPut16(pBuf, pOffset, 1);
+    NvMM3GpFragPutZeros(pBuf, pOffset, 16);
+    NvMM3GpFragPut16(pBuf, pOffset, pInpParam->VOPWidth);
+    NvMM3GpFragPut16(pBuf, pOffset, pInpParam->VOPHeight);
+    // 72 dpi
+    NvMM3GpFragPut32(pBuf, pOffset, 0x00480000);
+    NvMM3GpFragPut32(pBuf, pOffset, 0x00480000);
+    NvMM3GpFragPut32(pBuf, pOffset, 0);
+    // frame count
+    NvMM3GpFragPut16(pBuf, pOffset, 1);
+    // compressor name
+    NvMM3GpFragPutZeros(pBuf, pOffset, 32);
+    NvMM3GpFragPut16(pBuf, pOffset, 0x0018);
+    NvMM3GpFragPut16(pBuf, pOffset, 0xFFFF);
+
+    Box = NvMM3GpFragStartBox(pBuf, pOffset, "avcC");
+    NvMM3GpFragPut8(pBuf, pOffset, 1);
+    NvMM3GpFragPut8(pBuf, pOffset, pFrag->Sps[1]);
+    NvMM3GpFragPut8(pBuf, pOffset, pFrag->Sps[2]);
+    NvMM3GpFragPut8(pBuf, pOffset, pFrag->Sps[3]);
+    // 4 byte NAL lengths
+    NvMM3GpFragPut8(pBuf, pOffset, 0xFF);
+    NvMM3GpFragPut8(pBuf, pOffset, 0xE1);
+    NvMM3GpFragPut16(pBuf, pOffset, pFrag->SpsSize);
+    NvOsMemcpy(pBuf + *pOffset, pFrag->Sps, pFrag->SpsSize);
+    *pOffset += pFrag->SpsSize;
+    NvMM3GpFragPut8(pBuf, pOffset, 1);
+    NvMM3GpFragPut16(pBuf, pOffset, pFrag->PpsSize);
+    NvOsMemcpy(pBuf + *pOffset, pFrag->Pps, pFrag->PpsSize);
+    *pOffset += pFrag->PpsSize;
+    NvMM3GpFragEndBox(pBuf, pOffset, Box);
+
+    NvMM3GpFragEndBox(pBuf, pOffset, Entry);
+}
+
+static void
+NvMM3GpFragWriteAacSampleEntry(
+    NvMM3GpMuxInputParam *pInpParam,
+    NvU8 *pBuf,
+    NvU32 *pOffset)
+{
+    NvU32 Entry;
+    NvU32 Box;
+    NvU32 Config = 0;
+    NvU32 ConfigBits = 0;
+    NvU32 ConfigSize = 0;
+    NvU32 SampleRate = 0;
+    NvU32 FreqIndex = pInpParam->AacSamplingFreqIndex;
+    NvU32 ExtIndex = 0;
+    NvU32 ObjectType = pInpParam->AacObjectType;
+    NvU32 i;
+
+    if (FreqIndex >= NV_ARRAY_SIZE(s_AacSamplingRates))
+        FreqIndex = 4;
+    SampleRate = s_AacSamplingRates[FreqIndex];
+
+    // AudioSpecificConfig: object type, sampling frequency index, channel
+    // configuration and, for HE-AAC, the explicit SBR extension followed by
+    // the core object type; then a GASpecificConfig of three zero bits
+    if (FRAG_AAC_OBJECT_SBR == ObjectType)
+    {
+        for (ExtIndex = 0; ExtIndex < FreqIndex; ExtIndex++)
+        {
+            if (s_AacSamplingRates[ExtIndex] == SampleRate * 2)
+                break;
+        }
+        Config = (FRAG_AAC_OBJECT_SBR << 20) | (FreqIndex << 16) |
+            ((pInpParam->AacChannelNumber & 0xF) << 12) |
+            ((ExtIndex & 0xF) << 8) | (FRAG_AAC_OBJECT_LC << 3);
+        ConfigBits = 25;
+        ConfigSize = 4;
+        SampleRate *= 2;
+    }
+    else
+    {
+        if (!ObjectType || ObjectType > 31)
+            ObjectType = FRAG_AAC_OBJECT_LC;
+        Config = (ObjectType << 11) | (FreqIndex << 7) |
+            ((pInpParam->AacChannelNumber & 0xF) << 3);
+        ConfigBits = 16;
+        ConfigSize = 2;
+    }
+    Config <<= (ConfigSize * 8) - ConfigBits;
+
+    Entry = NvMM3GpFragStartBox(pBuf, pOffset, "mp4a");
+    NvMM3GpFragPutZeros(pBuf, pOffset, 6);
+    NvMM3GpFragPut16(pBuf, pOffset, 1);
+    NvMM3GpFragPutZeros(pBuf, pOffset, 8);
+    NvMM3GpFragPut16(pBuf, pOffset, pInpParam->AacChannelNumber);
+    NvMM3GpFragPut16(pBuf, pOffset, 16);
+    NvMM3GpFragPutZeros(pBuf, pOffset, 4);
+    NvMM3GpFragPut32(pBuf, pOffset, SampleRate << 16);
+
+    Box = NvMM3GpFragStartFullBox(pBuf, pOffset, "esds", 0);
+    // ES_Descriptor
+    NvMM3GpFragPut8(pBuf, pOffset, 3);
+    NvMM3GpFragPut8(pBuf, pOffset, 3 + 15 + ConfigSize + 2 + 3);
+    NvMM3GpFragPut16(pBuf, pOffset, 0);
+    NvMM3GpFragPut8(pBuf, pOffset, 0);
+    // DecoderConfigDescriptor: MPEG-4 audio, audio stream
+    NvMM3GpFragPut8(pBuf, pOffset, 4);
+    NvMM3GpFragPut8(pBuf, pOffset, 13 + ConfigSize + 2);
+    NvMM3GpFragPut8(pBuf, pOffset, 0x40);
+    NvMM3GpFragPut8(pBuf, pOffset, 0x15);
+    NvMM3GpFragPutZeros(pBuf, pOffset, 3);
+    NvMM3GpFragPut32(pBuf, pOffset, pInpParam->AacMaxBitRate);
+    NvMM3GpFragPut32(pBuf, pOffset, pInpParam->AacAvgBitRate);
+    // DecoderSpecificInfo
+    NvMM3GpFragPut8(pBuf, pOffset, 5);
+    NvMM3GpFragPut8(pBuf, pOffset, ConfigSize);
+    for (i = 0; i < ConfigSize; i++)
+        NvMM3GpFragPut8(pBuf, pOffset, Config >> ((ConfigSize - 1 - i) * 8));
+    // SLConfigDescriptor
+    NvMM3GpFragPut8(pBuf, pOffset, 6);
+    NvMM3GpFragPut8(pBuf, pOffset, 1);
+    NvMM3GpFragPut8(pBuf, pOffset, 2);
+    NvMM3GpFragEndBox(pBuf, pOffset, Box);
+
+    NvMM3GpFragEndBox(pBuf, pOffset, Entry);
+}
+
+static void
+NvMM3GpFragWriteTrak(
+    Nv3gpFragMux *pFrag,
+    NvMM3GpMuxInputParam *pInpParam,
+    NvU32 TrackIndex,
+    NvU8 *pBuf,
+    NvU32 *pOffset)
+{
+    NvMM3GpMuxFragTrack *pTrack = &pFrag->Track[TrackIndex];
+    NvBool IsVideo = (VIDEO_TRACK == TrackIndex);
+    NvU32 Trak, Mdia, Minf, Dinf, Dref, Stbl, Stsd, Box;
+
+    Trak = NvMM3GpFragStartBox(pBuf, pOffset, "trak");
+
+    // enabled, in movie and in preview
+    Box = NvMM3GpFragStartFullBox(pBuf, pOffset, "tkhd", 0x7);
+    NvMM3GpFragPut32(pBuf, pOffset, CREATION_TIME);
+    NvMM3GpFragPut32(pBuf, pOffset, MODIFICATION_TIME);
+    NvMM3GpFragPut32(pBuf, pOffset, pTrack->TrackId);
+    NvMM3GpFragPut32(pBuf, pOffset, 0);
+    // duration comes from the fragments
+    NvMM3GpFragPut32(pBuf, pOffset, 0);
+    NvMM3GpFragPutZeros(pBuf, pOffset, 8);
+    // layer, alternate group
+    NvMM3GpFragPut32(pBuf, pOffset, 0);
+    NvMM3GpFragPut16(pBuf, pOffset, IsVideo ? 0 : 0x0100);
+    NvMM3GpFragPut16(pBuf, pOffset, 0);
+    NvMM3GpFragWriteMatrix(pBuf, pOffset);
+    NvMM3GpFragPut32(pBuf, pOffset, IsVideo ? (NvU32)pInpParam->VOPWidth << 16 : 0);
+    NvMM3GpFragPut32(pBuf, pOffset, IsVideo ? (NvU32)pInpParam->VOPHeight << 16 : 0);
+    NvMM3GpFragEndBox(pBuf, pOffset, Box);
+
+    Mdia = NvMM3GpFragStartBox(pBuf, pOffset, "mdia");
+    Box = NvMM3GpFragStartFullBox(pBuf, pOffset, "mdhd", 0);
+    NvMM3GpFragPut32(pBuf, pOffset, CREATION_TIME);
+    NvMM3GpFragPut32(pBuf, pOffset, MODIFICATION_TIME);
+    NvMM3GpFragPut32(pBuf, pOffset, TIME_SCALE);
+    NvMM3GpFragPut32(pBuf, pOffset, 0);
+    // language "und"
+    NvMM3GpFragPut16(pBuf, pOffset, 0x55C4);
+    NvMM3GpFragPut16(pBuf, pOffset, 0);
+    NvMM3GpFragEndBox(pBuf, pOffset, Box);
+
+    Box = NvMM3GpFragStartFullBox(pBuf, pOffset, "hdlr", 0);
+    NvMM3GpFragPut32(pBuf, pOffset, 0);
+    if (IsVideo)
+    {
+        COPY_FOUR_BYTES((pBuf + *pOffset), 'v', 'i', 'd', 'e');
+    }
+    else
+    {
+        COPY_FOUR_BYTES((pBuf + *pOffset), 's', 'o', 'u', 'n');
+    }
+    *pOffset += sizeof(NvU32);
+    NvMM3GpFragPutZeros(pBuf, pOffset, 12);
+    NvOsMemcpy(pBuf + *pOffset, IsVideo ? "VideoHandler" : "SoundHandler", 13);
+    *pOffset += 13;
+    NvMM3GpFragEndBox(pBuf, pOffset, Box);
+
+    Minf = NvMM3GpFragStartBox(pBuf, pOffset, "minf");
+    if (IsVideo)
+    {
+        Box = NvMM3GpFragStartFullBox(pBuf, pOffset, "vmhd", 1);
+        NvMM3GpFragPutZeros(pBuf, pOffset, 8);
+    }
+    else
+    {
+        Box = NvMM3GpFragStartFullBox(pBuf, pOffset, "smhd", 0);
+        NvMM3GpFragPutZeros(pBuf, pOffset, 4);
+    }
+    NvMM3GpFragEndBox(pBuf, pOffset, Box);
+
+    Dinf = NvMM3GpFragStartBox(pBuf, pOffset, "dinf");
+    Dref = NvMM3GpFragStartFullBox(pBuf, pOffset, "dref", 0);
+    NvMM3GpFragPut32(pBuf, pOffset, 1);
+    // media data is in this file
+    Box = NvMM3GpFragStartFullBox(pBuf, pOffset, "url ", 1);
+    NvMM3GpFragEndBox(pBuf, pOffset, Box);
+    NvMM3GpFragEndBox(pBuf, pOffset, Dref);
+    NvMM3GpFragEndBox(pBuf, pOffset, Dinf);
+
+    // the sample tables of a fragmented file are empty
+    Stbl = NvMM3GpFragStartBox(pBuf, pOffset, "stbl");
+    Stsd = NvMM3GpFragStartFullBox(pBuf, pOffset, "stsd", 0);
+    NvMM3GpFragPut32(pBuf, pOffset, 1);
+    if (IsVideo)
+        NvMM3GpFragWriteAvcSampleEntry(pFrag, pInpParam, pBuf, pOffset);
+    else
+        NvMM3GpFragWriteAacSampleEntry(pInpParam, pBuf, pOffset);
+    NvMM3GpFragEndBox(pBuf, pOffset, Stsd);
+    Box = NvMM3GpFragStartFullBox(pBuf, pOffset, "stts", 0);
+    NvMM3GpFragPut32(pBuf, pOffset, 0);
+    NvMM3GpFragEndBox(pBuf, pOffset, Box);
+    Box = NvMM3GpFragStartFullBox(pBuf, pOffset, "stsc", 0);
+    NvMM3GpFragPut32(pBuf, pOffset, 0);
+    NvMM3GpFragEndBox(pBuf, pOffset, Box);
+    Box = NvMM3GpFragStartFullBox(pBuf, pOffset, "stsz", 0);
+    NvMM3GpFragPut32(pBuf, pOffset, 0);
+    NvMM3GpFragPut32(pBuf, pOffset, 0);
+    NvMM3GpFragEndBox(pBuf, pOffset, Box);
+    Box = NvMM3GpFragStartFullBox(pBuf, pOffset, "stco", 0);
+    NvMM3GpFragPut32(pBuf, pOffset, 0);
+    NvMM3GpFragEndBox(pBuf, pOffset, Box);
+    NvMM3GpFragEndBox(pBuf, pOffset, Stbl);
+
+    NvMM3GpFragEndBox(pBuf, pOffset, Minf);
+    NvMM3GpFragEndBox(pBuf, pOffset, Mdia);
+    NvMM3GpFragEndBox(pBuf, pOffset, Trak);
+}
+
+/*
+ * Writes the moov for the tracks that can be described: the video track
+ * needs its SPS and PPS, which come with the first video frame.
+ */
+static void
+NvMM3GpFragWriteMoov(
+    Nv3gpFragMux *pFrag,
+    NvMM3GpMuxInputParam *pInpParam,
+    NvU8 *pBuf,
+    NvU32 *pOffset)
+{
+    NvU32 Moov, Mvex, Box;
+    NvU32 i;
+
+    if (pFrag->Track[VIDEO_TRACK].Present && pFrag->SpsSize && pFrag->PpsSize)
+        pFrag->Track[VIDEO_TRACK].InMoov = NV_TRUE;
+    if (pFrag->Track[SOUND_TRACK].Present)
+        pFrag->Track[SOUND_TRACK].InMoov = NV_TRUE;
+
+    Moov = NvMM3GpFragStartBox(pBuf, pOffset, "moov");
+
+    Box = NvMM3GpFragStartFullBox(pBuf, pOffset, "mvhd", 0);
+    NvMM3GpFragPut32(pBuf, pOffset, CREATION_TIME);
+    NvMM3GpFragPut32(pBuf, pOffset, MODIFICATION_TIME);
+    NvMM3GpFragPut32(pBuf, pOffset, TIME_SCALE);
+    NvMM3GpFragPut32(pBuf, pOffset, 0);
+    // rate 1.0, volume 1.0
+    NvMM3GpFragPut32(pBuf, pOffset, 0x00010000);
+    NvMM3GpFragPut16(pBuf, pOffset, 0x0100);
+    NvMM3GpFragPutZeros(pBuf, pOffset, 10);
+    NvMM3GpFragWriteMatrix(pBuf, pOffset);
+    NvMM3GpFragPutZeros(pBuf, pOffset, 24);
+    NvMM3GpFragPut32(pBuf, pOffset, FRAG_TRACK_ID_AUDIO + 1);
+    NvMM3GpFragEndBox(pBuf, pOffset, Box);
+
+    // video first
+    for (i = MAX_TRACK; i-- > 0;)
+    {
+        if (pFrag->Track[i].InMoov)
+            NvMM3GpFragWriteTrak(pFrag, pInpParam, i, pBuf, pOffset);
+    }
+
+    Mvex = NvMM3GpFragStartBox(pBuf, pOffset, "mvex");
+    for (i = MAX_TRACK; i-- > 0;)
+    {
+        if (!pFrag->Track[i].InMoov)
+            continue;
+        Box = NvMM3GpFragStartFullBox(pBuf, pOffset, "trex", 0);
+        NvMM3GpFragPut32(pBuf, pOffset, pFrag->Track[i].TrackId);
+        // sample description index; duration, size and flags are per sample
+        NvMM3GpFragPut32(pBuf, pOffset, 1);
+        NvMM3GpFragPutZeros(pBuf, pOffset, 12);
+        NvMM3GpFragEndBox(pBuf, pOffset, Box);
+    }
+    NvMM3GpFragEndBox(pBuf, pOffset, Mvex);
+
+    NvMM3GpFragEndBox(pBuf, pOffset, Moov);
+    pFrag->MoovWritten = NV_TRUE;
+}
+
+/*
+ * Completes the fragment being filled: appends the staged audio to the
+ * video data, writes ftyp + moov (first fragment only), moof and the mdat
+ * header in front of it, and switches to the other fragment buffer.
+ * NextTime is the decode time of the sample of track NextTrack that starts
+ * the next fragment, if any, and gives the last sample of that track its
+ * duration; the other track repeats its last duration.
+ */
+static void
+NvMM3GpFragComplete(
+    Nv3gpFragMux *pFrag,
+    NvMM3GpMuxInputParam *pInpParam,
+    NvU32 NextTrack,
+    NvU64 NextTime,
+    NvMM3GpMuxFragment *pFragment)
+{
+    NvU8 *pHeader = pFrag->pHeader;
+    NvU8 *pData = pFrag->pFragBuffer[pFrag->FragIndex] + FRAG_HEADER_RESERVE;
+    NvMM3GpMuxFragTrack *pTrack = NULL;
+    NvMM3GpMuxFragSample *pSample = NULL;
+    NvU32 Offset = 0;
+    NvU32 Moof, Traf, Box;
+    NvU32 DataOffsetPos[MAX_TRACK];
+    NvU32 TrackDataOffset[MAX_TRACK];
+    NvU32 MdatPayload = 0;
+    NvU32 MoofSize = 0;
+    NvU32 Delta = 0;
+    NvU32 i, j;
+
+    // each track's samples are contiguous in the mdat: video, then audio
+    TrackDataOffset[VIDEO_TRACK] = 0;
+    TrackDataOffset[SOUND_TRACK] = pFrag->Track[VIDEO_TRACK].DataSize;
+    if (pFrag->Track[SOUND_TRACK].DataSize)
+    {
+        NvOsMemcpy(pData + TrackDataOffset[SOUND_TRACK], pFrag->pAudioStaging,
+            pFrag->Track[SOUND_TRACK].DataSize);
+    }
+    MdatPayload = pFrag->Track[VIDEO_TRACK].DataSize + pFrag->Track[SOUND_TRACK].DataSize;
+
+    if (!pFrag->MoovWritten)
+    {
+        NvMM3GpFragWriteFtyp(pInpParam, pHeader, &Offset);
+        NvMM3GpFragWriteMoov(pFrag, pInpParam, pHeader, &Offset);
+    }
+
+    Moof = NvMM3GpFragStartBox(pHeader, &Offset, "moof");
+    Box = NvMM3GpFragStartFullBox(pHeader, &Offset, "mfhd", 0);
+    NvMM3GpFragPut32(pHeader, &Offset, ++pFrag->SequenceNumber);
+    NvMM3GpFragEndBox(pHeader, &Offset, Box);
+
+    for (i = MAX_TRACK; i-- > 0;)
+    {
+        pTrack = &pFrag->Track[i];
+        DataOffsetPos[i] = 0;
+        // samples of a track left out of the moov stay unreferenced
+        if (!pTrack->SampleCount || !pTrack->InMoov)
+            continue;
+
+        Traf = NvMM3GpFragStartBox(pHeader, &Offset, "traf");
+        Box = NvMM3GpFragStartFullBox(pHeader, &Offset, "tfhd", FRAG_TFHD_FLAGS);
+        NvMM3GpFragPut32(pHeader, &Offset, pTrack->TrackId);
+        NvMM3GpFragEndBox(pHeader, &Offset, Box);
+
+        // version 1: 64 bit base media decode time
+        Box = NvMM3GpFragStartFullBox(pHeader, &Offset, "tfdt", 0x01000000);
+        NvMM3GpFragPut32(pHeader, &Offset, (NvU32)(pTrack->Samples[0].DecodeTime >> 32));
+        NvMM3GpFragPut32(pHeader, &Offset, (NvU32)pTrack->Samples[0].DecodeTime);
+        NvMM3GpFragEndBox(pHeader, &Offset, Box);
+
+        Box = NvMM3GpFragStartFullBox(pHeader, &Offset, "trun", FRAG_TRUN_FLAGS);
+        NvMM3GpFragPut32(pHeader, &Offset, pTrack->SampleCount);
+        DataOffsetPos[i] = Offset;
+        NvMM3GpFragPut32(pHeader, &Offset, 0);
+        for (j = 0; j < pTrack->SampleCount; j++)
+        {
+            pSample = &pTrack->Samples[j];
+            if (j + 1 < pTrack->SampleCount)
+                Delta = (NvU32)(pTrack->Samples[j + 1].DecodeTime - pSample->DecodeTime);
+            else if (NextTrack == i)
+                Delta = (NvU32)(NextTime - pSample->DecodeTime);
+            else
+                Delta = pTrack->LastDelta;
+            pTrack->LastDelta = Delta;
+            NvMM3GpFragPut32(pHeader, &Offset, Delta);
+            NvMM3GpFragPut32(pHeader, &Offset, pSample->Size);
+            NvMM3GpFragPut32(pHeader, &Offset, pSample->Flags);
+        }
+        NvMM3GpFragEndBox(pHeader, &Offset, Box);
+        NvMM3GpFragEndBox(pHeader, &Offset, Traf);
+    }
+    NvMM3GpFragEndBox(pHeader, &Offset, Moof);
+
+    // data offsets are relative to the moof
+    MoofSize = Offset - Moof;
+    for (i = 0; i < MAX_TRACK; i++)
+    {
+        if (DataOffsetPos[i])
+        {
+            LITTLE_TO_BIG_ENDIAN((pHeader + DataOffsetPos[i]),
+                (MoofSize + 8 + TrackDataOffset[i]));
+        }
+    }
+
+    NvMM3GpFragPut32(pHeader, &Offset, MdatPayload + 8);
+    COPY_FOUR_BYTES((pHeader + Offset), 'm', 'd', 'a', 't');
+    Offset += sizeof(NvU32);
+
+    pFragment->pData = pData - Offset;
+    pFragment->DataSize = Offset + MdatPayload;
+    NvOsMemcpy(pFragment->pData, pHeader, Offset);
+
+    for (i = 0; i < MAX_TRACK; i++)
+    {
+        pFrag->Track[i].SampleCount = 0;
+        pFrag->Track[i].DataSize = 0;
+    }
+    pFrag->PendingSize = 0;
+    pFrag->FragIndex = (pFrag->FragIndex + 1) % MAX_QUEUE_LEN;
+}
+
+/*
+ * Walks the 4 byte length prefixed NAL units at the start of an access
+ * unit, keeps the first SPS and PPS for the avcC box and returns how many
+ * bytes of parameter sets to leave out of the sample.
+ */
+static NvU32
+NvMM3GpFragStripParamSets(
+    Nv3gpFragMux *pFrag,
+    NvU8 *pData,
+    NvU32 DataSize)
+{
+    NvU32 Pos = 0;
+    NvU32 NalSize = 0;
+    NvU32 NalType = 0;
+
+    while (Pos + 5 <= DataSize)
+    {
+        NalSize = ((NvU32)pData[Pos] << 24) | ((NvU32)pData[Pos + 1] << 16) |
+            ((NvU32)pData[Pos + 2] << 8) | (NvU32)pData[Pos + 3];
+        if (!NalSize || NalSize > DataSize - Pos - 4)
+            break;
+        NalType = pData[Pos + 4] & 0x1F;
+        if (FRAG_NAL_TYPE_SPS == NalType)
+        {
+            if (!pFrag->MoovWritten && NalSize >= 4 &&
+                NalSize <= FRAG_MAX_PARAM_SET_SIZE)
+            {
+                NvOsMemcpy(pFrag->Sps, pData + Pos + 4, NalSize);
+                pFrag->SpsSize = NalSize;
+            }
+        }
+        else if (FRAG_NAL_TYPE_PPS == NalType)
+        {
+            if (!pFrag->MoovWritten && NalSize <= FRAG_MAX_PARAM_SET_SIZE)
+            {
+                NvOsMemcpy(pFrag->Pps, pData + Pos + 4, NalSize);
+                pFrag->PpsSize = NalSize;
+            }
+        }
+        else
+            break;
+        Pos += NalSize + 4;
+    }
+    return Pos;
+}
+
+NvError
+NvMM3GpMuxFragWriteInit(
+    NvMM3GpMuxInputParam *pInpParam,
+    NvU32 FragmentDuration,
+    NvU32 FragDataSize,
+    NvMM3GpMuxContext *pContext)
+{
+    NvError Status = NvSuccess;
+    Nv3gpFragMux *pFrag = NULL;
+    NvU32 i;
+
+    NVMM_CHK_ARG(pInpParam && pContext && FragmentDuration);
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_DEBUG, "++NvMM3GpMuxFragWriteInit \n"));
+
+    // the state of a previous split file is reused for its parameter sets
+    pFrag = (Nv3gpFragMux *)pContext->pIntMem;
+    if (pFrag && pFrag->FragDataCapacity < FragDataSize)
+    {
+        for (i = 0; i < MAX_QUEUE_LEN; i++)
+        {
+            NvOsFree(pFrag->pFragBuffer[i]);
+            pFrag->pFragBuffer[i] = NULL;
+        }
+    }
+    if (!pFrag)
+    {
+        pFrag = NvOsAlloc(sizeof(Nv3gpFragMux));
+        NVMM_CHK_MEM(pFrag);
+        NvOsMemset(pFrag, 0, sizeof(Nv3gpFragMux));
+        pContext->pIntMem = pFrag;
+        pContext->IntMemSize = sizeof(Nv3gpFragMux);
+
+        pFrag->pAudioStaging = NvOsAlloc(FRAG_AUDIO_STAGING_SIZE);
+        NVMM_CHK_MEM(pFrag->pAudioStaging);
+        pFrag->pHeader = NvOsAlloc(FRAG_HEADER_RESERVE);
+        NVMM_CHK_MEM(pFrag->pHeader);
+    }
+    for (i = 0; i < MAX_QUEUE_LEN; i++)
+    {
+        if (!pFrag->pFragBuffer[i])
+        {
+            pFrag->pFragBuffer[i] = NvOsAlloc(FRAG_HEADER_RESERVE + FragDataSize);
+            NVMM_CHK_MEM(pFrag->pFragBuffer[i]);
+        }
+    }
+    if (pFrag->FragDataCapacity < FragDataSize)
+        pFrag->FragDataCapacity = FragDataSize;
+
+    for (i = 0; i < MAX_TRACK; i++)
+    {
+        pFrag->Track[i].Present = NV_FALSE;
+        pFrag->Track[i].InMoov = NV_FALSE;
+        pFrag->Track[i].Started = NV_FALSE;
+        pFrag->Track[i].SampleCount = 0;
+        pFrag->Track[i].DataSize = 0;
+        pFrag->Track[i].LastDecodeTime = 0;
+        pFrag->Track[i].LastDelta = 0;
+    }
+    if (pInpParam->AudioVideoFlag & NvMM_AV_VIDEO_PRESENT)
+    {
+        pFrag->Track[VIDEO_TRACK].Present = NV_TRUE;
+        pFrag->Track[VIDEO_TRACK].TrackId = FRAG_TRACK_ID_VIDEO;
+        // until a second frame tells
+        pFrag->Track[VIDEO_TRACK].LastDelta = TIME_SCALE / 30;
+        if (pInpParam->VOPFrameRate)
+            pFrag->Track[VIDEO_TRACK].LastDelta = TIME_SCALE / pInpParam->VOPFrameRate;
+    }
+    if (pInpParam->AudioVideoFlag & NvMM_AV_AUDIO_PRESENT)
+    {
+        pFrag->Track[SOUND_TRACK].Present = NV_TRUE;
+        pFrag->Track[SOUND_TRACK].TrackId = FRAG_TRACK_ID_AUDIO;
+        // 1024 samples per frame
+        pFrag->Track[SOUND_TRACK].LastDelta = TIME_SCALE * 1024 / 44100;
+        if (pInpParam->AacSamplingFreqIndex < NV_ARRAY_SIZE(s_AacSamplingRates))
+            pFrag->Track[SOUND_TRACK].LastDelta = TIME_SCALE * 1024 /
+                s_AacSamplingRates[pInpParam->AacSamplingFreqIndex];
+    }
+    pFrag->FragIndex = 0;
+    pFrag->MoovWritten = NV_FALSE;
+    pFrag->SequenceNumber = 0;
+    pFrag->FragmentDuration = (NvU64)FragmentDuration * 10000;
+    pFrag->FragmentStartTS = 0;
+    pFrag->TimeBaseSet = NV_FALSE;
+    pFrag->TimeBase = 0;
+    pFrag->PendingSize = 0;
+
+cleanup:
+    if (Status != NvSuccess)
+        NvMM3GpMuxFragWriterDeallocate(pContext);
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_DEBUG, "--NvMM3GpMuxFragWriteInit \n"));
+    return Status;
+}
+
+NvError
+NvMM3GpMuxFragWriteRun(
+    NvMM3GpAVParam *pSVParam,
+    NvMM3GpMuxInputParam *pInpParam,
+    NvMM3GpMuxFragment *pFragment,
+    NvMM3GpMuxContext Context)
+{
+    NvError Status = NvSuccess;
+    Nv3gpFragMux *pFrag = NULL;
+    NvMM3GpMuxFragTrack *pTrack = NULL;
+    NvMM3GpMuxFragSample *pSample = NULL;
+    NvU32 TrackIndex = 0;
+    NvU8 *pData = NULL;
+    NvU32 DataSize = 0;
+    NvU64 TS = 0;
+    NvU64 DecodeTime = 0;
+    NvBool IsSync = NV_TRUE;
+    NvBool FragmentStart = NV_FALSE;
+    NvBool Pending = NV_FALSE;
+    NvU32 Skip = 0;
+    NvU32 i;
+
+    NVMM_CHK_ARG(pSVParam && pInpParam && pFragment);
+    pFrag = (Nv3gpFragMux *)Context.pIntMem;
+    NVMM_CHK_ARG(pFrag);
+    pFragment->pData = NULL;
+    pFragment->DataSize = 0;
+
+    if (pInpParam->ZeroVideoDataFlag)
+    {
+        TrackIndex = VIDEO_TRACK;
+        pData = pSVParam->pVideo;
+        DataSize = pSVParam->VideoDataSize;
+        TS = pSVParam->VideoTS;
+        IsSync = pInpParam->IsSyncFrame;
+        Skip = NvMM3GpFragStripParamSets(pFrag, pData, DataSize);
+        pData += Skip;
+        DataSize -= Skip;
+    }
+    else
+    {
+        TrackIndex = SOUND_TRACK;
+        pData = pSVParam->pSpeech;
+        DataSize = pSVParam->SpeechDataSize;
+        TS = pSVParam->AudioTS;
+    }
+    pTrack = &pFrag->Track[TrackIndex];
+    NVMM_CHK_ARG(pTrack->Present);
+    // parameter sets alone, or a track the moov could not announce
+    if (!DataSize || (pFrag->MoovWritten && !pTrack->InMoov))
+        goto cleanup;
+    NVMM_CHK_ARG(DataSize <= pFrag->FragDataCapacity);
+
+    if (!pFrag->TimeBaseSet)
+    {
+        pFrag->TimeBase = TS;
+        pFrag->TimeBaseSet = NV_TRUE;
+    }
+    DecodeTime = FRAG_TS_TO_TIME_SCALE((TS > pFrag->TimeBase) ? (TS - pFrag->TimeBase) : 0);
+    // decode times never go back
+    if (pTrack->Started && DecodeTime <= pTrack->LastDecodeTime)
+        DecodeTime = pTrack->LastDecodeTime + 1;
+
+    for (i = 0; i < MAX_TRACK; i++)
+        Pending = Pending || pFrag->Track[i].SampleCount;
+
+    if (Pending)
+    {
+        // a fragment starts on the sync frames of the video track, or of
+        // the audio track without video
+        if (IsSync && (VIDEO_TRACK == TrackIndex || !pFrag->Track[VIDEO_TRACK].Present) &&
+            TS >= pFrag->FragmentStartTS + pFrag->FragmentDuration)
+            FragmentStart = NV_TRUE;
+        // or earlier when this sample doesn't fit
+        if (pTrack->SampleCount == FRAG_MAX_SAMPLES ||
+            pFrag->Track[VIDEO_TRACK].DataSize + pFrag->Track[SOUND_TRACK].DataSize +
+            DataSize > pFrag->FragDataCapacity ||
+            (SOUND_TRACK == TrackIndex &&
+            pTrack->DataSize + DataSize > FRAG_AUDIO_STAGING_SIZE))
+            FragmentStart = NV_TRUE;
+    }
+    NVMM_CHK_ARG(SOUND_TRACK != TrackIndex || DataSize <= FRAG_AUDIO_STAGING_SIZE);
+
+    if (FragmentStart)
+    {
+        NvMM3GpFragComplete(pFrag, pInpParam, TrackIndex, DecodeTime, pFragment);
+        // without a sample for it, the moov left the video track out
+        if (!pTrack->InMoov)
+            goto cleanup;
+    }
+    if (!Pending || FragmentStart)
+    {
+        pFrag->FragmentStartTS = TS;
+        pFrag->PendingSize = FRAG_MOOF_BASE_SIZE;
+    }
+
+    if (VIDEO_TRACK == TrackIndex)
+    {
+        NvOsMemcpy(pFrag->pFragBuffer[pFrag->FragIndex] + FRAG_HEADER_RESERVE +
+            pTrack->DataSize, pData, DataSize);
+    }
+    else
+    {
+        NvOsMemcpy(pFrag->pAudioStaging + pTrack->DataSize, pData, DataSize);
+    }
+
+    pSample = &pTrack->Samples[pTrack->SampleCount++];
+    pSample->Size = DataSize;
+    pSample->Flags = IsSync ? FRAG_SAMPLE_FLAGS_SYNC : FRAG_SAMPLE_FLAGS_NON_SYNC;
+    pSample->DecodeTime = DecodeTime;
+    pTrack->DataSize += DataSize;
+    pTrack->LastDecodeTime = DecodeTime;
+    pTrack->Started = NV_TRUE;
+    pFrag->PendingSize += DataSize + FRAG_TRUN_ENTRY_SIZE;
+
+    if (pInpParam->MaxTrakDurationLimit > 0 &&
+        DecodeTime / (TIME_SCALE / 1000) >= pInpParam->MaxTrakDurationLimit)
+    {
+        if (VIDEO_TRACK == TrackIndex)
+            pInpParam->bVideoDurationLimit = NV_TRUE;
+        else
+            pInpParam->bAudioDurationLimit = NV_TRUE;
+    }
+
+cleanup:
+    return Status;
+}
+
+NvError
+NvMM3GpMuxFragWriteClose(
+    NvMM3GpMuxInputParam *pInpParam,
+    NvMM3GpMuxFragment *pFragment,
+    NvMM3GpMuxContext Context)
+{
+    NvError Status = NvSuccess;
+    Nv3gpFragMux *pFrag = NULL;
+
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_DEBUG, "++NvMM3GpMuxFragWriteClose \n"));
+    NVMM_CHK_ARG(pInpParam && pFragment);
+    pFrag = (Nv3gpFragMux *)Context.pIntMem;
+    NVMM_CHK_ARG(pFrag);
+    pFragment->pData = NULL;
+    pFragment->DataSize = 0;
+
+    // the last fragment; there is nothing else to finalize
+    if (pFrag->Track[VIDEO_TRACK].SampleCount || pFrag->Track[SOUND_TRACK].SampleCount)
+        NvMM3GpFragComplete(pFrag, pInpParam, MAX_TRACK, 0, pFragment);
+
+cleanup:
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_DEBUG, "--NvMM3GpMuxFragWriteClose \n"));
+    return Status;
+}
+
+void
+NvMM3GpMuxFragWriterDeallocate(
+    NvMM3GpMuxContext *pContext)
+{
+    Nv3gpFragMux *pFrag = NULL;
+    NvU32 i;
+
+    if (!pContext || !pContext->pIntMem)
+        return;
+    pFrag = (Nv3gpFragMux *)pContext->pIntMem;
+    for (i = 0; i < MAX_QUEUE_LEN; i++)
+        NvOsFree(pFrag->pFragBuffer[i]);
+    NvOsFree(pFrag->pAudioStaging);
+    NvOsFree(pFrag->pHeader);
+    NvOsFree(pFrag);
+    pContext->pIntMem = NULL;
+    pContext->IntMemSize = 0;
+}
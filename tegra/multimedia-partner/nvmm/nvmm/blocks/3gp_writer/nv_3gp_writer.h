@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2008-2010 NVIDIA Corporation.  All rights reserved.
+ * Copyright (c) 2008-2013 NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -989,6 +989,70 @@ typedef struct Nv3gpMux
     NvU16 MaxVideoBitRate;
  }  Nv3gpWriter;
 
+// Fragmented MP4 (moov + mvex up front, then self contained moof + mdat pairs)
+// Samples per track in one fragment; a full table closes the fragment
+#define FRAG_MAX_SAMPLES 1024
+// Largest SPS or PPS kept for the avcC box
+#define FRAG_MAX_PARAM_SET_SIZE 256
+// Room in front of each fragment for ftyp + moov (first fragment) and moof
+#define FRAG_HEADER_RESERVE (32 * 1024)
+// Audio of one fragment is staged here and placed after the video data
+#define FRAG_AUDIO_STAGING_SIZE (256 * 1024)
+
+typedef struct NvMM3GpMuxFragSampleRec
+{
+    NvU32 Size;
+    NvU32 Flags;
+    // in TIME_SCALE units from the start of the file
+    NvU64 DecodeTime;
+} NvMM3GpMuxFragSample;
+
+typedef struct NvMM3GpMuxFragTrackRec
+{
+    NvBool Present;
+    // announced in the moov; samples of other tracks are dropped
+    NvBool InMoov;
+    NvBool Started;
+    NvU32 TrackId;
+    NvU32 SampleCount;
+    NvU32 DataSize;
+    NvU64 LastDecodeTime;
+    NvU32 LastDelta;
+    NvMM3GpMuxFragSample Samples[FRAG_MAX_SAMPLES];
+} NvMM3GpMuxFragTrack;
+
+// A completed fragment, valid until the next but one fragment completes
+typedef struct NvMM3GpMuxFragmentRec
+{
+    NvU8 *pData;
+    NvU32 DataSize;
+} NvMM3GpMuxFragment;
+
+typedef struct Nv3gpFragMuxRec
+{
+    NvMM3GpMuxFragTrack Track[MAX_TRACK];
+    // two fragment buffers: one being filled, one being written out
+    NvU8 *pFragBuffer[MAX_QUEUE_LEN];
+    NvU32 FragIndex;
+    NvU32 FragDataCapacity;
+    NvU8 *pAudioStaging;
+    NvU8 *pHeader;
+    NvBool MoovWritten;
+    NvU32 SequenceNumber;
+    // in 100 ns units
+    NvU64 FragmentDuration;
+    NvU64 FragmentStartTS;
+    NvBool TimeBaseSet;
+    NvU64 TimeBase;
+    // H.264 parameter sets, kept across split files
+    NvU8 Sps[FRAG_MAX_PARAM_SET_SIZE];
+    NvU32 SpsSize;
+    NvU8 Pps[FRAG_MAX_PARAM_SET_SIZE];
+    NvU32 PpsSize;
+    // bytes of the fragment being filled, headers included
+    NvU32 PendingSize;
+} Nv3gpFragMux;
+
     // Function Prototypes
     // Video prototypes
 
@@ -1055,6 +1119,31 @@ WriterDeallocVideo(
     Nv3gpWriter *p3gpmux,
     NvMM3GpMuxInputParam *pInpParam);
 
+// Fragmented MP4 prototypes
+NvError
+NvMM3GpMuxFragWriteInit(
+    NvMM3GpMuxInputParam *pInpParam,
+    NvU32 FragmentDuration,
+    NvU32 FragDataSize,
+    NvMM3GpMuxContext *pContext);
+
+NvError
+NvMM3GpMuxFragWriteRun(
+    NvMM3GpAVParam *pSVParam,
+    NvMM3GpMuxInputParam *pInpParam,
+    NvMM3GpMuxFragment *pFragment,
+    NvMM3GpMuxContext Context);
+
+NvError
+NvMM3GpMuxFragWriteClose(
+    NvMM3GpMuxInputParam *pInpParam,
+    NvMM3GpMuxFragment *pFragment,
+    NvMM3GpMuxContext Context);
+
+void
+NvMM3GpMuxFragWriterDeallocate(
+    NvMM3GpMuxContext *pContext);
+
 // Audio prototypes
 NvError
 AudioInit(
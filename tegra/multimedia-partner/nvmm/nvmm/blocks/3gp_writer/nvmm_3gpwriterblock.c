@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2008-2012 NVIDIA CORPORATION.  All rights reserved.
+ * Copyright (c) 2008-2013 NVIDIA CORPORATION.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -96,6 +96,12 @@ typedef struct NvMM3gpWriterBlockContextRec
     NvBool FileSizeExceeded;
     NvBool TimeLimitExceeded;
     NvBool MDATWriteInProgress;
+    // Fragmented MP4 output, fragment duration in msec; 0 writes a regular file
+    NvU32 FragmentDuration;
+    NvBool FragmentMode;
+    NvMM3GpMuxContext ContextFragMux;
+    // fragments queued to or being written by the MDAT thread
+    NvU32 FragmentsInFlight;
 } NvMM3gpWriterBlockContext;
 
 static void
@@ -134,7 +140,15 @@ NvmmMDATFileWriteThread(
                 p3gpWriterContext->MDATWriteInProgress = NV_TRUE;
                 p3gpWriterContext->InputParam.CpStaus = (NvError)pPipeType->Write(p3gpWriterContext->CpHandle,(CPbyte *)(pMessage.pData),pMessage.DataSize);
                 p3gpWriterContext->MDATWriteInProgress = NV_FALSE;
-                if (p3gpWriterContext->InputParam.CpStaus != NvSuccess)
+                if (p3gpWriterContext->InputParam.CpStaus != NvSuccess &&
+                    p3gpWriterContext->FragmentMode)
+                {
+                    // No reserved space to give back; the fragments written
+                    // so far stay playable
+                    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_ERROR, "--NvmmMDATFileWriteThread::Fragment write failed\n"));
+                    p3gpWriterContext->InputParam.OverflowFlag = NV_TRUE;
+                }
+                else if (p3gpWriterContext->InputParam.CpStaus != NvSuccess)
                 {
                      NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_ERROR, "--NvmmMDATFileWriteThread::Write failed bail ou\n"));
                     // Write failed
@@ -159,8 +173,9 @@ NvmmMDATFileWriteThread(
                         NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_INFO, "--NvmmMDATFileWriteThread::Deleting reserved partition failed\n"));
                 }
                 CurrentWritePosition += pMessage.DataSize;
-                //If holding all the buffers signal
-                if(NV_TRUE == p3gpWriterContext->NoEmptyPingPongBuffer)
+                //If holding all the buffers signal; fragments are counted
+                if(NV_TRUE == p3gpWriterContext->NoEmptyPingPongBuffer ||
+                    p3gpWriterContext->FragmentMode)
                     NvOsSemaphoreSignal(p3gpWriterContext->PingPongBufferConsumedSema);
              }
          }
@@ -386,6 +401,27 @@ NvMM3gpWriterInit(
     for(i = 0; i< pContext->StreamIndex ;i++)
         pContext->WriterBufferCache.SizeOfThePingPongBuffer += (pContext->StreamInfo[i].MaxBufferSize * 2);
 
+    pContext->FragmentMode = (pContext->FragmentDuration != 0);
+    if (pContext->FragmentMode)
+    {
+        // Fragments are written for H.264 and AAC only; they take the place
+        // of the ping pong buffers and use the same memory budget
+        if (((pContext->InputParam.AudioVideoFlag & NvMM_AV_VIDEO_PRESENT) &&
+            pContext->InputParam.Mp4H263Flag != 2) ||
+            ((pContext->InputParam.AudioVideoFlag & NvMM_AV_AUDIO_PRESENT) &&
+            pContext->InputParam.SpeechAudioFlag != 2))
+        {
+            NVMM_CHK_ERR(NvError_WriterUnsupportedStream);
+        }
+        NVMM_CHK_ERR(NvMM3GpMuxFragWriteInit(
+            &pContext->InputParam,
+            pContext->FragmentDuration,
+            pContext->WriterBufferCache.SizeOfThePingPongBuffer,
+            &pContext->ContextFragMux));
+        pContext->FragmentsInFlight = 0;
+        goto cleanup;
+    }
+
     //Check if the  size is 2k aligned
     TempBufferSize = pContext->WriterBufferCache.SizeOfThePingPongBuffer % OPTIMAL_BUFFER_ALIGN;
     if(TempBufferSize != 0)
@@ -424,6 +460,36 @@ cleanup:
     return Status ;
 }
 
+static NvError
+NvMM3gpWriterQueueFragment(
+    NvMM3gpWriterBlockContext* pContext,
+    NvMM3GpMuxFragment *pFragment)
+{
+    NvError Status = NvSuccess;
+    NvMMFileWriteMsg Message;
+
+    NVMM_CHK_ARG(pContext && pFragment);
+
+    NvOsMemset(&Message, 0, sizeof(NvMMFileWriteMsg));
+    Message.pData = pFragment->pData;
+    Message.DataSize = pFragment->DataSize;
+    Message.ThreadShutDown = NV_FALSE;
+    NVMM_CHK_ERR(NvMMQueueEnQ(pContext->PingPongMsgQ, &Message, 0));
+    pContext->FragmentsInFlight++;
+    NvOsSemaphoreSignal(pContext->PingPongBufferFilledSema);
+
+    // The muxer alternates between two fragment buffers; wait until the one
+    // it fills next has been written out
+    if (MAX_QUEUE_LEN == pContext->FragmentsInFlight)
+    {
+        NvOsSemaphoreWait(pContext->PingPongBufferConsumedSema);
+        pContext->FragmentsInFlight--;
+    }
+
+    cleanup:
+    return Status;
+}
+
 static NvError
 NvMM3gpCloseTrack
     (NvmmWriterContext WriterContext)
@@ -437,6 +503,37 @@ NvMM3gpCloseTrack
     pContext = (NvMM3gpWriterBlockContext *)WriterContext;
     pPipeType = &pContext->pPipe->cpipe;
 
+    if (pContext->FragmentMode)
+    {
+        if (pContext->Init3gp)
+        {
+            NvMM3GpMuxFragment Fragment;
+
+            pContext->Init3gp = NV_FALSE;
+            if (!pContext->InputParam.OverflowFlag &&
+                NvSuccess == NvMM3GpMuxFragWriteClose(
+                    &pContext->InputParam,
+                    &Fragment,
+                    pContext->ContextFragMux) &&
+                Fragment.DataSize)
+            {
+                (void)NvMM3gpWriterQueueFragment(pContext, &Fragment);
+            }
+            // Wait for the queued fragments before closing the file
+            while (pContext->FragmentsInFlight)
+            {
+                NvOsSemaphoreWait(pContext->PingPongBufferConsumedSema);
+                pContext->FragmentsInFlight--;
+            }
+            if(pContext->CpHandle)
+            {
+                 (void)pContext->pPipe->cpipe.Close(pContext->CpHandle);
+                 pContext->CpHandle = 0;
+            }
+        }
+        goto cleanup;
+    }
+
     // Delete the temporary file to create room for writing pending mdat info
     (void)NvMM3GpMuxRecDelReservedFile(pContext->Context3GpMux);
 
@@ -652,7 +749,9 @@ NvMM3gpWriterAddMediaSample(
     NVMM_CHK_ARG(!pContext->InputParam.OverflowFlag);
     NVMM_CHK_ARG(!pContext->EndOfMux);
 
-    if(NV_FALSE == pContext->VideoInit &&
+    if(pContext->FragmentMode)
+        pOutputBuffer = pData;
+    else if(NV_FALSE == pContext->VideoInit &&
         NVMM_ISSTREAMVIDEO(pContext->StreamInfo[streamIndex].StreamConfig.StreamType))
     {
         NvU32 AllocSize;
@@ -733,6 +832,35 @@ NvMM3gpWriterAddMediaSample(
         break;
     }
 
+    if (pContext->FragmentMode)
+    {
+        NvMM3GpMuxFragment Fragment;
+        Nv3gpFragMux *pFragMux = (Nv3gpFragMux *)pContext->ContextFragMux.pIntMem;
+
+        NVMM_CHK_MEM(pFragMux);
+        if((pContext->CurrentMDATFileSize + pFragMux->PendingSize + UlSize) >=
+            pContext->MaxMDATFileSizeLimit)
+        {
+            pContext->FileSizeExceeded = NV_TRUE;
+            pContext->EndOfMux = NV_TRUE;
+            goto cleanup;
+        }
+
+        Fragment.pData = NULL;
+        Fragment.DataSize = 0;
+        NVMM_CHK_ERR(NvMM3GpMuxFragWriteRun(
+            &pContext->SVParam,
+            &pContext->InputParam,
+            &Fragment,
+            pContext->ContextFragMux));
+        if (Fragment.DataSize)
+        {
+            pContext->CurrentMDATFileSize += Fragment.DataSize;
+            NVMM_CHK_ERR(NvMM3gpWriterQueueFragment(pContext, &Fragment));
+        }
+        goto cleanup;
+    }
+
     NVMM_CHK_ERR(NvMM3GpMuxRecWriteRun(
         &pContext->SplitMode,
         &pContext->SVParam,
@@ -809,6 +937,8 @@ NvMM3gpCloseWriter
     if(pContext->SplitMode.ReInitBuffer)
         NvOsFree(pContext->SplitMode.ReInitBuffer);
 
+    NvMM3GpMuxFragWriterDeallocate(&pContext->ContextFragMux);
+
     if(pContext->p3gpBufferAlloc)
         NvOsFree(pContext->p3gpBufferAlloc);
 
@@ -990,6 +1120,12 @@ NvMM3gpSetAttribute(
             p3gpWriterContext->SplitMode.SplitFlag = NV_TRUE;
         }
         break;
+        case NvMMWriterAttribute_FragmentDuration:
+        {
+            p3gpWriterContext->FragmentDuration =
+                ((NvMMWriterAttrib_FragmentDuration *)pAttribute)->fragmentDuration;
+        }
+        break;
         case NvMMWriterAttribute_TrakDurationLimit:
         {
             p3gpWriterContext->InputParam.MaxTrakDurationLimit =
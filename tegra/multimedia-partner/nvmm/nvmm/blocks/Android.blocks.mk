@@ -11,4 +11,10 @@ BLOCKDIRS += 3gp_writer
 3GPWRITER_BUILT := 1
 endif
 endif
+ifeq ($(MTSWRITER_ENABLED),1)
+ifeq ($(MTSWRITER_LOCALE),$(LOCALE_CPU))
+BLOCKDIRS += mts_writer
+MTSWRITER_BUILT := 1
+endif
+endif
 
@@ -15,6 +15,9 @@ BLOCKLIBS += libnvbasewriter
 ifeq ($(3GPWRITER_BUILT),1)
 BLOCKLIBS += libnv3gpwriter
 endif
+ifeq ($(MTSWRITER_BUILT),1)
+BLOCKLIBS += libnvmtswriter
+endif
 
 LOCAL_WHOLE_STATIC_LIBRARIES += $(sort $(BLOCKLIBS))
 
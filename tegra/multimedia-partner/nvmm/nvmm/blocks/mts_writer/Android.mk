@@ -0,0 +1,30 @@
+LOCAL_PATH := $(call my-dir)
+include $(NVIDIA_DEFAULTS)
+
+LOCAL_MODULE := libnvmtswriter
+
+LOCAL_CFLAGS += -D__OMX_EXPORTS
+LOCAL_CFLAGS += -DOMXVERSION=2
+LOCAL_C_INCLUDES += $(TEGRA_TOP)/multimedia-partner/nvmm/nvmm/include
+
+ifeq ($(NV_LOGGER_ENABLED),1)
+LOCAL_CFLAGS += -DNV_LOGGER_ENABLED=1
+endif
+LOCAL_SRC_FILES += nvmm_mtswriterblock.c
+LOCAL_SRC_FILES += nv_mts_writer.c
+
+include $(NVIDIA_STATIC_LIBRARY)
+
+include $(NVIDIA_DEFAULTS)
+
+LOCAL_MODULE := nv_mts_writer_check
+LOCAL_MODULE_TAGS := nvidia_tests
+
+LOCAL_C_INCLUDES += $(TEGRA_TOP)/multimedia-partner/nvmm/nvmm/include
+
+LOCAL_SRC_FILES += nv_mts_writer.c
+LOCAL_SRC_FILES += nv_mts_writer_check.c
+
+LOCAL_SHARED_LIBRARIES += libnvos
+
+include $(NVIDIA_EXECUTABLE)
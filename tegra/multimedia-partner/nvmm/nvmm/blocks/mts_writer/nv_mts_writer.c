@@ -1,5 +1,5 @@
 /*
-* Copyright (c) 2007 NVIDIA Corporation. All rights reserved.
+* Copyright (c) 2007-2013 NVIDIA Corporation. All rights reserved.
 *
 * NVIDIA Corporation and its licensors retain all intellectual property
 * and proprietary rights in and to this software and related documentation
@@ -12,18 +12,691 @@
 #include "nvos.h"
 #include "nvassert.h"
 
-NvS16 NvMM_MTSWriteInit(structInpParam *pstructInpParam, NvU8 *pBufferOut, NvS32 *Offset, void *StructMem)
+// PTS/DTS run this far (90 kHz) ahead of the PCR: the decoder buffering delay
+#define MTS_PTS_OFFSET 63000
+// PCR at least every 40 ms, PAT and PMT every 100 ms
+#define MTS_PCR_INTERVAL 3600
+#define MTS_PSI_INTERVAL 9000
+
+// packets to write before the PES of the current sample
+#define MTS_PENDING_PAT 0x1
+#define MTS_PENDING_PMT 0x2
+#define MTS_PENDING_PCR 0x4
+
+// PES header with PTS and DTS, access unit delimiter, SPS, PPS and ADTS header
+#define MTS_MAX_HEAD_SIZE (MTS_PES_HEADER_SIZE + 2 * MTS_PES_TIMESTAMP_SIZE + \
+    MTS_AUD_SIZE + 2 * (MTS_START_CODE_SIZE + MTS_MAX_PARAM_SET_SIZE) + \
+    MTS_ADTS_HEADER_SIZE)
+
+typedef struct NvMtsNalInfoRec
 {
-    return SUCCESS;
+    NvBool HasAud;
+    NvBool HasSps;
+    NvBool HasPps;
+    NvBool HasSlice;
+    NvBool HasIdr;
+} NvMtsNalInfo;
+
+typedef struct NvMtsWriterRec
+{
+    // PSI packets with a zero continuity counter
+    NvU8 PatPacket[MTS_PACKET_SIZE];
+    NvU8 PmtPacket[MTS_PACKET_SIZE];
+    NvU8 PatCc;
+    NvU8 PmtCc;
+    NvU8 Cc[MAX_TRACK];
+    NvU16 Pid[MAX_TRACK];       // 0 for an absent track
+    NvU32 PcrTrack;
+    NvU32 SegmentTrack;
+
+    // Latest SPS and PPS with start codes, repeated on IDR frames without them
+    NvU8 Sps[MTS_START_CODE_SIZE + MTS_MAX_PARAM_SET_SIZE];
+    NvU32 SpsSize;
+    NvU8 Pps[MTS_START_CODE_SIZE + MTS_MAX_PARAM_SET_SIZE];
+    NvU32 PpsSize;
+    NvBool AnnexB;              // video samples have start codes
+
+    // System clock in 90 kHz units, not wrapped to 33 bits
+    NvU64 Pcr;
+    NvU64 LastPcr;
+    NvU64 LastPsi;
+    NvBool ClockStarted;
+    NvBool PcrForced;
+
+    NvU64 SegmentStart;         // 100 ns units
+    NvU32 SegmentCount;
+    NvBool BoundaryReported;
+
+    // Sample being written. The PES is the Head bytes followed by the sample
+    // data, with NAL lengths replaced by start codes in place.
+    NvBool SampleActive;
+    NvU32 Pending;
+    NvU32 Track;
+    NvBool RandomAccess;
+    NvBool SamplePcr;
+    NvU8 Head[MTS_MAX_HEAD_SIZE];
+    NvU32 HeadSize;
+    NvU32 PesSize;
+    NvU32 PesPos;
+    NvBool LengthPrefixed;
+    NvU32 DataPos;
+    NvU32 CodeEnd;              // end of the length field being rewritten
+    NvU32 NalEnd;               // offset of the next length field
+} NvMtsWriter;
+
+// CRC_32 of ISO/IEC 13818-1 annex B, computed once per table at init
+static NvU32 NvMtsCrc32(const NvU8 *pData, NvU32 Size)
+{
+    NvU32 Crc = 0xFFFFFFFF;
+    NvU32 i;
+
+    while (Size--)
+    {
+        Crc ^= (NvU32)*pData++ << 24;
+        for (i = 0; i < 8; i++)
+            Crc = (Crc & 0x80000000) ? (Crc << 1) ^ 0x04C11DB7 : Crc << 1;
+    }
+    return Crc;
+}
+
+static void NvMtsBuildPsiPacket(NvU8 *pPacket, NvU16 Pid, const NvU8 *pSection, NvU32 SectionSize)
+{
+    NvU32 Crc;
+    NvU8 *p;
+
+    NvOsMemset(pPacket, 0xFF, MTS_PACKET_SIZE);
+    pPacket[0] = MTS_SYNC_BYTE;
+    pPacket[1] = (NvU8)(MTS_PUSI_FLAG | (Pid >> 8));
+    pPacket[2] = (NvU8)Pid;
+    pPacket[3] = MTS_AFC_PAYLOAD_ONLY;
+    pPacket[4] = 0; // pointer_field
+
+    p = pPacket + 5;
+    NvOsMemcpy(p, pSection, SectionSize);
+    Crc = NvMtsCrc32(p, SectionSize);
+    p += SectionSize;
+    p[0] = (NvU8)(Crc >> 24);
+    p[1] = (NvU8)(Crc >> 16);
+    p[2] = (NvU8)(Crc >> 8);
+    p[3] = (NvU8)Crc;
+}
+
+static NvU8 *NvMtsPutTimestamp(NvU8 *p, NvU8 Prefix, NvU64 Ts)
+{
+    Ts &= MTS_TIMESTAMP_MASK;
+    p[0] = (NvU8)((Prefix << 4) | ((Ts >> 29) & 0x0E) | 1);
+    p[1] = (NvU8)(Ts >> 22);
+    p[2] = (NvU8)(((Ts >> 14) & 0xFE) | 1);
+    p[3] = (NvU8)(Ts >> 7);
+    p[4] = (NvU8)(((Ts << 1) & 0xFE) | 1);
+    return p + MTS_PES_TIMESTAMP_SIZE;
+}
+
+// program_clock_reference_base in 90 kHz units, extension 0
+static void NvMtsPutPcr(NvU8 *p, NvU64 Pcr)
+{
+    Pcr &= MTS_TIMESTAMP_MASK;
+    p[0] = (NvU8)(Pcr >> 25);
+    p[1] = (NvU8)(Pcr >> 17);
+    p[2] = (NvU8)(Pcr >> 9);
+    p[3] = (NvU8)(Pcr >> 1);
+    p[4] = (NvU8)(((Pcr & 1) << 7) | 0x7E);
+    p[5] = 0;
+}
+
+static NvU32 NvMtsGetBE32(const NvU8 *p)
+{
+    return ((NvU32)p[0] << 24) | ((NvU32)p[1] << 16) | ((NvU32)p[2] << 8) | p[3];
+}
+
+/*
+ * NvMM encoders write 4 byte NAL lengths, other sources start codes. A NAL
+ * length of 1 or of 256 to 511 bytes reads as a start code, and start codes
+ * can read as lengths that add up to the sample; such a sample keeps the
+ * format of the last one that was clear, lengths to begin with.
+ */
+static NvBool NvMtsIsAnnexB(NvMtsWriter *pMts, const NvU8 *p, NvU32 Size)
+{
+    NvBool StartCode = (Size >= 3 && !p[0] && !p[1] && p[2] == 1) ||
+                       (Size >= 4 && !p[0] && !p[1] && !p[2] && p[3] == 1);
+    NvU32 Pos = 0;
+    NvU32 Length;
+
+    while (StartCode && Size - Pos >= MTS_START_CODE_SIZE)
+    {
+        Length = NvMtsGetBE32(p + Pos);
+        if (Length > Size - Pos - MTS_START_CODE_SIZE)
+            break;
+        Pos += MTS_START_CODE_SIZE + Length;
+    }
+    if (!StartCode || Pos != Size)
+        pMts->AnnexB = StartCode;
+    return pMts->AnnexB;
+}
+
+// Offset just past the next 00 00 01 at or after Pos, Size if there is none
+static NvU32 NvMtsFindStartCode(const NvU8 *p, NvU32 Pos, NvU32 Size)
+{
+    while (Pos + 3 <= Size)
+    {
+        if (p[Pos + 2] > 1)
+            Pos += 3;
+        else if (!p[Pos] && !p[Pos + 1] && p[Pos + 2] == 1)
+            return Pos + 3;
+        else
+            Pos++;
+    }
+    return Size;
+}
+
+static void NvMtsCacheParamSet(NvU8 *pDst, NvU32 *pDstSize, const NvU8 *pNal, NvU32 NalSize)
+{
+    if (!NalSize || NalSize > MTS_MAX_PARAM_SET_SIZE)
+    {
+        *pDstSize = 0;
+        return;
+    }
+    pDst[0] = 0;
+    pDst[1] = 0;
+    pDst[2] = 0;
+    pDst[3] = 1;
+    NvOsMemcpy(pDst + MTS_START_CODE_SIZE, pNal, NalSize);
+    *pDstSize = MTS_START_CODE_SIZE + NalSize;
+}
+
+/*
+ * Walks the NAL units in front of the first slice of an access unit, noting
+ * which are present and keeping copies of the parameter sets. Slices are
+ * not scanned, so the cost does not depend on the frame size.
+ */
+static void NvMtsScanAccessUnit(NvMtsWriter *pMts, const NvU8 *pData, NvU32 Size,
+                                NvBool LengthPrefixed, NvMtsNalInfo *pInfo)
+{
+    NvU32 Pos = 0;
+    NvU32 Nal, NalSize, Next, Type;
+    NvBool First = NV_TRUE;
+
+    NvOsMemset(pInfo, 0, sizeof(NvMtsNalInfo));
+
+    while (Pos < Size)
+    {
+        if (LengthPrefixed)
+        {
+            if (Size - Pos <= MTS_START_CODE_SIZE)
+                break;
+            Nal = Pos + MTS_START_CODE_SIZE;
+            NalSize = NV_MIN(NvMtsGetBE32(pData + Pos), Size - Nal);
+            Next = Nal + NalSize;
+            if (!NalSize)
+            {
+                Pos = Next;
+                continue;
+            }
+        }
+        else
+        {
+            Nal = NvMtsFindStartCode(pData, Pos, Size);
+            if (Nal >= Size)
+                break;
+            NalSize = 0;
+            Next = Size;
+        }
+
+        Type = pData[Nal] & MTS_NAL_TYPE_MASK;
+        if (Type >= MTS_NAL_SLICE && Type <= MTS_NAL_IDR)
+        {
+            pInfo->HasSlice = NV_TRUE;
+            pInfo->HasIdr = (Type == MTS_NAL_IDR);
+            break;
+        }
+
+        if (!LengthPrefixed)
+        {
+            Next = NvMtsFindStartCode(pData, Nal, Size);
+            if (Next < Size)
+                Next -= 3;
+            NalSize = Next - Nal;
+            // a four byte start code leaves its first zero behind
+            while (NalSize && !pData[Nal + NalSize - 1])
+                NalSize--;
+        }
+
+        if (Type == MTS_NAL_AUD && First)
+            pInfo->HasAud = NV_TRUE;
+        else if (Type == MTS_NAL_SPS)
+        {
+            pInfo->HasSps = NV_TRUE;
+            NvMtsCacheParamSet(pMts->Sps, &pMts->SpsSize, pData + Nal, NalSize);
+        }
+        else if (Type == MTS_NAL_PPS)
+        {
+            pInfo->HasPps = NV_TRUE;
+            NvMtsCacheParamSet(pMts->Pps, &pMts->PpsSize, pData + Nal, NalSize);
+        }
+        First = NV_FALSE;
+        Pos = Next;
+    }
 }
 
-NvS16 NvMM_MTSWriteRun(structSVParam *pstructSVParam, structInpParam *pstructInpParam, NvU8 *pBufferOut, NvS32 *Offset, tmem ptrstructMem)
+/*
+ * Builds the PES header and the prefixes of a sample and works out which
+ * PSI and PCR packets go in front of it. Returns NV_FALSE when nothing is
+ * to be written, as for a sample that only carries parameter sets; those
+ * are kept for the IDR frames.
+ */
+static NvBool NvMtsStartSample(NvMtsWriter *pMts, NvMMMtsAVParam *pAVParam,
+                               NvMMMtsMuxInputParam *pInputParam)
 {
+    NvMtsNalInfo Info;
+    NvU64 Pts = MTS_100NS_TO_90KHZ(pAVParam->PTS);
+    NvU64 Dts = MTS_100NS_TO_90KHZ(pAVParam->DTS);
+    NvBool WriteDts = (Dts != Pts);
+    NvU8 *pHead = pMts->Head;
+    NvU8 *p;
+    NvU32 FrameLength, PesLength;
+    NvU8 Profile;
+
+    pMts->Track = pAVParam->Track;
+    pMts->LengthPrefixed = NV_FALSE;
+
+    pHead[0] = 0;
+    pHead[1] = 0;
+    pHead[2] = 1;
+    pHead[3] = (pMts->Track == VIDEO_TRACK) ? MTS_PES_STREAM_ID_VIDEO : MTS_PES_STREAM_ID_AUDIO;
+    pHead[6] = 0x84; // data_alignment_indicator
+    pHead[7] = WriteDts ? 0xC0 : 0x80;
+    pHead[8] = WriteDts ? 2 * MTS_PES_TIMESTAMP_SIZE : MTS_PES_TIMESTAMP_SIZE;
+    p = NvMtsPutTimestamp(pHead + MTS_PES_HEADER_SIZE, WriteDts ? 3 : 2, Pts + MTS_PTS_OFFSET);
+    if (WriteDts)
+        p = NvMtsPutTimestamp(p, 1, Dts + MTS_PTS_OFFSET);
+
+    if (pMts->Track == VIDEO_TRACK)
+    {
+        pMts->LengthPrefixed = !NvMtsIsAnnexB(pMts, pAVParam->pData, pAVParam->DataSize);
+        NvMtsScanAccessUnit(pMts, pAVParam->pData, pAVParam->DataSize,
+                            pMts->LengthPrefixed, &Info);
+        if (!Info.HasSlice && (Info.HasSps || Info.HasPps))
+            return NV_FALSE;
+
+        if (!Info.HasAud)
+        {
+            p[0] = 0;
+            p[1] = 0;
+            p[2] = 0;
+            p[3] = 1;
+            p[4] = MTS_NAL_AUD;
+            p[5] = 0xF0; // primary_pic_type 7, any slice type
+            p += MTS_AUD_SIZE;
+        }
+        // every segment has to be decodable on its own
+        if (Info.HasIdr && !Info.HasSps && !Info.HasPps && pMts->SpsSize && pMts->PpsSize)
+        {
+            NvOsMemcpy(p, pMts->Sps, pMts->SpsSize);
+            p += pMts->SpsSize;
+            NvOsMemcpy(p, pMts->Pps, pMts->PpsSize);
+            p += pMts->PpsSize;
+        }
+        pMts->RandomAccess = pAVParam->IsSyncFrame || Info.HasIdr;
+    }
+    else
+    {
+        if (pAVParam->DataSize < 2 || pAVParam->pData[0] != 0xFF ||
+            (pAVParam->pData[1] & 0xF0) != 0xF0)
+        {
+            // longer than any AAC frame, dropped
+            FrameLength = MTS_ADTS_HEADER_SIZE + pAVParam->DataSize;
+            if (FrameLength > 0x1FFF)
+                return NV_FALSE;
+
+            // ADTS signals HE-AAC as LC with implicit SBR
+            if (pInputParam->AacObjectType == MTS_AAC_OBJECT_SBR ||
+                pInputParam->AacObjectType < 1 || pInputParam->AacObjectType > 4)
+                Profile = MTS_AAC_OBJECT_LC - 1;
+            else
+                Profile = pInputParam->AacObjectType - 1;
+
+            p[0] = 0xFF;
+            p[1] = 0xF1; // MPEG-4, no CRC
+            p[2] = (NvU8)((Profile << 6) | ((pInputParam->AacSamplingFreqIndex & 0xF) << 2) |
+                          ((pInputParam->AacChannelNumber >> 2) & 0x1));
+            p[3] = (NvU8)(((pInputParam->AacChannelNumber & 0x3) << 6) | (FrameLength >> 11));
+            p[4] = (NvU8)(FrameLength >> 3);
+            p[5] = (NvU8)(((FrameLength & 0x7) << 5) | 0x1F);
+            p[6] = 0xFC; // buffer fullness VBR, one raw data block
+            p += MTS_ADTS_HEADER_SIZE;
+        }
+        pMts->RandomAccess = NV_TRUE;
+    }
+
+    pMts->HeadSize = (NvU32)(p - pHead);
+    pMts->PesSize = pMts->HeadSize + pAVParam->DataSize;
+    PesLength = pMts->PesSize - 6;
+    if (pMts->Track == VIDEO_TRACK || PesLength > MTS_PES_MAX_LENGTH)
+        PesLength = 0;
+    pHead[4] = (NvU8)(PesLength >> 8);
+    pHead[5] = (NvU8)PesLength;
+
+    pMts->PesPos = 0;
+    pMts->DataPos = 0;
+    pMts->CodeEnd = 0;
+    pMts->NalEnd = 0;
+
+    // The clock follows the decode times, which the PTS/DTS lead by
+    // MTS_PTS_OFFSET. It never runs backwards when audio and video interleave.
+    if (!pMts->ClockStarted || Dts > pMts->Pcr)
+        pMts->Pcr = Dts;
+
+    if (!pMts->ClockStarted || pMts->Pcr - pMts->LastPsi >= MTS_PSI_INTERVAL)
+        pMts->Pending |= MTS_PENDING_PAT | MTS_PENDING_PMT;
+
+    pMts->SamplePcr = NV_FALSE;
+    if (!pMts->ClockStarted || pMts->PcrForced ||
+        pMts->Pcr - pMts->LastPcr >= MTS_PCR_INTERVAL ||
+        (pMts->Track == VIDEO_TRACK && pMts->RandomAccess))
+    {
+        if (pMts->Track == pMts->PcrTrack)
+            pMts->SamplePcr = NV_TRUE;
+        else
+            pMts->Pending |= MTS_PENDING_PCR;
+    }
+    pMts->PcrForced = NV_FALSE;
+    pMts->ClockStarted = NV_TRUE;
+    return NV_TRUE;
+}
+
+// Copies the next Size bytes of the PES into a packet
+static void NvMtsCopyPayload(NvMtsWriter *pMts, const NvU8 *pData, NvU32 DataSize,
+                             NvU8 *pDst, NvU32 Size)
+{
+    NvU32 Count;
+
+    if (pMts->PesPos < pMts->HeadSize)
+    {
+        Count = NV_MIN(Size, pMts->HeadSize - pMts->PesPos);
+        NvOsMemcpy(pDst, pMts->Head + pMts->PesPos, Count);
+        pDst += Count;
+        Size -= Count;
+    }
+
+    if (!pMts->LengthPrefixed)
+    {
+        NvOsMemcpy(pDst, pData + pMts->DataPos, Size);
+        pMts->DataPos += Size;
+        return;
+    }
+
+    while (Size)
+    {
+        if (pMts->DataPos == pMts->NalEnd)
+        {
+            if (DataSize - pMts->DataPos > MTS_START_CODE_SIZE)
+            {
+                pMts->CodeEnd = pMts->DataPos + MTS_START_CODE_SIZE;
+                Count = NvMtsGetBE32(pData + pMts->DataPos);
+                pMts->NalEnd = (Count > DataSize - pMts->CodeEnd) ?
+                    DataSize : pMts->CodeEnd + Count;
+            }
+            else
+            {
+                // no room for a NAL unit, pass the tail through
+                pMts->CodeEnd = pMts->DataPos;
+                pMts->NalEnd = DataSize;
+            }
+        }
+
+        if (pMts->DataPos < pMts->CodeEnd)
+        {
+            *pDst++ = (pMts->DataPos + 1 == pMts->CodeEnd) ? 1 : 0;
+            pMts->DataPos++;
+            Size--;
+        }
+        else
+        {
+            Count = NV_MIN(Size, pMts->NalEnd - pMts->DataPos);
+            NvOsMemcpy(pDst, pData + pMts->DataPos, Count);
+            pMts->DataPos += Count;
+            pDst += Count;
+            Size -= Count;
+        }
+    }
+}
+
+static void NvMtsWritePcrPacket(NvMtsWriter *pMts, NvU8 *p)
+{
+    NvU16 Pid = pMts->Pid[pMts->PcrTrack];
+
+    p[0] = MTS_SYNC_BYTE;
+    p[1] = (NvU8)(Pid >> 8);
+    p[2] = (NvU8)Pid;
+    // the counter only advances on packets with payload
+    p[3] = (NvU8)(MTS_AFC_ADAPTATION_ONLY | ((pMts->Cc[pMts->PcrTrack] - 1) & 0xF));
+    p[4] = MTS_PACKET_PAYLOAD_SIZE - 1;
+    p[5] = MTS_AF_PCR;
+    NvMtsPutPcr(p + 6, pMts->Pcr);
+    NvOsMemset(p + 6 + MTS_AF_PCR_SIZE, 0xFF, MTS_PACKET_SIZE - 6 - MTS_AF_PCR_SIZE);
+    pMts->LastPcr = pMts->Pcr;
+}
+
+static void NvMtsWritePesPacket(NvMtsWriter *pMts, NvMMMtsAVParam *pAVParam, NvU8 *p)
+{
+    NvBool First = (pMts->PesPos == 0);
+    NvU16 Pid = pMts->Pid[pMts->Track];
+    NvU32 Remaining = pMts->PesSize - pMts->PesPos;
+    NvU32 AfSize = 0;
+    NvU32 Used;
+    NvU8 Flags = 0;
+
+    if (First)
+    {
+        if (pMts->RandomAccess)
+            Flags |= MTS_AF_RANDOM_ACCESS;
+        if (pMts->SamplePcr)
+            Flags |= MTS_AF_PCR;
+        if (Flags)
+            AfSize = 2 + ((Flags & MTS_AF_PCR) ? MTS_AF_PCR_SIZE : 0);
+    }
+    // the last packet of the PES is padded with adaptation field stuffing
+    if (Remaining < MTS_PACKET_PAYLOAD_SIZE - AfSize)
+        AfSize = MTS_PACKET_PAYLOAD_SIZE - Remaining;
+
+    p[0] = MTS_SYNC_BYTE;
+    p[1] = (NvU8)((First ? MTS_PUSI_FLAG : 0) | (Pid >> 8));
+    p[2] = (NvU8)Pid;
+    p[3] = (NvU8)((AfSize ? MTS_AFC_ADAPTATION_PAYLOAD : MTS_AFC_PAYLOAD_ONLY) |
+                  pMts->Cc[pMts->Track]);
+    pMts->Cc[pMts->Track] = (pMts->Cc[pMts->Track] + 1) & 0xF;
+    p += MTS_PACKET_HEADER_SIZE;
+
+    if (AfSize)
+    {
+        p[0] = (NvU8)(AfSize - 1);
+        if (AfSize > 1)
+        {
+            p[1] = Flags;
+            Used = 2;
+            if (Flags & MTS_AF_PCR)
+            {
+                NvMtsPutPcr(p + Used, pMts->Pcr);
+                pMts->LastPcr = pMts->Pcr;
+                Used += MTS_AF_PCR_SIZE;
+            }
+            NvOsMemset(p + Used, 0xFF, AfSize - Used);
+        }
+        p += AfSize;
+    }
+
+    NvMtsCopyPayload(pMts, pAVParam->pData, pAVParam->DataSize, p,
+                     MTS_PACKET_PAYLOAD_SIZE - AfSize);
+    pMts->PesPos += MTS_PACKET_PAYLOAD_SIZE - AfSize;
+}
+
+NvS16 NvMM_MTSWriteInit(NvMMMtsMuxInputParam *pInputParam, NvMMMtsMuxContext *pContext)
+{
+    NvMtsWriter *pMts = NULL;
+    NvU8 Section[32];
+    NvU8 *p;
+    NvU32 i;
+
+    if (!pInputParam || !pContext ||
+        (!pInputParam->AudioPresent && !pInputParam->VideoPresent))
+        return FAILURE;
+
+    pMts = NvOsAlloc(sizeof(NvMtsWriter));
+    if (!pMts)
+        return FAILURE;
+    NvOsMemset(pMts, 0, sizeof(NvMtsWriter));
+
+    if (pInputParam->AudioPresent)
+        pMts->Pid[SOUND_TRACK] = MTS_PID_AUDIO;
+    if (pInputParam->VideoPresent)
+        pMts->Pid[VIDEO_TRACK] = MTS_PID_VIDEO;
+    pMts->PcrTrack = pInputParam->VideoPresent ? VIDEO_TRACK : SOUND_TRACK;
+    pMts->SegmentTrack = pMts->PcrTrack;
+
+    // PAT with the one program
+    p = Section;
+    *p++ = MTS_TABLE_ID_PAT;
+    *p++ = 0xB0;
+    *p++ = 5 + 4 + MTS_PSI_CRC_SIZE;
+    *p++ = (NvU8)(MTS_TRANSPORT_STREAM_ID >> 8);
+    *p++ = (NvU8)MTS_TRANSPORT_STREAM_ID;
+    *p++ = 0xC1; // version 0, current
+    *p++ = 0;
+    *p++ = 0;
+    *p++ = (NvU8)(MTS_PROGRAM_NUMBER >> 8);
+    *p++ = (NvU8)MTS_PROGRAM_NUMBER;
+    *p++ = (NvU8)(0xE0 | (MTS_PID_PMT >> 8));
+    *p++ = (NvU8)MTS_PID_PMT;
+    NvMtsBuildPsiPacket(pMts->PatPacket, MTS_PID_PAT, Section, (NvU32)(p - Section));
+
+    // PMT, video first
+    p = Section;
+    *p++ = MTS_TABLE_ID_PMT;
+    *p++ = 0xB0;
+    *p++ = 0; // section_length, below
+    *p++ = (NvU8)(MTS_PROGRAM_NUMBER >> 8);
+    *p++ = (NvU8)MTS_PROGRAM_NUMBER;
+    *p++ = 0xC1;
+    *p++ = 0;
+    *p++ = 0;
+    *p++ = (NvU8)(0xE0 | (pMts->Pid[pMts->PcrTrack] >> 8));
+    *p++ = (NvU8)pMts->Pid[pMts->PcrTrack];
+    *p++ = 0xF0; // no program descriptors
+    *p++ = 0;
+    for (i = MAX_TRACK; i-- > 0; )
+    {
+        if (!pMts->Pid[i])
+            continue;
+        *p++ = (i == VIDEO_TRACK) ? MTS_STREAM_TYPE_H264 : MTS_STREAM_TYPE_AAC_ADTS;
+        *p++ = (NvU8)(0xE0 | (pMts->Pid[i] >> 8));
+        *p++ = (NvU8)pMts->Pid[i];
+        *p++ = 0xF0;
+        *p++ = 0;
+    }
+    Section[2] = (NvU8)(p - Section - 3 + MTS_PSI_CRC_SIZE);
+    NvMtsBuildPsiPacket(pMts->PmtPacket, MTS_PID_PMT, Section, (NvU32)(p - Section));
+
+    pContext->IntMemSize = sizeof(NvMtsWriter);
+    pContext->pIntMem = pMts;
     return SUCCESS;
 }
 
-NvS16 NvMM_MTSWriteClose(structInpParam *pstructInpParam, NvU8 *pBufferOut, NvS32 *Offset, tmem ptrstructMem)
+NvS16 NvMM_MTSWriteRun(NvMMMtsAVParam *pAVParam, NvMMMtsMuxInputParam *pInputParam, NvU8 *pBufferOut, NvU32 BufferSize, NvU32 *Offset, NvMMMtsMuxContext Context)
 {
+    NvMtsWriter *pMts = (NvMtsWriter *)Context.pIntMem;
+    NvU8 *p;
+
+    if (!pMts || !pAVParam || !pInputParam || !pBufferOut || !Offset ||
+        *Offset % MTS_PACKET_SIZE)
+        return FAILURE;
+
+    if (!pMts->SampleActive)
+    {
+        if (pAVParam->Track >= MAX_TRACK || !pMts->Pid[pAVParam->Track])
+            return FAILURE;
+        if (!pAVParam->pData || !pAVParam->DataSize)
+            return SUCCESS;
+
+        if (!pMts->SegmentCount ||
+            (pAVParam->Track == pMts->SegmentTrack &&
+             (pAVParam->IsSyncFrame || pAVParam->Track == SOUND_TRACK) &&
+             (pInputParam->SegmentRequest ||
+              (pInputParam->SegmentDuration &&
+               pAVParam->PTS >= pMts->SegmentStart + pInputParam->SegmentDuration))))
+        {
+            if (pMts->SegmentCount && !pMts->BoundaryReported)
+            {
+                pMts->BoundaryReported = NV_TRUE;
+                return MTS_SEGMENT_BOUNDARY;
+            }
+            pInputParam->SegmentRequest = NV_FALSE;
+            pMts->SegmentStart = pAVParam->PTS;
+            pMts->SegmentCount++;
+            pMts->Pending |= MTS_PENDING_PAT | MTS_PENDING_PMT;
+            pMts->PcrForced = NV_TRUE;
+        }
+        pMts->BoundaryReported = NV_FALSE;
+
+        if (!NvMtsStartSample(pMts, pAVParam, pInputParam))
+            return SUCCESS;
+        pMts->SampleActive = NV_TRUE;
+    }
+
+    while (pMts->Pending)
+    {
+        if (*Offset + MTS_PACKET_SIZE > BufferSize)
+            return MTS_OUTPUT_BUFFER_FULL;
+        p = pBufferOut + *Offset;
+
+        if (pMts->Pending & MTS_PENDING_PAT)
+        {
+            NvOsMemcpy(p, pMts->PatPacket, MTS_PACKET_SIZE);
+            p[3] |= pMts->PatCc;
+            pMts->PatCc = (pMts->PatCc + 1) & 0xF;
+            pMts->LastPsi = pMts->Pcr;
+            pMts->Pending &= ~MTS_PENDING_PAT;
+        }
+        else if (pMts->Pending & MTS_PENDING_PMT)
+        {
+            NvOsMemcpy(p, pMts->PmtPacket, MTS_PACKET_SIZE);
+            p[3] |= pMts->PmtCc;
+            pMts->PmtCc = (pMts->PmtCc + 1) & 0xF;
+            pMts->Pending &= ~MTS_PENDING_PMT;
+        }
+        else
+        {
+            NvMtsWritePcrPacket(pMts, p);
+            pMts->Pending &= ~MTS_PENDING_PCR;
+        }
+        *Offset += MTS_PACKET_SIZE;
+    }
+
+    while (pMts->PesPos < pMts->PesSize)
+    {
+        if (*Offset + MTS_PACKET_SIZE > BufferSize)
+            return MTS_OUTPUT_BUFFER_FULL;
+        NvMtsWritePesPacket(pMts, pAVParam, pBufferOut + *Offset);
+        *Offset += MTS_PACKET_SIZE;
+    }
+
+    pMts->SampleActive = NV_FALSE;
     return SUCCESS;
+}
+
+NvU32 NvMM_MTSWriteGetSegmentCount(NvMMMtsMuxContext Context)
+{
+    NvMtsWriter *pMts = (NvMtsWriter *)Context.pIntMem;
 
-}
\ No newline at end of file
+    return pMts ? pMts->SegmentCount : 0;
+}
+
+NvS16 NvMM_MTSWriteClose(NvMMMtsMuxInputParam *pInputParam, NvMMMtsMuxContext *pContext)
+{
+    if (!pContext)
+        return FAILURE;
+
+    NvOsFree(pContext->pIntMem);
+    pContext->pIntMem = NULL;
+    pContext->IntMemSize = 0;
+    return SUCCESS;
+}
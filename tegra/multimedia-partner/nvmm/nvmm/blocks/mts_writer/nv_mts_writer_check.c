@@ -0,0 +1,1030 @@
+/*
+ * Copyright (c) 2013 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an
+ * express license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+/*
+ * MTS writer check.
+ *
+ * Feeds generated H.264 and AAC samples to NvMM_MTSWriteRun and demuxes the
+ * transport stream it writes. Sync bytes, continuity counters, PAT, PMT,
+ * PCRs, PES headers and timestamps are checked, and every PES payload is
+ * compared with what its sample should turn into: H.264 with start codes,
+ * an access unit delimiter and the last parameter sets in front of IDR
+ * frames without them, AAC with an ADTS header. The streams below mix
+ * length prefixed and Annex B access units, and raw and ADTS framed AAC.
+ *
+ * Each stream is written with an output buffer that takes whole samples
+ * and again with buffers of a few packets; resuming after every
+ * MTS_OUTPUT_BUFFER_FULL has to give the same bytes. MTS_SEGMENT_BOUNDARY
+ * has to come on the sync frames SegmentDuration and SegmentRequest call
+ * for, before anything of the sample is written, and each segment has to
+ * start with a PAT, a PMT and a random access PES carrying a PCR.
+ *
+ * usage: nv_mts_writer_check
+ */
+
+#include <stdio.h>
+
+#include "nvos.h"
+#include "nv_mts_writer.h"
+
+#define CHECK_VIDEO_FRAME_TIME  333667      /* 100 ns units, 29.97 Hz */
+#define CHECK_AUDIO_FRAME_TIME  213333      /* 1024 samples at 48 kHz */
+#define CHECK_TO_90KHZ(t)       ((t) * 9 / 1000)
+#define CHECK_AAC_FREQ_INDEX    3           /* 48 kHz */
+#define CHECK_AAC_CHANNELS      2
+#define CHECK_SPS_SIZE          11
+#define CHECK_PPS_SIZE          5
+#define CHECK_MAX_NAL_OVERHEAD  64
+#define CHECK_MAX_SEGMENTS      64
+#define CHECK_MAX_ERRORS        10
+#define CHECK_NONE              0xFFFFFFFF
+
+typedef struct CheckStreamRec
+{
+    const char *szName;
+    NvBool bVideo;
+    NvBool bAudio;
+    NvBool bAnnexB;             /* start codes, else 4 byte NAL lengths */
+    NvBool bAdts;               /* ADTS framed AAC, else raw */
+    NvBool bConfigSample;       /* parameter sets in a sample of their own */
+    NvU8 AacObjectType;
+    NvU32 nFrames;              /* of the video, or of the audio without video */
+    NvU32 SliceSize;            /* per video frame, 0 for n + 1 bytes in frame n */
+    NvU32 GopSize;
+    NvU32 SegmentMs;            /* 0 for one segment */
+    NvU32 RequestFrame;         /* SegmentRequest set before it, 0 for none */
+} CheckStream;
+
+static const CheckStream s_Streams[] =
+{
+    { "lengths, raw aac",       NV_TRUE,  NV_TRUE,  NV_FALSE, NV_FALSE, NV_TRUE,  2, 300, 12000,  30, 2000, 0 },
+    { "annex b, adts",          NV_TRUE,  NV_TRUE,  NV_TRUE,  NV_TRUE,  NV_FALSE, 2, 300, 12000,  30, 2000, 0 },
+    { "lengths, adts",          NV_TRUE,  NV_TRUE,  NV_FALSE, NV_TRUE,  NV_FALSE, 5, 300, 7000,   24, 0,    0 },
+    { "annex b, raw he-aac",    NV_TRUE,  NV_TRUE,  NV_TRUE,  NV_FALSE, NV_TRUE,  5, 300, 7000,   24, 0,    0 },
+    // every way a PES can end in a packet
+    { "frame sizes, lengths",   NV_TRUE,  NV_FALSE, NV_FALSE, NV_FALSE, NV_TRUE,  2, 400, 0,      45, 1000, 0 },
+    { "frame sizes, annex b",   NV_TRUE,  NV_FALSE, NV_TRUE,  NV_FALSE, NV_FALSE, 2, 400, 0,      45, 1000, 0 },
+    { "large frames",           NV_TRUE,  NV_TRUE,  NV_FALSE, NV_FALSE, NV_FALSE, 2, 40,  200000, 10, 1000, 0 },
+    { "segment request",        NV_TRUE,  NV_TRUE,  NV_FALSE, NV_FALSE, NV_TRUE,  2, 200, 5000,   20, 0,    50 },
+    { "request and duration",   NV_TRUE,  NV_TRUE,  NV_TRUE,  NV_TRUE,  NV_FALSE, 2, 200, 5000,   25, 3000, 37 },
+    { "audio only, raw",        NV_FALSE, NV_TRUE,  NV_FALSE, NV_FALSE, NV_FALSE, 2, 700, 0,      0,  1000, 0 },
+    { "audio only, adts",       NV_FALSE, NV_TRUE,  NV_FALSE, NV_TRUE,  NV_FALSE, 2, 700, 0,      0,  0,    120 },
+};
+
+/* The first size takes any sample whole, the others fill up inside them */
+static const NvU32 s_BufferPackets[] = { 2048, 1, 2, 7 };
+
+typedef struct CheckSampleRec
+{
+    NvU32 EsOffset;
+    NvU32 EsSize;
+    NvU64 Pts;                  /* 90 kHz */
+    NvU64 Dts;
+    NvBool bSync;
+} CheckSample;
+
+typedef struct CheckTrackRec
+{
+    CheckSample *pSamples;
+    NvU32 nSamples;
+    NvU8 *pEs;                  /* the elementary stream the samples make */
+    NvU32 EsSize;
+    NvU32 EsMax;
+    NvU32 MaxSample;
+    NvU32 nDemuxed;
+} CheckTrack;
+
+typedef struct CheckInputRec
+{
+    NvMMMtsAVParam *pSamples;
+    NvU32 *pTrackIndex;         /* of the expected sample, CHECK_NONE for none */
+    NvU32 nSamples;
+    NvU32 RequestSample;
+    NvU32 SegmentTrack;
+    NvU32 Segments[CHECK_MAX_SEGMENTS];     /* samples starting one */
+    NvU32 nSegments;
+    NvU64 SegmentStart;
+    NvBool bRequest;
+    NvU8 Sps[CHECK_SPS_SIZE];
+    NvBool bSps;
+    NvU8 Pps[CHECK_PPS_SIZE];
+    NvU8 *pNal;
+    NvU8 *pScratch;
+    CheckTrack Tracks[MAX_TRACK];
+} CheckInput;
+
+typedef struct CheckOutputRec
+{
+    NvU8 *pData;
+    NvU32 Size;
+    NvU32 Max;
+    NvU32 Offsets[CHECK_MAX_SEGMENTS];
+    NvU32 Segments[CHECK_MAX_SEGMENTS];
+    NvU32 nSegments;
+} CheckOutput;
+
+typedef struct CheckPidRec
+{
+    NvS32 Cc;                   /* -1 before the first payload */
+    NvU8 *pPes;
+    NvU32 PesSize;
+    NvU32 PesMax;
+    NvBool bPes;
+    NvBool bRandomAccess;
+    NvU32 Segment;              /* started by the PES, 0 for none */
+    NvU64 Pcr;                  /* when the PES started */
+} CheckPid;
+
+typedef struct CheckDemuxRec
+{
+    const CheckStream *pStream;
+    CheckInput *pIn;
+    CheckOutput *pOut;
+    CheckPid Pids[MAX_TRACK];
+    NvU16 Pid[MAX_TRACK];
+    NvU32 PcrTrack;
+    NvS32 PatCc;
+    NvS32 PmtCc;
+    NvU32 Offset;
+    NvU32 nErrors;
+    NvU32 nSegments;
+    NvU32 SegmentPacket;
+    NvU64 Pcr;
+    NvBool bPcr;
+    NvU64 TsBase;
+    NvBool bTsBase;
+} CheckDemux;
+
+static void CheckError(CheckDemux *pDemux, const char *szWhat)
+{
+    if (pDemux->nErrors++ < CHECK_MAX_ERRORS)
+        printf("%s: %s at byte %u\n", pDemux->pStream->szName, szWhat, pDemux->Offset);
+}
+
+static void CheckPut32(NvU8 *p, NvU32 Value)
+{
+    p[0] = (NvU8)(Value >> 24);
+    p[1] = (NvU8)(Value >> 16);
+    p[2] = (NvU8)(Value >> 8);
+    p[3] = (NvU8)Value;
+}
+
+/* CRC_32 of ISO/IEC 13818-1 annex B; 0 over a section with its CRC */
+static NvU32 CheckCrc32(const NvU8 *pData, NvU32 Size)
+{
+    NvU32 Crc = 0xFFFFFFFF;
+    NvU32 i;
+
+    while (Size--)
+    {
+        Crc ^= (NvU32)*pData++ << 24;
+        for (i = 0; i < 8; i++)
+            Crc = (Crc & 0x80000000) ? (Crc << 1) ^ 0x04C11DB7 : Crc << 1;
+    }
+    return Crc;
+}
+
+static void CheckPutAdts(NvU8 *p, NvU8 Profile, NvU8 FreqIndex, NvU8 Channels, NvU32 FrameLength)
+{
+    p[0] = 0xFF;
+    p[1] = 0xF1;
+    p[2] = (NvU8)((Profile << 6) | (FreqIndex << 2) | (Channels >> 2));
+    p[3] = (NvU8)(((Channels & 0x3) << 6) | (FrameLength >> 11));
+    p[4] = (NvU8)(FrameLength >> 3);
+    p[5] = (NvU8)(((FrameLength & 0x7) << 5) | 0x1F);
+    p[6] = 0xFC;
+}
+
+static NvU8 *CheckPutNal(NvU8 *p, const NvU8 *pNal, NvU32 Size, NvBool bAnnexB, NvBool bShortCode)
+{
+    if (!bAnnexB)
+    {
+        CheckPut32(p, Size);
+        p += 4;
+    }
+    else
+    {
+        if (!bShortCode)
+            *p++ = 0;
+        *p++ = 0;
+        *p++ = 0;
+        *p++ = 1;
+    }
+    NvOsMemcpy(p, pNal, Size);
+    return p + Size;
+}
+
+static NvBool CheckExpect(CheckTrack *pTrack, const NvU8 *pEs, NvU32 Size,
+                          NvU64 Pts, NvU64 Dts, NvBool bSync)
+{
+    CheckSample *pSample = &pTrack->pSamples[pTrack->nSamples++];
+    NvU8 *pNew;
+
+    if (pTrack->EsSize + Size > pTrack->EsMax)
+    {
+        pNew = NvOsRealloc(pTrack->pEs, 2 * (pTrack->EsMax + Size));
+        if (!pNew)
+            return NV_FALSE;
+        pTrack->pEs = pNew;
+        pTrack->EsMax = 2 * (pTrack->EsMax + Size);
+    }
+    NvOsMemcpy(pTrack->pEs + pTrack->EsSize, pEs, Size);
+    pSample->EsOffset = pTrack->EsSize;
+    pSample->EsSize = Size;
+    pSample->Pts = CHECK_TO_90KHZ(Pts);
+    pSample->Dts = CHECK_TO_90KHZ(Dts);
+    pSample->bSync = bSync;
+    pTrack->EsSize += Size;
+    pTrack->MaxSample = NV_MAX(pTrack->MaxSample, Size);
+    return NV_TRUE;
+}
+
+/*
+ * Adds a sample to the input, and notes whether it should start a segment,
+ * as nv_mts_writer.h describes.
+ */
+static NvMMMtsAVParam *CheckAddSample(CheckInput *pIn, const CheckStream *pStream, NvU32 Track,
+                                      NvU32 Size, NvU64 Pts, NvU64 Dts, NvBool bSync)
+{
+    NvMMMtsAVParam *pSample = &pIn->pSamples[pIn->nSamples];
+
+    NvOsMemset(pSample, 0, sizeof(NvMMMtsAVParam));
+    pSample->pData = NvOsAlloc(Size);
+    if (!pSample->pData)
+        return NULL;
+    pSample->DataSize = Size;
+    pSample->Track = Track;
+    pSample->PTS = Pts;
+    pSample->DTS = Dts;
+    pSample->IsSyncFrame = bSync;
+    pIn->pTrackIndex[pIn->nSamples] = CHECK_NONE;
+
+    if (pIn->nSamples == pIn->RequestSample)
+        pIn->bRequest = NV_TRUE;
+    if (!pIn->nSamples)
+        pIn->SegmentStart = Pts;
+    else if (Track == pIn->SegmentTrack && (bSync || Track == SOUND_TRACK) &&
+             (pIn->bRequest ||
+              (pStream->SegmentMs && Pts >= pIn->SegmentStart + pStream->SegmentMs * 10000ULL)) &&
+             pIn->nSegments < CHECK_MAX_SEGMENTS)
+    {
+        pIn->Segments[pIn->nSegments++] = pIn->nSamples;
+        pIn->SegmentStart = Pts;
+        pIn->bRequest = NV_FALSE;
+    }
+
+    pIn->nSamples++;
+    return pSample;
+}
+
+/*
+ * Frame n is an IDR frame every GopSize frames and carries its own
+ * parameter sets on the first, unless they came in a sample of their own,
+ * and on every third IDR frame after, with new contents. Every fourth
+ * frame starts with an access unit delimiter. Annex B frames use three
+ * byte start codes here and there.
+ */
+static NvBool CheckAddVideo(CheckInput *pIn, const CheckStream *pStream, NvU32 Frame, NvBool bConfig)
+{
+    CheckTrack *pTrack = &pIn->Tracks[VIDEO_TRACK];
+    NvBool bIdr = !(Frame % pStream->GopSize);
+    NvBool bSets = bConfig ||
+        (bIdr && ((!Frame && !pStream->bConfigSample) || (Frame / pStream->GopSize) % 3 == 2));
+    NvU32 SliceSize = pStream->SliceSize ? pStream->SliceSize : Frame + 1;
+    NvU64 Dts = (NvU64)Frame * CHECK_VIDEO_FRAME_TIME;
+    NvU64 Pts = Dts + ((Frame & 1) ? CHECK_VIDEO_FRAME_TIME : 0);
+    NvU8 Aud[2] = { MTS_NAL_AUD, 0x30 };
+    NvU32 NalSizes[6];
+    const NvU8 *pNals[6];
+    NvU32 nNals = 0;
+    NvMMMtsAVParam *pSample;
+    NvU8 *p, *pEs;
+    NvU32 i, n, Size;
+
+    if (!bConfig && (Frame & 3) == 3)
+    {
+        pNals[nNals] = Aud;
+        NalSizes[nNals++] = sizeof(Aud);
+    }
+    if (bSets)
+    {
+        pIn->Sps[0] = 0x67;
+        for (i = 1; i < CHECK_SPS_SIZE; i++)
+            pIn->Sps[i] = (NvU8)((Frame * 3 + i) | 1);
+        pIn->Pps[0] = 0x68;
+        for (i = 1; i < CHECK_PPS_SIZE; i++)
+            pIn->Pps[i] = (NvU8)((Frame * 5 + i) | 1);
+        pIn->bSps = NV_TRUE;
+        pNals[nNals] = pIn->Sps;
+        NalSizes[nNals++] = CHECK_SPS_SIZE;
+        pNals[nNals] = pIn->Pps;
+        NalSizes[nNals++] = CHECK_PPS_SIZE;
+    }
+    if (!bConfig)
+    {
+        // slice data without zero bytes, so without start code emulation
+        pIn->pNal[0] = bIdr ? 0x65 : 0x41;
+        for (i = 1; i < SliceSize; i++)
+            pIn->pNal[i] = (NvU8)((i * 7 + Frame) | 1);
+        n = (SliceSize > 1000) ? SliceSize / 2 : SliceSize;
+        pNals[nNals] = pIn->pNal;
+        NalSizes[nNals++] = n;
+        if (n < SliceSize)
+        {
+            pIn->pNal[n] = pIn->pNal[0];
+            pNals[nNals] = pIn->pNal + n;
+            NalSizes[nNals++] = SliceSize - n;
+        }
+    }
+
+    Size = 0;
+    for (i = 0; i < nNals; i++)
+        Size += 4 + NalSizes[i];
+    pSample = CheckAddSample(pIn, pStream, VIDEO_TRACK, Size, Pts, Dts, bIdr && !bConfig);
+    if (!pSample)
+        return NV_FALSE;
+
+    p = pSample->pData;
+    pEs = pIn->pScratch;
+    if (pNals[0] != Aud)
+    {
+        pEs[0] = 0;
+        pEs[1] = 0;
+        pEs[2] = 0;
+        pEs[3] = 1;
+        pEs[4] = MTS_NAL_AUD;
+        pEs[5] = 0xF0;
+        pEs += 6;
+    }
+    if (bIdr && !bSets && pIn->bSps)
+    {
+        pEs = CheckPutNal(pEs, pIn->Sps, CHECK_SPS_SIZE, NV_TRUE, NV_FALSE);
+        pEs = CheckPutNal(pEs, pIn->Pps, CHECK_PPS_SIZE, NV_TRUE, NV_FALSE);
+    }
+    for (i = 0; i < nNals; i++)
+    {
+        NvBool bShortCode = pStream->bAnnexB && (Frame + i) % 3 == 1;
+
+        p = CheckPutNal(p, pNals[i], NalSizes[i], pStream->bAnnexB, bShortCode);
+        pEs = CheckPutNal(pEs, pNals[i], NalSizes[i], NV_TRUE, bShortCode);
+    }
+    pSample->DataSize = (NvU32)(p - pSample->pData);
+
+    // parameter sets alone are kept for the IDR frames, not written
+    if (bConfig)
+        return NV_TRUE;
+    pIn->pTrackIndex[pIn->nSamples - 1] = pTrack->nSamples;
+    return CheckExpect(pTrack, pIn->pScratch, (NvU32)(pEs - pIn->pScratch), Pts, Dts, bIdr);
+}
+
+/*
+ * AAC frame n has 1 + n * 37 % 700 bytes that never look like an ADTS
+ * header. ADTS framed input uses another configuration than the writer,
+ * which must not touch it.
+ */
+static NvBool CheckAddAudio(CheckInput *pIn, const CheckStream *pStream, NvU32 Frame)
+{
+    CheckTrack *pTrack = &pIn->Tracks[SOUND_TRACK];
+    NvU32 RawSize = 1 + Frame * 37 % 700;
+    NvU32 Size = pStream->bAdts ? MTS_ADTS_HEADER_SIZE + RawSize : RawSize;
+    NvU64 Pts = (NvU64)Frame * CHECK_AUDIO_FRAME_TIME;
+    // ADTS signals HE-AAC as LC
+    NvU8 Profile = (pStream->AacObjectType == 5) ? 1 : pStream->AacObjectType - 1;
+    NvMMMtsAVParam *pSample;
+    NvU8 *p = pIn->pScratch;
+    NvU32 i;
+
+    // the ADTS header the writer adds, or one of another configuration
+    if (pStream->bAdts)
+        CheckPutAdts(p, Profile, CHECK_AAC_FREQ_INDEX + 1, 1, MTS_ADTS_HEADER_SIZE + RawSize);
+    else
+        CheckPutAdts(p, Profile, CHECK_AAC_FREQ_INDEX, CHECK_AAC_CHANNELS,
+                     MTS_ADTS_HEADER_SIZE + RawSize);
+    for (i = 0; i < RawSize; i++)
+        p[MTS_ADTS_HEADER_SIZE + i] = (NvU8)((Frame + i * 3) & 0x7F);
+
+    pSample = CheckAddSample(pIn, pStream, SOUND_TRACK, Size, Pts, Pts, NV_TRUE);
+    if (!pSample)
+        return NV_FALSE;
+    NvOsMemcpy(pSample->pData, p + MTS_ADTS_HEADER_SIZE - (Size - RawSize), Size);
+
+    pIn->pTrackIndex[pIn->nSamples - 1] = pTrack->nSamples;
+    return CheckExpect(pTrack, p, MTS_ADTS_HEADER_SIZE + RawSize, Pts, Pts, NV_TRUE);
+}
+
+static void CheckFree(CheckInput *pIn)
+{
+    NvU32 i;
+
+    if (pIn->pSamples)
+    {
+        for (i = 0; i < pIn->nSamples; i++)
+            NvOsFree(pIn->pSamples[i].pData);
+    }
+    for (i = 0; i < MAX_TRACK; i++)
+    {
+        NvOsFree(pIn->Tracks[i].pSamples);
+        NvOsFree(pIn->Tracks[i].pEs);
+    }
+    NvOsFree(pIn->pSamples);
+    NvOsFree(pIn->pTrackIndex);
+    NvOsFree(pIn->pNal);
+    NvOsFree(pIn->pScratch);
+}
+
+/* Video frames each followed by the audio frames that start before the next */
+static NvBool CheckBuild(CheckInput *pIn, const CheckStream *pStream)
+{
+    NvU32 MaxSamples = 3 * pStream->nFrames + 2;
+    NvU32 MaxSlice = pStream->SliceSize ? pStream->SliceSize : pStream->nFrames;
+    NvU32 Audio = 0;
+    NvU32 i;
+
+    NvOsMemset(pIn, 0, sizeof(CheckInput));
+    pIn->RequestSample = CHECK_NONE;
+    pIn->SegmentTrack = pStream->bVideo ? VIDEO_TRACK : SOUND_TRACK;
+    pIn->pSamples = NvOsAlloc(MaxSamples * sizeof(NvMMMtsAVParam));
+    pIn->pTrackIndex = NvOsAlloc(MaxSamples * sizeof(NvU32));
+    pIn->pNal = NvOsAlloc(MaxSlice);
+    pIn->pScratch = NvOsAlloc(MaxSlice + CHECK_MAX_NAL_OVERHEAD + 1024);
+    for (i = 0; i < MAX_TRACK; i++)
+        pIn->Tracks[i].pSamples = NvOsAlloc(MaxSamples * sizeof(CheckSample));
+    if (!pIn->pSamples || !pIn->pTrackIndex || !pIn->pNal || !pIn->pScratch ||
+        !pIn->Tracks[0].pSamples || !pIn->Tracks[1].pSamples)
+        return NV_FALSE;
+
+    if (!pStream->bVideo)
+    {
+        for (i = 0; i < pStream->nFrames; i++)
+        {
+            if (pStream->RequestFrame && i == pStream->RequestFrame)
+                pIn->RequestSample = pIn->nSamples;
+            if (!CheckAddAudio(pIn, pStream, i))
+                return NV_FALSE;
+        }
+        return NV_TRUE;
+    }
+
+    if (pStream->bConfigSample && !CheckAddVideo(pIn, pStream, 0, NV_TRUE))
+        return NV_FALSE;
+    for (i = 0; i < pStream->nFrames; i++)
+    {
+        if (pStream->RequestFrame && i == pStream->RequestFrame)
+            pIn->RequestSample = pIn->nSamples;
+        if (!CheckAddVideo(pIn, pStream, i, NV_FALSE))
+            return NV_FALSE;
+        while (pStream->bAudio &&
+               (NvU64)Audio * CHECK_AUDIO_FRAME_TIME < (NvU64)(i + 1) * CHECK_VIDEO_FRAME_TIME)
+        {
+            if (!CheckAddAudio(pIn, pStream, Audio++))
+                return NV_FALSE;
+        }
+    }
+    return NV_TRUE;
+}
+
+static NvBool CheckFlush(CheckOutput *pOut, const NvU8 *pBuffer, NvU32 *pOffset)
+{
+    NvU8 *pNew;
+
+    if (pOut->Size + *pOffset > pOut->Max)
+    {
+        pNew = NvOsRealloc(pOut->pData, 2 * (pOut->Max + *pOffset));
+        if (!pNew)
+            return NV_FALSE;
+        pOut->pData = pNew;
+        pOut->Max = 2 * (pOut->Max + *pOffset);
+    }
+    NvOsMemcpy(pOut->pData + pOut->Size, pBuffer, *pOffset);
+    pOut->Size += *pOffset;
+    *pOffset = 0;
+    return NV_TRUE;
+}
+
+/*
+ * Writes the samples the way the writer block does: flushes the buffer on
+ * MTS_OUTPUT_BUFFER_FULL, closes the segment on MTS_SEGMENT_BOUNDARY, and
+ * calls again with the same sample.
+ */
+static NvBool CheckWrite(const CheckStream *pStream, CheckInput *pIn, NvU32 BufferSize,
+                         CheckOutput *pOut, NvU64 *pTime)
+{
+    NvMMMtsMuxInputParam Param;
+    NvMMMtsMuxContext Context;
+    NvU8 *pBuffer = NvOsAlloc(BufferSize);
+    NvU32 Offset = 0;
+    NvU32 Before;
+    NvBool bWritten, bBoundary;
+    NvBool bOk = NV_TRUE;
+    NvS16 Status;
+    NvU64 Start;
+    NvU32 i;
+
+    NvOsMemset(pOut, 0, sizeof(CheckOutput));
+    NvOsMemset(&Param, 0, sizeof(Param));
+    NvOsMemset(&Context, 0, sizeof(Context));
+    Param.VideoPresent = pStream->bVideo;
+    Param.AudioPresent = pStream->bAudio;
+    Param.AacObjectType = pStream->AacObjectType;
+    Param.AacSamplingFreqIndex = CHECK_AAC_FREQ_INDEX;
+    Param.AacChannelNumber = CHECK_AAC_CHANNELS;
+    Param.SegmentDuration = pStream->SegmentMs * 10000ULL;
+    if (!pBuffer || NvMM_MTSWriteInit(&Param, &Context) != SUCCESS)
+    {
+        NvOsFree(pBuffer);
+        printf("%s: init failed\n", pStream->szName);
+        return NV_FALSE;
+    }
+    pOut->nSegments = 1;
+
+    Start = NvOsGetTimeUS();
+    for (i = 0; i < pIn->nSamples && bOk; i++)
+    {
+        if (i == pIn->RequestSample)
+            Param.SegmentRequest = NV_TRUE;
+        bWritten = NV_FALSE;
+        bBoundary = NV_FALSE;
+        for (;;)
+        {
+            Before = Offset;
+            Status = NvMM_MTSWriteRun(&pIn->pSamples[i], &Param, pBuffer, BufferSize, &Offset, Context);
+            if (Status == SUCCESS)
+                break;
+
+            if (Status == MTS_OUTPUT_BUFFER_FULL)
+            {
+                if (Offset == Before && Offset + MTS_PACKET_SIZE <= BufferSize)
+                {
+                    printf("%s: sample %u full without writing\n", pStream->szName, i);
+                    bOk = NV_FALSE;
+                    break;
+                }
+                bWritten = NV_TRUE;
+            }
+            else if (Status == MTS_SEGMENT_BOUNDARY)
+            {
+                if (bBoundary || bWritten || Offset != Before)
+                {
+                    printf("%s: sample %u boundary after writing\n", pStream->szName, i);
+                    bOk = NV_FALSE;
+                    break;
+                }
+                bBoundary = NV_TRUE;
+            }
+            else
+            {
+                printf("%s: sample %u returned %d\n", pStream->szName, i, Status);
+                bOk = NV_FALSE;
+                break;
+            }
+
+            if (!CheckFlush(pOut, pBuffer, &Offset))
+            {
+                bOk = NV_FALSE;
+                break;
+            }
+            if (Status == MTS_SEGMENT_BOUNDARY && pOut->nSegments < CHECK_MAX_SEGMENTS)
+            {
+                pOut->Offsets[pOut->nSegments] = pOut->Size;
+                pOut->Segments[pOut->nSegments++] = i;
+            }
+        }
+        if (bBoundary && Param.SegmentRequest)
+        {
+            printf("%s: sample %u left SegmentRequest set\n", pStream->szName, i);
+            bOk = NV_FALSE;
+        }
+    }
+    bOk = CheckFlush(pOut, pBuffer, &Offset) && bOk;
+    *pTime = NvOsGetTimeUS() - Start;
+
+    if (bOk && NvMM_MTSWriteGetSegmentCount(Context) != pOut->nSegments)
+    {
+        printf("%s: %u segments counted, %u reported\n", pStream->szName,
+               NvMM_MTSWriteGetSegmentCount(Context), pOut->nSegments);
+        bOk = NV_FALSE;
+    }
+    if (bOk && (pOut->nSegments != pIn->nSegments + 1 ||
+                NvOsMemcmp(pOut->Segments + 1, pIn->Segments, pIn->nSegments * sizeof(NvU32))))
+    {
+        printf("%s: segments do not start on the expected samples\n", pStream->szName);
+        bOk = NV_FALSE;
+    }
+
+    NvMM_MTSWriteClose(&Param, &Context);
+    NvOsFree(pBuffer);
+    return bOk;
+}
+
+static NvBool CheckGetTimestamp(const NvU8 *p, NvU8 Prefix, NvU64 *pTs)
+{
+    if ((p[0] >> 4) != Prefix || !(p[0] & 1) || !(p[2] & 1) || !(p[4] & 1))
+        return NV_FALSE;
+    *pTs = ((NvU64)(p[0] & 0x0E) << 29) | ((NvU64)p[1] << 22) | ((NvU64)(p[2] >> 1) << 15) |
+           ((NvU64)p[3] << 7) | (p[4] >> 1);
+    return NV_TRUE;
+}
+
+/* An SPS and a PPS come before the IDR slice */
+static NvBool CheckHasParamSets(const NvU8 *p, NvU32 Size)
+{
+    NvBool bSps = NV_FALSE, bPps = NV_FALSE;
+    NvU32 i;
+
+    for (i = 0; i + 3 < Size; i++)
+    {
+        if (p[i] || p[i + 1] || p[i + 2] != 1)
+            continue;
+        switch (p[i + 3] & MTS_NAL_TYPE_MASK)
+        {
+            case MTS_NAL_SPS: bSps = NV_TRUE; break;
+            case MTS_NAL_PPS: bPps = NV_TRUE; break;
+            case MTS_NAL_IDR: return bSps && bPps;
+            default: break;
+        }
+    }
+    return NV_FALSE;
+}
+
+static void CheckPsi(CheckDemux *pDemux, const NvU8 *p, NvU16 Pid)
+{
+    const NvU8 *pSection = p + 5;
+    NvU32 Length = ((pSection[1] & 0xF) << 8) | pSection[2];
+    NvU32 Pos, i;
+
+    if (!(p[1] & MTS_PUSI_FLAG) || (p[3] & 0x30) != MTS_AFC_PAYLOAD_ONLY || p[4])
+    {
+        CheckError(pDemux, "PSI packet without a section");
+        return;
+    }
+    if (Length + 3 > MTS_PACKET_SIZE - 5 || CheckCrc32(pSection, Length + 3))
+    {
+        CheckError(pDemux, "bad PSI CRC");
+        return;
+    }
+
+    if (Pid == MTS_PID_PAT)
+    {
+        if (pSection[0] != MTS_TABLE_ID_PAT || Length != 13 ||
+            ((pSection[8] << 8) | pSection[9]) != MTS_PROGRAM_NUMBER ||
+            (((pSection[10] & 0x1F) << 8) | pSection[11]) != MTS_PID_PMT)
+            CheckError(pDemux, "bad PAT");
+        return;
+    }
+
+    if (pSection[0] != MTS_TABLE_ID_PMT ||
+        (((pSection[8] & 0x1F) << 8) | pSection[9]) != pDemux->Pid[pDemux->PcrTrack] ||
+        (((pSection[10] & 0xF) << 8) | pSection[11]))
+    {
+        CheckError(pDemux, "bad PMT");
+        return;
+    }
+    Pos = 12;
+    for (i = MAX_TRACK; i-- > 0; )
+    {
+        if (!pDemux->Pid[i])
+            continue;
+        if (Pos + 5 > Length + 3 - MTS_PSI_CRC_SIZE ||
+            pSection[Pos] != ((i == VIDEO_TRACK) ? MTS_STREAM_TYPE_H264 : MTS_STREAM_TYPE_AAC_ADTS) ||
+            (((pSection[Pos + 1] & 0x1F) << 8) | pSection[Pos + 2]) != pDemux->Pid[i])
+        {
+            CheckError(pDemux, "bad PMT stream");
+            return;
+        }
+        Pos += 5;
+    }
+    if (Pos != Length + 3 - MTS_PSI_CRC_SIZE)
+        CheckError(pDemux, "extra PMT streams");
+}
+
+static void CheckPes(CheckDemux *pDemux, NvU32 Track)
+{
+    CheckPid *pPid = &pDemux->Pids[Track];
+    CheckTrack *pTrack = &pDemux->pIn->Tracks[Track];
+    const CheckSample *pSample;
+    const NvU8 *p = pPid->pPes;
+    NvU32 Index = 0;
+    NvU32 Length, HeaderSize;
+    NvU64 Pts, Dts;
+    NvU8 Flags;
+
+    pPid->bPes = NV_FALSE;
+    if (pPid->Segment > 1)
+        Index = pDemux->pIn->pTrackIndex[pDemux->pIn->Segments[pPid->Segment - 2]];
+    if (pPid->Segment > 1 && pTrack->nDemuxed != Index)
+        CheckError(pDemux, "segment starts on the wrong sample");
+    if (pTrack->nDemuxed >= pTrack->nSamples)
+    {
+        CheckError(pDemux, "PES without a sample");
+        return;
+    }
+    pSample = &pTrack->pSamples[pTrack->nDemuxed++];
+
+    if (pPid->PesSize < MTS_PES_HEADER_SIZE || p[0] || p[1] || p[2] != 1 ||
+        p[3] != ((Track == VIDEO_TRACK) ? MTS_PES_STREAM_ID_VIDEO : MTS_PES_STREAM_ID_AUDIO))
+    {
+        CheckError(pDemux, "bad PES start");
+        return;
+    }
+    Length = (p[4] << 8) | p[5];
+    if (Length != ((Track == VIDEO_TRACK) ? 0 : pPid->PesSize - 6))
+        CheckError(pDemux, "bad PES_packet_length");
+    if ((p[6] & 0xC4) != 0x84)
+        CheckError(pDemux, "data_alignment_indicator not set");
+
+    Flags = p[7] & 0xC0;
+    HeaderSize = MTS_PES_HEADER_SIZE + p[8];
+    if ((Flags != 0x80 || p[8] != MTS_PES_TIMESTAMP_SIZE) &&
+        (Flags != 0xC0 || p[8] != 2 * MTS_PES_TIMESTAMP_SIZE))
+    {
+        CheckError(pDemux, "bad PES header");
+        return;
+    }
+    if (!CheckGetTimestamp(p + MTS_PES_HEADER_SIZE, (Flags == 0xC0) ? 3 : 2, &Pts) ||
+        (Flags == 0xC0 &&
+         !CheckGetTimestamp(p + MTS_PES_HEADER_SIZE + MTS_PES_TIMESTAMP_SIZE, 1, &Dts)))
+    {
+        CheckError(pDemux, "bad PES timestamp");
+        return;
+    }
+    if (Flags != 0xC0)
+        Dts = Pts;
+
+    // timestamps lead the samples' by the writer's decoder delay
+    if (!pDemux->bTsBase)
+    {
+        pDemux->TsBase = (Pts - pSample->Pts) & MTS_TIMESTAMP_MASK;
+        pDemux->bTsBase = NV_TRUE;
+    }
+    if (Pts != ((pSample->Pts + pDemux->TsBase) & MTS_TIMESTAMP_MASK) ||
+        Dts != ((pSample->Dts + pDemux->TsBase) & MTS_TIMESTAMP_MASK) ||
+        (Flags == 0xC0) != (pSample->Pts != pSample->Dts))
+        CheckError(pDemux, "wrong PTS or DTS");
+    if (pPid->Pcr > Dts)
+        CheckError(pDemux, "PES arrives after its DTS");
+    if (pPid->bRandomAccess != pSample->bSync)
+        CheckError(pDemux, "wrong random_access_indicator");
+
+    if (pPid->PesSize - HeaderSize != pSample->EsSize ||
+        NvOsMemcmp(p + HeaderSize, pTrack->pEs + pSample->EsOffset, pSample->EsSize))
+        CheckError(pDemux, "PES payload differs from its sample");
+    if (pPid->Segment && Track == VIDEO_TRACK &&
+        !CheckHasParamSets(p + HeaderSize, pPid->PesSize - HeaderSize))
+        CheckError(pDemux, "segment without parameter sets");
+}
+
+static void CheckPacket(CheckDemux *pDemux, const NvU8 *p)
+{
+    NvU16 Pid = (NvU16)(((p[1] & 0x1F) << 8) | p[2]);
+    NvU32 Afc = (p[3] >> 4) & 0x3;
+    NvS32 Cc = p[3] & 0xF;
+    NvU32 Header = MTS_PACKET_HEADER_SIZE;
+    NvBool bPusi = (p[1] & MTS_PUSI_FLAG) != 0;
+    NvBool bRandomAccess = NV_FALSE;
+    NvBool bPcr = NV_FALSE;
+    NvBool bSegment = NV_FALSE;
+    NvS32 *pCc;
+    CheckPid *pPid = NULL;
+    NvU32 Track = MAX_TRACK;
+    NvU32 AfLength, Used, i;
+
+    if (p[0] != MTS_SYNC_BYTE || (p[1] & 0x80) || !Afc)
+    {
+        CheckError(pDemux, "bad packet header");
+        return;
+    }
+
+    if (Afc & 0x2)
+    {
+        AfLength = p[4];
+        if ((Afc == 0x2) ? AfLength != MTS_PACKET_PAYLOAD_SIZE - 1 :
+                           AfLength > MTS_PACKET_PAYLOAD_SIZE - 2)
+        {
+            CheckError(pDemux, "bad adaptation_field_length");
+            return;
+        }
+        if (AfLength)
+        {
+            if (p[5] & ~(MTS_AF_RANDOM_ACCESS | MTS_AF_PCR))
+                CheckError(pDemux, "unexpected adaptation field flags");
+            bRandomAccess = (p[5] & MTS_AF_RANDOM_ACCESS) != 0;
+            Used = 1;
+            if (p[5] & MTS_AF_PCR)
+            {
+                NvU64 Pcr = ((NvU64)p[6] << 25) | ((NvU64)p[7] << 17) | ((NvU64)p[8] << 9) |
+                            ((NvU64)p[9] << 1) | (p[10] >> 7);
+
+                if (AfLength < 1 + MTS_AF_PCR_SIZE || Pid != pDemux->Pid[pDemux->PcrTrack])
+                    CheckError(pDemux, "PCR out of place");
+                if (pDemux->bPcr && Pcr < pDemux->Pcr)
+                    CheckError(pDemux, "PCR went back");
+                pDemux->Pcr = Pcr;
+                pDemux->bPcr = NV_TRUE;
+                bPcr = NV_TRUE;
+                Used += MTS_AF_PCR_SIZE;
+            }
+            for (i = Used; i < AfLength; i++)
+            {
+                if (p[5 + i] != 0xFF)
+                {
+                    CheckError(pDemux, "bad stuffing");
+                    break;
+                }
+            }
+        }
+        Header += 1 + AfLength;
+    }
+
+    // a segment opens with a PAT, a PMT and the PES of its first sample
+    if (pDemux->nSegments < pDemux->pOut->nSegments &&
+        pDemux->Offset == pDemux->pOut->Offsets[pDemux->nSegments])
+    {
+        pDemux->nSegments++;
+        pDemux->SegmentPacket = 0;
+    }
+    if (pDemux->SegmentPacket < 3)
+    {
+        if ((pDemux->SegmentPacket == 0 && Pid != MTS_PID_PAT) ||
+            (pDemux->SegmentPacket == 1 && Pid != MTS_PID_PMT) ||
+            (pDemux->SegmentPacket == 2 &&
+             (Pid != pDemux->Pid[pDemux->pIn->SegmentTrack] || !bPusi || !bRandomAccess || !bPcr)))
+            CheckError(pDemux, "bad segment start");
+        bSegment = (pDemux->SegmentPacket == 2);
+        pDemux->SegmentPacket++;
+    }
+
+    if (Pid == MTS_PID_PAT || Pid == MTS_PID_PMT)
+    {
+        pCc = (Pid == MTS_PID_PAT) ? &pDemux->PatCc : &pDemux->PmtCc;
+        if (*pCc >= 0 && Cc != ((*pCc + 1) & 0xF))
+            CheckError(pDemux, "PSI continuity_counter skipped");
+        *pCc = Cc;
+        CheckPsi(pDemux, p, Pid);
+        return;
+    }
+
+    for (i = 0; i < MAX_TRACK; i++)
+    {
+        if (pDemux->Pid[i] && Pid == pDemux->Pid[i])
+            Track = i;
+    }
+    if (Track == MAX_TRACK)
+    {
+        CheckError(pDemux, "unknown PID");
+        return;
+    }
+    pPid = &pDemux->Pids[Track];
+
+    if (!(Afc & 0x1))
+    {
+        if (pPid->Cc >= 0 && Cc != pPid->Cc)
+            CheckError(pDemux, "continuity_counter moved without payload");
+        return;
+    }
+    if (pPid->Cc >= 0 && Cc != ((pPid->Cc + 1) & 0xF))
+        CheckError(pDemux, "continuity_counter skipped");
+    pPid->Cc = Cc;
+
+    if (bPusi)
+    {
+        if (pPid->bPes)
+            CheckPes(pDemux, Track);
+        pPid->bPes = NV_TRUE;
+        pPid->PesSize = 0;
+        pPid->bRandomAccess = bRandomAccess;
+        pPid->Segment = bSegment ? pDemux->nSegments : 0;
+        pPid->Pcr = pDemux->Pcr;
+    }
+    else if (!pPid->bPes)
+    {
+        CheckError(pDemux, "payload before the PES start");
+        return;
+    }
+    if (pPid->PesSize + MTS_PACKET_SIZE - Header > pPid->PesMax)
+    {
+        CheckError(pDemux, "PES longer than any sample");
+        pPid->bPes = NV_FALSE;
+        return;
+    }
+    NvOsMemcpy(pPid->pPes + pPid->PesSize, p + Header, MTS_PACKET_SIZE - Header);
+    pPid->PesSize += MTS_PACKET_SIZE - Header;
+}
+
+/* Walks the output of one run against the expected samples */
+static NvBool CheckDemuxOutput(const CheckStream *pStream, CheckInput *pIn, CheckOutput *pOut)
+{
+    CheckDemux Demux;
+    NvBool bOk = NV_TRUE;
+    NvU32 i;
+
+    NvOsMemset(&Demux, 0, sizeof(Demux));
+    Demux.pStream = pStream;
+    Demux.pIn = pIn;
+    Demux.pOut = pOut;
+    Demux.PatCc = -1;
+    Demux.PmtCc = -1;
+    Demux.SegmentPacket = 3;
+    Demux.Pid[VIDEO_TRACK] = pStream->bVideo ? MTS_PID_VIDEO : 0;
+    Demux.Pid[SOUND_TRACK] = pStream->bAudio ? MTS_PID_AUDIO : 0;
+    Demux.PcrTrack = pStream->bVideo ? VIDEO_TRACK : SOUND_TRACK;
+    for (i = 0; i < MAX_TRACK; i++)
+    {
+        CheckTrack *pTrack = &pIn->Tracks[i];
+
+        Demux.Pids[i].Cc = -1;
+        Demux.Pids[i].PesMax = pTrack->MaxSample + MTS_PES_HEADER_SIZE +
+                               2 * MTS_PES_TIMESTAMP_SIZE + MTS_PACKET_SIZE;
+        Demux.Pids[i].pPes = NvOsAlloc(Demux.Pids[i].PesMax);
+        if (!Demux.Pids[i].pPes)
+            bOk = NV_FALSE;
+        pTrack->nDemuxed = 0;
+    }
+
+    if (pOut->Size % MTS_PACKET_SIZE)
+    {
+        printf("%s: output is not whole packets\n", pStream->szName);
+        bOk = NV_FALSE;
+    }
+    for (Demux.Offset = 0; bOk && Demux.Offset + MTS_PACKET_SIZE <= pOut->Size;
+         Demux.Offset += MTS_PACKET_SIZE)
+        CheckPacket(&Demux, pOut->pData + Demux.Offset);
+
+    for (i = 0; i < MAX_TRACK; i++)
+    {
+        CheckTrack *pTrack = &pIn->Tracks[i];
+
+        if (bOk && Demux.Pids[i].bPes)
+            CheckPes(&Demux, i);
+        if (bOk && pTrack->nDemuxed != pTrack->nSamples)
+            CheckError(&Demux, "samples missing");
+        NvOsFree(Demux.Pids[i].pPes);
+    }
+    if (bOk && Demux.nSegments != pOut->nSegments)
+        CheckError(&Demux, "segments missing");
+
+    return bOk && !Demux.nErrors;
+}
+
+static NvBool CheckRun(const CheckStream *pStream)
+{
+    CheckInput In;
+    CheckOutput Ref, Out;
+    NvU64 Time, Bytes = 0;
+    NvBool bOk;
+    NvU32 i;
+
+    NvOsMemset(&Ref, 0, sizeof(Ref));
+    NvOsMemset(&Out, 0, sizeof(Out));
+    bOk = CheckBuild(&In, pStream);
+    if (!bOk)
+        printf("%s: out of memory\n", pStream->szName);
+
+    bOk = bOk && CheckWrite(pStream, &In, s_BufferPackets[0] * MTS_PACKET_SIZE, &Ref, &Time);
+    bOk = bOk && CheckDemuxOutput(pStream, &In, &Ref);
+
+    for (i = 1; bOk && i < NV_ARRAY_SIZE(s_BufferPackets); i++)
+    {
+        NvU64 Unused;
+
+        bOk = CheckWrite(pStream, &In, s_BufferPackets[i] * MTS_PACKET_SIZE, &Out, &Unused);
+        if (bOk && (Out.Size != Ref.Size || NvOsMemcmp(Out.pData, Ref.pData, Ref.Size) ||
+                    Out.nSegments != Ref.nSegments ||
+                    NvOsMemcmp(Out.Offsets, Ref.Offsets, Ref.nSegments * sizeof(NvU32))))
+        {
+            printf("%s: %u packet buffers give other output\n", pStream->szName, s_BufferPackets[i]);
+            bOk = NV_FALSE;
+        }
+        NvOsFree(Out.pData);
+        Out.pData = NULL;
+    }
+
+    for (i = 0; i < In.nSamples; i++)
+        Bytes += In.pSamples[i].DataSize;
+    if (bOk)
+        printf("%-24s %5u samples %3u segments %7u packets %7.1f MB/s\n", pStream->szName,
+               In.nSamples, Ref.nSegments, Ref.Size / MTS_PACKET_SIZE,
+               Time ? (double)Bytes / Time : 0.0);
+
+    NvOsFree(Ref.pData);
+    CheckFree(&In);
+    return bOk;
+}
+
+int main(int argc, char **argv)
+{
+    NvBool bOk = NV_TRUE;
+    NvU32 i;
+
+    for (i = 0; i < NV_ARRAY_SIZE(s_Streams); i++)
+        bOk = CheckRun(&s_Streams[i]) && bOk;
+
+    printf("%s\n", bOk ? "PASSED" : "FAILED");
+    return bOk ? 0 : 1;
+}
@@ -1,4 +1,4 @@
-/* Copyright (c) 2006 NVIDIA Corporation.  All rights reserved.
+/* Copyright (c) 2006-2013 NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -14,6 +14,65 @@
 #include <string.h>
 #include "nvos.h"
 
+// ISO/IEC 13818-1 transport packet
+#define MTS_PACKET_SIZE             188
+#define MTS_PACKET_HEADER_SIZE      4
+#define MTS_PACKET_PAYLOAD_SIZE     (MTS_PACKET_SIZE - MTS_PACKET_HEADER_SIZE)
+#define MTS_SYNC_BYTE               0x47
+#define MTS_PUSI_FLAG               0x40
+#define MTS_AFC_PAYLOAD_ONLY        0x10
+#define MTS_AFC_ADAPTATION_ONLY     0x20
+#define MTS_AFC_ADAPTATION_PAYLOAD  0x30
+
+// adaptation field flags
+#define MTS_AF_RANDOM_ACCESS        0x40
+#define MTS_AF_PCR                  0x10
+#define MTS_AF_PCR_SIZE             6
+
+// PIDs and program
+#define MTS_PID_PAT                 0x0000
+#define MTS_PID_PMT                 0x0100
+#define MTS_PID_VIDEO               0x0101
+#define MTS_PID_AUDIO               0x0102
+#define MTS_PROGRAM_NUMBER          1
+#define MTS_TRANSPORT_STREAM_ID     1
+
+// PSI
+#define MTS_TABLE_ID_PAT            0x00
+#define MTS_TABLE_ID_PMT            0x02
+#define MTS_PSI_CRC_SIZE            4
+
+// stream_type values of the PMT
+#define MTS_STREAM_TYPE_AAC_ADTS    0x0F
+#define MTS_STREAM_TYPE_H264        0x1B
+
+// PES
+#define MTS_PES_STREAM_ID_VIDEO     0xE0
+#define MTS_PES_STREAM_ID_AUDIO     0xC0
+#define MTS_PES_HEADER_SIZE         9
+#define MTS_PES_TIMESTAMP_SIZE      5
+#define MTS_PES_MAX_LENGTH          0xFFFF
+
+// system clock: PTS/DTS tick at 90 kHz, PCR at 27 MHz
+#define MTS_CLOCK_90KHZ             90000
+#define MTS_PCR_PER_90KHZ           300
+#define MTS_TIMESTAMP_MASK          0x1FFFFFFFFULL
+#define MTS_100NS_TO_90KHZ(t)       ((t) * 9 / 1000)
+
+// H.264 NAL unit types
+#define MTS_NAL_TYPE_MASK           0x1F
+#define MTS_NAL_SLICE               1
+#define MTS_NAL_IDR                 5
+#define MTS_NAL_SPS                 7
+#define MTS_NAL_PPS                 8
+#define MTS_NAL_AUD                 9
+#define MTS_START_CODE_SIZE         4
+#define MTS_AUD_SIZE                6
+
+// AAC
+#define MTS_ADTS_HEADER_SIZE        7
+#define MTS_AAC_OBJECT_LC           2
+#define MTS_AAC_OBJECT_SBR          5
 
 #endif //INCLUDED_NV_MTSWRITER_DEFINES_H
 
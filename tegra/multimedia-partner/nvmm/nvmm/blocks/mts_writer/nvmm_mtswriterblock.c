@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007 NVIDIA Corporation.  All rights reserved.
+ * Copyright (c) 2007-2013 NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -9,162 +9,581 @@
  */
 
 /*
- * This NvMM block is provided as a reference to block writers. As such it
- * is a demonstration of correct semantics. Implementation of so called
- * "custom blocks" may vary.
- * Note that the calls on the reference block are serviced synchronously.
- * This is by design. A layer leveraging the Transport API operates between
- * the client and the block. Transparently to the block implementation, this
- * layer provides a block worker thread and makes all calls to the block
- * on this thread. Synchronous operation, e.g. without the Transport API as
- * a middleman, is also possible using the same code. The block need not
- * concern itself with the context under which it is run, any threading, or
- * messages. The block need only service calls synchronously and the rest
- * will be taken care of by whatever has created it, e.g. the transport API.
+ * Core writer for MPEG-2 transport streams (.ts, .m2ts, .mts), driven by
+ * the base writer block like the 3gp writer. Samples are packetized by the
+ * MTS writer library straight into an output buffer of whole transport
+ * packets, which is written to the file each time it fills up.
+ *
+ * With a segment duration set, the stream is split on video sync frames and
+ * every segment goes to its own file: the first one to the file name given,
+ * the following ones to the name given with NvMMWriterAttribute_SplitTrack
+ * or, without one, to the file name with "_<segment number>" added in front
+ * of the extension.
  */
 
-
-#include "nvmm.h"
-#include "nvmm_event.h"
-#include "nvrm_transport.h"
-#include "nvmm_block.h"
-#include "nvmm_queue.h"
-#include "nvassert.h"
-#include "nvos.h"
-#include "nvmm_debug.h"
 #include "nvmm_util.h"
-#include "nvlocalfilecontentpipe.h"
 #include "nvmm_basewriterblock.h"
 #include "nvmm_mtswriterblock.h"
 #include "nv_mts_writer.h"
+#include "nvmm_contentpipe.h"
 
+#define NVLOG_CLIENT NVLOG_MP4_WRITER
 
 #define NVMM_MTSWRITER_MAX_TRACKS 2
-#define NVMM_MTSWRITER_WORK_BUFFER_SIZE (400*1024)
-#define TICKS_PER_SECOND 1000000
-// Buffer Sizes
-#define MAX_CHANNELS          6    /* can be set to 1 for a mono encoder */
+// 1024 transport packets, written to the file at once
+#define NVMM_MTSWRITER_OUTPUT_BUFFER_SIZE (MTS_PACKET_SIZE * 1024)
+// can be set to 1 for a mono encoder
+#define MAX_AAC_CHANNELS 6
+#define MAX_BYTES_PER_AAC_CHANNEL 768
+#define AACPLUS_ENC_OUT_BUF_SIZE (MAX_BYTES_PER_AAC_CHANNEL * MAX_AAC_CHANNELS)
+#define VIDEO_ENC_MAX_OUTPUT_BUFFERS 5
+#define VIDEO_ENC_MIN_OUTPUT_BUFFERS 3
+#define MIN_RAW_YUV_BUFFER (32*1024)
+#define MAX_SEGMENT_NUMBER_LEN 11
 
-#define VIDEOENC_MAX_OUTPUT_BUFFERS 5
-#define VIDEOENC_MIN_OUTPUT_BUFFERS 3
-
-typedef enum NvMMmtsWriterState
+typedef struct NvMMMtsWriterStreamInfoRec
 {
-    WRITER_INIT,
-    WRITER_DATA,
-    WRITER_EOS
-} NvMMmtsWriterState;
+    NvMMWriterStreamConfig StreamConfig;
+    //Maximum supported buffer size in bytes
+    NvU32 MaxBufferSize;
+} NvMMMtsWriterStreamInfo;
 
+// Context for mts writer block
+typedef struct NvMMMtsWriterBlockContextRec
+{
+    NvMMMtsWriterStreamInfo StreamInfo[NVMM_MTSWRITER_MAX_TRACKS];
+    NvU32 StreamIndex;
+    CPhandle CpHandle;
+    CP_PIPETYPE_EXTENDED *pPipe;
+    // Params for MTS core library
+    NvMMMtsMuxInputParam InputParam;
+    NvMMMtsMuxContext ContextMtsMux;
+    NvMMMtsAVParam AVParam;
+    NvU8 *pOutputBuffer;
+    NvU32 OutputOffset;
+    NvBool InitMts;
+    NvBool AudioPresent;
+    NvBool VideoPresent;
+    NvBool EndOfMux;
+    char *FileURI;
+    char *SegmentURI;
+    char *NextSegmentURI;
+    NvU64 CurrentFileSize;
+    NvU64 MaxFileSizeLimit;
+    NvU64 AudioFrameCount;
+    NvU64 VideoFrameCount;
+    NvBool FileSizeExceeded;
+} NvMMMtsWriterBlockContext;
 
-typedef struct NvMMMTSWriterStreamInfo
+static NvError
+NvMMMtsWriterBlockGetBufferRequirements(
+    NvmmWriterContext WriterContext,
+    NvU32 StreamIndex,
+    NvU32 *pMinBuffers,
+    NvU32 *pMaxBuffers,
+    NvU32 *pMinBufferSize,
+    NvU32 *pMaxBufferSize)
 {
-  NvMMWriterStreamConfig streamConfig;
-  NvMMmtsWriterState streamState;
-} NvMMMTSWriterStreamInfo;
+    NvError Status = NvSuccess;
+    NvMMMtsWriterBlockContext *pContext = NULL;
+    NvMMWriterStreamConfig *streamConfig = NULL;
+
+    NVMM_CHK_ARG(
+        WriterContext &&
+        pMinBuffers &&
+        pMaxBuffers &&
+        pMinBufferSize &&
+        pMaxBufferSize);
+
+    pContext = (NvMMMtsWriterBlockContext *)WriterContext;
+    NVMM_CHK_ARG(StreamIndex < NVMM_MTSWRITER_MAX_TRACKS);
+    streamConfig = &pContext->StreamInfo[StreamIndex].StreamConfig;
 
+    switch (streamConfig->StreamType)
+    {
+        case NvMMStreamType_AAC:
+        case NvMMStreamType_AACSBR:
+        {
+            *pMinBuffers = 1;
+            *pMaxBuffers = NVMMSTREAM_MAXBUFFERS;
+            *pMinBufferSize = AACPLUS_ENC_OUT_BUF_SIZE;
+            *pMaxBufferSize = AACPLUS_ENC_OUT_BUF_SIZE;
+        }
+        break;
+        case NvMMStreamType_H264:
+        {
+            *pMinBuffers = VIDEO_ENC_MIN_OUTPUT_BUFFERS;
+            *pMaxBuffers = VIDEO_ENC_MAX_OUTPUT_BUFFERS;
+            // Encoded frame sizes are not bounded, allow for a raw YUV 4:2:0 frame
+            *pMinBufferSize = NV_MAX(MIN_RAW_YUV_BUFFER,
+                (streamConfig->NvMMWriter_Config.VideoConfig.width *
+                streamConfig->NvMMWriter_Config.VideoConfig.height*3)/2);
+            *pMaxBufferSize = *pMinBufferSize;
+        }
+        break;
+        default:
+            Status = NvError_WriterUnsupportedStream;
+        break;
+    }
+    if (Status == NvSuccess)
+        pContext->StreamInfo[StreamIndex].MaxBufferSize = *pMaxBufferSize;
 
-/** Context for MTS writer block.
+cleanup:
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_ERROR, "--NvMMMtsWriterBlockGetBufferRequirements ::Status ->%x \n",Status));
+    return Status;
+}
 
-*/
-typedef struct
+static NvError
+NvMMMtsWriterSetStreamConfig(
+    NvmmWriterContext WriterContext,
+    NvMMWriterStreamConfig *pConfig)
 {
-    NvMMBaseWriterBlockContext *block; //!< NvMMBlock base class, must be first member to allow down-casting
-    NvString szFilename;
-    //NvMM3GPWriterStreamInfo streamInfo[NVMM_3GPWRITER_MAX_TRACKS];
-    NvS32 streamIndex;
-    CPhandle cphandle;
-    CP_PIPETYPE_EXTENDED *pPipe;
-    // Params for MTS core library
-    structInpParam oInputParam;
-    tmem           omtsMem;
-    structSVParam  oSVParam;
-    // First Video frame Timestamp
-    NvU64     uFirstFrameTimeStamp;
-    NvU32 nBufferSize;
-    NvU32 nPageSize;
-    NvU32 nBufferDataSize;
-    NvU8 *pmtsBufferAlloc;
-    NvU8 *pmtsBuffer;
-    NvBool bmtsInitialized;
-    NvBool audioPresent;
-    NvBool videoPresent;
-} NvMMmtsWriterBlockContext;
+    NvError Status = NvSuccess;
+    NvMMMtsWriterBlockContext* pContext = NULL;
+    NvMMMP4WriterAudioConfig *AudConfig = NULL;
 
-/*
- * INTERNAL TYPEDEFS/DEFINES
- *
- * A custom block may use these values to the extent
- * that its implementation resembles the reference.
- * Even so, the values will likely differ in a custom
- * block.
- */
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_INFO, "++NvMMMtsWriterSetStreamConfig \n"));
+    NVMM_CHK_ARG(WriterContext && pConfig);
+    pContext = (NvMMMtsWriterBlockContext *)WriterContext;
+    NVMM_CHK_ARG(pContext->StreamIndex < NVMM_MTSWRITER_MAX_TRACKS);
+    // streams can't be added once the PMT is out
+    NVMM_CHK_ARG(!pContext->InitMts);
 
-// prototypes for  implementation of mts writer functions
-NvError NvMMmtsWriterSetStreamConfig(NvMMBlockHandle hBlock, NvMMWriterStreamConfig *pConfig);
-NvError NvMMmtsWriterSetUserData(NvMMBlockHandle hBlock, NvMMWriteUserDataConfig *pConfig);
-NvError NvMMmtsWriterAddMediaSample(NvMMBlockHandle hBlock, NvU32 streamIndex, NvMMBuffer *pBuffer);
-NvError NvMMmtsOpenWriter(NvMMBlockHandle hBlock, NvString pURI);
-NvError NvMMmtsCloseWriter(NvMMBlockHandle hBlock);
-NvBool  NvMMmtsWriterBlockGetBufferRequirements( NvMMBlockHandle hBlock,
-                                                 NvU32 StreamIndex,
-                                                 NvU32 Retry,
-                                                 NvMMNewBufferRequirementsInfo *pBufReq);
+    switch (pConfig->StreamType)
+    {
+        case NvMMStreamType_H264:
+        {
+            NVMM_CHK_ARG(!pContext->VideoPresent);
+            pContext->VideoPresent = NV_TRUE;
+        }
+        break;
+        case NvMMStreamType_AAC:
+        case NvMMStreamType_AACSBR:
+        {
+            NVMM_CHK_ARG(!pContext->AudioPresent);
+            AudConfig = &pConfig->NvMMWriter_Config.AudioConfig;
+            pContext->InputParam.AacObjectType = AudConfig->NvMMWriter_AudConfig.AACAudioConfig.aacObjectType;
+            pContext->InputParam.AacSamplingFreqIndex = AudConfig->NvMMWriter_AudConfig.AACAudioConfig.aacSamplingFreqIndex;
+            pContext->InputParam.AacChannelNumber = AudConfig->NvMMWriter_AudConfig.AACAudioConfig.aacChannelNumber;
+            pContext->AudioPresent = NV_TRUE;
+        }
+        break;
+        default:
+        {
+            NVMM_CHK_ERR(NvError_WriterUnsupportedStream);
+        }
+        break;
+    }
 
+    NvOsMemcpy(
+        &pContext->StreamInfo[pContext->StreamIndex].StreamConfig,
+        pConfig,
+        sizeof(NvMMWriterStreamConfig));
+    pContext->StreamIndex++;
 
+cleanup:
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_INFO, "--NvMMMtsWriterSetStreamConfig \n"));
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_ERROR, "--NvMMMtsWriterSetStreamConfig ->%x\n",Status));
+    return Status;
+}
 
-/**
- *  Constructor for the block which is used by NvMMOpenBlock.
- */
-NvError NvMMmtsWriterBlockOpen(NvMMBlockHandle *phBlock,
-                               NvMMInternalCreationParameters *pParams,
-                               NvOsSemaphoreHandle BlockEventSema,
-                               NvMMDoWorkFunction *pDoWorkFunction)
+static NvError
+NvMMMtsStoreFileUri(
+    char **ExistingFileUri,
+    const char *NewFileUri)
 {
-    NvError status = NvSuccess;
-    return status;
+    NvError Status = NvSuccess;
+
+    if(!(*ExistingFileUri) ||
+        (NvOsStrlen(NewFileUri) >
+         NvOsStrlen(*ExistingFileUri)))
+    {
+        if(*ExistingFileUri)
+            NvOsFree(*ExistingFileUri);
+        *ExistingFileUri =(char *) NvOsAlloc(NvOsStrlen(NewFileUri) + 1);
+        NVMM_CHK_MEM(*ExistingFileUri);
+    }
+    NvOsStrncpy(*ExistingFileUri, NewFileUri, NvOsStrlen(NewFileUri) + 1);
+
+cleanup:
+    return Status;
 }
 
-NvBool  NvMMmtsWriterBlockGetBufferRequirements(NvMMBlockHandle hBlock,
-                                                NvU32 StreamIndex,
-                                                NvU32 Retry,
-                                                NvMMNewBufferRequirementsInfo *pBufReq)
+/* Names segment n of "dir/name.ext" "dir/name_n.ext". */
+static NvError
+NvMMMtsMakeSegmentUri(
+    NvMMMtsWriterBlockContext *pContext,
+    NvU32 Segment)
 {
-    return NV_TRUE;
+    NvError Status = NvSuccess;
+    const char *pExt = NULL;
+    const char *p = NULL;
+    NvU32 StemLen = 0;
+    NvU32 Size = 0;
+
+    for (p = pContext->FileURI; *p; p++)
+    {
+        if (*p == '.')
+            pExt = p;
+        else if (*p == '/')
+            pExt = NULL;
+    }
+    if (!pExt)
+        pExt = p;
+    StemLen = (NvU32)(pExt - pContext->FileURI);
+
+    Size = NvOsStrlen(pContext->FileURI) + MAX_SEGMENT_NUMBER_LEN + 1;
+    NvOsFree(pContext->SegmentURI);
+    pContext->SegmentURI = (char *)NvOsAlloc(Size);
+    NVMM_CHK_MEM(pContext->SegmentURI);
+
+    NvOsMemcpy(pContext->SegmentURI, pContext->FileURI, StemLen);
+    NvOsSnprintf(pContext->SegmentURI + StemLen, Size - StemLen, "_%u%s", Segment, pExt);
+
+cleanup:
+    return Status;
 }
 
+static NvError
+NvMMMtsWriterFlush(
+    NvMMMtsWriterBlockContext *pContext)
+{
+    NvError Status = NvSuccess;
+
+    if (!pContext->OutputOffset)
+        return NvSuccess;
+
+    if (pContext->CurrentFileSize + pContext->OutputOffset > pContext->MaxFileSizeLimit)
+    {
+        pContext->FileSizeExceeded = NV_TRUE;
+        NVMM_CHK_ERR(NvError_WriterFileWriteLimitExceeded);
+    }
+
+    NVMM_CHK_ERR((NvError)pContext->pPipe->cpipe.Write(
+        pContext->CpHandle,
+        (CPbyte *)pContext->pOutputBuffer,
+        (CPuint)pContext->OutputOffset));
+    pContext->CurrentFileSize += pContext->OutputOffset;
+    pContext->OutputOffset = 0;
+
+cleanup:
+    return Status;
+}
+
+static NvError
+NvMMMtsWriterInit(
+    NvMMMtsWriterBlockContext *pContext)
+{
+    NvError Status = NvSuccess;
+
+    NVMM_CHK_MEM(pContext->FileURI);
+    NVMM_CHK_ARG(pContext->AudioPresent || pContext->VideoPresent);
 
-/** Close function which is called by NvMMCloseBlock().
+    if (!pContext->pOutputBuffer)
+    {
+        pContext->pOutputBuffer = NvOsAlloc(NVMM_MTSWRITER_OUTPUT_BUFFER_SIZE);
+        NVMM_CHK_MEM(pContext->pOutputBuffer);
+    }
+    pContext->OutputOffset = 0;
 
-    If possible block will be closed here, otherwise it will be marked for close.
-    Block will be closed whenever possible in future.
-*/
-void NvMMmtsWriterBlockClose(NvMMBlockHandle hBlock,
-                             NvMMInternalDestructionParameters *pParams)
+    pContext->InputParam.AudioPresent = pContext->AudioPresent;
+    pContext->InputParam.VideoPresent = pContext->VideoPresent;
+    if (SUCCESS != NvMM_MTSWriteInit(&pContext->InputParam, &pContext->ContextMtsMux))
+    {
+        NVMM_CHK_ERR(NvError_WriterInitFailure);
+    }
+
+    NVMM_CHK_ERR((NvError)pContext->pPipe->cpipe.Open(&pContext->CpHandle,
+        pContext->FileURI, CP_AccessWrite));
+    pContext->CurrentFileSize = 0;
+
+cleanup:
+    if (Status != NvSuccess)
+        (void)NvMM_MTSWriteClose(&pContext->InputParam, &pContext->ContextMtsMux);
+    return Status;
+}
+
+/* Finishes the current segment file and opens the one for the next segment. */
+static NvError
+NvMMMtsWriterNextSegment(
+    NvMMMtsWriterBlockContext *pContext)
 {
-     NvMMBlockTryClose(hBlock);
+    NvError Status = NvSuccess;
+    NvU32 Segment = NvMM_MTSWriteGetSegmentCount(pContext->ContextMtsMux);
+
+    NVMM_CHK_ERR(NvMMMtsWriterFlush(pContext));
+    if (pContext->CpHandle)
+    {
+        (void)pContext->pPipe->cpipe.Close(pContext->CpHandle);
+        pContext->CpHandle = 0;
+    }
+
+    if (pContext->NextSegmentURI)
+    {
+        NVMM_CHK_ERR(NvMMMtsStoreFileUri(&pContext->SegmentURI, pContext->NextSegmentURI));
+        NvOsFree(pContext->NextSegmentURI);
+        pContext->NextSegmentURI = NULL;
+    }
+    else
+    {
+        NVMM_CHK_ERR(NvMMMtsMakeSegmentUri(pContext, Segment));
+    }
+
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_DEBUG, "NvMMMtsWriterNextSegment: %s\n",
+        pContext->SegmentURI));
+    NVMM_CHK_ERR((NvError)pContext->pPipe->cpipe.Open(&pContext->CpHandle,
+        pContext->SegmentURI, CP_AccessWrite));
+    pContext->CurrentFileSize = 0;
+
+cleanup:
+    return Status;
 }
 
-NvError NvMMmtsOpenWriter(NvMMBlockHandle hBlock, NvString szURI)
+static NvError
+NvMMMtsWriterAddMediaSample(
+    NvmmWriterContext WriterContext,
+    NvU32 streamIndex,
+    NvMMBuffer *pBuffer)
 {
-    NvError status = NvSuccess;
-    return status;
+    NvError Status = NvSuccess;
+    NvMMMtsWriterBlockContext* pContext = NULL;
+    NvMMStreamType StreamType = NvMMStreamType_OTHER;
+    NvS16 MuxStatus = SUCCESS;
+
+    NVMM_CHK_ARG(WriterContext && pBuffer);
+    pContext = (NvMMMtsWriterBlockContext *)WriterContext;
+    NVMM_CHK_ARG(streamIndex < pContext->StreamIndex);
+    NVMM_CHK_ARG(!pContext->EndOfMux);
+
+    if (NV_FALSE == pContext->InitMts)
+    {
+        NVMM_CHK_ERR(NvMMMtsWriterInit(pContext));
+        pContext->InitMts = NV_TRUE;
+    }
+
+    StreamType = pContext->StreamInfo[streamIndex].StreamConfig.StreamType;
+    pContext->AVParam.pData = (NvU8 *)pBuffer->Payload.Ref.pMem;
+    pContext->AVParam.DataSize = pBuffer->Payload.Ref.sizeOfValidDataInBytes;
+    pContext->AVParam.PTS = pBuffer->PayloadInfo.TimeStamp;
+    // the encoders don't reorder, decode order is presentation order
+    pContext->AVParam.DTS = pBuffer->PayloadInfo.TimeStamp;
+    if (NVMM_ISSTREAMVIDEO(StreamType))
+    {
+        pContext->AVParam.Track = VIDEO_TRACK;
+        pContext->AVParam.IsSyncFrame = pBuffer->PayloadInfo.BufferMetaData.VideoEncMetadata.KeyFrame;
+        pContext->VideoFrameCount++;
+    }
+    else
+    {
+        pContext->AVParam.Track = SOUND_TRACK;
+        pContext->AVParam.IsSyncFrame = NV_TRUE;
+        pContext->AudioFrameCount++;
+    }
+
+    for (;;)
+    {
+        MuxStatus = NvMM_MTSWriteRun(
+            &pContext->AVParam,
+            &pContext->InputParam,
+            pContext->pOutputBuffer,
+            NVMM_MTSWRITER_OUTPUT_BUFFER_SIZE,
+            &pContext->OutputOffset,
+            pContext->ContextMtsMux);
+
+        if (SUCCESS == MuxStatus)
+            break;
+        else if (MTS_OUTPUT_BUFFER_FULL == MuxStatus)
+        {
+            NVMM_CHK_ERR(NvMMMtsWriterFlush(pContext));
+        }
+        else if (MTS_SEGMENT_BOUNDARY == MuxStatus)
+        {
+            NVMM_CHK_ERR(NvMMMtsWriterNextSegment(pContext));
+        }
+        else
+        {
+            NVMM_CHK_ERR(NvError_WriterFailure);
+        }
+    }
+
+cleanup:
+    if (NvSuccess != Status)
+    {
+        NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_ERROR, "NvMMMtsWriterAddMediaSample ->%x\n", Status));
+        pContext->EndOfMux = NV_TRUE;
+    }
+    if (pContext && pContext->FileSizeExceeded)
+        Status = NvError_WriterFileWriteLimitExceeded;
+    return Status;
 }
 
+static NvError
+NvMMMtsCloseWriter(
+    NvmmWriterContext WriterContext)
+{
+    NvError Status = NvSuccess;
+    NvMMMtsWriterBlockContext* pContext = NULL;
+
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_INFO, "++NvMMMtsCloseWriter \n"));
+    NVMM_CHK_ARG(WriterContext);
+    pContext = (NvMMMtsWriterBlockContext *)WriterContext;
 
-NvError NvMMmtsWriterSetStreamConfig(NvMMBlockHandle hBlock, NvMMWriterStreamConfig *pConfig)
+    if (pContext->InitMts)
+    {
+        // a transport stream ends with its last packet, there is no trailer
+        if (!pContext->FileSizeExceeded)
+            Status = NvMMMtsWriterFlush(pContext);
+        (void)NvMM_MTSWriteClose(&pContext->InputParam, &pContext->ContextMtsMux);
+        pContext->InitMts = NV_FALSE;
+    }
+    if (pContext->CpHandle)
+    {
+        (void)pContext->pPipe->cpipe.Close(pContext->CpHandle);
+        pContext->CpHandle = 0;
+    }
+
+    NvOsFree(pContext->pOutputBuffer);
+    NvOsFree(pContext->FileURI);
+    NvOsFree(pContext->SegmentURI);
+    NvOsFree(pContext->NextSegmentURI);
+    NvOsFree(pContext);
+
+cleanup:
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_INFO, "--NvMMMtsCloseWriter \n"));
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_ERROR, "--NvMMMtsCloseWriter->%x \n",Status));
+    return Status;
+}
+
+static NvError
+NvMMMtsGetAttribute(
+    NvmmWriterContext WriterContext,
+    NvU32 AttributeType,
+    void *pAttribute)
 {
-    NvError status = NvSuccess;
-    return status;
+    NvError Status = NvSuccess;
+    NvMMMtsWriterBlockContext *pMtsWriterContext = NULL;
+
+    NVMM_CHK_ARG(WriterContext && pAttribute);
+    pMtsWriterContext = (NvMMMtsWriterBlockContext *)WriterContext;
+    switch (AttributeType)
+    {
+        case NvMMWriterAttribute_FrameCount:
+        {
+            ((NvMMWriterAttrib_FrameCount*)pAttribute)->audioFrameCount =
+                pMtsWriterContext->AudioFrameCount;
+            ((NvMMWriterAttrib_FrameCount*)pAttribute)->videoFrameCount =
+                pMtsWriterContext->VideoFrameCount;
+        }
+        break;
+        default:
+        break;
+    }
+cleanup:
+    return Status;
 }
 
+static NvError
+NvMMMtsSetAttribute(
+    NvmmWriterContext WriterContext,
+    NvU32 AttributeType,
+    void *pAttribute)
+{
+    NvError Status = NvSuccess;
+    NvMMMtsWriterBlockContext *pMtsWriterContext = NULL;
+
+    NVMM_CHK_ARG(WriterContext && pAttribute);
+    pMtsWriterContext = (NvMMMtsWriterBlockContext *)WriterContext;
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_INFO, "++NvMMMtsSetAttribute\n"));
 
-NvError NvMMmtsWriterAddMediaSample(NvMMBlockHandle hBlock, NvU32 streamIndex, NvMMBuffer *pBuffer)
+    switch(AttributeType)
+    {
+        case NvMMWriterAttribute_FileName:
+        {
+            NVMM_CHK_ERR(NvMMMtsStoreFileUri(&pMtsWriterContext->FileURI,
+                (char *)((NvMMWriterAttrib_FileName*)pAttribute)->szURI));
+        }
+        break;
+        case NvMMWriterAttribute_StreamConfig:
+        {
+            NVMM_CHK_ERR(NvMMMtsWriterSetStreamConfig(WriterContext,
+                (NvMMWriterStreamConfig*)pAttribute));
+        }
+        break;
+        case NvMMWriterAttribute_FileSize:
+        {
+            pMtsWriterContext->MaxFileSizeLimit =
+                ((NvMMWriterAttrib_FileSize *)pAttribute)->maxFileSize;
+        }
+        break;
+        case NvMMWriterAttribute_SplitTrack:
+        {
+            // the next segment goes to this file, starting on the next sync frame
+            NVMM_CHK_ERR(NvMMMtsStoreFileUri(&pMtsWriterContext->NextSegmentURI,
+                ((NvMMWriterAttrib_SplitTrack *)pAttribute)->fileName));
+            pMtsWriterContext->InputParam.SegmentRequest = NV_TRUE;
+        }
+        break;
+        case NvMMWriterAttribute_SegmentDuration:
+        {
+            // msec to 100 ns units
+            pMtsWriterContext->InputParam.SegmentDuration =
+                ((NvMMWriterAttrib_SegmentDuration *)pAttribute)->segmentDuration * 10000;
+        }
+        break;
+        default:
+        break;
+    }
+cleanup:
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_INFO, "--NvMMMtsSetAttribute\n"));
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_ERROR, "--NvMMMtsSetAttribute ->%x\n",Status));
+    return Status;
+}
+
+static NvError
+NvMMMtsOpenWriter(
+    NvmmWriterContext WriterContext)
 {
-    NvError status = NvSuccess;
-    return status;
+    NvError Status = NvSuccess;
+    NvMMMtsWriterBlockContext* pMtsWriterBlockContext = NULL;
+
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_INFO, "++NvMMMtsOpenWriter\n"));
+    NVMM_CHK_ARG(WriterContext);
+    pMtsWriterBlockContext = (NvMMMtsWriterBlockContext *)WriterContext;
+
+    NvmmGetFileContentPipe(&pMtsWriterBlockContext->pPipe);
+    NVMM_CHK_ARG(pMtsWriterBlockContext->pPipe);
+
+cleanup:
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_INFO, "--NvMMMtsOpenWriter\n"));
+    NV_LOGGER_PRINT((NVLOG_MP4_WRITER, NVLOG_ERROR, "--NvMMMtsOpenWriter ->%x\n",Status));
+    return Status;
 }
 
+NvError
+NvMMCreateMtsWriterContext(
+    NvmmCoreWriterOps *CoreWriterOps,
+    NvmmWriterContext *pWriterHandle)
+{
+    NvError Status = NvSuccess;
+    NvMMMtsWriterBlockContext* pMtsWriterBlockContext = NULL;
+
+    NVMM_CHK_ARG(CoreWriterOps && pWriterHandle);
 
+    // Populate writer
+    CoreWriterOps->OpenWriter = NvMMMtsOpenWriter;
+    CoreWriterOps->CloseWriter = NvMMMtsCloseWriter;
+    CoreWriterOps->ProcessRawBuffer = NvMMMtsWriterAddMediaSample;
+    CoreWriterOps->GetBufferRequirements = NvMMMtsWriterBlockGetBufferRequirements;
+    CoreWriterOps->GetAttribute = NvMMMtsGetAttribute;
+    CoreWriterOps->SetAttribute = NvMMMtsSetAttribute;
 
+    pMtsWriterBlockContext = (NvMMMtsWriterBlockContext *)NvOsAlloc(sizeof(NvMMMtsWriterBlockContext));
+    NVMM_CHK_MEM(pMtsWriterBlockContext);
+    NvOsMemset(pMtsWriterBlockContext, 0, sizeof(NvMMMtsWriterBlockContext));
 
+    pMtsWriterBlockContext->MaxFileSizeLimit = (NvU64)-1;
 
+    *pWriterHandle = (NvmmWriterContext )pMtsWriterBlockContext;
+cleanup:
+    return Status;
+}
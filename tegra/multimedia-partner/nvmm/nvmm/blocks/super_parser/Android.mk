@@ -12,6 +12,7 @@ LOCAL_SRC_FILES += parser_core/mp3/nvmm_mp3parser_core.c
 LOCAL_SRC_FILES += parser_core/mp3/nvmm_mp3parser.c
 LOCAL_SRC_FILES += parser_core/mp4/nvmm_mp4parser_core.c
 LOCAL_SRC_FILES += parser_core/mp4/nv_mp4parser.c
+LOCAL_SRC_FILES += parser_core/mp4/nv_mp4_sampleindex.c
 LOCAL_SRC_FILES += parser_core/ogg/nvmm_oggparser_core.c
 LOCAL_SRC_FILES += parser_core/ogg/nvmm_oggparser.c
 LOCAL_SRC_FILES += parser_core/ogg/nvmm_oggbookunpack.c
@@ -36,3 +37,20 @@ LOCAL_SRC_FILES += parser_core/mps/nvmm_mps_reader.c
 LOCAL_CFLAGS += -Wno-error=enum-compare
 include $(NVIDIA_STATIC_LIBRARY)
 
+
+include $(NVIDIA_DEFAULTS)
+include $(LOCAL_PATH)/../../Android.common.mk
+
+LOCAL_MODULE := nv_mp4parser_seek_check
+LOCAL_MODULE_TAGS := nvidia_tests
+
+LOCAL_C_INCLUDES += $(TEGRA_TOP)/multimedia-partner/openmax/include/openmax/il
+
+LOCAL_SRC_FILES += parser_core/mp4/nv_mp4parser_seek_check.c
+
+LOCAL_STATIC_LIBRARIES += libnv_parser
+LOCAL_SHARED_LIBRARIES += libnvos
+LOCAL_SHARED_LIBRARIES += libnvmm_utils
+LOCAL_SHARED_LIBRARIES += libnvmm_contentpipe
+
+include $(NVIDIA_EXECUTABLE)
@@ -3922,6 +3922,10 @@ NvMMSuperParserBlockGetAttribute(NvMMBlockHandle hBlock,
             Status = NvError_ParserFailure;                        
         break;
 
+    case NvMMAttribute_SeekStats:
+        // Filled in by the core above
+        break;
+
     default:
         // Handle unknown attribute types in base class
         Status = NvMMBlockGetAttribute(hBlock, AttributeType, AttributeSize, pAttribute);
@@ -112,6 +112,7 @@ Mp3CoreParserOpen (
     NvU64 TotalTrackTime    = 0;
     NvMMMp3ParserCoreContext *pContext = NULL;
     NvU32 MetaDataInterval = 0;
+    NvBool MapContent = NV_TRUE;
 
     NVMM_CHK_ARG (hParserCore && pFilePath);
 
@@ -137,6 +138,12 @@ Mp3CoreParserOpen (
 
     if (hParserCore->bUsingCachedCP)
     {
+        // Outside ULP mode the data is only touched by the CPU, so the pipe
+        // may serve it from a mapping of the file instead of its cache pool
+        if (!hParserCore->bEnableUlpMode && pContext->Parser.pPipe->SetConfig)
+        {
+            (void)pContext->Parser.pPipe->SetConfig (pContext->Parser.hContentPipe, CP_ConfigIndexMapContent, &MapContent);
+        }
         NVMM_CHK_ERR (pContext->Parser.pPipe->InitializeCP (pContext->Parser.hContentPipe,
                 hParserCore->MinCacheSize,
                 hParserCore->MaxCacheSize,
@@ -0,0 +1,866 @@
+/*
+ * Copyright (c) 2013 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software and related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+#include "nv_mp4_sampleindex.h"
+#include "nvmm_common.h"
+#include "nvutil.h"
+
+#define NVMP4_SAMPLE_INDEX_MAGIC    MP4_FOURCC('N', 'V', 'S', 'I')
+#define NVMP4_SAMPLE_INDEX_VERSION  1
+#define NVMP4_SAMPLE_INDEX_PATH_LEN 256
+
+/* Header of the sidecar file, followed by CheckpointCount checkpoints */
+typedef struct NvMp4SampleIndexSidecarHeaderRec
+{
+    NvU32 Magic;
+    NvU32 Version;
+    NvU64 FileSize;
+    NvU64 FileMtime;
+    NvU32 TrackID;
+    NvU32 SampleCount;
+    NvU32 PageShift;
+    NvU32 CheckpointSize;
+    NvU32 CheckpointCount;
+} NvMp4SampleIndexSidecarHeader;
+
+/* Sequential reader over a run-length encoded array */
+typedef struct Mp4RunCursorRec
+{
+    const NvMp4SampleIndexRun *pRun;
+    NvU32 RunCount;
+    NvU32 Run;
+    NvU32 Used;
+} Mp4RunCursor;
+
+static void
+Mp4RunCursorInit (
+    Mp4RunCursor *pCursor,
+    const NvMp4SampleIndexRun *pRun,
+    NvU32 RunCount)
+{
+    pCursor->pRun = pRun;
+    pCursor->RunCount = RunCount;
+    pCursor->Run = 0;
+    pCursor->Used = 0;
+}
+
+static NvU32
+Mp4RunCursorNext (
+    Mp4RunCursor *pCursor)
+{
+    NvU32 Value;
+
+    if (pCursor->Run >= pCursor->RunCount)
+        return 0;
+
+    Value = pCursor->pRun[pCursor->Run].Value;
+    if (++pCursor->Used >= pCursor->pRun[pCursor->Run].Count)
+    {
+        pCursor->Run++;
+        pCursor->Used = 0;
+    }
+    return Value;
+}
+
+static void
+Mp4RunAppend (
+    NvMp4SampleIndexRun *pRun,
+    NvU32 *pRunCount,
+    NvU32 Value)
+{
+    if (*pRunCount && pRun[*pRunCount - 1].Value == Value)
+    {
+        pRun[*pRunCount - 1].Count++;
+    }
+    else
+    {
+        pRun[*pRunCount].Value = Value;
+        pRun[*pRunCount].Count = 1;
+        (*pRunCount)++;
+    }
+}
+
+static void
+Mp4TableReaderInit (
+    NvMp4TableReader *pReader,
+    NvU64 EntryOffset,
+    NvU32 EntrySize,
+    NvU32 EntryCount)
+{
+    pReader->EntryOffset = EntryOffset;
+    pReader->EntrySize = EntrySize;
+    pReader->EntryCount = EntryCount;
+    pReader->WindowStart = 0;
+    pReader->WindowCount = 0;
+}
+
+/* Returns a pointer to the big-endian bytes of table entry Entry */
+static NvError
+Mp4TableReaderGet (
+    NvMp4SampleIndex *pIndex,
+    NvMp4TableReader *pReader,
+    NvU32 Entry,
+    NvU8 **ppEntry)
+{
+    NvError Status = NvSuccess;
+    NvU32 Count;
+
+    if (Entry >= pReader->EntryCount)
+    {
+        return NvError_ParserCorruptedStream;
+    }
+
+    if (Entry < pReader->WindowStart || Entry >= pReader->WindowStart + pReader->WindowCount)
+    {
+        Count = NVMP4_SAMPLE_INDEX_WINDOW_BYTES / pReader->EntrySize;
+        if (Count > pReader->EntryCount - Entry)
+            Count = pReader->EntryCount - Entry;
+
+        pReader->WindowCount = 0;
+        NVMM_CHK_CP (pIndex->pPipe->SetPosition64 (pIndex->hContentPipe,
+            (CPint64) (pReader->EntryOffset + (NvU64) Entry * pReader->EntrySize), CP_OriginBegin));
+        NVMM_CHK_CP (pIndex->pPipe->cpipe.Read (pIndex->hContentPipe,
+            (CPbyte *) pReader->Window, (CPuint) (Count * pReader->EntrySize)));
+        pReader->WindowStart = Entry;
+        pReader->WindowCount = Count;
+    }
+
+    *ppEntry = &pReader->Window[(Entry - pReader->WindowStart) * pReader->EntrySize];
+
+cleanup:
+    return Status;
+}
+
+static NvError
+Mp4SampleIndexReadChunkOffset (
+    NvMp4SampleIndex *pIndex,
+    NvU32 Chunk,
+    NvU64 *pChunkOffset)
+{
+    NvError Status = NvSuccess;
+    NvU8 *pEntry;
+
+    NVMM_CHK_ERR (Mp4TableReaderGet (pIndex, &pIndex->Stco, Chunk, &pEntry));
+    if (pIndex->Stco.EntrySize == sizeof (NvU64))
+    {
+        *pChunkOffset = ((NvU64) NV_BE_TO_INT_32 (&pEntry[0]) << 32) | (NvU64) NV_BE_TO_INT_32 (&pEntry[4]);
+    }
+    else
+    {
+        *pChunkOffset = NV_BE_TO_INT_32 (pEntry);
+    }
+
+cleanup:
+    return Status;
+}
+
+/*
+ * Loads the samples-per-chunk of the stsc entry governing pState->Chunk and
+ * the first chunk (0 based) of the entry that follows it.
+ */
+static NvError
+Mp4SampleIndexLoadStsc (
+    NvMp4SampleIndex *pIndex,
+    NvMp4SampleIndexCheckpoint *pState,
+    NvU32 *pSamplesPerChunk,
+    NvU32 *pNextFirstChunk)
+{
+    NvError Status = NvSuccess;
+    NvU8 *pEntry;
+    NvU32 NextFirstChunk;
+
+    for (;;)
+    {
+        NextFirstChunk = NVMP4_SAMPLE_INDEX_INVALID;
+        if (pState->StscEntry + 1 < pIndex->Stsc.EntryCount)
+        {
+            NVMM_CHK_ERR (Mp4TableReaderGet (pIndex, &pIndex->Stsc, pState->StscEntry + 1, &pEntry));
+            NextFirstChunk = NV_BE_TO_INT_32 (&pEntry[0]) - 1;
+        }
+        if (pState->Chunk < NextFirstChunk)
+            break;
+        pState->StscEntry++;
+    }
+
+    NVMM_CHK_ERR (Mp4TableReaderGet (pIndex, &pIndex->Stsc, pState->StscEntry, &pEntry));
+    *pSamplesPerChunk = NV_BE_TO_INT_32 (&pEntry[4]);
+    *pNextFirstChunk = NextFirstChunk;
+    if (*pSamplesPerChunk == 0)
+    {
+        Status = NvError_ParserCorruptedStream;
+    }
+
+cleanup:
+    return Status;
+}
+
+/*
+ * Reads the value of a (count, value) table such as stts or ctts for the
+ * sample at the (*pEntry, *pUsed) cursor and advances the cursor by one
+ * sample. Samples past the end of the table get a value of 0.
+ */
+static NvError
+Mp4SampleIndexNextCountedValue (
+    NvMp4SampleIndex *pIndex,
+    NvMp4TableReader *pReader,
+    NvU32 *pEntry,
+    NvU32 *pUsed,
+    NvU32 *pValue)
+{
+    NvError Status = NvSuccess;
+    NvU8 *pData;
+
+    *pValue = 0;
+    while (*pEntry < pReader->EntryCount)
+    {
+        NVMM_CHK_ERR (Mp4TableReaderGet (pIndex, pReader, *pEntry, &pData));
+        if (*pUsed < NV_BE_TO_INT_32 (&pData[0]))
+        {
+            *pValue = NV_BE_TO_INT_32 (&pData[4]);
+            (*pUsed)++;
+            break;
+        }
+        (*pEntry)++;
+        *pUsed = 0;
+    }
+
+cleanup:
+    return Status;
+}
+
+static void
+Mp4SampleIndexFreePage (
+    NvMp4SampleIndexPage *pPage)
+{
+    if (pPage->pStorage)
+    {
+        NvOsFree (pPage->pStorage);
+    }
+    NvOsMemset (pPage, 0, sizeof (NvMp4SampleIndexPage));
+    pPage->PageNum = NVMP4_SAMPLE_INDEX_INVALID;
+}
+
+/*
+ * Walks the sample tables for one page starting at its checkpoint and
+ * stores the result in compact form. Produces the checkpoint of the next
+ * page as a side effect.
+ */
+static NvError
+Mp4SampleIndexDecodePage (
+    NvMp4SampleIndex *pIndex,
+    NvU32 PageNum,
+    NvMp4SampleIndexPage *pPage)
+{
+    NvError Status = NvSuccess;
+    NvMp4SampleIndexCheckpoint State;
+    NvMp4SampleIndexRun *pSizeRun = pIndex->pScratchRun;
+    NvMp4SampleIndexRun *pDurationRun = pIndex->pScratchRun + NVMP4_SAMPLE_INDEX_PAGE_SAMPLES;
+    NvMp4SampleIndexRun *pCtsRun = pIndex->pScratchRun + 2 * NVMP4_SAMPLE_INDEX_PAGE_SAMPLES;
+    NvU32 SyncBits[NVMP4_SAMPLE_INDEX_PAGE_SAMPLES / 32];
+    NvU32 SizeRuns = 0, DurationRuns = 0, CtsRuns = 0, GapCount = 0;
+    NvU32 FirstSample, Count, i, Sample;
+    NvU32 SamplesPerChunk = 0, NextFirstChunk = 0;
+    NvU32 Size, Duration, Cts, SyncSample;
+    NvU64 ChunkOffset, Offset, NextOffset = 0, BaseOffset = 0;
+    NvBool HasSync = NV_FALSE, RawSizes;
+    NvU32 StorageSize;
+    NvU8 *pEntry, *pStorage;
+
+    Mp4SampleIndexFreePage (pPage);
+
+    State = pIndex->pCheckpoint[PageNum];
+    FirstSample = PageNum << NVMP4_SAMPLE_INDEX_PAGE_SHIFT;
+    Count = pIndex->SampleCount - FirstSample;
+    if (Count > NVMP4_SAMPLE_INDEX_PAGE_SAMPLES)
+        Count = NVMP4_SAMPLE_INDEX_PAGE_SAMPLES;
+
+    NvOsMemset (SyncBits, 0, sizeof (SyncBits));
+    NVMM_CHK_ERR (Mp4SampleIndexLoadStsc (pIndex, &State, &SamplesPerChunk, &NextFirstChunk));
+
+    for (i = 0; i < Count; i++)
+    {
+        Sample = FirstSample + i;
+
+        if (pIndex->DefaultSampleSize)
+        {
+            Size = pIndex->DefaultSampleSize;
+        }
+        else
+        {
+            NVMM_CHK_ERR (Mp4TableReaderGet (pIndex, &pIndex->Stsz, Sample, &pEntry));
+            Size = NV_BE_TO_INT_32 (pEntry);
+        }
+
+        NVMM_CHK_ERR (Mp4SampleIndexNextCountedValue (pIndex, &pIndex->Stts,
+            &State.SttsEntry, &State.SttsUsed, &Duration));
+        Cts = 0;
+        if (pIndex->HasCtts)
+        {
+            NVMM_CHK_ERR (Mp4SampleIndexNextCountedValue (pIndex, &pIndex->Ctts,
+                &State.CttsEntry, &State.CttsUsed, &Cts));
+        }
+
+        /* Samples within a chunk are contiguous; only chunk starts need stco */
+        if (i == 0 || State.SampleInChunk == 0)
+        {
+            if (State.Chunk >= pIndex->Stco.EntryCount)
+            {
+                NV_LOGGER_PRINT ((NVLOG_MP4_PARSER, NVLOG_WARN,
+                    "SampleIndex: sample %d is past the last chunk %d\n", Sample, pIndex->Stco.EntryCount));
+                break;
+            }
+            NVMM_CHK_ERR (Mp4SampleIndexReadChunkOffset (pIndex, State.Chunk, &ChunkOffset));
+            Offset = ChunkOffset + State.OffsetInChunk;
+        }
+        else
+        {
+            Offset = NextOffset;
+        }
+
+        if (i == 0)
+        {
+            BaseOffset = Offset;
+        }
+        else if (Offset != NextOffset)
+        {
+            pIndex->pScratchGap[GapCount].Sample = i;
+            pIndex->pScratchGap[GapCount].Delta = (NvS64) (Offset - NextOffset);
+            GapCount++;
+        }
+        NextOffset = Offset + Size;
+
+        pIndex->pScratchSize[i] = Size;
+        Mp4RunAppend (pSizeRun, &SizeRuns, Size);
+        Mp4RunAppend (pDurationRun, &DurationRuns, Duration);
+        if (pIndex->HasCtts)
+        {
+            Mp4RunAppend (pCtsRun, &CtsRuns, Cts);
+        }
+
+        /* stss holds 1 based sample numbers in increasing order */
+        while (State.StssEntry < pIndex->Stss.EntryCount)
+        {
+            NVMM_CHK_ERR (Mp4TableReaderGet (pIndex, &pIndex->Stss, State.StssEntry, &pEntry));
+            SyncSample = NV_BE_TO_INT_32 (pEntry) - 1;
+            if (SyncSample > Sample)
+                break;
+            if (SyncSample == Sample)
+            {
+                SyncBits[i >> 5] |= 1 << (i & 31);
+                HasSync = NV_TRUE;
+            }
+            State.StssEntry++;
+        }
+
+        State.DTS += Duration;
+        State.OffsetInChunk += Size;
+        if (++State.SampleInChunk >= SamplesPerChunk)
+        {
+            State.Chunk++;
+            State.SampleInChunk = 0;
+            State.OffsetInChunk = 0;
+            if (State.Chunk >= NextFirstChunk)
+            {
+                NVMM_CHK_ERR (Mp4SampleIndexLoadStsc (pIndex, &State, &SamplesPerChunk, &NextFirstChunk));
+            }
+        }
+    }
+    Count = i;
+
+    /* Keep sizes run-length encoded only when that actually saves space */
+    RawSizes = (SizeRuns * sizeof (NvMp4SampleIndexRun) > Count * sizeof (NvU32));
+    StorageSize = GapCount * sizeof (NvMp4SampleIndexGap) +
+                  (DurationRuns + CtsRuns) * sizeof (NvMp4SampleIndexRun) +
+                  (RawSizes ? Count * sizeof (NvU32) : SizeRuns * sizeof (NvMp4SampleIndexRun)) +
+                  (HasSync ? sizeof (SyncBits) : 0);
+
+    if (StorageSize)
+    {
+        pPage->pStorage = NvOsAlloc (StorageSize);
+        NVMM_CHK_MEM (pPage->pStorage);
+    }
+    pStorage = (NvU8 *) pPage->pStorage;
+
+    /* Gaps first as they hold 64 bit members */
+    pPage->pGap = (NvMp4SampleIndexGap *) pStorage;
+    pPage->GapCount = GapCount;
+    NvOsMemcpy (pPage->pGap, pIndex->pScratchGap, GapCount * sizeof (NvMp4SampleIndexGap));
+    pStorage += GapCount * sizeof (NvMp4SampleIndexGap);
+
+    pPage->pDurationRun = (NvMp4SampleIndexRun *) pStorage;
+    pPage->DurationRunCount = DurationRuns;
+    NvOsMemcpy (pPage->pDurationRun, pDurationRun, DurationRuns * sizeof (NvMp4SampleIndexRun));
+    pStorage += DurationRuns * sizeof (NvMp4SampleIndexRun);
+
+    pPage->pCtsRun = (NvMp4SampleIndexRun *) pStorage;
+    pPage->CtsRunCount = CtsRuns;
+    NvOsMemcpy (pPage->pCtsRun, pCtsRun, CtsRuns * sizeof (NvMp4SampleIndexRun));
+    pStorage += CtsRuns * sizeof (NvMp4SampleIndexRun);
+
+    if (RawSizes)
+    {
+        pPage->pSize = (NvU32 *) pStorage;
+        pPage->SizeRunCount = 0;
+        NvOsMemcpy (pPage->pSize, pIndex->pScratchSize, Count * sizeof (NvU32));
+        pStorage += Count * sizeof (NvU32);
+    }
+    else
+    {
+        pPage->pSizeRun = (NvMp4SampleIndexRun *) pStorage;
+        pPage->SizeRunCount = SizeRuns;
+        NvOsMemcpy (pPage->pSizeRun, pSizeRun, SizeRuns * sizeof (NvMp4SampleIndexRun));
+        pStorage += SizeRuns * sizeof (NvMp4SampleIndexRun);
+    }
+
+    if (HasSync)
+    {
+        pPage->pSyncBits = (NvU32 *) pStorage;
+        NvOsMemcpy (pPage->pSyncBits, SyncBits, sizeof (SyncBits));
+    }
+
+    pPage->BaseOffset = BaseOffset;
+    pPage->SampleCount = Count;
+    pPage->PageNum = PageNum;
+
+    /* Only a fully decoded page yields a trustworthy checkpoint for the next one */
+    if (Count == NVMP4_SAMPLE_INDEX_PAGE_SAMPLES &&
+        PageNum + 1 < pIndex->PageCount &&
+        PageNum + 1 == pIndex->ValidCheckpoints)
+    {
+        pIndex->pCheckpoint[PageNum + 1] = State;
+        pIndex->ValidCheckpoints++;
+    }
+
+cleanup:
+    if (Status != NvSuccess)
+    {
+        Mp4SampleIndexFreePage (pPage);
+    }
+    return Status;
+}
+
+static NvError
+Mp4SampleIndexGetPage (
+    NvMp4SampleIndex *pIndex,
+    NvU32 PageNum,
+    NvMp4SampleIndexPage **ppPage)
+{
+    NvError Status = NvSuccess;
+    NvMp4SampleIndexPage *pVictim = NULL;
+    NvU32 i;
+
+    if (PageNum >= pIndex->PageCount)
+    {
+        return NvError_ParserEndOfStream;
+    }
+
+    for (i = 0; i < NVMP4_SAMPLE_INDEX_CACHED_PAGES; i++)
+    {
+        if (pIndex->Page[i].PageNum == PageNum)
+        {
+            pIndex->PageHits++;
+            pIndex->Page[i].LastUse = ++pIndex->UseClock;
+            *ppPage = &pIndex->Page[i];
+            return NvSuccess;
+        }
+        if (!pVictim || pIndex->Page[i].PageNum == NVMP4_SAMPLE_INDEX_INVALID ||
+            (pVictim->PageNum != NVMP4_SAMPLE_INDEX_INVALID && pIndex->Page[i].LastUse < pVictim->LastUse))
+        {
+            pVictim = &pIndex->Page[i];
+        }
+    }
+    pIndex->PageMisses++;
+
+    /* Build the missing checkpoints by decoding the pages in front of this one */
+    while (pIndex->ValidCheckpoints <= PageNum)
+    {
+        NvU32 Before = pIndex->ValidCheckpoints;
+
+        NVMM_CHK_ERR (Mp4SampleIndexDecodePage (pIndex, pIndex->ValidCheckpoints - 1, pVictim));
+        if (pIndex->ValidCheckpoints == Before)
+        {
+            /* The tables end before this page */
+            Status = NvError_ParserEndOfStream;
+            goto cleanup;
+        }
+    }
+
+    NVMM_CHK_ERR (Mp4SampleIndexDecodePage (pIndex, PageNum, pVictim));
+    pVictim->LastUse = ++pIndex->UseClock;
+    *ppPage = pVictim;
+
+cleanup:
+    return Status;
+}
+
+static NvU32
+Mp4SampleIndexHashURI (
+    const char *pURI)
+{
+    /* FNV-1a */
+    NvU32 Hash = 2166136261U;
+
+    while (*pURI)
+    {
+        Hash ^= (NvU8) *pURI++;
+        Hash *= 16777619U;
+    }
+    return Hash;
+}
+
+static void
+Mp4SampleIndexSidecarInit (
+    NvMp4SampleIndex *pIndex,
+    const char *pURI)
+{
+    char CacheDir[NVMP4_SAMPLE_INDEX_PATH_LEN];
+    NvOsStatType FileStat;
+
+    /* Only local files have a stable size/mtime to key the cache on */
+    if (!pURI || NvUStrstr (pURI, ":"))
+        return;
+
+    if (NvOsGetConfigString (NVMP4_SAMPLE_INDEX_CACHE_DIR_CONFIG, CacheDir, sizeof (CacheDir)) != NvSuccess ||
+        !CacheDir[0])
+        return;
+
+    if (NvOsStat (pURI, &FileStat) != NvSuccess || FileStat.size != pIndex->FileSize)
+        return;
+
+    pIndex->pSidecarPath = NvOsAlloc (NVMP4_SAMPLE_INDEX_PATH_LEN);
+    if (!pIndex->pSidecarPath)
+        return;
+
+    NvOsSnprintf (pIndex->pSidecarPath, NVMP4_SAMPLE_INDEX_PATH_LEN, "%s/%08x_%u.nvsi",
+        CacheDir, Mp4SampleIndexHashURI (pURI), pIndex->TrackID);
+    pIndex->FileMtime = FileStat.mtime;
+}
+
+static void
+Mp4SampleIndexSidecarLoad (
+    NvMp4SampleIndex *pIndex)
+{
+    NvOsFileHandle hFile = NULL;
+    NvMp4SampleIndexSidecarHeader Header;
+    size_t BytesRead = 0;
+
+    if (NvOsFopen (pIndex->pSidecarPath, NVOS_OPEN_READ, &hFile) != NvSuccess)
+        return;
+
+    if (NvOsFread (hFile, &Header, sizeof (Header), &BytesRead) != NvSuccess ||
+        BytesRead != sizeof (Header))
+        goto cleanup;
+
+    if (Header.Magic != NVMP4_SAMPLE_INDEX_MAGIC ||
+        Header.Version != NVMP4_SAMPLE_INDEX_VERSION ||
+        Header.FileSize != pIndex->FileSize ||
+        Header.FileMtime != pIndex->FileMtime ||
+        Header.TrackID != pIndex->TrackID ||
+        Header.SampleCount != pIndex->SampleCount ||
+        Header.PageShift != NVMP4_SAMPLE_INDEX_PAGE_SHIFT ||
+        Header.CheckpointSize != sizeof (NvMp4SampleIndexCheckpoint) ||
+        Header.CheckpointCount == 0 ||
+        Header.CheckpointCount > pIndex->PageCount)
+    {
+        NV_LOGGER_PRINT ((NVLOG_MP4_PARSER, NVLOG_DEBUG, "SampleIndex: stale sidecar %s\n", pIndex->pSidecarPath));
+        goto cleanup;
+    }
+
+    if (NvOsFread (hFile, pIndex->pCheckpoint, Header.CheckpointCount * sizeof (NvMp4SampleIndexCheckpoint),
+            &BytesRead) != NvSuccess ||
+        BytesRead != Header.CheckpointCount * sizeof (NvMp4SampleIndexCheckpoint))
+    {
+        /* Checkpoint 0 may have been overwritten, restore it */
+        NvOsMemset (pIndex->pCheckpoint, 0, sizeof (NvMp4SampleIndexCheckpoint));
+        goto cleanup;
+    }
+
+    pIndex->ValidCheckpoints = Header.CheckpointCount;
+    pIndex->LoadedCheckpoints = Header.CheckpointCount;
+    NV_LOGGER_PRINT ((NVLOG_MP4_PARSER, NVLOG_DEBUG, "SampleIndex: loaded %d checkpoints from %s\n",
+        Header.CheckpointCount, pIndex->pSidecarPath));
+
+cleanup:
+    NvOsFclose (hFile);
+}
+
+static void
+Mp4SampleIndexSidecarSave (
+    NvMp4SampleIndex *pIndex)
+{
+    NvOsFileHandle hFile = NULL;
+    NvMp4SampleIndexSidecarHeader Header;
+    NvError Status;
+
+    NvOsMemset (&Header, 0, sizeof (Header));
+    Header.Magic = NVMP4_SAMPLE_INDEX_MAGIC;
+    Header.Version = NVMP4_SAMPLE_INDEX_VERSION;
+    Header.FileSize = pIndex->FileSize;
+    Header.FileMtime = pIndex->FileMtime;
+    Header.TrackID = pIndex->TrackID;
+    Header.SampleCount = pIndex->SampleCount;
+    Header.PageShift = NVMP4_SAMPLE_INDEX_PAGE_SHIFT;
+    Header.CheckpointSize = sizeof (NvMp4SampleIndexCheckpoint);
+    Header.CheckpointCount = pIndex->ValidCheckpoints;
+
+    if (NvOsFopen (pIndex->pSidecarPath, NVOS_OPEN_CREATE | NVOS_OPEN_WRITE, &hFile) != NvSuccess)
+    {
+        NV_LOGGER_PRINT ((NVLOG_MP4_PARSER, NVLOG_DEBUG, "SampleIndex: cannot create %s\n", pIndex->pSidecarPath));
+        return;
+    }
+
+    Status = NvOsFwrite (hFile, &Header, sizeof (Header));
+    if (Status == NvSuccess)
+    {
+        Status = NvOsFwrite (hFile, pIndex->pCheckpoint,
+            pIndex->ValidCheckpoints * sizeof (NvMp4SampleIndexCheckpoint));
+    }
+    NvOsFclose (hFile);
+
+    if (Status != NvSuccess)
+    {
+        (void) NvOsFremove (pIndex->pSidecarPath);
+    }
+}
+
+NvError
+NvMp4SampleIndexCreate (
+    NvMp4SampleIndex **ppIndex,
+    CP_PIPETYPE_EXTENDED *pPipe,
+    CPhandle hContentPipe,
+    const NvMp4TrackInformation *pTrackInfo,
+    const char *pURI,
+    NvU64 FileSize)
+{
+    NvError Status = NvSuccess;
+    NvMp4SampleIndex *pIndex = NULL;
+    NvU32 i;
+
+    NVMM_CHK_ARG (ppIndex && pPipe && pTrackInfo);
+    *ppIndex = NULL;
+
+    /* Without chunk tables there is nothing to index */
+    if (pTrackInfo->STSZSampleCount && (!pTrackInfo->STSCEntries || !pTrackInfo->STCOEntries))
+    {
+        Status = NvError_ParserCorruptedStream;
+        goto cleanup;
+    }
+
+    pIndex = NvOsAlloc (sizeof (NvMp4SampleIndex));
+    NVMM_CHK_MEM (pIndex);
+    NvOsMemset (pIndex, 0, sizeof (NvMp4SampleIndex));
+
+    pIndex->pPipe = pPipe;
+    pIndex->hContentPipe = hContentPipe;
+    pIndex->TrackID = pTrackInfo->TrackID;
+    pIndex->SampleCount = pTrackInfo->STSZSampleCount;
+    pIndex->DefaultSampleSize = pTrackInfo->STSZSampleSize;
+    pIndex->FileSize = FileSize;
+
+    /* Entry offsets: 4 size + 4 AtomType + 4 Version-flag + 4 entry count (+ 4 sample_size for stsz) */
+    if (!pIndex->DefaultSampleSize)
+    {
+        Mp4TableReaderInit (&pIndex->Stsz, pTrackInfo->STSZOffset + 20, sizeof (NvU32), pIndex->SampleCount);
+    }
+    if (pTrackInfo->STTSOffset != (NvU64) -1)
+    {
+        Mp4TableReaderInit (&pIndex->Stts, pTrackInfo->STTSOffset + 16, sizeof (NvU32) * 2, pTrackInfo->STTSEntries);
+    }
+    if (pTrackInfo->CTTSOffset != (NvU64) -1 && pTrackInfo->CTTSEntries)
+    {
+        pIndex->HasCtts = NV_TRUE;
+        Mp4TableReaderInit (&pIndex->Ctts, pTrackInfo->CTTSOffset + 16, sizeof (NvU32) * 2, pTrackInfo->CTTSEntries);
+    }
+    Mp4TableReaderInit (&pIndex->Stsc, pTrackInfo->STSCOffset + 16, sizeof (NvU32) * 3, pTrackInfo->STSCEntries);
+    Mp4TableReaderInit (&pIndex->Stco, pTrackInfo->STCOOffset + 16,
+        pTrackInfo->IsCo64bitOffsetPresent ? sizeof (NvU64) : sizeof (NvU32), pTrackInfo->STCOEntries);
+    if (pTrackInfo->STSSEntries)
+    {
+        pIndex->HasStss = NV_TRUE;
+        Mp4TableReaderInit (&pIndex->Stss, pTrackInfo->STSSOffset + 16, sizeof (NvU32), pTrackInfo->STSSEntries);
+    }
+
+    pIndex->PageCount = (pIndex->SampleCount + NVMP4_SAMPLE_INDEX_PAGE_SAMPLES - 1) >> NVMP4_SAMPLE_INDEX_PAGE_SHIFT;
+    pIndex->pCheckpoint = NvOsAlloc ((pIndex->PageCount + 1) * sizeof (NvMp4SampleIndexCheckpoint));
+    NVMM_CHK_MEM (pIndex->pCheckpoint);
+    NvOsMemset (pIndex->pCheckpoint, 0, sizeof (NvMp4SampleIndexCheckpoint));
+    pIndex->ValidCheckpoints = pIndex->PageCount ? 1 : 0;
+
+    for (i = 0; i < NVMP4_SAMPLE_INDEX_CACHED_PAGES; i++)
+    {
+        pIndex->Page[i].PageNum = NVMP4_SAMPLE_INDEX_INVALID;
+    }
+
+    pIndex->pScratchRun = NvOsAlloc (3 * NVMP4_SAMPLE_INDEX_PAGE_SAMPLES * sizeof (NvMp4SampleIndexRun));
+    NVMM_CHK_MEM (pIndex->pScratchRun);
+    pIndex->pScratchSize = NvOsAlloc (NVMP4_SAMPLE_INDEX_PAGE_SAMPLES * sizeof (NvU32));
+    NVMM_CHK_MEM (pIndex->pScratchSize);
+    pIndex->pScratchGap = NvOsAlloc (NVMP4_SAMPLE_INDEX_PAGE_SAMPLES * sizeof (NvMp4SampleIndexGap));
+    NVMM_CHK_MEM (pIndex->pScratchGap);
+
+    Mp4SampleIndexSidecarInit (pIndex, pURI);
+    if (pIndex->pSidecarPath && pIndex->PageCount)
+    {
+        Mp4SampleIndexSidecarLoad (pIndex);
+    }
+
+    *ppIndex = pIndex;
+    pIndex = NULL;
+
+cleanup:
+    if (pIndex)
+    {
+        NvMp4SampleIndexDestroy (pIndex);
+    }
+    return Status;
+}
+
+void
+NvMp4SampleIndexDestroy (
+    NvMp4SampleIndex *pIndex)
+{
+    NvU32 i;
+
+    if (!pIndex)
+        return;
+
+    if (pIndex->pSidecarPath && pIndex->ValidCheckpoints > pIndex->LoadedCheckpoints)
+    {
+        Mp4SampleIndexSidecarSave (pIndex);
+    }
+
+    NV_LOGGER_PRINT ((NVLOG_MP4_PARSER, NVLOG_DEBUG,
+        "SampleIndex: track %d pages %d checkpoints %d hits %d misses %d\n",
+        pIndex->TrackID, pIndex->PageCount, pIndex->ValidCheckpoints, pIndex->PageHits, pIndex->PageMisses));
+
+    for (i = 0; i < NVMP4_SAMPLE_INDEX_CACHED_PAGES; i++)
+    {
+        Mp4SampleIndexFreePage (&pIndex->Page[i]);
+    }
+    NvOsFree (pIndex->pScratchRun);
+    NvOsFree (pIndex->pScratchSize);
+    NvOsFree (pIndex->pScratchGap);
+    NvOsFree (pIndex->pCheckpoint);
+    NvOsFree (pIndex->pSidecarPath);
+    NvOsFree (pIndex);
+}
+
+NvError
+NvMp4SampleIndexGetSamples (
+    NvMp4SampleIndex *pIndex,
+    NvU32 FirstSample,
+    NvU32 Count,
+    NvU64 *pOffset,
+    NvU32 *pSize,
+    NvU64 *pDTS,
+    NvU32 *pCTS,
+    NvU32 *pValidCount)
+{
+    NvError Status = NvSuccess;
+    NvMp4SampleIndexPage *pPage = NULL;
+    Mp4RunCursor SizeCursor, DurationCursor, CtsCursor;
+    NvU32 Filled = 0, PageNum, First, End, Gap, j;
+    NvU32 Size, Duration, Cts;
+    NvU64 Offset, DTS;
+
+    NVMM_CHK_ARG (pIndex && pValidCount);
+
+    if (FirstSample >= pIndex->SampleCount)
+    {
+        Status = NvError_ParserEndOfStream;
+        goto cleanup;
+    }
+    if (Count > pIndex->SampleCount - FirstSample)
+        Count = pIndex->SampleCount - FirstSample;
+
+    while (Filled < Count)
+    {
+        PageNum = (FirstSample + Filled) >> NVMP4_SAMPLE_INDEX_PAGE_SHIFT;
+        First = (FirstSample + Filled) & (NVMP4_SAMPLE_INDEX_PAGE_SAMPLES - 1);
+
+        Status = Mp4SampleIndexGetPage (pIndex, PageNum, &pPage);
+        if (Status == NvError_ParserEndOfStream)
+        {
+            Status = NvSuccess;
+            break;
+        }
+        NVMM_CHK_ERR (Status);
+
+        End = First + (Count - Filled);
+        if (End > pPage->SampleCount)
+            End = pPage->SampleCount;
+        if (First >= End)
+            break;
+
+        /* Replay the page from its start; offsets and DTS are cumulative */
+        Mp4RunCursorInit (&SizeCursor, pPage->pSizeRun, pPage->SizeRunCount);
+        Mp4RunCursorInit (&DurationCursor, pPage->pDurationRun, pPage->DurationRunCount);
+        Mp4RunCursorInit (&CtsCursor, pPage->pCtsRun, pPage->CtsRunCount);
+        Offset = pPage->BaseOffset;
+        DTS = pIndex->pCheckpoint[PageNum].DTS;
+        Gap = 0;
+
+        for (j = 0; j < End; j++)
+        {
+            Size = pPage->SizeRunCount ? Mp4RunCursorNext (&SizeCursor) : pPage->pSize[j];
+            Duration = Mp4RunCursorNext (&DurationCursor);
+            Cts = Mp4RunCursorNext (&CtsCursor);
+            if (Gap < pPage->GapCount && pPage->pGap[Gap].Sample == j)
+            {
+                Offset += pPage->pGap[Gap].Delta;
+                Gap++;
+            }
+
+            if (j >= First)
+            {
+                if (pOffset)
+                    *pOffset++ = Offset;
+                if (pSize)
+                    *pSize++ = Size;
+                if (pDTS)
+                    *pDTS++ = DTS;
+                if (pCTS)
+                    *pCTS++ = Cts;
+            }
+            Offset += Size;
+            DTS += Duration;
+        }
+        Filled += End - First;
+
+        if (pPage->SampleCount < NVMP4_SAMPLE_INDEX_PAGE_SAMPLES && End == pPage->SampleCount)
+            break;
+    }
+
+cleanup:
+    if (pValidCount)
+        *pValidCount = Filled;
+    return Status;
+}
+
+NvBool
+NvMp4SampleIndexIsSyncSample (
+    NvMp4SampleIndex *pIndex,
+    NvU32 Sample)
+{
+    NvMp4SampleIndexPage *pPage = NULL;
+    NvU32 Bit;
+
+    if (!pIndex->HasStss)
+        return NV_TRUE;
+
+    if (Mp4SampleIndexGetPage (pIndex, Sample >> NVMP4_SAMPLE_INDEX_PAGE_SHIFT, &pPage) != NvSuccess)
+        return NV_FALSE;
+
+    Bit = Sample & (NVMP4_SAMPLE_INDEX_PAGE_SAMPLES - 1);
+    if (!pPage->pSyncBits || Bit >= pPage->SampleCount)
+        return NV_FALSE;
+
+    return (pPage->pSyncBits[Bit >> 5] >> (Bit & 31)) & 1;
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2013 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software and related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+#ifndef INCLUDED_NV_MP4_SAMPLEINDEX_H
+#define INCLUDED_NV_MP4_SAMPLEINDEX_H
+
+#include "nvos.h"
+#include "nvlocalfilecontentpipe.h"
+#include "nv_mp4parser_defines.h"
+
+/**
+ * Compact, lazily paged index over the sample table (stsz/stts/ctts/stsc/
+ * stco/co64/stss) of one track.
+ *
+ * The sample space is split into pages of NVMP4_SAMPLE_INDEX_PAGE_SAMPLES.
+ * For every page a small checkpoint records where each table cursor stands
+ * at the first sample of the page, so a page can be decoded without walking
+ * the tables from the beginning. Checkpoints are built incrementally the
+ * first time a page is reached and can be persisted to a sidecar file.
+ *
+ * Decoded pages are kept in a small LRU cache in compact form: sizes,
+ * durations and composition offsets are run-length encoded, file offsets
+ * are stored as a base plus the gaps between non-contiguous samples, and
+ * sync samples are kept in a per-page bitmap that is only present when the
+ * page contains one. Memory use therefore does not depend on the number of
+ * samples in the track apart from the checkpoint array (~48 bytes per page).
+ */
+
+#define NVMP4_SAMPLE_INDEX_PAGE_SHIFT       10
+#define NVMP4_SAMPLE_INDEX_PAGE_SAMPLES     (1 << NVMP4_SAMPLE_INDEX_PAGE_SHIFT)
+#define NVMP4_SAMPLE_INDEX_CACHED_PAGES     6
+/* 3072 bytes hold a whole number of entries of every table (4, 8 and 12 bytes) */
+#define NVMP4_SAMPLE_INDEX_WINDOW_BYTES     3072
+#define NVMP4_SAMPLE_INDEX_INVALID          0xFFFFFFFF
+
+/** Config string naming the directory used for the sidecar index cache. */
+#define NVMP4_SAMPLE_INDEX_CACHE_DIR_CONFIG "mp4.sampleindex.cachedir"
+
+/**
+ * Buffered reader over one big-endian sample table.
+ */
+typedef struct NvMp4TableReaderRec
+{
+    NvU64 EntryOffset;      /**< file offset of the first table entry */
+    NvU32 EntrySize;        /**< size of one entry in bytes */
+    NvU32 EntryCount;       /**< number of entries in the table */
+    NvU32 WindowStart;      /**< index of the first entry held in Window */
+    NvU32 WindowCount;      /**< number of valid entries in Window */
+    NvU8 Window[NVMP4_SAMPLE_INDEX_WINDOW_BYTES];
+} NvMp4TableReader;
+
+/**
+ * Position of every table cursor at the first sample of a page.
+ */
+typedef struct NvMp4SampleIndexCheckpointRec
+{
+    NvU64 DTS;              /**< decode time of the first sample */
+    NvU32 SttsEntry;        /**< stts entry holding the first sample */
+    NvU32 SttsUsed;         /**< samples of SttsEntry before the first sample */
+    NvU32 CttsEntry;
+    NvU32 CttsUsed;
+    NvU32 StscEntry;        /**< stsc entry governing Chunk */
+    NvU32 Chunk;            /**< 0 based chunk holding the first sample */
+    NvU32 SampleInChunk;    /**< samples of Chunk before the first sample */
+    NvU32 OffsetInChunk;    /**< bytes of Chunk before the first sample */
+    NvU32 StssEntry;        /**< first stss entry at or after the first sample */
+} NvMp4SampleIndexCheckpoint;
+
+typedef struct NvMp4SampleIndexRunRec
+{
+    NvU32 Value;
+    NvU32 Count;
+} NvMp4SampleIndexRun;
+
+typedef struct NvMp4SampleIndexGapRec
+{
+    NvU32 Sample;           /**< sample number within the page */
+    NvS64 Delta;            /**< offset minus the end of the previous sample */
+} NvMp4SampleIndexGap;
+
+/**
+ * One decoded page in compact form.
+ */
+typedef struct NvMp4SampleIndexPageRec
+{
+    NvU32 PageNum;          /**< NVMP4_SAMPLE_INDEX_INVALID if the slot is free */
+    NvU32 SampleCount;
+    NvU32 LastUse;
+    NvU64 BaseOffset;       /**< file offset of the first sample */
+
+    /* Single allocation holding all of the arrays below */
+    void *pStorage;
+
+    NvU32 SizeRunCount;     /**< 0 when sizes are stored raw in pSize */
+    NvMp4SampleIndexRun *pSizeRun;
+    NvU32 *pSize;
+    NvU32 DurationRunCount;
+    NvMp4SampleIndexRun *pDurationRun;
+    NvU32 CtsRunCount;
+    NvMp4SampleIndexRun *pCtsRun;
+    NvU32 GapCount;
+    NvMp4SampleIndexGap *pGap;
+
+    /* NULL when the page holds no sync sample */
+    NvU32 *pSyncBits;
+} NvMp4SampleIndexPage;
+
+typedef struct NvMp4SampleIndexRec
+{
+    CP_PIPETYPE_EXTENDED *pPipe;
+    CPhandle hContentPipe;
+
+    NvU32 TrackID;
+    NvU32 SampleCount;
+    NvU32 DefaultSampleSize;
+    NvBool HasCtts;
+    NvBool HasStss;
+
+    NvMp4TableReader Stsz;
+    NvMp4TableReader Stts;
+    NvMp4TableReader Ctts;
+    NvMp4TableReader Stsc;
+    NvMp4TableReader Stco;
+    NvMp4TableReader Stss;
+
+    NvU32 PageCount;
+    /* Checkpoints [0, ValidCheckpoints) are known */
+    NvU32 ValidCheckpoints;
+    /* Number of checkpoints read from the sidecar */
+    NvU32 LoadedCheckpoints;
+    NvMp4SampleIndexCheckpoint *pCheckpoint;
+
+    NvMp4SampleIndexPage Page[NVMP4_SAMPLE_INDEX_CACHED_PAGES];
+    NvU32 UseClock;
+
+    /* Worst-case page used while decoding, before it is compacted */
+    NvMp4SampleIndexRun *pScratchRun;
+    NvU32 *pScratchSize;
+    NvMp4SampleIndexGap *pScratchGap;
+
+    /* Sidecar cache, NULL when disabled */
+    char *pSidecarPath;
+    NvU64 FileSize;
+    NvU64 FileMtime;
+
+    /* Statistics */
+    NvU32 PageHits;
+    NvU32 PageMisses;
+} NvMp4SampleIndex;
+
+/**
+ * Creates the index for a track. Nothing is read from the sample tables
+ * until a sample is requested.
+ *
+ * @param pURI URI of the file, used to key the sidecar cache. May be NULL.
+ */
+NvError
+NvMp4SampleIndexCreate (
+    NvMp4SampleIndex **ppIndex,
+    CP_PIPETYPE_EXTENDED *pPipe,
+    CPhandle hContentPipe,
+    const NvMp4TrackInformation *pTrackInfo,
+    const char *pURI,
+    NvU64 FileSize);
+
+/**
+ * Destroys the index, writing the sidecar cache first when new checkpoints
+ * were built since it was loaded.
+ */
+void
+NvMp4SampleIndexDestroy (
+    NvMp4SampleIndex *pIndex);
+
+/**
+ * Fills the caller's framing arrays for Count samples starting at
+ * FirstSample. Any of the output arrays may be NULL.
+ *
+ * @param pValidCount Returns how many samples were filled. Less than Count
+ *                    when the tables end early (corrupted file).
+ */
+NvError
+NvMp4SampleIndexGetSamples (
+    NvMp4SampleIndex *pIndex,
+    NvU32 FirstSample,
+    NvU32 Count,
+    NvU64 *pOffset,
+    NvU32 *pSize,
+    NvU64 *pDTS,
+    NvU32 *pCTS,
+    NvU32 *pValidCount);
+
+/**
+ * Returns NV_TRUE if Sample (0 based) is a sync sample. Every sample is a
+ * sync sample when the track has no stss table.
+ */
+NvBool
+NvMp4SampleIndexIsSyncSample (
+    NvMp4SampleIndex *pIndex,
+    NvU32 Sample);
+
+#endif // INCLUDED_NV_MP4_SAMPLEINDEX_H
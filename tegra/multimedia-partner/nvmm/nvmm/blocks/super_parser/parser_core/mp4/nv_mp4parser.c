@@ -3809,6 +3809,8 @@ NvMp4ParserInit (
     }
 
     pNvMp4Parser->VideoSyncData.IsReady = NV_FALSE;
+    pNvMp4Parser->IsVideoSeekIndexComplete = NV_FALSE;
+    NVMM_CHK_ERR (NvMMSeekIndexCreate (&pNvMp4Parser->hVideoSeekIndex, MP4_SEEK_INDEX_GRANULARITY));
 
     pNvMp4Parser->MediaMetadata.TrackNumber = MP4_INVALID_NUMBER;
     pNvMp4Parser->MediaMetadata.TotalTracks = MP4_INVALID_NUMBER;
@@ -3839,6 +3841,7 @@ NvMp4ParserDeInit (
 {
     NvU32 i = 0;
     NvU32 index = 0;
+    NvMMSeekIndexStats SeekStats;
 
     if (pNvMp4Parser)
     {
@@ -3848,6 +3851,18 @@ NvMp4ParserDeInit (
             pNvMp4Parser->hContentPipe = 0;
         }
 
+        if (pNvMp4Parser->hVideoSeekIndex)
+        {
+            NvMMSeekIndexGetStats (pNvMp4Parser->hVideoSeekIndex, &SeekStats);
+            NV_LOGGER_PRINT ((NVLOG_MP4_PARSER, NVLOG_DEBUG,
+                "Seek index: %u points, %u seeks, avg %u us, max %u us, %u over %u us",
+                SeekStats.PointCount, SeekStats.SeekCount,
+                SeekStats.SeekCount ? (NvU32) (SeekStats.TotalLatencyUs / SeekStats.SeekCount) : 0,
+                SeekStats.MaxLatencyUs, SeekStats.OverBudgetCount, SeekStats.FrameBudgetUs));
+            NvMMSeekIndexDestroy (pNvMp4Parser->hVideoSeekIndex);
+            pNvMp4Parser->hVideoSeekIndex = NULL;
+        }
+
         for (i = 0 ; i < (pNvMp4Parser->MvHdData.AudioTracks + pNvMp4Parser->MvHdData.VideoTracks); i++)
         {
             if (pNvMp4Parser->FramingInfo[i].OffsetTable)
@@ -3874,6 +3889,12 @@ NvMp4ParserDeInit (
                 pNvMp4Parser->FramingInfo[i].CTSTable = NULL;
             }
 
+            if (pNvMp4Parser->FramingInfo[i].pSampleIndex)
+            {
+                NvMp4SampleIndexDestroy (pNvMp4Parser->FramingInfo[i].pSampleIndex);
+                pNvMp4Parser->FramingInfo[i].pSampleIndex = NULL;
+            }
+
             if (pNvMp4Parser->TrackInfo[i].SegmentTable)
             {
                 NvOsFree (pNvMp4Parser->TrackInfo[i].SegmentTable);
@@ -4026,6 +4047,17 @@ NvMp4ParserSetTrack (
             pNvMp4Parser->FramingInfo[TrackIndex].MaxFramesPerBlock) + 1;
 
     NVMM_CHK_ERR (MP4ParserAllocFramingInfo (&pNvMp4Parser->FramingInfo[TrackIndex]));
+    if (!pNvMp4Parser->FramingInfo[TrackIndex].pSampleIndex)
+    {
+        /* Without the index, MP4PrepareFramingInfo walks the tables for every block */
+        if (NvMp4SampleIndexCreate (&pNvMp4Parser->FramingInfo[TrackIndex].pSampleIndex,
+                pNvMp4Parser->pPipe, pNvMp4Parser->hContentPipe,
+                &pNvMp4Parser->TrackInfo[TrackIndex], pNvMp4Parser->URIList[0],
+                pNvMp4Parser->FileSize) != NvSuccess)
+        {
+            NV_LOGGER_PRINT ((NVLOG_MP4_PARSER, NVLOG_WARN, "Track %d: sample index not available\n", TrackIndex));
+        }
+    }
     pNvMp4Parser->FramingInfo[TrackIndex].BitRate = pNvMp4Parser->TrackInfo[TrackIndex].AvgBitRate;
 
     /**
@@ -4218,6 +4250,36 @@ cleanup:
     return Status;
 }
 
+/*
+ * Reads Count stss entries starting at FirstEntry into pEntries.
+ */
+static NvError
+Mp4ReadSTSSEntries (
+    NvMp4Parser *pNvMp4Parser,
+    const NvMp4TrackInformation *pTrackInfo,
+    NvU32 FirstEntry,
+    NvU32 Count,
+    NvS32 *pEntries)
+{
+    NvError Status = NvSuccess;
+    NvU64 FileOffset;
+    NvU32 i;
+
+    FileOffset = pTrackInfo->STSSOffset;
+    FileOffset += 16; /* 16 bytes = 4 size + 4 AtomType + 4 Version-flag + 4 entry*/
+    FileOffset += (NvU64) FirstEntry * 4;
+    NVMM_CHK_CP (pNvMp4Parser->pPipe->SetPosition64 (pNvMp4Parser->hContentPipe, (CPint64) FileOffset, CP_OriginBegin));
+    NVMM_CHK_CP (pNvMp4Parser->pPipe->cpipe.Read (pNvMp4Parser->hContentPipe, (CPbyte *) pEntries, Count * 4));
+
+    for (i = 0; i < Count; i++)
+    {
+        pEntries[i] = NV_BE_TO_INT_32 ( (NvU8 *) &pEntries[i]);
+    }
+
+cleanup:
+    return Status;
+}
+
 NvS32
 NvMp4ParserGetNextSyncUnit (
     NvMp4Parser * pNvMp4Parser,
@@ -4225,11 +4287,9 @@ NvMp4ParserGetNextSyncUnit (
     NvBool Direction)
 {
     NvError Status = NvSuccess;
-    NvU32 i = 0;
-    NvU32 ReadCount = 0;
-    NvU64 FileOffset;
-    NvBool IsPreviousSyncUnit;
-    CP_PIPETYPE *pPipe;
+    NvU32 Low, High, Mid, Entry;
+    NvS32 Value;
+    NvBool IsWindowHit;
     NvMp4TrackInformation *pTrackInfo = NULL;
     NvMp4SynchUnitData * pSyncData = NULL;
 
@@ -4238,132 +4298,319 @@ NvMp4ParserGetNextSyncUnit (
     if (Reference == 0)
         return Reference;
 
-    pPipe = &pNvMp4Parser->pPipe->cpipe;
-
     pTrackInfo = &pNvMp4Parser->TrackInfo[pNvMp4Parser->VideoIndex];
-
     pSyncData = &pNvMp4Parser->VideoSyncData;
-    // populate the data structure if this is the first call
-    if (!pSyncData->IsReady)
+
+    if (pTrackInfo->STSSEntries == 0)
     {
-        if (pTrackInfo->STSSEntries <= 0)
-        {
-            return (Reference + 1);
-        }
-        FileOffset = pTrackInfo->STSSOffset;
-        FileOffset += 16; /* 16 bytes = 4 size + 4 AtomType + 4 Version-flag + 4 entry*/
-        NVMM_CHK_ERR (pNvMp4Parser->pPipe->SetPosition64 (pNvMp4Parser->hContentPipe, (CPint64) FileOffset, CP_OriginBegin));
-        pSyncData->FirstEntryIndex = 0;
-        ReadCount = STSS_BUFF_SIZE;
-        if (pTrackInfo->STSSEntries < STSS_BUFF_SIZE)
-        {
-            ReadCount = pTrackInfo->STSSEntries;
-        }
+        return (Reference + 1);
+    }
 
-        NVMM_CHK_ERR (pPipe->Read (pNvMp4Parser->hContentPipe, (CPbyte *) pSyncData->ReadBuffer, ReadCount * 4));
+    // The cached window answers the lookup if the lower bound of Reference
+    // is known to lie inside it
+    IsWindowHit = pSyncData->IsReady && (0 < pSyncData->ValidCount) &&
+        ( (0 == pSyncData->FirstEntryIndex) || (pSyncData->ReadBuffer[0] < Reference)) &&
+        ( (pSyncData->FirstEntryIndex + pSyncData->ValidCount >= pTrackInfo->STSSEntries) ||
+          (pSyncData->ReadBuffer[pSyncData->ValidCount-1] >= Reference));
 
-        for (i = 0; i < ReadCount; i++)
+    if (!IsWindowHit)
+    {
+        // Binary search over the table in the file until the lower bound
+        // fits in one window, then load the window starting just before it
+        Low = 0;
+        High = pTrackInfo->STSSEntries;
+        while (High - Low > STSS_BUFF_SIZE - 2)
         {
-            pSyncData->ReadBuffer[i] = NV_BE_TO_INT_32 ( (NvU8 *) & pSyncData->ReadBuffer[i]);
+            Mid = Low + (High - Low) / 2;
+            NVMM_CHK_ERR (Mp4ReadSTSSEntries (pNvMp4Parser, pTrackInfo, Mid, 1, &Value));
+            if (Value < Reference)
+                Low = Mid + 1;
+            else
+                High = Mid;
         }
-        pSyncData->ValidCount = ReadCount;
+
+        pSyncData->IsReady = NV_FALSE;
+        pSyncData->FirstEntryIndex = Low ? (Low - 1) : 0;
+        pSyncData->ValidCount = pTrackInfo->STSSEntries - pSyncData->FirstEntryIndex;
+        if (pSyncData->ValidCount > STSS_BUFF_SIZE)
+            pSyncData->ValidCount = STSS_BUFF_SIZE;
+        NVMM_CHK_ERR (Mp4ReadSTSSEntries (pNvMp4Parser, pTrackInfo, pSyncData->FirstEntryIndex,
+                                          pSyncData->ValidCount, pSyncData->ReadBuffer));
         pSyncData->IsReady = NV_TRUE;
     }
 
-    // check if the index we are looking for is in the ReadBuffer
-    if (0 < pSyncData->ValidCount)
+    // First sync sample at or after Reference
+    Entry = pSyncData->FirstEntryIndex +
+            NvMMSeekIndexLowerBound ( (const NvU32 *) pSyncData->ReadBuffer, pSyncData->ValidCount, (NvU32) Reference);
+
+    if (Direction)
+    {
+        // Past the last sync sample, stay on it
+        if (Entry >= pTrackInfo->STSSEntries)
+            Entry = pTrackInfo->STSSEntries - 1;
+    }
+    else
+    {
+        // No sync sample before Reference
+        NVMM_CHK_ARG (Entry > 0);
+        Entry--;
+    }
+
+    return pSyncData->ReadBuffer[Entry - pSyncData->FirstEntryIndex];
+
+cleanup:
+    return -1;
+}
+
+/*
+ * Returns stts entry Entry of the track, reading the table through
+ * pTempBuffer one window at a time.
+ */
+static NvError
+Mp4ReadSTTSEntry (
+    NvMp4Parser *pNvMp4Parser,
+    const NvMp4TrackInformation *pTrackInfo,
+    NvU32 Entry,
+    NvU32 *pWindowStart,
+    NvU32 *pWindowCount,
+    NvU32 *pSampleCount,
+    NvU32 *pSampleDelta)
+{
+    NvError Status = NvSuccess;
+    NvU64 FileOffset;
+    NvU32 Count;
+    NvU8 *pEntry;
+
+    if ( (Entry < *pWindowStart) || (Entry >= *pWindowStart + *pWindowCount))
+    {
+        Count = pTrackInfo->STTSEntries - Entry;
+        if (Count > READ_BULK_DATA_SIZE / 8)
+            Count = READ_BULK_DATA_SIZE / 8;
+
+        FileOffset = pTrackInfo->STTSOffset + 16 + (NvU64) Entry * 8;
+        *pWindowCount = 0;
+        NVMM_CHK_CP (pNvMp4Parser->pPipe->SetPosition64 (pNvMp4Parser->hContentPipe, (CPint64) FileOffset, CP_OriginBegin));
+        NVMM_CHK_CP (pNvMp4Parser->pPipe->cpipe.Read (pNvMp4Parser->hContentPipe, (CPbyte *) pNvMp4Parser->pTempBuffer, Count * 8));
+        *pWindowStart = Entry;
+        *pWindowCount = Count;
+    }
+
+    pEntry = &pNvMp4Parser->pTempBuffer[(Entry - *pWindowStart) * 8];
+    *pSampleCount = NV_BE_TO_INT_32 (&pEntry[0]);
+    *pSampleDelta = NV_BE_TO_INT_32 (&pEntry[4]);
+
+cleanup:
+    return Status;
+}
+
+/*
+ * Walks the video stts on from the last seek index point, adding a point
+ * every MP4_SEEK_INDEX_GRANULARITY samples, until a point after MediaTime
+ * has been added or the table ends.
+ */
+static NvError
+Mp4ExtendSeekIndex (
+    NvMp4Parser *pNvMp4Parser,
+    const NvMp4TrackInformation *pTrackInfo,
+    NvU64 MediaTime)
+{
+    NvError Status = NvSuccess;
+    NvMMSeekPoint Point;
+    NvU32 Entry, Used, Sample, Step;
+    NvU32 SampleCount = 0, SampleDelta = 0;
+    NvU32 WindowStart = 0, WindowCount = 0;
+    NvU64 Time;
+
+    if (!NvMMSeekIndexGetLastPoint (pNvMp4Parser->hVideoSeekIndex, &Point))
+    {
+        NvOsMemset (&Point, 0, sizeof (NvMMSeekPoint));
+        Point.Offset = NVMM_SEEKINDEX_OFFSET_UNKNOWN;
+        NVMM_CHK_ERR (NvMMSeekIndexAddPoint (pNvMp4Parser->hVideoSeekIndex, &Point));
+    }
+
+    Entry = Point.Cursor[0];
+    Used = Point.Cursor[1];
+    Sample = Point.Sample;
+    Time = Point.Time;
+
+    while (Point.Time <= MediaTime)
     {
-        if ( (Reference > pSyncData->ReadBuffer[0]) && (Reference <= pSyncData->ReadBuffer[pSyncData->ValidCount-1]))
+        if (Entry >= pTrackInfo->STTSEntries)
         {
-            //this is a hit, get the index
-            // TODO: binary search would be faster
-            for (i = 0; i < (pSyncData->ValidCount - 1); i++)
-            {
-                if ( (Reference <= pSyncData->ReadBuffer[i+1]) && (Reference >= pSyncData->ReadBuffer[i]))
-                {
-                    if (Direction)
-                    {
-                        if ( (Reference == pSyncData->ReadBuffer[i]) && (pNvMp4Parser->rate == 0 || pNvMp4Parser->rate == 1000))
-                        {
-                            return pSyncData->ReadBuffer[i];
-                        }
-                        else
-                        {
-                            return pSyncData->ReadBuffer[i+1];
-                        }
-                    }
-                    else
-                    {
-                        if (Reference > pSyncData->ReadBuffer[i])
-                        {
-                            return pSyncData->ReadBuffer[i];
-                        }
-                        else
-                        {
-                            // means equal
-                            return pSyncData->ReadBuffer[i-1];
-                        }
-                    }
-                }
-            }
+            pNvMp4Parser->IsVideoSeekIndexComplete = NV_TRUE;
+            break;
         }
-        //check the corner cases
-        else if (Direction && (Reference == pSyncData->ReadBuffer[0]))
+
+        NVMM_CHK_ERR (Mp4ReadSTTSEntry (pNvMp4Parser, pTrackInfo, Entry, &WindowStart, &WindowCount,
+                                        &SampleCount, &SampleDelta));
+
+        Step = Point.Sample + MP4_SEEK_INDEX_GRANULARITY - Sample;
+        if (Used + Step < SampleCount)
         {
-            return pSyncData->ReadBuffer[1];
+            // Next point falls inside this entry
+            Used += Step;
+            Sample += Step;
+            Time += (NvU64) Step * SampleDelta;
+
+            Point.Time = Time;
+            Point.Sample = Sample;
+            Point.Cursor[0] = Entry;
+            Point.Cursor[1] = Used;
+            NVMM_CHK_ERR (NvMMSeekIndexAddPoint (pNvMp4Parser->hVideoSeekIndex, &Point));
         }
-        else if (!Direction && (Reference == pSyncData->ReadBuffer[pSyncData->ValidCount-1]))
+        else
         {
-            return pSyncData->ReadBuffer[pSyncData->ValidCount-2];
+            Sample += SampleCount - Used;
+            Time += (NvU64) (SampleCount - Used) * SampleDelta;
+            Entry++;
+            Used = 0;
         }
     }
-    //no match, check if reloading the ReadBuffer would help
-    //first find out if need to load previous or later records
-    IsPreviousSyncUnit = NV_FALSE;
-    if (Reference < pSyncData->ReadBuffer[0])
-    {
-        IsPreviousSyncUnit = NV_TRUE;
-    }
 
-    // check the corner cases first
-    if (IsPreviousSyncUnit && (0 == pSyncData->FirstEntryIndex))
+cleanup:
+    return Status;
+}
+
+NvError
+NvMp4ParserTimeToSample (
+    NvMp4Parser *pNvMp4Parser,
+    NvU64 MediaTime,
+    NvU32 *pSample)
+{
+    NvError Status = NvSuccess;
+    NvMp4TrackInformation *pTrackInfo = NULL;
+    NvMMSeekPoint Point;
+    NvU32 Entry, Used, Sample, Remaining;
+    NvU32 SampleCount = 0, SampleDelta = 0;
+    NvU32 WindowStart = 0, WindowCount = 0;
+    NvU64 Time, Skip;
+
+    NVMM_CHK_ARG (pNvMp4Parser && pNvMp4Parser->hVideoSeekIndex && pSample);
+    NVMM_CHK_ARG (pNvMp4Parser->VideoIndex < MAX_TRACKS);
+
+    pTrackInfo = &pNvMp4Parser->TrackInfo[pNvMp4Parser->VideoIndex];
+
+    // A constant rate table has always been looked up by the end of each
+    // sample: the sample that contains MediaTime is returned
+    if (pTrackInfo->STTSEntries == 1)
     {
-        NVMM_CHK_ARG(Direction);
-        return pSyncData->ReadBuffer[0];
+        NVMM_CHK_ERR (Mp4ReadSTTSEntry (pNvMp4Parser, pTrackInfo, 0, &WindowStart, &WindowCount,
+                                        &SampleCount, &SampleDelta));
+        Skip = 0;
+        if (MediaTime > 0)
+            Skip = SampleDelta ? ( (MediaTime + SampleDelta - 1) / SampleDelta - 1) : SampleCount;
+
+        if (Skip < SampleCount)
+            *pSample = (NvU32) Skip;
+        else
+            Status = NvError_ParserFailure;
+        goto cleanup;
     }
-    if (!IsPreviousSyncUnit && ( (pSyncData->FirstEntryIndex + pSyncData->ValidCount) >= pTrackInfo->STSSEntries))
-        return pSyncData->ReadBuffer[pSyncData->ValidCount-1];
 
-    //update the ReadBuffer
-    if (IsPreviousSyncUnit)
+    // Level one: last checkpoint at or before MediaTime
+    if (!pNvMp4Parser->IsVideoSeekIndexComplete &&
+        (!NvMMSeekIndexGetLastPoint (pNvMp4Parser->hVideoSeekIndex, &Point) || (Point.Time <= MediaTime)))
     {
-        pSyncData->FirstEntryIndex = pSyncData->FirstEntryIndex - (STSS_BUFF_SIZE - 16);
+        NVMM_CHK_ERR (Mp4ExtendSeekIndex (pNvMp4Parser, pTrackInfo, MediaTime));
     }
-    else
+    NVMM_CHK_ERR (NvMMSeekIndexFindTime (pNvMp4Parser->hVideoSeekIndex, MediaTime, &Point));
+
+    // Level two: walk the stts runs of the span following the checkpoint,
+    // at most MP4_SEEK_INDEX_GRANULARITY samples
+    Entry = Point.Cursor[0];
+    Used = Point.Cursor[1];
+    Sample = Point.Sample;
+    Time = Point.Time;
+
+    while (Entry < pTrackInfo->STTSEntries)
     {
-        pSyncData->FirstEntryIndex += pSyncData->ValidCount;
+        NVMM_CHK_ERR (Mp4ReadSTTSEntry (pNvMp4Parser, pTrackInfo, Entry, &WindowStart, &WindowCount,
+                                        &SampleCount, &SampleDelta));
+        if (SampleCount > Used)
+        {
+            Remaining = SampleCount - Used;
+            Skip = 0;
+            if (MediaTime > Time)
+                Skip = SampleDelta ? ( (MediaTime - Time + SampleDelta - 1) / SampleDelta) : Remaining;
+
+            if (Skip < Remaining)
+            {
+                *pSample = Sample + (NvU32) Skip;
+                goto cleanup;
+            }
+
+            Sample += Remaining;
+            Time += (NvU64) Remaining * SampleDelta;
+        }
+        Entry++;
+        Used = 0;
     }
 
-    ReadCount = ((pSyncData->FirstEntryIndex + STSS_BUFF_SIZE) > pTrackInfo->STSSEntries) ?
-                            pTrackInfo->STSSEntries-pSyncData->FirstEntryIndex : STSS_BUFF_SIZE;
+    Status = NvError_ParserFailure;
 
-    FileOffset = pTrackInfo->STSSOffset;
-    FileOffset += 16; /* 16 bytes = 4 size + 4 AtomType + 4 Version-flag + 4 entry*/
-    FileOffset += (pSyncData->FirstEntryIndex * 4);
-    NVMM_CHK_ERR (pNvMp4Parser->pPipe->SetPosition64 (pNvMp4Parser->hContentPipe, (CPint64) FileOffset, CP_OriginBegin));
-    NVMM_CHK_ERR (pPipe->Read (pNvMp4Parser->hContentPipe, (CPbyte *) pSyncData->ReadBuffer, ReadCount * 4));
+cleanup:
+    return Status;
+}
+
+/*
+ * Store stsc, need "sample_desc_index" to switch between stsd entries.
+ * Although we store stsc for both audio and video tracks, switching is only
+ * supported for AVC decoder currently. For other audio/video decoders, we
+ * will have to talk to decoder owners about how to send/switch decoder
+ * specific configuration. The mechanism for AVC decoder is described in
+ * comments of bug#724650
+ */
+static NvError
+Mp4ReadSTSCList (
+    NvMp4Parser *pNvMp4Parser,
+    const NvMp4TrackInformation *pTrackInfo,
+    NvMp4FramingInfo *pFramingInfo)
+{
+    NvError Status = NvSuccess;
+    NvU8 *ReadBuffer;
+    NvU64 i, FileOffset, ReadCount;
+    CP_PIPETYPE *pPipe = &pNvMp4Parser->pPipe->cpipe;
 
-    for (i = 0; i < ReadCount; i++)
+    if(!pFramingInfo->IsValidStsc)
     {
-        pSyncData->ReadBuffer[i] = NV_BE_TO_INT_32 ( (NvU8 *) & pSyncData->ReadBuffer[i]);
-    }
-    pSyncData->ValidCount = ReadCount;
-    // TODO: Remove the recursion and implement a simple loop
-    // do the search again
-    return NvMp4ParserGetNextSyncUnit (pNvMp4Parser , Reference , Direction);
+        NvStscEntry *stsc = NULL;
+        NvStscEntry *stsc_last = NULL;
+        /* 16 bytes = 4 size + 4 AtomType + 4 Version-flag + 4 entry*/
+        FileOffset = pTrackInfo->STSCOffset + 16;
+        NVMM_CHK_CP (pNvMp4Parser->pPipe->SetPosition64(pNvMp4Parser->hContentPipe,
+                (CPint64) FileOffset, CP_OriginBegin));
 
+        // Read STSC data
+        ReadBuffer = pNvMp4Parser->pTempBuffer;
+        ReadCount = 12; /*12=size of a stsc entry*/
+        for (i = 0; i < pTrackInfo->STSCEntries; i++)
+        {
+            stsc = (NvStscEntry*) NvOsAlloc((size_t)(sizeof(NvStscEntry)));
+            NVMM_CHK_MEM (stsc);
+            NvOsMemset(stsc, 0, sizeof(NvStscEntry));
+            if(0 == i)
+            {
+                /*creating list head*/
+                pFramingInfo->StscEntryListHead = stsc;
+            }
+            else
+            {
+                /*append to the last one*/
+                stsc_last->next = stsc;
+            }
+
+            NVMM_CHK_CP (pPipe->Read(pNvMp4Parser->hContentPipe,
+                    (CPbyte *) ReadBuffer, (CPuint) ReadCount));
+
+            stsc->first_chunk = NV_BE_TO_INT_32 (&ReadBuffer[0]);
+            stsc->samples_per_chunk = NV_BE_TO_INT_32 (&ReadBuffer[4]);
+            stsc->sample_desc_index = NV_BE_TO_INT_32 (&ReadBuffer[8]);
+            stsc_last = stsc;
+        }
+        pFramingInfo->IsValidStsc = NV_TRUE;
+    }
 cleanup:
-    return -1;
+    return Status;
 }
 
 /*
@@ -4390,6 +4637,7 @@ MP4PrepareFramingInfo (
     NvU64 *pChunkOffsetArray = NULL, ChunkArrayCount = 0;
     NvU32 ChunkIndexCount = 0;
     NvU32 CumNFramesCount = 0, ChunkFramesRead = 0;
+    NvU32 IndexedFrames = 0;
     NvU64 i, FileOffset, ReadCount, STSCBytesRead;
     NvU32 Factor;
     CP_PIPETYPE *pPipe;
@@ -4407,6 +4655,23 @@ MP4PrepareFramingInfo (
                           (pFramingInfo->MaxFramesPerBlock) :
                           (pFramingInfo->TotalNoFrames % pFramingInfo->MaxFramesPerBlock);
 
+    /* Steps 1-5 come straight from the paged sample index when we have one */
+    if (pFramingInfo->pSampleIndex)
+    {
+        NVMM_CHK_ERR (NvMp4SampleIndexGetSamples (pFramingInfo->pSampleIndex,
+            BlockNum * pFramingInfo->MaxFramesPerBlock, ActualFramesInBlock,
+            pFramingInfo->OffsetTable, pFramingInfo->SizeTable,
+            pFramingInfo->DTSTable, pFramingInfo->CTSTable, &IndexedFrames));
+        if (IndexedFrames < ActualFramesInBlock)
+        {
+            pFramingInfo->IsCorruptedFile = NV_TRUE;
+        }
+        pFramingInfo->ValidFrameCount = (BlockNum * pFramingInfo->MaxFramesPerBlock) + IndexedFrames;
+        NV_LOGGER_PRINT ((NVLOG_MP4_PARSER, NVLOG_DEBUG, "ValidFrameCount = %d - ActualFramesInBlock = %d\n", pFramingInfo->ValidFrameCount, ActualFramesInBlock));
+        NVMM_CHK_ERR (Mp4ReadSTSCList (pNvMp4Parser, pTrackInfo, pFramingInfo));
+        goto cleanup;
+    }
+
     /******* STEP 1 ********/
     /***********************/
     /* read frame sizes */
@@ -4586,50 +4851,7 @@ MP4PrepareFramingInfo (
 
     /******* STEP 6 ********/
     /***********************/
-    /* store stsc, need "sample_desc_index" to switch between stsd entries
-     * Although we store stsc for both audio and video tracks, switching is only
-     * supported for AVC decoder currently. For other audio/video decoders, we
-     * will have to talk to decoder owners about how to send/switch decoder
-     * specific configuration. The mechanism for AVC decoder is described in
-     * comments of bug#724650 */
-    if(!pFramingInfo->IsValidStsc)
-    {
-        NvStscEntry *stsc = NULL;
-        NvStscEntry *stsc_last = NULL;
-        /* 16 bytes = 4 size + 4 AtomType + 4 Version-flag + 4 entry*/
-        FileOffset = pTrackInfo->STSCOffset + 16;
-        NVMM_CHK_CP (pNvMp4Parser->pPipe->SetPosition64(pNvMp4Parser->hContentPipe,
-                (CPint64) FileOffset, CP_OriginBegin));
-
-        // Read STSC data
-        ReadBuffer = pNvMp4Parser->pTempBuffer;
-        ReadCount = 12; /*12=size of a stsc entry*/
-        for (i = 0; i < pTrackInfo->STSCEntries; i++)
-        {
-            stsc = (NvStscEntry*) NvOsAlloc((size_t)(sizeof(NvStscEntry)));
-            NVMM_CHK_MEM (stsc);
-            NvOsMemset(stsc, 0, sizeof(NvStscEntry));
-            if(0 == i)
-            {
-                /*creating list head*/
-                pFramingInfo->StscEntryListHead = stsc;
-            }
-            else
-            {
-                /*append to the last one*/
-                stsc_last->next = stsc;
-            }
-
-            NVMM_CHK_CP (pPipe->Read(pNvMp4Parser->hContentPipe,
-                    (CPbyte *) ReadBuffer, (CPuint) ReadCount));
-
-            stsc->first_chunk = NV_BE_TO_INT_32 (&ReadBuffer[0]);
-            stsc->samples_per_chunk = NV_BE_TO_INT_32 (&ReadBuffer[4]);
-            stsc->sample_desc_index = NV_BE_TO_INT_32 (&ReadBuffer[8]);
-            stsc_last = stsc;
-        }
-        pFramingInfo->IsValidStsc = NV_TRUE;
-    }
+    NVMM_CHK_ERR (Mp4ReadSTSCList (pNvMp4Parser, pTrackInfo, pFramingInfo));
 cleanup:
     if (pChunkOffsetArray)
     {
@@ -5281,6 +5503,83 @@ Mp4ReadAudioStreamingData (
     return (NvSuccess);
 }
 
+/**
+ * Publishes the byte ranges of the next MP4_READAHEAD_FRAMES samples of the
+ * track to the content pipe, so that its read-ahead follows the sample
+ * layout of each track instead of the file order. Published again once half
+ * of the window is consumed or when the track moves outside it. Failures
+ * are ignored, the pipe then keeps reading ahead sequentially.
+ */
+static void
+Mp4PublishReadAheadRanges (
+    NvMp4Parser * pNvMp4Parser,
+    NvU32 TrackIndex)
+{
+    NvMp4FramingInfo *pNvMp4FramingInfo = &pNvMp4Parser->FramingInfo[TrackIndex];
+    CP_ByteRange Ranges[MP4_READAHEAD_RANGES];
+    CP_ConfigReadAheadRanges Config;
+    NvU32 FirstFrame = pNvMp4FramingInfo->FrameCounter;
+    NvU32 BlockStart = pNvMp4FramingInfo->CurrentBlock * pNvMp4FramingInfo->MaxFramesPerBlock;
+    NvU32 LastFrame, Frame, Size;
+    NvU64 Offset;
+    NvU32 Count = 0;
+
+    if (pNvMp4Parser->IsStreaming || !pNvMp4Parser->pPipe->SetConfig ||
+        TrackIndex >= CP_READAHEAD_MAX_STREAMS ||
+        (pNvMp4Parser->rate > 2000) || (pNvMp4Parser->rate < 0))
+        return;
+
+    if (FirstFrame >= pNvMp4FramingInfo->ReadAheadStart &&
+        FirstFrame - pNvMp4FramingInfo->ReadAheadStart <
+        (pNvMp4FramingInfo->ReadAheadEnd - pNvMp4FramingInfo->ReadAheadStart) / 2)
+        return;
+
+    /* The framing tables only hold the current block */
+    LastFrame = FirstFrame + MP4_READAHEAD_FRAMES;
+    if (LastFrame > BlockStart + pNvMp4FramingInfo->MaxFramesPerBlock)
+        LastFrame = BlockStart + pNvMp4FramingInfo->MaxFramesPerBlock;
+    if (LastFrame > pNvMp4FramingInfo->TotalNoFrames)
+        LastFrame = pNvMp4FramingInfo->TotalNoFrames;
+    if (pNvMp4FramingInfo->IsCorruptedFile && LastFrame > pNvMp4FramingInfo->ValidFrameCount)
+        LastFrame = pNvMp4FramingInfo->ValidFrameCount;
+
+    /* Near the end of a block or of the track the window shrinks to a frame
+     * and the half window test above passes on every frame. Keep the last
+     * ranges until a new block gives a window worth publishing. */
+    if (pNvMp4FramingInfo->ReadAheadEnd - pNvMp4FramingInfo->ReadAheadStart <= 1 &&
+        LastFrame <= FirstFrame + 1)
+        return;
+
+    for (Frame = FirstFrame; Frame < LastFrame; Frame++)
+    {
+        Offset = pNvMp4FramingInfo->OffsetTable[Frame - BlockStart];
+        Size = pNvMp4FramingInfo->SizeTable[Frame - BlockStart];
+        if (!Size || Offset >= pNvMp4Parser->FileSize)
+            continue;
+
+        if (Count && Offset == Ranges[Count - 1].Offset + Ranges[Count - 1].Size)
+        {
+            Ranges[Count - 1].Size += Size;
+        }
+        else
+        {
+            if (Count == MP4_READAHEAD_RANGES)
+                break;
+            Ranges[Count].Offset = Offset;
+            Ranges[Count].Size = Size;
+            Count++;
+        }
+    }
+
+    Config.StreamIndex = TrackIndex;
+    Config.Count = Count;
+    Config.pRanges = Ranges;
+    (void)pNvMp4Parser->pPipe->SetConfig (pNvMp4Parser->hContentPipe, CP_ConfigIndexReadAheadRanges, &Config);
+
+    pNvMp4FramingInfo->ReadAheadStart = FirstFrame;
+    pNvMp4FramingInfo->ReadAheadEnd = Frame;
+}
+
 static NvError
 Mp4ReadData (
     NvMp4Parser * pNvMp4Parser,
@@ -5320,6 +5619,7 @@ Mp4ReadData (
     }
 
     NVMM_CHK_ERR (Mp4PrepareFramingInfoPLAY (pNvMp4Parser, pNvMp4FramingInfo->FrameCounter, pTrackInfo, pNvMp4FramingInfo));
+    Mp4PublishReadAheadRanges (pNvMp4Parser, TrackIndex);
 
     TempBufferOffset  = pNvMp4FramingInfo->OffsetTable[pNvMp4FramingInfo->FrameCounter - (pNvMp4FramingInfo->CurrentBlock*pNvMp4FramingInfo->MaxFramesPerBlock) ];
     (*pMaxFrameBytes) = pNvMp4FramingInfo->SizeTable[pNvMp4FramingInfo->FrameCounter - (pNvMp4FramingInfo->CurrentBlock*pNvMp4FramingInfo->MaxFramesPerBlock) ];
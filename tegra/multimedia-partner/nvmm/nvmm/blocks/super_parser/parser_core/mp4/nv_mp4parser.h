@@ -14,7 +14,9 @@
 #include "nvmm.h"
 #include "nvmm_parser.h"
 #include "nvmm_ulp_util.h"
+#include "nvmm_seekindex.h"
 #include "nv_mp4parser_defines.h"
+#include "nv_mp4_sampleindex.h"
 #include "nvlocalfilecontentpipe.h"
 #include "nvdrm.h"
 #define MAX_AVCC_COUNT MAX_DECSPECINFO_COUNT
@@ -28,6 +30,9 @@ typedef struct NvMP4ParserRec
     NvMp4MovieData MvHdData;
     NvMp4MediaMetadata MediaMetadata;
     NvMp4SynchUnitData VideoSyncData;
+    /* stts checkpoints of the video track, built lazily on time seeks */
+    NvMMSeekIndexHandle hVideoSeekIndex;
+    NvBool IsVideoSeekIndexComplete;
     NvAVCConfigData *pAVCConfigData[MAX_AVCC_COUNT];
     NvU32 nAVCConfigCount;
     NvAVCConfigData *pCurAVCConfigData; /*keep track of the current activated avcC*/
@@ -141,6 +146,18 @@ NvMp4ParserGetNextSyncUnit (
     NvS32 Reference,
     NvBool Direction);
 
+/**
+ * Returns in pSample the 0 based number of the first video sample whose
+ * decode time is not before MediaTime (in media time scale units). With a
+ * single stts entry it is the sample whose duration contains MediaTime.
+ * Returns NvError_ParserFailure when MediaTime is past the last sample.
+ */
+NvError
+NvMp4ParserTimeToSample (
+    NvMp4Parser *pNvMp4Parser,
+    NvU64 MediaTime,
+    NvU32 *pSample);
+
 
 NvError
 NvMp4ParserSetMediaDuration (
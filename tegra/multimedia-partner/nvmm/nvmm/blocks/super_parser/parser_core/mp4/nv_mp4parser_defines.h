@@ -144,6 +144,11 @@ static const unsigned char NvLeadingZerosTable[2048] =
  */
 #define STSS_BUFF_SIZE      (8192*4)
 
+/**
+ * Samples between two points of the video seek index
+ */
+#define MP4_SEEK_INDEX_GRANULARITY  1024
+
 /**
  * MP4 Atoms FOURCC definition
  *
@@ -202,6 +207,8 @@ static const unsigned char NvLeadingZerosTable[2048] =
 #define VIDEO_TRACK 2
 
 #define NUM_FRAMES_IN_BLOCK      5120  /* so that it is integral number of sectors (512 bytes) */
+#define MP4_READAHEAD_FRAMES     128   /* samples per track published to the content pipe read-ahead */
+#define MP4_READAHEAD_RANGES     16    /* byte ranges per track published to the content pipe read-ahead */
 
 /*
  * Misc definitions
@@ -427,6 +434,9 @@ typedef struct NvMp4FramingInfoRec
     NvU32 MaxFrameSize;
     NvStscEntry *StscEntryListHead;
     NvBool IsValidStsc;
+    struct NvMp4SampleIndexRec *pSampleIndex; /* NULL if the tables are walked per block */
+    NvU32 ReadAheadStart; /* frames [ReadAheadStart, ReadAheadEnd) are published to the content pipe */
+    NvU32 ReadAheadEnd;
 } NvMp4FramingInfo;
 
 
@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2013 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an
+ * express license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+/*
+ * MP4 seek lookup check.
+ *
+ * Builds stts and stss tables in memory, serves them to the parser through a
+ * content pipe over that memory, and compares NvMp4ParserTimeToSample and
+ * NvMp4ParserGetNextSyncUnit with the linear scans they replaced, for every
+ * table in the tables below. Times and sample numbers are looked up in
+ * order and then at random, so that both the seek index being built and
+ * the one already built are used, as are the stss windows being reloaded.
+ *
+ * The scans are those of the parser before the seek index, with the stss
+ * table read as a single window. The old parser skipped to the second sync
+ * sample of a window when asked for the first, and going back from the
+ * first sync sample of the track fell through to the last one; the
+ * references return the sync sample itself and no sync sample instead.
+ *
+ * usage: nv_mp4parser_seek_check
+ */
+
+#include <stdio.h>
+
+#include "nvos.h"
+#include "nv_mp4parser.h"
+
+#define CHECK_MAX_STTS          6000
+#define CHECK_MAX_STSS          100000
+#define CHECK_RANDOM_LOOKUPS    4000
+
+typedef struct CheckSttsTableRec
+{
+    const char *szName;
+    NvU32 nRuns;
+    NvU32 nPattern;             /* runs repeat these entries */
+    NvU32 Pattern[4][2];        /* sample count, sample delta */
+} CheckSttsTable;
+
+typedef struct CheckStssTableRec
+{
+    const char *szName;
+    NvU32 nEntries;
+    NvU32 First;                /* 1 based, as in the file */
+    NvU32 nGaps;
+    NvU32 Gaps[4];              /* entries follow each other by these */
+} CheckStssTable;
+
+static const CheckSttsTable s_SttsTables[] =
+{
+    { "constant rate",          1, 1, { { 3000, 1001 } } },
+    { "constant rate, one",     1, 1, { { 1, 512 } } },
+    { "constant rate, zero",    1, 1, { { 10, 0 } } },
+    { "two rates",              2, 2, { { 40, 3003 }, { 2000, 1001 } } },
+    { "zero delta runs",        9, 3, { { 1, 0 }, { 7, 1001 }, { 3, 0 } } },
+    // seek index points inside a run of equal times
+    { "long zero delta run",    3, 3, { { 1000, 1001 }, { 3000, 0 }, { 10, 1001 } } },
+    // more entries than one stts read and samples than one seek index span
+    { "pulldown",    CHECK_MAX_STTS, 4, { { 1, 1001 }, { 2, 1502 }, { 1, 1001 }, { 20, 1000 } } },
+};
+
+static const CheckStssTable s_StssTables[] =
+{
+    { "none",                   0,      0,  0, { 0 } },
+    { "one",                    1,      1,  1, { 1 } },
+    { "one, not first",         1,      25, 1, { 1 } },
+    { "every 30",               200,    1,  1, { 30 } },
+    { "two",                    2,      1,  1, { 12 } },
+    // more entries than one stss window
+    { "irregular",  CHECK_MAX_STSS,     1,  4, { 1, 7, 3, 24 } },
+};
+
+static NvU8 *s_pFile;
+static NvU64 s_FileSize;
+static NvU64 s_Position;
+static NvU64 s_Random = 12345;
+
+static CPresult CheckPipeSetPosition64(CPhandle hContent, CPint64 nOffset, CP_ORIGINTYPE eOrigin)
+{
+    if (eOrigin != CP_OriginBegin || nOffset < 0 || (NvU64)nOffset > s_FileSize)
+        return NvError_BadParameter;
+    s_Position = (NvU64)nOffset;
+    return NvSuccess;
+}
+
+static CPresult CheckPipeRead(CPhandle hContent, CPbyte *pData, CPuint nSize)
+{
+    if (s_Position + nSize > s_FileSize)
+        return NvError_EndOfFile;
+    NvOsMemcpy(pData, s_pFile + s_Position, nSize);
+    s_Position += nSize;
+    return NvSuccess;
+}
+
+static NvU32 CheckRandom(NvU32 Range)
+{
+    s_Random = s_Random * 6364136223846793005ULL + 1442695040888963407ULL;
+    return Range ? ((NvU32)(s_Random >> 32) % Range) : 0;
+}
+
+static void CheckPut32(NvU8 *p, NvU32 Value)
+{
+    p[0] = (NvU8)(Value >> 24);
+    p[1] = (NvU8)(Value >> 16);
+    p[2] = (NvU8)(Value >> 8);
+    p[3] = (NvU8)Value;
+}
+
+/* Writes an atom of Count entries at s_FileSize, returns its offset */
+static NvU64 CheckPutAtom(const NvU32 *pValues, NvU32 Count)
+{
+    NvU64 Offset = s_FileSize;
+    NvU32 i;
+
+    // 4 size + 4 AtomType + 4 Version-flag + 4 entry count
+    CheckPut32(s_pFile + Offset, 16 + Count * 4);
+    CheckPut32(s_pFile + Offset + 12, Count);
+    for (i = 0; i < Count; i++)
+        CheckPut32(s_pFile + Offset + 16 + i * 4, pValues[i]);
+    s_FileSize += 16 + (NvU64)Count * 4;
+    return Offset;
+}
+
+static NvError CheckOpen(NvMp4Parser *pParser, CP_PIPETYPE_EXTENDED *pPipe)
+{
+    NvOsMemset(pParser, 0, sizeof(NvMp4Parser));
+    pParser->pPipe = pPipe;
+    pParser->VideoIndex = 0;
+    pParser->rate = 1000;
+    s_FileSize = 0;
+    return NvMMSeekIndexCreate(&pParser->hVideoSeekIndex, MP4_SEEK_INDEX_GRANULARITY);
+}
+
+static void CheckClose(NvMp4Parser *pParser)
+{
+    NvMMSeekIndexDestroy(pParser->hVideoSeekIndex);
+}
+
+/*
+ * The time to sample loop of Mp4ParserTrackTimeToSampleChunk before the seek
+ * index. Returns -1 for NvError_ParserFailure.
+ */
+static NvS64 CheckOldTimeToSample(const NvU32 *pStts, NvU32 EntryCount, NvU64 RequestedTime)
+{
+    NvU64 FrameCount = 0, TimeIncrement = 0;
+    NvU32 i, k, SampleCount, SampleDelta;
+
+    for (i = 0; i < EntryCount; i++)
+    {
+        SampleCount = pStts[i * 2];
+        SampleDelta = pStts[i * 2 + 1];
+        if (EntryCount == 1)
+        {
+            // all frames have a constant incrementing time stamp
+            TimeIncrement = (NvU64)SampleDelta;
+        }
+        for (k = 0; k < SampleCount; k++)
+        {
+            if (TimeIncrement >= RequestedTime)
+                return (NvS64)FrameCount;
+            FrameCount++;
+            TimeIncrement += SampleDelta;
+        }
+    }
+    return -1;
+}
+
+/*
+ * The in window scan of NvMp4ParserGetNextSyncUnit before the seek index,
+ * over the whole table.
+ */
+static NvS32 CheckOldSyncUnit(const NvU32 *pStss, NvU32 Count, NvS32 Reference, NvBool Direction)
+{
+    const NvS32 *pTable = (const NvS32 *)pStss;
+    NvU32 i;
+
+    if (Reference == 0)
+        return Reference;
+    if (Count == 0)
+        return Reference + 1;
+
+    if ((Reference > pTable[0]) && (Reference <= pTable[Count - 1]))
+    {
+        for (i = 0; i < Count - 1; i++)
+        {
+            if ((Reference <= pTable[i + 1]) && (Reference >= pTable[i]))
+            {
+                if (Direction)
+                    return (Reference == pTable[i]) ? pTable[i] : pTable[i + 1];
+                return (Reference > pTable[i]) ? pTable[i] : pTable[i - 1];
+            }
+        }
+    }
+
+    if (Reference <= pTable[0])
+        return Direction ? pTable[0] : -1;
+    return pTable[Count - 1];
+}
+
+static void CheckTimeToSample(NvMp4Parser *pParser, const CheckSttsTable *pTable, const NvU32 *pEntries,
+                              NvU64 Time, NvU32 *pnFailed)
+{
+    NvS64 Expected, Actual;
+    NvU32 Sample;
+
+    Expected = CheckOldTimeToSample(pEntries, pTable->nRuns, Time);
+    Actual = (NvMp4ParserTimeToSample(pParser, Time, &Sample) == NvSuccess) ? (NvS64)Sample : -1;
+    if ((Actual != Expected) && ((*pnFailed)++ < 5))
+    {
+        printf("  stts %s: time %llu sample %lld, was %lld\n", pTable->szName,
+               (unsigned long long)Time, (long long)Actual, (long long)Expected);
+    }
+}
+
+static NvBool CheckStts(NvMp4Parser *pParser, CP_PIPETYPE_EXTENDED *pPipe, const CheckSttsTable *pTable,
+                        NvU32 *pEntries)
+{
+    NvMp4TrackInformation *pTrackInfo = &pParser->TrackInfo[0];
+    NvU64 Duration = 0, Time, Step;
+    NvU32 i, nLookups = 0, nFailed = 0;
+
+    if (CheckOpen(pParser, pPipe) != NvSuccess)
+        return NV_FALSE;
+
+    for (i = 0; i < pTable->nRuns; i++)
+    {
+        pEntries[i * 2] = pTable->Pattern[i % pTable->nPattern][0];
+        pEntries[i * 2 + 1] = pTable->Pattern[i % pTable->nPattern][1];
+        Duration += (NvU64)pEntries[i * 2] * pEntries[i * 2 + 1];
+    }
+    pTrackInfo->STTSEntries = pTable->nRuns;
+    pTrackInfo->STTSOffset = CheckPutAtom(pEntries, pTable->nRuns * 2);
+
+    // every time from 0 up to past the end, then at random
+    Step = Duration / 20000 + 1;
+    for (Time = 0; Time <= Duration + 2 * Step; Time += CheckRandom((NvU32)Step) + 1, nLookups++)
+        CheckTimeToSample(pParser, pTable, pEntries, Time, &nFailed);
+    for (i = 0; i < CHECK_RANDOM_LOOKUPS; i++, nLookups++)
+    {
+        Time = CheckRandom((NvU32)Duration + 2) + (CheckRandom(4) ? 0 : Duration);
+        CheckTimeToSample(pParser, pTable, pEntries, Time, &nFailed);
+    }
+
+    printf("stts %-20s %6u lookups, %u wrong\n", pTable->szName, nLookups, nFailed);
+    CheckClose(pParser);
+    return nFailed ? NV_FALSE : NV_TRUE;
+}
+
+static void CheckSyncUnit(NvMp4Parser *pParser, const CheckStssTable *pTable, const NvU32 *pEntries,
+                          NvS32 Reference, NvBool Direction, NvU32 *pnFailed)
+{
+    static const NvS32 s_Rates[] = { 1000, 4000, -2000 };
+    NvS32 Expected, Actual;
+
+    pParser->rate = s_Rates[CheckRandom(NV_ARRAY_SIZE(s_Rates))];
+    Expected = CheckOldSyncUnit(pEntries, pTable->nEntries, Reference, Direction);
+    Actual = NvMp4ParserGetNextSyncUnit(pParser, Reference, Direction);
+    if ((Actual != Expected) && ((*pnFailed)++ < 5))
+    {
+        printf("  stss %s: sample %d %s rate %d gave %d, was %d\n", pTable->szName, Reference,
+               Direction ? "forward" : "back", pParser->rate, Actual, Expected);
+    }
+}
+
+static NvBool CheckStss(NvMp4Parser *pParser, CP_PIPETYPE_EXTENDED *pPipe, const CheckStssTable *pTable,
+                        NvU32 *pEntries)
+{
+    NvMp4TrackInformation *pTrackInfo = &pParser->TrackInfo[0];
+    NvU32 i, nLookups = 0, nFailed = 0, Last, Step;
+    NvS32 Reference;
+
+    if (CheckOpen(pParser, pPipe) != NvSuccess)
+        return NV_FALSE;
+
+    for (i = 0; i < pTable->nEntries; i++)
+        pEntries[i] = i ? (pEntries[i - 1] + pTable->Gaps[i % pTable->nGaps]) : pTable->First;
+    Last = pTable->nEntries ? pEntries[pTable->nEntries - 1] : 100;
+    pTrackInfo->STSSEntries = pTable->nEntries;
+    pTrackInfo->STSSOffset = CheckPutAtom(pEntries, pTable->nEntries);
+
+    // samples from 0 up to past the end each way, then at random
+    Step = Last / 20000 + 1;
+    for (Reference = 0; Reference <= (NvS32)Last + 2; Reference += CheckRandom(Step) + 1, nLookups += 2)
+    {
+        CheckSyncUnit(pParser, pTable, pEntries, Reference, NV_TRUE, &nFailed);
+        CheckSyncUnit(pParser, pTable, pEntries, Reference, NV_FALSE, &nFailed);
+    }
+    for (i = 0; i < CHECK_RANDOM_LOOKUPS; i++, nLookups++)
+    {
+        Reference = (NvS32)CheckRandom(Last + 3);
+        CheckSyncUnit(pParser, pTable, pEntries, Reference, CheckRandom(2) ? NV_TRUE : NV_FALSE, &nFailed);
+    }
+
+    printf("stss %-20s %6u lookups, %u wrong\n", pTable->szName, nLookups, nFailed);
+    CheckClose(pParser);
+    return nFailed ? NV_FALSE : NV_TRUE;
+}
+
+int main(int argc, char **argv)
+{
+    CP_PIPETYPE_EXTENDED Pipe;
+    NvMp4Parser *pParser;
+    NvU32 *pEntries;
+    NvBool bOk = NV_TRUE;
+    NvU32 i;
+
+    NvOsMemset(&Pipe, 0, sizeof(Pipe));
+    Pipe.SetPosition64 = CheckPipeSetPosition64;
+    Pipe.cpipe.Read = CheckPipeRead;
+
+    pParser = NvOsAlloc(sizeof(NvMp4Parser));
+    pEntries = NvOsAlloc(2 * CHECK_MAX_STSS * sizeof(NvU32));
+    s_pFile = NvOsAlloc(16 + 2 * CHECK_MAX_STSS * sizeof(NvU32));
+    if (!pParser || !pEntries || !s_pFile)
+    {
+        printf("out of memory\n");
+        return 1;
+    }
+
+    for (i = 0; i < NV_ARRAY_SIZE(s_SttsTables); i++)
+        bOk = CheckStts(pParser, &Pipe, &s_SttsTables[i], pEntries) && bOk;
+    for (i = 0; i < NV_ARRAY_SIZE(s_StssTables); i++)
+        bOk = CheckStss(pParser, &Pipe, &s_StssTables[i], pEntries) && bOk;
+
+    NvOsFree(s_pFile);
+    NvOsFree(pEntries);
+    NvOsFree(pParser);
+
+    printf("%s\n", bOk ? "PASSED" : "FAILED");
+    return bOk ? 0 : 1;
+}
@@ -475,6 +475,7 @@ Mp4CoreParserOpen (
     NvU64 MediaTimeScale = 0;
     NvU64 TotalTrackTimeNs = 0;
     NvMMMp4ParserCoreContext *pContext = NULL;
+    NvBool MapContent = NV_TRUE;
 
     NVMM_CHK_ARG (hParserCore && szURI);
     pContext = NvOsAlloc (sizeof (NvMMMp4ParserCoreContext));
@@ -503,6 +504,12 @@ Mp4CoreParserOpen (
 
     if (hParserCore->bUsingCachedCP)
     {
+        // Outside ULP mode the data is only touched by the CPU, so the pipe
+        // may serve it from a mapping of the file instead of its cache pool
+        if (!hParserCore->bEnableUlpMode && pContext->Parser.pPipe->SetConfig)
+        {
+            (void)pContext->Parser.pPipe->SetConfig (pContext->Parser.hContentPipe, CP_ConfigIndexMapContent, &MapContent);
+        }
         NVMM_CHK_ERR (pContext->Parser.pPipe->InitializeCP (pContext->Parser.hContentPipe,
             hParserCore->MinCacheSize,
             hParserCore->MaxCacheSize,
@@ -743,90 +750,18 @@ NvError Mp4ParserTrackTimeToSampleChunk (NvMp4Parser *pNvMp4Parser, NvU64 Refren
 {
     NvError Status = NvSuccess;
     NvU64 RequestedTime = 0;
-    NvU32 EntryCount = 0;
-    NvU32 EntrySize = 0;
-    NvU32 ReadCount = 0;
-    NvU32 TotalReadCount = 0;
-    NvU32 i = 0, j = 0;
-    NvBool ReferenceIdentified = NV_FALSE;
-    NvU64 FileOffset = 0;
-    NvU8 *ReadBuffer = NULL;
-    NvU64 FrameCount = 0, TimeIncrement = 0;
-    NvU32 k = 0, SampleCount = 0,  SampleDelta = 0;
-    NvMp4TrackInformation *pTrackInfo = NULL;
+    NvU32 Sample = 0;
 
     NV_LOGGER_PRINT((NVLOG_MP4_PARSER, NVLOG_DEBUG, "++%s[%d]", __FUNCTION__, __LINE__));
     NVMM_CHK_ARG (pNvMp4Parser);
 
     RequestedTime = ((RefrenceTime*(NvU64)pNvMp4Parser->TrackInfo[pNvMp4Parser->VideoIndex].TimeScale)/(10*TICKS_PER_SECOND));
-    pTrackInfo = &pNvMp4Parser->TrackInfo[pNvMp4Parser->VideoIndex];
-    // Now find the corresponding Frame for this time.
-    // read STTS
-    FileOffset = pTrackInfo->STTSOffset + 16;
-    NVMM_CHK_CP (pNvMp4Parser->pPipe->SetPosition64 (pNvMp4Parser->hContentPipe, (CPint64) FileOffset, CP_OriginBegin));
-
-    EntryCount = pTrackInfo->STTSEntries;
-    EntrySize = sizeof (NvU32) *2;
-    TotalReadCount = EntryCount * EntrySize;
-    for (i = 0; i <= TotalReadCount / READ_BULK_DATA_SIZE; i++)
-    {
-        ReadBuffer = pNvMp4Parser->pTempBuffer;
-        ReadCount = (i < TotalReadCount / READ_BULK_DATA_SIZE) ? READ_BULK_DATA_SIZE : (TotalReadCount % READ_BULK_DATA_SIZE);
-        if (ReadCount > 0)
-            NVMM_CHK_CP (pNvMp4Parser->pPipe->cpipe.Read (pNvMp4Parser->hContentPipe, (CPbyte *) ReadBuffer, (CPuint) ReadCount));
-        for (j = 0; j < ReadCount; j += EntrySize, ReadBuffer += EntrySize)
-        {
-            if (EntryCount == 1)
-            {
-                // EntryCount == 1: indicates all frames are have constant incrementing time stamp
-                SampleCount = NV_BE_TO_INT_32 (&ReadBuffer[0]);
-                SampleDelta = NV_BE_TO_INT_32 (&ReadBuffer[4]);
-                TimeIncrement =  (NvU64) SampleDelta;
-                for (k = 0; k < SampleCount; k++)
-                {
-                if (TimeIncrement >= RequestedTime)
-                {
-                    *RefrenceFrame = FrameCount;
-                    Status = NvSuccess;
-                    ReferenceIdentified = NV_TRUE;
-                    NV_LOGGER_PRINT ((NVLOG_MP4_PARSER, NVLOG_DEBUG, "STSS EntryCount 1 :Mp4ParserTrackTimeToSampleChunk RefrenceFrame = %d\n", FrameCount));
-                    goto cleanup; // we are done
-                }
-                FrameCount++;
-                TimeIncrement += SampleDelta;
-                }
-            }
-            else
-            {
-            // sample table is:
-            // 4-byte: # of frames
-            // 4-byte: duration for the given # of frames
-            // Now Scan thru dts sample count and get the refrence frame match for time.
-            //
-                SampleCount = NV_BE_TO_INT_32 (&ReadBuffer[0]);
-                SampleDelta = NV_BE_TO_INT_32 (&ReadBuffer[4]);
-                for (k = 0; k < SampleCount; k++)
-                {
-                    if (TimeIncrement >= RequestedTime)
-                    {
-                        *RefrenceFrame = FrameCount;
-                        Status = NvSuccess;
-                        ReferenceIdentified = NV_TRUE;
-                        NV_LOGGER_PRINT ((NVLOG_MP4_PARSER, NVLOG_DEBUG, "Mp4ParserTrackTimeToSampleChunk RefrenceFrame = %d\n", FrameCount));
-                        goto cleanup; // we are done
-                    }
-                    FrameCount++;
-                    TimeIncrement += SampleDelta;
-                }
-            }
-        }
-    }
+    // Now find the corresponding Frame for this time through the seek index
+    NVMM_CHK_ERR (NvMp4ParserTimeToSample (pNvMp4Parser, RequestedTime, &Sample));
+    *RefrenceFrame = Sample;
+    NV_LOGGER_PRINT ((NVLOG_MP4_PARSER, NVLOG_DEBUG, "Mp4ParserTrackTimeToSampleChunk RefrenceFrame = %d\n", Sample));
 
 cleanup:
-    if (!ReferenceIdentified)
-    {
-        Status = NvError_ParserFailure;
-    }
     NV_LOGGER_PRINT((NVLOG_MP4_PARSER, NVLOG_DEBUG, "--%s[%d]", __FUNCTION__, __LINE__));
     return Status;
 
@@ -1394,6 +1329,9 @@ Mp4CoreParserSetPosition (
     NVMM_CHK_ARG (hParserCore && hParserCore->pContext && pTimeStamp);
     pContext = (NvMMMp4ParserCoreContext *) hParserCore->pContext;
 
+    if (pContext->Parser.hVideoSeekIndex)
+        NvMMSeekIndexSeekBegin (pContext->Parser.hVideoSeekIndex);
+
     pContext->Parser.SeekVideoFrameCounter = 0;
     pContext->Parser.TempCount = 0;
     TotalTracks = NvMp4ParserGetNumTracks (&pContext->Parser);
@@ -1457,6 +1395,11 @@ Mp4CoreParserSetPosition (
                 TotalTime = ( (StreamDuration * TICKS_PER_SECOND) / MediaTimeScale) * 10;
             else
                 TotalTime = 0;
+
+            // Seeks are expected to complete within one frame interval
+            if (Count && TotalTime && pContext->Parser.hVideoSeekIndex)
+                NvMMSeekIndexSetFrameBudget (pContext->Parser.hVideoSeekIndex, (NvU32) (TotalTime / Count / 10));
+
             if (pTrackInfo->IsELSTPresent && pTrackInfo->ELSTEntries > 2)
             {
                 Status = Mp4ParserTrackTimeToSampleChunk(&pContext->Parser, *pTimeStamp, &DesiredFrame);
@@ -1636,6 +1579,9 @@ cleanup:
             FrameCounter, *pTimeStamp / 10000));
 
         pContext->Parser.SeekVideoFrameCounter = pContext->Parser.FramingInfo[pContext->Parser.AudioIndex].FrameCounter;
+
+        if (pContext->Parser.hVideoSeekIndex)
+            NvMMSeekIndexSeekEnd (pContext->Parser.hVideoSeekIndex);
     }
 
     return Status;
@@ -2204,6 +2150,13 @@ Mp4CoreParserGetAttribute (
 
             break;
         }
+    case NvMMAttribute_SeekStats:
+        {
+            NVMM_CHK_ARG (AttributeSize >= sizeof (NvMMSeekIndexStats));
+            NVMM_CHK_ARG (pContext->Parser.hVideoSeekIndex);
+            NvMMSeekIndexGetStats (pContext->Parser.hVideoSeekIndex, (NvMMSeekIndexStats *) pAttribute);
+        }
+        break;
     default:
         break;
     }
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2008-2010 NVIDIA Corporation.  All rights reserved.
+ * Copyright (c) 2008-2013 NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -13,6 +13,7 @@
 #include "nvmm_queue.h"
 #include "nvmm_debug.h"
 #include "nvmm_3gpwriterblock.h"
+#include "nvmm_mtswriterblock.h"
 #include "nvutil.h"
 
 #define NVLOG_CLIENT NVLOG_NVMM_BASEWRITER
@@ -135,6 +136,14 @@ NvMMBaseWriterBlockSetAttribute(
                             &BaseWriterContext->CoreWriterOps,
                             &BaseWriterContext->WriterContext));
                     }
+                    else if (!NvOsStrcmp(BaseWriterContext->FileExt, "ts") ||
+                        !NvOsStrcmp(BaseWriterContext->FileExt, "m2ts") ||
+                        !NvOsStrcmp(BaseWriterContext->FileExt, "mts"))
+                    {
+                        NVMM_CHK_ERR(NvMMCreateMtsWriterContext(
+                            &BaseWriterContext->CoreWriterOps,
+                            &BaseWriterContext->WriterContext));
+                    }
                     else
                         NVMM_CHK_ARG(0);
                     //Add other writers here
@@ -7,6 +7,7 @@ LOCAL_MODULE := libnvmm_contentpipe
 LOCAL_C_INCLUDES += $(TEGRA_TOP)/multimedia-partner/openmax/include/openmax/il
 
 LOCAL_SRC_FILES += nvmm_contentpipe.c
+LOCAL_SRC_FILES += nvmm_contentpipe_shared.c
 LOCAL_SRC_FILES += nvlocalfilecontentpipe.c
 LOCAL_SRC_FILES += nvmm_customprotocol.c
 LOCAL_SRC_FILES += nvmm_protocol_file.c
@@ -14,6 +15,7 @@ LOCAL_SRC_FILES += nvmm_protocol_http.c
 LOCAL_SRC_FILES += nvmm_protocol_rtsp.c
 LOCAL_SRC_FILES += rtsp.c
 LOCAL_SRC_FILES += rtp.c
+LOCAL_SRC_FILES += rtp_jitter.c
 LOCAL_SRC_FILES += rtp_audio.c
 LOCAL_SRC_FILES += rtp_video.c
 LOCAL_SRC_FILES += rtp_latm.c
@@ -27,4 +29,35 @@ LOCAL_SHARED_LIBRARIES += libnvmm_utils
 #TODO: Remove following lines before include statement and fix the source giving warnings/errors
 LOCAL_NVIDIA_NO_WARNINGS_AS_ERRORS := 1
 include $(NVIDIA_SHARED_LIBRARY)
+
+include $(NVIDIA_DEFAULTS)
+include $(LOCAL_PATH)/../Android.common.mk
+
+LOCAL_MODULE := rtp_jitter_bench
+LOCAL_MODULE_TAGS := nvidia_tests
+
+LOCAL_C_INCLUDES += $(TEGRA_TOP)/multimedia-partner/openmax/include/openmax/il
+
+LOCAL_SRC_FILES += rtp_jitter.c
+LOCAL_SRC_FILES += rtp_jitter_bench.c
+
+LOCAL_SHARED_LIBRARIES += libnvos
+LOCAL_SHARED_LIBRARIES += libnvmm_utils
+
+include $(NVIDIA_EXECUTABLE)
+
+include $(NVIDIA_DEFAULTS)
+include $(LOCAL_PATH)/../Android.common.mk
+
+LOCAL_MODULE := nvmm_contentpipe_shared_bench
+LOCAL_MODULE_TAGS := nvidia_tests
+
+LOCAL_C_INCLUDES += $(TEGRA_TOP)/multimedia-partner/openmax/include/openmax/il
+
+LOCAL_SRC_FILES += nvmm_contentpipe_shared_bench.c
+
+LOCAL_SHARED_LIBRARIES += libnvos
+LOCAL_SHARED_LIBRARIES += libnvmm_contentpipe
+
+include $(NVIDIA_EXECUTABLE)
 include $(call all-makefiles-under,$(LOCAL_PATH))
@@ -16,6 +16,7 @@
 #endif
 
 #include "nvmm_contentpipe.h"
+#include "nvmm_contentpipe_shared.h"
 #include "nvrm_init.h"
 #include "nvrm_memmgr.h"
 #include "nvrm_power.h"
@@ -34,6 +35,8 @@
 #define STREAMING_MIN_CACHE_SIZE (10 * 1024 * 1024)
 #define STREAMING_MIN_SPARE_SIZE (256 * 1024)
 
+#define MAPPED_READAHEAD_SIZE (2 * 1024 * 1024)
+
 #define KPI_MODE_ENABLED 0
 #define NVMM_CP_PROFILE_ENABLED 0
 #define MAX_PROFILE_ENTRIES (40 * 1024)
@@ -57,8 +60,27 @@ typedef struct FileChunkRec
     NvU32               status;
     NvBool              bInvalidate;
     NvU64               position;
+    NvU32               nBytesUsed;  // bytes handed to the reader, for the wasted byte count
+    NvBool              bPrefetched; // holds published ranges the reader has not reached
 }FileChunk;
 
+typedef struct ReadAheadStreamRec
+{
+    CP_ByteRange        *pRanges;
+    NvU32               nRanges;
+    NvU32               nMaxRanges;
+    NvU32               nNext;       // first range the reader has not reached
+}ReadAheadStream;
+
+// Area of the mapping already advised to the protocol. The reader of an
+// interleaved file jumps between streams, so one window is kept per stream.
+typedef struct MappedWindowRec
+{
+    NvU64               Start;
+    NvU64               End;
+    NvU32               LastUse;
+}MappedWindow;
+
 typedef struct ReadBufferRec
 {
     NvU8                *pBuffer;
@@ -133,6 +155,33 @@ typedef struct NvmmFileCacheRec
 
     NvBool              bCachingPaused;
     NvBool              bStop;
+
+    // Range read-ahead, enabled by the first CP_ConfigIndexReadAheadRanges.
+    // The ring then holds chunks of unrelated file areas and the reader's
+    // data (pRead, nBytesAvailable) only spans the chunks that follow each
+    // other both in the ring and in the file.
+    NvBool              bReadAheadRanges;
+    ReadAheadStream     ReadAhead[CP_READAHEAD_MAX_STREAMS];
+    CP_ReadAheadStats   ReadAheadStats;
+
+    // Mapped content, see CP_ConfigIndexMapContent. The cache pool and its
+    // thread are not created; reads are served from pMap at MapPosition and
+    // the protocol is asked to page in the window ahead of the reader.
+    // pMapFaulted is set by the protocol once the mapping lost pages.
+    NvBool              bMapRequested;
+    NvBool              bMapped;
+    NvU8                *pMap;
+    const volatile NvU32 *pMapFaulted;
+    NvU64               MapPosition;
+    MappedWindow        MapWindows[CP_READAHEAD_MAX_STREAMS];
+    NvU32               MapWindowClock;
+
+    // Cache shared with the other readers of the same local file, used when
+    // the content is not mapped. The private pool and thread are not created;
+    // reads are served at the reader's cursor in hShared. The pool address is
+    // kept in PhyAddress and VirtAddress, CacheSize is the pool size.
+    NvmmSharedReaderHandle hShared;
+    char                *szURI;     // the shared cache opens its own handle with it
 } NvmmFileCache;
 
 static NvBool CheckFileChunkInUse(NvmmFileCache *pFileCache, FileChunk *pFileChunk)
@@ -171,6 +220,462 @@ static NvBool CheckFileChunkInUse(NvmmFileCache *pFileCache, FileChunk *pFileChu
     return NV_FALSE;
 }
 
+// The read-ahead statistics and the bytes used of each chunk change on the
+// reader and the caching thread, they are kept under ChunkLock (recursive)
+static void RetireFileChunk(NvmmFileCache *pFileCache, FileChunk *pFileChunk)
+{
+    NvOsMutexLock(pFileCache->ChunkLock);
+    // whatever the reader never used of a chunk that is dropped was fetched for nothing
+    if ((pFileChunk->status == FULL) && (pFileChunk->nBytesUsed < pFileChunk->size))
+    {
+        pFileCache->ReadAheadStats.nBytesWasted += pFileChunk->size - pFileChunk->nBytesUsed;
+    }
+    pFileChunk->nBytesUsed = 0;
+    pFileChunk->bPrefetched = NV_FALSE;
+    NvOsMutexUnlock(pFileCache->ChunkLock);
+}
+
+static void CountReadAhead(NvmmFileCache *pFileCache, NvBool bHit)
+{
+    NvOsMutexLock(pFileCache->ChunkLock);
+    if (bHit)
+        pFileCache->ReadAheadStats.nHits++;
+    else
+        pFileCache->ReadAheadStats.nMisses++;
+    NvOsMutexUnlock(pFileCache->ChunkLock);
+}
+
+static void MarkBytesUsed(NvmmFileCache *pFileCache, NvU8 *pStart, NvU32 nBytes)
+{
+    NvU8 *pBitsEnd = pFileCache->pBits + pFileCache->TotalFileChunks*pFileCache->ChunkSize;
+    FileChunk *pFileChunk;
+    NvU32 n;
+
+    NvOsMutexLock(pFileCache->ChunkLock);
+    while (nBytes)
+    {
+        if (pStart >= pBitsEnd)
+            pStart = pFileCache->pBits + (pStart - pBitsEnd);
+        pFileChunk = &pFileCache->FileChunks[(pStart - pFileCache->pBits) / pFileCache->ChunkSize];
+        n = (NvU32)(pFileChunk->pBuffer + pFileCache->ChunkSize - pStart);
+        if (n > nBytes)
+            n = nBytes;
+        pFileChunk->nBytesUsed += n;
+        if (pFileChunk->nBytesUsed > pFileChunk->size)
+            pFileChunk->nBytesUsed = pFileChunk->size;
+        pStart += n;
+        nBytes -= n;
+    }
+    NvOsMutexUnlock(pFileCache->ChunkLock);
+}
+
+// File position of the read pointer, for a partially cached file
+static NvU64 GetReadPosition(NvmmFileCache *pFileCache)
+{
+    NvU32 iChunk = (NvU32)(pFileCache->pRead - pFileCache->pBits) / pFileCache->ChunkSize;
+
+    if (iChunk >= pFileCache->TotalFileChunks)
+        iChunk = pFileCache->TotalFileChunks - 1;
+    return pFileCache->FileChunks[iChunk].position + (pFileCache->pRead - pFileCache->FileChunks[iChunk].pBuffer);
+}
+
+// Returns the first byte of [Offset, End) that no cached chunk holds, End if all of it is cached
+static NvU64 FirstUncachedByte(NvmmFileCache *pFileCache, NvU64 Offset, NvU64 End, FileChunk *pSkip)
+{
+    FileChunk *pFileChunk = NULL;
+    NvU32 i;
+
+    while (Offset < End)
+    {
+        for (i = 0; i < pFileCache->TotalFileChunks; i++)
+        {
+            pFileChunk = &pFileCache->FileChunks[i];
+            if ((pFileChunk != pSkip) && (pFileChunk->status == FULL) && !pFileChunk->bInvalidate &&
+                (pFileChunk->position <= Offset) && (Offset < pFileChunk->position + pFileChunk->size))
+            {
+                break;
+            }
+        }
+        if (i == pFileCache->TotalFileChunks)
+            return Offset;
+        Offset = pFileChunk->position + pFileChunk->size;
+    }
+    return End;
+}
+
+static NvBool HoldsPendingRange(NvmmFileCache *pFileCache, FileChunk *pFileChunk)
+{
+    ReadAheadStream *pStream;
+    CP_ByteRange *pRange;
+    NvU32 s, i;
+
+    for (s = 0; s < CP_READAHEAD_MAX_STREAMS; s++)
+    {
+        pStream = &pFileCache->ReadAhead[s];
+        for (i = pStream->nNext; i < pStream->nRanges; i++)
+        {
+            pRange = &pStream->pRanges[i];
+            if ((pRange->Offset < pFileChunk->position + pFileChunk->size) &&
+                (pFileChunk->position < pRange->Offset + pRange->Size))
+            {
+                return NV_TRUE;
+            }
+        }
+    }
+    return NV_FALSE;
+}
+
+// Drops the prefetched mark of chunks whose ranges have all been reached
+static void UpdatePrefetchedChunks(NvmmFileCache *pFileCache)
+{
+    FileChunk *pFileChunk;
+    NvU32 i;
+
+    for (i = 0; i < pFileCache->TotalFileChunks; i++)
+    {
+        pFileChunk = &pFileCache->FileChunks[i];
+        if (pFileChunk->bPrefetched &&
+            ((pFileChunk->status != FULL) || !HoldsPendingRange(pFileCache, pFileChunk)))
+        {
+            pFileChunk->bPrefetched = NV_FALSE;
+        }
+    }
+}
+
+// The reader moved to nOffset: in each stream the ranges before the one holding it are done
+static void ConsumeReadAheadRanges(NvmmFileCache *pFileCache, NvU64 nOffset)
+{
+    ReadAheadStream *pStream;
+    CP_ByteRange *pRange;
+    NvBool bChanged = NV_FALSE;
+    NvU32 s, i;
+
+    for (s = 0; s < CP_READAHEAD_MAX_STREAMS; s++)
+    {
+        pStream = &pFileCache->ReadAhead[s];
+        for (i = pStream->nNext; i < pStream->nRanges; i++)
+        {
+            pRange = &pStream->pRanges[i];
+            if ((pRange->Offset <= nOffset) && (nOffset < pRange->Offset + pRange->Size))
+            {
+                if (i != pStream->nNext)
+                {
+                    pStream->nNext = i;
+                    bChanged = NV_TRUE;
+                }
+                break;
+            }
+        }
+    }
+    if (bChanged)
+    {
+        UpdatePrefetchedChunks(pFileCache);
+    }
+}
+
+// Bytes the reader can still use without waiting: its own data and the prefetched chunks
+static NvU64 GetCachedAheadBytes(NvmmFileCache *pFileCache)
+{
+    NvU64 nBytes = pFileCache->nBytesAvailable;
+    NvU32 i;
+
+    if (pFileCache->bReadAheadRanges)
+    {
+        for (i = 0; i < pFileCache->TotalFileChunks; i++)
+        {
+            if ((pFileCache->FileChunks[i].status == FULL) && pFileCache->FileChunks[i].bPrefetched)
+                nBytes += pFileCache->FileChunks[i].size;
+        }
+    }
+    return nBytes;
+}
+
+/*
+ * Picks where the chunk being filled is read from in range read-ahead. A
+ * starved reader gets the data at its position, then the range the reader is
+ * in is completed, then the lowest published range of any stream that is not
+ * cached yet is fetched. Without one the cache keeps reading sequentially
+ * after the reader's data.
+ */
+static NvU64 GetReadAheadTarget(NvmmFileCache *pFileCache, FileChunk *pFileChunk, NvBool *pbRange)
+{
+    ReadAheadStream *pStream;
+    CP_ByteRange *pRange;
+    NvU64 RunStart, RunEnd, RangeEnd, Start, Target = (NvU64)-1;
+    NvU32 s, i;
+
+    RunStart = GetReadPosition(pFileCache);
+    RunEnd = RunStart + pFileCache->nBytesAvailable;
+    *pbRange = NV_FALSE;
+
+    if (!pFileCache->nBytesAvailable)
+        return RunEnd;
+
+    for (s = 0; s < CP_READAHEAD_MAX_STREAMS; s++)
+    {
+        pStream = &pFileCache->ReadAhead[s];
+        for (i = pStream->nNext; i < pStream->nRanges; i++)
+        {
+            pRange = &pStream->pRanges[i];
+            RangeEnd = pRange->Offset + pRange->Size;
+            if ((pRange->Offset <= RunStart) && (RunStart < RangeEnd))
+            {
+                Start = FirstUncachedByte(pFileCache, RunEnd, RangeEnd, pFileChunk);
+                if (Start < RangeEnd)
+                {
+                    *pbRange = NV_TRUE;
+                    return Start;
+                }
+                continue;
+            }
+            Start = FirstUncachedByte(pFileCache, pRange->Offset, RangeEnd, pFileChunk);
+            if (Start < RangeEnd)
+            {
+                if (Start < Target)
+                    Target = Start;
+                break;
+            }
+        }
+    }
+
+    if (Target == (NvU64)-1)
+        return RunEnd;
+
+    *pbRange = NV_TRUE;
+    return Target;
+}
+
+// In range read-ahead a chunk only adds to the reader's data when it follows it in the ring and in the file
+static NvBool ExtendsReaderData(NvmmFileCache *pFileCache, FileChunk *pFileChunk)
+{
+    NvU32 nRingSize = pFileCache->TotalFileChunks*pFileCache->ChunkSize;
+    NvU8 *pEnd = pFileCache->pRead + pFileCache->nBytesAvailable;
+
+    if (pEnd >= pFileCache->pBits + nRingSize)
+        pEnd -= nRingSize;
+    return (pFileChunk->pBuffer == pEnd) &&
+           (pFileChunk->position == GetReadPosition(pFileCache) + pFileCache->nBytesAvailable);
+}
+
+// In range read-ahead the next chunk in the ring may hold the reader's data or ranges it has not reached
+static NvBool IsChunkReusable(NvmmFileCache *pFileCache, FileChunk *pFileChunk)
+{
+    NvU32 nRingSize = pFileCache->TotalFileChunks*pFileCache->ChunkSize;
+    NvU32 nDistance;
+
+    nDistance = (NvU32)((pFileChunk->pBuffer + nRingSize - pFileCache->pRead) % nRingSize);
+    if (nDistance < pFileCache->nBytesAvailable)
+        return NV_FALSE;
+
+    return !((pFileChunk->status == FULL) && pFileChunk->bPrefetched);
+}
+
+static void AdviseMappedRange(NvmmFileCache *pFileCache, NvU64 Offset, NvU64 Size)
+{
+    NvCPR_MappedRange Range;
+
+    if (Offset >= pFileCache->FileSize)
+        return;
+    if (Size > pFileCache->FileSize - Offset)
+        Size = pFileCache->FileSize - Offset;
+
+    Range.nOffset = Offset;
+    Range.nSize = Size;
+    (void)pFileCache->pProtocol->QueryConfig(pFileCache->hFile, NvCPR_ConfigMappedWillNeed, &Range, sizeof(NvCPR_MappedRange));
+}
+
+static void AdviseMappedReadAhead(NvmmFileCache *pFileCache)
+{
+    NvU64 Position = pFileCache->MapPosition;
+    MappedWindow *pWindow = NULL;
+    NvU32 i;
+
+    for (i = 0; i < CP_READAHEAD_MAX_STREAMS; i++)
+    {
+        MappedWindow *pCur = &pFileCache->MapWindows[i];
+        if ((Position >= pCur->Start) && (Position < pCur->End))
+        {
+            pWindow = pCur;
+            break;
+        }
+        if (!pWindow || (pCur->LastUse < pWindow->LastUse))
+            pWindow = pCur;
+    }
+    pWindow->LastUse = ++pFileCache->MapWindowClock;
+
+    if (i < CP_READAHEAD_MAX_STREAMS)
+    {
+        // slide the window once the reader is past its middle, advising only what is new
+        if (Position + MAPPED_READAHEAD_SIZE / 2 < pWindow->End)
+            return;
+        AdviseMappedRange(pFileCache, pWindow->End, Position + MAPPED_READAHEAD_SIZE - pWindow->End);
+    }
+    else
+    {
+        // a stream nobody read recently, take over its window
+        AdviseMappedRange(pFileCache, Position, MAPPED_READAHEAD_SIZE);
+    }
+    pWindow->Start = Position;
+    pWindow->End = Position + MAPPED_READAHEAD_SIZE;
+}
+
+/* Pages of a mapped file that was truncated or whose media was removed read
+ * as zeros; anything read from the mapping since then cannot be trusted. */
+static NvBool MappedContentFaulted(NvmmFileCache *pFileCache)
+{
+    return (pFileCache->pMapFaulted && *pFileCache->pMapFaulted) ? NV_TRUE : NV_FALSE;
+}
+
+static NvError MapContent(NvmmFileCache *pFileCache)
+{
+    NvCPR_MappedContent Mapped;
+    NvError status;
+
+    if (pFileCache->bIsStreaming || pFileCache->nProtocolVersion < 2)
+        return NvError_NotSupported;
+
+    NvOsMemset(&Mapped, 0, sizeof(NvCPR_MappedContent));
+    status = pFileCache->pProtocol->QueryConfig(pFileCache->hFile, NvCPR_ConfigGetMappedContent, &Mapped, sizeof(NvCPR_MappedContent));
+    if (status != NvSuccess)
+        return status;
+    if (!Mapped.pBase || (Mapped.nSize != pFileCache->FileSize))
+        return NvError_NotSupported;
+
+    // reads before InitializeCP went straight to the protocol, carry on from there
+    status = pFileCache->pProtocol->GetPosition(pFileCache->hFile, &pFileCache->MapPosition);
+    if (status != NvSuccess)
+        return status;
+
+    pFileCache->pMap = Mapped.pBase;
+    pFileCache->pMapFaulted = Mapped.pFaulted;
+    pFileCache->bMapped = NV_TRUE;
+    AdviseMappedReadAhead(pFileCache);
+    return NvSuccess;
+}
+
+static NvError ShareContent(NvmmFileCache *pFileCache, NvU64 CacheSize)
+{
+    NvCPR_ContentId Id;
+    NvU64 Position = 0;
+    NvError status;
+
+    if (pFileCache->bIsStreaming || pFileCache->nProtocolVersion < 2 || !pFileCache->szURI)
+        return NvError_NotSupported;
+
+    NvOsMemset(&Id, 0, sizeof(NvCPR_ContentId));
+    status = pFileCache->pProtocol->QueryConfig(pFileCache->hFile, NvCPR_ConfigGetContentId, &Id, sizeof(NvCPR_ContentId));
+    if (status != NvSuccess)
+        return status;
+    if (Id.nSize != pFileCache->FileSize)
+        return NvError_NotSupported;
+
+    // reads before InitializeCP went straight to the protocol, carry on from there
+    status = pFileCache->pProtocol->GetPosition(pFileCache->hFile, &Position);
+    if (status != NvSuccess)
+        return status;
+
+    status = NvmmSharedCacheAttach(pFileCache->pProtocol, pFileCache->hFile, pFileCache->szURI,
+                                   &Id, CacheSize, Position, &pFileCache->hShared);
+    if (status != NvSuccess)
+        return status;
+
+    pFileCache->CacheSize = NvmmSharedCacheGetSize(pFileCache->hShared);
+    NvmmSharedCacheGetBaseAddress(pFileCache->hShared, &pFileCache->PhyAddress, &pFileCache->VirtAddress);
+    return NvSuccess;
+}
+
+static CPresult SetReadAheadRanges(NvmmFileCache *pFileCache, CP_ConfigReadAheadRanges *pConfig)
+{
+    ReadAheadStream *pStream;
+    CP_ByteRange *pRanges;
+    NvU32 i;
+
+    if (!pConfig || (pConfig->StreamIndex >= CP_READAHEAD_MAX_STREAMS) ||
+        (pConfig->Count && !pConfig->pRanges))
+    {
+        return NvError_BadParameter;
+    }
+
+    if (pFileCache->bMapped)
+    {
+        // nothing to track, the ranges are only paged in ahead of the reader
+        for (i = 0; i < pConfig->Count; i++)
+        {
+            AdviseMappedRange(pFileCache, pConfig->pRanges[i].Offset, pConfig->pRanges[i].Size);
+        }
+        return NvSuccess;
+    }
+
+    if (pFileCache->hShared)
+    {
+        // the shared cache finds the streams of an interleaved file from
+        // where the reader reads and reads ahead of the last two
+        return NvSuccess;
+    }
+
+    // only a partially cached local file benefits, anything else keeps its strategy
+    if (!pFileCache->bInitialized || pFileCache->bIsStreaming ||
+        (pFileCache->CacheSize >= pFileCache->FileSize))
+    {
+        return NvSuccess;
+    }
+
+    if (!pFileCache->bReadAheadRanges)
+    {
+        NvU64 Position = 0;
+        NvBool bSeek = NV_FALSE;
+
+        // When the reader has consumed everything the read pointer sits at
+        // the end of its last chunk, which range read-ahead cannot tell from
+        // the start of the next one. Sequential caching always continues at
+        // the file position, so seek there to give the reader a chunk of its own.
+        NvOsMutexLock(pFileCache->WriteLock);
+        if (!pFileCache->nBytesAvailable && !pFileCache->bEOS)
+        {
+            bSeek = (pFileCache->pProtocol->GetPosition(pFileCache->hFile, &Position) == NvSuccess);
+        }
+        NvOsMutexUnlock(pFileCache->WriteLock);
+        if (bSeek)
+        {
+            Nvmm_FileSetPosition64(pFileCache, (CPint64)Position, CP_OriginBegin);
+        }
+    }
+
+    NvOsMutexLock(pFileCache->ChunkLock);
+    pStream = &pFileCache->ReadAhead[pConfig->StreamIndex];
+    if (pConfig->Count > pStream->nMaxRanges)
+    {
+        pRanges = NvOsRealloc(pStream->pRanges, sizeof(CP_ByteRange) * pConfig->Count);
+        if (!pRanges)
+        {
+            NvOsMutexUnlock(pFileCache->ChunkLock);
+            return NvError_InsufficientMemory;
+        }
+        pStream->pRanges = pRanges;
+        pStream->nMaxRanges = pConfig->Count;
+    }
+
+    pStream->nRanges = 0;
+    pStream->nNext = 0;
+    for (i = 0; i < pConfig->Count; i++)
+    {
+        const CP_ByteRange *pRange = &pConfig->pRanges[i];
+
+        if (!pRange->Size || (pRange->Offset >= pFileCache->FileSize))
+            continue;
+        pStream->pRanges[pStream->nRanges] = *pRange;
+        if (pRange->Size > pFileCache->FileSize - pRange->Offset)
+            pStream->pRanges[pStream->nRanges].Size = (NvU32)(pFileCache->FileSize - pRange->Offset);
+        pStream->nRanges++;
+    }
+
+    pFileCache->bReadAheadRanges = NV_TRUE;
+    UpdatePrefetchedChunks(pFileCache);
+    NvOsMutexUnlock(pFileCache->ChunkLock);
+
+    NvOsSemaphoreSignal(pFileCache->WorkerSema);
+    return NvSuccess;
+}
 
 static NvError PrepareForProcessing(NvmmFileCache *pFileCache, FileChunk **pFileChunk)
 {
@@ -255,7 +760,15 @@ static NvError PrepareForProcessing(NvmmFileCache *pFileCache, FileChunk **pFile
         return NvError_ContentPipeNotReady; // then we have to wait until read buffer is freed
     }
 
+    if (pFileCache->bReadAheadRanges && pFileCache->nBytesAvailable &&
+        !IsChunkReusable(pFileCache, &pFileCache->FileChunks[pFileCache->NextChunkToWrite]))
+    {
+        NV_LOGGER_PRINT((NVLOG_CONTENT_PIPE, NVLOG_VERBOSE, "--PrepareForProcessing::Next chunk holds data still to be read"));
+        return NvError_ContentPipeNotReady;
+    }
+
     // this block is ready for writing
+    RetireFileChunk(pFileCache, &pFileCache->FileChunks[pFileCache->NextChunkToWrite]);
     pFileCache->FileChunks[pFileCache->NextChunkToWrite].status = FILLING;
     *pFileChunk = &pFileCache->FileChunks[pFileCache->NextChunkToWrite];
 
@@ -272,13 +785,14 @@ static NvError NvmmFileCacheDoRead(NvmmFileCache *pFileCache)
     NvU32 index;
     CPProf *pProf = NULL;
     NvError e = NvSuccess;
+    NvBool bRange = NV_FALSE;
 
 #if KPI_MODE_ENABLED
     NvmmUlpUpdateKpis(KpiFlag_FileIOStart, NV_FALSE, NV_FALSE, 0);
 #endif
 
     if ((pFileCache->CacheSize < pFileCache->FileSize) &&
-        (pFileCache->nBytesAvailable > pFileCache->HighMark))
+        (GetCachedAheadBytes(pFileCache) > pFileCache->HighMark))
     {
         pFileCache->bTrigger = NV_FALSE;
         goto  endOfFunction;
@@ -301,7 +815,15 @@ static NvError NvmmFileCacheDoRead(NvmmFileCache *pFileCache)
     }
     else
     {
-        e = pFileCache->pProtocol->GetPosition(pFileCache->hFile, &pFileChunk->position);
+        if (pFileCache->bReadAheadRanges)
+        {
+            pFileChunk->position = GetReadAheadTarget(pFileCache, pFileChunk, &bRange);
+            e = pFileCache->pProtocol->SetPosition(pFileCache->hFile, pFileChunk->position, NvCPR_OriginBegin);
+        }
+        else
+        {
+            e = pFileCache->pProtocol->GetPosition(pFileCache->hFile, &pFileChunk->position);
+        }
         NV_LOGGER_PRINT((NVLOG_CONTENT_PIPE, NVLOG_VERBOSE, "Reading from file location %lld\n", pFileChunk->position));
         if (pFileChunk->position == pFileCache->FileSize)
         {
@@ -378,6 +900,10 @@ static NvError NvmmFileCacheDoRead(NvmmFileCache *pFileCache)
     {
         pFileChunk->status = FULL;
         pFileChunk->bInvalidate = NV_FALSE;
+        pFileChunk->bPrefetched = bRange;
+        pFileCache->ReadAheadStats.nBytesFetched += nBytesRead;
+        if (bRange)
+            pFileCache->ReadAheadStats.nRangeFetches++;
 
         NvOsMutexLock(pFileCache->AvailLock);
         if (pFileCache->CacheSize == pFileCache->FileSize &&
@@ -414,6 +940,16 @@ static NvError NvmmFileCacheDoRead(NvmmFileCache *pFileCache)
             }
             NV_LOGGER_PRINT((NVLOG_CONTENT_PIPE, NVLOG_VERBOSE,"nBytesAvailable = %x\n",pFileCache->nBytesAvailable));
         } 
+        else if (pFileCache->bReadAheadRanges)
+        {
+            // a chunk fetched elsewhere is picked up when the reader seeks into it
+            if (ExtendsReaderData(pFileCache, pFileChunk))
+            {
+                pFileCache->nBytesAvailable += nBytesRead;
+                if (pFileChunk->size == (pFileCache->FileSize - pFileChunk->position))
+                    pFileCache->bEOS = NV_TRUE;
+            }
+        }
         else
         {
             pFileCache->nBytesAvailable += nBytesRead;
@@ -468,7 +1004,7 @@ static NvError NvmmFileCacheDoRead(NvmmFileCache *pFileCache)
         else
         {
             // for a partially cached file check for the highmark limit
-            if (pFileCache->nBytesAvailable < pFileCache->HighMark)
+            if (GetCachedAheadBytes(pFileCache) < pFileCache->HighMark)
             {
                 NvOsSemaphoreSignal(pFileCache->WorkerSema);
             }
@@ -561,6 +1097,16 @@ static CPresult Nvmm_FileOpen(
     }
 
     pFileCache->bIsStreaming = pFileCache->pProtocol->IsStreaming(pFileCache->hFile);
+    if (!pFileCache->bIsStreaming)
+    {
+        pFileCache->szURI = NvOsAlloc(NvOsStrlen(szURI) + 1);
+        if (!pFileCache->szURI)
+        {
+            e = NvError_InsufficientMemory;
+            goto fail;
+        }
+        NvOsStrncpy(pFileCache->szURI, szURI, NvOsStrlen(szURI) + 1);
+    }
    }
     pFileCache->nProtocolVersion = 1;
     pFileCache->pProtocol->GetVersion(&pFileCache->nProtocolVersion);
@@ -575,6 +1121,7 @@ fail:
     {
         if(pFileCache->pProtocol && pFileCache->hFile)
             pFileCache->pProtocol->Close(pFileCache->hFile);
+        NvOsFree(pFileCache->szURI);
         NvOsFree(pFileCache);
     }
     *hContent = NULL;
@@ -593,9 +1140,20 @@ static CPresult Nvmm_FileClose(CPhandle hContent)
 #endif
     if (!pFileCache->bInitialized)
     {
+        if (pFileCache->hShared)
+        {
+            CP_ReadAheadStats Stats;
+
+            NvmmSharedCacheGetStats(pFileCache->hShared, &Stats);
+            NV_LOGGER_PRINT((NVLOG_CONTENT_PIPE, NVLOG_DEBUG, "NvMMContentPipe shared cache: hits %lld misses %lld fetched %lld wasted %lld",
+                Stats.nHits, Stats.nMisses, Stats.nBytesFetched, Stats.nBytesWasted));
+            // before the handle it reads through goes
+            NvmmSharedCacheDetach(pFileCache->hShared);
+        }
         if (pFileCache->pProtocol && pFileCache->hFile)
             pFileCache->pProtocol->Close(pFileCache->hFile);
 
+        NvOsFree(pFileCache->szURI);
         NvOsFree(pFileCache);
         pFileCache = NULL;
     }
@@ -631,6 +1189,15 @@ static CPresult Nvmm_FileClose(CPhandle hContent)
         }
         NvOsFree(pFileCache->FileChunks);
         pFileCache->FileChunks = NULL;
+        for (i = 0; i < CP_READAHEAD_MAX_STREAMS; i++)
+        {
+            NvOsFree(pFileCache->ReadAhead[i].pRanges);
+            pFileCache->ReadAhead[i].pRanges = NULL;
+        }
+        NV_LOGGER_PRINT((NVLOG_CONTENT_PIPE, NVLOG_DEBUG, "NvMMContentPipe read-ahead: hits %lld misses %lld fetched %lld wasted %lld range fetches %lld",
+            pFileCache->ReadAheadStats.nHits, pFileCache->ReadAheadStats.nMisses,
+            pFileCache->ReadAheadStats.nBytesFetched, pFileCache->ReadAheadStats.nBytesWasted,
+            pFileCache->ReadAheadStats.nRangeFetches));
         if (pFileCache->bProfile)
         {
             NvOsFileHandle oOut;
@@ -693,6 +1260,7 @@ static CPresult Nvmm_FileClose(CPhandle hContent)
 
         NvOsFree(pFileCache->pProfData);
         pFileCache->pProfData = NULL;
+        NvOsFree(pFileCache->szURI);
         NvOsFree(pFileCache);
         pFileCache = NULL;
     }
@@ -709,7 +1277,53 @@ static CPresult Nvmm_FileRead( CPhandle hContent, CPbyte *pData, CPuint nSize)
     NvmmFileCache *pFileCache = (NvmmFileCache *)hContent;
     NvU8 *pBitsEnd;
     NvU32 nBytesToRead, ulTailSize, nBytesRead;
+    NvU64 Position = 0;
     CPresult status = NvSuccess;
+    NvError e;
+
+    if (pFileCache->bMapped)
+    {
+        if (pFileCache->MapPosition >= pFileCache->FileSize)
+        {
+            status = NvError_EndOfFile;
+            goto CpExit;
+        }
+        nBytesToRead = nSize;
+        if (nBytesToRead > pFileCache->FileSize - pFileCache->MapPosition)
+        {
+            nBytesToRead = (NvU32)(pFileCache->FileSize - pFileCache->MapPosition);
+            status = NvError_EndOfFile;
+        }
+        NvOsMemcpy(pData, pFileCache->pMap + pFileCache->MapPosition, nBytesToRead);
+        if (MappedContentFaulted(pFileCache))
+        {
+            status = NvError_FileReadFailed;
+            goto CpExit;
+        }
+        pFileCache->MapPosition += nBytesToRead;
+        AdviseMappedReadAhead(pFileCache);
+        goto CpExit;
+    }
+
+    if (pFileCache->hShared)
+    {
+        Position = NvmmSharedCacheGetPosition(pFileCache->hShared);
+        if (Position >= pFileCache->FileSize)
+        {
+            status = NvError_EndOfFile;
+            goto CpExit;
+        }
+        nBytesToRead = nSize;
+        if (nBytesToRead > pFileCache->FileSize - Position)
+        {
+            nBytesToRead = (NvU32)(pFileCache->FileSize - Position);
+            status = NvError_EndOfFile;
+        }
+        e = NvmmSharedCacheRead(pFileCache->hShared, (NvU8 *)pData, nBytesToRead);
+        if (e != NvSuccess)
+            status = e;
+        goto CpExit;
+    }
 
     Nvmm_PauseCaching(pFileCache, NV_FALSE);
 
@@ -744,12 +1358,49 @@ static CPresult Nvmm_FileRead( CPhandle hContent, CPbyte *pData, CPuint nSize)
         status = NvError_EndOfFile;
         goto CpExit;
     }
+    if (pFileCache->bReadAheadRanges)
+    {
+        // The reader's data may end where a prefetched chunk takes over: take
+        // what there is and seek on, which moves the read pointer to the chunk
+        // holding the next byte or restarts caching there
+        Position = GetReadPosition(pFileCache);
+        while (pFileCache->nBytesAvailable && (pFileCache->nBytesAvailable < nSize) && !pFileCache->bEOS)
+        {
+            nBytesToRead = pFileCache->nBytesAvailable;
+            MarkBytesUsed(pFileCache, pFileCache->pRead, nBytesToRead);
+            pBitsEnd = pFileCache->pBits+pFileCache->TotalFileChunks*pFileCache->ChunkSize;
+            ulTailSize = (NvU32)(pBitsEnd - pFileCache->pRead);
+            if (nBytesToRead > ulTailSize)
+            {
+                NvOsMemcpy(pData, pFileCache->pRead, ulTailSize);
+                NvOsMemcpy(pData + ulTailSize, pFileCache->pBits, (nBytesToRead-ulTailSize));
+                pFileCache->pRead = pFileCache->pBits + (nBytesToRead-ulTailSize);
+            }
+            else
+            {
+                NvOsMemcpy(pData, pFileCache->pRead, nBytesToRead);
+                pFileCache->pRead += nBytesToRead;
+                if (pFileCache->pRead == pBitsEnd)
+                    pFileCache->pRead = pFileCache->pBits;
+            }
+            NvOsMutexLock(pFileCache->AvailLock);
+            pFileCache->nBytesAvailable -= nBytesToRead;
+            NvOsMutexUnlock(pFileCache->AvailLock);
+            pData += nBytesToRead;
+            nSize -= nBytesToRead;
+            Position += nBytesToRead;
+            status = Nvmm_FileSetPosition64(hContent, (CPint64)Position, CP_OriginBegin);
+            if (status != NvSuccess)
+                goto CpExit;
+        }
+    }
     // enough data?
     nBytesToRead = nSize;
     if (pFileCache->nBytesAvailable < nBytesToRead)
     {
         if (!pFileCache->bEOS)
         {
+            CountReadAhead(pFileCache, NV_FALSE);
             if (pFileCache->HighMark < nBytesToRead )
             {
                 status = NvError_ContentPipeNoData;
@@ -778,6 +1429,11 @@ static CPresult Nvmm_FileRead( CPhandle hContent, CPbyte *pData, CPuint nSize)
                         }
                         else
                         {
+                            if (pFileCache->bReadAheadRanges)
+                            {
+                                // the file position is wherever the last prefetch left it
+                                pFileCache->pProtocol->SetPosition(pFileCache->hFile, GetReadPosition(pFileCache), NvCPR_OriginBegin);
+                            }
                             nBytesRead = pFileCache->pProtocol->Read(pFileCache->hFile, (NvU8 *)pData, nSize);
                         }
                         NvOsMutexUnlock(pFileCache->WriteLock);
@@ -807,8 +1463,13 @@ static CPresult Nvmm_FileRead( CPhandle hContent, CPbyte *pData, CPuint nSize)
             nBytesToRead  = pFileCache->nBytesAvailable; // EOS: use whatever is left
         }
     }
+    else
+    {
+        CountReadAhead(pFileCache, NV_TRUE);
+    }
 
     // copy data
+    MarkBytesUsed(pFileCache, pFileCache->pRead, nBytesToRead);
     pBitsEnd = pFileCache->pBits+pFileCache->TotalFileChunks*pFileCache->ChunkSize;
     ulTailSize = (NvU32)(pBitsEnd - pFileCache->pRead);
     if (pFileCache->pRead + nBytesToRead > pBitsEnd){
@@ -832,6 +1493,12 @@ static CPresult Nvmm_FileRead( CPhandle hContent, CPbyte *pData, CPuint nSize)
     pFileCache->nBytesAvailable -= nBytesToRead;
     NvOsMutexUnlock(pFileCache->AvailLock);
 
+    if (pFileCache->bReadAheadRanges && !pFileCache->nBytesAvailable && !pFileCache->bEOS)
+    {
+        // leave the read pointer where the next byte is, not at the end of a chunk
+        Nvmm_FileSetPosition64(hContent, (CPint64)(Position + nBytesToRead), CP_OriginBegin);
+    }
+
     if (!pFileCache->bTrigger && !pFileCache->bEOS &&
         (pFileCache->CacheSize < pFileCache->FileSize) &&
         pFileCache->nBytesAvailable <= pFileCache->ReadTriggerThreshold)
@@ -906,6 +1573,40 @@ static CPresult Nvmm_FileCheckAvailableBytes( CPhandle hContent, CPuint nBytesRe
     NvmmUlpUpdateKpis(KpiFlag_FileIOStart, NV_FALSE, NV_FALSE, 0);
 #endif
 
+    if (pFileCache->bMapped)
+    {
+        nEndPosition = pFileCache->FileSize;
+        nCurrentPosition = pFileCache->MapPosition < nEndPosition ? pFileCache->MapPosition : nEndPosition;
+        if (nBytesRequested <= nEndPosition - nCurrentPosition)
+        {
+            *eResult = CP_CheckBytesOk;
+            return NvSuccess;
+        }
+        *eResult = (nEndPosition > nCurrentPosition) ? CP_CheckBytesInsufficientBytes : CP_CheckBytesAtEndOfStream;
+        return NvError_ContentPipeNotReady;
+    }
+
+    if (pFileCache->hShared)
+    {
+        // missing blocks are read when asked for, only the pool can run short
+        nEndPosition = pFileCache->FileSize;
+        nCurrentPosition = NvmmSharedCacheGetPosition(pFileCache->hShared);
+        if (nCurrentPosition > nEndPosition)
+            nCurrentPosition = nEndPosition;
+        if (nBytesRequested > nEndPosition - nCurrentPosition)
+        {
+            *eResult = (nEndPosition > nCurrentPosition) ? CP_CheckBytesInsufficientBytes : CP_CheckBytesAtEndOfStream;
+            return NvError_ContentPipeNotReady;
+        }
+        if (!NvmmSharedCacheCanHold(pFileCache->hShared, nBytesRequested))
+        {
+            *eResult = CP_CheckBytesOutOfBuffers;
+            return NvSuccess;
+        }
+        *eResult = CP_CheckBytesOk;
+        return NvSuccess;
+    }
+
     if (!pFileCache->bInitialized || pFileCache->bStop)
     {
         status = pFileCache->pProtocol->GetPosition(pFileCache->hFile, &nCurrentPosition);
@@ -1013,11 +1714,51 @@ static CPresult Nvmm_FileReadBuffer( CPhandle hContent, CPbyte **ppBuffer, CPuin
     NvBool found = NV_FALSE;
     ReadBuffer *pReadBufferEntry = NULL;
     NvU32 i = 0, j = 0;
+    NvU64 Position = 0;
     CPresult status = NvSuccess;
     
 #if KPI_MODE_ENABLED
     NvmmUlpUpdateKpis(KpiFlag_FileIOStart, NV_FALSE, NV_FALSE, 0);
 #endif
+    if (pFileCache->bMapped)
+    {
+        // hand out the mapping itself, a request never wraps
+        if (MappedContentFaulted(pFileCache))
+        {
+            status = NvError_FileReadFailed;
+            goto CpExit;
+        }
+        if (pFileCache->MapPosition >= pFileCache->FileSize)
+        {
+            status = NvError_EndOfFile;
+            goto CpExit;
+        }
+        if (*nSize > pFileCache->FileSize - pFileCache->MapPosition)
+        {
+            *nSize = (CPuint)(pFileCache->FileSize - pFileCache->MapPosition);
+        }
+        *ppBuffer = (CPbyte *)(pFileCache->pMap + pFileCache->MapPosition);
+        pFileCache->MapPosition += *nSize;
+        AdviseMappedReadAhead(pFileCache);
+        goto CpExit;
+    }
+
+    if (pFileCache->hShared)
+    {
+        Position = NvmmSharedCacheGetPosition(pFileCache->hShared);
+        if (Position >= pFileCache->FileSize)
+        {
+            status = NvError_EndOfFile;
+            goto CpExit;
+        }
+        if (*nSize > pFileCache->FileSize - Position)
+        {
+            *nSize = (CPuint)(pFileCache->FileSize - Position);
+        }
+        status = NvmmSharedCacheReadBuffer(pFileCache->hShared, *nSize, (NvU8 **)ppBuffer);
+        goto CpExit;
+    }
+
     if (!pFileCache->bInitialized || pFileCache->bStop)
     {
         status = NvError_ContentPipeInNonCachingMode;
@@ -1043,6 +1784,7 @@ static CPresult Nvmm_FileReadBuffer( CPhandle hContent, CPbyte **ppBuffer, CPuin
 #if KPI_MODE_ENABLED
             NvmmUlpUpdateKpis(KpiFlag_FileIOEnd, NV_FALSE, NV_FALSE, 0);
 #endif
+            CountReadAhead(pFileCache, NV_FALSE);
             status = NvError_ContentPipeNoData;
             goto CpExit;
         }
@@ -1094,9 +1836,14 @@ static CPresult Nvmm_FileReadBuffer( CPhandle hContent, CPbyte **ppBuffer, CPuin
     }
 
     pFileCache->nReadBuffersInUse++; // fixme atomic this
+    CountReadAhead(pFileCache, NV_TRUE);
+    MarkBytesUsed(pFileCache, pFileCache->pRead, nBytesToRead);
 
     if (pFileCache->CacheSize < pFileCache->FileSize)
     {
+        if (pFileCache->bReadAheadRanges)
+            Position = GetReadPosition(pFileCache) + nBytesToRead;
+
         // does requested area wrap around end of buffer?
         pBufferStart = NULL;
         pBitsEnd = pFileCache->pBits+pFileCache->TotalFileChunks*pFileCache->ChunkSize;
@@ -1142,6 +1889,12 @@ static CPresult Nvmm_FileReadBuffer( CPhandle hContent, CPbyte **ppBuffer, CPuin
 
     *ppBuffer = (CPbyte *)pReadBufferEntry->pBuffer;
 
+    if (pFileCache->bReadAheadRanges && !pFileCache->nBytesAvailable && !pFileCache->bEOS)
+    {
+        // leave the read pointer where the next byte is, not at the end of a chunk
+        Nvmm_FileSetPosition64(hContent, (CPint64)Position, CP_OriginBegin);
+    }
+
     if (!pFileCache->bTrigger && !pFileCache->bEOS &&
         (pFileCache->CacheSize < pFileCache->FileSize) &&
         pFileCache->nBytesAvailable <= pFileCache->ReadTriggerThreshold)
@@ -1180,6 +1933,22 @@ static CPresult Nvmm_FileReleaseReadBuffer(CPhandle hContent, CPbyte *pBuffer)
 #if KPI_MODE_ENABLED
     NvmmUlpUpdateKpis(KpiFlag_FileIOStart, NV_FALSE, NV_FALSE, 0);
 #endif
+    if (pFileCache->bMapped)
+    {
+        // nothing to give back, the buffer is part of the mapping
+        if (((NvU8 *)pBuffer < pFileCache->pMap) ||
+            ((NvU8 *)pBuffer >= pFileCache->pMap + pFileCache->FileSize))
+        {
+            return NvError_BadParameter;
+        }
+        return NvSuccess;
+    }
+
+    if (pFileCache->hShared)
+    {
+        return NvmmSharedCacheReleaseBuffer(pFileCache->hShared, (NvU8 *)pBuffer);
+    }
+
     if (!pFileCache->bInitialized)
     {
         return NvError_ContentPipeInNonCachingMode;
@@ -1224,6 +1993,7 @@ static CPresult Nvmm_FileReleaseReadBuffer(CPhandle hContent, CPbyte *pBuffer)
                 if (!CheckFileChunkInUse(pFileCache, pFileChunk))
                 {
                     NV_LOGGER_PRINT((NVLOG_CONTENT_PIPE, NVLOG_VERBOSE, "Nvmm_FileReleaseReadBuffer::Chunk %x", i));
+                    RetireFileChunk(pFileCache, pFileChunk);
                     pFileChunk->bInvalidate = NV_FALSE;
                     pFileChunk->status = INVALID;
                 }
@@ -1317,6 +2087,7 @@ static void FindNextChunkToWrite(NvmmFileCache *pFileCache, NvU64 nOffset)
             pFileCache->bEOS = NV_FALSE;
         }
         pFileCache->nBytesAvailable = 0;
+        RetireFileChunk(pFileCache, &pFileCache->FileChunks[pFileCache->NextChunkToWrite]);
         pFileCache->FileChunks[pFileCache->NextChunkToWrite].position = nOffset;
         pFileCache->FileChunks[pFileCache->NextChunkToWrite].status = INVALID;
         pFileCache->FileChunks[pFileCache->NextChunkToWrite].bInvalidate = NV_FALSE;
@@ -1331,6 +2102,47 @@ static CPresult Nvmm_FileSetPosition64( CPhandle  hContent, CPint64 nOffset, CP_
     NvU32 iChunk = 0;
     FileChunk *pFileChunk;
 
+    if (pFileCache->bMapped)
+    {
+        NvS64 Position;
+
+        if (eOrigin == CP_OriginBegin)
+            Position = nOffset;
+        else if (eOrigin == CP_OriginCur)
+            Position = (NvS64)pFileCache->MapPosition + nOffset;
+        else if (eOrigin == CP_OriginEnd)
+            Position = (NvS64)pFileCache->FileSize + nOffset;
+        else
+            return NvError_BadParameter;
+
+        if (Position < 0)
+            return NvError_BadParameter;
+        if (MappedContentFaulted(pFileCache))
+            return NvError_FileReadFailed;
+        pFileCache->MapPosition = (NvU64)Position;
+        AdviseMappedReadAhead(pFileCache);
+        return NvSuccess;
+    }
+
+    if (pFileCache->hShared)
+    {
+        NvS64 Position;
+
+        if (eOrigin == CP_OriginBegin)
+            Position = nOffset;
+        else if (eOrigin == CP_OriginCur)
+            Position = (NvS64)NvmmSharedCacheGetPosition(pFileCache->hShared) + nOffset;
+        else if (eOrigin == CP_OriginEnd)
+            Position = (NvS64)pFileCache->FileSize + nOffset;
+        else
+            return NvError_BadParameter;
+
+        if (Position < 0)
+            return NvError_BadParameter;
+        NvmmSharedCacheSetPosition(pFileCache->hShared, (NvU64)Position);
+        return NvSuccess;
+    }
+
     if (!pFileCache->bInitialized || pFileCache->bStop)
     {
         return pFileCache->pProtocol->SetPosition(pFileCache->hFile, nOffset, eOrigin);
@@ -1521,6 +2333,10 @@ static CPresult Nvmm_FileSetPosition64( CPhandle  hContent, CPint64 nOffset, CP_
             NvOsMutexUnlock(pFileCache->ChunkLock);
             return NvError_FileOperationFailed;
         } 
+        if (pFileCache->bReadAheadRanges)
+        {
+            ConsumeReadAheadRanges(pFileCache, (NvU64)nOffset);
+        }
         if (!pFileCache->bInvalidateCache)
         {
             // look for chunk containing desired position
@@ -1591,7 +2407,12 @@ static CPresult Nvmm_FileSetPosition64( CPhandle  hContent, CPint64 nOffset, CP_
                     }
                 }
 
-                if ((nextWrite != -1) && (pFileCache->NextChunkToWrite == (NvU32)nextWrite) && (pFileCache->FileChunks[nextWrite].position == nextPos))
+                if (pFileCache->bReadAheadRanges)
+                {
+                    // the worker picks its own position, and the next chunk may hold prefetched ranges
+                    nextWrite = -1;
+                }
+                else if ((nextWrite != -1) && (pFileCache->NextChunkToWrite == (NvU32)nextWrite) && (pFileCache->FileChunks[nextWrite].position == nextPos))
                 {
                     if (pFileCache->FileChunks[nextWrite].position == pFileCache->FileSize)
                     {
@@ -1682,6 +2503,18 @@ static CPresult Nvmm_FileGetPosition64( CPhandle hContent, CPuint64 *pPosition)
 #if KPI_MODE_ENABLED
     NvmmUlpUpdateKpis(KpiFlag_FileIOStart, NV_FALSE, NV_FALSE, 0);
 #endif
+    if (pFileCache->bMapped)
+    {
+        *pPosition = pFileCache->MapPosition;
+        return NvSuccess;
+    }
+
+    if (pFileCache->hShared)
+    {
+        *pPosition = NvmmSharedCacheGetPosition(pFileCache->hShared);
+        return NvSuccess;
+    }
+
     if (!pFileCache->bInitialized || pFileCache->bStop)
     {
         return pFileCache->pProtocol->GetPosition(pFileCache->hFile, pPosition);
@@ -1710,7 +2543,7 @@ static CPresult Nvmm_FileGetPosition64( CPhandle hContent, CPuint64 *pPosition)
 static CPresult Nvmm_FileGetBaseAddress( CPhandle hContent, NvRmPhysAddr *pPhyAddress, void **pVirtAddress)
 {
     NvmmFileCache *pFileCache = (NvmmFileCache *)hContent;
-    if (!pFileCache->bInitialized)
+    if (!pFileCache->bInitialized && !pFileCache->hShared)
     {
         return NvError_ContentPipeInNonCachingMode;
     }
@@ -1737,6 +2570,28 @@ static CPresult Nvmm_FileGetAvailableBytes(CPhandle hContent, CPuint64 *nBytesAv
     CPuint nCurrentPosition, nEndPosition;
     NvError status = NvSuccess;
 
+    if (pFileCache->bMapped)
+    {
+        if (nBytesAvailable)
+        {
+            *nBytesAvailable = (pFileCache->MapPosition < pFileCache->FileSize) ?
+                (pFileCache->FileSize - pFileCache->MapPosition) : 0;
+        }
+        return NvSuccess;
+    }
+
+    if (pFileCache->hShared)
+    {
+        // as for mapped content, a read never waits for the cache to fill
+        if (nBytesAvailable)
+        {
+            NvU64 Position = NvmmSharedCacheGetPosition(pFileCache->hShared);
+
+            *nBytesAvailable = (Position < pFileCache->FileSize) ? (pFileCache->FileSize - Position) : 0;
+        }
+        return NvSuccess;
+    }
+
     if (!pFileCache->bInitialized || pFileCache->bStop)
     {
         status = Nvmm_FileGetPosition(hContent, &nCurrentPosition);
@@ -1802,6 +2657,21 @@ static CPresult Nvmm_InitializeCP(CPhandle hContent, CPuint64 MinCacheSize, CPui
         *pActualSize = 0;
         return NvSuccess;
     }
+
+    if (pFileCache->bMapRequested && (MapContent(pFileCache) == NvSuccess))
+    {
+        *pActualSize = pFileCache->FileSize;
+        NV_LOGGER_PRINT((NVLOG_CONTENT_PIPE, NVLOG_INFO,"NvMMContentPipe Content Mapped:FileSize = %lld\n", pFileCache->FileSize));
+        return NvSuccess;
+    }
+    // the pool is sized by the first reader, with room for copies of read
+    // buffers spanning blocks as the spare area of a private pool would
+    if (ShareContent(pFileCache, (pFileCache->FileSize > MaxCacheSize ? MaxCacheSize : pFileCache->FileSize) + SpareAreaSize) == NvSuccess)
+    {
+        *pActualSize = pFileCache->CacheSize;
+        NV_LOGGER_PRINT((NVLOG_CONTENT_PIPE, NVLOG_INFO,"NvMMContentPipe Content Shared:CacheSize = %lld\tFileSize = %lld\n", pFileCache->CacheSize, pFileCache->FileSize));
+        return NvSuccess;
+    }
     pFileCache->CacheSize = pFileCache->FileSize > MaxCacheSize ? MaxCacheSize : (NvU32)pFileCache->FileSize;
     pFileCache->SpareCacheSize = SpareAreaSize;
 
@@ -2059,6 +2929,12 @@ static CPresult Nvmm_InvalidateCache(CPhandle hContent)
 {
     NvU32 i;
     NvmmFileCache *pFileCache = (NvmmFileCache *)hContent;
+
+    // a local file does not change under the shared cache, and the other
+    // readers still use its blocks
+    if (pFileCache->hShared)
+        return NvSuccess;
+
     for (i = 0; i < pFileCache->TotalFileChunks; i++)
     {
         FileChunk *pFileChunk = &pFileCache->FileChunks[i];
@@ -2066,6 +2942,7 @@ static CPresult Nvmm_InvalidateCache(CPhandle hContent)
         {
             if (!CheckFileChunkInUse(pFileCache, pFileChunk))
             {
+                RetireFileChunk(pFileCache, pFileChunk);
                 pFileChunk->status = INVALID;
             }
             else
@@ -2093,7 +2970,11 @@ static CPresult Nvmm_PauseCaching(CPhandle hContent, CPbool bPause)
 
         pFileCache->bCachingPaused = bPause;
 
-        if (!pFileCache->bCachingPaused)
+        if (pFileCache->hShared)
+        {
+            NvmmSharedCachePause(pFileCache->hShared, bPause || pFileCache->bStop);
+        }
+        else if (!pFileCache->bCachingPaused)
         {
             NvOsSemaphoreSignal(pFileCache->WorkerSema);
         }
@@ -2114,6 +2995,26 @@ static CPresult Nvmm_GetPositionEx(CPhandle hContent, CP_PositionInfoType* pPosi
     NvS32 j,k;
     NvmmFileCache *pFileCache = (NvmmFileCache *)hContent;
 
+    if (pFileCache->bMapped)
+    {
+        // the whole file is available
+        pPosition->nDataBegin = 0;
+        pPosition->nDataFirst = 0;
+        pPosition->nDataCur = pFileCache->MapPosition;
+        pPosition->nDataLast = pFileCache->FileSize;
+        pPosition->nDataEnd = pFileCache->FileSize;
+        return NvSuccess;
+    }
+
+    if (pFileCache->hShared)
+    {
+        pPosition->nDataBegin = 0;
+        pPosition->nDataCur = NvmmSharedCacheGetPosition(pFileCache->hShared);
+        NvmmSharedCacheGetCachedRange(pFileCache->hShared, &pPosition->nDataFirst, &pPosition->nDataLast);
+        pPosition->nDataEnd = pFileCache->FileSize;
+        return NvSuccess;
+    }
+
     if (!pFileCache->bInitialized)
        return NvSuccess;
     NvOsMutexLock(pFileCache->ChunkLock);
@@ -2239,6 +3140,20 @@ static CPresult Nvmm_GetCPConfig(CPhandle hContent, CP_ConfigIndex nIndex, void
                 NV_LOGGER_PRINT((NVLOG_CONTENT_PIPE, NVLOG_WARN,"Nvmm_GetCPConfig:: CP_ConfigIndexThreshold case, not handled %x\n", nIndex));
                 break;
        }
+        case CP_ConfigQueryReadAheadStats:
+        {
+            if (pFileCache->hShared)
+            {
+                NvmmSharedCacheGetStats(pFileCache->hShared, (CP_ReadAheadStats *)pConfigStructure);
+                break;
+            }
+            if (pFileCache->ChunkLock)
+                NvOsMutexLock(pFileCache->ChunkLock);
+            *(CP_ReadAheadStats *)pConfigStructure = pFileCache->ReadAheadStats;
+            if (pFileCache->ChunkLock)
+                NvOsMutexUnlock(pFileCache->ChunkLock);
+            break;
+        }
        case CP_ConfigQueryMetaInterval:
         {
             pFileCache->pProtocol->QueryConfig(pFileCache->hFile, 
@@ -2364,6 +3279,17 @@ static CPresult Nvmm_SetCPConfig(CPhandle hContent, CP_ConfigIndex nIndex, void
             NV_LOGGER_PRINT((NVLOG_CONTENT_PIPE, NVLOG_WARN, "Nvmm_SetCPConfig:: CP_ConfigQueryActualSeekTime case, not handled %x\n", nIndex));
             break;
         }
+        case CP_ConfigIndexReadAheadRanges:
+        {
+            return SetReadAheadRanges(pFileCache, (CP_ConfigReadAheadRanges *)pConfigStructure);
+        }
+        case CP_ConfigIndexMapContent:
+        {
+            if (pFileCache->bInitialized || pFileCache->bMapped || pFileCache->hShared)
+                return NvError_InvalidState;
+            pFileCache->bMapRequested = *(NvBool *)pConfigStructure;
+            break;
+        }
         default:
         break;
     }
@@ -2374,6 +3300,13 @@ static CPresult Nvmm_SetCPConfig(CPhandle hContent, CP_ConfigIndex nIndex, void
 static CPresult Nvmm_StopCaching(CPhandle hContent)
 {
     NvmmFileCache *pFileCache = (NvmmFileCache *)hContent;
+    if (pFileCache->hShared)
+    {
+        // reads are still served by the cache, only the read-ahead stops
+        pFileCache->bStop = NV_TRUE;
+        NvmmSharedCachePause(pFileCache->hShared, NV_TRUE);
+        return NvSuccess;
+    }
     NvOsMutexLock(pFileCache->WriteLock);
     pFileCache->bStop = NV_TRUE;
     NvOsMutexUnlock(pFileCache->WriteLock);
@@ -2384,6 +3317,11 @@ static CPresult Nvmm_StartCaching(CPhandle hContent)
 {
     NvmmFileCache *pFileCache = (NvmmFileCache *)hContent;
     pFileCache->bStop = NV_FALSE;
+    if (pFileCache->hShared)
+    {
+        NvmmSharedCachePause(pFileCache->hShared, pFileCache->bCachingPaused);
+        return NvSuccess;
+    }
     if (pFileCache->CacheSize)
     {
         NvOsSemaphoreSignal(pFileCache->WorkerSema);
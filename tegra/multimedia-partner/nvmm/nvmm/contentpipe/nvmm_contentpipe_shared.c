@@ -0,0 +1,972 @@
+/* Copyright (c) 2013 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an
+ * express license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+#include "nvmm_contentpipe_shared.h"
+#include "nvrm_memmgr.h"
+#include "nvos.h"
+#include "nvmm_logger.h"
+
+#define NVLOG_CLIENT NVLOG_CONTENT_PIPE // required for logging contentpipe traces
+
+#define SHARED_BLOCK_SIZE (256 * 1024)
+#define SHARED_MIN_BLOCKS 4
+
+enum SharedBlockStatus
+{
+    SHARED_BLOCK_FREE = 0,
+    SHARED_BLOCK_FILLING = 1,
+    SHARED_BLOCK_FULL = 2,
+    SHARED_BLOCK_SPARE = 3      // holds the copy of a read buffer spanning blocks
+};
+
+typedef struct SharedBlockRec
+{
+    NvU64               Position;   // block aligned file offset
+    NvU32               Size;
+    NvU32               Status;
+    NvU32               nPins;      // read buffers handed out from the block
+    NvU32               LastUse;
+    struct NvmmSharedReaderRec *pFetcher; // read ahead for this reader, until someone uses it
+}SharedBlock;
+
+typedef struct SharedBufferRec
+{
+    NvU8                *pBuffer;
+    NvU32               First;      // index of the first block it lies in
+    NvU32               Count;
+    NvBool              bSpare;     // the blocks are a copy, not pinned cached blocks
+}SharedBuffer;
+
+typedef struct NvmmSharedCacheRec NvmmSharedCache;
+
+typedef struct NvmmSharedReaderRec
+{
+    struct NvmmSharedReaderRec *pNext;
+    NvmmSharedCache     *pCache;
+    NvCPRHandle         hFile;
+    NvU64               Position;
+    NvBool              bRead;      // read at Position since it last seeked
+    NvU64               Other;      // where it read before, the other stream of an interleaved file
+    NvBool              bOther;
+    NvBool              bPaused;
+
+    SharedBuffer        *pBuffers;
+    NvU32               nBuffers;
+    NvU32               nMaxBuffers;
+
+    CP_ReadAheadStats   Stats;
+}NvmmSharedReader;
+
+struct NvmmSharedCacheRec
+{
+    NvmmSharedCache     *pNext;
+    NV_CUSTOM_PROTOCOL  *pProtocol;
+    NvCPR_ContentId     Id;
+    NvU64               FileSize;
+    NvU32               nRefs;      // under s_SharedCacheLock
+
+    NvRmDeviceHandle    hRmDevice;
+    NvRmMemHandle       hMem;
+    NvRmPhysAddr        PhyAddress;
+    NvU8                *pBits;
+    NvU32               PoolSize;
+
+    // everything below is under Lock
+    SharedBlock         *pBlocks;
+    NvU32               nBlocks;
+    NvU32               Clock;
+
+    NvmmSharedReader    *pReaders;
+    NvU32               nReaders;
+    NvU32               NextReader; // the worker serves readers in turn from here
+
+    NvOsMutexHandle     Lock;
+    NvOsSemaphoreHandle WorkerSema;
+    NvOsThreadHandle    WorkerThread;
+    NvCPRHandle         hFile;      // the worker's own
+    NvBool              bShutDown;
+};
+
+static NvmmSharedCache *s_pSharedCaches = NULL;
+static NvOsMutexHandle s_SharedCacheLock = NULL;
+static NvS32 s_SharedCacheLockState = 0; // 1 while s_SharedCacheLock is created, 2 once it is
+
+static NvError LockSharedCaches(void)
+{
+    NvError e;
+
+    while (NvOsAtomicExchangeAdd32(&s_SharedCacheLockState, 0) != 2)
+    {
+        if (NvOsAtomicCompareExchange32(&s_SharedCacheLockState, 0, 1) == 0)
+        {
+            e = NvOsMutexCreate(&s_SharedCacheLock);
+            NvOsAtomicExchange32(&s_SharedCacheLockState, (e == NvSuccess) ? 2 : 0);
+            if (e != NvSuccess)
+                return e;
+        }
+        else
+        {
+            NvOsThreadYield();
+        }
+    }
+    NvOsMutexLock(s_SharedCacheLock);
+    return NvSuccess;
+}
+
+static NvU64 BlockStart(NvU64 Position)
+{
+    return Position - Position % SHARED_BLOCK_SIZE;
+}
+
+static NvU8 *BlockData(NvmmSharedCache *pCache, SharedBlock *pBlock)
+{
+    return pCache->pBits + (NvU32)(pBlock - pCache->pBlocks) * SHARED_BLOCK_SIZE;
+}
+
+// The block holding Position, cached or being read
+static SharedBlock *FindBlock(NvmmSharedCache *pCache, NvU64 Position)
+{
+    NvU64 Start = BlockStart(Position);
+    SharedBlock *pBlock;
+    NvU32 i;
+
+    for (i = 0; i < pCache->nBlocks; i++)
+    {
+        pBlock = &pCache->pBlocks[i];
+        if (((pBlock->Status == SHARED_BLOCK_FULL) || (pBlock->Status == SHARED_BLOCK_FILLING)) &&
+            (pBlock->Position == Start))
+        {
+            return pBlock;
+        }
+    }
+    return NULL;
+}
+
+// Blocks of the pool each reader may keep ahead of its cursor
+static NvU32 GetShare(NvmmSharedCache *pCache)
+{
+    NvU32 nShare = pCache->nBlocks / (pCache->nReaders ? pCache->nReaders : 1);
+
+    return nShare ? nShare : 1;
+}
+
+// A reader reading two streams splits its share between their cursors
+static NvU32 GetCursorShare(NvmmSharedCache *pCache, NvmmSharedReader *pReader)
+{
+    NvU32 nShare = GetShare(pCache);
+
+    if (pReader->bOther)
+        nShare /= 2;
+    return nShare ? nShare : 1;
+}
+
+static NvBool InCursorWindow(NvU64 Cursor, NvU32 nShare, SharedBlock *pBlock)
+{
+    NvU64 Start = BlockStart(Cursor);
+
+    return ((pBlock->Position >= Start) &&
+            (pBlock->Position < Start + (NvU64)nShare * SHARED_BLOCK_SIZE)) ? NV_TRUE : NV_FALSE;
+}
+
+// How many blocks ahead of one of the reader's cursors pBlock lies; its
+// share of the pool if pBlock is outside its window
+static NvU32 WindowOffset(NvmmSharedCache *pCache, NvmmSharedReader *pReader, SharedBlock *pBlock)
+{
+    NvU32 nShare = GetCursorShare(pCache, pReader);
+
+    if (InCursorWindow(pReader->Position, nShare, pBlock))
+        return (NvU32)((pBlock->Position - BlockStart(pReader->Position)) / SHARED_BLOCK_SIZE);
+    if (pReader->bOther && InCursorWindow(pReader->Other, nShare, pBlock))
+        return (NvU32)((pBlock->Position - BlockStart(pReader->Other)) / SHARED_BLOCK_SIZE);
+    return nShare;
+}
+
+static NvBool InWindow(NvmmSharedCache *pCache, NvmmSharedReader *pReader, SharedBlock *pBlock)
+{
+    return (WindowOffset(pCache, pReader, pBlock) < GetCursorShare(pCache, pReader)) ? NV_TRUE : NV_FALSE;
+}
+
+static NvBool InOtherWindow(NvmmSharedCache *pCache, SharedBlock *pBlock, NvmmSharedReader *pSkip)
+{
+    NvmmSharedReader *pReader;
+
+    for (pReader = pCache->pReaders; pReader; pReader = pReader->pNext)
+    {
+        if ((pReader != pSkip) && InWindow(pCache, pReader, pBlock))
+            return NV_TRUE;
+    }
+    return NV_FALSE;
+}
+
+static void DropBlock(SharedBlock *pBlock)
+{
+    // read ahead for a reader that never got to it
+    if ((pBlock->Status == SHARED_BLOCK_FULL) && pBlock->pFetcher)
+        pBlock->pFetcher->Stats.nBytesWasted += pBlock->Size;
+    pBlock->Status = SHARED_BLOCK_FREE;
+    pBlock->Size = 0;
+    pBlock->pFetcher = NULL;
+}
+
+static void UseBlock(NvmmSharedCache *pCache, SharedBlock *pBlock)
+{
+    pBlock->LastUse = ++pCache->Clock;
+    pBlock->pFetcher = NULL;
+}
+
+// Evictable: free, or cached and neither handed out nor in the window of a
+// reader other than pReader. The worker passes no reader.
+static NvBool IsEvictable(NvmmSharedCache *pCache, SharedBlock *pBlock, NvmmSharedReader *pReader)
+{
+    if (pBlock->Status == SHARED_BLOCK_FREE)
+        return NV_TRUE;
+    if ((pBlock->Status != SHARED_BLOCK_FULL) || pBlock->nPins)
+        return NV_FALSE;
+    return !InOtherWindow(pCache, pBlock, pReader);
+}
+
+// The free block, else the least recently used evictable one outside every
+// window. A reader that has to read a block itself may take the far end of
+// its own window as a last resort.
+static SharedBlock *PickVictim(NvmmSharedCache *pCache, NvmmSharedReader *pReader)
+{
+    SharedBlock *pBlock, *pVictim = NULL, *pOwn = NULL;
+    NvU32 i, nOffset, nOwnOffset = 0;
+
+    for (i = 0; i < pCache->nBlocks; i++)
+    {
+        pBlock = &pCache->pBlocks[i];
+        if (pBlock->Status == SHARED_BLOCK_FREE)
+            return pBlock;
+        if (!IsEvictable(pCache, pBlock, pReader))
+            continue;
+        nOffset = pReader ? WindowOffset(pCache, pReader, pBlock) : 0;
+        if (pReader && (nOffset < GetCursorShare(pCache, pReader)))
+        {
+            if (!pOwn || (nOffset > nOwnOffset))
+            {
+                pOwn = pBlock;
+                nOwnOffset = nOffset;
+            }
+        }
+        else if (!pVictim || ((NvS32)(pBlock->LastUse - pVictim->LastUse) < 0))
+        {
+            pVictim = pBlock;
+        }
+    }
+    return pVictim ? pVictim : pOwn;
+}
+
+// Reads the file block at Position into pBlock through hFile. Called with
+// Lock held, which is dropped for the read.
+static NvError FillBlock(NvmmSharedCache *pCache, SharedBlock *pBlock, NvU64 Position,
+                         NvCPRHandle hFile, NvmmSharedReader *pFetcher)
+{
+    NvU8 *pData = BlockData(pCache, pBlock);
+    NvU32 nSize = SHARED_BLOCK_SIZE, nRead = 0, n;
+    NvError status;
+
+    if (nSize > pCache->FileSize - Position)
+        nSize = (NvU32)(pCache->FileSize - Position);
+
+    DropBlock(pBlock);
+    pBlock->Status = SHARED_BLOCK_FILLING;
+    pBlock->Position = Position;
+    pBlock->pFetcher = pFetcher;
+    NvOsMutexUnlock(pCache->Lock);
+
+    status = pCache->pProtocol->SetPosition(hFile, (NvS64)Position, NvCPR_OriginBegin);
+    while ((status == NvSuccess) && (nRead < nSize))
+    {
+        n = pCache->pProtocol->Read(hFile, pData + nRead, nSize - nRead);
+        if (!n)
+            status = NvError_FileReadFailed;
+        nRead += n;
+    }
+
+    NvOsMutexLock(pCache->Lock);
+    if (status != NvSuccess)
+    {
+        NV_LOGGER_PRINT((NVLOG_CONTENT_PIPE, NVLOG_ERROR, "NvmmSharedCache: read of 0x%x bytes at %lld failed", nSize, Position));
+        pBlock->Status = SHARED_BLOCK_FREE;
+        pBlock->pFetcher = NULL;
+        return status;
+    }
+    pBlock->Size = nSize;
+    pBlock->Status = SHARED_BLOCK_FULL;
+    pBlock->LastUse = ++pCache->Clock;
+    // the reader may have left while the block was read
+    if (pBlock->pFetcher)
+        pBlock->pFetcher->Stats.nBytesFetched += nSize;
+    return NvSuccess;
+}
+
+// The cached block holding Position, read by the reader itself if the worker
+// has not got to it. Called with Lock held.
+static NvError GetBlock(NvmmSharedCache *pCache, NvmmSharedReader *pReader, NvU64 Position,
+                        SharedBlock **ppBlock, NvBool *pbMiss)
+{
+    SharedBlock *pBlock;
+    NvError status;
+
+    while ((pBlock = FindBlock(pCache, Position)) != NULL)
+    {
+        if (pBlock->Status == SHARED_BLOCK_FULL)
+        {
+            *ppBlock = pBlock;
+            return NvSuccess;
+        }
+        // someone else is reading it
+        *pbMiss = NV_TRUE;
+        NvOsMutexUnlock(pCache->Lock);
+        NvOsSleepMS(1);
+        NvOsMutexLock(pCache->Lock);
+    }
+
+    *pbMiss = NV_TRUE;
+    pBlock = PickVictim(pCache, pReader);
+    if (!pBlock)
+        return NvError_ContentPipeNoFreeBuffers;
+    status = FillBlock(pCache, pBlock, BlockStart(Position), pReader->hFile, pReader);
+    if (status != NvSuccess)
+        return status;
+    *ppBlock = pBlock;
+    return NvSuccess;
+}
+
+// Moves the cursor to Position. A seek out of the window of a cursor the
+// reader has read at keeps that cursor as the other stream, so that the two
+// streams of an interleaved file keep their read ahead while the reader
+// alternates between them.
+static void MoveCursor(NvmmSharedReader *pReader, NvU64 Position, NvBool bSeek)
+{
+    NvmmSharedCache *pCache = pReader->pCache;
+    NvBool bWake = (BlockStart(Position) != BlockStart(pReader->Position));
+
+    if (!bSeek)
+    {
+        pReader->bRead = NV_TRUE;
+    }
+    else if ((Position < BlockStart(pReader->Position)) ||
+             (Position >= BlockStart(pReader->Position) + (NvU64)GetCursorShare(pCache, pReader) * SHARED_BLOCK_SIZE))
+    {
+        if (pReader->bRead)
+        {
+            pReader->Other = pReader->Position;
+            pReader->bOther = NV_TRUE;
+        }
+        pReader->bRead = NV_FALSE;
+    }
+    pReader->Position = Position;
+    // the window moved on, there is something to read ahead
+    if (bWake)
+        NvOsSemaphoreSignal(pReader->pCache->WorkerSema);
+}
+
+static void ReleaseBlocks(NvmmSharedCache *pCache, SharedBuffer *pBuffer)
+{
+    SharedBlock *pBlock;
+    NvU32 i;
+
+    for (i = pBuffer->First; i < pBuffer->First + pBuffer->Count; i++)
+    {
+        pBlock = &pCache->pBlocks[i];
+        if (pBuffer->bSpare)
+            pBlock->Status = SHARED_BLOCK_FREE;
+        else if (pBlock->nPins)
+            pBlock->nPins--;
+    }
+}
+
+// Nearest block ahead of the reader's cursors that is neither cached nor
+// being read
+static NvBool FindMissingBlock(NvmmSharedCache *pCache, NvmmSharedReader *pReader, NvU64 *pPosition)
+{
+    NvU32 nShare = GetCursorShare(pCache, pReader);
+    NvU32 nCursors = pReader->bOther ? 2 : 1;
+    NvU64 Position;
+    NvU32 i, j;
+
+    for (i = 0; i < nShare; i++)
+    {
+        for (j = 0; j < nCursors; j++)
+        {
+            Position = BlockStart(j ? pReader->Other : pReader->Position) + (NvU64)i * SHARED_BLOCK_SIZE;
+            if ((Position < pCache->FileSize) && !FindBlock(pCache, Position))
+            {
+                *pPosition = Position;
+                return NV_TRUE;
+            }
+        }
+    }
+    return NV_FALSE;
+}
+
+// Reads one block ahead for the next reader in turn that misses one, so that
+// a fast reader does not starve the others of the worker
+static NvBool ReadAheadOne(NvmmSharedCache *pCache)
+{
+    NvmmSharedReader *pReader;
+    SharedBlock *pBlock;
+    NvU64 Position;
+    NvU32 i, j;
+
+    for (i = 0; i < pCache->nReaders; i++)
+    {
+        pReader = pCache->pReaders;
+        for (j = (pCache->NextReader + i) % pCache->nReaders; j; j--)
+            pReader = pReader->pNext;
+
+        if (pReader->bPaused || !FindMissingBlock(pCache, pReader, &Position))
+            continue;
+
+        pBlock = PickVictim(pCache, NULL);
+        if (!pBlock)
+            return NV_FALSE;
+        pCache->NextReader = (pCache->NextReader + i + 1) % pCache->nReaders;
+        return (FillBlock(pCache, pBlock, Position, pCache->hFile, pReader) == NvSuccess);
+    }
+    return NV_FALSE;
+}
+
+static void SharedCacheThread(void *arg)
+{
+    NvmmSharedCache *pCache = (NvmmSharedCache *)arg;
+
+    NvBool bShutDown = NV_FALSE;
+
+    while (!bShutDown)
+    {
+        NvOsSemaphoreWait(pCache->WorkerSema);
+
+        NvOsMutexLock(pCache->Lock);
+        while (!pCache->bShutDown && ReadAheadOne(pCache))
+            ;
+        bShutDown = pCache->bShutDown;
+        NvOsMutexUnlock(pCache->Lock);
+    }
+}
+
+static void SharedCacheDestroy(NvmmSharedCache *pCache)
+{
+    if (pCache->WorkerThread)
+    {
+        NvOsMutexLock(pCache->Lock);
+        pCache->bShutDown = NV_TRUE;
+        NvOsMutexUnlock(pCache->Lock);
+        NvOsSemaphoreSignal(pCache->WorkerSema);
+        NvOsThreadJoin(pCache->WorkerThread);
+    }
+    if (pCache->hFile)
+        pCache->pProtocol->Close(pCache->hFile);
+    NvOsSemaphoreDestroy(pCache->WorkerSema);
+    NvOsMutexDestroy(pCache->Lock);
+    if (pCache->hMem)
+    {
+        if (pCache->pBits)
+            NvRmMemUnmap(pCache->hMem, pCache->pBits, pCache->PoolSize);
+        NvRmMemUnpin(pCache->hMem);
+        NvRmMemHandleFree(pCache->hMem);
+    }
+    NvRmClose(pCache->hRmDevice);
+    NvOsFree(pCache->pBlocks);
+    NvOsFree(pCache);
+}
+
+static NvError SharedCacheCreate(NV_CUSTOM_PROTOCOL *pProtocol, const char *szURI,
+                                 const NvCPR_ContentId *pId, NvU64 CacheSize,
+                                 NvmmSharedCache **ppCache)
+{
+    NvmmSharedCache *pCache;
+    NvU64 nBlocks;
+    NvError e;
+
+    nBlocks = (CacheSize + SHARED_BLOCK_SIZE - 1) / SHARED_BLOCK_SIZE;
+    if (nBlocks < SHARED_MIN_BLOCKS)
+        nBlocks = SHARED_MIN_BLOCKS;
+    if (nBlocks > (NvU32)-1 / SHARED_BLOCK_SIZE)
+        return NvError_BadParameter;
+
+    pCache = NvOsAlloc(sizeof(NvmmSharedCache));
+    if (!pCache)
+        return NvError_InsufficientMemory;
+    NvOsMemset(pCache, 0, sizeof(NvmmSharedCache));
+    pCache->pProtocol = pProtocol;
+    pCache->Id = *pId;
+    pCache->FileSize = pId->nSize;
+    pCache->nBlocks = (NvU32)nBlocks;
+    pCache->PoolSize = pCache->nBlocks * SHARED_BLOCK_SIZE;
+
+    pCache->pBlocks = NvOsAlloc(sizeof(SharedBlock) * pCache->nBlocks);
+    if (!pCache->pBlocks)
+    {
+        e = NvError_InsufficientMemory;
+        goto fail;
+    }
+    NvOsMemset(pCache->pBlocks, 0, sizeof(SharedBlock) * pCache->nBlocks);
+
+    NV_CHECK_ERROR_CLEANUP(
+        NvRmOpen(&pCache->hRmDevice, 0)
+        );
+    NV_CHECK_ERROR_CLEANUP(
+        NvRmMemHandleAlloc(pCache->hRmDevice, NULL, 0, 4, NvOsMemAttribute_Uncached,
+                           pCache->PoolSize, 0, 0, &pCache->hMem)
+        );
+    pCache->PhyAddress = NvRmMemPin(pCache->hMem);
+    NV_CHECK_ERROR_CLEANUP(
+        NvRmMemMap(pCache->hMem, 0, pCache->PoolSize, NVOS_MEM_READ_WRITE, (void **)&pCache->pBits)
+        );
+
+    NV_CHECK_ERROR_CLEANUP(
+        NvOsMutexCreate(&pCache->Lock)
+        );
+    NV_CHECK_ERROR_CLEANUP(
+        NvOsSemaphoreCreate(&pCache->WorkerSema, 0)
+        );
+    NV_CHECK_ERROR_CLEANUP(
+        pProtocol->Open(&pCache->hFile, (char *)szURI, NvCPR_AccessRead)
+        );
+    NV_CHECK_ERROR_CLEANUP(
+        NvOsThreadCreate(SharedCacheThread, (void *)pCache, &pCache->WorkerThread)
+        );
+
+    *ppCache = pCache;
+    return NvSuccess;
+
+fail:
+    SharedCacheDestroy(pCache);
+    return e;
+}
+
+NvError NvmmSharedCacheAttach(
+    NV_CUSTOM_PROTOCOL *pProtocol,
+    NvCPRHandle hFile,
+    const char *szURI,
+    const NvCPR_ContentId *pId,
+    NvU64 CacheSize,
+    NvU64 Position,
+    NvmmSharedReaderHandle *phReader)
+{
+    NvmmSharedReader *pReader;
+    NvmmSharedCache *pCache;
+    NvError e;
+
+    if (!pProtocol || !hFile || !szURI || !pId || !pId->nSize || !phReader)
+        return NvError_BadParameter;
+
+    pReader = NvOsAlloc(sizeof(NvmmSharedReader));
+    if (!pReader)
+        return NvError_InsufficientMemory;
+    NvOsMemset(pReader, 0, sizeof(NvmmSharedReader));
+    pReader->hFile = hFile;
+    pReader->Position = Position;
+
+    e = LockSharedCaches();
+    if (e != NvSuccess)
+    {
+        NvOsFree(pReader);
+        return e;
+    }
+    for (pCache = s_pSharedCaches; pCache; pCache = pCache->pNext)
+    {
+        if ((pCache->pProtocol == pProtocol) &&
+            !NvOsMemcmp(&pCache->Id, pId, sizeof(NvCPR_ContentId)))
+        {
+            break;
+        }
+    }
+    if (!pCache)
+    {
+        e = SharedCacheCreate(pProtocol, szURI, pId, CacheSize, &pCache);
+        if (e != NvSuccess)
+        {
+            NvOsMutexUnlock(s_SharedCacheLock);
+            NvOsFree(pReader);
+            return e;
+        }
+        pCache->pNext = s_pSharedCaches;
+        s_pSharedCaches = pCache;
+    }
+    pCache->nRefs++;
+    pReader->pCache = pCache;
+
+    NvOsMutexLock(pCache->Lock);
+    pReader->pNext = pCache->pReaders;
+    pCache->pReaders = pReader;
+    pCache->nReaders++;
+    NvOsMutexUnlock(pCache->Lock);
+    NvOsMutexUnlock(s_SharedCacheLock);
+
+    NV_LOGGER_PRINT((NVLOG_CONTENT_PIPE, NVLOG_INFO, "NvmmSharedCache: reader %d of %s, %d blocks", pCache->nRefs, szURI, pCache->nBlocks));
+    NvOsSemaphoreSignal(pCache->WorkerSema);
+    *phReader = pReader;
+    return NvSuccess;
+}
+
+void NvmmSharedCacheDetach(NvmmSharedReaderHandle hReader)
+{
+    NvmmSharedReader *pReader = hReader;
+    NvmmSharedCache *pCache = pReader->pCache;
+    NvmmSharedReader **ppLink;
+    NvU32 i;
+
+    // the lock exists, the reader could not have attached otherwise
+    (void)LockSharedCaches();
+
+    NvOsMutexLock(pCache->Lock);
+    for (ppLink = &pCache->pReaders; *ppLink; ppLink = &(*ppLink)->pNext)
+    {
+        if (*ppLink == pReader)
+        {
+            *ppLink = pReader->pNext;
+            break;
+        }
+    }
+    pCache->nReaders--;
+    pCache->NextReader = 0;
+    while (pReader->nBuffers)
+        ReleaseBlocks(pCache, &pReader->pBuffers[--pReader->nBuffers]);
+    for (i = 0; i < pCache->nBlocks; i++)
+    {
+        if (pCache->pBlocks[i].pFetcher == pReader)
+            pCache->pBlocks[i].pFetcher = NULL;
+    }
+    NvOsMutexUnlock(pCache->Lock);
+
+    if (--pCache->nRefs == 0)
+    {
+        NvmmSharedCache **ppCache;
+
+        for (ppCache = &s_pSharedCaches; *ppCache; ppCache = &(*ppCache)->pNext)
+        {
+            if (*ppCache == pCache)
+            {
+                *ppCache = pCache->pNext;
+                break;
+            }
+        }
+    }
+    else
+    {
+        // the others get its share
+        NvOsSemaphoreSignal(pCache->WorkerSema);
+        pCache = NULL;
+    }
+    NvOsMutexUnlock(s_SharedCacheLock);
+
+    if (pCache)
+        SharedCacheDestroy(pCache);
+    NvOsFree(pReader->pBuffers);
+    NvOsFree(pReader);
+}
+
+NvU64 NvmmSharedCacheGetPosition(NvmmSharedReaderHandle hReader)
+{
+    return hReader->Position;
+}
+
+void NvmmSharedCacheSetPosition(NvmmSharedReaderHandle hReader, NvU64 Position)
+{
+    NvmmSharedCache *pCache = hReader->pCache;
+
+    NvOsMutexLock(pCache->Lock);
+    MoveCursor(hReader, Position, NV_TRUE);
+    NvOsMutexUnlock(pCache->Lock);
+}
+
+NvError NvmmSharedCacheRead(NvmmSharedReaderHandle hReader, NvU8 *pData, NvU32 nSize)
+{
+    NvmmSharedReader *pReader = hReader;
+    NvmmSharedCache *pCache = pReader->pCache;
+    NvU64 Position = pReader->Position;
+    SharedBlock *pBlock = NULL;
+    NvBool bMiss = NV_FALSE;
+    NvError status = NvSuccess;
+    NvU32 nOffset, n;
+
+    if ((Position >= pCache->FileSize) || (nSize > pCache->FileSize - Position))
+        return NvError_EndOfFile;
+
+    NvOsMutexLock(pCache->Lock);
+    while (nSize)
+    {
+        status = GetBlock(pCache, pReader, Position, &pBlock, &bMiss);
+        if (status != NvSuccess)
+            break;
+        nOffset = (NvU32)(Position - pBlock->Position);
+        n = pBlock->Size - nOffset;
+        if (n > nSize)
+            n = nSize;
+        NvOsMemcpy(pData, BlockData(pCache, pBlock) + nOffset, n);
+        UseBlock(pCache, pBlock);
+        pData += n;
+        nSize -= n;
+        Position += n;
+    }
+    if (bMiss)
+        pReader->Stats.nMisses++;
+    else
+        pReader->Stats.nHits++;
+    MoveCursor(pReader, Position, NV_FALSE);
+    NvOsMutexUnlock(pCache->Lock);
+    return status;
+}
+
+// Whether pBlock may hold a spare copy: on pass 0 only if it is free, on
+// pass 1 if no other reader wants it, on pass 2 if it is not handed out
+static NvBool CanSpare(NvmmSharedCache *pCache, SharedBlock *pBlock, NvmmSharedReader *pReader, NvU32 nPass)
+{
+    if (pBlock->Status == SHARED_BLOCK_FREE)
+        return NV_TRUE;
+    if (nPass == 1)
+        return IsEvictable(pCache, pBlock, pReader);
+    if (nPass == 2)
+        return ((pBlock->Status == SHARED_BLOCK_FULL) && !pBlock->nPins) ? NV_TRUE : NV_FALSE;
+    return NV_FALSE;
+}
+
+// Copies [Position, Position + nSize), whose blocks are pinned, to nSpan
+// consecutive blocks of the pool, evicting as little as it can.
+static NvError CopyToSpare(NvmmSharedCache *pCache, NvmmSharedReader *pReader,
+                           NvU64 Position, NvU32 nSize, NvU32 nSpan, SharedBuffer *pBuffer)
+{
+    SharedBlock *pBlock;
+    NvU32 nPass, First, i, nOffset, n;
+    NvU8 *pDst;
+
+    for (nPass = 0; nPass < 3; nPass++)
+    {
+        for (First = 0; First + nSpan <= pCache->nBlocks; First++)
+        {
+            for (i = First; i < First + nSpan; i++)
+            {
+                if (!CanSpare(pCache, &pCache->pBlocks[i], pReader, nPass))
+                    break;
+            }
+            if (i == First + nSpan)
+                goto found;
+            First = i;
+        }
+    }
+    return NvError_ContentPipeSpareAreaInUse;
+
+found:
+    for (i = First; i < First + nSpan; i++)
+    {
+        DropBlock(&pCache->pBlocks[i]);
+        pCache->pBlocks[i].Status = SHARED_BLOCK_SPARE;
+    }
+    pBuffer->pBuffer = pDst = BlockData(pCache, &pCache->pBlocks[First]);
+    pBuffer->First = First;
+    pBuffer->Count = nSpan;
+    pBuffer->bSpare = NV_TRUE;
+
+    while (nSize)
+    {
+        pBlock = FindBlock(pCache, Position);
+        nOffset = (NvU32)(Position - pBlock->Position);
+        n = pBlock->Size - nOffset;
+        if (n > nSize)
+            n = nSize;
+        NvOsMemcpy(pDst, BlockData(pCache, pBlock) + nOffset, n);
+        pDst += n;
+        nSize -= n;
+        Position += n;
+    }
+    return NvSuccess;
+}
+
+NvError NvmmSharedCacheReadBuffer(NvmmSharedReaderHandle hReader, NvU32 nSize, NvU8 **ppBuffer)
+{
+    NvmmSharedReader *pReader = hReader;
+    NvmmSharedCache *pCache = pReader->pCache;
+    NvU64 Position = pReader->Position;
+    NvU64 Start = BlockStart(Position);
+    SharedBlock *pBlock = NULL, *pFirst = NULL;
+    SharedBuffer *pBuffer;
+    NvBool bMiss = NV_FALSE, bInPlace = NV_TRUE;
+    NvError status = NvSuccess;
+    NvU32 nSpan, nPinned, i;
+
+    if (!nSize || (Position >= pCache->FileSize) || (nSize > pCache->FileSize - Position))
+        return NvError_EndOfFile;
+    nSpan = (NvU32)((BlockStart(Position + nSize - 1) - Start) / SHARED_BLOCK_SIZE) + 1;
+
+    NvOsMutexLock(pCache->Lock);
+    if (pReader->nBuffers == pReader->nMaxBuffers)
+    {
+        pBuffer = NvOsRealloc(pReader->pBuffers, sizeof(SharedBuffer) * (pReader->nMaxBuffers + 16));
+        if (!pBuffer)
+        {
+            status = NvError_ContentPipeNoFreeBuffers;
+            goto cleanup;
+        }
+        pReader->pBuffers = pBuffer;
+        pReader->nMaxBuffers += 16;
+    }
+    pBuffer = &pReader->pBuffers[pReader->nBuffers];
+
+    // pin the blocks as they come, so that reading the rest cannot evict them
+    for (nPinned = 0; nPinned < nSpan; nPinned++)
+    {
+        status = GetBlock(pCache, pReader, Start + (NvU64)nPinned * SHARED_BLOCK_SIZE, &pBlock, &bMiss);
+        if (status != NvSuccess)
+            break;
+        pBlock->nPins++;
+        UseBlock(pCache, pBlock);
+        if (!pFirst)
+            pFirst = pBlock;
+        else if (pBlock != pFirst + nPinned)
+            bInPlace = NV_FALSE;
+    }
+
+    if (status == NvSuccess)
+    {
+        if (bInPlace)
+        {
+            // the blocks follow each other in the pool too
+            pBuffer->pBuffer = BlockData(pCache, pFirst) + (NvU32)(Position - Start);
+            pBuffer->First = (NvU32)(pFirst - pCache->pBlocks);
+            pBuffer->Count = nSpan;
+            pBuffer->bSpare = NV_FALSE;
+            nPinned = 0;
+        }
+        else
+        {
+            status = CopyToSpare(pCache, pReader, Position, nSize, nSpan, pBuffer);
+        }
+    }
+
+    // the copy or a failure leaves nothing pinned
+    for (i = 0; i < nPinned; i++)
+        FindBlock(pCache, Start + (NvU64)i * SHARED_BLOCK_SIZE)->nPins--;
+
+    if (status == NvSuccess)
+    {
+        pReader->nBuffers++;
+        *ppBuffer = pBuffer->pBuffer;
+        MoveCursor(pReader, Position + nSize, NV_FALSE);
+    }
+    if (bMiss)
+        pReader->Stats.nMisses++;
+    else
+        pReader->Stats.nHits++;
+
+cleanup:
+    NvOsMutexUnlock(pCache->Lock);
+    return status;
+}
+
+NvError NvmmSharedCacheReleaseBuffer(NvmmSharedReaderHandle hReader, NvU8 *pBuffer)
+{
+    NvmmSharedReader *pReader = hReader;
+    NvmmSharedCache *pCache = pReader->pCache;
+    NvError status = NvError_BadParameter;
+    NvU32 i;
+
+    NvOsMutexLock(pCache->Lock);
+    for (i = 0; i < pReader->nBuffers; i++)
+    {
+        if (pReader->pBuffers[i].pBuffer == pBuffer)
+        {
+            ReleaseBlocks(pCache, &pReader->pBuffers[i]);
+            pReader->pBuffers[i] = pReader->pBuffers[--pReader->nBuffers];
+            status = NvSuccess;
+            break;
+        }
+    }
+    NvOsMutexUnlock(pCache->Lock);
+
+    if (status == NvSuccess)
+        NvOsSemaphoreSignal(pCache->WorkerSema);
+    return status;
+}
+
+NvBool NvmmSharedCacheCanHold(NvmmSharedReaderHandle hReader, NvU32 nSize)
+{
+    NvmmSharedCache *pCache = hReader->pCache;
+    NvU64 Position = hReader->Position;
+    NvU32 nSpan, nUsable = 0, i;
+
+    if (!nSize)
+        return NV_TRUE;
+    nSpan = (NvU32)((BlockStart(Position + nSize - 1) - BlockStart(Position)) / SHARED_BLOCK_SIZE) + 1;
+
+    NvOsMutexLock(pCache->Lock);
+    for (i = 0; i < pCache->nBlocks; i++)
+    {
+        if (!pCache->pBlocks[i].nPins && (pCache->pBlocks[i].Status != SHARED_BLOCK_SPARE))
+            nUsable++;
+    }
+    NvOsMutexUnlock(pCache->Lock);
+
+    // a request spanning blocks may need as many again for its copy
+    return (nUsable >= ((nSpan > 1) ? 2 * nSpan : 1)) ? NV_TRUE : NV_FALSE;
+}
+
+void NvmmSharedCacheGetCachedRange(NvmmSharedReaderHandle hReader, NvU64 *pFirst, NvU64 *pLast)
+{
+    NvmmSharedCache *pCache = hReader->pCache;
+    NvU64 Position = hReader->Position;
+    NvU64 Start = BlockStart(Position);
+    SharedBlock *pBlock;
+    NvU64 Cur;
+
+    *pFirst = *pLast = Position;
+
+    NvOsMutexLock(pCache->Lock);
+    for (Cur = Start; Cur < pCache->FileSize; Cur += SHARED_BLOCK_SIZE)
+    {
+        pBlock = FindBlock(pCache, Cur);
+        if (!pBlock || (pBlock->Status != SHARED_BLOCK_FULL))
+            break;
+        *pLast = Cur + pBlock->Size;
+    }
+    if (*pLast > Position)
+    {
+        *pFirst = Start;
+        for (Cur = Start; Cur >= SHARED_BLOCK_SIZE; Cur -= SHARED_BLOCK_SIZE)
+        {
+            pBlock = FindBlock(pCache, Cur - SHARED_BLOCK_SIZE);
+            if (!pBlock || (pBlock->Status != SHARED_BLOCK_FULL))
+                break;
+            *pFirst = Cur - SHARED_BLOCK_SIZE;
+        }
+    }
+    NvOsMutexUnlock(pCache->Lock);
+}
+
+void NvmmSharedCachePause(NvmmSharedReaderHandle hReader, NvBool bPause)
+{
+    NvmmSharedCache *pCache = hReader->pCache;
+
+    NvOsMutexLock(pCache->Lock);
+    hReader->bPaused = bPause;
+    NvOsMutexUnlock(pCache->Lock);
+    if (!bPause)
+        NvOsSemaphoreSignal(pCache->WorkerSema);
+}
+
+void NvmmSharedCacheGetBaseAddress(NvmmSharedReaderHandle hReader, NvRmPhysAddr *pPhyAddress, void **pVirtAddress)
+{
+    *pPhyAddress = hReader->pCache->PhyAddress;
+    *pVirtAddress = hReader->pCache->pBits;
+}
+
+NvU64 NvmmSharedCacheGetSize(NvmmSharedReaderHandle hReader)
+{
+    return hReader->pCache->PoolSize;
+}
+
+void NvmmSharedCacheGetStats(NvmmSharedReaderHandle hReader, CP_ReadAheadStats *pStats)
+{
+    NvOsMutexLock(hReader->pCache->Lock);
+    *pStats = hReader->Stats;
+    NvOsMutexUnlock(hReader->pCache->Lock);
+}
@@ -0,0 +1,95 @@
+/* Copyright (c) 2013 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an
+ * express license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+#ifndef NVMM_CONTENTPIPE_SHARED_H_
+#define NVMM_CONTENTPIPE_SHARED_H_
+
+#include "nvcommon.h"
+#include "nverror.h"
+#include "nvrm_init.h"
+#include "nvcustomprotocol.h"
+#include "nvmm_contentpipe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Cache pool shared by all content pipe handles reading the same local file,
+ * so that playback, a thumbnailer and a metadata extractor running on one file
+ * read and hold each part of it once.
+ *
+ * Caches are process-wide, keyed by the protocol's NvCPR_ContentId and
+ * refcounted by their readers. A cache is one pinned NvRm pool cut into
+ * blocks that hold file data at block aligned offsets, plus one worker
+ * thread that reads ahead of every reader in turn. Each reader has its own
+ * cursor; the blocks from its cursor on, up to its share of the pool, are its
+ * read-ahead window. A reader alternating between two streams of an
+ * interleaved file keeps a cursor on each and splits its window between them.
+ * Blocks are evicted least recently used first, but never
+ * from the window of another reader, so one reader cannot take the pool from
+ * the others. A reader that gets ahead of the worker reads the missing block
+ * itself through its own protocol handle.
+ *
+ * A reader's calls must not overlap; different readers may be called from
+ * different threads.
+ */
+
+typedef struct NvmmSharedReaderRec *NvmmSharedReaderHandle;
+
+/**
+ * Joins the cache for content pId, creating it with a pool of CacheSize bytes
+ * if this is its first reader. The reader reads through hFile, which stays
+ * owned by the caller; the worker opens its own handle with szURI. The new
+ * reader's cursor is at Position.
+ */
+NvError NvmmSharedCacheAttach(
+    NV_CUSTOM_PROTOCOL *pProtocol,
+    NvCPRHandle hFile,
+    const char *szURI,
+    const NvCPR_ContentId *pId,
+    NvU64 CacheSize,
+    NvU64 Position,
+    NvmmSharedReaderHandle *phReader);
+
+/** Leaves the cache, giving back the buffers the reader still holds. */
+void NvmmSharedCacheDetach(NvmmSharedReaderHandle hReader);
+
+NvU64 NvmmSharedCacheGetPosition(NvmmSharedReaderHandle hReader);
+void NvmmSharedCacheSetPosition(NvmmSharedReaderHandle hReader, NvU64 Position);
+
+/** Copies nSize bytes at the cursor to pData and moves the cursor past them. */
+NvError NvmmSharedCacheRead(NvmmSharedReaderHandle hReader, NvU8 *pData, NvU32 nSize);
+
+/**
+ * Hands out nSize bytes at the cursor from the pool and moves the cursor past
+ * them. The bytes stay in place until NvmmSharedCacheReleaseBuffer; a request
+ * spanning blocks is copied to consecutive blocks of the pool.
+ */
+NvError NvmmSharedCacheReadBuffer(NvmmSharedReaderHandle hReader, NvU32 nSize, NvU8 **ppBuffer);
+NvError NvmmSharedCacheReleaseBuffer(NvmmSharedReaderHandle hReader, NvU8 *pBuffer);
+
+/** Whether NvmmSharedCacheReadBuffer can currently hand out nSize bytes. */
+NvBool NvmmSharedCacheCanHold(NvmmSharedReaderHandle hReader, NvU32 nSize);
+
+/** The cached bytes around the cursor, [*pFirst, *pLast). */
+void NvmmSharedCacheGetCachedRange(NvmmSharedReaderHandle hReader, NvU64 *pFirst, NvU64 *pLast);
+
+/** Stops or resumes reading ahead for this reader; reads are still served. */
+void NvmmSharedCachePause(NvmmSharedReaderHandle hReader, NvBool bPause);
+
+void NvmmSharedCacheGetBaseAddress(NvmmSharedReaderHandle hReader, NvRmPhysAddr *pPhyAddress, void **pVirtAddress);
+NvU64 NvmmSharedCacheGetSize(NvmmSharedReaderHandle hReader);
+void NvmmSharedCacheGetStats(NvmmSharedReaderHandle hReader, CP_ReadAheadStats *pStats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
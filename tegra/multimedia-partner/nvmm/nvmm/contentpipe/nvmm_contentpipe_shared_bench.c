@@ -0,0 +1,287 @@
+/* Copyright (c) 2013 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an
+ * express license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+/*
+ * Shared content cache check.
+ *
+ * Writes a file of known bytes and has three threads read it at the same time
+ * through content pipe handles of their own, the way playback, a thumbnailer
+ * and a metadata extractor do: one reads it from start to end, one reads two
+ * interleaved streams from both halves, and one takes read buffers of a size
+ * that spans cache blocks, closing and reopening its handle every quarter of
+ * the file. Every byte read is compared with the file.
+ *
+ * It runs once with a cache smaller than the file and once with one that
+ * holds it. Each run reports per reader what the cache read from the file for
+ * it, and fails if the readers together got the file read more often than
+ * private caches would have, or, when the file fits, more than once and a
+ * quarter.
+ *
+ * usage: nvmm_contentpipe_shared_bench [file] [MB]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "nvos.h"
+#include "nvmm_contentpipe.h"
+
+#define BENCH_DEFAULT_FILE      "/data/local/tmp/nvmm_cp_shared.bin"
+#define BENCH_DEFAULT_MB        24
+#define BENCH_READERS           3
+#define BENCH_READ_SIZE         (64 * 1024)
+#define BENCH_VIDEO_SIZE        (48 * 1024)
+#define BENCH_AUDIO_SIZE        (8 * 1024)
+#define BENCH_BUFFER_SIZE       100000
+#define BENCH_SPARE_SIZE        (1024 * 1024)
+#define BENCH_REOPENS           4
+
+enum
+{
+    BenchReader_Sequential,
+    BenchReader_Interleaved,
+    BenchReader_Buffers
+};
+
+typedef struct BenchReaderRec
+{
+    NvU32 Kind;
+    const char *szFile;
+    NvU64 FileSize;
+    NvU64 CacheSize;
+    NvU64 nBytes;
+    NvU64 nFetched;
+    NvU64 nWasted;
+    NvU64 nMisses;
+    NvBool bFailed;
+    NvOsThreadHandle hThread;
+} BenchReader;
+
+static NvU8 BenchByte(NvU64 Offset)
+{
+    return (NvU8)((Offset * 2654435761u) >> 13);
+}
+
+static NvBool BenchCheck(const NvU8 *pData, NvU64 Offset, NvU32 nSize)
+{
+    NvU32 i;
+
+    for (i = 0; i < nSize; i++)
+    {
+        if (pData[i] != BenchByte(Offset + i))
+        {
+            printf("mismatch at %llu\n", (unsigned long long)(Offset + i));
+            return NV_FALSE;
+        }
+    }
+    return NV_TRUE;
+}
+
+static NvBool BenchWriteFile(const char *szFile, NvU64 FileSize)
+{
+    static NvU8 Buf[BENCH_READ_SIZE];
+    FILE *pFile = fopen(szFile, "wb");
+    NvU64 Offset;
+    NvU32 i, n;
+
+    if (!pFile)
+        return NV_FALSE;
+    for (Offset = 0; Offset < FileSize; Offset += n)
+    {
+        n = (FileSize - Offset < BENCH_READ_SIZE) ? (NvU32)(FileSize - Offset) : BENCH_READ_SIZE;
+        for (i = 0; i < n; i++)
+            Buf[i] = BenchByte(Offset + i);
+        if (fwrite(Buf, 1, n, pFile) != n)
+        {
+            fclose(pFile);
+            return NV_FALSE;
+        }
+    }
+    return (fclose(pFile) == 0) ? NV_TRUE : NV_FALSE;
+}
+
+static NvBool BenchOpen(BenchReader *pReader, CP_PIPETYPE_EXTENDED *pPipe, CPhandle *phContent)
+{
+    CPuint64 ActualSize = 0;
+
+    if (pPipe->cpipe.Open(phContent, (CPstring)pReader->szFile, CP_AccessRead) != NvSuccess)
+        return NV_FALSE;
+    if ((pPipe->InitializeCP(*phContent, 1024 * 1024, pReader->CacheSize,
+                             BENCH_SPARE_SIZE, &ActualSize) != NvSuccess) || !ActualSize)
+    {
+        pPipe->cpipe.Close(*phContent);
+        return NV_FALSE;
+    }
+    return NV_TRUE;
+}
+
+static void BenchClose(BenchReader *pReader, CP_PIPETYPE_EXTENDED *pPipe, CPhandle hContent)
+{
+    CP_ReadAheadStats Stats;
+
+    NvOsMemset(&Stats, 0, sizeof(Stats));
+    pPipe->GetConfig(hContent, CP_ConfigQueryReadAheadStats, &Stats);
+    pReader->nFetched += Stats.nBytesFetched;
+    pReader->nWasted += Stats.nBytesWasted;
+    pReader->nMisses += Stats.nMisses;
+    pPipe->cpipe.Close(hContent);
+}
+
+static NvBool BenchRead(CP_PIPETYPE_EXTENDED *pPipe, CPhandle hContent, NvU8 *pBuf,
+                        NvU64 Offset, NvU32 nSize)
+{
+    if (pPipe->SetPosition64(hContent, (CPint64)Offset, CP_OriginBegin) != NvSuccess)
+        return NV_FALSE;
+    if (pPipe->cpipe.Read(hContent, (CPbyte *)pBuf, nSize) != NvSuccess)
+        return NV_FALSE;
+    return BenchCheck(pBuf, Offset, nSize);
+}
+
+static void BenchReaderThread(void *pArg)
+{
+    static NvU8 Bufs[BENCH_READERS][BENCH_READ_SIZE];
+    BenchReader *pReader = (BenchReader *)pArg;
+    NvU8 *pBuf = Bufs[pReader->Kind];
+    CP_PIPETYPE_EXTENDED *pPipe;
+    CPhandle hContent;
+    NvU64 Offset = 0, Audio = pReader->FileSize / 2;
+    NvU32 n, nReopen = 0;
+
+    NvmmGetFileContentPipe(&pPipe);
+    if (!BenchOpen(pReader, pPipe, &hContent))
+    {
+        printf("reader %u: open failed\n", pReader->Kind);
+        pReader->bFailed = NV_TRUE;
+        return;
+    }
+
+    while (!pReader->bFailed)
+    {
+        if (pReader->Kind == BenchReader_Sequential)
+        {
+            if (Offset >= pReader->FileSize)
+                break;
+            n = (pReader->FileSize - Offset < BENCH_READ_SIZE) ? (NvU32)(pReader->FileSize - Offset) : BENCH_READ_SIZE;
+            pReader->bFailed = !BenchRead(pPipe, hContent, pBuf, Offset, n);
+            Offset += n;
+            pReader->nBytes += n;
+        }
+        else if (pReader->Kind == BenchReader_Interleaved)
+        {
+            if (Offset + BENCH_VIDEO_SIZE > pReader->FileSize / 2)
+                break;
+            pReader->bFailed = !BenchRead(pPipe, hContent, pBuf, Offset, BENCH_VIDEO_SIZE) ||
+                               !BenchRead(pPipe, hContent, pBuf, Audio, BENCH_AUDIO_SIZE);
+            Offset += BENCH_VIDEO_SIZE;
+            Audio += BENCH_AUDIO_SIZE;
+            pReader->nBytes += BENCH_VIDEO_SIZE + BENCH_AUDIO_SIZE;
+        }
+        else
+        {
+            CP_CHECKBYTESRESULTTYPE eResult = CP_CheckBytesOk;
+            CPbyte *pData = NULL;
+            CPuint nSize = BENCH_BUFFER_SIZE;
+
+            if (Offset + BENCH_BUFFER_SIZE > pReader->FileSize)
+                break;
+            if (Offset >= (nReopen + 1) * (pReader->FileSize / BENCH_REOPENS))
+            {
+                // a new handle joins the cache the others keep alive
+                BenchClose(pReader, pPipe, hContent);
+                nReopen++;
+                if (!BenchOpen(pReader, pPipe, &hContent))
+                {
+                    printf("reader %u: reopen failed\n", pReader->Kind);
+                    pReader->bFailed = NV_TRUE;
+                    return;
+                }
+                pPipe->SetPosition64(hContent, (CPint64)Offset, CP_OriginBegin);
+            }
+            pPipe->cpipe.CheckAvailableBytes(hContent, nSize, &eResult);
+            if (eResult != CP_CheckBytesOk)
+            {
+                NvOsSleepMS(1);
+                continue;
+            }
+            pPipe->cpipe.ReadBuffer(hContent, &pData, &nSize, 0);
+            pReader->bFailed = !pData || (nSize != BENCH_BUFFER_SIZE) ||
+                               !BenchCheck((NvU8 *)pData, Offset, nSize);
+            if (pData)
+                pPipe->cpipe.ReleaseReadBuffer(hContent, pData);
+            Offset += BENCH_BUFFER_SIZE;
+            pReader->nBytes += BENCH_BUFFER_SIZE;
+        }
+    }
+    if (pReader->bFailed)
+        printf("reader %u: read failed at %llu\n", pReader->Kind, (unsigned long long)Offset);
+    BenchClose(pReader, pPipe, hContent);
+}
+
+static NvBool BenchRun(const char *szFile, NvU64 FileSize, NvU64 CacheSize)
+{
+    static const char *s_Names[BENCH_READERS] = { "sequential", "interleaved", "buffers" };
+    BenchReader Readers[BENCH_READERS];
+    NvU64 nFetched = 0, nLimit;
+    NvBool bOk = NV_TRUE;
+    NvU32 i;
+
+    printf("cache %llu MB, file %llu MB\n", (unsigned long long)(CacheSize >> 20),
+           (unsigned long long)(FileSize >> 20));
+    NvOsMemset(Readers, 0, sizeof(Readers));
+    for (i = 0; i < BENCH_READERS; i++)
+    {
+        Readers[i].Kind = i;
+        Readers[i].szFile = szFile;
+        Readers[i].FileSize = FileSize;
+        Readers[i].CacheSize = CacheSize;
+        if (NvOsThreadCreate(BenchReaderThread, &Readers[i], &Readers[i].hThread) != NvSuccess)
+        {
+            printf("thread create failed\n");
+            return NV_FALSE;
+        }
+    }
+    for (i = 0; i < BENCH_READERS; i++)
+    {
+        NvOsThreadJoin(Readers[i].hThread);
+        printf("  %-12s read %6llu KB  fetched %6llu KB  wasted %6llu KB  misses %llu\n", s_Names[i],
+               (unsigned long long)(Readers[i].nBytes >> 10), (unsigned long long)(Readers[i].nFetched >> 10),
+               (unsigned long long)(Readers[i].nWasted >> 10), (unsigned long long)Readers[i].nMisses);
+        bOk = bOk && !Readers[i].bFailed;
+        nFetched += Readers[i].nFetched;
+    }
+
+    nLimit = (CacheSize >= FileSize) ? FileSize + FileSize / 4 : BENCH_READERS * FileSize;
+    printf("  file read %.2f times\n", (double)nFetched / (double)FileSize);
+    if (nFetched > nLimit)
+    {
+        printf("  more than %.2f times\n", (double)nLimit / (double)FileSize);
+        bOk = NV_FALSE;
+    }
+    return bOk;
+}
+
+int main(int argc, char **argv)
+{
+    const char *szFile = (argc > 1) ? argv[1] : BENCH_DEFAULT_FILE;
+    NvU64 FileSize = (NvU64)((argc > 2) ? atoi(argv[2]) : BENCH_DEFAULT_MB) << 20;
+    NvBool bOk;
+
+    if (!FileSize || !BenchWriteFile(szFile, FileSize))
+    {
+        printf("cannot write %s\n", szFile);
+        return 1;
+    }
+
+    bOk = BenchRun(szFile, FileSize, FileSize / 3);
+    bOk = BenchRun(szFile, FileSize, FileSize) && bOk;
+    remove(szFile);
+
+    printf("%s\n", bOk ? "PASSED" : "FAILED");
+    return bOk ? 0 : 1;
+}
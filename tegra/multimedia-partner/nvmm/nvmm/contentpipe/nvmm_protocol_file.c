@@ -11,6 +11,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#endif
 
 #include "nvcustomprotocol.h"
 #include "nvmm_protocol_builtin.h"
@@ -24,12 +33,153 @@
 
 /* Default file reader */
  
+#if !defined(_WIN32)
+/* A mapping is shared by every handle open on the same file, so concurrent
+ * readers of a file (playback, thumbnail and metadata extraction) read the
+ * same pages and the file takes address space only once. Handles keep their
+ * own position. A file that changed since it was mapped gets a new mapping. */
+typedef struct LocalFileMappingRec
+{
+    struct LocalFileMappingRec *pNext;
+    dev_t Dev;
+    ino_t Ino;
+    time_t Mtime;
+    NvU64 nSize;
+    NvU8 *pBase;
+    NvU32 RefCount;
+    NvU32 Guard;    // index in s_Guards
+} LocalFileMapping;
+
+static LocalFileMapping *s_pMappings = NULL;
+static pthread_mutex_t s_MappingLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Reading a page of a MAP_SHARED mapping that is no longer backed by the file
+ * (the file was truncated, or the SD card or USB disk it lives on was removed)
+ * raises SIGBUS, which would kill the whole media server. Every mapping is
+ * registered in s_Guards; the SIGBUS handler replaces a faulting page of a
+ * registered mapping with a page of zeros, flags the mapping and lets the read
+ * carry on. The content pipe checks the flag and fails the read. Faults
+ * anywhere else go to the handler that was installed before ours.
+ *
+ * The handler reads s_Guards without a lock, so a slot is filled (nSize then
+ * pBase) and cleared (pBase) under s_MappingLock with barriers in between. */
+#define LOCAL_FILE_MAX_MAPPINGS 16
+
+typedef struct LocalFileGuardRec
+{
+    NvU8 *volatile pBase;   // NULL when the slot is free
+    volatile size_t nSize;
+    volatile NvU32 Faulted;
+} LocalFileGuard;
+
+static LocalFileGuard s_Guards[LOCAL_FILE_MAX_MAPPINGS];
+static struct sigaction s_OldSigBus;
+static size_t s_PageSize;
+static NvBool s_bGuardInstalled = NV_FALSE;
+static pthread_once_t s_GuardOnce = PTHREAD_ONCE_INIT;
+
+static void LocalFileSigBus(int Sig, siginfo_t *pInfo, void *pContext)
+{
+    NvU8 *pAddr = (NvU8 *)pInfo->si_addr;
+    NvU32 i;
+
+    for (i = 0; i < LOCAL_FILE_MAX_MAPPINGS; i++)
+    {
+        NvU8 *pBase = s_Guards[i].pBase;
+
+        if (pBase && (pAddr >= pBase) && (pAddr < pBase + s_Guards[i].nSize))
+        {
+            void *pPage = (void *)((uintptr_t)pAddr & ~(uintptr_t)(s_PageSize - 1));
+
+            if (mmap(pPage, s_PageSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+                     -1, 0) == MAP_FAILED)
+            {
+                break;
+            }
+            s_Guards[i].Faulted = 1;
+            return;
+        }
+    }
+
+    if (s_OldSigBus.sa_flags & SA_SIGINFO)
+    {
+        s_OldSigBus.sa_sigaction(Sig, pInfo, pContext);
+    }
+    else if ((s_OldSigBus.sa_handler == SIG_DFL) || (s_OldSigBus.sa_handler == SIG_IGN))
+    {
+        // the faulting access runs again on return and takes the default action
+        signal(SIGBUS, SIG_DFL);
+    }
+    else
+    {
+        s_OldSigBus.sa_handler(Sig);
+    }
+}
+
+static void LocalFileInstallGuard(void)
+{
+    struct sigaction Action;
+    long PageSize = sysconf(_SC_PAGESIZE);
+
+    if (PageSize <= 0)
+        return;
+    s_PageSize = (size_t)PageSize;
+
+    NvOsMemset(&Action, 0, sizeof(Action));
+    Action.sa_sigaction = LocalFileSigBus;
+    Action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&Action.sa_mask);
+    if (sigaction(SIGBUS, &Action, &s_OldSigBus) == 0)
+        s_bGuardInstalled = NV_TRUE;
+}
+#else
+typedef struct LocalFileMappingRec LocalFileMapping;
+#endif
+
 typedef struct LocalFileHandle
 {
     NvOsFileHandle hFile;
     NvU64 nSize;
+    char *szPath;
+    LocalFileMapping *pMapping; // NULL until the file is mapped
 } LocalFileHandle;
 
+/* Larger files are not mapped so that they do not exhaust a 32-bit address space */
+#define LOCAL_FILE_MAX_MAP_SIZE ((NvU64)((size_t)-1 / 4))
+
+static void LocalFileUnmap(LocalFileHandle *pFile)
+{
+#if !defined(_WIN32)
+    LocalFileMapping **ppLink;
+    LocalFileMapping *pMapping = pFile->pMapping;
+
+    if (!pMapping)
+        return;
+    pFile->pMapping = NULL;
+
+    pthread_mutex_lock(&s_MappingLock);
+    if (--pMapping->RefCount)
+    {
+        pthread_mutex_unlock(&s_MappingLock);
+        return;
+    }
+    for (ppLink = &s_pMappings; *ppLink; ppLink = &(*ppLink)->pNext)
+    {
+        if (*ppLink == pMapping)
+        {
+            *ppLink = pMapping->pNext;
+            break;
+        }
+    }
+    s_Guards[pMapping->Guard].pBase = NULL;
+    __sync_synchronize();
+    pthread_mutex_unlock(&s_MappingLock);
+
+    munmap(pMapping->pBase, (size_t)pMapping->nSize);
+    NvOsFree(pMapping);
+#endif
+}
+
 static NvError LocalFileGetVersion(NvS32 *pnVersion)
 {
     *pnVersion = NV_CUSTOM_PROTOCOL_VERSION;
@@ -43,8 +193,10 @@ static NvError LocalFileClose(NvCPRHandle hContent)
     NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_DEBUG, "++LocalFileClose"));
     if (pFile)
     {
+        LocalFileUnmap(pFile);
         if (pFile->hFile)
             NvOsFclose(pFile->hFile);
+        NvOsFree(pFile->szPath);
         NvOsFree(pFile);
     }
     NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_DEBUG, "--LocalFileClose"));    
@@ -81,6 +233,14 @@ static NvError LocalFileOpen(NvCPRHandle* hHandle, char *szURI,
     NVMM_CHK_ERR(NvOsFtell(pFile->hFile, &pFile->nSize));
     NVMM_CHK_ERR(NvOsFseek(pFile->hFile, 0, NvOsSeek_Set));
 
+    if (eAccess == NvCPR_AccessRead)
+    {
+        // kept to map the file on request
+        pFile->szPath = NvOsAlloc(NvOsStrlen(szURI) + 1);
+        NVMM_CHK_MEM(pFile->szPath);
+        NvOsStrncpy(pFile->szPath, szURI, NvOsStrlen(szURI) + 1);
+    }
+
     *hHandle = pFile;
 
 cleanup:
@@ -182,6 +342,95 @@ static NvParserCoreType LocalFileProbeParserType(char *szURI)
     return NvParserCoreType_UnKnown;
 }
 
+#if !defined(_WIN32)
+static NvError LocalFileMap(LocalFileHandle *pFile)
+{
+    NvError Status = NvSuccess;
+    LocalFileMapping *pMapping;
+    struct stat Stat;
+    void *pMap;
+    NvU32 Guard;
+    int fd;
+
+    if (pFile->pMapping)
+        return NvSuccess;
+    if (!pFile->szPath || !pFile->nSize || pFile->nSize > LOCAL_FILE_MAX_MAP_SIZE)
+        return NvError_NotSupported;
+
+    // without the SIGBUS guard the file is read through the cache pool
+    pthread_once(&s_GuardOnce, LocalFileInstallGuard);
+    if (!s_bGuardInstalled)
+        return NvError_NotSupported;
+
+    fd = open(pFile->szPath, O_RDONLY);
+    if (fd < 0)
+        return NvError_FileOperationFailed;
+    if (fstat(fd, &Stat) || ((NvU64)Stat.st_size != pFile->nSize))
+    {
+        close(fd);
+        return NvError_FileOperationFailed;
+    }
+
+    pthread_mutex_lock(&s_MappingLock);
+    for (pMapping = s_pMappings; pMapping; pMapping = pMapping->pNext)
+    {
+        if ((pMapping->Dev == Stat.st_dev) && (pMapping->Ino == Stat.st_ino) &&
+            (pMapping->Mtime == Stat.st_mtime) && (pMapping->nSize == pFile->nSize) &&
+            !s_Guards[pMapping->Guard].Faulted)
+        {
+            break;
+        }
+    }
+
+    if (!pMapping)
+    {
+        for (Guard = 0; Guard < LOCAL_FILE_MAX_MAPPINGS; Guard++)
+        {
+            if (!s_Guards[Guard].pBase)
+                break;
+        }
+        if (Guard == LOCAL_FILE_MAX_MAPPINGS)
+        {
+            Status = NvError_NotSupported;
+            goto cleanup;
+        }
+        pMapping = NvOsAlloc(sizeof(LocalFileMapping));
+        NVMM_CHK_MEM(pMapping);
+        pMap = mmap(NULL, (size_t)pFile->nSize, PROT_READ, MAP_SHARED, fd, 0);
+        if (pMap == MAP_FAILED)
+        {
+            NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_WARN, "LocalFileMap: mmap of 0x%llx bytes failed", pFile->nSize));
+            NvOsFree(pMapping);
+            pMapping = NULL;
+            Status = NvError_InsufficientMemory;
+            goto cleanup;
+        }
+        pMapping->Dev = Stat.st_dev;
+        pMapping->Ino = Stat.st_ino;
+        pMapping->Mtime = Stat.st_mtime;
+        pMapping->nSize = pFile->nSize;
+        pMapping->pBase = (NvU8 *)pMap;
+        pMapping->RefCount = 0;
+        pMapping->Guard = Guard;
+        pMapping->pNext = s_pMappings;
+        s_pMappings = pMapping;
+
+        s_Guards[Guard].Faulted = 0;
+        s_Guards[Guard].nSize = (size_t)pFile->nSize;
+        __sync_synchronize();
+        s_Guards[Guard].pBase = pMapping->pBase;
+    }
+    pMapping->RefCount++;
+    pFile->pMapping = pMapping;
+
+cleanup:
+    pthread_mutex_unlock(&s_MappingLock);
+    // the mapping keeps its own reference to the file
+    close(fd);
+    return Status;
+}
+#endif
+
 static NvError LocalFileQueryConfig(NvCPRHandle hContent, 
                                     NvCPR_ConfigQueryType eQuery,
                                     void *pData, int nDataSize)
@@ -209,6 +458,73 @@ static NvError LocalFileQueryConfig(NvCPRHandle hContent,
             *((NvU32*)pData) = 0;
             return NvSuccess;
         }
+        case NvCPR_ConfigGetMappedContent:
+        {
+#if !defined(_WIN32)
+            LocalFileHandle *pFile = (LocalFileHandle *)hContent;
+            NvCPR_MappedContent *pMapped = (NvCPR_MappedContent *)pData;
+            NvError Status;
+
+            if (!pFile || nDataSize != sizeof(NvCPR_MappedContent))
+                return NvError_BadParameter;
+            Status = LocalFileMap(pFile);
+            if (Status != NvSuccess)
+                return Status;
+            pMapped->pBase = pFile->pMapping->pBase;
+            pMapped->nSize = pFile->nSize;
+            pMapped->pFaulted = &s_Guards[pFile->pMapping->Guard].Faulted;
+            return NvSuccess;
+#else
+            return NvError_NotSupported;
+#endif
+        }
+        case NvCPR_ConfigMappedWillNeed:
+        {
+#if !defined(_WIN32)
+            LocalFileHandle *pFile = (LocalFileHandle *)hContent;
+            NvCPR_MappedRange *pRange = (NvCPR_MappedRange *)pData;
+            NvU64 Start, End;
+            long PageSize = sysconf(_SC_PAGESIZE);
+
+            if (!pFile || nDataSize != sizeof(NvCPR_MappedRange))
+                return NvError_BadParameter;
+            if (!pFile->pMapping || pRange->nOffset >= pFile->nSize || PageSize <= 0)
+                return NvError_InvalidState;
+
+            // madvise wants a page aligned start
+            Start = pRange->nOffset & ~((NvU64)PageSize - 1);
+            End = pRange->nOffset + pRange->nSize;
+            if (End > pFile->nSize || End < pRange->nOffset)
+                End = pFile->nSize;
+            (void)madvise(pFile->pMapping->pBase + Start, (size_t)(End - Start), MADV_WILLNEED);
+            return NvSuccess;
+#else
+            return NvError_NotSupported;
+#endif
+        }
+        case NvCPR_ConfigGetContentId:
+        {
+#if !defined(_WIN32)
+            LocalFileHandle *pFile = (LocalFileHandle *)hContent;
+            NvCPR_ContentId *pId = (NvCPR_ContentId *)pData;
+            struct stat Stat;
+
+            if (!pFile || nDataSize != sizeof(NvCPR_ContentId))
+                return NvError_BadParameter;
+            if (!pFile->szPath || stat(pFile->szPath, &Stat) ||
+                ((NvU64)Stat.st_size != pFile->nSize))
+            {
+                return NvError_NotSupported;
+            }
+            pId->nDevice = (NvU64)Stat.st_dev;
+            pId->nInode = (NvU64)Stat.st_ino;
+            pId->nSize = pFile->nSize;
+            pId->nModTime = (NvU64)Stat.st_mtime;
+            return NvSuccess;
+#else
+            return NvError_NotSupported;
+#endif
+        }
         default:
             break;
     }
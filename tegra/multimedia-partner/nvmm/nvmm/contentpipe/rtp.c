@@ -1,4 +1,4 @@
-/* Copyright (c) 2010 NVIDIA Corporation.  All rights reserved.
+/* Copyright (c) 2010-2013 NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -12,6 +12,7 @@
 #include <ctype.h>
 
 #include "rtp.h"
+#include "rtp_jitter.h"
 #include "rtp_audio.h"
 #include "rtp_video.h"
 #include "rtp_video_h264.h"
@@ -19,7 +20,6 @@
 
 #define NVLOG_CLIENT NVLOG_CONTENT_PIPE // required for logging contentpipe traces
 
-static int firstPacket = 0;
 void InitRTPStream(RTPStream *pRtp)
 {
     NvU32 i = 0;
@@ -65,7 +65,6 @@ NvError SetupRTPStreams(RTPStream *pRtp, int port)
         NvMMCloseUDP(pRtp->rtpSock);
         goto cleanup;
     }
-    firstPacket = 1;
     return NvSuccess;
 
 cleanup:
@@ -151,7 +150,6 @@ void CloseRTPStreams(RTPStream *pRtp)
     if(pRtp->codecContext)
         NvOsFree(pRtp->codecContext);
     pRtp->codecContext = NULL;
-    firstPacket = 0;
 }
 
 static void
@@ -431,6 +429,28 @@ static void ProcessRTPPacket(int M, int seq, NvU32 timestamp, char *buf,
     }
 }
 
+/* Hands the oldest packet held by the jitter buffer to the depacketizer. */
+static NvBool ReleaseRTPPacket(RTPStream *rtp)
+{
+    RTPPacket rawPacket;
+    RTPPacket packet;
+    NvU32 nLost = 0;
+
+    if (NvSuccess != RTPJitterPop(rtp->pJitter, &rawPacket, &nLost))
+        return NV_FALSE;
+
+    if (nLost)
+    {
+        rtp->rawLostPackets += nLost;
+        NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_ERROR, "Missed Receiving packets:  curseq: %d lost: %d On stream: %d \n", rawPacket.seqnum, nLost, rtp->nStreamNum));
+    }
+
+    NvOsMemset(&packet, 0, sizeof(RTPPacket));
+    packet.streamNum = rtp->nStreamNum;
+    ProcessRTPPacket(rawPacket.M, rawPacket.seqnum, (NvU32) rawPacket.timestamp,  (char *)rawPacket.buf, rawPacket.size, &packet, rtp);
+    return NV_TRUE;
+}
+
 void ParseRTP(RTPStream *rtp, char *buf, int len, NvBool isAtEOS)
 {
     int header;
@@ -438,12 +458,8 @@ void ParseRTP(RTPStream *rtp, char *buf, int len, NvBool isAtEOS)
     int seq, timestamp, ssrc;
 
     char *p = buf;
-    RTPPacket rawPacket;
-    RTPPacket packet;
-    unsigned char *rawbuf;
-    NvU32 listsize;
     NvBool bDrainList = NV_FALSE;
-    int rawCurSeq;
+    RTPJitterStats stats;
     NvError status;
 
     if (len < 0)
@@ -511,80 +527,38 @@ void ParseRTP(RTPStream *rtp, char *buf, int len, NvBool isAtEOS)
     // Deal with packet (Using M, seq, + remaining bits)
     rtp->ssrc = ssrc;
 
-    rtp->highseq = (seq > rtp->highseq ? seq : rtp->highseq);
-    if(rtp->oRawPacketQueue)
-    {
-        rawbuf = NvOsAlloc(len+1);
-        if(!rawbuf)
-            return;
-
-        NvOsMemcpy(rawbuf, p, len);
-        NvOsMemset(&rawPacket, 0, sizeof(RTPPacket));
-
-        rawPacket.timestamp = timestamp;
-        rawPacket.M               = M;
-        rawPacket.seqnum     = seq;
-        rawPacket.size            = len;
-        rawPacket.buf             = rawbuf;
-        if (rawPacket.seqnum == 65535)
-        {
-             NvOsDebugPrintf("rollover\n");
-             rtp->SeqNumRollOverCount += 1;
-        }
-        rawPacket.seqnum += (rtp->SeqNumRollOverCount * 65535);
+    if (!rtp->pJitter)
+        return;
 
-        if (NvSuccess != InsertInOrder(rtp->oRawPacketQueue, &rawPacket))
-        {
-             NvOsFree(rawbuf );
-             NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_ERROR, "dropping packet on stream: %d seq num: %d", rtp->eCodecType, seq));
-             NvOsDebugPrintf("dropping packet on stream: %d seq num: %d", rtp->eCodecType, seq);
-        }
+    while (NvError_Busy == (status = RTPJitterInsert(rtp->pJitter, (NvU16)seq,
+                                (NvU32)timestamp, M, p, len)))
+    {
+        // too far ahead of the held packets, release them to make room
+        if (!ReleaseRTPPacket(rtp))
+            break;
     }
-
-drain_list:
-    if(rtp->oRawPacketQueue)
+    if (status != NvSuccess)
     {
-        listsize = GetListSize(rtp->oRawPacketQueue);
-        if(listsize <= 0)
-            return;
-
-        if((listsize > rtp->maxReorderedPackets) || (bDrainList == NV_TRUE))
-        {
-            NvOsMemset(&rawPacket, 0, sizeof(RTPPacket));
-            status = Remove(rtp->oRawPacketQueue, &rawPacket);
-            if (status !=NvSuccess)
-                return;
+        NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_ERROR, "dropping packet on stream: %d seq num: %d", rtp->eCodecType, seq));
+    }
 
-            rawCurSeq = rawPacket.seqnum;
-            if(!firstPacket)
-            {
-                if( (rtp->rawLastSeq +1) != rawCurSeq)
-                {
-                     rtp->rawLostPackets +=  (rawCurSeq - rtp->rawLastSeq );
-                     NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_ERROR, "Missed Receiving packets:  curseq: %d lastseq: %d On stream: %d \n", rawCurSeq , rtp->rawLastSeq, rtp->nStreamNum));
-//                  NvOsDebugPrintf("Missed Receiving packets: curseq: %d lastseq: %d On stream: %d \n",rawCurSeq , rtp->rawLastSeq, rtp->nStreamNum);
-                }
-            }
-            else
-                firstPacket = 0;
+    RTPJitterGetStats(rtp->pJitter, &stats);
+    rtp->highseq = (int)stats.nHighSeq;
+    rtp->SeqNumRollOverCount = stats.nHighSeq >> 16;
 
-            rtp->rawLastSeq =  rawCurSeq;
-        }
-        else
-             return;
+drain_list:
+    if (!rtp->pJitter)
+        return;
 
-        NvOsMemset(&packet, 0, sizeof(RTPPacket));
-        packet.streamNum = rtp->nStreamNum;
-        ProcessRTPPacket(rawPacket.M, rawPacket.seqnum, (NvU32) rawPacket.timestamp,  (char *)rawPacket.buf, rawPacket.size, &packet, rtp);
-        if(rawPacket.buf)
-            NvOsFree(rawPacket.buf);
+    if (bDrainList)
+    {
+        while (ReleaseRTPPacket(rtp))
+            ;
+    }
+    else if (RTPJitterGetCount(rtp->pJitter) > rtp->maxReorderedPackets)
+    {
+        ReleaseRTPPacket(rtp);
     }
-    else
-        bDrainList = NV_FALSE; /* once packet processed */
-
-    /* if EOS drain the raw packet list */
-    if(bDrainList == NV_TRUE)
-        goto drain_list;
 }
 
 NvError SetRTPCodec(RTPStream *pRtp, char *codec)
@@ -1,4 +1,4 @@
-/* Copyright (c) 2010 NVIDIA Corporation.  All rights reserved.
+/* Copyright (c) 2010-2013 NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -136,8 +136,6 @@ typedef struct RTPStreamRec
 /*Sdes data*/
     char *sdestypevalue[RTCP_SDES_PRIV + 1];
 
-    int rawFirstSeq;
-    int rawLastSeq;
     int rawLostPackets;
 
     NvU32 ssrc;
@@ -190,9 +188,13 @@ typedef struct RTPStreamRec
     int (*ProcessPacket)(int M, int seq, NvU32 timestamp, char *buf, int size,
                          RTPPacket *packet, struct RTPStreamRec *stream);
     void *oPacketQueue;
-    void *oRawPacketQueue;
+    struct RTPJitterRec *pJitter;   /* reorders the raw packets */
     NvU32 maxReorderedPackets;
     NvU32 SeqNumRollOverCount;
+
+/*Receiver report state at the previous report*/
+    NvU32 nRRExpectedPrior;
+    NvU32 nRRReceivedPrior;
 } RTPStream;
 
 #define START_PORT 35562 //FIXME: make this random
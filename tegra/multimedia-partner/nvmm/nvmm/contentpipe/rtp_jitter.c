@@ -0,0 +1,343 @@
+/* Copyright (c) 2013 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an
+ * express license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+#include "rtp_jitter.h"
+
+/* jumps ahead of at most this many packets are losses, larger ones restarts */
+#define RTP_JITTER_MAX_DROPOUT 3000
+
+typedef struct RTPJitterSlotRec
+{
+    NvU32 nExtSeq;
+    NvU32 nTimestamp;
+    int nSize;
+    int M;
+    NvBool bValid;
+
+    unsigned char *pBuf;        /* pData or pHeap */
+    unsigned char *pData;       /* nSlotSize bytes of the shared slot storage */
+    unsigned char *pHeap;       /* grown on demand for oversized packets */
+    int nHeapSize;
+} RTPJitterSlot;
+
+struct RTPJitterRec
+{
+    NvOsMutexHandle hLock;
+
+    RTPJitterSlot *pSlots;
+    unsigned char *pSlotData;
+    NvU32 nDepth;
+    NvU32 nMask;
+    NvU32 nSlotSize;
+
+    NvU32 nCount;           /* valid slots */
+    NvU32 nBase;            /* extended seq of the next packet to release */
+    NvU32 nHigh;            /* highest extended seq accepted */
+    NvBool bStarted;
+
+    /* a far out of window seq is only trusted once the next one follows it */
+    NvBool bBadSeqValid;
+    NvU16 nBadSeq;
+
+    RTPJitterNackCallback pNackCallback;
+    void *pNackContext;
+
+    RTPJitterStats oStats;
+};
+
+NvError RTPJitterCreate(RTPJitter **ppJitter, NvU32 nDepth, NvU32 nSlotSize)
+{
+    RTPJitter *pJitter;
+    NvU32 i;
+
+    if (!ppJitter || !nSlotSize)
+        return NvError_BadParameter;
+
+    pJitter = NvOsAlloc(sizeof(RTPJitter));
+    if (!pJitter)
+        return NvError_InsufficientMemory;
+    NvOsMemset(pJitter, 0, sizeof(RTPJitter));
+
+    if (nDepth > RTP_JITTER_MAX_DEPTH)
+        nDepth = RTP_JITTER_MAX_DEPTH;
+    pJitter->nDepth = 4;
+    while (pJitter->nDepth < nDepth)
+        pJitter->nDepth <<= 1;
+    pJitter->nMask = pJitter->nDepth - 1;
+    pJitter->nSlotSize = nSlotSize;
+
+    pJitter->pSlots = NvOsAlloc(pJitter->nDepth * sizeof(RTPJitterSlot));
+    pJitter->pSlotData = NvOsAlloc(pJitter->nDepth * nSlotSize);
+    if (!pJitter->pSlots || !pJitter->pSlotData)
+        goto fail;
+    NvOsMemset(pJitter->pSlots, 0, pJitter->nDepth * sizeof(RTPJitterSlot));
+
+    for (i = 0; i < pJitter->nDepth; i++)
+        pJitter->pSlots[i].pData = pJitter->pSlotData + i * nSlotSize;
+
+    if (NvSuccess != NvOsMutexCreate(&pJitter->hLock))
+        goto fail;
+
+    *ppJitter = pJitter;
+    return NvSuccess;
+
+fail:
+    NvOsFree(pJitter->pSlotData);
+    NvOsFree(pJitter->pSlots);
+    NvOsFree(pJitter);
+    return NvError_InsufficientMemory;
+}
+
+void RTPJitterDestroy(RTPJitter *pJitter)
+{
+    NvU32 i;
+
+    if (!pJitter)
+        return;
+
+    for (i = 0; i < pJitter->nDepth; i++)
+        NvOsFree(pJitter->pSlots[i].pHeap);
+
+    NvOsMutexDestroy(pJitter->hLock);
+    NvOsFree(pJitter->pSlotData);
+    NvOsFree(pJitter->pSlots);
+    NvOsFree(pJitter);
+}
+
+void RTPJitterSetNackCallback(RTPJitter *pJitter,
+                              RTPJitterNackCallback pCallback,
+                              void *pContext)
+{
+    NvOsMutexLock(pJitter->hLock);
+    pJitter->pNackCallback = pCallback;
+    pJitter->pNackContext = pContext;
+    NvOsMutexUnlock(pJitter->hLock);
+}
+
+/* Drops every held packet, the caller holds the lock. */
+static void RTPJitterClear(RTPJitter *pJitter)
+{
+    while (pJitter->nCount)
+    {
+        RTPJitterSlot *pSlot = &pJitter->pSlots[pJitter->nBase & pJitter->nMask];
+
+        if (pSlot->bValid)
+        {
+            pSlot->bValid = NV_FALSE;
+            pJitter->nCount--;
+        }
+        pJitter->nBase++;
+    }
+}
+
+NvError RTPJitterInsert(RTPJitter *pJitter, NvU16 nSeq, NvU32 nTimestamp,
+                        int M, const char *pData, int nSize)
+{
+    RTPJitterSlot *pSlot;
+    RTPJitterNackCallback pNackCallback = NULL;
+    NvU32 nNackFirst = 0, nNackCount = 0;
+    NvS64 nExt;
+    NvU32 nGap;
+
+    if (nSize < 0)
+        return NvError_BadParameter;
+
+    NvOsMutexLock(pJitter->hLock);
+
+    // Unwrap against the highest seq seen, as in RFC 3550 appendix A.1
+    nExt = (NvS64)pJitter->nHigh + (NvS16)(nSeq - (NvU16)pJitter->nHigh);
+
+    if (!pJitter->bStarted)
+    {
+        if (nExt < 0 || !pJitter->oStats.nReceived)
+            nExt = nSeq;
+        if (!pJitter->oStats.nReceived)
+            pJitter->oStats.nFirstSeq = (NvU32)nExt;
+        pJitter->nBase = (NvU32)nExt;
+        pJitter->nHigh = (NvU32)nExt;
+        pJitter->bStarted = NV_TRUE;
+    }
+    else if (nExt < (NvS64)pJitter->nBase)
+    {
+        if (nExt + (NvS64)pJitter->nDepth >= (NvS64)pJitter->nBase ||
+            !pJitter->bBadSeqValid || pJitter->nBadSeq != nSeq)
+        {
+            // Released already, or possibly the first packet of a restarted
+            // source, which is only believed once the next one follows
+            if (nExt + (NvS64)pJitter->nDepth < (NvS64)pJitter->nBase)
+            {
+                pJitter->bBadSeqValid = NV_TRUE;
+                pJitter->nBadSeq = (NvU16)(nSeq + 1);
+            }
+            pJitter->oStats.nLate++;
+            NvOsMutexUnlock(pJitter->hLock);
+            return NvSuccess;
+        }
+
+        if (pJitter->nCount)
+        {
+            NvOsMutexUnlock(pJitter->hLock);
+            return NvError_Busy;
+        }
+
+        // The source restarted its sequence, continue in the next cycle so
+        // extended numbers keep increasing
+        nExt = (NvS64)((((pJitter->nHigh >> 16) + 1) << 16) | nSeq);
+        pJitter->nBase = (NvU32)nExt;
+        pJitter->nHigh = (NvU32)nExt;
+        pJitter->oStats.nResyncs++;
+    }
+    else if (nExt >= (NvS64)pJitter->nBase + pJitter->nDepth)
+    {
+        if (pJitter->nCount)
+        {
+            NvOsMutexUnlock(pJitter->hLock);
+            return NvError_Busy;
+        }
+
+        nGap = (NvU32)nExt - pJitter->nBase;
+        if (nGap < RTP_JITTER_MAX_DROPOUT)
+            pJitter->oStats.nLost += nGap;
+        else
+            pJitter->oStats.nResyncs++;
+        pJitter->nBase = (NvU32)nExt;
+        pJitter->nHigh = (NvU32)nExt;
+    }
+
+    pSlot = &pJitter->pSlots[(NvU32)nExt & pJitter->nMask];
+    if (pSlot->bValid)
+    {
+        pJitter->oStats.nDuplicates++;
+        NvOsMutexUnlock(pJitter->hLock);
+        return NvSuccess;
+    }
+
+    if (nSize <= (int)pJitter->nSlotSize)
+    {
+        pSlot->pBuf = pSlot->pData;
+    }
+    else
+    {
+        if (nSize > pSlot->nHeapSize)
+        {
+            NvOsFree(pSlot->pHeap);
+            pSlot->nHeapSize = 0;
+            pSlot->pHeap = NvOsAlloc(nSize);
+            if (!pSlot->pHeap)
+            {
+                NvOsMutexUnlock(pJitter->hLock);
+                return NvError_InsufficientMemory;
+            }
+            pSlot->nHeapSize = nSize;
+        }
+        pSlot->pBuf = pSlot->pHeap;
+    }
+
+    NvOsMemcpy(pSlot->pBuf, pData, nSize);
+    pSlot->nExtSeq = (NvU32)nExt;
+    pSlot->nTimestamp = nTimestamp;
+    pSlot->nSize = nSize;
+    pSlot->M = M;
+    pSlot->bValid = NV_TRUE;
+
+    if ((NvU32)nExt < pJitter->nHigh)
+    {
+        pJitter->oStats.nReordered++;
+    }
+    else if ((NvU32)nExt > pJitter->nHigh)
+    {
+        if ((NvU32)nExt > pJitter->nHigh + 1 && pJitter->pNackCallback)
+        {
+            pNackCallback = pJitter->pNackCallback;
+            nNackFirst = pJitter->nHigh + 1;
+            nNackCount = (NvU32)nExt - nNackFirst;
+        }
+        pJitter->nHigh = (NvU32)nExt;
+    }
+
+    pJitter->bBadSeqValid = NV_FALSE;
+    pJitter->nCount++;
+    pJitter->oStats.nReceived++;
+    if (pJitter->nCount > pJitter->oStats.nMaxDepth)
+        pJitter->oStats.nMaxDepth = pJitter->nCount;
+
+    NvOsMutexUnlock(pJitter->hLock);
+
+    if (pNackCallback)
+        pNackCallback(pJitter->pNackContext, nNackFirst, nNackCount);
+
+    return NvSuccess;
+}
+
+NvError RTPJitterPop(RTPJitter *pJitter, RTPPacket *pPacket, NvU32 *pnLost)
+{
+    RTPJitterSlot *pSlot;
+    NvU32 nLost = 0;
+
+    NvOsMutexLock(pJitter->hLock);
+
+    if (!pJitter->nCount)
+    {
+        NvOsMutexUnlock(pJitter->hLock);
+        return NvError_BadParameter;
+    }
+
+    pSlot = &pJitter->pSlots[pJitter->nBase & pJitter->nMask];
+    while (!pSlot->bValid)
+    {
+        nLost++;
+        pJitter->nBase++;
+        pSlot = &pJitter->pSlots[pJitter->nBase & pJitter->nMask];
+    }
+
+    NvOsMemset(pPacket, 0, sizeof(RTPPacket));
+    pPacket->seqnum = (int)pSlot->nExtSeq;
+    pPacket->timestamp = pSlot->nTimestamp;
+    pPacket->M = pSlot->M;
+    pPacket->size = pSlot->nSize;
+    pPacket->buf = pSlot->pBuf;
+
+    pSlot->bValid = NV_FALSE;
+    pJitter->nBase++;
+    pJitter->nCount--;
+    pJitter->oStats.nLost += nLost;
+
+    NvOsMutexUnlock(pJitter->hLock);
+
+    if (pnLost)
+        *pnLost = nLost;
+    return NvSuccess;
+}
+
+NvU32 RTPJitterGetCount(RTPJitter *pJitter)
+{
+    NvU32 nCount;
+
+    NvOsMutexLock(pJitter->hLock);
+    nCount = pJitter->nCount;
+    NvOsMutexUnlock(pJitter->hLock);
+    return nCount;
+}
+
+void RTPJitterReset(RTPJitter *pJitter)
+{
+    NvOsMutexLock(pJitter->hLock);
+    RTPJitterClear(pJitter);
+    pJitter->bStarted = NV_FALSE;
+    pJitter->bBadSeqValid = NV_FALSE;
+    NvOsMutexUnlock(pJitter->hLock);
+}
+
+void RTPJitterGetStats(RTPJitter *pJitter, RTPJitterStats *pStats)
+{
+    NvOsMutexLock(pJitter->hLock);
+    *pStats = pJitter->oStats;
+    pStats->nHighSeq = pJitter->nHigh;
+    NvOsMutexUnlock(pJitter->hLock);
+}
@@ -0,0 +1,98 @@
+/* Copyright (c) 2013 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an
+ * express license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+#ifndef RTP_JITTER_H_
+#define RTP_JITTER_H_
+
+#include <nverror.h>
+#include <nvos.h>
+
+#include "rtp.h"
+
+/*
+ * Reorder buffer for the raw packets of one RTP stream.
+ *
+ * Packets are kept in a ring of preallocated slots indexed by their extended
+ * (32 bit, wrap corrected) sequence number, so inserting and releasing a
+ * packet is a copy into or out of its slot with no allocation and no search.
+ * The ring covers the sequence numbers [base, base + depth); base is the
+ * next packet to be released.
+ *
+ * Insert and Pop are called from the RTP receive thread; Reset may be called
+ * from any thread.
+ */
+
+/* depth used when the tegra.rtp_jitter_depth property is not set */
+#define RTP_JITTER_DEFAULT_DEPTH 128
+#define RTP_JITTER_MAX_DEPTH 4096
+
+/* payload bytes preallocated per slot, larger packets get their own buffer */
+#define RTP_JITTER_SLOT_SIZE 2048
+
+typedef struct RTPJitterRec RTPJitter;
+
+typedef struct RTPJitterStatsRec
+{
+    NvU32 nReceived;        /* packets accepted into the ring */
+    NvU32 nLost;            /* sequence numbers released without a packet */
+    NvU32 nReordered;       /* packets that arrived after a later packet */
+    NvU32 nDuplicates;      /* packets whose slot was already filled */
+    NvU32 nLate;            /* packets that arrived after their release */
+    NvU32 nResyncs;         /* sequence discontinuities the ring restarted on */
+    NvU32 nMaxDepth;        /* most packets held at once */
+    NvU32 nFirstSeq;        /* extended sequence number of the first packet */
+    NvU32 nHighSeq;         /* highest extended sequence number received */
+} RTPJitterStats;
+
+/*
+ * Called from RTPJitterInsert, with the buffer unlocked, when a packet
+ * arrives ahead of sequence numbers that have not been received yet.
+ * nFirstSeq is the extended sequence number of the first missing packet.
+ */
+typedef void (*RTPJitterNackCallback)(void *pContext, NvU32 nFirstSeq,
+                                      NvU32 nCount);
+
+/* nDepth is rounded up to a power of two */
+NvError RTPJitterCreate(RTPJitter **ppJitter, NvU32 nDepth, NvU32 nSlotSize);
+
+void RTPJitterDestroy(RTPJitter *pJitter);
+
+void RTPJitterSetNackCallback(RTPJitter *pJitter,
+                              RTPJitterNackCallback pCallback,
+                              void *pContext);
+
+/*
+ * Copies a packet into its slot. Late and duplicate packets are counted and
+ * dropped with NvSuccess. Returns NvError_Busy when the packet is too far
+ * ahead of the oldest held packet; the caller should release packets with
+ * RTPJitterPop and retry.
+ */
+NvError RTPJitterInsert(RTPJitter *pJitter, NvU16 nSeq, NvU32 nTimestamp,
+                        int M, const char *pData, int nSize);
+
+/*
+ * Releases the oldest held packet. pPacket->buf points into the ring and
+ * stays valid until the next RTPJitterInsert or RTPJitterReset. pnLost, if
+ * given, receives the number of missing sequence numbers skipped over to
+ * reach it. Returns NvError_BadParameter when the ring is empty.
+ */
+NvError RTPJitterPop(RTPJitter *pJitter, RTPPacket *pPacket, NvU32 *pnLost);
+
+/* Number of packets currently held. */
+NvU32 RTPJitterGetCount(RTPJitter *pJitter);
+
+/*
+ * Drops all held packets. The next packet restarts the ring without being
+ * counted as a loss or a discontinuity; statistics are kept.
+ */
+void RTPJitterReset(RTPJitter *pJitter);
+
+void RTPJitterGetStats(RTPJitter *pJitter, RTPJitterStats *pStats);
+
+#endif
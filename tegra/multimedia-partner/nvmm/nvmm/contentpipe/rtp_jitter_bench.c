@@ -0,0 +1,321 @@
+/* Copyright (c) 2013 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an
+ * express license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+/*
+ * Localhost RTP receive benchmark.
+ *
+ * A sender thread pushes RTP packets carrying 7 TS packets each (the usual
+ * IPTV payload) at 127.0.0.1 in bursts of BENCH_BURST packets paced to the
+ * given bit rate, or as fast as it can for a rate of 0, swapping every 37th
+ * pair and dropping every 101st packet. The receiver reads them with
+ * NvMMReadSockBatch and runs them through the jitter buffer the way
+ * ParseRTP does, checking that released packets come out in order. Each run
+ * reports the packet rate, the process CPU time per received packet (the
+ * sender's share is the same in every run), the packets the kernel dropped
+ * because the receiver fell behind, and the jitter statistics.
+ *
+ * usage: rtp_jitter_bench [packets] [Mbit/s] [port]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "rtp_jitter.h"
+
+#define BENCH_DEFAULT_PACKETS   20000
+#define BENCH_DEFAULT_MBPS      40
+#define BENCH_DEFAULT_PORT      35562
+#define BENCH_BURST             32
+#define BENCH_PAYLOAD           (7 * 188)
+#define BENCH_REORDER           20
+#define BENCH_SWAP_EVERY        37
+#define BENCH_DROP_EVERY        101
+
+typedef struct BenchSenderRec
+{
+    NvU32 nPackets;
+    NvU32 nMbps;
+    int nPort;
+    NvU32 nSent;
+    NvBool bFailed;
+} BenchSender;
+
+static void BenchBuildPacket(unsigned char *pBuf, NvU32 nIndex)
+{
+    NvU16 nSeq = (NvU16)nIndex;
+    NvU32 nTs = nIndex * 3000;
+    NvU32 i;
+
+    pBuf[0] = 0x80;
+    pBuf[1] = 33;           // MP2T
+    pBuf[2] = (unsigned char)(nSeq >> 8);
+    pBuf[3] = (unsigned char)nSeq;
+    pBuf[4] = (unsigned char)(nTs >> 24);
+    pBuf[5] = (unsigned char)(nTs >> 16);
+    pBuf[6] = (unsigned char)(nTs >> 8);
+    pBuf[7] = (unsigned char)nTs;
+    pBuf[8] = 0x12;
+    pBuf[9] = 0x34;
+    pBuf[10] = 0x56;
+    pBuf[11] = 0x78;
+
+    // the payload starts with the index so the receiver can check it
+    pBuf[12] = (unsigned char)(nIndex >> 24);
+    pBuf[13] = (unsigned char)(nIndex >> 16);
+    pBuf[14] = (unsigned char)(nIndex >> 8);
+    pBuf[15] = (unsigned char)nIndex;
+    for (i = 16; i < 12 + BENCH_PAYLOAD; i++)
+        pBuf[i] = (unsigned char)(nIndex + i);
+}
+
+static void BenchSenderThread(void *pArg)
+{
+    BenchSender *pSender = (BenchSender *)pArg;
+    unsigned char aPacket[2][12 + BENCH_PAYLOAD];
+    struct sockaddr_in dest;
+    NvU64 nStart, nDue;
+    NvU32 i, nSlot;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        pSender->bFailed = NV_TRUE;
+        return;
+    }
+
+    NvOsMemset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    dest.sin_port = htons(pSender->nPort);
+
+    nStart = NvOsGetTimeUS();
+    for (i = 0; i < pSender->nPackets; i++)
+    {
+        if (pSender->nMbps && i % BENCH_BURST == 0)
+        {
+            nDue = nStart + (NvU64)i * sizeof(aPacket[0]) * 8 / pSender->nMbps;
+            while (NvOsGetTimeUS() < nDue)
+                NvOsSleepMS(1);
+        }
+
+        // every BENCH_SWAP_EVERY packets send i + 1 ahead of i
+        if (i % BENCH_SWAP_EVERY == 0 && i + 1 < pSender->nPackets)
+        {
+            BenchBuildPacket(aPacket[0], i);
+            BenchBuildPacket(aPacket[1], i + 1);
+            nSlot = 1;
+        }
+        else if (i % BENCH_SWAP_EVERY == 1)
+        {
+            nSlot = 0;
+        }
+        else
+        {
+            BenchBuildPacket(aPacket[0], i);
+            nSlot = 0;
+        }
+
+        if (i % BENCH_DROP_EVERY == BENCH_DROP_EVERY - 1)
+            continue;
+
+        if (sendto(fd, aPacket[nSlot], sizeof(aPacket[nSlot]), 0,
+                   (struct sockaddr *)&dest, sizeof(dest)) > 0)
+            pSender->nSent++;
+    }
+
+    close(fd);
+}
+
+static NvU64 BenchCpuUs(void)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return (NvU64)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 +
+           ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+static NvBool BenchRelease(RTPJitter *pJitter, NvU32 *pnReleased, NvS64 *pnLast)
+{
+    RTPPacket packet;
+    NvS64 nIndex;
+
+    if (NvSuccess != RTPJitterPop(pJitter, &packet, NULL))
+        return NV_FALSE;
+
+    nIndex = ((NvU32)packet.buf[0] << 24) | ((NvU32)packet.buf[1] << 16) |
+             ((NvU32)packet.buf[2] << 8) | packet.buf[3];
+    if (nIndex <= *pnLast)
+    {
+        printf("packet %lld released after %lld\n", nIndex, *pnLast);
+        exit(1);
+    }
+    *pnLast = nIndex;
+    (*pnReleased)++;
+    return NV_TRUE;
+}
+
+static NvError BenchRun(NvU32 nPackets, NvU32 nMbps, int nPort, int nBatch)
+{
+    BenchSender oSender;
+    NvOsThreadHandle hThread = NULL;
+    NvMMSock *pSock = NULL;
+    NvMMSock *sockList[2];
+    NvMMSock *pFrom;
+    NvMMSockMsg msgs[NVMM_SOCK_MAX_BATCH];
+    char *pBufs = NULL;
+    RTPJitter *pJitter = NULL;
+    RTPJitterStats stats;
+    NvU32 nReceived = 0, nReleased = 0, nReads = 0;
+    NvS64 nLast = -1;
+    NvU64 nStart = 0, nCpu = 0, nUs;
+    NvError err;
+    int n, i, len;
+
+    NvOsMemset(&oSender, 0, sizeof(oSender));
+    oSender.nPackets = nPackets;
+    oSender.nMbps = nMbps;
+    oSender.nPort = nPort;
+
+    pBufs = NvOsAlloc(nBatch * RTP_PACKET_SIZE);
+    if (!pBufs)
+        return NvError_InsufficientMemory;
+    for (i = 0; i < nBatch; i++)
+    {
+        msgs[i].buffer = pBufs + i * RTP_PACKET_SIZE;
+        msgs[i].size = RTP_PACKET_SIZE;
+    }
+
+    err = RTPJitterCreate(&pJitter, RTP_JITTER_DEFAULT_DEPTH, RTP_JITTER_SLOT_SIZE);
+    if (err != NvSuccess)
+        goto cleanup;
+
+    err = NvMMCreateSock(&pSock);
+    if (err != NvSuccess)
+        goto cleanup;
+    err = NvMMOpenUDP(pSock, "rtsp://127.0.0.1/", nPort);
+    if (err != NvSuccess)
+        goto cleanup;
+    sockList[0] = pSock;
+    sockList[1] = NULL;
+
+    nStart = NvOsGetTimeUS();
+    nCpu = BenchCpuUs();
+    err = NvOsThreadCreate(BenchSenderThread, &oSender, &hThread);
+    if (err != NvSuccess)
+        goto cleanup;
+
+    for (;;)
+    {
+        n = NvMMReadSockBatch(sockList, msgs, nBatch, 200, &pFrom);
+        if (n < 0)
+        {
+            // done once the stream stops, the sender may not have started
+            if (nReceived || NvOsGetTimeUS() - nStart > 2000000)
+                break;
+            continue;
+        }
+        nReads++;
+
+        for (i = 0; i < n; i++)
+        {
+            len = msgs[i].len;
+            if (len < 12)
+                continue;
+            nReceived++;
+
+            while (NvError_Busy == RTPJitterInsert(pJitter,
+                        (NvU16)(((unsigned char)msgs[i].buffer[2] << 8) |
+                                (unsigned char)msgs[i].buffer[3]),
+                        0, 0, msgs[i].buffer + 12, len - 12))
+            {
+                BenchRelease(pJitter, &nReleased, &nLast);
+            }
+            if (RTPJitterGetCount(pJitter) > BENCH_REORDER)
+                BenchRelease(pJitter, &nReleased, &nLast);
+        }
+    }
+    while (BenchRelease(pJitter, &nReleased, &nLast))
+        ;
+
+    // the final read waited out the 200 ms timeout
+    nUs = NvOsGetTimeUS() - nStart - 200000;
+    nCpu = BenchCpuUs() - nCpu;
+
+    NvOsThreadJoin(hThread);
+    hThread = NULL;
+    if (oSender.bFailed)
+    {
+        err = NvError_NotSupported;
+        goto cleanup;
+    }
+
+    RTPJitterGetStats(pJitter, &stats);
+    printf("batch %2d  %8u pkt/s  %6.2f pkt/read  cpu %6llu ns/pkt  "
+           "kernel drops %6u  lost %5u reordered %4u late %u max depth %u\n",
+           nBatch,
+           nUs ? (NvU32)((NvU64)nReceived * 1000000 / nUs) : 0,
+           nReads ? (double)nReceived / nReads : 0.0,
+           nReceived ? nCpu * 1000 / nReceived : 0,
+           oSender.nSent - nReceived,
+           stats.nLost, stats.nReordered, stats.nLate, stats.nMaxDepth);
+
+cleanup:
+    if (hThread)
+        NvOsThreadJoin(hThread);
+    if (pSock)
+    {
+        NvMMCloseUDP(pSock);
+        NvMMDestroySock(pSock);
+    }
+    RTPJitterDestroy(pJitter);
+    NvOsFree(pBufs);
+    return err;
+}
+
+int main(int argc, char *argv[])
+{
+    NvU32 nPackets = BENCH_DEFAULT_PACKETS;
+    NvU32 nMbps = BENCH_DEFAULT_MBPS;
+    int nPort = BENCH_DEFAULT_PORT;
+    NvError err = NvSuccess;
+
+    if (argc > 1)
+        nPackets = (NvU32)strtoul(argv[1], NULL, 0);
+    if (argc > 2)
+        nMbps = (NvU32)strtoul(argv[2], NULL, 0);
+    if (argc > 3)
+        nPort = atoi(argv[3]);
+    if (!nPackets || nPort <= 0 || nPort > 65535)
+    {
+        printf("usage: %s [packets] [Mbit/s, 0 for unpaced] [port]\n", argv[0]);
+        return 1;
+    }
+
+    if (err == NvSuccess)
+        err = BenchRun(nPackets, nMbps, nPort, 1);
+    if (err == NvSuccess)
+        err = BenchRun(nPackets, nMbps, nPort, 4);
+    if (err == NvSuccess)
+        err = BenchRun(nPackets, nMbps, nPort, NVMM_SOCK_MAX_BATCH);
+
+    if (err != NvSuccess)
+    {
+        printf("benchmark failed NvError 0x%x\n", err);
+        return 1;
+    }
+    return 0;
+}
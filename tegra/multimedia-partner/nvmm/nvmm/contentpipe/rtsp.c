@@ -1,4 +1,4 @@
-/* Copyright (c) 2010 NVIDIA Corporation.  All rights reserved.
+/* Copyright (c) 2010-2013 NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -13,6 +13,7 @@
 
 #include "rtsp.h"
 #include "rtp_audio.h"
+#include "rtp_jitter.h"
 #include "nvmm_logger.h"
 #include "nvmm_common.h"
 
@@ -24,13 +25,17 @@
 
 #define NV_ENABLE_RECEIVEREPORTS 1
 
+/* datagrams read per wakeup of the RTP thread */
+#define RTP_RECV_BATCH 8
+
 typedef  struct Node {
-    RTPPacket   *packet;
+    RTPPacket   packet;
     struct Node *next;
 }Node;
 
 typedef  struct List{
     Node *Head;
+    Node *Tail;                             /* packets mostly arrive in order */
     NvU32 size;
     NvBool bAllowSameSeq;
     NvOsMutexHandle hListMutexLock;         /* mutex lock for queue */
@@ -127,22 +132,21 @@ void CloseRTSPSession(RTSPSession *pServer)
                 }
             }
         }
-        if (stream->oRawPacketQueue)
-        {
-            while (NvSuccess == (Remove(stream->oRawPacketQueue, &packet)))
-            {
-                if (packet.buf)
-                {
-                    NvOsFree(packet.buf);
-                    packet.buf = NULL;
-                }
-            }
-        }
         DestroyList(stream->oPacketQueue);
         stream->oPacketQueue = NULL;
 
-        DestroyList(stream->oRawPacketQueue);
-        stream->oRawPacketQueue = NULL;
+        if (stream->pJitter)
+        {
+            RTPJitterStats stats;
+
+            RTPJitterGetStats(stream->pJitter, &stats);
+            NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_DEBUG,
+                "stream %d: received %u lost %u reordered %u duplicate %u late %u resync %u max depth %u",
+                stream->nStreamNum, stats.nReceived, stats.nLost, stats.nReordered,
+                stats.nDuplicates, stats.nLate, stats.nResyncs, stats.nMaxDepth));
+            RTPJitterDestroy(stream->pJitter);
+            stream->pJitter = NULL;
+        }
 
         CloseRTPStreams(stream);
     }
@@ -1147,6 +1151,19 @@ cleanup:
     return err;
 }
 
+/* Ring depth for a stream's jitter buffer, from tegra.rtp_jitter_depth if set */
+static NvU32 GetJitterDepth(RTPStream *stream)
+{
+    NvU32 depth = RTP_JITTER_DEFAULT_DEPTH;
+
+    NvOsGetConfigU32("rtp_jitter_depth", &depth);
+
+    // room for the reorder window plus as many packets arriving past a gap
+    if (depth < 2 * (stream->maxReorderedPackets + 1))
+        depth = 2 * (stream->maxReorderedPackets + 1);
+    return depth;
+}
+
 NvError SetupRTSPStreams(RTSPSession *pServer)
 {
     NvU32 i;
@@ -1217,7 +1234,8 @@ NvError SetupRTSPStreams(RTSPSession *pServer)
             SetRTPPacketSize(stream, pServer->nMaxASFPacket);
 
         CreateList(&(stream->oPacketQueue), NV_TRUE);
-        CreateList(&(stream->oRawPacketQueue), NV_FALSE);
+        if (!stream->pJitter)
+            RTPJitterCreate(&stream->pJitter, GetJitterDepth(stream), RTP_JITTER_SLOT_SIZE);
 
         //FIXME: support more than udp unicast
         NvOsMemset(cmd, 0, 2048);
@@ -1523,7 +1541,7 @@ NvError RTSPPlayFrom(RTSPSession *pServer, NvS64 ts, NvU64 *newts)
                     p = part + 4;
                     if (stream)
                     {
-                        stream->firstseq = (stream->SeqNumRollOverCount * 65535) + atoi(p);
+                        stream->firstseq = (stream->SeqNumRollOverCount << 16) + atoi(p);
                         NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_VERBOSE,
                                       "RTSPPlayFrom:: First Seq = %d ", stream->firstseq));
                     }
@@ -1722,17 +1740,8 @@ void ClearStreamData(RTSPSession *pServer, int stream)
             NvOsFree(packet.buf);
         packet.buf = NULL;
     }
-    if (rtp->oRawPacketQueue)
-    {
-        while (NvSuccess == (Remove(rtp->oRawPacketQueue, &packet)))
-        {
-            if (packet.buf)
-            {
-                NvOsFree(packet.buf);
-                packet.buf = NULL;
-            }
-        }
-    }
+    if (rtp->pJitter)
+        RTPJitterReset(rtp->pJitter);
 
     rtp->lastseq = 0;
     rtp->lastTS = 0;
@@ -1745,6 +1754,10 @@ static void *RTPThread(void *param)
 {
     RTSPSession *pServer = (RTSPSession *)param;
     char buf[RTP_PACKET_SIZE];
+    char *batchbuf;
+    NvMMSockMsg msgs[RTP_RECV_BATCH];
+    int msgcount = 1;
+    int nmsgs, m;
     int len;
     NvU32 lastUDPTime = 0, timeNow = 0;
     int timecheckcounter = 0;
@@ -1756,6 +1769,20 @@ static void *RTPThread(void *param)
 
     NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_VERBOSE,"++RTPThread"));
 
+    // Drain bursts several datagrams per wakeup, or one at a time into buf
+    // if the batch buffers can't be had
+    msgs[0].buffer = buf;
+    msgs[0].size = RTP_PACKET_SIZE;
+    batchbuf = NvOsAlloc((RTP_RECV_BATCH - 1) * RTP_PACKET_SIZE);
+    if (batchbuf)
+    {
+        for (msgcount = 1; msgcount < RTP_RECV_BATCH; msgcount++)
+        {
+            msgs[msgcount].buffer = batchbuf + (msgcount - 1) * RTP_PACKET_SIZE;
+            msgs[msgcount].size = RTP_PACKET_SIZE;
+        }
+    }
+
     for (i = 0; i < pServer->nNumStreams; i++)
     {
         stream = &(pServer->oRtpStreams[i]);
@@ -1801,42 +1828,51 @@ static void *RTPThread(void *param)
         if (sockList[0] == NULL)
             break;
 
-        len = NvMMReadSockMultiple(sockList, buf, RTP_PACKET_SIZE, 1000, &sock);
-        NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_VERBOSE,"NvMMReadSockMultiple :: len = %d ", len));
+        nmsgs = NvMMReadSockBatch(sockList, msgs, msgcount, 1000, &sock);
+        NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_VERBOSE,"NvMMReadSockBatch :: count = %d ", nmsgs));
 
-        if(len <0)
+        if(nmsgs <0)
         {
             pServer->nReadError++;
             for (i = 0; i < pServer->nNumStreams; i++)
             {
                 stream = &(pServer->oRtpStreams[i]);
                 if (stream && stream->bUdpSetup)
-                    ParseRTP(stream, buf, len, pServer->bGotBye);
+                    ParseRTP(stream, buf, -1, pServer->bGotBye);
             }
+            nmsgs = 0;
         }
         else
             pServer->nReadError = 0;
 
-        for (i = 0; i < pServer->nNumStreams; i++)
+        for (i = 0; i < pServer->nNumStreams && nmsgs > 0; i++)
         {
             stream = &(pServer->oRtpStreams[i]);
             if (stream && stream->bUdpSetup)
             {
                 if (sock == stream->rtpSock)
                 {
-                    NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_VERBOSE,"++ParseRTP :: stream %d len = %d ", i, len));
-                    ParseRTP(stream, buf, len, pServer->bGotBye);
-                    NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_VERBOSE,"--ParseRTP"));
+                    for (m = 0; m < nmsgs; m++)
+                    {
+                        len = msgs[m].len;
+                        NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_VERBOSE,"++ParseRTP :: stream %d len = %d ", i, len));
+                        ParseRTP(stream, msgs[m].buffer, len, pServer->bGotBye);
+                        NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_VERBOSE,"--ParseRTP"));
+                    }
                 }
                 else if (sock == stream->rtpcSock)
                 {
-                    NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_VERBOSE,"++ParseRTCP :: stream %d len = %d ", i, len));
-                    ParseRTCP(stream, buf, len);
-                    if (stream->isAtEOS == 1)
+                    for (m = 0; m < nmsgs; m++)
                     {
-                        pServer->bGotBye = NV_TRUE;
+                        len = msgs[m].len;
+                        NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_VERBOSE,"++ParseRTCP :: stream %d len = %d ", i, len));
+                        ParseRTCP(stream, msgs[m].buffer, len);
+                        if (stream->isAtEOS == 1)
+                        {
+                            pServer->bGotBye = NV_TRUE;
+                        }
+                        NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_VERBOSE,"--ParseRTCP"));
                     }
-                    NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_VERBOSE,"--ParseRTCP"));
                 }
             }
         }
@@ -1882,6 +1918,7 @@ static void *RTPThread(void *param)
         }
     }
 
+    NvOsFree(batchbuf);
     NV_LOGGER_PRINT((NVLOG_CLIENT, NVLOG_VERBOSE,"--RTPThread"));
     return NULL;
 }
@@ -1908,9 +1945,12 @@ void SendRTCPReceiveReport(RTSPSession *pServer)
     NvU32 buffer[256];
     NvU32 index = 0;
     NvU32 fractionlost = 0;
+    NvU32 cumulativelost = 0;
+    NvU32 expected, expectedinterval, receivedinterval, lostinterval;
     NvU32 jitter = 0;
     int i;
     RTPStream *stream;
+    RTPJitterStats stats;
     //NvU8 *cmd = buffer;
     NvU32 header;
 
@@ -1934,8 +1974,29 @@ void SendRTCPReceiveReport(RTSPSession *pServer)
 
             // calculate fraction lost
             // cumulative number of packets lost
-            //buffer[index++] = NvMMHToNL(fractionlost<<24 | stream->nLostPackets);
-            buffer[index++] = NvMMHToNL(fractionlost<<24);
+            fractionlost = 0;
+            cumulativelost = 0;
+            if (stream->pJitter)
+            {
+                RTPJitterGetStats(stream->pJitter, &stats);
+                if (stats.nReceived)
+                {
+                    expected = stats.nHighSeq - stats.nFirstSeq + 1;
+                    if (expected > stats.nReceived)
+                        cumulativelost = NV_MIN(expected - stats.nReceived, 0x7FFFFF);
+
+                    expectedinterval = expected - stream->nRRExpectedPrior;
+                    receivedinterval = stats.nReceived - stream->nRRReceivedPrior;
+                    stream->nRRExpectedPrior = expected;
+                    stream->nRRReceivedPrior = stats.nReceived;
+                    if (expectedinterval > receivedinterval)
+                    {
+                        lostinterval = expectedinterval - receivedinterval;
+                        fractionlost = NV_MIN((NvU32)(((NvU64)lostinterval << 8) / expectedinterval), 255);
+                    }
+                }
+            }
+            buffer[index++] = NvMMHToNL(fractionlost<<24 | cumulativelost);
 
             //extended highest sequence number received
             buffer[index++] = NvMMHToNL(stream->highseq);
@@ -2034,32 +2095,33 @@ NvError CreateList(ListHandle *phList, NvBool bAllowSameSeq)
 
 NvError InsertInOrder(ListHandle hList, RTPPacket *pPacket)
 {
-    RTPPacket *pNewPacket;
     Node *pNode, *pNewNode, *pPrev;
     List *pList = (List *)hList;
 
-    pNewPacket = NvOsAlloc(sizeof(RTPPacket));
-    if (!pNewPacket)
-    {
-        return NvError_InsufficientMemory;
-    }
-    NvOsMemcpy(pNewPacket, pPacket, sizeof(RTPPacket));
-    //NvOsDebugPrintf("Insert packet %d\n", pPacket->seqnum);
-
     pNewNode = NvOsAlloc(sizeof(Node));
     if (!pNewNode)
     {
-        NvOsFree(pNewPacket);
         return NvError_InsufficientMemory;
     }
-    NvOsMemset(pNewNode, 0, sizeof(Node));
-
-    pNewNode->packet = pNewPacket;
+    NvOsMemcpy(&pNewNode->packet, pPacket, sizeof(RTPPacket));
+    pNewNode->next = NULL;
+    //NvOsDebugPrintf("Insert packet %d\n", pPacket->seqnum);
 
     NvOsMutexLock(pList->hListMutexLock);
 
-    if (pList->Head == NULL ||
-        pList->Head->packet->seqnum > pNewNode->packet->seqnum)
+    if (pList->Head == NULL)
+    {
+        pList->Head = pNewNode;
+        pList->Tail = pNewNode;
+    }
+    else if (pList->Tail->packet.seqnum < pNewNode->packet.seqnum ||
+             (pList->bAllowSameSeq &&
+              pList->Tail->packet.seqnum == pNewNode->packet.seqnum))
+    {
+        pList->Tail->next = pNewNode;
+        pList->Tail = pNewNode;
+    }
+    else if (pList->Head->packet.seqnum > pNewNode->packet.seqnum)
     {
         pNewNode->next = pList->Head;
         pList->Head = pNewNode;
@@ -2068,22 +2130,30 @@ NvError InsertInOrder(ListHandle hList, RTPPacket *pPacket)
     {
         pPrev = pList->Head;
         pNode = pList->Head->next;
+        if (!pList->bAllowSameSeq &&
+            pPrev->packet.seqnum == pNewNode->packet.seqnum)
+        {
+            pNode = pPrev;
+        }
         while ((pNode != NULL) &&
-               (pNode->packet->seqnum <= pNewNode->packet->seqnum))
+               (pNode->packet.seqnum <= pNewNode->packet.seqnum))
         {
             if (!pList->bAllowSameSeq &&
-                pNode->packet->seqnum == pNewNode->packet->seqnum)
+                pNode->packet.seqnum == pNewNode->packet.seqnum)
             {
-                //NvOsDebugPrintf("Same Seq %d\n", pNode->packet->seqnum);
+                //NvOsDebugPrintf("Same Seq %d\n", pNode->packet.seqnum);
                 NvOsMutexUnlock(pList->hListMutexLock);
+                NvOsFree(pNewNode);
                 return NvError_BadParameter;
             }
-            //NvOsDebugPrintf("pNode = %d\n", pNode->packet->seqnum);
+            //NvOsDebugPrintf("pNode = %d\n", pNode->packet.seqnum);
             pPrev = pNode;
             pNode = pNode->next;
         }
         pNewNode->next = pPrev->next;
         pPrev->next = pNewNode;
+        if (!pNewNode->next)
+            pList->Tail = pNewNode;
     }
     pList->size++;
     NvOsMutexUnlock(pList->hListMutexLock);
@@ -2110,10 +2180,11 @@ NvError Remove(ListHandle hList, RTPPacket *pPacket)
         return NvError_BadParameter;
     }
     pList->Head = pNode->next;
+    if (!pList->Head)
+        pList->Tail = NULL;
 
-    NvOsMemcpy(pPacket, pNode->packet, sizeof(RTPPacket));
+    NvOsMemcpy(pPacket, &pNode->packet, sizeof(RTPPacket));
 
-    NvOsFree(pNode->packet);
     NvOsFree(pNode);
     pList->size--;
     //NvOsDebugPrintf("Removing packet %d\n", pPacket->seqnum);
@@ -2134,9 +2205,8 @@ NvError DestroyList(ListHandle hList)
     while ( pNode != NULL )
     {
         pNext = pNode->next;
-        if (pNode->packet->buf)
-            NvOsFree(pNode->packet->buf);
-        NvOsFree(pNode->packet);
+        if (pNode->packet.buf)
+            NvOsFree(pNode->packet.buf);
         NvOsFree(pNode);
         pNode = pNext;
     }
@@ -2337,7 +2407,7 @@ NvError PeekListElement(ListHandle hList, RTPPacket *pPacket, NvU32 nElement)
     {
         if(i == nElement)
         {
-            NvOsMemcpy(pPacket, pNode->packet, sizeof(RTPPacket));
+            NvOsMemcpy(pPacket, &pNode->packet, sizeof(RTPPacket));
             bFoundElement = NV_TRUE;
             break;
         }
@@ -2374,11 +2444,12 @@ NvError RemoveListElement(ListHandle hList, RTPPacket *pPacket,  NvU32 nElement)
     {
         if(i == nElement)
         {
-            NvOsMemcpy(pPacket, pNode->packet, sizeof(RTPPacket));
+            NvOsMemcpy(pPacket, &pNode->packet, sizeof(RTPPacket));
             pPrev->next = pNode->next;
             if(pNode == pList->Head)
                 pList->Head = pNode->next;
-            NvOsFree(pNode->packet);
+            if(pNode == pList->Tail)
+                pList->Tail = pList->Head ? pPrev : NULL;
             NvOsFree(pNode);
             pList->size--;
             bFoundElement = NV_TRUE;
@@ -51,6 +51,15 @@ typedef enum CP_ConfigIndexEnum {
     CP_ConfigQueryRTCPSdesNote,
     CP_ConfigQueryRTCPSdesPriv,
     CP_ConfigQueryTimeStamps,
+    CP_ConfigIndexReadAheadRanges,
+    CP_ConfigQueryReadAheadStats,
+    /* NvBool, set before InitializeCP: serve reads from a read-only mapping of
+     * the content when its protocol supports one, instead of copying it
+     * through the cache pool. ReadBuffer then returns pointers into the
+     * mapping, which have no physical address (GetBaseAddress fails), so only
+     * clients that access the buffers from the CPU may set it. InitializeCP
+     * falls back to the cache pool when the content cannot be mapped. */
+    CP_ConfigIndexMapContent,
 }CP_ConfigIndex;
 
 typedef struct CP_ConfigThreshold {
@@ -58,6 +67,33 @@ typedef struct CP_ConfigThreshold {
     NvU64 LowMark;
 }CP_ConfigThreshold;
 
+/* Number of independent range lists a client can publish, one per stream */
+#define CP_READAHEAD_MAX_STREAMS 4
+
+typedef struct CP_ByteRange {
+    NvU64 Offset;
+    NvU32 Size;
+}CP_ByteRange;
+
+/* Byte ranges a client is about to read for one of its streams, in the order
+ * it will read them. Publishing a list replaces the previous list of that
+ * stream and a Count of 0 clears it. Once a list has been published the cache
+ * fetches the published ranges, across all streams in file order, instead of
+ * reading ahead sequentially from the current position. */
+typedef struct CP_ConfigReadAheadRanges {
+    NvU32 StreamIndex;
+    NvU32 Count;
+    const CP_ByteRange *pRanges;
+}CP_ConfigReadAheadRanges;
+
+typedef struct CP_ReadAheadStats {
+    NvU64 nHits;          // reads served from cached data
+    NvU64 nMisses;        // reads that had to wait for the file
+    NvU64 nBytesFetched;  // bytes read from the file into the cache
+    NvU64 nBytesWasted;   // fetched bytes dropped from the cache without being read
+    NvU64 nRangeFetches;  // chunks fetched for published ranges
+}CP_ReadAheadStats;
+
 
 typedef struct CP_PositionInfoTypeRec
 {
@@ -1,4 +1,4 @@
-/* Copyright (c) 2010 NVIDIA Corporation.  All rights reserved.
+/* Copyright (c) 2010-2013 NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -52,6 +52,28 @@ NvMMReadSockMultiple(
     int timeout,
     NvMMSock **sockReadFrom);
 
+#define NVMM_SOCK_MAX_BATCH 16
+
+typedef struct NvMMSockMsgRec
+{
+    char *buffer;
+    int size;       /* bytes available in buffer */
+    int len;        /* bytes received */
+} NvMMSockMsg;
+
+/*
+ * Waits like NvMMReadSockMultiple, then also reads the datagrams already
+ * queued on the same socket, up to count (at most NVMM_SOCK_MAX_BATCH)
+ * without blocking. Returns the number of msgs filled in, or -1.
+ */
+int
+NvMMReadSockBatch(
+    NvMMSock **sockets,
+    NvMMSockMsg *msgs,
+    int count,
+    int timeout,
+    NvMMSock **sockReadFrom);
+
 NvError 
 NvMMOpenTCP(
     NvMMSock *sock,
@@ -12,6 +12,7 @@ LOCAL_SRC_FILES += nvmm_ulp_util.c
 LOCAL_SRC_FILES += nvmm_ulp_kpi_logger.c
 LOCAL_SRC_FILES += nvmm_bufmgr.c
 LOCAL_SRC_FILES += nvmm_queue.c
+LOCAL_SRC_FILES += nvmm_seekindex.c
 LOCAL_SRC_FILES += nvmm_mediaclock.c
 LOCAL_SRC_FILES += nvmm_sock_util.c
 LOCAL_SRC_FILES += nvmm_file_util.c
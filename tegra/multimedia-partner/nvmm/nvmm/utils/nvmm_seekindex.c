@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2013 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software and related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+/* =========================================================================
+ *                       I N C L U D E S
+ * ========================================================================= */
+
+#include "nvos.h"
+#include "nvassert.h"
+#include "nvmm_seekindex.h"
+
+/* =========================================================================
+ *                        D E F I N E S
+ * ========================================================================= */
+
+#define NVMM_SEEKINDEX_INITIAL_POINTS   64
+
+typedef struct NvMMSeekIndexRec
+{
+    NvU32 Granularity;          /* minimum samples between two points */
+    NvU32 PointCount;           /* valid entries in pPoints */
+    NvU32 MaxPoints;            /* allocated entries in pPoints */
+    NvMMSeekPoint *pPoints;     /* points in increasing time order */
+    NvU64 SeekStartUs;          /* start of the seek being timed */
+    NvMMSeekIndexStats Stats;
+} NvMMSeekIndex;
+
+/* =========================================================================
+ *                      P R O T O T Y P E S
+ * ========================================================================= */
+
+NvError NvMMSeekIndexCreate(NvMMSeekIndexHandle *phIndex, NvU32 Granularity)
+{
+    NvMMSeekIndex *pIndex;
+
+    NV_ASSERT(phIndex);
+
+    pIndex = (NvMMSeekIndex *)NvOsAlloc(sizeof(NvMMSeekIndex));
+    if (!pIndex)
+        return NvError_InsufficientMemory;
+
+    NvOsMemset(pIndex, 0, sizeof(NvMMSeekIndex));
+    pIndex->Granularity = Granularity ? Granularity : 1;
+
+    *phIndex = pIndex;
+    return NvSuccess;
+}
+
+void NvMMSeekIndexDestroy(NvMMSeekIndexHandle hIndex)
+{
+    if (!hIndex)
+        return;
+
+    NvOsFree(hIndex->pPoints);
+    NvOsFree(hIndex);
+}
+
+void NvMMSeekIndexReset(NvMMSeekIndexHandle hIndex)
+{
+    NV_ASSERT(hIndex);
+    hIndex->PointCount = 0;
+}
+
+NvError NvMMSeekIndexAddPoint(NvMMSeekIndexHandle hIndex, const NvMMSeekPoint *pPoint)
+{
+    NvMMSeekPoint *pLast;
+    NvMMSeekPoint *pPoints;
+    NvU32 MaxPoints;
+
+    NV_ASSERT(hIndex && pPoint);
+
+    if (hIndex->PointCount)
+    {
+        pLast = &hIndex->pPoints[hIndex->PointCount - 1];
+        if (pPoint->Time < pLast->Time || pPoint->Sample < pLast->Sample)
+            return NvError_BadParameter;
+        if (pPoint->Sample - pLast->Sample < hIndex->Granularity)
+            return NvSuccess;
+    }
+
+    if (hIndex->PointCount == hIndex->MaxPoints)
+    {
+        MaxPoints = hIndex->MaxPoints ? hIndex->MaxPoints * 2 : NVMM_SEEKINDEX_INITIAL_POINTS;
+        pPoints = (NvMMSeekPoint *)NvOsRealloc(hIndex->pPoints, MaxPoints * sizeof(NvMMSeekPoint));
+        if (!pPoints)
+            return NvError_InsufficientMemory;
+        hIndex->pPoints = pPoints;
+        hIndex->MaxPoints = MaxPoints;
+    }
+
+    hIndex->pPoints[hIndex->PointCount++] = *pPoint;
+    return NvSuccess;
+}
+
+NvBool NvMMSeekIndexGetLastPoint(NvMMSeekIndexHandle hIndex, NvMMSeekPoint *pPoint)
+{
+    NV_ASSERT(hIndex && pPoint);
+
+    if (!hIndex->PointCount)
+        return NV_FALSE;
+
+    *pPoint = hIndex->pPoints[hIndex->PointCount - 1];
+    return NV_TRUE;
+}
+
+NvError NvMMSeekIndexFindTime(NvMMSeekIndexHandle hIndex, NvU64 Time, NvMMSeekPoint *pPoint)
+{
+    NvU32 Low = 0, High, Mid;
+
+    NV_ASSERT(hIndex && pPoint);
+
+    hIndex->Stats.LookupCount++;
+
+    // Number of points at or before Time
+    High = hIndex->PointCount;
+    while (Low < High)
+    {
+        Mid = Low + (High - Low) / 2;
+        if (hIndex->pPoints[Mid].Time <= Time)
+            Low = Mid + 1;
+        else
+            High = Mid;
+    }
+
+    if (!Low)
+        return NvError_BadValue;
+
+    *pPoint = hIndex->pPoints[Low - 1];
+    return NvSuccess;
+}
+
+NvError NvMMSeekIndexFindSample(NvMMSeekIndexHandle hIndex, NvU32 Sample, NvMMSeekPoint *pPoint)
+{
+    NvU32 Low = 0, High, Mid;
+
+    NV_ASSERT(hIndex && pPoint);
+
+    hIndex->Stats.LookupCount++;
+
+    High = hIndex->PointCount;
+    while (Low < High)
+    {
+        Mid = Low + (High - Low) / 2;
+        if (hIndex->pPoints[Mid].Sample <= Sample)
+            Low = Mid + 1;
+        else
+            High = Mid;
+    }
+
+    if (!Low)
+        return NvError_BadValue;
+
+    *pPoint = hIndex->pPoints[Low - 1];
+    return NvSuccess;
+}
+
+NvU32 NvMMSeekIndexLowerBound(const NvU32 *pValues, NvU32 Count, NvU32 Key)
+{
+    NvU32 Low = 0, High = Count, Mid;
+
+    while (Low < High)
+    {
+        Mid = Low + (High - Low) / 2;
+        if (pValues[Mid] < Key)
+            Low = Mid + 1;
+        else
+            High = Mid;
+    }
+    return Low;
+}
+
+void NvMMSeekIndexSetFrameBudget(NvMMSeekIndexHandle hIndex, NvU32 BudgetUs)
+{
+    NV_ASSERT(hIndex);
+    hIndex->Stats.FrameBudgetUs = BudgetUs;
+}
+
+void NvMMSeekIndexSeekBegin(NvMMSeekIndexHandle hIndex)
+{
+    NV_ASSERT(hIndex);
+    hIndex->SeekStartUs = NvOsGetTimeUS();
+}
+
+void NvMMSeekIndexSeekEnd(NvMMSeekIndexHandle hIndex)
+{
+    NvU64 Elapsed;
+    NvU32 LatencyUs;
+
+    NV_ASSERT(hIndex);
+
+    Elapsed = NvOsGetTimeUS() - hIndex->SeekStartUs;
+    LatencyUs = (Elapsed > (NvU64)0xFFFFFFFF) ? 0xFFFFFFFF : (NvU32)Elapsed;
+
+    hIndex->Stats.SeekCount++;
+    hIndex->Stats.LastLatencyUs = LatencyUs;
+    hIndex->Stats.TotalLatencyUs += LatencyUs;
+    if (LatencyUs > hIndex->Stats.MaxLatencyUs)
+        hIndex->Stats.MaxLatencyUs = LatencyUs;
+    if (hIndex->Stats.FrameBudgetUs && LatencyUs > hIndex->Stats.FrameBudgetUs)
+        hIndex->Stats.OverBudgetCount++;
+}
+
+void NvMMSeekIndexGetStats(NvMMSeekIndexHandle hIndex, NvMMSeekIndexStats *pStats)
+{
+    NV_ASSERT(hIndex && pStats);
+
+    *pStats = hIndex->Stats;
+    pStats->PointCount = hIndex->PointCount;
+}
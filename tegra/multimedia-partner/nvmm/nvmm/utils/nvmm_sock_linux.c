@@ -1,4 +1,4 @@
-/* Copyright (c) 2010 NVIDIA Corporation.  All rights reserved.
+/* Copyright (c) 2010-2013 NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -9,6 +9,8 @@
 
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
@@ -422,6 +424,86 @@ readagain:
     goto readagain;
 }
 
+#if defined(__NR_recvmmsg)
+/* struct mmsghdr, which older C libraries do not declare */
+typedef struct NvMMMsgHdrRec
+{
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+} NvMMMsgHdr;
+
+static int s_bNoRecvmmsg = 0;
+#endif
+
+/* Reads the datagrams queued on sock without blocking, returns the count. */
+static int ReadQueuedDatagrams(NvSocket *sock, NvMMSockMsg *msgs, int count)
+{
+    int i, len;
+#if defined(__NR_recvmmsg)
+    NvMMMsgHdr hdrs[NVMM_SOCK_MAX_BATCH];
+    struct iovec iovs[NVMM_SOCK_MAX_BATCH];
+
+    if (!s_bNoRecvmmsg)
+    {
+        NvOsMemset(hdrs, 0, count * sizeof(NvMMMsgHdr));
+        for (i = 0; i < count; i++)
+        {
+            iovs[i].iov_base = msgs[i].buffer;
+            iovs[i].iov_len = msgs[i].size;
+            hdrs[i].msg_hdr.msg_iov = &iovs[i];
+            hdrs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        len = syscall(__NR_recvmmsg, sock->fd, hdrs, count, MSG_DONTWAIT, NULL);
+        if (len >= 0)
+        {
+            for (i = 0; i < len; i++)
+                msgs[i].len = hdrs[i].msg_len;
+            return len;
+        }
+        if (errno != ENOSYS)
+            return 0;
+
+        // kernel predates recvmmsg, read one datagram per call
+        s_bNoRecvmmsg = 1;
+    }
+#endif
+
+    for (i = 0; i < count; i++)
+    {
+        len = recv(sock->fd, msgs[i].buffer, msgs[i].size, MSG_DONTWAIT);
+        if (len < 0)
+            break;
+        msgs[i].len = len;
+    }
+    return i;
+}
+
+int NvMMReadSockBatch(NvMMSock **sockets, NvMMSockMsg *msgs, int count,
+                      int timeout, NvMMSock **sockReadFrom)
+{
+    NvSocket *sock;
+    int len;
+
+    if (!msgs || count <= 0)
+        return -1;
+    if (count > NVMM_SOCK_MAX_BATCH)
+        count = NVMM_SOCK_MAX_BATCH;
+
+    len = NvMMReadSockMultiple(sockets, msgs[0].buffer, msgs[0].size,
+                               timeout, sockReadFrom);
+    if (len < 0)
+        return -1;
+    msgs[0].len = len;
+
+    // stream sockets have no message boundaries to batch on
+    sock = (NvSocket *)*sockReadFrom;
+    if (count == 1 || sock->type != SOCK_UDP || NvMMSockGetBlockActivity())
+        return 1;
+
+    return 1 + ReadQueuedDatagrams(sock, msgs + 1, count - 1);
+}
+
 int NvMMWriteSock(NvMMSock *pSock, char *buffer, int size, int timeout)
 {
     NvSocket *sock = (NvSocket *)pSock;
@@ -1,4 +1,4 @@
-/* Copyright (c) 2010 NVIDIA Corporation.  All rights reserved.
+/* Copyright (c) 2010-2013 NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -82,3 +82,9 @@ int NvMMReadSockMultiple(NvMMSock **sockets, char *buffer, int size,
     return -1;
 }
 
+int NvMMReadSockBatch(NvMMSock **sockets, NvMMSockMsg *msgs, int count,
+                      int timeout, NvMMSock **sockReadFrom)
+{
+    return -1;
+}
+
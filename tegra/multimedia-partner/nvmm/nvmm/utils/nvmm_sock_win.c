@@ -1,4 +1,4 @@
-/* Copyright (c) 2010 NVIDIA Corporation.  All rights reserved.
+/* Copyright (c) 2010-2013 NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -329,6 +329,23 @@ readagain:
     goto readagain;
 }
 
+int NvMMReadSockBatch(NvMMSock **sockets, NvMMSockMsg *msgs, int count,
+                      int timeout, NvMMSock **sockReadFrom)
+{
+    int len;
+
+    if (!msgs || count <= 0)
+        return -1;
+
+    // no recvmmsg equivalent, one datagram per call
+    len = NvMMReadSockMultiple(sockets, msgs[0].buffer, msgs[0].size,
+                               timeout, sockReadFrom);
+    if (len < 0)
+        return -1;
+    msgs[0].len = len;
+    return 1;
+}
+
 int NvMMWriteSock(NvMMSock *pSock, char *buffer, int size, int timeout)
 {
     NvSocket *sock = (NvSocket *)pSock;
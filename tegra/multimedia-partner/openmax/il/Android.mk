@@ -175,3 +175,15 @@ LOCAL_CFLAGS += -DLIBEGL_DSO=\"libEGL\"
 LOCAL_NVIDIA_NO_WARNINGS_AS_ERRORS := 1
 include $(NVIDIA_SHARED_LIBRARY)
 
+
+include $(NVIDIA_DEFAULTS)
+
+LOCAL_MODULE := nvxlist_bench
+LOCAL_MODULE_TAGS := nvidia_tests
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/common
+LOCAL_SRC_FILES += common/nvxlist.c
+LOCAL_SRC_FILES += common/nvxlist_bench.c
+LOCAL_SHARED_LIBRARIES += libnvos
+
+include $(NVIDIA_EXECUTABLE)
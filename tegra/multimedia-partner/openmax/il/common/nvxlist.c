@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2010 NVIDIA Corporation.  All rights reserved.
+ * Copyright (c) 2010-2013 NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software and related documentation
@@ -11,6 +11,62 @@
 #include "nvxlist.h"
 #include "nvassert.h"
 
+#define NVX_LIST_CACHE_LINE 64
+
+/* Ordered accesses to the ring indices and slot sequence numbers. */
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+#define NVX_LIST_LOAD(p)        __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define NVX_LIST_STORE(p, v)    __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define NVX_LIST_CAS(p, o, n) \
+    __atomic_compare_exchange_n((p), &(o), (n), NV_FALSE, \
+                                __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)
+#else
+static NV_INLINE NvU32 NvxListLoad(volatile NvU32 *p)
+{
+    NvU32 v = *p;
+    NvOsAtomicExchangeAdd32((NvS32 *)p, 0);
+    return v;
+}
+
+static NV_INLINE NvBool NvxListCas(volatile NvU32 *p, NvU32 *pOld, NvU32 New)
+{
+    NvU32 Cur = (NvU32)NvOsAtomicCompareExchange32((NvS32 *)p, (NvS32)*pOld,
+                                                   (NvS32)New);
+    if (Cur == *pOld)
+        return NV_TRUE;
+    *pOld = Cur;
+    return NV_FALSE;
+}
+
+#define NVX_LIST_LOAD(p)        NvxListLoad(p)
+#define NVX_LIST_STORE(p, v)    NvOsAtomicExchange32((NvS32 *)(p), (NvS32)(v))
+#define NVX_LIST_CAS(p, o, n)   NvxListCas((p), &(o), (n))
+#endif
+
+typedef struct NvxListRingSlotRec
+{
+    volatile NvU32 nSeq;    /* Mpmc: position this slot is ready for */
+    void *pElement;
+} NvxListRingSlot;
+
+/* Producer and consumer indices live on their own cache lines so that the
+   two sides only share a line when one of them has to look at the other. */
+typedef struct NvxListRingRec
+{
+    NvxListRingSlot *pSlots;
+    NvU32 nMask;
+    NvxListType eType;
+    NvU8 aPad0[NVX_LIST_CACHE_LINE - sizeof(void *) - 2 * sizeof(NvU32)];
+
+    volatile NvU32 nTail;
+    NvU32 nHeadCache;       /* Spsc: last head seen by the producer */
+    NvU8 aPad1[NVX_LIST_CACHE_LINE - 2 * sizeof(NvU32)];
+
+    volatile NvU32 nHead;
+    NvU32 nTailCache;       /* Spsc: last tail seen by the consumer */
+    NvU8 aPad2[NVX_LIST_CACHE_LINE - 2 * sizeof(NvU32)];
+} NvxListRing;
+
 NvError NvxListCreate(NvxListHandle *phList)
 {
     NvxList *pList;
@@ -30,18 +86,171 @@ NvError NvxListCreate(NvxListHandle *phList)
     pList->pHead = NULL;
     pList->pEnd = NULL;
     pList->nCount = 0;
+    pList->pRing = NULL;
+    pList->pRingAlloc = NULL;
 
     *phList = pList;
     return NvSuccess;
 }
 
+NvError NvxListCreateRing(NvxListHandle *phList, NvxListType eType, NvU32 nCapacity)
+{
+    NvxList *pList;
+    NvxListRing *pRing;
+    NvU32 nSlots = 1;
+    NvU32 i;
+
+    if (eType == NvxListType_Linked)
+        return NvxListCreate(phList);
+
+    if (eType != NvxListType_Spsc && eType != NvxListType_Mpmc)
+        return NvError_BadParameter;
+
+    if (!nCapacity || nCapacity > 0x10000)
+        return NvError_BadParameter;
+
+    while (nSlots < nCapacity)
+        nSlots <<= 1;
+
+    pList = NvOsAlloc(sizeof(NvxList));
+    if (!pList)
+        return NvError_InsufficientMemory;
+    NvOsMemset(pList, 0, sizeof(NvxList));
+
+    pList->pRingAlloc = NvOsAlloc(NVX_LIST_CACHE_LINE + sizeof(NvxListRing) +
+                                  nSlots * sizeof(NvxListRingSlot));
+    if (!pList->pRingAlloc)
+    {
+        NvOsFree(pList);
+        return NvError_InsufficientMemory;
+    }
+
+    pRing = (NvxListRing *)(((NvUPtr)pList->pRingAlloc + NVX_LIST_CACHE_LINE - 1) &
+                            ~(NvUPtr)(NVX_LIST_CACHE_LINE - 1));
+    NvOsMemset(pRing, 0, sizeof(NvxListRing));
+    pRing->pSlots = (NvxListRingSlot *)(pRing + 1);
+    pRing->nMask = nSlots - 1;
+    pRing->eType = eType;
+
+    for (i = 0; i < nSlots; i++)
+    {
+        pRing->pSlots[i].nSeq = i;
+        pRing->pSlots[i].pElement = NULL;
+    }
+
+    pList->pRing = pRing;
+    *phList = pList;
+    return NvSuccess;
+}
+
+static NvError NvxListRingEnQ(NvxListRing *pRing, void *pElem)
+{
+    NvxListRingSlot *pSlot;
+    NvU32 nPos, nSeq;
+
+    if (pRing->eType == NvxListType_Spsc)
+    {
+        nPos = pRing->nTail;
+        if (nPos - pRing->nHeadCache > pRing->nMask)
+        {
+            pRing->nHeadCache = NVX_LIST_LOAD(&pRing->nHead);
+            if (nPos - pRing->nHeadCache > pRing->nMask)
+                return NvError_Busy;
+        }
+
+        pRing->pSlots[nPos & pRing->nMask].pElement = pElem;
+        NVX_LIST_STORE(&pRing->nTail, nPos + 1);
+        return NvSuccess;
+    }
+
+    /* Claim the tail slot once its previous occupant has been consumed,
+       then publish the element through the slot sequence number. */
+    nPos = NVX_LIST_LOAD(&pRing->nTail);
+    for (;;)
+    {
+        pSlot = &pRing->pSlots[nPos & pRing->nMask];
+        nSeq = NVX_LIST_LOAD(&pSlot->nSeq);
+        if (nSeq == nPos)
+        {
+            if (NVX_LIST_CAS(&pRing->nTail, nPos, nPos + 1))
+                break;
+        }
+        else if ((NvS32)(nSeq - nPos) < 0)
+        {
+            return NvError_Busy;
+        }
+        else
+        {
+            nPos = NVX_LIST_LOAD(&pRing->nTail);
+        }
+    }
+
+    pSlot->pElement = pElem;
+    NVX_LIST_STORE(&pSlot->nSeq, nPos + 1);
+    return NvSuccess;
+}
+
+static NvError NvxListRingDeQ(NvxListRing *pRing, void **pElem, NvBool bRemove)
+{
+    NvxListRingSlot *pSlot;
+    NvU32 nPos, nSeq;
+
+    if (pRing->eType == NvxListType_Spsc)
+    {
+        nPos = pRing->nHead;
+        if (nPos == pRing->nTailCache)
+        {
+            pRing->nTailCache = NVX_LIST_LOAD(&pRing->nTail);
+            if (nPos == pRing->nTailCache)
+                return NvError_InvalidSize;
+        }
+
+        *pElem = pRing->pSlots[nPos & pRing->nMask].pElement;
+        if (bRemove)
+            NVX_LIST_STORE(&pRing->nHead, nPos + 1);
+        return NvSuccess;
+    }
+
+    nPos = NVX_LIST_LOAD(&pRing->nHead);
+    for (;;)
+    {
+        pSlot = &pRing->pSlots[nPos & pRing->nMask];
+        nSeq = NVX_LIST_LOAD(&pSlot->nSeq);
+        if (nSeq == nPos + 1)
+        {
+            if (!bRemove)
+            {
+                *pElem = pSlot->pElement;
+                return NvSuccess;
+            }
+            if (NVX_LIST_CAS(&pRing->nHead, nPos, nPos + 1))
+                break;
+        }
+        else if ((NvS32)(nSeq - (nPos + 1)) < 0)
+        {
+            return NvError_InvalidSize;
+        }
+        else
+        {
+            nPos = NVX_LIST_LOAD(&pRing->nHead);
+        }
+    }
+
+    *pElem = pSlot->pElement;
+    NVX_LIST_STORE(&pSlot->nSeq, nPos + pRing->nMask + 1);
+    return NvSuccess;
+}
+
 void NvxListDestroy(NvxListHandle *phList)
 {
     NvxList *pList = *phList;
     if (!pList)
         return;
 
-    NvOsMutexDestroy(pList->oLock);
+    if (pList->pRing)
+        NvOsFree(pList->pRingAlloc);
+    else
+        NvOsMutexDestroy(pList->oLock);
     NvOsFree(pList);
     *phList = NULL;
 }
@@ -49,8 +258,12 @@ void NvxListDestroy(NvxListHandle *phList)
 NvError NvxListEnQ(NvxListHandle hList, void *pElem, NvU32 Timeout)
 {
     NvxList *pList = hList;
-    NvxListItem *newItem = NvOsAlloc(sizeof(NvxListItem));
+    NvxListItem *newItem;
+
+    if (pList->pRing)
+        return NvxListRingEnQ(pList->pRing, pElem);
 
+    newItem = NvOsAlloc(sizeof(NvxListItem));
     if (!newItem)
         return NvError_InsufficientMemory;
 
@@ -79,6 +292,9 @@ NvError NvxListDeQ(NvxListHandle hList, void **pElem)
     NvxList *pList = hList;
     NvError ret = NvSuccess;
 
+    if (pList->pRing)
+        return NvxListRingDeQ(pList->pRing, pElem, NV_TRUE);
+
     NvOsMutexLock(pList->oLock);
 
     if (!pList->pHead)
@@ -104,6 +320,9 @@ NvError NvxListPeek(NvxListHandle hList, void **pElem)
     NvxList *pList = hList;
     NvError ret = NvSuccess;
 
+    if (pList->pRing)
+        return NvxListRingDeQ(pList->pRing, pElem, NV_FALSE);
+
     NvOsMutexLock(pList->oLock);
 
     if (!pList->pHead)
@@ -122,6 +341,9 @@ NvError NvxListPeekEntry(NvxListHandle hList, void **pElem, NvU32 nEntry)
     NvxList *pList = hList;
     NvError ret = NvSuccess;
 
+    if (pList->pRing)
+        return NvError_NotSupported;
+
     NvOsMutexLock(pList->oLock);
 
     if (!pList->pHead)
@@ -151,8 +373,12 @@ NvError NvxListPeekEntry(NvxListHandle hList, void **pElem, NvU32 nEntry)
 NvError NvxListInsertHead(NvxListHandle hList, void *pElem, NvU32 uTimeout)
 {
     NvxList *pList = hList;
-    NvxListItem *newItem = NvOsAlloc(sizeof(NvxListItem));
+    NvxListItem *newItem;
+
+    if (pList->pRing)
+        return NvError_NotSupported;
 
+    newItem = NvOsAlloc(sizeof(NvxListItem));
     if (!newItem)
         return NvError_InsufficientMemory;
 
@@ -177,6 +403,15 @@ NvU32 NvxListGetNumEntries(NvxListHandle hList)
     NvxList *pList = hList;
     NvU32 count;
 
+    if (pList->pRing)
+    {
+        NvU32 nHead = NVX_LIST_LOAD(&pList->pRing->nHead);
+        NvU32 nTail = NVX_LIST_LOAD(&pList->pRing->nTail);
+
+        /* a consumer may have moved past the tail we read */
+        return ((NvS32)(nTail - nHead) > 0) ? nTail - nHead : 0;
+    }
+
     NvOsMutexLock(pList->oLock);
     count = pList->nCount;
     NvOsMutexUnlock(pList->oLock);
@@ -189,6 +424,9 @@ NvError NvxListRemoveEntry(NvxListHandle hList, void *pElem)
     NvxList *pList = hList;
     NvError ret = NvSuccess;
 
+    if (pList->pRing)
+        return NvError_NotSupported;
+
     NvOsMutexLock(pList->oLock);
 
     if (!pList->pHead)
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2010 NVIDIA Corporation.  All rights reserved.
+ * Copyright (c) 2010-2013 NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software and related documentation
@@ -23,8 +23,30 @@ extern "C"
 /* Not a great API, but need to keep compatability with the nvmm queue
    to minimize changes.  These will always have < 10 elements, so any
    inefficiencies implied in the API don't really matter.
+
+   Lists made with NvxListCreateRing are backed by a fixed size, lock free
+   ring instead of the mutex protected linked list.  They hold at most
+   nCapacity elements (EnQ returns NvError_Busy when full), never allocate
+   after creation, and only support EnQ, DeQ, Peek and GetNumEntries; the
+   other calls return NvError_NotSupported.
  */
 
+typedef enum
+{
+    /* mutex protected linked list, every call supported */
+    NvxListType_Linked = 0,
+
+    /* ring with one producer and one consumer thread */
+    NvxListType_Spsc,
+
+    /* ring with any number of producer and consumer threads */
+    NvxListType_Mpmc,
+
+    NvxListType_Force32 = 0x7FFFFFFF
+} NvxListType;
+
+struct NvxListRingRec;
+
 typedef struct _NvxListItem
 {
     void *pElement;
@@ -37,11 +59,14 @@ typedef struct NvxListRec
     NvxListItem *pHead;
     NvxListItem *pEnd;
     NvU32 nCount;
+    struct NvxListRingRec *pRing;
+    void *pRingAlloc;
 } NvxList;
 
 typedef struct NvxListRec *NvxListHandle;
 
 NvError NvxListCreate(NvxListHandle *phList);
+NvError NvxListCreateRing(NvxListHandle *phList, NvxListType eType, NvU32 nCapacity);
 void NvxListDestroy(NvxListHandle *phList);
 NvError NvxListEnQ(NvxListHandle hList, void *pElem, NvU32 Timeout);
 NvError NvxListDeQ(NvxListHandle hList, void **pElem);
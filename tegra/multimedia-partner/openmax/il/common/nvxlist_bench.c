@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2013 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software and related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+/*
+ * Throughput and latency of the NvxList backends under the access patterns
+ * an OMX port sees on its buffer queues:
+ *
+ *   1p1c  client thread returning buffers, worker taking them
+ *   3p1c  client, worker and flush all returning buffers to one worker
+ *   2p2c  as 1p1c plus a flush draining the queue against the worker
+ *
+ * Producers never have more than BENCH_DEPTH elements queued, like a port
+ * that only owns nBuffers headers. Every EnQ and DeQ that moves an element
+ * is timed and the per call latency is reported as percentiles.
+ *
+ * usage: nvxlist_bench [operations per producer]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "nvos.h"
+#include "nvxlist.h"
+
+#define BENCH_DEFAULT_OPS   1000000
+#define BENCH_DEPTH         8
+#define BENCH_CAPACITY      (BENCH_DEPTH + 40)
+#define BENCH_MAX_THREADS   4
+#define BENCH_BUCKETS       32
+
+typedef struct BenchHistRec
+{
+    NvU64 aCount[BENCH_BUCKETS];    /* bucket n counts calls of < 2^n ns */
+    NvU64 nMaxNs;
+} BenchHist;
+
+typedef struct BenchRec
+{
+    NvxListHandle hList;
+    NvU32 nOps;
+    NvU32 nProducers;
+    volatile NvU32 nConsumed;
+    volatile NvU32 bGo;
+} Bench;
+
+typedef struct BenchThreadRec
+{
+    Bench *pBench;
+    NvU32 nId;
+    NvU64 nSum;
+    BenchHist oHist;
+} BenchThread;
+
+static NvU64 BenchNowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (NvU64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void BenchRecord(BenchHist *pHist, NvU64 nNs)
+{
+    NvU32 n = 0;
+
+    while (n < BENCH_BUCKETS - 1 && (1ULL << n) <= nNs)
+        n++;
+    pHist->aCount[n]++;
+    if (nNs > pHist->nMaxNs)
+        pHist->nMaxNs = nNs;
+}
+
+static void BenchMerge(BenchHist *pDst, const BenchHist *pSrc)
+{
+    NvU32 i;
+
+    for (i = 0; i < BENCH_BUCKETS; i++)
+        pDst->aCount[i] += pSrc->aCount[i];
+    if (pSrc->nMaxNs > pDst->nMaxNs)
+        pDst->nMaxNs = pSrc->nMaxNs;
+}
+
+/* Upper bound, in ns, of the bucket holding the given fraction of calls. */
+static NvU64 BenchPercentile(const BenchHist *pHist, NvU32 nPerMille)
+{
+    NvU64 nTotal = 0, nSeen = 0;
+    NvU32 i;
+
+    for (i = 0; i < BENCH_BUCKETS; i++)
+        nTotal += pHist->aCount[i];
+
+    for (i = 0; i < BENCH_BUCKETS; i++)
+    {
+        nSeen += pHist->aCount[i];
+        if (nSeen * 1000 >= nTotal * nPerMille)
+            return 1ULL << i;
+    }
+    return pHist->nMaxNs;
+}
+
+static void BenchProducer(void *pArg)
+{
+    BenchThread *pThread = (BenchThread *)pArg;
+    Bench *pBench = pThread->pBench;
+    NvU32 i;
+    NvU64 nStart;
+    NvUPtr nValue;
+
+    while (!pBench->bGo)
+        NvOsThreadYield();
+
+    for (i = 0; i < pBench->nOps; i++)
+    {
+        nValue = ((NvUPtr)pThread->nId << 24) | (i + 1);
+
+        while (NvxListGetNumEntries(pBench->hList) >= BENCH_DEPTH)
+            NvOsThreadYield();
+
+        for (;;)
+        {
+            nStart = BenchNowNs();
+            if (NvxListEnQ(pBench->hList, (void *)nValue, 0) == NvSuccess)
+                break;
+            NvOsThreadYield();
+        }
+        BenchRecord(&pThread->oHist, BenchNowNs() - nStart);
+        pThread->nSum += nValue;
+    }
+}
+
+static void BenchConsumer(void *pArg)
+{
+    BenchThread *pThread = (BenchThread *)pArg;
+    Bench *pBench = pThread->pBench;
+    NvU32 nLast[BENCH_MAX_THREADS];
+    NvU32 nTotal;
+    NvU64 nStart, nEnd;
+    void *pElem;
+    NvUPtr nValue;
+
+    NvOsMemset(nLast, 0, sizeof(nLast));
+
+    while (!pBench->bGo)
+        NvOsThreadYield();
+
+    nTotal = pBench->nOps * pBench->nProducers;
+    while (pBench->nConsumed < nTotal)
+    {
+        nStart = BenchNowNs();
+        if (NvxListDeQ(pBench->hList, &pElem) != NvSuccess)
+        {
+            NvOsThreadYield();
+            continue;
+        }
+        nEnd = BenchNowNs();
+        BenchRecord(&pThread->oHist, nEnd - nStart);
+
+        /* every producer's elements come out in the order they went in */
+        nValue = (NvUPtr)pElem;
+        if ((nValue & 0xFFFFFF) <= nLast[nValue >> 24])
+        {
+            printf("element 0x%x out of order\n", (NvU32)nValue);
+            exit(1);
+        }
+        nLast[nValue >> 24] = (NvU32)(nValue & 0xFFFFFF);
+
+        pThread->nSum += nValue;
+        NvOsAtomicExchangeAdd32((NvS32 *)&pBench->nConsumed, 1);
+    }
+}
+
+static NvError BenchRun(const char *pName, NvxListType eType,
+                        NvU32 nProducers, NvU32 nConsumers, NvU32 nOps)
+{
+    Bench oBench;
+    BenchThread aThreads[BENCH_MAX_THREADS];
+    NvOsThreadHandle ahThreads[BENCH_MAX_THREADS];
+    BenchHist oEnQ, oDeQ;
+    NvU64 nProducedSum = 0, nConsumedSum = 0;
+    NvU64 nStart, nUs;
+    NvU32 nThreads = nProducers + nConsumers;
+    NvU32 i;
+    NvError err;
+
+    NvOsMemset(&oBench, 0, sizeof(oBench));
+    NvOsMemset(aThreads, 0, sizeof(aThreads));
+    NvOsMemset(ahThreads, 0, sizeof(ahThreads));
+    NvOsMemset(&oEnQ, 0, sizeof(oEnQ));
+    NvOsMemset(&oDeQ, 0, sizeof(oDeQ));
+
+    oBench.nOps = nOps;
+    oBench.nProducers = nProducers;
+
+    err = NvxListCreateRing(&oBench.hList, eType, BENCH_CAPACITY);
+    if (err != NvSuccess)
+        return err;
+
+    for (i = 0; i < nThreads; i++)
+    {
+        aThreads[i].pBench = &oBench;
+        aThreads[i].nId = i;
+        err = NvOsThreadCreate((i < nProducers) ? BenchProducer : BenchConsumer,
+                               &aThreads[i], &ahThreads[i]);
+        if (err != NvSuccess)
+        {
+            /* threads already started have nothing to wait for */
+            oBench.nOps = 0;
+            oBench.nProducers = 0;
+            break;
+        }
+    }
+
+    nStart = NvOsGetTimeUS();
+    oBench.bGo = 1;
+    for (i = 0; i < nThreads; i++)
+        NvOsThreadJoin(ahThreads[i]);
+    nUs = NvOsGetTimeUS() - nStart;
+
+    NvxListDestroy(&oBench.hList);
+    if (err != NvSuccess)
+        return err;
+
+    for (i = 0; i < nThreads; i++)
+    {
+        if (i < nProducers)
+        {
+            BenchMerge(&oEnQ, &aThreads[i].oHist);
+            nProducedSum += aThreads[i].nSum;
+        }
+        else
+        {
+            BenchMerge(&oDeQ, &aThreads[i].oHist);
+            nConsumedSum += aThreads[i].nSum;
+        }
+    }
+
+    if (nProducedSum != nConsumedSum)
+    {
+        printf("%s: elements lost\n", pName);
+        return NvError_InvalidState;
+    }
+
+    printf("%-6s %-7s %10llu  enq p50 %5llu p99 %6llu p999 %7llu max %8llu"
+           "  deq p50 %5llu p99 %6llu p999 %7llu max %8llu\n",
+           pName,
+           (eType == NvxListType_Linked) ? "list" :
+           (eType == NvxListType_Spsc) ? "spsc" : "mpmc",
+           nUs ? (NvU64)nOps * nProducers * 1000000ULL / nUs : 0,
+           BenchPercentile(&oEnQ, 500), BenchPercentile(&oEnQ, 990),
+           BenchPercentile(&oEnQ, 999), oEnQ.nMaxNs,
+           BenchPercentile(&oDeQ, 500), BenchPercentile(&oDeQ, 990),
+           BenchPercentile(&oDeQ, 999), oDeQ.nMaxNs);
+    return NvSuccess;
+}
+
+int main(int argc, char *argv[])
+{
+    NvU32 nOps = BENCH_DEFAULT_OPS;
+    NvError err = NvSuccess;
+
+    if (argc > 1)
+    {
+        nOps = (NvU32)strtoul(argv[1], NULL, 0);
+        if (!nOps || nOps > 0xFFFFFF)
+        {
+            printf("usage: %s [operations per producer, at most %u]\n",
+                   argv[0], 0xFFFFFF);
+            return 1;
+        }
+    }
+
+    printf("%-6s %-7s %10s  (latencies in ns, rounded up to a power of 2)\n",
+           "load", "backend", "ops/s");
+
+    if (err == NvSuccess)
+        err = BenchRun("1p1c", NvxListType_Linked, 1, 1, nOps);
+    if (err == NvSuccess)
+        err = BenchRun("1p1c", NvxListType_Spsc, 1, 1, nOps);
+    if (err == NvSuccess)
+        err = BenchRun("1p1c", NvxListType_Mpmc, 1, 1, nOps);
+    if (err == NvSuccess)
+        err = BenchRun("3p1c", NvxListType_Linked, 3, 1, nOps);
+    if (err == NvSuccess)
+        err = BenchRun("3p1c", NvxListType_Mpmc, 3, 1, nOps);
+    if (err == NvSuccess)
+        err = BenchRun("2p2c", NvxListType_Linked, 2, 2, nOps);
+    if (err == NvSuccess)
+        err = BenchRun("2p2c", NvxListType_Mpmc, 2, 2, nOps);
+
+    if (err != NvSuccess)
+    {
+        printf("benchmark failed NvError 0x%x\n", err);
+        return 1;
+    }
+    return 0;
+}
@@ -1773,7 +1773,7 @@ static OMX_BOOL NvxCanStop(OMX_IN NvxComponent *pNvComp)
                 }
                 else
                 {
-                    nBuffers = NvMMQueueGetNumEntries(pPort->pFullBuffers);
+                    nBuffers = NvxListGetNumEntries(pPort->pFullBuffers);
                 }
 
                 if ((OMX_U32)nBuffers != pPort->nBuffers){
@@ -250,10 +250,8 @@ OMX_ERRORTYPE NvxPortAllocResources(NvxPort *pThis)
 
     if (NvxIsSuccess(eError)) 
     {
-        if (pThis->pFullBuffers == NULL)
-            err = NvMMQueueCreate(&(pThis->pFullBuffers), pThis->nReqBufferCount, sizeof(OMX_BUFFERHEADERTYPE*), NV_FALSE);
         if (pThis->pEmptyBuffers == NULL)
-            err |= NvxListCreate(&(pThis->pEmptyBuffers));
+            err = NvxListCreate(&(pThis->pEmptyBuffers));
         if (pThis->pBufferMarks == NULL)
             err |= NvMMQueueCreate( &(pThis->pBufferMarks),  pThis->nReqBufferCount, sizeof(OMX_MARKTYPE), NV_FALSE);
         if (pThis->pBuffersToSend == NULL)
@@ -283,6 +281,12 @@ OMX_ERRORTYPE NvxPortAllocResources(NvxPort *pThis)
                 eError = OMX_ErrorInsufficientResources; 
             }
         }
+
+        /* Filled from client threads and drained by the worker and flush,
+           never holds more than the nMaxBuffers headers set up above. */
+        if (pThis->pFullBuffers == NULL && NvxIsSuccess(eError))
+            err |= NvxListCreateRing(&(pThis->pFullBuffers), NvxListType_Mpmc,
+                                     pThis->nMaxBuffers);
     }
 
     if (err != NvSuccess)
@@ -636,7 +640,7 @@ OMX_ERRORTYPE NvxPortReleaseResources(NvxPort *pThis)
 
     if (pThis->pFullBuffers != NULL) 
     {
-        NvMMQueueDestroy(&pThis->pFullBuffers);
+        NvxListDestroy(&pThis->pFullBuffers);
         pThis->pFullBuffers = NULL;
     }
     if (pThis->pEmptyBuffers != NULL)
@@ -678,7 +682,7 @@ OMX_ERRORTYPE NvxPortEmptyThisBuffer(NvxPort *pThis, OMX_IN OMX_BUFFERHEADERTYPE
     if (!pThis->pFullBuffers)
         return OMX_ErrorResourcesLost; 
 
-    err = NvMMQueueEnQ(pThis->pFullBuffers, &pBuffer, OMX_TIMEOUT_MS);
+    err = NvxListEnQ(pThis->pFullBuffers, pBuffer, OMX_TIMEOUT_MS);
 
     if (pThis->nSharingPorts)
     {
@@ -797,8 +801,8 @@ OMX_ERRORTYPE NvxPortGetFullBuffer(NvxPort *pThis, OMX_OUT OMX_BUFFERHEADERTYPE*
     if (!pThis->pFullBuffers)
         return OMX_ErrorNoMore;
 
-    if (NvMMQueueGetNumEntries(pThis->pFullBuffers) > 0)
-        err = NvMMQueueDeQ(pThis->pFullBuffers, ppBuffer);
+    if (NvxListGetNumEntries(pThis->pFullBuffers) > 0)
+        err = NvxListDeQ(pThis->pFullBuffers, (void **)ppBuffer);
 
     if (NvSuccess == err)
         return OMX_ErrorNone;
@@ -1008,7 +1012,7 @@ OMX_ERRORTYPE NvxPortReturnBuffers(OMX_IN NvxPort *pThis, OMX_BOOL bWorkerLocked
                 pBuffer->nOffset = 0;
 
                 if (pThis->oPortDef.eDir == OMX_DirInput)
-                    err = NvMMQueueEnQ(pThis->pFullBuffers, &pBuffer, OMX_TIMEOUT_MS);
+                    err = NvxListEnQ(pThis->pFullBuffers, pBuffer, OMX_TIMEOUT_MS);
                 else
                     err = NvxListEnQ(pThis->pEmptyBuffers, pBuffer, OMX_TIMEOUT_MS);
 
@@ -1108,7 +1112,7 @@ OMX_ERRORTYPE NvxPortReturnBuffers(OMX_IN NvxPort *pThis, OMX_BOOL bWorkerLocked
                 pThis->pCurrentBufferHdr->nFlags = 0;
 
                 if (pThis->oPortDef.eDir == OMX_DirInput)
-                    err = NvMMQueueEnQ( pThis->pFullBuffers, &pThis->pCurrentBufferHdr, OMX_TIMEOUT_MS);
+                    err = NvxListEnQ(pThis->pFullBuffers, pThis->pCurrentBufferHdr, OMX_TIMEOUT_MS);
                 else
                     err = NvxListEnQ( pThis->pEmptyBuffers, pThis->pCurrentBufferHdr, OMX_TIMEOUT_MS);
 
@@ -1129,7 +1133,7 @@ OMX_ERRORTYPE NvxPortReturnBuffers(OMX_IN NvxPort *pThis, OMX_BOOL bWorkerLocked
                 pBuffer->nFlags = 0;
 
                 if (pThis->oPortDef.eDir == OMX_DirInput)
-                    err = NvMMQueueEnQ(pThis->pFullBuffers, &pBuffer, OMX_TIMEOUT_MS);
+                    err = NvxListEnQ(pThis->pFullBuffers, pBuffer, OMX_TIMEOUT_MS);
                 else
                     err = NvxListEnQ(pThis->pEmptyBuffers, pBuffer, OMX_TIMEOUT_MS);
 
@@ -1150,7 +1154,7 @@ OMX_ERRORTYPE NvxPortReturnBuffers(OMX_IN NvxPort *pThis, OMX_BOOL bWorkerLocked
         {
             if (pThis->pNvComp->pCallbacks != NULL && pThis->pNvComp->pCallbacks->EmptyBufferDone != NULL)
             {
-                while (NvSuccess == NvMMQueueDeQ(pThis->pFullBuffers, (void *)&pBuffer))
+                while (NvSuccess == NvxListDeQ(pThis->pFullBuffers, (void **)&pBuffer))
                 {
                     NvxCheckError(eError, pThis->pNvComp->pCallbacks->EmptyBufferDone(pThis->pNvComp->hBaseComponent, pThis->pNvComp->pCallbackAppData, pBuffer));
                 }
@@ -1221,7 +1225,7 @@ OMX_ERRORTYPE NvxPortFlushBuffers(OMX_IN NvxPort *pThis)
         if (pThis->oPortDef.eDir == OMX_DirInput)
         {
             /* input return all buffers to the output */
-            while (NvSuccess == NvMMQueueDeQ(pThis->pFullBuffers, (void *)&pBuffer))
+            while (NvSuccess == NvxListDeQ(pThis->pFullBuffers, (void **)&pBuffer))
             {
                 pBuffer->nFilledLen = 0;
                 NvxCheckError(eError, OMX_FillThisBuffer(pThis->hTunnelComponent,pBuffer));
@@ -1275,7 +1279,7 @@ OMX_ERRORTYPE NvxPortFlushBuffers(OMX_IN NvxPort *pThis)
         {
             if (pThis->pNvComp->pCallbacks != NULL && pThis->pNvComp->pCallbacks->EmptyBufferDone != NULL)
             {
-                while (NvSuccess == NvMMQueueDeQ(pThis->pFullBuffers, (void *)&pBuffer))
+                while (NvSuccess == NvxListDeQ(pThis->pFullBuffers, (void **)&pBuffer))
                 {
                     NvxCheckError(eError, pThis->pNvComp->pCallbacks->EmptyBufferDone(pThis->pNvComp->hBaseComponent, pThis->pNvComp->pCallbackAppData, pBuffer));
                     if (NvxIsError(eError))
@@ -1521,7 +1525,7 @@ OMX_ERRORTYPE NvxPortStart(OMX_IN NvxPort *pThis)
         OMX_BUFFERHEADERTYPE *pBuffer = NULL;
 
 
-        if (NvMMQueueGetNumEntries(pThis->pFullBuffers) > 0)
+        if (NvxListGetNumEntries(pThis->pFullBuffers) > 0)
         {
             // Exec->idle->Exec operations will lead to this code path.
             while (NvxPortNumPendingBuffers(pThis) > 0)
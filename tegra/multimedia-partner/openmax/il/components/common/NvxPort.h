@@ -52,7 +52,7 @@ struct _NvxPort {
     OMX_U32                 nMaxBufferSize;      /* max size of buffers */
     OMX_U32                 nNonTunneledBufferSize; 
 
-    NvMMQueueHandle          pFullBuffers;        /* buffers that have been filled in */
+    NvxListHandle            pFullBuffers;        /* buffers that have been filled in */
     NvxListHandle            pEmptyBuffers;       /* buffers that are empty */
     NvMMQueueHandle          pBufferMarks;        /* buffers that are empty */
 
@@ -1,4 +1,4 @@
-/* Copyright (c) 2006 NVIDIA Corporation.  All rights reserved.
+/* Copyright (c) 2006-2013 NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property
  * and proprietary rights in and to this software, related documentation
@@ -19,6 +19,7 @@
 
 #include "nvos.h"
 
+typedef struct SNvxSchedTask NvxSchedTask;
 typedef struct SNvxWorkerInt NvxWorkerInt;
 struct SNvxWorkerInt {
     void *pWorkerData;           /**< pointer reserved for use by worker */
@@ -31,6 +32,7 @@ struct SNvxWorkerInt {
             NvOsThreadHandle hThread;
             NvOsSemaphoreHandle hTriggerEvent;
             NvOsSemaphoreHandle hSchedulerEvent;
+            NvxSchedTask *pTask;
         } i;
         void *pSchedulerPtrs[8];     /**< set of pointers reserved for use by scheduler */
     } p;
@@ -50,6 +52,458 @@ struct SNvxWorkerInt {
 static OMX_HANDLETYPE s_hSchedMutex = 0;
 static struct SNvxWorkerInt s_oHead = { 0, {{0}}, {{0}} };
 
+/* Task states, only moved with atomic operations */
+#define NVX_TASK_IDLE       0   /* waiting for a trigger or its timer */
+#define NVX_TASK_QUEUED     1   /* on a pool run queue */
+#define NVX_TASK_RUNNING    2
+#define NVX_TASK_RERUN      3   /* running, triggered again meanwhile */
+#define NVX_TASK_STOPPED    4
+
+#define NVX_SCHED_MAX_THREADS   8
+#define NVX_SCHED_WHEEL_SLOTS   256     /* one slot per millisecond */
+#define NVX_SCHED_STOP_POLL_MS  10
+#define NVX_SCHED_STATS_PERIOD  1024    /* runs between two stats traces */
+
+/* Scheduler side state of a worker, allocated by NvxWorkerInit */
+struct SNvxSchedTask {
+    NvxWorkerInt *pWorker;
+    NvS32 eState;
+    NvxSchedTask *pNextRun;         /**< run queue link */
+    NvxSchedTask *pTimerNext;
+    NvxSchedTask **ppTimerPrev;     /**< NULL when no timer is armed */
+    NvxTimeMs uExpiry;
+    NvU64 nQueuedUs;                /**< trigger time, 0 if not triggered */
+    NvxWorkerStats oStats;
+};
+
+typedef struct SNvxSchedQueue {
+    NvOsMutexHandle hLock;
+    NvxSchedTask *pHead;
+    NvxSchedTask *pTail;
+} NvxSchedQueue;
+
+typedef struct SNvxSchedPool {
+    NvU32 nThreads;
+    NvOsThreadHandle hThreads[NVX_SCHED_MAX_THREADS];
+    NvxSchedQueue oQueues[NVX_SCHED_MAX_THREADS];
+    NvOsSemaphoreHandle hWake;      /**< signalled for sleeping pool threads */
+    NvS32 nSleeping;
+    NvS32 nNextQueue;               /**< round robin for outside triggers */
+    NvU32 uTlsIndex;                /**< pool thread index + 1 */
+    volatile NvU32 bShutdown;
+
+    NvOsThreadHandle hTimerThread;
+    NvOsMutexHandle hTimerLock;
+    NvOsSemaphoreHandle hTimerEvent;
+    NvxSchedTask *pWheel[NVX_SCHED_WHEEL_SLOTS];
+    NvxTimeMs uWheelTime;           /**< next millisecond to expire */
+    NvxTimeMs uTimerWakeAt;
+    NvU32 nArmed;
+} NvxSchedPool;
+
+static NvxSchedPool *s_pPool = NULL;
+
+static OMX_ERRORTYPE NvxRunWorkerFuncOnce(NvxWorkerInt* pWorkerInt, NvxTimeMs uMaxTime, NvxTimeMs* puMaxMsecToNextCall);
+
+static void NvxSchedTraceStats(NvxWorkerInt *pWorkerInt, NvxWorkerStats *pStats)
+{
+    NVXTRACE((NVXT_WORKER, NVXT_SCHEDULER,
+              "worker %p: %u runs, run avg %u max %u us, queue avg %u max %u us, %u steals\n",
+              pWorkerInt, pStats->nRuns,
+              pStats->nRuns ? (OMX_U32)(pStats->nRunTimeUs / pStats->nRuns) : 0,
+              pStats->nMaxRunTimeUs,
+              pStats->nRuns ? (OMX_U32)(pStats->nQueueLatencyUs / pStats->nRuns) : 0,
+              pStats->nMaxQueueLatencyUs, pStats->nSteals));
+}
+
+static void NvxSchedQueuePush(NvxSchedQueue *pQueue, NvxSchedTask *pTask)
+{
+    pTask->pNextRun = NULL;
+    NvOsMutexLock(pQueue->hLock);
+    if (pQueue->pTail)
+        pQueue->pTail->pNextRun = pTask;
+    else
+        pQueue->pHead = pTask;
+    pQueue->pTail = pTask;
+    NvOsMutexUnlock(pQueue->hLock);
+}
+
+static NvxSchedTask *NvxSchedQueuePop(NvxSchedQueue *pQueue)
+{
+    NvxSchedTask *pTask;
+
+    /* racy peek, pushers always wake a sleeper after the push */
+    if (!pQueue->pHead)
+        return NULL;
+
+    NvOsMutexLock(pQueue->hLock);
+    pTask = pQueue->pHead;
+    if (pTask)
+    {
+        pQueue->pHead = pTask->pNextRun;
+        if (!pQueue->pHead)
+            pQueue->pTail = NULL;
+    }
+    NvOsMutexUnlock(pQueue->hLock);
+    return pTask;
+}
+
+/* Put a task in the run queue of the calling pool thread, or spread
+   triggers from outside the pool over all queues. */
+static void NvxSchedPoolPush(NvxSchedTask *pTask)
+{
+    NvxSchedPool *pPool = s_pPool;
+    NvU32 nQueue = (NvU32)(NvUPtr)NvOsTlsGet(pPool->uTlsIndex);
+
+    if (nQueue)
+        nQueue--;
+    else
+        nQueue = (NvU32)NvOsAtomicExchangeAdd32(&pPool->nNextQueue, 1) % pPool->nThreads;
+
+    NvxSchedQueuePush(&pPool->oQueues[nQueue], pTask);
+
+    if (NvOsAtomicExchangeAdd32(&pPool->nSleeping, 0) > 0)
+        NvOsSemaphoreSignal(pPool->hWake);
+}
+
+/* Make a triggered task runnable.  A task is on at most one queue and run
+   by at most one thread at a time; triggers while it runs make it run
+   again once it finishes. */
+static void NvxSchedSubmit(NvxSchedTask *pTask)
+{
+    NvS32 eState;
+
+    for (;;)
+    {
+        eState = NvOsAtomicExchangeAdd32(&pTask->eState, 0);
+        if (eState == NVX_TASK_IDLE)
+        {
+            if (NvOsAtomicCompareExchange32(&pTask->eState, NVX_TASK_IDLE,
+                                            NVX_TASK_QUEUED) == NVX_TASK_IDLE)
+                break;
+        }
+        else if (eState == NVX_TASK_RUNNING)
+        {
+            if (NvOsAtomicCompareExchange32(&pTask->eState, NVX_TASK_RUNNING,
+                                            NVX_TASK_RERUN) == NVX_TASK_RUNNING)
+                return;
+        }
+        else
+            return;
+    }
+
+    if (!pTask->nQueuedUs)
+        pTask->nQueuedUs = NvOsGetTimeUS();
+    NvxSchedPoolPush(pTask);
+}
+
+static void NvxSchedTimerUnlink(NvxSchedTask *pTask)
+{
+    *pTask->ppTimerPrev = pTask->pTimerNext;
+    if (pTask->pTimerNext)
+        pTask->pTimerNext->ppTimerPrev = pTask->ppTimerPrev;
+    pTask->ppTimerPrev = NULL;
+    pTask->pTimerNext = NULL;
+    s_pPool->nArmed--;
+}
+
+static void NvxSchedTimerArm(NvxSchedTask *pTask, NvxTimeMs uExpiry)
+{
+    NvxSchedPool *pPool = s_pPool;
+    NvxSchedTask **ppSlot;
+    NvBool bWake;
+
+    NvOsMutexLock(pPool->hTimerLock);
+    if (pTask->ppTimerPrev)
+        NvxSchedTimerUnlink(pTask);
+
+    /* never behind the wheel, or it would wait for a full turn */
+    if ((NvS32)(uExpiry - pPool->uWheelTime) < 0)
+        uExpiry = pPool->uWheelTime;
+    ppSlot = &pPool->pWheel[uExpiry % NVX_SCHED_WHEEL_SLOTS];
+
+    pTask->uExpiry = uExpiry;
+    pTask->pTimerNext = *ppSlot;
+    if (*ppSlot)
+        (*ppSlot)->ppTimerPrev = &pTask->pTimerNext;
+    pTask->ppTimerPrev = ppSlot;
+    *ppSlot = pTask;
+    pPool->nArmed++;
+
+    bWake = ((NvS32)(uExpiry - pPool->uTimerWakeAt) < 0);
+    if (bWake)
+        pPool->uTimerWakeAt = uExpiry;
+    NvOsMutexUnlock(pPool->hTimerLock);
+
+    if (bWake)
+        NvOsSemaphoreSignal(pPool->hTimerEvent);
+}
+
+/* Disarm the timer of a task that is about to be freed.  The lock is taken
+   even when no timer is armed: the timer thread unlinks and submits under
+   it, so once it is released no expiry pass is still using the task. */
+static void NvxSchedTimerDisarm(NvxSchedTask *pTask)
+{
+    NvxSchedPool *pPool = s_pPool;
+
+    NvOsMutexLock(pPool->hTimerLock);
+    if (pTask->ppTimerPrev)
+        NvxSchedTimerUnlink(pTask);
+    NvOsMutexUnlock(pPool->hTimerLock);
+}
+
+static void NvxSchedTimerCancel(NvxSchedTask *pTask)
+{
+    /* only the thread running the task arms its timer */
+    if (!pTask->ppTimerPrev)
+        return;
+
+    NvxSchedTimerDisarm(pTask);
+}
+
+static void NvxSchedTimerThread(void *pArg)
+{
+    NvxSchedPool *pPool = (NvxSchedPool *)pArg;
+    NvxSchedTask *pTask, *pNext;
+    NvxTimeMs uNow, uWait, uSlotTime;
+    NvU32 i;
+
+    NvOsMutexLock(pPool->hTimerLock);
+    pPool->uWheelTime = NvOsGetTimeMS();
+
+    while (!pPool->bShutdown)
+    {
+        /* expire every slot up to now, at most one full turn of the wheel */
+        uNow = NvOsGetTimeMS();
+        if ((NvS32)(uNow - pPool->uWheelTime) >= NVX_SCHED_WHEEL_SLOTS)
+            pPool->uWheelTime = uNow - (NVX_SCHED_WHEEL_SLOTS - 1);
+
+        while ((NvS32)(uNow - pPool->uWheelTime) >= 0)
+        {
+            pTask = pPool->pWheel[pPool->uWheelTime % NVX_SCHED_WHEEL_SLOTS];
+            while (pTask)
+            {
+                pNext = pTask->pTimerNext;
+                if ((NvS32)(pTask->uExpiry - uNow) <= 0)
+                {
+                    NvxSchedTimerUnlink(pTask);
+                    pTask->pWorker->state.i.bTriggered = 1;
+                    NvxSchedSubmit(pTask);
+                }
+                pTask = pNext;
+            }
+            pPool->uWheelTime++;
+        }
+
+        /* sleep until the first slot holding a timer due in this turn */
+        uWait = NV_WAIT_INFINITE;
+        if (pPool->nArmed)
+        {
+            uWait = NVX_SCHED_WHEEL_SLOTS;
+            for (i = 0; i < NVX_SCHED_WHEEL_SLOTS && uWait == NVX_SCHED_WHEEL_SLOTS; i++)
+            {
+                uSlotTime = pPool->uWheelTime + i;
+                for (pTask = pPool->pWheel[uSlotTime % NVX_SCHED_WHEEL_SLOTS];
+                     pTask; pTask = pTask->pTimerNext)
+                {
+                    if ((NvS32)(pTask->uExpiry - uSlotTime) <= 0)
+                    {
+                        uWait = i + 1;
+                        break;
+                    }
+                }
+            }
+        }
+        pPool->uTimerWakeAt = (uWait == NV_WAIT_INFINITE) ?
+                              uNow + 0x7fffffff : pPool->uWheelTime + uWait - 1;
+
+        NvOsMutexUnlock(pPool->hTimerLock);
+        NvOsSemaphoreWaitTimeout(pPool->hTimerEvent, uWait);
+        NvOsMutexLock(pPool->hTimerLock);
+    }
+
+    NvOsMutexUnlock(pPool->hTimerLock);
+}
+
+static void NvxSchedStopTask(NvxSchedTask *pTask)
+{
+    NvOsSemaphoreHandle hSchedulerEvent = pTask->pWorker->p.i.hSchedulerEvent;
+
+    /* NvxWorkerDeinit may free the task as soon as it sees it stopped */
+    NvOsSemaphoreSignal(hSchedulerEvent);
+    NvOsAtomicExchange32(&pTask->eState, NVX_TASK_STOPPED);
+}
+
+static void NvxSchedRunTask(NvxSchedTask *pTask, NvU32 nQueue)
+{
+    NvxWorkerInt *pWorkerInt = pTask->pWorker;
+    NvxTimeMs uMaxMsecToNextCall = NVX_TIMEOUT_NEVER;
+
+    NvOsAtomicExchange32(&pTask->eState, NVX_TASK_RUNNING);
+
+    if (pWorkerInt->state.i.bStopping)
+    {
+        NvxSchedStopTask(pTask);
+        return;
+    }
+
+    /* NvxWorkerResume triggers the worker again */
+    if (pWorkerInt->state.i.bPaused)
+    {
+        NvOsAtomicExchange32(&pTask->eState, NVX_TASK_IDLE);
+        return;
+    }
+
+    /* this run replaces the one the timer was armed for */
+    NvxSchedTimerCancel(pTask);
+
+    NvxRunWorkerFuncOnce(pWorkerInt, NVX_TIMEOUT_NEVER, &uMaxMsecToNextCall);
+
+    if (pWorkerInt->state.i.bStopping)
+    {
+        NvxSchedStopTask(pTask);
+        return;
+    }
+
+    if (!pWorkerInt->state.i.bTriggered)
+    {
+        if (uMaxMsecToNextCall != NVX_TIMEOUT_NEVER && uMaxMsecToNextCall != 0)
+            NvxSchedTimerArm(pTask, NvOsGetTimeMS() + uMaxMsecToNextCall);
+
+        if (NvOsAtomicCompareExchange32(&pTask->eState, NVX_TASK_RUNNING,
+                                        NVX_TASK_IDLE) == NVX_TASK_RUNNING)
+            return;
+    }
+
+    /* more work, go to the back of this thread's queue */
+    NvOsAtomicExchange32(&pTask->eState, NVX_TASK_QUEUED);
+    if (!pTask->nQueuedUs)
+        pTask->nQueuedUs = NvOsGetTimeUS();
+    NvxSchedQueuePush(&s_pPool->oQueues[nQueue], pTask);
+}
+
+static NvxSchedTask *NvxSchedFindTask(NvxSchedPool *pPool, NvU32 nQueue)
+{
+    NvxSchedTask *pTask;
+    NvU32 i;
+
+    pTask = NvxSchedQueuePop(&pPool->oQueues[nQueue]);
+    if (pTask)
+        return pTask;
+
+    for (i = 1; i < pPool->nThreads; i++)
+    {
+        pTask = NvxSchedQueuePop(&pPool->oQueues[(nQueue + i) % pPool->nThreads]);
+        if (pTask)
+        {
+            pTask->oStats.nSteals++;
+            return pTask;
+        }
+    }
+    return NULL;
+}
+
+static void NvxSchedPoolThread(void *pArg)
+{
+    NvxSchedPool *pPool = s_pPool;
+    NvU32 nQueue = (NvU32)(NvUPtr)pArg;
+    NvxSchedTask *pTask;
+
+    NvOsTlsSet(pPool->uTlsIndex, (void *)(NvUPtr)(nQueue + 1));
+
+    while (!pPool->bShutdown)
+    {
+        pTask = NvxSchedFindTask(pPool, nQueue);
+        if (!pTask)
+        {
+            /* look again once counted as sleeping so no push is missed */
+            NvOsAtomicExchangeAdd32(&pPool->nSleeping, 1);
+            pTask = NvxSchedFindTask(pPool, nQueue);
+            if (!pTask && !pPool->bShutdown)
+                NvOsSemaphoreWait(pPool->hWake);
+            NvOsAtomicExchangeAdd32(&pPool->nSleeping, -1);
+            if (!pTask)
+                continue;
+        }
+
+        NvxSchedRunTask(pTask, nQueue);
+    }
+}
+
+static void NvxSchedPoolDestroy(void)
+{
+    NvxSchedPool *pPool = s_pPool;
+    NvU32 i;
+
+    if (!pPool)
+        return;
+
+    pPool->bShutdown = 1;
+    for (i = 0; i < pPool->nThreads; i++)
+        NvOsSemaphoreSignal(pPool->hWake);
+    for (i = 0; i < pPool->nThreads; i++)
+        NvOsThreadJoin(pPool->hThreads[i]);
+
+    if (pPool->hTimerThread)
+    {
+        NvOsSemaphoreSignal(pPool->hTimerEvent);
+        NvOsThreadJoin(pPool->hTimerThread);
+    }
+
+    for (i = 0; i < NVX_SCHED_MAX_THREADS; i++)
+        NvOsMutexDestroy(pPool->oQueues[i].hLock);
+    NvOsMutexDestroy(pPool->hTimerLock);
+    NvOsSemaphoreDestroy(pPool->hTimerEvent);
+    NvOsSemaphoreDestroy(pPool->hWake);
+    NvOsTlsFree(pPool->uTlsIndex);
+
+    NvOsFree(pPool);
+    s_pPool = NULL;
+}
+
+static NvError NvxSchedPoolCreate(NvU32 nThreads)
+{
+    NvxSchedPool *pPool;
+    NvError e = NvSuccess;
+    NvU32 i;
+
+    pPool = NvOsAlloc(sizeof(NvxSchedPool));
+    if (!pPool)
+        return NvError_InsufficientMemory;
+    NvOsMemset(pPool, 0, sizeof(NvxSchedPool));
+
+    pPool->nThreads = NV_MIN(nThreads, NVX_SCHED_MAX_THREADS);
+    pPool->uTlsIndex = NvOsTlsAlloc();
+    pPool->uTimerWakeAt = NvOsGetTimeMS() + 0x7fffffff;
+    s_pPool = pPool;
+
+    if (pPool->uTlsIndex == NVOS_INVALID_TLS_INDEX)
+        e = NvError_InsufficientMemory;
+    for (i = 0; i < NVX_SCHED_MAX_THREADS && e == NvSuccess; i++)
+        e = NvOsMutexCreate(&pPool->oQueues[i].hLock);
+    if (e == NvSuccess)
+        e = NvOsMutexCreate(&pPool->hTimerLock);
+    if (e == NvSuccess)
+        e = NvOsSemaphoreCreate(&pPool->hTimerEvent, 0);
+    if (e == NvSuccess)
+        e = NvOsSemaphoreCreate(&pPool->hWake, 0);
+    if (e == NvSuccess)
+        e = NvOsThreadCreate(NvxSchedTimerThread, pPool, &pPool->hTimerThread);
+
+    for (i = 0; i < pPool->nThreads && e == NvSuccess; i++)
+    {
+        e = NvOsThreadCreate(NvxSchedPoolThread, (void *)(NvUPtr)i,
+                             &pPool->hThreads[i]);
+    }
+
+    if (e != NvSuccess)
+    {
+        pPool->nThreads = i ? i - 1 : 0;
+        NvxSchedPoolDestroy();
+    }
+    return e;
+}
+
 //static void atexit_handler(void)
 //{
 //    NvxSchedulerShutdown(100);
@@ -71,6 +525,19 @@ OMX_ERRORTYPE NvxSchedulerInit(void)
     s_oHead.p.i.pPrev = &s_oHead;
     s_oHead.p.i.pNext = &s_oHead;
 
+    if (s_hSchedMutex != NULL)
+    {
+        NvU32 nThreads = 0;
+
+        if (NvOsGetConfigU32("omx_sched_threads", &nThreads) == NvSuccess &&
+            nThreads > 0 &&
+            NvxSchedPoolCreate(nThreads) != NvSuccess)
+        {
+            NVXTRACE((NVXT_WARNING, NVXT_SCHEDULER,
+                      "NvxSchedulerInit: no worker pool, using a thread per worker\n"));
+        }
+    }
+
     //atexit(atexit_handler);
     return e;
 }
@@ -93,6 +560,7 @@ OMX_ERRORTYPE NvxSchedulerShutdown(OMX_IN NvxTimeMs uTimeOut)
         }
     }
 
+    NvxSchedPoolDestroy();
     NvxMutexDestroy(s_hSchedMutex);
     s_hSchedMutex = 0;
     NvOsMemset(&s_oHead, 0, sizeof(s_oHead));
@@ -108,15 +576,43 @@ static OMX_ERRORTYPE NvxRunWorkerFuncOnce(NvxWorkerInt* pWorkerInt, NvxTimeMs uM
 
     NvxWorkerFunc pFunc = pWorkerInt->p.i.pFunc;
     NvxErrorHandler pError = pWorkerInt->p.i.pError;
+    NvxSchedTask *pTask = pWorkerInt->p.i.pTask;
+    NvU64 nStartUs = 0, nQueuedUs, nUs;
     NVXTRACE((NVXT_WORKER,NVXT_SCHEDULER, "NvxRunWorkerFuncOnce"));
     pWorkerInt->state.i.bTriggered = 0;
 
+    if (pTask)
+    {
+        nStartUs = NvOsGetTimeUS();
+        nQueuedUs = pTask->nQueuedUs;
+        if (nQueuedUs)
+        {
+            /* a trigger may race with this run and stamp a later time */
+            nUs = (nStartUs > nQueuedUs) ? nStartUs - nQueuedUs : 0;
+            pTask->nQueuedUs = 0;
+            pTask->oStats.nQueueLatencyUs += nUs;
+            if (nUs > pTask->oStats.nMaxQueueLatencyUs)
+                pTask->oStats.nMaxQueueLatencyUs = (OMX_U32)nUs;
+        }
+    }
+
     bMoreWork = OMX_FALSE;
     if (pFunc && pWorker)
         e = pFunc(pWorker, uMaxTime, &bMoreWork, puMaxMsecToNextCall);
     else
         e = OMX_ErrorUndefined;
 
+    if (pTask)
+    {
+        nUs = NvOsGetTimeUS() - nStartUs;
+        pTask->oStats.nRuns++;
+        pTask->oStats.nRunTimeUs += nUs;
+        if (nUs > pTask->oStats.nMaxRunTimeUs)
+            pTask->oStats.nMaxRunTimeUs = (OMX_U32)nUs;
+        if (pTask->oStats.nRuns % NVX_SCHED_STATS_PERIOD == 0)
+            NvxSchedTraceStats(pWorkerInt, &pTask->oStats);
+    }
+
     if (NvxIsError(e) && pError)
         e = pError(pWorker, e);
 
@@ -311,6 +807,7 @@ OMX_ERRORTYPE NvxWorkerInit(OMX_OUT NvxWorker* pWorker, NvxWorkerFunc pFunc, voi
 {
     NvError e = NvSuccess;
     NvxWorkerInt* pWorkerInt = (NvxWorkerInt *)pWorker;
+    NvxSchedTask *pTask;
 
     if (pWorker == NULL || pFunc == NULL)
         return OMX_ErrorBadParameter;
@@ -320,15 +817,26 @@ OMX_ERRORTYPE NvxWorkerInit(OMX_OUT NvxWorker* pWorker, NvxWorkerFunc pFunc, voi
 
     NvOsMemset(pWorker, 0, sizeof(*pWorker));
 
+    pTask = NvOsAlloc(sizeof(NvxSchedTask));
+    if (!pTask)
+        return OMX_ErrorInsufficientResources;
+    NvOsMemset(pTask, 0, sizeof(NvxSchedTask));
+    pTask->pWorker = pWorkerInt;
+
     NvxMutexLock(s_hSchedMutex);
     pWorker->pWorkerData = pWorkerData;
     pWorkerInt->p.i.pPrev = s_oHead.p.i.pPrev; // when complete, this worker will be the last in the chain before the head
     pWorkerInt->p.i.pNext = &s_oHead;
     pWorkerInt->p.i.pFunc = pFunc;
     pWorkerInt->p.i.pError = pErrorHandler;
+    pWorkerInt->p.i.pTask = pTask;
     pWorkerInt->state.i.bTriggered = 1;
 
-    if (s_hSchedMutex != NULL) {
+    if (s_pPool) {
+        /* runs on the pool, the event only signals a stopped task */
+        e = NvOsSemaphoreCreate(&pWorkerInt->p.i.hSchedulerEvent, 0);
+    }
+    else if (s_hSchedMutex != NULL) {
         e = NvOsSemaphoreCreate(&pWorkerInt->p.i.hTriggerEvent, 0);
         
         if (e == NvSuccess)
@@ -347,11 +855,20 @@ OMX_ERRORTYPE NvxWorkerInit(OMX_OUT NvxWorker* pWorker, NvxWorkerFunc pFunc, voi
         pWorkerInt->p.i.pNext->p.i.pPrev = pWorkerInt;
     }
 
-    if (s_hSchedMutex != NULL) {
+    if (s_pPool) {
+        if (e == NvSuccess)
+            NvxSchedSubmit(pTask);
+    }
+    else if (s_hSchedMutex != NULL) {
         if (e == NvSuccess)
             NvOsSemaphoreWait(pWorkerInt->p.i.hSchedulerEvent);
     }
 
+    if (e != NvSuccess) {
+        pWorkerInt->p.i.pTask = NULL;
+        NvOsFree(pTask);
+    }
+
     NvxMutexUnlock(s_hSchedMutex);
     return (e != NvSuccess) ? OMX_ErrorInsufficientResources : OMX_ErrorNone;
 }
@@ -381,7 +898,44 @@ OMX_ERRORTYPE NvxWorkerDeinit(OMX_IN NvxWorker* pWorker, OMX_IN NvxTimeMs uTimeO
 
     pWorkerInt->state.i.bStopping = 1;
 
-    if (s_hSchedMutex != NULL)
+    if (s_pPool && pWorkerInt->p.i.pTask)
+    {
+        NvxSchedTask *pTask = pWorkerInt->p.i.pTask;
+        NvxTimeMs uStart = NvOsGetTimeMS();
+        NvS32 eState;
+
+        /* a queued or running task stops when a pool thread next looks at
+           it, an idle one is stopped here */
+        NvxSchedTimerDisarm(pTask);
+        for (;;)
+        {
+            eState = NvOsAtomicExchangeAdd32(&pTask->eState, 0);
+            if (eState == NVX_TASK_STOPPED)
+                break;
+            if (eState == NVX_TASK_IDLE &&
+                NvOsAtomicCompareExchange32(&pTask->eState, NVX_TASK_IDLE,
+                                            NVX_TASK_STOPPED) == NVX_TASK_IDLE)
+                break;
+
+            if (uTimeOut != NV_WAIT_INFINITE &&
+                NvOsGetTimeMS() - uStart >= uTimeOut)
+            {
+                NvxMutexUnlock(s_hSchedMutex);
+                return OMX_ErrorTimeout;
+            }
+            NvOsSemaphoreWaitTimeout(pWorkerInt->p.i.hSchedulerEvent,
+                                     NVX_SCHED_STOP_POLL_MS);
+        }
+
+        /* its last run may have armed the timer again, and an expiry pass
+           may still be submitting it */
+        NvxSchedTimerDisarm(pTask);
+        pWorkerInt->state.i.bStopped = 1;
+
+        NvOsSemaphoreDestroy(pWorkerInt->p.i.hSchedulerEvent);
+        pWorkerInt->p.i.hSchedulerEvent = NULL;
+    }
+    else if (s_hSchedMutex != NULL)
     {
         NvOsSemaphoreHandle hTriggerEvent = pWorkerInt->p.i.hTriggerEvent;
         NvOsSemaphoreHandle hSchedulerEvent = pWorkerInt->p.i.hSchedulerEvent;
@@ -428,6 +982,12 @@ OMX_ERRORTYPE NvxWorkerDeinit(OMX_IN NvxWorker* pWorker, OMX_IN NvxTimeMs uTimeO
         pWorkerInt->p.i.pPrev = NULL;
     }
 
+    if (pWorkerInt->p.i.pTask) {
+        NvxSchedTraceStats(pWorkerInt, &pWorkerInt->p.i.pTask->oStats);
+        NvOsFree(pWorkerInt->p.i.pTask);
+        pWorkerInt->p.i.pTask = NULL;
+    }
+
     pWorkerInt->p.i.hTriggerEvent = 0;
     pWorkerInt->p.i.hSchedulerEvent = 0;
     pWorkerInt->state.i.bTriggered = 0;
@@ -487,7 +1047,10 @@ OMX_ERRORTYPE NvxWorkerResume(OMX_IN NvxWorker* pWorker, OMX_IN NvxTimeMs uTimeO
         pWorkerInt->state.i.bPaused = 0;
 
     if (NvxIsSuccess(eError)) {
-        NvOsSemaphoreSignal(pWorkerInt->p.i.hTriggerEvent);
+        if (s_pPool && pWorkerInt->p.i.pTask)
+            NvxSchedSubmit(pWorkerInt->p.i.pTask);
+        else
+            NvOsSemaphoreSignal(pWorkerInt->p.i.hTriggerEvent);
         eError = OMX_ErrorNone;
     }
     return eError;
@@ -505,6 +1068,15 @@ OMX_ERRORTYPE NvxWorkerTrigger(OMX_IN NvxWorker* pWorker)
     else
         return OMX_ErrorIncorrectStateOperation;
 
+    if (s_pPool && pWorkerInt->p.i.pTask)
+    {
+        NvxSchedSubmit(pWorkerInt->p.i.pTask);
+        return OMX_ErrorNone;
+    }
+
+    if (pWorkerInt->p.i.pTask && !pWorkerInt->p.i.pTask->nQueuedUs)
+        pWorkerInt->p.i.pTask->nQueuedUs = NvOsGetTimeUS();
+
     if (pWorkerInt->p.i.hTriggerEvent == NULL)
         return OMX_ErrorNone;
 
@@ -512,3 +1084,17 @@ OMX_ERRORTYPE NvxWorkerTrigger(OMX_IN NvxWorker* pWorker)
     return OMX_ErrorNone;
 }
 
+OMX_ERRORTYPE NvxWorkerGetStats(OMX_IN NvxWorker* pWorker, OMX_OUT NvxWorkerStats *pStats)
+{
+    NvxWorkerInt* pWorkerInt = (NvxWorkerInt *)pWorker;
+
+    if (pWorker == NULL || pStats == NULL)
+        return OMX_ErrorBadParameter;
+
+    if (pWorkerInt->p.i.pTask == NULL)
+        return OMX_ErrorIncorrectStateOperation;
+
+    *pStats = pWorkerInt->p.i.pTask->oStats;
+    return OMX_ErrorNone;
+}
+
@@ -1,4 +1,4 @@
-/* Copyright (c) 2006 NVIDIA Corporation.  All rights reserved.
+/* Copyright (c) 2006-2013 NVIDIA Corporation.  All rights reserved.
  *
  * NVIDIA Corporation and its licensors retain all intellectual property 
  * and proprietary rights in and to this software, related documentation 
@@ -14,6 +14,12 @@
 
 /* Scheduler abstraction to allow for components to run either single threaded or multithreaded */
 
+/* In a multithreaded environment every worker normally gets its own thread.
+   Setting the config variable omx_sched_threads to N > 0 instead runs all
+   workers as tasks on a pool of N threads that steal work from each other;
+   workers that ask to be called again after a delay are woken by a single
+   timer wheel thread. */
+
 #include <OMX_Core.h>
 #include <NVOMX_IndexExtensions.h>
 
@@ -27,6 +33,16 @@ struct SNvxWorker {
     OMX_U32 pSchedulerData[4];   /**< data area reserved for use by scheduler */
 };
 
+/** Per worker statistics, kept in every scheduler mode */
+typedef struct SNvxWorkerStats {
+    OMX_U32 nRuns;                /**< calls of the worker function */
+    OMX_U64 nRunTimeUs;           /**< total time spent in the worker function */
+    OMX_U32 nMaxRunTimeUs;
+    OMX_U64 nQueueLatencyUs;      /**< total time from trigger to run */
+    OMX_U32 nMaxQueueLatencyUs;
+    OMX_U32 nSteals;              /**< runs taken from another pool thread's queue */
+} NvxWorkerStats;
+
 /** Typedef for error handler */
 typedef OMX_ERRORTYPE (*NvxErrorHandler)(OMX_IN NvxWorker *, OMX_IN OMX_ERRORTYPE);
 
@@ -92,6 +108,14 @@ OMX_ERRORTYPE NvxWorkerDeinit(OMX_IN NvxWorker* pWorker, OMX_IN NvxTimeMs uTimeO
     @param[in] pWorker  the worker to trigger */
 OMX_ERRORTYPE NvxWorkerTrigger(OMX_IN NvxWorker* pWorker);
 
+/** Get the run time and queue latency statistics of a worker.  They are
+    also traced with NVXT_WORKER on NVXT_SCHEDULER periodically and when the
+    worker is deinitialized.
+
+    @param[in] pWorker  the worker
+    @param[out] pStats  the statistics */
+OMX_ERRORTYPE NvxWorkerGetStats(OMX_IN NvxWorker* pWorker, OMX_OUT NvxWorkerStats *pStats);
+
 /** In single threaded mode only, run the specified worker
 
     @param[in] pWorker  the worker to run */
@@ -97,9 +97,9 @@ static OMX_ERRORTYPE NvxVirtualComponentFillThisBuffer(NvxComponent *hComponent,
     pNvxData = (SNvxVirtualComponentData *)hComponent->pComponentData;
     NV_ASSERT(pNvxData);
 
-    if (NvMMQueueGetNumEntries(pVideoInPort->pFullBuffers) > 0)
+    if (NvxListGetNumEntries(pVideoInPort->pFullBuffers) > 0)
     {
-        status = NvMMQueueDeQ(pVideoInPort->pFullBuffers, (void *) &pBuffer);
+        status = NvxListDeQ(pVideoInPort->pFullBuffers, (void **)&pBuffer);
         status = NvxPortReleaseBuffer(pVideoInPort, pBuffer);
     }
     return status;
@@ -1054,7 +1054,7 @@ static OMX_ERRORTYPE NvxNvMMLiteProcessInputBuffer(SNvxNvMMLiteTransformData *pD
             (pData->oBlockType == NvMMLiteBlockType_EncH263) ||
             (pData->oBlockType == NvMMLiteBlockType_EncVP8))
         {
-            Pending_buffers = NvMMQueueGetNumEntries(pPort->pOMXPort->pFullBuffers);
+            Pending_buffers = NvxListGetNumEntries(pPort->pOMXPort->pFullBuffers);
             pData->hBlock->SetAttribute(pData->hBlock, NvMMAttributeVideoEnc_PendingInputBuffers,
                                     0, sizeof(NvU32), &Pending_buffers);
         }